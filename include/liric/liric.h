@@ -44,6 +44,7 @@ typedef struct lr_compiler_config {
     lr_policy_t policy;       /* default: LR_POLICY_DIRECT */
     lr_backend_t backend;     /* default: LR_BACKEND_ISEL */
     const char *target;       /* NULL = host */
+    int opt_level;            /* as lr_session_config_t.opt_level */
 } lr_compiler_config_t;
 
 lr_compiler_t *lr_compiler_create(const lr_compiler_config_t *cfg,
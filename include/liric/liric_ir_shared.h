@@ -55,6 +55,14 @@ typedef enum lr_opcode {
     LR_OP_FPTRUNC,
     LR_OP_EXTRACTVALUE,
     LR_OP_INSERTVALUE,
+    /* switch cond, default, [case_imm, block]... */
+    LR_OP_SWITCH,
+    /* extractelement vec, idx */
+    LR_OP_EXTRACTELEMENT,
+    /* insertelement vec, elt, idx */
+    LR_OP_INSERTELEMENT,
+    /* shufflevector v1, v2; mask lanes in indices (UINT32_MAX = undef) */
+    LR_OP_SHUFFLEVECTOR,
 } lr_opcode_t;
 
 typedef enum lr_fcmp_pred {
@@ -64,6 +72,15 @@ typedef enum lr_fcmp_pred {
     LR_FCMP_TRUE,
 } lr_fcmp_pred_t;
 
+/* Call-site tail markers.  LR_CALL_TAIL allows the backend to turn a call
+   directly followed by its return into a jump; LR_CALL_MUSTTAIL requires it
+   wherever the target can. */
+enum {
+    LR_CALL_TAIL_NONE = 0,
+    LR_CALL_TAIL      = 1,
+    LR_CALL_MUSTTAIL  = 2,
+};
+
 typedef struct lr_operand_desc {
     int kind;
     union {
@@ -30,14 +30,30 @@ typedef enum lr_session_backend {
     LR_SESSION_BACKEND_LLVM = 3,
 } lr_session_backend_t;
 
+typedef enum lr_session_regalloc {
+    LR_SESSION_REGALLOC_DEFAULT = 0,     /* LIRIC_REGALLOC env, else none */
+    LR_SESSION_REGALLOC_NONE = 1,        /* every value in a stack slot */
+    LR_SESSION_REGALLOC_LINEAR_SCAN = 2, /* integer GPR homes (x86_64) */
+} lr_session_regalloc_t;
+
 typedef struct lr_session_config {
     lr_session_mode_t mode;
     const char *target;
-    lr_session_backend_t backend; /* default: LR_SESSION_BACKEND_COPY_PATCH */
-    /* LLVM AOT optimization level: 0 = none (default, direct/unoptimized),
-       1/2/3 = LLVM -O1/-O2/-O3 pass pipelines. Only the LLVM backend honors
-       nonzero values. */
+    lr_session_backend_t backend; /* default: LR_SESSION_BACKEND_ISEL */
+    /* Optimization level: 0 = none (default, direct/unoptimized).  The
+       LLVM backend runs its -O1/-O2/-O3 pass pipelines; at any nonzero
+       level the direct backends promote allocas, number values, hoist
+       loop invariants, strength-reduce induction variables and inline
+       small callees (streamed functions only see callees finished
+       before them). */
     int opt_level;
+    /* Register allocation for the direct backends. Targets without an
+       allocator compile as with LR_SESSION_REGALLOC_NONE. */
+    lr_session_regalloc_t regalloc;
+    /* Optional ISA extensions the direct backends may use, as an LLVM
+       -mattr style list ("host", "baseline", "+bmi2,-avx2", ...).  NULL
+       uses LIRIC_CPU_FEATURES, else the host's features. */
+    const char *target_features;
 } lr_session_config_t;
 
 /* ---- Error ------------------------------------------------------------- */
@@ -77,6 +93,7 @@ typedef struct lr_inst_desc {
     int fcmp_pred;
     bool call_external_abi;
     bool call_vararg;
+    uint8_t call_tail;          /* LR_CALL_TAIL_* marker */
     uint32_t call_fixed_args;
 } lr_inst_desc_t;
 
@@ -685,6 +702,40 @@ static inline uint32_t lr_emit_insertvalue(lr_session_t *s, lr_type_t *ty,
     return lr_session_emit(s, &d, NULL);
 }
 
+static inline uint32_t lr_emit_extractelement(lr_session_t *s, lr_type_t *ty,
+                                              lr_operand_desc_t vec,
+                                              lr_operand_desc_t idx) {
+    lr_inst_desc_t d; memset(&d, 0, sizeof(d));
+    lr_operand_desc_t ops[2] = {vec, idx};
+    d.op = LR_OP_EXTRACTELEMENT; d.type = ty; d.operands = ops;
+    d.num_operands = 2;
+    return lr_session_emit(s, &d, NULL);
+}
+
+static inline uint32_t lr_emit_insertelement(lr_session_t *s, lr_type_t *ty,
+                                             lr_operand_desc_t vec,
+                                             lr_operand_desc_t elt,
+                                             lr_operand_desc_t idx) {
+    lr_inst_desc_t d; memset(&d, 0, sizeof(d));
+    lr_operand_desc_t ops[3] = {vec, elt, idx};
+    d.op = LR_OP_INSERTELEMENT; d.type = ty; d.operands = ops;
+    d.num_operands = 3;
+    return lr_session_emit(s, &d, NULL);
+}
+
+/* mask[i] selects lane i of the result from v1 ++ v2; UINT32_MAX = undef. */
+static inline uint32_t lr_emit_shufflevector(lr_session_t *s, lr_type_t *ty,
+                                             lr_operand_desc_t v1,
+                                             lr_operand_desc_t v2,
+                                             uint32_t *mask,
+                                             uint32_t num_lanes) {
+    lr_inst_desc_t d; memset(&d, 0, sizeof(d));
+    lr_operand_desc_t ops[2] = {v1, v2};
+    d.op = LR_OP_SHUFFLEVECTOR; d.type = ty; d.operands = ops;
+    d.num_operands = 2; d.indices = mask; d.num_indices = num_lanes;
+    return lr_session_emit(s, &d, NULL);
+}
+
 /* ---- Compound convenience wrappers ------------------------------------- */
 
 static inline unsigned lr_type_width(lr_session_t *s, lr_type_t *ty) {
@@ -786,16 +837,30 @@ static inline void lr_emit_switch(lr_session_t *s,
                                   const int64_t *case_vals,
                                   const uint32_t *case_blocks,
                                   uint32_t num_cases) {
-    uint32_t i;
-    for (i = 0; i < num_cases; i++) {
-        uint32_t cmp = lr_emit_icmp(s, LR_CMP_EQ, val,
-                                    LR_IMM(case_vals[i], val.type));
-        uint32_t next = lr_session_block(s);
-        lr_emit_condbr(s, LR_VREG(cmp, lr_type_i1_s(s)),
-                       case_blocks[i], next);
-        lr_session_set_block(s, next, NULL);
-    }
-    lr_emit_br(s, default_block);
+    /* Emits LR_OP_SWITCH; more than 127 cases spill into chained switch
+       blocks so the operand list fits the fixed stack buffer. */
+    lr_operand_desc_t ops[256];
+    uint32_t i = 0;
+    do {
+        lr_inst_desc_t d; memset(&d, 0, sizeof(d));
+        uint32_t n = num_cases - i;
+        uint32_t next = default_block;
+        if (n > 127) {
+            n = 127;
+            next = lr_session_block(s);
+        }
+        ops[0] = val;
+        ops[1] = LR_BLOCK(next);
+        for (uint32_t c = 0; c < n; c++) {
+            ops[2 + c * 2] = LR_IMM(case_vals[i + c], val.type);
+            ops[3 + c * 2] = LR_BLOCK(case_blocks[i + c]);
+        }
+        d.op = LR_OP_SWITCH; d.operands = ops; d.num_operands = 2 + n * 2;
+        lr_session_emit(s, &d, NULL);
+        i += n;
+        if (next != default_block)
+            lr_session_set_block(s, next, NULL);
+    } while (i < num_cases);
 }
 
 #ifdef __cplusplus
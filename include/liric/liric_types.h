@@ -54,6 +54,7 @@ struct lr_inst {
     uint32_t align;
     bool call_external_abi;
     bool call_vararg;
+    uint8_t call_tail;
     uint32_t call_fixed_args;
     struct lr_inst *next;
 };
@@ -80,6 +81,10 @@ struct lr_func {
     bool vararg;
     bool is_decl;
     bool uses_llvm_abi;
+    bool is_local;
+    bool fast_cc;
+    bool acyclic;
+    uint32_t inline_size;
     lr_block_t *first_block;
     lr_block_t *last_block;
     lr_block_t **block_array;
@@ -88,6 +93,7 @@ struct lr_func {
     uint32_t num_linear_insts;
     uint32_t num_blocks;
     uint32_t next_vreg;
+    struct lr_cfg *cfg;
     struct lr_module *module;
     struct lr_func *next;
 };
@@ -163,6 +169,9 @@ struct lr_module {
     lr_type_t *type_fp128;
     lr_type_t *type_ptr;
     void *obj_ctx;
+    int opt_level;
+    lr_func_t **inline_funcs;
+    uint32_t inline_funcs_cap;
     bool local_function_collision_scan_dirty;
     void *sym_to_global;  /* lr_global_t** */
     void *sym_to_func;    /* lr_func_t** */
@@ -586,6 +586,10 @@ typedef struct {
     void *on_inst_ctx;
     uint32_t cur_func_code;
     const char *cur_func_name;
+    /* Block receiving loads of wide vector constants; NULL for phi
+       records and outside function bodies. */
+    lr_block_t *cur_block;
+    uint32_t const_vec_seq;
     bc_global_init_ref_t *global_inits;
     uint32_t global_init_count;
     uint32_t global_init_cap;
@@ -1160,6 +1164,87 @@ static lr_type_t *bc_get_type(bc_decoder_t *d, uint32_t idx) {
     return d->types.types[idx];
 }
 
+static bool bc_emit_inst(bc_decoder_t *d, lr_func_t *func,
+                         lr_block_t *block, lr_inst_t *inst);
+
+/* Shuffle masks are i32 constant vectors: undef lanes (and a wholly undef
+   mask) become UINT32_MAX, zeroinitializer selects lane 0 everywhere. */
+static bool bc_decode_shuffle_mask(const bc_value_table_t *vt,
+                                   const bc_value_t *mv,
+                                   uint32_t *mask, uint32_t nmask) {
+    uint32_t i;
+    if (mv->agg_elem_ids && mv->agg_elem_count == nmask) {
+        for (i = 0; i < nmask; i++) {
+            uint32_t eid = mv->agg_elem_ids[i];
+            const bc_value_t *ev;
+            if (eid >= vt->count)
+                return false;
+            ev = &vt->values[eid];
+            if (ev->kind != BC_VAL_CONST)
+                return false;
+            mask[i] = ev->operand.kind == LR_VAL_IMM_I64
+                ? (uint32_t)ev->operand.imm_i64 : UINT32_MAX;
+        }
+        return true;
+    }
+    if (mv->init_bytes && mv->init_size >= (size_t)nmask * 4u) {
+        for (i = 0; i < nmask; i++)
+            memcpy(&mask[i], mv->init_bytes + (size_t)i * 4u, 4);
+        return true;
+    }
+    if (mv->operand.kind == LR_VAL_IMM_I64 && nmask <= 2) {
+        uint64_t raw = (uint64_t)mv->operand.imm_i64;
+        for (i = 0; i < nmask; i++)
+            mask[i] = (uint32_t)(raw >> (32u * i));
+        return true;
+    }
+    if (mv->operand.kind == LR_VAL_IMM_I64 || mv->operand.kind == LR_VAL_UNDEF) {
+        uint32_t fill = mv->operand.kind == LR_VAL_UNDEF ? UINT32_MAX : 0;
+        for (i = 0; i < nmask; i++)
+            mask[i] = fill;
+        return true;
+    }
+    return false;
+}
+
+/* Vector constants too wide for an immediate are loaded from a private
+   constant global ahead of the instruction being decoded. */
+static lr_operand_t bc_materialize_vector_constant(bc_decoder_t *d,
+                                                   lr_func_t *func,
+                                                   const bc_value_t *v) {
+    char name[64];
+    lr_global_t *g;
+    uint32_t sym;
+    uint32_t dest;
+    lr_operand_t addr;
+    lr_inst_t *inst;
+    size_t size = lr_type_size(v->type);
+    size_t i;
+
+    if (size == 0 || v->init_size < size)
+        return v->operand;
+    for (i = 0; i < size && v->init_bytes[i] == 0; i++) {}
+    if (i == size)
+        return lr_op_imm_i64(0, v->type);
+    if (!func || !d->cur_block)
+        return v->operand;
+
+    snprintf(name, sizeof(name), ".lc.constagg.bc.%llx.%u",
+             (unsigned long long)(uintptr_t)d->module, d->const_vec_seq++);
+    g = lr_global_create(d->module, name, v->type, true);
+    g->init_data = lr_arena_array(d->arena, uint8_t, size);
+    memcpy(g->init_data, v->init_bytes, size);
+    g->init_size = size;
+    g->is_local = true;
+    sym = lr_frontend_intern_symbol(d->module, g->name);
+    dest = lr_vreg_new(func);
+    addr = lr_op_global(sym, d->module->type_ptr);
+    inst = lr_inst_create(d->arena, LR_OP_LOAD, v->type, dest, &addr, 1);
+    if (!bc_emit_inst(d, func, d->cur_block, inst))
+        return v->operand;
+    return lr_op_vreg(dest, v->type);
+}
+
 static lr_operand_t bc_make_operand_from_value(bc_decoder_t *d, bc_value_table_t *vt,
                                                 uint32_t val_id,
                                                 lr_func_t *func,
@@ -1203,6 +1288,8 @@ static lr_operand_t bc_make_operand_from_value(bc_decoder_t *d, bc_value_table_t
             if (bc_try_operand_from_const_bytes(v->type, v->init_bytes,
                                                 v->init_size, &packed))
                 op = packed;
+            else if (v->type && v->type->kind == LR_TYPE_VECTOR)
+                op = bc_materialize_vector_constant(d, func, v);
         }
         break;
     case BC_VAL_GLOBAL:
@@ -1393,40 +1480,6 @@ static bool bc_define_vreg_value(bc_decoder_t *d, bc_value_table_t *vt, lr_func_
     return true;
 }
 
-static bool bc_define_undef_value(bc_decoder_t *d, bc_value_table_t *vt,
-                                  uint32_t value_id, lr_type_t *type) {
-    while (value_id >= vt->count) {
-        bc_value_t fwd;
-        uint32_t before = vt->count;
-        fwd.kind = BC_VAL_VREG;
-        fwd.type = d->module->type_i32;
-        fwd.init_bytes = NULL;
-        fwd.init_size = 0;
-        fwd.agg_elem_ids = NULL;
-        fwd.agg_elem_count = 0;
-        fwd.vreg = 0;
-        bc_value_push(vt, fwd);
-        if (vt->count == before) {
-            bc_dec_error(d, "out of memory while materializing undef value");
-            return false;
-        }
-    }
-
-    {
-        bc_value_t *slot = &vt->values[value_id];
-        slot->kind = BC_VAL_CONST;
-        slot->type = type ? type : d->module->type_i32;
-        slot->init_bytes = NULL;
-        slot->init_size = 0;
-        slot->agg_elem_ids = NULL;
-        slot->agg_elem_count = 0;
-        slot->operand.kind = LR_VAL_UNDEF;
-        slot->operand.type = slot->type;
-        slot->operand.global_offset = 0;
-    }
-    return true;
-}
-
 static bool bc_define_alias_value(bc_decoder_t *d, bc_value_table_t *vt,
                                   uint32_t value_id, lr_operand_t op,
                                   lr_type_t *type) {
@@ -1518,163 +1571,6 @@ static lr_func_t *bc_resolve_call_callee_func(const bc_decoder_t *d,
     return name ? bc_find_module_function(d->module, name) : NULL;
 }
 
-static bool bc_append_unique_u32(uint32_t *vals, uint32_t *count,
-                                 uint32_t cap, uint32_t v) {
-    uint32_t i;
-    if (!vals || !count || *count > cap)
-        return false;
-    for (i = 0; i < *count; i++) {
-        if (vals[i] == v)
-            return true;
-    }
-    if (*count >= cap)
-        return false;
-    vals[*count] = v;
-    (*count)++;
-    return true;
-}
-
-static bool bc_switch_remap_phi_preds(bc_decoder_t *d, lr_block_t *succ,
-                                      uint32_t old_pred,
-                                      const uint32_t *new_preds,
-                                      uint32_t new_pred_count,
-                                      bool keep_old_pred) {
-    lr_inst_t *inst;
-    if (!d || !succ)
-        return false;
-    for (inst = succ->first; inst; inst = inst->next) {
-        uint32_t i;
-        uint32_t old_hits = 0;
-        uint32_t new_pairs;
-        uint32_t out_i = 0;
-        lr_operand_t *rewritten;
-
-        if (inst->op != LR_OP_PHI)
-            continue;
-        if (inst->num_operands < 2 || (inst->num_operands & 1u) != 0u) {
-            bc_dec_error(d, "malformed phi node in switch successor");
-            return false;
-        }
-
-        for (i = 0; i + 1 < inst->num_operands; i += 2) {
-            const lr_operand_t *pred = &inst->operands[i + 1];
-            if (pred->kind == LR_VAL_BLOCK && pred->block_id == old_pred)
-                old_hits++;
-        }
-        if (old_hits == 0)
-            continue;
-
-        if (!keep_old_pred && new_pred_count == 0) {
-            bc_dec_error(d, "switch lowering removed predecessor with no replacement");
-            return false;
-        }
-
-        {
-            uint32_t delta_pairs;
-            if (keep_old_pred) {
-                delta_pairs = old_hits * new_pred_count;
-            } else {
-                delta_pairs = old_hits * (new_pred_count - 1u);
-            }
-            new_pairs = (inst->num_operands / 2u) + delta_pairs;
-        }
-
-        rewritten = lr_arena_array(d->arena, lr_operand_t, new_pairs * 2u);
-        if (!rewritten) {
-            bc_dec_error(d, "out of memory remapping switch phi operands");
-            return false;
-        }
-
-        for (i = 0; i + 1 < inst->num_operands; i += 2) {
-            const lr_operand_t val = inst->operands[i];
-            const lr_operand_t pred = inst->operands[i + 1];
-            if (pred.kind == LR_VAL_BLOCK && pred.block_id == old_pred) {
-                uint32_t pi;
-                if (keep_old_pred) {
-                    rewritten[out_i++] = val;
-                    rewritten[out_i++] = pred;
-                }
-                for (pi = 0; pi < new_pred_count; pi++) {
-                    /* Skip duplicate predecessors — a switch may
-                       route multiple cases to the same target block,
-                       but PHI must have exactly one entry per pred. */
-                    uint32_t qi;
-                    bool dup = false;
-                    for (qi = 0; qi < out_i; qi += 2) {
-                        if (rewritten[qi + 1].kind == LR_VAL_BLOCK &&
-                            rewritten[qi + 1].block_id == new_preds[pi]) {
-                            dup = true;
-                            break;
-                        }
-                    }
-                    if (dup)
-                        continue;
-                    rewritten[out_i++] = val;
-                    rewritten[out_i++] = lr_op_block(new_preds[pi]);
-                }
-            } else {
-                rewritten[out_i++] = val;
-                rewritten[out_i++] = pred;
-            }
-        }
-        inst->operands = rewritten;
-        inst->num_operands = out_i;
-    }
-    return true;
-}
-
-typedef struct bc_switch_phi_fixup {
-    uint32_t succ_bb;
-    uint32_t old_pred;
-    bool keep_old_pred;
-    uint32_t *new_preds;
-    uint32_t new_pred_count;
-} bc_switch_phi_fixup_t;
-
-static bool bc_push_switch_phi_fixup(bc_decoder_t *d,
-                                     bc_switch_phi_fixup_t **arr,
-                                     uint32_t *count,
-                                     uint32_t *cap,
-                                     uint32_t succ_bb,
-                                     uint32_t old_pred,
-                                     bool keep_old_pred,
-                                     const uint32_t *new_preds,
-                                     uint32_t new_pred_count) {
-    bc_switch_phi_fixup_t *grown;
-    uint32_t new_cap;
-    uint32_t *pred_copy;
-
-    if (!d || !arr || !count || !cap || !new_preds || new_pred_count == 0)
-        return false;
-
-    if (*count == *cap) {
-        new_cap = (*cap == 0u) ? 8u : (*cap * 2u);
-        grown = (bc_switch_phi_fixup_t *)realloc(*arr,
-                                                 (size_t)new_cap * sizeof(*grown));
-        if (!grown) {
-            bc_dec_error(d, "out of memory growing switch phi fixups");
-            return false;
-        }
-        *arr = grown;
-        *cap = new_cap;
-    }
-
-    pred_copy = (uint32_t *)malloc((size_t)new_pred_count * sizeof(uint32_t));
-    if (!pred_copy) {
-        bc_dec_error(d, "out of memory storing switch phi fixup preds");
-        return false;
-    }
-    memcpy(pred_copy, new_preds, (size_t)new_pred_count * sizeof(uint32_t));
-
-    (*arr)[*count].succ_bb = succ_bb;
-    (*arr)[*count].old_pred = old_pred;
-    (*arr)[*count].keep_old_pred = keep_old_pred;
-    (*arr)[*count].new_preds = pred_copy;
-    (*arr)[*count].new_pred_count = new_pred_count;
-    (*count)++;
-    return true;
-}
-
 /* ---- Type block decoder ------------------------------------------------ */
 
 static bool bc_decode_type_block(bc_decoder_t *d, bc_reader_t *r, size_t end_pos) {
@@ -2582,6 +2478,7 @@ static bool bc_emit_inst(bc_decoder_t *d, lr_func_t *func,
             desc.fcmp_pred = (int)inst->fcmp_pred;
         desc.call_external_abi = inst->call_external_abi;
         desc.call_vararg = inst->call_vararg;
+        desc.call_tail = inst->call_tail;
         desc.call_fixed_args = inst->call_fixed_args;
 
         if (d->on_inst(func, block, &desc, d->on_inst_ctx) != 0) {
@@ -2616,9 +2513,6 @@ static bool bc_decode_function_block(bc_decoder_t *d, bc_reader_t *r,
     uint32_t num_blocks = 0;
     uint32_t cur_block = 0;
     uint32_t next_value_id = 0;
-    bc_switch_phi_fixup_t *switch_fixups = NULL;
-    uint32_t switch_fixup_count = 0;
-    uint32_t switch_fixup_cap = 0;
     uint32_t i;
     bool dbg_switch = getenv("LIRIC_DBG_BC_SWITCH") != NULL;
     bool ok = true;
@@ -2739,6 +2633,7 @@ static bool bc_decode_function_block(bc_decoder_t *d, bc_reader_t *r,
             }
 
             d->cur_func_code = code;
+            d->cur_block = code == FUNC_CODE_INST_PHI ? NULL : blocks[cur_block];
             switch (code) {
             case FUNC_CODE_INST_RET: {
                 lr_inst_t *inst;
@@ -2899,6 +2794,7 @@ static bool bc_decode_function_block(bc_decoder_t *d, bc_reader_t *r,
                 uint32_t dest;
                 lr_inst_t *inst;
                 lr_type_t *lhs_ty = NULL;
+                lr_type_t *res_type;
                 uint32_t op_num = 0;
 
                 /* Mirror LLVM BitcodeReader:
@@ -2916,8 +2812,12 @@ static bool bc_decode_function_block(bc_decoder_t *d, bc_reader_t *r,
                 pred = (uint32_t)r->record[op_num++];
                 ops[0] = bc_make_operand_from_value(d, &local_vt, lhs_vid, func, lhs_ty);
                 ops[1] = bc_make_operand_from_value(d, &local_vt, rhs_vid, func, ops[0].type);
+                res_type = d->module->type_i1;
+                if (ops[0].type && ops[0].type->kind == LR_TYPE_VECTOR)
+                    res_type = lr_type_vector(d->arena, d->module->type_i1,
+                                            ops[0].type->array.count);
                 if (!bc_define_vreg_value(d, &local_vt, func, next_value_id,
-                                          d->module->type_i1, &dest)) {
+                                          res_type, &dest)) {
                     ok = false;
                     break;
                 }
@@ -2929,7 +2829,7 @@ static bool bc_decode_function_block(bc_decoder_t *d, bc_reader_t *r,
                         lr_icmp_pred_t ipred_fallback;
                         if (bc_map_icmp_pred(pred, &ipred_fallback)) {
                             inst = lr_inst_create(d->arena, LR_OP_ICMP,
-                                                   d->module->type_i1, dest, ops, 2);
+                                                   res_type, dest, ops, 2);
                             if (inst)
                                 inst->icmp_pred = ipred_fallback;
                             goto cmp_emit_done;
@@ -2939,7 +2839,7 @@ static bool bc_decode_function_block(bc_decoder_t *d, bc_reader_t *r,
                         break;
                     }
                     inst = lr_inst_create(d->arena, LR_OP_FCMP,
-                                           d->module->type_i1, dest, ops, 2);
+                                           res_type, dest, ops, 2);
                     if (inst)
                         inst->fcmp_pred = fpred;
                 } else {
@@ -2947,12 +2847,12 @@ static bool bc_decode_function_block(bc_decoder_t *d, bc_reader_t *r,
                     lr_fcmp_pred_t fpred;
                     if (bc_map_icmp_pred(pred, &ipred)) {
                         inst = lr_inst_create(d->arena, LR_OP_ICMP,
-                                               d->module->type_i1, dest, ops, 2);
+                                               res_type, dest, ops, 2);
                         if (inst)
                             inst->icmp_pred = ipred;
                     } else if (bc_map_fcmp_pred(pred, &fpred)) {
                         inst = lr_inst_create(d->arena, LR_OP_FCMP,
-                                               d->module->type_i1, dest, ops, 2);
+                                               res_type, dest, ops, 2);
                         if (inst)
                             inst->fcmp_pred = fpred;
                     } else {
@@ -3458,6 +3358,8 @@ cmp_emit_done:
                 lr_func_t *callee_func = NULL;
                 bool call_vararg_meta;
                 uint32_t call_fixed_args_meta;
+                const uint32_t CALL_TAIL_BIT = 0u;
+                const uint32_t CALL_MUSTTAIL_BIT = 14u;
                 const uint32_t CALL_EXPLICIT_TYPE_BIT = 15u;
                 const uint32_t CALL_FMF_BIT = 17u;
 
@@ -3611,8 +3513,11 @@ cmp_emit_done:
                 if (inst) {
                     inst->call_vararg = call_vararg_meta;
                     inst->call_fixed_args = call_fixed_args_meta;
+                    if (((cc_flags >> CALL_MUSTTAIL_BIT) & 1u) != 0u)
+                        inst->call_tail = LR_CALL_MUSTTAIL;
+                    else if (((cc_flags >> CALL_TAIL_BIT) & 1u) != 0u)
+                        inst->call_tail = LR_CALL_TAIL;
                 }
-                (void)cc_flags;
                 if (!bc_emit_inst(d, func, blocks[cur_block], inst)) {
                     ok = false;
                     break;
@@ -3668,8 +3573,9 @@ cmp_emit_done:
                 lr_type_t *vec_ty = NULL;
                 lr_type_t *idx_ty = NULL;
                 lr_type_t *res_ty = d->module->type_i32;
-                (void)idx_vid;
-                (void)idx_ty;
+                lr_operand_t ops[2];
+                uint32_t dest;
+                lr_inst_t *inst;
                 if (!bc_record_get_value_type_pair(d, &local_vt, r->record, r->record_len,
                                                    &op_num, next_value_id, &vec_vid, &vec_ty) ||
                     !bc_record_get_value_type_pair(d, &local_vt, r->record, r->record_len,
@@ -3680,11 +3586,20 @@ cmp_emit_done:
                 }
                 if (vec_ty && vec_ty->kind == LR_TYPE_VECTOR && vec_ty->array.elem)
                     res_ty = vec_ty->array.elem;
-                if (!bc_define_undef_value(d, &local_vt, next_value_id, res_ty)) {
+                ops[0] = bc_make_operand_from_value(d, &local_vt, vec_vid, func, vec_ty);
+                ops[1] = bc_make_operand_from_value(d, &local_vt, idx_vid, func, idx_ty);
+                if (!bc_define_vreg_value(d, &local_vt, func, next_value_id, res_ty, &dest)) {
                     ok = false;
                     break;
                 }
                 next_value_id++;
+
+                inst = lr_inst_create(d->arena, LR_OP_EXTRACTELEMENT,
+                                      res_ty, dest, ops, 2);
+                if (!bc_emit_inst(d, func, blocks[cur_block], inst)) {
+                    ok = false;
+                    break;
+                }
                 break;
             }
             case FUNC_CODE_INST_INSERTELT: {
@@ -3692,9 +3607,10 @@ cmp_emit_done:
                 uint32_t vec_vid = 0, val_vid = 0, idx_vid = 0;
                 lr_type_t *vec_ty = NULL;
                 lr_type_t *idx_ty = NULL;
-                (void)val_vid;
-                (void)idx_vid;
-                (void)idx_ty;
+                lr_type_t *elem_ty = d->module->type_i32;
+                lr_operand_t ops[3];
+                uint32_t dest;
+                lr_inst_t *inst;
                 if (!bc_record_get_value_type_pair(d, &local_vt, r->record, r->record_len,
                                                    &op_num, next_value_id, &vec_vid, &vec_ty) ||
                     !bc_record_get_value(d, r->record, r->record_len,
@@ -3705,12 +3621,25 @@ cmp_emit_done:
                     ok = false;
                     break;
                 }
-                if (!bc_define_undef_value(d, &local_vt, next_value_id,
-                                           vec_ty ? vec_ty : d->module->type_i32)) {
+                if (!vec_ty)
+                    vec_ty = d->module->type_i32;
+                if (vec_ty->kind == LR_TYPE_VECTOR && vec_ty->array.elem)
+                    elem_ty = vec_ty->array.elem;
+                ops[0] = bc_make_operand_from_value(d, &local_vt, vec_vid, func, vec_ty);
+                ops[1] = bc_make_operand_from_value(d, &local_vt, val_vid, func, elem_ty);
+                ops[2] = bc_make_operand_from_value(d, &local_vt, idx_vid, func, idx_ty);
+                if (!bc_define_vreg_value(d, &local_vt, func, next_value_id, vec_ty, &dest)) {
                     ok = false;
                     break;
                 }
                 next_value_id++;
+
+                inst = lr_inst_create(d->arena, LR_OP_INSERTELEMENT,
+                                      vec_ty, dest, ops, 3);
+                if (!bc_emit_inst(d, func, blocks[cur_block], inst)) {
+                    ok = false;
+                    break;
+                }
                 break;
             }
             case FUNC_CODE_INST_SHUFFLEVEC: {
@@ -3718,9 +3647,12 @@ cmp_emit_done:
                 uint32_t lhs_vid = 0, rhs_vid = 0, mask_vid = 0;
                 lr_type_t *lhs_ty = NULL;
                 lr_type_t *mask_ty = NULL;
-                (void)rhs_vid;
-                (void)mask_vid;
-                (void)mask_ty;
+                lr_type_t *res_ty;
+                lr_operand_t ops[2];
+                uint32_t *mask = NULL;
+                uint32_t nmask = 0;
+                uint32_t dest;
+                lr_inst_t *inst;
                 if (!bc_record_get_value_type_pair(d, &local_vt, r->record, r->record_len,
                                                    &op_num, next_value_id, &lhs_vid, &lhs_ty) ||
                     !bc_record_get_value(d, r->record, r->record_len,
@@ -3731,12 +3663,41 @@ cmp_emit_done:
                     ok = false;
                     break;
                 }
-                if (!bc_define_undef_value(d, &local_vt, next_value_id,
-                                           lhs_ty ? lhs_ty : d->module->type_i32)) {
+                if (!lhs_ty || lhs_ty->kind != LR_TYPE_VECTOR ||
+                    !mask_ty || mask_ty->kind != LR_TYPE_VECTOR ||
+                    mask_vid >= local_vt.count ||
+                    local_vt.values[mask_vid].kind != BC_VAL_CONST) {
+                    bc_dec_error(d, "unsupported shufflevector operands");
+                    ok = false;
+                    break;
+                }
+                nmask = (uint32_t)mask_ty->array.count;
+                mask = lr_arena_array(d->arena, uint32_t, nmask);
+                if (!bc_decode_shuffle_mask(&local_vt, &local_vt.values[mask_vid],
+                                            mask, nmask)) {
+                    bc_dec_error(d, "unsupported shufflevector mask");
+                    ok = false;
+                    break;
+                }
+                res_ty = lr_type_vector(d->arena, lhs_ty->array.elem, nmask);
+                ops[0] = bc_make_operand_from_value(d, &local_vt, lhs_vid, func, lhs_ty);
+                ops[1] = bc_make_operand_from_value(d, &local_vt, rhs_vid, func, lhs_ty);
+                if (!bc_define_vreg_value(d, &local_vt, func, next_value_id, res_ty, &dest)) {
                     ok = false;
                     break;
                 }
                 next_value_id++;
+
+                inst = lr_inst_create(d->arena, LR_OP_SHUFFLEVECTOR,
+                                      res_ty, dest, ops, 2);
+                if (inst) {
+                    inst->indices = mask;
+                    inst->num_indices = nmask;
+                }
+                if (!bc_emit_inst(d, func, blocks[cur_block], inst)) {
+                    ok = false;
+                    break;
+                }
                 break;
             }
             case FUNC_CODE_INST_VSELECT: {
@@ -3943,15 +3904,9 @@ cmp_emit_done:
                 uint32_t cases_payload;
                 uint32_t num_cases;
                 lr_type_t *switch_ty;
-                lr_operand_t cond_op;
-                lr_block_t *test_block;
+                lr_operand_t *sw_ops;
+                lr_inst_t *inst;
                 uint32_t ci;
-                uint32_t old_switch_pred;
-                uint32_t edge_count = 0;
-                uint32_t edge_cap = 0;
-                uint32_t *edge_targets = NULL;
-                uint32_t *edge_preds = NULL;
-                uint32_t *target_preds = NULL;
 
                 if (r->record_len < 3) {
                     bc_dec_error(d, "malformed switch record");
@@ -3976,7 +3931,6 @@ cmp_emit_done:
                     ok = false;
                     break;
                 }
-                cond_op = bc_make_operand_from_value(d, &local_vt, cond_vid, func, switch_ty);
                 cases_payload = r->record_len - 3u;
                 if ((cases_payload & 1u) != 0u) {
                     bc_dec_error(d, "malformed switch record payload");
@@ -3984,44 +3938,20 @@ cmp_emit_done:
                     break;
                 }
                 num_cases = cases_payload / 2u;
-                if (num_cases == 0u) {
-                    lr_operand_t op = lr_op_block(default_bb);
-                    lr_inst_t *inst = lr_inst_create(d->arena, LR_OP_BR,
-                                                     d->module->type_void, 0, &op, 1);
-                    if (!bc_emit_inst(d, func, blocks[cur_block], inst)) {
-                        ok = false;
-                        break;
-                    }
-                    cur_block++;
-                    break;
-                }
-
-                old_switch_pred = blocks[cur_block]->id;
-                edge_cap = num_cases + 1u; /* each case true-edge + final default edge */
-                edge_targets = (uint32_t *)malloc((size_t)edge_cap * sizeof(uint32_t));
-                edge_preds = (uint32_t *)malloc((size_t)edge_cap * sizeof(uint32_t));
-                target_preds = (uint32_t *)malloc((size_t)edge_cap * sizeof(uint32_t));
-                if (!edge_targets || !edge_preds || !target_preds) {
-                    free(edge_targets);
-                    free(edge_preds);
-                    free(target_preds);
-                    bc_dec_error(d, "out of memory lowering switch");
+                sw_ops = lr_arena_array(d->arena, lr_operand_t,
+                                        2u + num_cases * 2u);
+                if (!sw_ops) {
+                    bc_dec_error(d, "out of memory decoding switch");
                     ok = false;
                     break;
                 }
-
-                test_block = blocks[cur_block];
+                sw_ops[0] = bc_make_operand_from_value(d, &local_vt, cond_vid,
+                                                       func, switch_ty);
+                sw_ops[1] = lr_op_block(default_bb);
                 for (ci = 0; ci < num_cases; ci++) {
                     uint32_t case_val_id = (uint32_t)r->record[3u + (ci * 2u)];
                     uint32_t case_bb = (uint32_t)r->record[4u + (ci * 2u)];
-                    uint32_t false_bb = default_bb;
-                    uint32_t test_block_id = test_block->id;
                     lr_operand_t case_op;
-                    lr_operand_t cmp_ops[2];
-                    lr_operand_t br_ops[3];
-                    lr_inst_t *icmp;
-                    lr_inst_t *brinst;
-                    uint32_t cmp_vreg;
 
                     if (case_bb >= num_blocks) {
                         bc_dec_error(d, "switch case block %u out of range (have %u)",
@@ -4029,168 +3959,39 @@ cmp_emit_done:
                         ok = false;
                         break;
                     }
-                    if (dbg_switch) {
-                        if (case_val_id < local_vt.count &&
-                            local_vt.values[case_val_id].kind == BC_VAL_CONST &&
-                            local_vt.values[case_val_id].operand.kind == LR_VAL_IMM_I64) {
-                            fprintf(stderr,
-                                    "bc switch: func=%s base=%u raw_case=%u imm=%lld case_bb=%u default_bb=%u\n",
-                                    func && func->name ? func->name : "<anon>",
-                                    next_value_id,
-                                    (unsigned)case_val_id,
-                                    (long long)local_vt.values[case_val_id].operand.imm_i64,
-                                    (unsigned)case_bb,
-                                    (unsigned)default_bb);
-                        } else {
-                            fprintf(stderr,
-                                    "bc switch: func=%s base=%u raw_case=%u kind=%d case_bb=%u default_bb=%u\n",
-                                    func && func->name ? func->name : "<anon>",
-                                    next_value_id,
-                                    (unsigned)case_val_id,
-                                    (case_val_id < local_vt.count)
-                                        ? (int)local_vt.values[case_val_id].kind
-                                        : -1,
-                                    (unsigned)case_bb,
-                                    (unsigned)default_bb);
-                        }
-                    }
                     case_op = bc_make_operand_from_value(d, &local_vt, case_val_id,
                                                          func, switch_ty);
-
-                    if (ci + 1u < num_cases) {
-                        char bb_name[32];
-                        lr_block_t *next_test;
-                        snprintf(bb_name, sizeof(bb_name), "bb.sw.%u", func->num_blocks);
-                        next_test = lr_block_create(func, d->arena, bb_name);
-                        if (!next_test) {
-                            bc_dec_error(d, "out of memory creating switch test block");
-                            ok = false;
-                            break;
-                        }
-                        false_bb = next_test->id;
-                    }
-
-                    cmp_vreg = lr_vreg_new(func);
-                    cmp_ops[0] = cond_op;
-                    cmp_ops[1] = case_op;
-                    icmp = lr_inst_create(d->arena, LR_OP_ICMP,
-                                          d->module->type_i1, cmp_vreg, cmp_ops, 2);
-                    if (icmp)
-                        icmp->icmp_pred = LR_ICMP_EQ;
-                    if (!bc_emit_inst(d, func, test_block, icmp)) {
+                    if (case_op.kind != LR_VAL_IMM_I64) {
+                        bc_dec_error(d, "switch case value %u is not an integer constant",
+                                     case_val_id);
                         ok = false;
                         break;
                     }
-
-                    br_ops[0] = lr_op_vreg(cmp_vreg, d->module->type_i1);
-                    br_ops[1] = lr_op_block(case_bb);
-                    br_ops[2] = lr_op_block(false_bb);
-                    brinst = lr_inst_create(d->arena, LR_OP_CONDBR,
-                                            d->module->type_void, 0, br_ops, 3);
-                    if (!bc_emit_inst(d, func, test_block, brinst)) {
-                        ok = false;
-                        break;
-                    }
-                    if (edge_count >= edge_cap) {
-                        bc_dec_error(d, "internal switch edge accounting overflow");
-                        ok = false;
-                        break;
+                    if (dbg_switch) {
+                        fprintf(stderr,
+                                "bc switch: func=%s case=%lld case_bb=%u default_bb=%u\n",
+                                func && func->name ? func->name : "<anon>",
+                                (long long)case_op.imm_i64,
+                                (unsigned)case_bb,
+                                (unsigned)default_bb);
                     }
-                    edge_targets[edge_count] = case_bb;
-                    edge_preds[edge_count] = test_block_id;
-                    edge_count++;
-
-                    if (ci + 1u < num_cases)
-                        test_block = func->last_block;
+                    sw_ops[2u + ci * 2u] = case_op;
+                    sw_ops[3u + ci * 2u] = lr_op_block(case_bb);
                 }
-                if (!ok) {
-                    free(edge_targets);
-                    free(edge_preds);
-                    free(target_preds);
+                if (!ok)
                     break;
-                }
 
-                if (edge_count >= edge_cap) {
-                    free(edge_targets);
-                    free(edge_preds);
-                    free(target_preds);
-                    bc_dec_error(d, "internal switch edge accounting overflow");
+                if (num_cases == 0u)
+                    inst = lr_inst_create(d->arena, LR_OP_BR,
+                                          d->module->type_void, 0, &sw_ops[1], 1);
+                else
+                    inst = lr_inst_create(d->arena, LR_OP_SWITCH,
+                                          d->module->type_void, 0, sw_ops,
+                                          2u + num_cases * 2u);
+                if (!bc_emit_inst(d, func, blocks[cur_block], inst)) {
                     ok = false;
                     break;
                 }
-                edge_targets[edge_count] = default_bb;
-                edge_preds[edge_count] = test_block->id;
-                edge_count++;
-
-                for (uint32_t ei = 0; ei < edge_count && ok; ei++) {
-                    uint32_t target_bb = edge_targets[ei];
-                    uint32_t pred_count = 0;
-                    bool seen_target = false;
-                    bool has_old_pred = false;
-
-                    for (uint32_t pi = 0; pi < ei; pi++) {
-                        if (edge_targets[pi] == target_bb) {
-                            seen_target = true;
-                            break;
-                        }
-                    }
-                    if (seen_target)
-                        continue;
-
-                    for (uint32_t pi = 0; pi < edge_count; pi++) {
-                        if (edge_targets[pi] != target_bb)
-                            continue;
-                        if (!bc_append_unique_u32(target_preds, &pred_count,
-                                                  edge_cap, edge_preds[pi])) {
-                            bc_dec_error(d, "internal switch predecessor overflow");
-                            ok = false;
-                            break;
-                        }
-                        if (edge_preds[pi] == old_switch_pred)
-                            has_old_pred = true;
-                    }
-                    if (!ok)
-                        break;
-
-                    if (!has_old_pred) {
-                        if (!bc_push_switch_phi_fixup(d, &switch_fixups,
-                                                      &switch_fixup_count,
-                                                      &switch_fixup_cap,
-                                                      target_bb,
-                                                      old_switch_pred,
-                                                      false,
-                                                      target_preds,
-                                                      pred_count)) {
-                            ok = false;
-                            break;
-                        }
-                    } else if (pred_count > 1u) {
-                        uint32_t extra_count = 0;
-                        for (uint32_t pi = 0; pi < pred_count; pi++) {
-                            if (target_preds[pi] == old_switch_pred)
-                                continue;
-                            target_preds[extra_count++] = target_preds[pi];
-                        }
-                        if (extra_count > 0u &&
-                            !bc_push_switch_phi_fixup(d, &switch_fixups,
-                                                      &switch_fixup_count,
-                                                      &switch_fixup_cap,
-                                                      target_bb,
-                                                      old_switch_pred,
-                                                      true,
-                                                      target_preds,
-                                                      extra_count)) {
-                            ok = false;
-                            break;
-                        }
-                    }
-                }
-
-                free(edge_targets);
-                free(edge_preds);
-                free(target_preds);
-                if (!ok)
-                    break;
                 cur_block++;
                 break;
             }
@@ -4206,29 +4007,9 @@ cmp_emit_done:
         }
     }
 
-    if (ok && !r->has_error) {
-        for (i = 0; i < switch_fixup_count; i++) {
-            bc_switch_phi_fixup_t *fx = &switch_fixups[i];
-            if (fx->succ_bb >= num_blocks) {
-                bc_dec_error(d, "switch phi fixup target block %u out of range",
-                             fx->succ_bb);
-                ok = false;
-                break;
-            }
-            if (!bc_switch_remap_phi_preds(d, blocks[fx->succ_bb],
-                                           fx->old_pred,
-                                           fx->new_preds,
-                                           fx->new_pred_count,
-                                           fx->keep_old_pred)) {
-                ok = false;
-                break;
-            }
-        }
-    }
-
-    /* Deduplicate PHI predecessor entries.  Switch lowering can
-       produce multiple entries for the same predecessor block when
-       several case values branch to the same target. */
+    /* Deduplicate PHI predecessor entries.  A switch lists its block
+       once per case edge, so several case values branching to the same
+       target leave repeated entries for one predecessor. */
     if (ok && !r->has_error && num_blocks > 0) {
         for (uint32_t bi = 0; bi < num_blocks; bi++) {
             for (lr_inst_t *inst = blocks[bi]->first; inst;
@@ -4336,9 +4117,6 @@ cmp_emit_done:
         }
     }
 
-    for (i = 0; i < switch_fixup_count; i++)
-        free(switch_fixups[i].new_preds);
-    free(switch_fixups);
     free(blocks);
     free(local_vt.values);
     d->cur_func_name = NULL;
@@ -4539,6 +4317,7 @@ static bool bc_decode_module_block(bc_decoder_t *d, bc_reader_t *r, size_t end_p
                    function declarations/definitions. Keep call/param lowering
                    consistent across caller and callee. */
                 fn->uses_llvm_abi = true;
+                fn->is_local = !is_decl && func_name != name;
 
                 fv.kind = BC_VAL_FUNC;
                 fv.type = d->module->type_ptr;
@@ -5037,6 +4816,7 @@ static bool bc_opcode_has_dest(lr_opcode_t op, lr_type_t *type) {
     case LR_OP_RET_VOID:
     case LR_OP_BR:
     case LR_OP_CONDBR:
+    case LR_OP_SWITCH:
     case LR_OP_UNREACHABLE:
     case LR_OP_STORE:
         return false;
@@ -5172,6 +4952,7 @@ static int bc_replay_func_to_session(const lr_module_t *src_mod,
             desc.fcmp_pred = inst->fcmp_pred;
             desc.call_external_abi = inst->call_external_abi;
             desc.call_vararg = inst->call_vararg;
+            desc.call_tail = inst->call_tail;
             desc.call_fixed_args = inst->call_fixed_args;
 
             if (desc.num_operands > 0) {
@@ -28,6 +28,7 @@ typedef struct lr_bc_inst_desc {
     int fcmp_pred;
     bool call_external_abi;
     bool call_vararg;
+    uint8_t call_tail;
     uint32_t call_fixed_args;
 } lr_bc_inst_desc_t;
 
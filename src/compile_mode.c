@@ -1,4 +1,5 @@
 #include "compile_mode.h"
+#include "platform/platform_cpu.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -27,7 +28,7 @@ int lr_compile_mode_parse(const char *text, lr_compile_mode_t *out_mode) {
 }
 
 lr_compile_mode_t lr_compile_mode_from_env(void) {
-    lr_compile_mode_t mode = LR_COMPILE_COPY_PATCH;
+    lr_compile_mode_t mode = LR_COMPILE_ISEL;
     const char *env = getenv("LIRIC_COMPILE_MODE");
     if (env)
         (void)lr_compile_mode_parse(env, &mode);
@@ -46,3 +47,28 @@ const char *lr_compile_mode_name(lr_compile_mode_t mode) {
         return "unknown";
     }
 }
+
+uint32_t lr_codegen_flags_from_env(void) {
+    uint32_t flags = 0;
+    const char *env = getenv("LIRIC_REGALLOC");
+    if (env && (strcmp(env, "linear_scan") == 0 || strcmp(env, "1") == 0))
+        flags |= LR_CODEGEN_REGALLOC;
+    return flags;
+}
+
+int lr_cpu_features_resolve(const char *target_name, const char *spec,
+                            bool host_default, uint32_t *out) {
+    uint32_t feats = 0;
+    if (!out)
+        return -1;
+    if (!spec)
+        spec = getenv("LIRIC_CPU_FEATURES");
+    if (spec) {
+        if (lr_platform_cpu_parse_features(spec, &feats) != 0)
+            return -1;
+    } else if (host_default && lr_platform_cpu_target_is_host(target_name)) {
+        feats = lr_platform_cpu_host_features();
+    }
+    *out = feats & lr_platform_cpu_target_mask(target_name);
+    return 0;
+}
@@ -6,9 +6,21 @@
 /* Parse mode text into enum; returns 0 on success. */
 int lr_compile_mode_parse(const char *text, lr_compile_mode_t *out_mode);
 
-/* Parse LIRIC_COMPILE_MODE from env; defaults to LR_COMPILE_COPY_PATCH. */
+/* Parse LIRIC_COMPILE_MODE from env; defaults to LR_COMPILE_ISEL. */
 lr_compile_mode_t lr_compile_mode_from_env(void);
 
 const char *lr_compile_mode_name(lr_compile_mode_t mode);
 
+/* Parse LIRIC_REGALLOC ("linear_scan" or "none") into LR_CODEGEN_* bits;
+   defaults to no optional passes. */
+uint32_t lr_codegen_flags_from_env(void);
+
+/* Feature set (LR_CPU_* bits) code for target_name may assume.  spec uses
+   lr_platform_cpu_parse_features syntax; NULL falls back to
+   LIRIC_CPU_FEATURES, then to the host features when the code runs on
+   this host (host_default) and the baseline otherwise.  Bits for other
+   architectures are dropped.  Returns 0, or -1 on an invalid spec. */
+int lr_cpu_features_resolve(const char *target_name, const char *spec,
+                            bool host_default, uint32_t *out);
+
 #endif
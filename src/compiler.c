@@ -95,6 +95,7 @@ lr_compiler_t *lr_compiler_create(const lr_compiler_config_t *cfg,
     lr_policy_t policy = LR_POLICY_DIRECT;
     lr_backend_t backend = LR_BACKEND_COPY_PATCH;
     const char *target = NULL;
+    int opt_level = 0;
 
     compiler_err_clear(err);
 
@@ -102,6 +103,7 @@ lr_compiler_t *lr_compiler_create(const lr_compiler_config_t *cfg,
         policy = cfg->policy;
         backend = cfg->backend;
         target = cfg->target;
+        opt_level = cfg->opt_level;
     }
 
     if (policy != LR_POLICY_DIRECT && policy != LR_POLICY_IR) {
@@ -111,6 +113,7 @@ lr_compiler_t *lr_compiler_create(const lr_compiler_config_t *cfg,
     memset(&scfg, 0, sizeof(scfg));
     scfg.mode = (policy == LR_POLICY_DIRECT) ? LR_MODE_DIRECT : LR_MODE_IR;
     scfg.target = target;
+    scfg.opt_level = opt_level;
     if (backend_to_session_backend(backend, &scfg.backend) != 0) {
         compiler_err_set(err, LR_COMPILER_ERR_ARGUMENT, "invalid backend");
         return NULL;
@@ -118,6 +118,19 @@ lr_type_t *lr_type_vector(lr_arena_t *a, lr_type_t *elem, uint64_t count) {
     return t;
 }
 
+/* Vector and array types are not interned, so two uses of the same type
+   may be distinct objects; everything else compares by identity. */
+bool lr_type_same(const lr_type_t *a, const lr_type_t *b) {
+    if (a == b)
+        return true;
+    if (!a || !b || a->kind != b->kind)
+        return false;
+    if (a->kind != LR_TYPE_VECTOR && a->kind != LR_TYPE_ARRAY)
+        return false;
+    return a->array.count == b->array.count &&
+           lr_type_same(a->array.elem, b->array.elem);
+}
+
 lr_type_t *lr_type_struct(lr_arena_t *a, lr_type_t **fields, uint32_t n,
                            bool packed, char *name) {
     lr_type_t *t = lr_arena_new(a, lr_type_t);
@@ -180,6 +193,7 @@ lr_block_t *lr_block_create(lr_func_t *f, lr_arena_t *a, const char *name) {
     f->linear_inst_array = NULL;
     f->block_inst_offsets = NULL;
     f->num_linear_insts = 0;
+    f->cfg = NULL;
     if (!f->first_block) {
         f->first_block = b;
         f->is_decl = false;
@@ -225,6 +239,7 @@ lr_inst_t *lr_inst_create(lr_arena_t *a, lr_opcode_t op, lr_type_t *type,
     inst->align = 0;
     inst->call_external_abi = false;
     inst->call_vararg = false;
+    inst->call_tail = LR_CALL_TAIL_NONE;
     inst->call_fixed_args = 0;
     inst->next = NULL;
     return inst;
@@ -243,6 +258,7 @@ void lr_block_append(lr_block_t *b, lr_inst_t *inst) {
         f->linear_inst_array = NULL;
         f->block_inst_offsets = NULL;
         f->num_linear_insts = 0;
+        f->cfg = NULL;
         /* Only a new *global call* instruction can introduce a new
            call-signature-vs-function-definition conflict.  Other
            instructions (load/store/arithmetic/branch/return/...) cannot
@@ -260,10 +276,13 @@ typedef struct lr_opt_replacement {
     lr_operand_t op;
 } lr_opt_replacement_t;
 
+/* Open-addressed; entries from an older epoch read as empty, so a store
+   or call clears the table by bumping the epoch. */
 typedef struct lr_load_cache_entry {
     lr_operand_t ptr;
     lr_type_t *load_type;
     uint32_t value_vreg;
+    uint32_t epoch;
 } lr_load_cache_entry_t;
 
 static uint8_t int_type_width_bits(const lr_type_t *type) {
@@ -310,6 +329,16 @@ static int64_t int_sign_extend_bits(uint64_t val, uint8_t bits) {
     return (int64_t)((v ^ sign) - sign);
 }
 
+/* Case values compare in the condition's width, so i8 -1 matches 255. */
+static bool switch_case_matches(const lr_operand_t *cond,
+                                const lr_operand_t *case_val) {
+    uint8_t bits = int_type_width_bits(cond->type);
+    if (case_val->kind != LR_VAL_IMM_I64)
+        return false;
+    return int_to_unsigned_bits(cond->imm_i64, bits) ==
+           int_to_unsigned_bits(case_val->imm_i64, bits);
+}
+
 static bool operand_equal(const lr_operand_t *a, const lr_operand_t *b) {
     uint64_t a_bits = 0;
     uint64_t b_bits = 0;
@@ -336,6 +365,30 @@ static bool operand_equal(const lr_operand_t *a, const lr_operand_t *b) {
     }
 }
 
+static uint32_t hash_mix(uint32_t h, uint64_t v) {
+    h = (h ^ (uint32_t)v) * 16777619u;
+    return (h ^ (uint32_t)(v >> 32)) * 16777619u;
+}
+
+/* Hash consistent with operand_equal. */
+static uint32_t operand_hash(const lr_operand_t *op) {
+    uint32_t h = hash_mix(2166136261u, (uint64_t)op->kind);
+    h = hash_mix(h, (uint64_t)(uintptr_t)op->type);
+    h = hash_mix(h, (uint64_t)op->global_offset);
+    switch (op->kind) {
+    case LR_VAL_VREG:    return hash_mix(h, op->vreg);
+    case LR_VAL_IMM_I64: return hash_mix(h, (uint64_t)op->imm_i64);
+    case LR_VAL_IMM_F64: {
+        uint64_t bits;
+        memcpy(&bits, &op->imm_f64, sizeof(bits));
+        return hash_mix(h, bits);
+    }
+    case LR_VAL_BLOCK:   return hash_mix(h, op->block_id);
+    case LR_VAL_GLOBAL:  return hash_mix(h, op->global_id);
+    default:             return h;
+    }
+}
+
 static bool operand_resolve(const lr_opt_replacement_t *repl, uint32_t nrepl,
                             lr_operand_t *op) {
     bool changed = false;
@@ -365,6 +418,7 @@ static bool inst_defines_dest(const lr_inst_t *inst) {
     case LR_OP_RET_VOID:
     case LR_OP_BR:
     case LR_OP_CONDBR:
+    case LR_OP_SWITCH:
     case LR_OP_UNREACHABLE:
     case LR_OP_STORE:
         return false;
@@ -603,7 +657,20 @@ static bool fold_select(const lr_inst_t *inst, lr_operand_t *out) {
     return false;
 }
 
+static bool is_vector_type(const lr_type_t *type) {
+    return type && type->kind == LR_TYPE_VECTOR;
+}
+
 static bool try_inst_replacement(const lr_inst_t *inst, lr_operand_t *out) {
+    /* Vector immediates pack every lane into imm_i64; the scalar folders
+       below would read them as one integer. */
+    if (is_vector_type(inst->type) ||
+        (inst->num_operands > 0 && is_vector_type(inst->operands[0].type))) {
+        if (inst->op == LR_OP_SELECT && inst->num_operands >= 3 &&
+            !is_vector_type(inst->operands[0].type))
+            return fold_select(inst, out);
+        return false;
+    }
     if (fold_select(inst, out))
         return true;
     if (fold_icmp_immediates(inst, out))
@@ -619,6 +686,7 @@ static int run_func_peephole_passes(lr_func_t *f, lr_arena_t *a) {
     uint32_t nrepl;
     lr_opt_replacement_t *repl;
     lr_load_cache_entry_t *load_cache;
+    uint32_t load_cap = 16, load_epoch = 0;
     uint32_t *use_counts;
     bool changed_any = false;
 
@@ -626,8 +694,10 @@ static int run_func_peephole_passes(lr_func_t *f, lr_arena_t *a) {
         return 0;
 
     nrepl = f->next_vreg > 0 ? f->next_vreg : 1u;
+    while (load_cap < nrepl * 2u)
+        load_cap <<= 1;
     repl = lr_arena_array(a, lr_opt_replacement_t, nrepl);
-    load_cache = lr_arena_array(a, lr_load_cache_entry_t, nrepl);
+    load_cache = lr_arena_array(a, lr_load_cache_entry_t, load_cap);
     use_counts = lr_arena_array(a, uint32_t, nrepl);
     if (!repl || !load_cache || !use_counts)
         return -1;
@@ -638,10 +708,10 @@ static int run_func_peephole_passes(lr_func_t *f, lr_arena_t *a) {
         for (uint32_t bi = 0; bi < f->num_blocks; bi++) {
             lr_block_t *b = f->block_array[bi];
             lr_inst_t *prev = NULL;
-            uint32_t load_count = 0;
 
             if (!b)
                 continue;
+            load_epoch++;
 
             for (lr_inst_t *inst = b->first; inst; ) {
                 lr_inst_t *next = inst->next;
@@ -660,6 +730,25 @@ static int run_func_peephole_passes(lr_func_t *f, lr_arena_t *a) {
                     inst->op = LR_OP_BR;
                     inst->num_operands = 1;
                     inst->operands[0] = target;
+                    lr_func_invalidate_cfg(f);
+                    iter_changed = true;
+                }
+
+                if (inst->op == LR_OP_SWITCH &&
+                    inst->num_operands >= 2 &&
+                    inst->operands[0].kind == LR_VAL_IMM_I64) {
+                    lr_operand_t target = inst->operands[1];
+                    for (uint32_t ci = 2; ci + 1 < inst->num_operands; ci += 2) {
+                        if (switch_case_matches(&inst->operands[0],
+                                                &inst->operands[ci])) {
+                            target = inst->operands[ci + 1];
+                            break;
+                        }
+                    }
+                    inst->op = LR_OP_BR;
+                    inst->num_operands = 1;
+                    inst->operands[0] = target;
+                    lr_func_invalidate_cfg(f);
                     iter_changed = true;
                 }
 
@@ -668,7 +757,11 @@ static int run_func_peephole_passes(lr_func_t *f, lr_arena_t *a) {
                 } else if (inst->op == LR_OP_LOAD &&
                            inst->num_operands >= 1 &&
                            inst_defines_dest(inst)) {
-                    for (uint32_t li = 0; li < load_count; li++) {
+                    uint32_t h = hash_mix(operand_hash(&inst->operands[0]),
+                                          (uint64_t)(uintptr_t)inst->type);
+                    uint32_t li = h & (load_cap - 1u);
+                    for (; load_cache[li].epoch == load_epoch;
+                         li = (li + 1u) & (load_cap - 1u)) {
                         if (load_cache[li].load_type == inst->type &&
                             operand_equal(&load_cache[li].ptr, &inst->operands[0])) {
                             replacement = lr_op_vreg(load_cache[li].value_vreg, inst->type);
@@ -676,17 +769,17 @@ static int run_func_peephole_passes(lr_func_t *f, lr_arena_t *a) {
                             break;
                         }
                     }
-                    if (!remove_inst && load_count < nrepl) {
-                        load_cache[load_count].ptr = inst->operands[0];
-                        load_cache[load_count].load_type = inst->type;
-                        load_cache[load_count].value_vreg = inst->dest;
-                        load_count++;
+                    if (!remove_inst) {
+                        load_cache[li].ptr = inst->operands[0];
+                        load_cache[li].load_type = inst->type;
+                        load_cache[li].value_vreg = inst->dest;
+                        load_cache[li].epoch = load_epoch;
                     }
                 }
 
                 if (!remove_inst &&
                     (inst->op == LR_OP_STORE || inst->op == LR_OP_CALL))
-                    load_count = 0;
+                    load_epoch++;
 
                 if (remove_inst && inst_defines_dest(inst) && inst->dest < nrepl) {
                     if (!(replacement.kind == LR_VAL_VREG &&
@@ -777,19 +870,1426 @@ static int run_func_peephole_passes(lr_func_t *f, lr_arena_t *a) {
                     inst = next;
                     continue;
                 }
-                prev = inst;
+                prev = inst;
+                inst = next;
+            }
+            if (!b->first)
+                b->last = NULL;
+        }
+
+        if (!removed_any)
+            break;
+    }
+
+    (void)changed_any;
+    return 0;
+}
+
+/* ---- CFG analysis ---- */
+
+typedef struct cfg_frame {
+    uint32_t block;
+    uint32_t height;            /* walk-specific stack mark */
+    uint32_t next;              /* next successor / dominator-tree child */
+} cfg_frame_t;
+
+static uint32_t cfg_intersect(const lr_cfg_t *g, uint32_t x, uint32_t y) {
+    while (x != y) {
+        while (g->rpo_num[x] > g->rpo_num[y])
+            x = g->idom[x];
+        while (g->rpo_num[y] > g->rpo_num[x])
+            y = g->idom[y];
+    }
+    return x;
+}
+
+/* Prefix-sum counts[0..n] (count of i at i + 1) into offsets, returning
+   a cursor copy for filling. */
+static uint32_t *cfg_csr_offsets(lr_arena_t *a, uint32_t *off, uint32_t n) {
+    uint32_t *cursor = lr_arena_array_uninit(a, uint32_t, n + 1u);
+    if (!cursor)
+        return NULL;
+    for (uint32_t i = 0; i < n; i++)
+        off[i + 1u] += off[i];
+    memcpy(cursor, off, sizeof(uint32_t) * (n + 1u));
+    return cursor;
+}
+
+static int cfg_build_edges(const lr_func_t *f, lr_arena_t *a, lr_cfg_t *g,
+                           uint32_t *mark) {
+    uint32_t nb = g->num_blocks, nedges = 0, *cursor = NULL;
+
+    /* Successors: the block operands of each terminator. */
+    for (int pass = 0; pass < 2; pass++) {
+        memset(mark, 0, sizeof(uint32_t) * nb);
+        for (uint32_t bi = 0; bi < nb; bi++) {
+            const lr_block_t *b = f->block_array[bi];
+            const lr_inst_t *term = b ? b->last : NULL;
+            if (!term || (term->op != LR_OP_BR && term->op != LR_OP_CONDBR &&
+                          term->op != LR_OP_SWITCH))
+                continue;
+            for (uint32_t oi = 0; oi < term->num_operands; oi++) {
+                uint32_t t = term->operands[oi].block_id;
+                if (term->operands[oi].kind != LR_VAL_BLOCK || t >= nb ||
+                    !f->block_array[t] || mark[t] == bi + 1u)
+                    continue;
+                mark[t] = bi + 1u;
+                if (pass == 0) {
+                    g->succ_off[bi + 1u]++;
+                    g->pred_off[t + 1u]++;
+                    nedges++;
+                } else {
+                    g->succ[cursor[bi]++] = t;
+                }
+            }
+        }
+        if (pass == 0) {
+            g->succ = lr_arena_array(a, uint32_t, nedges + 1u);
+            g->pred = lr_arena_array(a, uint32_t, nedges + 1u);
+            cursor = cfg_csr_offsets(a, g->succ_off, nb);
+            if (!g->succ || !g->pred || !cursor)
+                return -1;
+        }
+    }
+    cursor = cfg_csr_offsets(a, g->pred_off, nb);
+    if (!cursor)
+        return -1;
+    for (uint32_t bi = 0; bi < nb; bi++) {
+        for (uint32_t e = g->succ_off[bi]; e < g->succ_off[bi + 1u]; e++)
+            g->pred[cursor[g->succ[e]]++] = bi;
+    }
+    return 0;
+}
+
+static void cfg_build_rpo(lr_cfg_t *g, uint32_t entry, cfg_frame_t *stack) {
+    uint32_t depth = 0, npost = 0;
+
+    memset(g->rpo_num, 0xFF, sizeof(uint32_t) * g->num_blocks);
+    g->rpo_num[entry] = 0;
+    stack[depth++] = (cfg_frame_t){ entry, 0, g->succ_off[entry] };
+    while (depth > 0) {
+        cfg_frame_t *fr = &stack[depth - 1u];
+        if (fr->next < g->succ_off[fr->block + 1u]) {
+            uint32_t t = g->succ[fr->next++];
+            if (g->rpo_num[t] == UINT32_MAX) {
+                g->rpo_num[t] = 0;
+                stack[depth++] = (cfg_frame_t){ t, 0, g->succ_off[t] };
+            }
+            continue;
+        }
+        g->rpo[npost++] = fr->block;
+        depth--;
+    }
+    g->num_rpo = npost;
+    for (uint32_t i = 0; i < npost / 2u; i++) {
+        uint32_t tmp = g->rpo[i];
+        g->rpo[i] = g->rpo[npost - 1u - i];
+        g->rpo[npost - 1u - i] = tmp;
+    }
+    for (uint32_t i = 0; i < npost; i++)
+        g->rpo_num[g->rpo[i]] = i;
+}
+
+static int cfg_build_dominators(lr_cfg_t *g, lr_arena_t *a, uint32_t entry,
+                                uint32_t *mark, cfg_frame_t *stack) {
+    uint32_t nb = g->num_blocks, *cursor, depth = 0, tick = 0;
+    bool changed = true;
+
+    /* Immediate dominators (Cooper, Harvey and Kennedy). */
+    memset(g->idom, 0xFF, sizeof(uint32_t) * nb);
+    g->idom[entry] = entry;
+    while (changed) {
+        changed = false;
+        for (uint32_t i = 1; i < g->num_rpo; i++) {
+            uint32_t b = g->rpo[i], nd = UINT32_MAX;
+            for (uint32_t e = g->pred_off[b]; e < g->pred_off[b + 1u]; e++) {
+                uint32_t p = g->pred[e];
+                if (g->idom[p] == UINT32_MAX)
+                    continue;
+                nd = nd == UINT32_MAX ? p : cfg_intersect(g, p, nd);
+            }
+            if (nd != g->idom[b]) {
+                g->idom[b] = nd;
+                changed = true;
+            }
+        }
+    }
+
+    /* Dominance frontiers: walk up from each predecessor of a join. */
+    cursor = NULL;
+    for (int pass = 0; pass < 2; pass++) {
+        memset(mark, 0, sizeof(uint32_t) * nb);
+        for (uint32_t i = 0; i < g->num_rpo; i++) {
+            uint32_t b = g->rpo[i], joins = 0;
+            for (uint32_t e = g->pred_off[b]; e < g->pred_off[b + 1u]; e++)
+                joins += g->rpo_num[g->pred[e]] != UINT32_MAX ? 1u : 0u;
+            if (joins < 2)
+                continue;
+            for (uint32_t e = g->pred_off[b]; e < g->pred_off[b + 1u]; e++) {
+                uint32_t r = g->pred[e];
+                if (g->rpo_num[r] == UINT32_MAX)
+                    continue;
+                while (r != g->idom[b] && mark[r] != b + 1u) {
+                    mark[r] = b + 1u;
+                    if (pass == 0)
+                        g->df_off[r + 1u]++;
+                    else
+                        g->df[cursor[r]++] = b;
+                    r = g->idom[r];
+                }
+            }
+        }
+        if (pass == 0) {
+            cursor = cfg_csr_offsets(a, g->df_off, nb);
+            g->df = lr_arena_array(a, uint32_t, g->df_off[nb] + 1u);
+            if (!cursor || !g->df)
+                return -1;
+        }
+    }
+
+    /* Dominator-tree children, then pre/post numbers for O(1)
+       dominance queries. */
+    for (uint32_t i = 1; i < g->num_rpo; i++)
+        g->child_off[g->idom[g->rpo[i]] + 1u]++;
+    cursor = cfg_csr_offsets(a, g->child_off, nb);
+    g->child = lr_arena_array(a, uint32_t, nb);
+    if (!cursor || !g->child)
+        return -1;
+    for (uint32_t i = 1; i < g->num_rpo; i++)
+        g->child[cursor[g->idom[g->rpo[i]]]++] = g->rpo[i];
+
+    memset(g->dom_pre, 0xFF, sizeof(uint32_t) * nb);
+    memset(g->dom_post, 0xFF, sizeof(uint32_t) * nb);
+    g->dom_pre[entry] = tick++;
+    stack[depth++] = (cfg_frame_t){ entry, 0, g->child_off[entry] };
+    while (depth > 0) {
+        cfg_frame_t *fr = &stack[depth - 1u];
+        if (fr->next < g->child_off[fr->block + 1u]) {
+            uint32_t c = g->child[fr->next++];
+            g->dom_pre[c] = tick++;
+            stack[depth++] = (cfg_frame_t){ c, 0, g->child_off[c] };
+            continue;
+        }
+        g->dom_post[fr->block] = tick++;
+        depth--;
+    }
+    return 0;
+}
+
+/* Natural loops: a back edge t -> h with h dominating t.  Headers are
+   visited in RPO, so an enclosing loop is walked before the loops it
+   contains and the innermost header is the last to claim a block. */
+static void cfg_build_loops(lr_cfg_t *g, uint32_t *mark, uint32_t *work) {
+    uint32_t nb = g->num_blocks;
+
+    memset(g->loop_header, 0xFF, sizeof(uint32_t) * nb);
+    memset(g->loop_parent, 0xFF, sizeof(uint32_t) * nb);
+    memset(mark, 0, sizeof(uint32_t) * nb);
+    for (uint32_t i = 0; i < g->num_rpo; i++) {
+        uint32_t h = g->rpo[i], nwork = 0;
+        for (uint32_t e = g->pred_off[h]; e < g->pred_off[h + 1u]; e++) {
+            uint32_t t = g->pred[e];
+            if (lr_cfg_dominates(g, h, t) && mark[t] != h + 1u) {
+                mark[t] = h + 1u;
+                work[nwork++] = t;
+            }
+        }
+        if (nwork == 0)
+            continue;
+        g->num_loops++;
+        g->loop_parent[h] = g->loop_header[h];
+        g->loop_header[h] = h;
+        g->loop_depth[h]++;
+        mark[h] = h + 1u;
+        while (nwork > 0) {
+            uint32_t b = work[--nwork];
+            if (b == h)
+                continue;
+            g->loop_header[b] = h;
+            g->loop_depth[b]++;
+            for (uint32_t e = g->pred_off[b]; e < g->pred_off[b + 1u]; e++) {
+                uint32_t p = g->pred[e];
+                if (g->rpo_num[p] != UINT32_MAX && mark[p] != h + 1u) {
+                    mark[p] = h + 1u;
+                    work[nwork++] = p;
+                }
+            }
+        }
+    }
+}
+
+static lr_cfg_t *cfg_build(const lr_func_t *f, lr_arena_t *a) {
+    uint32_t nb, entry, *mark, *work;
+    cfg_frame_t *stack;
+    lr_cfg_t *g;
+
+    if (!f || !a || f->num_blocks == 0 || !f->block_array ||
+        !f->first_block || f->first_block->id >= f->num_blocks)
+        return NULL;
+    nb = f->num_blocks;
+    entry = f->first_block->id;
+
+    g = lr_arena_new(a, lr_cfg_t);
+    if (!g)
+        return NULL;
+    g->num_blocks = nb;
+    g->succ_off = lr_arena_array(a, uint32_t, nb + 1u);
+    g->pred_off = lr_arena_array(a, uint32_t, nb + 1u);
+    g->df_off = lr_arena_array(a, uint32_t, nb + 1u);
+    g->child_off = lr_arena_array(a, uint32_t, nb + 1u);
+    g->rpo = lr_arena_array(a, uint32_t, nb);
+    g->rpo_num = lr_arena_array_uninit(a, uint32_t, nb);
+    g->idom = lr_arena_array_uninit(a, uint32_t, nb);
+    g->dom_pre = lr_arena_array_uninit(a, uint32_t, nb);
+    g->dom_post = lr_arena_array_uninit(a, uint32_t, nb);
+    g->loop_header = lr_arena_array_uninit(a, uint32_t, nb);
+    g->loop_parent = lr_arena_array_uninit(a, uint32_t, nb);
+    g->loop_depth = lr_arena_array(a, uint32_t, nb);
+    mark = lr_arena_array(a, uint32_t, nb);
+    work = lr_arena_array(a, uint32_t, nb);
+    stack = lr_arena_array(a, cfg_frame_t, nb);
+    if (!g->succ_off || !g->pred_off || !g->df_off || !g->child_off ||
+        !g->rpo || !g->rpo_num || !g->idom || !g->dom_pre ||
+        !g->dom_post || !g->loop_header || !g->loop_parent ||
+        !g->loop_depth || !mark || !work || !stack)
+        return NULL;
+
+    if (cfg_build_edges(f, a, g, mark) != 0)
+        return NULL;
+    cfg_build_rpo(g, entry, stack);
+    if (cfg_build_dominators(g, a, entry, mark, stack) != 0)
+        return NULL;
+    cfg_build_loops(g, mark, work);
+    return g;
+}
+
+const lr_cfg_t *lr_func_build_cfg(const lr_func_t *f, lr_arena_t *a) {
+    return cfg_build(f, a);
+}
+
+const lr_cfg_t *lr_func_cfg(lr_func_t *f, lr_arena_t *a) {
+    if (f && !f->cfg)
+        f->cfg = cfg_build(f, a);
+    return f ? f->cfg : NULL;
+}
+
+void lr_func_invalidate_cfg(lr_func_t *f) {
+    if (f)
+        f->cfg = NULL;
+}
+
+bool lr_cfg_dominates(const lr_cfg_t *g, uint32_t a, uint32_t b) {
+    if (!g || a >= g->num_blocks || b >= g->num_blocks ||
+        g->dom_pre[a] == UINT32_MAX || g->dom_pre[b] == UINT32_MAX)
+        return false;
+    return g->dom_pre[a] <= g->dom_pre[b] && g->dom_post[b] <= g->dom_post[a];
+}
+
+/* ---- Alloca promotion ---- */
+
+/* Scalar allocas whose address is only loaded from and stored to at
+   their own type become SSA values: phis go on the iterated dominance
+   frontier of the stores, pruned to blocks where the slot is live-in,
+   and a walk of the dominator tree renames each load to the value that
+   reaches it.  Reads with no store on some path see undef. */
+
+typedef struct promo_phi {
+    lr_inst_t *inst;
+    uint32_t slot;
+    struct promo_phi *next;     /* next inserted phi of the same block */
+} promo_phi_t;
+
+typedef struct promo_undo {
+    uint32_t slot;
+    lr_operand_t value;
+} promo_undo_t;
+
+/* On from opt_level 1; LIRIC_MEM2REG=0/1 overrides the module's level. */
+static bool mem2reg_enabled(const lr_module_t *m) {
+    static int cached = -2;
+    if (cached == -2) {
+        const char *env = getenv("LIRIC_MEM2REG");
+        cached = env ? strcmp(env, "0") != 0 : -1;
+    }
+    return cached < 0 ? m && m->opt_level > 0 : cached != 0;
+}
+
+static bool promotable_slot_type(const lr_type_t *t) {
+    if (!t)
+        return false;
+    switch (t->kind) {
+    case LR_TYPE_I1:
+    case LR_TYPE_I8:
+    case LR_TYPE_I16:
+    case LR_TYPE_I32:
+    case LR_TYPE_I64:
+    case LR_TYPE_FLOAT:
+    case LR_TYPE_DOUBLE:
+    case LR_TYPE_PTR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool lifetime_marker_call(const lr_func_t *f, const lr_inst_t *inst) {
+    const char *name;
+    if (inst->op != LR_OP_CALL || inst->num_operands == 0 ||
+        inst->operands[0].kind != LR_VAL_GLOBAL || !f->module)
+        return false;
+    name = lr_module_symbol_name(f->module, inst->operands[0].global_id);
+    return name && strncmp(name, "llvm.lifetime.", 14) == 0;
+}
+
+/* Slot index + 1 of the promoted alloca op names, or 0. */
+static uint32_t promo_slot_of(const uint32_t *slot_of, uint32_t nv,
+                              const lr_operand_t *op) {
+    if (op->kind != LR_VAL_VREG || op->vreg >= nv)
+        return 0;
+    return slot_of[op->vreg];
+}
+
+static lr_operand_t promo_undef(lr_type_t *type) {
+    lr_operand_t op;
+    memset(&op, 0, sizeof(op));
+    op.kind = LR_VAL_UNDEF;
+    op.type = type;
+    return op;
+}
+
+/* Remove the promoted loads, stores and lifetime markers of block b,
+   recording each load's value in repl.  cur tracks the slot values;
+   undo (may be NULL) receives the value each store overwrote. */
+static void promo_rewrite_block(const lr_func_t *f, lr_block_t *b,
+                                const uint32_t *slot_of, uint32_t nv,
+                                lr_operand_t *cur,
+                                lr_opt_replacement_t *repl,
+                                promo_undo_t *undo, uint32_t *nundo) {
+    lr_inst_t *prev = NULL;
+    for (lr_inst_t *inst = b->first; inst; ) {
+        lr_inst_t *next = inst->next;
+        uint32_t s = 0;
+        bool remove = false;
+        if (inst->op == LR_OP_LOAD && inst->num_operands >= 1 &&
+            (s = promo_slot_of(slot_of, nv, &inst->operands[0])) != 0) {
+            if (inst->dest < nv) {
+                repl[inst->dest].known = true;
+                repl[inst->dest].op = cur[s - 1u];
+            }
+            remove = true;
+        } else if (inst->op == LR_OP_STORE && inst->num_operands >= 2 &&
+                   (s = promo_slot_of(slot_of, nv, &inst->operands[1])) != 0) {
+            if (undo) {
+                undo[*nundo].slot = s - 1u;
+                undo[*nundo].value = cur[s - 1u];
+                (*nundo)++;
+            }
+            cur[s - 1u] = inst->operands[0];
+            remove = true;
+        } else if (lifetime_marker_call(f, inst)) {
+            for (uint32_t oi = 1; oi < inst->num_operands; oi++) {
+                if (promo_slot_of(slot_of, nv, &inst->operands[oi]) != 0)
+                    remove = true;
+            }
+        } else if (inst->op == LR_OP_ALLOCA && inst->dest < nv &&
+                   slot_of[inst->dest] != 0) {
+            remove = true;
+        }
+        if (remove) {
+            if (prev)
+                prev->next = next;
+            else
+                b->first = next;
+            if (b->last == inst)
+                b->last = prev;
+        } else {
+            prev = inst;
+        }
+        inst = next;
+    }
+}
+
+int lr_func_promote_allocas(lr_func_t *f, lr_arena_t *a) {
+    uint32_t nb, nv, nslots = 0, nstores = 0, nphis = 0, nundo = 0;
+    uint32_t *slot_of, *seen, *def_seen, *def_off, *defs, *use_off, *uses;
+    uint32_t *cursor = NULL, *work, *live, *visited, *def_mark;
+    lr_inst_t **slots;
+    lr_operand_t *cur;
+    lr_opt_replacement_t *repl;
+    promo_phi_t **phi_head;
+    promo_undo_t *undo;
+    cfg_frame_t *stack;
+    const lr_cfg_t *g;
+    uint32_t depth = 0;
+
+    if (!f || !a || f->num_blocks == 0 || !f->block_array ||
+        !f->first_block || f->first_block->id >= f->num_blocks ||
+        f->next_vreg == 0)
+        return 0;
+    nb = f->num_blocks;
+    nv = f->next_vreg;
+
+    /* Candidates: single-element scalar allocas in the entry block. */
+    slot_of = lr_arena_array(a, uint32_t, nv);
+    if (!slot_of)
+        return -1;
+    for (lr_inst_t *inst = f->first_block->first; inst; inst = inst->next) {
+        if (inst->op != LR_OP_ALLOCA || inst->dest >= nv ||
+            !promotable_slot_type(inst->type))
+            continue;
+        if (inst->num_operands > 1 ||
+            (inst->num_operands == 1 &&
+             !(inst->operands[0].kind == LR_VAL_IMM_I64 &&
+               inst->operands[0].imm_i64 == 1)))
+            continue;
+        slot_of[inst->dest] = ++nslots;
+    }
+    if (nslots == 0)
+        return 0;
+    slots = lr_arena_array(a, lr_inst_t *, nslots);
+    if (!slots)
+        return -1;
+    for (lr_inst_t *inst = f->first_block->first; inst; inst = inst->next) {
+        if (inst->op == LR_OP_ALLOCA && inst->dest < nv && slot_of[inst->dest])
+            slots[slot_of[inst->dest] - 1u] = inst;
+    }
+
+    /* Drop candidates whose address escapes or that are accessed at
+       another type. */
+    for (uint32_t bi = 0; bi < nb; bi++) {
+        lr_block_t *b = f->block_array[bi];
+        if (!b)
+            continue;
+        for (lr_inst_t *inst = b->first; inst; inst = inst->next) {
+            bool marker = lifetime_marker_call(f, inst);
+            for (uint32_t oi = 0; oi < inst->num_operands; oi++) {
+                uint32_t s = promo_slot_of(slot_of, nv, &inst->operands[oi]);
+                bool ok;
+                if (!s)
+                    continue;
+                if (inst->op == LR_OP_LOAD && oi == 0)
+                    ok = lr_type_same(inst->type, slots[s - 1u]->type);
+                else if (inst->op == LR_OP_STORE && oi == 1)
+                    ok = lr_type_same(inst->operands[0].type,
+                                      slots[s - 1u]->type);
+                else
+                    ok = marker && oi > 0;
+                if (!ok)
+                    slot_of[inst->operands[oi].vreg] = 0;
+            }
+        }
+    }
+    {
+        uint32_t kept = 0;
+        for (uint32_t s = 0; s < nslots; s++) {
+            if (slot_of[slots[s]->dest] != s + 1u)
+                continue;
+            slots[kept++] = slots[s];
+            slot_of[slots[s]->dest] = kept;
+        }
+        nslots = kept;
+    }
+    if (nslots == 0)
+        return 0;
+
+    if (!(g = lr_func_cfg(f, a)))
+        return -1;
+    /* A branch back to the entry block leaves no edge for the incoming
+       value of a phi there. */
+    if (g->pred_off[f->first_block->id + 1u] != g->pred_off[f->first_block->id])
+        return 0;
+
+    /* Per slot: blocks that store it, and blocks that read it before
+       any store of their own (upward-exposed uses). */
+    seen = lr_arena_array(a, uint32_t, nslots);
+    def_seen = lr_arena_array(a, uint32_t, nslots);
+    def_off = lr_arena_array(a, uint32_t, nslots + 1u);
+    use_off = lr_arena_array(a, uint32_t, nslots + 1u);
+    if (!seen || !def_seen || !def_off || !use_off)
+        return -1;
+    defs = uses = NULL;
+    for (int pass = 0; pass < 2; pass++) {
+        uint32_t *use_cursor = NULL;
+        if (pass == 1) {
+            cursor = cfg_csr_offsets(a, def_off, nslots);
+            use_cursor = cfg_csr_offsets(a, use_off, nslots);
+            defs = lr_arena_array(a, uint32_t, def_off[nslots] + 1u);
+            uses = lr_arena_array(a, uint32_t, use_off[nslots] + 1u);
+            if (!cursor || !use_cursor || !defs || !uses)
+                return -1;
+            memset(seen, 0, sizeof(uint32_t) * nslots);
+            memset(def_seen, 0, sizeof(uint32_t) * nslots);
+        }
+        for (uint32_t i = 0; i < g->num_rpo; i++) {
+            uint32_t bi = g->rpo[i];
+            for (lr_inst_t *inst = f->block_array[bi]->first; inst;
+                 inst = inst->next) {
+                uint32_t s = 0;
+                bool is_store = false;
+                if (inst->op == LR_OP_LOAD && inst->num_operands >= 1)
+                    s = promo_slot_of(slot_of, nv, &inst->operands[0]);
+                else if (inst->op == LR_OP_STORE && inst->num_operands >= 2)
+                    is_store = (s = promo_slot_of(slot_of, nv,
+                                                  &inst->operands[1])) != 0;
+                if (!s)
+                    continue;
+                s--;
+                if (seen[s] != bi + 1u) {
+                    seen[s] = bi + 1u;
+                    if (!is_store) {
+                        if (pass == 0)
+                            use_off[s + 1u]++;
+                        else
+                            uses[use_cursor[s]++] = bi;
+                    }
+                }
+                if (is_store) {
+                    if (pass == 0)
+                        nstores++;
+                    if (def_seen[s] != bi + 1u) {
+                        def_seen[s] = bi + 1u;
+                        if (pass == 0)
+                            def_off[s + 1u]++;
+                        else
+                            defs[cursor[s]++] = bi;
+                    }
+                }
+            }
+        }
+    }
+
+    /* Pruned phi placement. */
+    work = lr_arena_array(a, uint32_t, nb);
+    live = lr_arena_array(a, uint32_t, nb);
+    visited = lr_arena_array(a, uint32_t, nb);
+    def_mark = lr_arena_array(a, uint32_t, nb);
+    phi_head = lr_arena_array(a, promo_phi_t *, nb);
+    if (!work || !live || !visited || !def_mark || !phi_head)
+        return -1;
+    for (uint32_t s = 0; s < nslots; s++) {
+        uint32_t tag = s + 1u, nwork = 0;
+        for (uint32_t d = def_off[s]; d < def_off[s + 1u]; d++)
+            def_mark[defs[d]] = tag;
+        for (uint32_t u = use_off[s]; u < use_off[s + 1u]; u++) {
+            live[uses[u]] = tag;
+            work[nwork++] = uses[u];
+        }
+        while (nwork > 0) {
+            uint32_t b = work[--nwork];
+            for (uint32_t e = g->pred_off[b]; e < g->pred_off[b + 1u]; e++) {
+                uint32_t p = g->pred[e];
+                if (g->rpo_num[p] == UINT32_MAX || live[p] == tag ||
+                    def_mark[p] == tag)
+                    continue;
+                live[p] = tag;
+                work[nwork++] = p;
+            }
+        }
+        for (uint32_t d = def_off[s]; d < def_off[s + 1u]; d++)
+            work[nwork++] = defs[d];
+        while (nwork > 0) {
+            uint32_t x = work[--nwork];
+            for (uint32_t e = g->df_off[x]; e < g->df_off[x + 1u]; e++) {
+                uint32_t y = g->df[e];
+                lr_block_t *yb = f->block_array[y];
+                uint32_t npreds = g->pred_off[y + 1u] - g->pred_off[y];
+                lr_operand_t *ops;
+                promo_phi_t *phi;
+                if (visited[y] == tag || live[y] != tag)
+                    continue;
+                visited[y] = tag;
+                ops = lr_arena_array(a, lr_operand_t, npreds * 2u);
+                phi = lr_arena_new(a, promo_phi_t);
+                if (!ops || !phi)
+                    return -1;
+                for (uint32_t pi = 0; pi < npreds; pi++) {
+                    ops[pi * 2u] = promo_undef(slots[s]->type);
+                    ops[pi * 2u + 1u] = lr_op_block(g->pred[g->pred_off[y] + pi]);
+                }
+                phi->inst = lr_inst_create(a, LR_OP_PHI, slots[s]->type,
+                                           lr_vreg_new(f), ops, npreds * 2u);
+                if (!phi->inst)
+                    return -1;
+                phi->inst->next = yb->first;
+                yb->first = phi->inst;
+                if (!yb->last)
+                    yb->last = phi->inst;
+                phi->slot = s;
+                phi->next = phi_head[y];
+                phi_head[y] = phi;
+                nphis++;
+                if (def_mark[y] != tag)
+                    work[nwork++] = y;
+            }
+        }
+    }
+
+    /* Rename along the dominator tree. */
+    cur = lr_arena_array(a, lr_operand_t, nslots);
+    repl = lr_arena_array(a, lr_opt_replacement_t, nv);
+    undo = lr_arena_array(a, promo_undo_t, nstores + nphis + 1u);
+    stack = lr_arena_array(a, cfg_frame_t, nb);
+    if (!cur || !repl || !undo || !stack)
+        return -1;
+    for (uint32_t s = 0; s < nslots; s++)
+        cur[s] = promo_undef(slots[s]->type);
+    stack[depth++] = (cfg_frame_t){ f->first_block->id, 0, UINT32_MAX };
+    while (depth > 0) {
+        cfg_frame_t *fr = &stack[depth - 1u];
+        uint32_t b = fr->block;
+        if (fr->next == UINT32_MAX) {
+            fr->height = nundo;
+            for (promo_phi_t *phi = phi_head[b]; phi; phi = phi->next) {
+                undo[nundo].slot = phi->slot;
+                undo[nundo].value = cur[phi->slot];
+                nundo++;
+                cur[phi->slot] = lr_op_vreg(phi->inst->dest, phi->inst->type);
+            }
+            promo_rewrite_block(f, f->block_array[b], slot_of, nv, cur, repl,
+                                undo, &nundo);
+            for (uint32_t e = g->succ_off[b]; e < g->succ_off[b + 1u]; e++) {
+                for (promo_phi_t *phi = phi_head[g->succ[e]]; phi;
+                     phi = phi->next) {
+                    lr_inst_t *pi = phi->inst;
+                    for (uint32_t oi = 0; oi + 1u < pi->num_operands; oi += 2u) {
+                        if (pi->operands[oi + 1u].block_id == b)
+                            pi->operands[oi] = cur[phi->slot];
+                    }
+                }
+            }
+            fr->next = g->child_off[b];
+        }
+        if (fr->next < g->child_off[b + 1u]) {
+            uint32_t c = g->child[fr->next++];
+            stack[depth++] = (cfg_frame_t){ c, 0, UINT32_MAX };
+            continue;
+        }
+        while (nundo > fr->height) {
+            nundo--;
+            cur[undo[nundo].slot] = undo[nundo].value;
+        }
+        depth--;
+    }
+
+    /* Unreachable blocks only read undef. */
+    for (uint32_t bi = 0; bi < nb; bi++) {
+        if (!f->block_array[bi] || g->rpo_num[bi] != UINT32_MAX)
+            continue;
+        for (uint32_t s = 0; s < nslots; s++)
+            cur[s] = promo_undef(slots[s]->type);
+        promo_rewrite_block(f, f->block_array[bi], slot_of, nv, cur, repl,
+                            NULL, NULL);
+    }
+
+    for (uint32_t bi = 0; bi < nb; bi++) {
+        lr_block_t *b = f->block_array[bi];
+        if (!b)
+            continue;
+        for (lr_inst_t *inst = b->first; inst; inst = inst->next) {
+            for (uint32_t oi = 0; oi < inst->num_operands; oi++)
+                operand_resolve(repl, nv, &inst->operands[oi]);
+        }
+    }
+    return (int)nslots;
+}
+
+/* ---- Value numbering ---- */
+
+/* A pure instruction whose opcode, types, operands and predicate or
+   indices match one in a dominating position computes the same value.
+   The table is scoped to the dominator tree: entries are chained per
+   bucket and popped, LIFO, when the walk leaves the block that added
+   them. */
+
+typedef struct gvn_entry {
+    const lr_inst_t *inst;
+    uint32_t hash;
+    uint32_t shadowed;          /* previous bucket head, index + 1 */
+} gvn_entry_t;
+
+/* On from opt_level 1; LIRIC_GVN=0/1 overrides the module's level. */
+static bool gvn_enabled(const lr_module_t *m) {
+    static int cached = -2;
+    if (cached == -2) {
+        const char *env = getenv("LIRIC_GVN");
+        cached = env ? strcmp(env, "0") != 0 : -1;
+    }
+    return cached < 0 ? m && m->opt_level > 0 : cached != 0;
+}
+
+static bool gvn_commutative(lr_opcode_t op) {
+    switch (op) {
+    case LR_OP_ADD:
+    case LR_OP_MUL:
+    case LR_OP_AND:
+    case LR_OP_OR:
+    case LR_OP_XOR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool gvn_candidate(const lr_inst_t *inst) {
+    switch (inst->op) {
+    case LR_OP_ADD: case LR_OP_SUB: case LR_OP_MUL:
+    case LR_OP_SDIV: case LR_OP_SREM: case LR_OP_UDIV: case LR_OP_UREM:
+    case LR_OP_AND: case LR_OP_OR: case LR_OP_XOR:
+    case LR_OP_SHL: case LR_OP_LSHR: case LR_OP_ASHR:
+    case LR_OP_FADD: case LR_OP_FSUB: case LR_OP_FMUL: case LR_OP_FDIV:
+    case LR_OP_FREM: case LR_OP_FNEG:
+    case LR_OP_ICMP: case LR_OP_FCMP: case LR_OP_SELECT:
+    case LR_OP_SEXT: case LR_OP_ZEXT: case LR_OP_TRUNC:
+    case LR_OP_BITCAST: case LR_OP_PTRTOINT: case LR_OP_INTTOPTR:
+    case LR_OP_SITOFP: case LR_OP_UITOFP: case LR_OP_FPTOSI:
+    case LR_OP_FPTOUI: case LR_OP_FPEXT: case LR_OP_FPTRUNC:
+        return inst->type && inst->type->kind != LR_TYPE_ARRAY &&
+               inst->type->kind != LR_TYPE_STRUCT;
+    case LR_OP_GEP:
+        /* inst->type is the source element type; the result is a ptr. */
+        return inst->num_operands >= 1;
+    default:
+        return false;
+    }
+}
+
+/* Structural where lr_type_same is: vector and array types are not
+   interned. */
+static uint32_t gvn_type_hash(const lr_type_t *t) {
+    if (t && (t->kind == LR_TYPE_VECTOR || t->kind == LR_TYPE_ARRAY))
+        return hash_mix(hash_mix(gvn_type_hash(t->array.elem), t->kind),
+                        t->array.count);
+    return hash_mix(0, (uint64_t)(uintptr_t)t);
+}
+
+static uint32_t gvn_operand_hash(const lr_operand_t *op) {
+    lr_operand_t o = *op;
+    o.type = NULL;
+    return hash_mix(operand_hash(&o), gvn_type_hash(op->type));
+}
+
+static bool gvn_operand_equal(const lr_operand_t *x, const lr_operand_t *y) {
+    lr_operand_t o;
+    if (!lr_type_same(x->type, y->type))
+        return false;
+    o = *y;
+    o.type = x->type;
+    return operand_equal(x, &o);
+}
+
+static uint32_t gvn_hash(const lr_inst_t *inst) {
+    uint32_t h = hash_mix(2166136261u, (uint64_t)inst->op);
+    uint32_t oh = 0;
+    h = hash_mix(h, gvn_type_hash(inst->type));
+    h = hash_mix(h, inst->num_operands);
+    if (inst->op == LR_OP_ICMP)
+        h = hash_mix(h, (uint64_t)inst->icmp_pred);
+    else if (inst->op == LR_OP_FCMP)
+        h = hash_mix(h, (uint64_t)inst->fcmp_pred);
+    /* Order-insensitive for commutative ops. */
+    for (uint32_t oi = 0; oi < inst->num_operands; oi++) {
+        uint32_t v = gvn_operand_hash(&inst->operands[oi]);
+        oh = gvn_commutative(inst->op) ? oh + v : hash_mix(oh, v);
+    }
+    return hash_mix(h, oh);
+}
+
+static bool gvn_equal(const lr_inst_t *x, const lr_inst_t *y) {
+    const lr_operand_t *xo = x->operands, *yo = y->operands;
+    if (x->op != y->op || !lr_type_same(x->type, y->type) ||
+        x->num_operands != y->num_operands)
+        return false;
+    if (x->op == LR_OP_ICMP && x->icmp_pred != y->icmp_pred)
+        return false;
+    if (x->op == LR_OP_FCMP && x->fcmp_pred != y->fcmp_pred)
+        return false;
+    if (gvn_commutative(x->op) && x->num_operands == 2 &&
+        gvn_operand_equal(&xo[0], &yo[1]) &&
+        gvn_operand_equal(&xo[1], &yo[0]))
+        return true;
+    for (uint32_t oi = 0; oi < x->num_operands; oi++) {
+        if (!gvn_operand_equal(&xo[oi], &yo[oi]))
+            return false;
+    }
+    return true;
+}
+
+/* Point vreg uses at their leader, keeping the use's own operand type
+   (a GEP's inst->type is not its result type). */
+static void gvn_rename(const uint32_t *leader, uint32_t nv, lr_inst_t *inst) {
+    for (uint32_t oi = 0; oi < inst->num_operands; oi++) {
+        lr_operand_t *op = &inst->operands[oi];
+        if (op->kind == LR_VAL_VREG && op->vreg < nv && leader[op->vreg])
+            op->vreg = leader[op->vreg] - 1u;
+    }
+}
+
+/* A vreg written more than once (ndefs saturates at 2) holds different
+   values at different points, so neither it nor anything computed from
+   it may be numbered. */
+static bool gvn_single_defs(const lr_inst_t *inst, const uint8_t *ndefs,
+                            uint32_t nv) {
+    if (inst->dest >= nv || ndefs[inst->dest] > 1)
+        return false;
+    for (uint32_t oi = 0; oi < inst->num_operands; oi++) {
+        const lr_operand_t *op = &inst->operands[oi];
+        if (op->kind == LR_VAL_VREG && op->vreg < nv && ndefs[op->vreg] > 1)
+            return false;
+    }
+    return true;
+}
+
+/* Number the pure instructions of block b, unlinking those a
+   dominating entry already computes. */
+static uint32_t gvn_block(lr_block_t *b, uint32_t *leader, uint32_t nv,
+                          const uint8_t *ndefs, uint32_t *bucket,
+                          uint32_t mask, gvn_entry_t *entries,
+                          uint32_t *nentries) {
+    uint32_t removed = 0;
+    lr_inst_t *prev = NULL;
+
+    for (lr_inst_t *inst = b->first; inst; ) {
+        lr_inst_t *next = inst->next;
+        uint32_t h, e;
+
+        if (inst->op != LR_OP_PHI)
+            gvn_rename(leader, nv, inst);
+        if (!gvn_candidate(inst) || !gvn_single_defs(inst, ndefs, nv)) {
+            prev = inst;
+            inst = next;
+            continue;
+        }
+        h = gvn_hash(inst);
+        for (e = bucket[h & mask]; e; e = entries[e - 1u].shadowed) {
+            if (entries[e - 1u].hash == h &&
+                gvn_equal(entries[e - 1u].inst, inst))
+                break;
+        }
+        if (e) {
+            leader[inst->dest] = entries[e - 1u].inst->dest + 1u;
+            if (prev)
+                prev->next = next;
+            else
+                b->first = next;
+            if (b->last == inst)
+                b->last = prev;
+            removed++;
+        } else {
+            entries[*nentries] = (gvn_entry_t){ inst, h, bucket[h & mask] };
+            bucket[h & mask] = ++*nentries;
+            prev = inst;
+        }
+        inst = next;
+    }
+    return removed;
+}
+
+int lr_func_value_number(lr_func_t *f, lr_arena_t *a) {
+    uint32_t nb, nv, ninsts = 0, cap = 16, nentries = 0, removed = 0;
+    uint32_t *leader, *bucket;
+    uint8_t *ndefs;
+    gvn_entry_t *entries;
+    cfg_frame_t *stack;
+    const lr_cfg_t *g;
+    uint32_t depth = 0;
+
+    if (!f || !a || f->num_blocks == 0 || !f->block_array ||
+        !f->first_block || f->first_block->id >= f->num_blocks ||
+        f->next_vreg == 0)
+        return 0;
+    nb = f->num_blocks;
+    nv = f->next_vreg;
+    ndefs = lr_arena_array(a, uint8_t, nv);
+    if (!ndefs)
+        return -1;
+    for (uint32_t bi = 0; bi < nb; bi++) {
+        const lr_block_t *b = f->block_array[bi];
+        for (const lr_inst_t *inst = b ? b->first : NULL; inst;
+             inst = inst->next) {
+            ninsts += gvn_candidate(inst) ? 1u : 0u;
+            if (inst_defines_dest(inst) && inst->dest < nv &&
+                ndefs[inst->dest] < 2)
+                ndefs[inst->dest]++;
+        }
+    }
+    if (ninsts < 2)
+        return 0;
+    while (cap < ninsts * 2u)
+        cap <<= 1;
+    leader = lr_arena_array(a, uint32_t, nv);
+    bucket = lr_arena_array(a, uint32_t, cap);
+    entries = lr_arena_array_uninit(a, gvn_entry_t, ninsts);
+    if (!leader || !bucket || !entries)
+        return -1;
+
+    if (nb == 1) {
+        removed = gvn_block(f->first_block, leader, nv, ndefs, bucket,
+                            cap - 1u, entries, &nentries);
+    } else {
+        if (!(g = lr_func_cfg(f, a)))
+            return -1;
+        stack = lr_arena_array(a, cfg_frame_t, g->num_rpo);
+        if (!stack)
+            return -1;
+        stack[depth++] = (cfg_frame_t){ f->first_block->id, 0, UINT32_MAX };
+        while (depth > 0) {
+            cfg_frame_t *fr = &stack[depth - 1u];
+            uint32_t b = fr->block;
+            if (fr->next == UINT32_MAX) {
+                fr->height = nentries;
+                removed += gvn_block(f->block_array[b], leader, nv, ndefs,
+                                     bucket, cap - 1u, entries, &nentries);
+                fr->next = g->child_off[b];
+            }
+            if (fr->next < g->child_off[b + 1u]) {
+                uint32_t c = g->child[fr->next++];
+                stack[depth++] = (cfg_frame_t){ c, 0, UINT32_MAX };
+                continue;
+            }
+            while (nentries > fr->height) {
+                gvn_entry_t *e = &entries[--nentries];
+                bucket[e->hash & (cap - 1u)] = e->shadowed;
+            }
+            depth--;
+        }
+    }
+    if (removed == 0)
+        return 0;
+
+    /* Phis and unreachable blocks were skipped by the walk. */
+    for (uint32_t bi = 0; bi < nb; bi++) {
+        lr_block_t *b = f->block_array[bi];
+        for (lr_inst_t *inst = b ? b->first : NULL; inst; inst = inst->next)
+            gvn_rename(leader, nv, inst);
+    }
+    return (int)removed;
+}
+
+/* ---- Loop optimization ---- */
+
+/* Loops with a preheader (the header's only predecessor outside the
+   loop, ending in a branch to it) get two rewrites, innermost first:
+   instructions whose operands are all defined outside the loop move to
+   the preheader, and `mul %iv, c` of a basic induction variable becomes
+   a second induction variable stepped by an add.  Pure instructions that
+   cannot trap are always safe to hoist.  A load also needs a loop free
+   of stores and calls, and must sit in a block that dominates every
+   exit of the loop so that it already ran on every path out of it. */
+
+#define LOOP_DEF_MULTI (UINT32_MAX - 1u)
+
+typedef struct loop_ctx {
+    lr_func_t *f;
+    lr_arena_t *a;
+    const lr_cfg_t *g;
+    uint32_t cap;               /* vreg capacity of the maps below */
+    uint32_t *def_block;        /* UINT32_MAX: parameter or unknown,
+                                   LOOP_DEF_MULTI: written more than once */
+    lr_inst_t **def_inst;
+    uint32_t *leader;           /* index + 1 of the replacing vreg */
+    lr_inst_t **pre_tail;       /* last instruction before the terminator */
+} loop_ctx_t;
+
+static int loop_track(loop_ctx_t *lc, uint32_t v, uint32_t block,
+                      lr_inst_t *inst) {
+    if (v >= lc->cap) {
+        uint32_t cap = lc->cap * 2u > v ? lc->cap * 2u : v + 1u;
+        uint32_t *db = lr_arena_array_uninit(lc->a, uint32_t, cap);
+        lr_inst_t **di = lr_arena_array(lc->a, lr_inst_t *, cap);
+        uint32_t *ld = lr_arena_array(lc->a, uint32_t, cap);
+        if (!db || !di || !ld)
+            return -1;
+        memcpy(db, lc->def_block, sizeof(uint32_t) * lc->cap);
+        memset(db + lc->cap, 0xFF, sizeof(uint32_t) * (cap - lc->cap));
+        memcpy(di, lc->def_inst, sizeof(lr_inst_t *) * lc->cap);
+        memcpy(ld, lc->leader, sizeof(uint32_t) * lc->cap);
+        lc->def_block = db;
+        lc->def_inst = di;
+        lc->leader = ld;
+        lc->cap = cap;
+    }
+    lc->def_block[v] = block;
+    lc->def_inst[v] = inst;
+    return 0;
+}
+
+static bool loop_contains(const lr_cfg_t *g, uint32_t h, uint32_t b) {
+    for (uint32_t x = g->loop_header[b]; x != UINT32_MAX;
+         x = g->loop_parent[x]) {
+        if (x == h)
+            return true;
+    }
+    return false;
+}
+
+static bool loop_invariant_operand(const loop_ctx_t *lc, uint32_t h,
+                                   const lr_operand_t *op) {
+    uint32_t db;
+    if (op->kind != LR_VAL_VREG)
+        return op->kind != LR_VAL_BLOCK;
+    db = op->vreg < lc->cap ? lc->def_block[op->vreg] : UINT32_MAX;
+    if (db == LOOP_DEF_MULTI)
+        return false;
+    return db == UINT32_MAX || !loop_contains(lc->g, h, db);
+}
+
+static uint32_t loop_preheader(const lr_func_t *f, const lr_cfg_t *g,
+                               uint32_t h) {
+    uint32_t pre = UINT32_MAX;
+    const lr_inst_t *term;
+    for (uint32_t e = g->pred_off[h]; e < g->pred_off[h + 1u]; e++) {
+        uint32_t p = g->pred[e];
+        if (loop_contains(g, h, p))
+            continue;
+        if (pre != UINT32_MAX)
+            return UINT32_MAX;
+        pre = p;
+    }
+    if (pre == UINT32_MAX || g->rpo_num[pre] == UINT32_MAX)
+        return UINT32_MAX;
+    term = f->block_array[pre]->last;
+    if (!term || term->op != LR_OP_BR)
+        return UINT32_MAX;
+    return pre;
+}
+
+/* Append inst to the preheader, ahead of its branch. */
+static void loop_emit_in_preheader(loop_ctx_t *lc, uint32_t pre,
+                                   lr_inst_t *inst) {
+    lr_block_t *pb = lc->f->block_array[pre];
+    lr_inst_t *term = pb->last;
+    inst->next = term;
+    if (!lc->pre_tail[pre] && pb->first != term) {
+        lr_inst_t *it = pb->first;
+        while (it->next != term)
+            it = it->next;
+        lc->pre_tail[pre] = it;
+    }
+    if (lc->pre_tail[pre])
+        lc->pre_tail[pre]->next = inst;
+    else
+        pb->first = inst;
+    lc->pre_tail[pre] = inst;
+}
+
+static void loop_unlink(loop_ctx_t *lc, uint32_t b, lr_inst_t *prev,
+                        lr_inst_t *inst) {
+    lr_block_t *blk = lc->f->block_array[b];
+    if (prev)
+        prev->next = inst->next;
+    else
+        blk->first = inst->next;
+    if (blk->last == inst)
+        blk->last = prev;
+    if (lc->pre_tail[b] == inst)
+        lc->pre_tail[b] = prev;
+}
+
+static bool loop_speculatable(const lr_inst_t *inst) {
+    const lr_operand_t *d;
+    switch (inst->op) {
+    case LR_OP_SDIV:
+    case LR_OP_SREM:
+    case LR_OP_UDIV:
+    case LR_OP_UREM:
+        d = &inst->operands[1];
+        return d->kind == LR_VAL_IMM_I64 &&
+               int_to_unsigned_bits(d->imm_i64,
+                                    int_type_width_bits(inst->type)) != 0 &&
+               !((inst->op == LR_OP_SDIV || inst->op == LR_OP_SREM) &&
+                 int_sign_extend_bits(
+                     int_to_unsigned_bits(d->imm_i64,
+                                          int_type_width_bits(inst->type)),
+                     int_type_width_bits(inst->type)) == -1);
+    default:
+        return gvn_candidate(inst);
+    }
+}
+
+static uint32_t loop_hoist_invariants(loop_ctx_t *lc, uint32_t h,
+                                      uint32_t pre, uint32_t *exits) {
+    const lr_cfg_t *g = lc->g;
+    uint32_t nexits = 0, hoisted = 0;
+    bool writes = false;
+
+    for (uint32_t i = 0; i < g->num_rpo; i++) {
+        uint32_t b = g->rpo[i];
+        bool leaves;
+        if (!loop_contains(g, h, b))
+            continue;
+        /* Returns leave the loop too. */
+        leaves = g->succ_off[b] == g->succ_off[b + 1u];
+        for (uint32_t e = g->succ_off[b]; !leaves && e < g->succ_off[b + 1u];
+             e++)
+            leaves = !loop_contains(g, h, g->succ[e]);
+        if (leaves)
+            exits[nexits++] = b;
+        for (const lr_inst_t *inst = lc->f->block_array[b]->first; inst;
+             inst = inst->next)
+            writes |= inst->op == LR_OP_STORE || inst->op == LR_OP_CALL;
+    }
+
+    for (uint32_t i = 0; i < g->num_rpo; i++) {
+        uint32_t b = g->rpo[i];
+        lr_block_t *blk = lc->f->block_array[b];
+        bool runs_every_exit = b == h || nexits > 0;
+        lr_inst_t *prev = NULL;
+        if (!loop_contains(g, h, b))
+            continue;
+        for (uint32_t x = 0; x < nexits && runs_every_exit; x++)
+            runs_every_exit = lr_cfg_dominates(g, b, exits[x]);
+        for (lr_inst_t *inst = blk->first; inst; ) {
+            lr_inst_t *next = inst->next;
+            bool ok = inst->op == LR_OP_LOAD
+                ? !writes && runs_every_exit && inst->num_operands == 1 &&
+                  promotable_slot_type(inst->type)
+                : loop_speculatable(inst);
+            for (uint32_t oi = 0; ok && oi < inst->num_operands; oi++)
+                ok = loop_invariant_operand(lc, h, &inst->operands[oi]);
+            if (!ok || inst->dest >= lc->cap ||
+                lc->def_block[inst->dest] == LOOP_DEF_MULTI) {
+                prev = inst;
+                inst = next;
+                continue;
+            }
+            loop_unlink(lc, b, prev, inst);
+            loop_emit_in_preheader(lc, pre, inst);
+            lc->def_block[inst->dest] = pre;
+            hoisted++;
+            inst = next;
+        }
+    }
+    return hoisted;
+}
+
+/* x * y in the preheader, folded when either is 0 or 1 or both are
+   immediates. */
+static int loop_product(loop_ctx_t *lc, uint32_t pre, lr_type_t *type,
+                        const lr_operand_t *x, const lr_operand_t *y,
+                        lr_operand_t *out) {
+    lr_operand_t ops[2];
+    lr_inst_t *mul;
+    if (y->kind == LR_VAL_IMM_I64 &&
+        (y->imm_i64 == 0 || y->imm_i64 == 1)) {
+        const lr_operand_t *t = x;
+        x = y;
+        y = t;
+    }
+    if (x->kind == LR_VAL_IMM_I64 && x->imm_i64 == 0) {
+        *out = lr_op_imm_i64(0, type);
+        return 0;
+    }
+    if (x->kind == LR_VAL_IMM_I64 && x->imm_i64 == 1) {
+        *out = *y;
+        out->type = type;
+        return 0;
+    }
+    if (x->kind == LR_VAL_IMM_I64 && y->kind == LR_VAL_IMM_I64) {
+        uint8_t bits = int_type_width_bits(type);
+        uint64_t p = (uint64_t)x->imm_i64 * (uint64_t)y->imm_i64;
+        *out = lr_op_imm_i64(int_sign_extend_bits(p & int_mask_for_bits(bits),
+                                                  bits), type);
+        return 0;
+    }
+    ops[0] = *x;
+    ops[1] = *y;
+    mul = lr_inst_create(lc->a, LR_OP_MUL, type, lr_vreg_new(lc->f), ops, 2);
+    if (!mul || loop_track(lc, mul->dest, pre, mul) != 0)
+        return -1;
+    loop_emit_in_preheader(lc, pre, mul);
+    *out = lr_op_vreg(mul->dest, type);
+    return 0;
+}
+
+static bool loop_int_type(const lr_type_t *t) {
+    return t && (t->kind == LR_TYPE_I8 || t->kind == LR_TYPE_I16 ||
+                 t->kind == LR_TYPE_I32 || t->kind == LR_TYPE_I64);
+}
+
+/* Replace each `mul %iv, c` inside loop h by a new induction variable
+   starting at init * c and stepping by step * c, where %iv is a header
+   phi stepped by `add %iv, step` on the single back edge. */
+static int loop_reduce_strength(loop_ctx_t *lc, uint32_t h, uint32_t pre) {
+    const lr_cfg_t *g = lc->g;
+    lr_block_t *hb = lc->f->block_array[h];
+    int reduced = 0;
+
+    for (lr_inst_t *phi = hb->first; phi && phi->op == LR_OP_PHI;
+         phi = phi->next) {
+        const lr_operand_t *init = NULL, *step = NULL;
+        lr_inst_t *inc = NULL;
+        uint32_t latch = UINT32_MAX, inc_block;
+        if (!loop_int_type(phi->type) || phi->num_operands != 4 ||
+            phi->dest >= lc->cap ||
+            lc->def_block[phi->dest] == LOOP_DEF_MULTI)
+            continue;
+        for (uint32_t oi = 0; oi < 4; oi += 2) {
+            uint32_t pb = phi->operands[oi + 1u].block_id;
+            if (pb == pre)
+                init = &phi->operands[oi];
+            else if (pb < g->num_blocks && loop_contains(g, h, pb))
+                latch = pb;
+        }
+        if (!init || latch == UINT32_MAX)
+            continue;
+        for (uint32_t oi = 0; oi < 4; oi += 2) {
+            if (phi->operands[oi + 1u].block_id == latch &&
+                phi->operands[oi].kind == LR_VAL_VREG &&
+                phi->operands[oi].vreg < lc->cap)
+                inc = lc->def_inst[phi->operands[oi].vreg];
+        }
+        if (!inc || inc->op != LR_OP_ADD || inc->type != phi->type)
+            continue;
+        if (inc->operands[0].kind == LR_VAL_VREG &&
+            inc->operands[0].vreg == phi->dest)
+            step = &inc->operands[1];
+        else if (inc->operands[1].kind == LR_VAL_VREG &&
+                 inc->operands[1].vreg == phi->dest)
+            step = &inc->operands[0];
+        if (!step || !loop_invariant_operand(lc, h, step))
+            continue;
+        inc_block = lc->def_block[inc->dest];
+        if (inc_block == UINT32_MAX || !loop_contains(g, h, inc_block))
+            continue;
+
+        for (uint32_t i = 0; i < g->num_rpo; i++) {
+            uint32_t b = g->rpo[i];
+            lr_block_t *blk = lc->f->block_array[b];
+            lr_inst_t *prev = NULL;
+            if (!loop_contains(g, h, b))
+                continue;
+            for (lr_inst_t *inst = blk->first; inst; ) {
+                lr_inst_t *next = inst->next;
+                const lr_operand_t *c = NULL;
+                lr_operand_t start, stride, ops[4];
+                lr_inst_t *iv, *bump;
+                if (inst->op == LR_OP_MUL && inst->type == phi->type &&
+                    inst->dest < lc->cap &&
+                    lc->def_block[inst->dest] != LOOP_DEF_MULTI) {
+                    if (inst->operands[0].kind == LR_VAL_VREG &&
+                        inst->operands[0].vreg == phi->dest)
+                        c = &inst->operands[1];
+                    else if (inst->operands[1].kind == LR_VAL_VREG &&
+                             inst->operands[1].vreg == phi->dest)
+                        c = &inst->operands[0];
+                }
+                if (!c || !loop_invariant_operand(lc, h, c)) {
+                    prev = inst;
+                    inst = next;
+                    continue;
+                }
+                if (loop_product(lc, pre, phi->type, init, c, &start) != 0 ||
+                    loop_product(lc, pre, phi->type, step, c, &stride) != 0)
+                    return -1;
+                ops[0] = start;
+                ops[1] = lr_op_block(pre);
+                ops[2] = lr_op_vreg(0, phi->type);
+                ops[3] = lr_op_block(latch);
+                iv = lr_inst_create(lc->a, LR_OP_PHI, phi->type,
+                                    lr_vreg_new(lc->f), ops, 4);
+                if (!iv)
+                    return -1;
+                ops[0] = lr_op_vreg(iv->dest, phi->type);
+                ops[1] = stride;
+                bump = lr_inst_create(lc->a, LR_OP_ADD, phi->type,
+                                      lr_vreg_new(lc->f), ops, 2);
+                if (!bump || loop_track(lc, iv->dest, h, iv) != 0 ||
+                    loop_track(lc, bump->dest, inc_block, bump) != 0)
+                    return -1;
+                iv->operands[2].vreg = bump->dest;
+
+                /* Unlink the mul before splicing, as inc or the header
+                   phis may be its neighbours. */
+                loop_unlink(lc, b, prev, inst);
+                lc->leader[inst->dest] = iv->dest + 1u;
+                iv->next = hb->first;
+                hb->first = iv;
+                bump->next = inc->next;
+                inc->next = bump;
+                if (lc->f->block_array[inc_block]->last == inc)
+                    lc->f->block_array[inc_block]->last = bump;
+                if (prev == inc)
+                    prev = bump;
+                reduced++;
                 inst = next;
             }
-            if (!b->first)
-                b->last = NULL;
         }
+    }
+    return reduced;
+}
 
-        if (!removed_any)
-            break;
+int lr_func_optimize_loops(lr_func_t *f, lr_arena_t *a) {
+    const lr_cfg_t *g;
+    loop_ctx_t lc;
+    uint32_t *exits, hoisted = 0, changed = 0;
+
+    if (!f || !a || f->num_blocks < 2 || !f->block_array ||
+        f->next_vreg == 0)
+        return 0;
+    if (!(g = lr_func_cfg(f, a)))
+        return -1;
+    if (g->num_loops == 0)
+        return 0;
+
+    memset(&lc, 0, sizeof(lc));
+    lc.f = f;
+    lc.a = a;
+    lc.g = g;
+    lc.cap = f->next_vreg;
+    lc.def_block = lr_arena_array_uninit(a, uint32_t, lc.cap);
+    lc.def_inst = lr_arena_array(a, lr_inst_t *, lc.cap);
+    lc.leader = lr_arena_array(a, uint32_t, lc.cap);
+    lc.pre_tail = lr_arena_array(a, lr_inst_t *, f->num_blocks);
+    exits = lr_arena_array(a, uint32_t, f->num_blocks);
+    if (!lc.def_block || !lc.def_inst || !lc.leader || !lc.pre_tail || !exits)
+        return -1;
+    memset(lc.def_block, 0xFF, sizeof(uint32_t) * lc.cap);
+    for (uint32_t bi = 0; bi < f->num_blocks; bi++) {
+        lr_block_t *b = f->block_array[bi];
+        for (lr_inst_t *inst = b ? b->first : NULL; inst; inst = inst->next) {
+            if (!inst_defines_dest(inst) || inst->dest >= lc.cap)
+                continue;
+            if (lc.def_block[inst->dest] != UINT32_MAX) {
+                lc.def_block[inst->dest] = LOOP_DEF_MULTI;
+                lc.def_inst[inst->dest] = NULL;
+                continue;
+            }
+            lc.def_block[inst->dest] = bi;
+            lc.def_inst[inst->dest] = inst;
+        }
     }
 
-    (void)changed_any;
-    return 0;
+    /* Inner loops come later in RPO than the loops around them. */
+    for (uint32_t i = g->num_rpo; i-- > 0; ) {
+        uint32_t h = g->rpo[i], pre;
+        if (g->loop_header[h] != h ||
+            (pre = loop_preheader(f, g, h)) == UINT32_MAX)
+            continue;
+        hoisted += loop_hoist_invariants(&lc, h, pre, exits);
+    }
+    changed = hoisted;
+    for (uint32_t i = g->num_rpo; i-- > 0; ) {
+        uint32_t h = g->rpo[i], pre;
+        int reduced;
+        if (g->loop_header[h] != h ||
+            (pre = loop_preheader(f, g, h)) == UINT32_MAX)
+            continue;
+        if ((reduced = loop_reduce_strength(&lc, h, pre)) < 0)
+            return -1;
+        changed += (uint32_t)reduced;
+    }
+
+    if (changed == 0)
+        return 0;
+    for (uint32_t bi = 0; bi < f->num_blocks; bi++) {
+        lr_block_t *b = f->block_array[bi];
+        for (lr_inst_t *inst = b ? b->first : NULL; inst; inst = inst->next)
+            gvn_rename(lc.leader, lc.cap, inst);
+    }
+    if (getenv("LIRIC_VERBOSE_LOOP_OPT"))
+        fprintf(stderr, "loop-opt: fn=%s hoisted=%u reduced=%u\n",
+                f->name ? f->name : "<anon>", hoisted, changed - hoisted);
+    return (int)changed;
 }
 
 int lr_func_finalize(lr_func_t *f, lr_arena_t *a) {
@@ -814,8 +2314,15 @@ int lr_func_finalize(lr_func_t *f, lr_arena_t *a) {
         /* NULL entries are permitted for detached/sparse blocks. */
     }
 
+    if (mem2reg_enabled(f->module) && lr_func_promote_allocas(f, a) < 0)
+        return -1;
     if (run_func_peephole_passes(f, a) != 0)
         return -1;
+    if (gvn_enabled(f->module) && lr_func_value_number(f, a) < 0)
+        return -1;
+    if (f->module && f->module->opt_level > 0 &&
+        lr_func_optimize_loops(f, a) < 0)
+        return -1;
 
     for (uint32_t bi = 0; bi < f->num_blocks; bi++) {
         lr_block_t *b = f->block_array[bi];
@@ -1091,7 +2598,7 @@ static bool ir_call_signature_matches_func(const lr_inst_t *inst,
     uint32_t num_args = 0;
     if (!inst || !func || inst->op != LR_OP_CALL)
         return false;
-    if (inst->type != func->ret_type)
+    if (!lr_type_same(inst->type, func->ret_type))
         return false;
     num_args = inst->num_operands > 0 ? inst->num_operands - 1u : 0u;
     if (func->vararg) {
@@ -1102,7 +2609,7 @@ static bool ir_call_signature_matches_func(const lr_inst_t *inst,
     }
     for (uint32_t i = 0; i < func->num_params; i++) {
         if (!func->param_types ||
-            func->param_types[i] != inst->operands[i + 1u].type) {
+            !lr_type_same(func->param_types[i], inst->operands[i + 1u].type)) {
             return false;
         }
     }
@@ -1512,6 +3019,583 @@ bool lr_module_disambiguate_local_function_collisions_if_dirty(lr_module_t *m) {
     return true;
 }
 
+static bool fast_cc_enabled(void) {
+    static int cached = -1;
+    if (cached < 0) {
+        const char *env = getenv("LIRIC_FAST_CC");
+        cached = !(env && strcmp(env, "0") == 0);
+    }
+    return cached != 0;
+}
+
+static bool fast_cc_scalar_type(const lr_type_t *t) {
+    if (!t)
+        return false;
+    switch (t->kind) {
+    case LR_TYPE_I1:
+    case LR_TYPE_I8:
+    case LR_TYPE_I16:
+    case LR_TYPE_I32:
+    case LR_TYPE_I64:
+    case LR_TYPE_PTR:
+    case LR_TYPE_FLOAT:
+    case LR_TYPE_DOUBLE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool fast_cc_candidate(const lr_func_t *f) {
+    if (!f->is_local || f->is_decl || !f->first_block || f->vararg)
+        return false;
+    if (!f->ret_type || (f->ret_type->kind != LR_TYPE_VOID &&
+                         !fast_cc_scalar_type(f->ret_type)))
+        return false;
+    for (uint32_t i = 0; i < f->num_params; i++) {
+        if (!f->param_types || !fast_cc_scalar_type(f->param_types[i]))
+            return false;
+    }
+    return true;
+}
+
+void lr_module_mark_fast_cc(lr_module_t *m) {
+    lr_func_t **cand;
+    uint32_t ncand = 0;
+
+    if (!m)
+        return;
+    for (lr_func_t *f = m->first_func; f; f = f->next) {
+        f->fast_cc = false;
+        if (fast_cc_candidate(f) && f->symbol_id < m->num_symbols)
+            ncand++;
+    }
+    if (ncand == 0 || !fast_cc_enabled())
+        return;
+    cand = (lr_func_t **)calloc(m->num_symbols, sizeof(*cand));
+    if (!cand)
+        return;
+    for (lr_func_t *f = m->first_func; f; f = f->next) {
+        if (fast_cc_candidate(f) && f->symbol_id < m->num_symbols)
+            cand[f->symbol_id] = f;
+    }
+
+    /* Any reference other than the callee of a matching direct call
+       lets the address escape to code that calls it under the platform
+       ABI. */
+    for (lr_func_t *f = m->first_func; f; f = f->next) {
+        for (lr_block_t *b = f->first_block; b; b = b->next) {
+            for (lr_inst_t *inst = b->first; inst; inst = inst->next) {
+                for (uint32_t i = 0; i < inst->num_operands; i++) {
+                    const lr_operand_t *op = &inst->operands[i];
+                    lr_func_t *callee;
+                    if (op->kind != LR_VAL_GLOBAL ||
+                        op->global_id >= m->num_symbols)
+                        continue;
+                    callee = cand[op->global_id];
+                    if (!callee)
+                        continue;
+                    if (i == 0 && inst->op == LR_OP_CALL &&
+                        !inst->call_vararg && op->global_offset == 0 &&
+                        ir_call_signature_matches_func(inst, callee))
+                        continue;
+                    cand[op->global_id] = NULL;
+                }
+            }
+        }
+    }
+    for (lr_global_t *g = m->first_global; g; g = g->next) {
+        uint32_t sym_id;
+        if (g->name && g->name[0]) {
+            sym_id = lr_module_find_symbol_id(m, g->name);
+            if (sym_id < m->num_symbols)
+                cand[sym_id] = NULL;
+        }
+        for (lr_reloc_t *r = g->relocs; r; r = r->next) {
+            if (!r->symbol_name)
+                continue;
+            sym_id = lr_module_find_symbol_id(m, r->symbol_name);
+            if (sym_id < m->num_symbols)
+                cand[sym_id] = NULL;
+        }
+    }
+
+    for (lr_func_t *f = m->first_func; f; f = f->next) {
+        if (f->symbol_id < m->num_symbols && cand[f->symbol_id] == f)
+            f->fast_cc = true;
+    }
+    free(cand);
+}
+
+/* ---- Inlining ---- */
+
+/* Callees of at most INLINE_MAX_INSTS instructions are copied into their
+   callers, bottom-up so that a callee's own small calls are already
+   expanded.  A module-local function with a single call site may be
+   larger, since its out-of-line copy is then dead weight anyway. */
+#define INLINE_MAX_INSTS 24u
+#define INLINE_SOLE_CALL_MAX_INSTS 96u
+#define INLINE_MAX_GROWTH 1024u     /* instructions added to one caller */
+
+/* On from opt_level 1; LIRIC_INLINE=0/1 overrides the module's level. */
+static bool inline_enabled(const lr_module_t *m) {
+    static int cached = -2;
+    if (cached == -2) {
+        const char *env = getenv("LIRIC_INLINE");
+        cached = env ? strcmp(env, "0") != 0 : -1;
+    }
+    return cached < 0 ? m->opt_level > 0 : cached != 0;
+}
+
+static int inline_register(lr_module_t *m, lr_func_t *f) {
+    if (f->symbol_id >= m->inline_funcs_cap) {
+        uint32_t cap = m->inline_funcs_cap ? m->inline_funcs_cap : 64u;
+        lr_func_t **nf;
+        while (cap <= f->symbol_id)
+            cap *= 2u;
+        nf = lr_arena_array(m->arena, lr_func_t *, cap);
+        if (!nf)
+            return -1;
+        if (m->inline_funcs_cap > 0)
+            memcpy(nf, m->inline_funcs,
+                   sizeof(lr_func_t *) * m->inline_funcs_cap);
+        m->inline_funcs = nf;
+        m->inline_funcs_cap = cap;
+    }
+    m->inline_funcs[f->symbol_id] = f;
+    return 0;
+}
+
+/* The module-defined function a direct call reaches, if the call passes
+   exactly the declared parameters. */
+static lr_func_t *inline_callee(const lr_module_t *m, const lr_inst_t *inst) {
+    lr_func_t *g;
+    uint32_t sym;
+    if (!ir_inst_is_global_call(inst) || inst->call_vararg ||
+        inst->call_external_abi || inst->operands[0].global_offset != 0)
+        return NULL;
+    sym = inst->operands[0].global_id;
+    if (sym >= m->inline_funcs_cap || !(g = m->inline_funcs[sym]))
+        return NULL;
+    /* DIRECT sessions flag emitted functions is_decl but keep their
+       bodies; only registered functions are considered here. */
+    if (g->symbol_id != sym || !g->first_block ||
+        !ir_call_signature_matches_func(inst, g))
+        return NULL;
+    return g;
+}
+
+/* Record whether f may be inlined, and its size.  in_cycle: f calls
+   itself or sits on a longer call cycle. */
+static void inline_analyze(const lr_module_t *m, lr_func_t *f,
+                           bool in_cycle) {
+    uint32_t size = 0;
+    bool ok = !f->vararg && f->ret_type &&
+              (f->ret_type->kind == LR_TYPE_VOID ||
+               fast_cc_scalar_type(f->ret_type));
+    bool returns = false;
+
+    f->acyclic = !in_cycle;
+    for (uint32_t i = 0; ok && i < f->num_params; i++)
+        ok = f->param_types && f->param_vregs &&
+             fast_cc_scalar_type(f->param_types[i]);
+    for (lr_block_t *b = f->first_block; b; b = b->next) {
+        for (lr_inst_t *inst = b->first; inst; inst = inst->next) {
+            lr_func_t *g;
+            size++;
+            if (inst->op == LR_OP_RET || inst->op == LR_OP_RET_VOID)
+                returns = true;
+            /* Allocas move to the caller's entry block, which needs a
+               fixed count. */
+            if (inst->op == LR_OP_ALLOCA &&
+                (b != f->first_block ||
+                 (inst->num_operands > 0 &&
+                  inst->operands[0].kind == LR_VAL_VREG)))
+                ok = false;
+            if (inst->op == LR_OP_CALL && (g = inline_callee(m, inst)) &&
+                (g == f || !g->acyclic))
+                f->acyclic = false;
+        }
+    }
+    f->inline_size = ok && returns && f->acyclic ? size : 0u;
+}
+
+/* A new block of f, linked right after `after` and named after `name`
+   with a suffix keeping labels unique. */
+static lr_block_t *inline_new_block(lr_func_t *f, lr_arena_t *a,
+                                    lr_block_t *after, const char *name,
+                                    const char *suffix) {
+    char label[96];
+    lr_block_t *tail = f->last_block;
+    lr_block_t *b;
+    snprintf(label, sizeof(label), "%.64s.%s%u", name ? name : "",
+             suffix, f->num_blocks);
+    b = lr_block_create(f, a, label);
+    if (!b || tail == after)
+        return b;
+    tail->next = NULL;
+    f->last_block = tail;
+    b->next = after->next;
+    after->next = b;
+    return b;
+}
+
+static void inline_retarget_phis(lr_func_t *f, const lr_inst_t *term,
+                                  uint32_t from, uint32_t to) {
+    for (uint32_t i = 0; term && i < term->num_operands; i++) {
+        lr_block_t *s;
+        if (term->operands[i].kind != LR_VAL_BLOCK)
+            continue;
+        for (s = f->first_block; s && s->id != term->operands[i].block_id;
+             s = s->next) {}
+        for (lr_inst_t *phi = s ? s->first : NULL;
+             phi && phi->op == LR_OP_PHI; phi = phi->next) {
+            for (uint32_t oi = 1; oi < phi->num_operands; oi += 2) {
+                if (phi->operands[oi].kind == LR_VAL_BLOCK &&
+                    phi->operands[oi].block_id == from)
+                    phi->operands[oi].block_id = to;
+            }
+        }
+    }
+}
+
+/* Replace `call` (after `prev` in blk) by a copy of callee's body.  The
+   instructions after the call move to a continuation block, returned in
+   *cont, where a phi of the returned values takes over the call's dest. */
+static int inline_call(lr_func_t *f, lr_arena_t *a, lr_block_t *blk,
+                       lr_inst_t *prev, lr_inst_t *call,
+                       const lr_func_t *callee, lr_block_t **cont) {
+    uint32_t base = f->next_vreg, nrets = 0;
+    uint32_t *arg_of;
+    lr_block_t **bmap, *after = blk, *c, *entry = f->first_block;
+    lr_inst_t *alloca_tail = NULL, *br, *phi = NULL;
+    lr_operand_t op;
+
+    arg_of = lr_arena_array_uninit(a, uint32_t, callee->next_vreg);
+    bmap = lr_arena_array(a, lr_block_t *, callee->num_blocks);
+    if (!arg_of || !bmap)
+        return -1;
+    memset(arg_of, 0xFF, sizeof(uint32_t) * callee->next_vreg);
+    for (uint32_t i = 0; i < callee->num_params; i++) {
+        if (callee->param_vregs[i] < callee->next_vreg)
+            arg_of[callee->param_vregs[i]] = i + 1u;
+    }
+    for (const lr_block_t *cb = callee->first_block; cb; cb = cb->next) {
+        if (cb->id >= callee->num_blocks ||
+            !(bmap[cb->id] = inline_new_block(f, a, after, cb->name, "i")))
+            return -1;
+        after = bmap[cb->id];
+    }
+    if (!(c = inline_new_block(f, a, after, blk->name, "split")))
+        return -1;
+    f->next_vreg += callee->next_vreg;
+
+    /* Split blk after the call; its successors now come from c. */
+    c->first = call->next;
+    c->last = blk->last;
+    inline_retarget_phis(f, c->last, blk->id, c->id);
+
+    op = lr_op_block(bmap[callee->first_block->id]->id);
+    br = lr_inst_create(a, LR_OP_BR, f->module->type_void, 0, &op, 1);
+    if (call->type && call->type->kind != LR_TYPE_VOID) {
+        uint32_t n = 0;
+        for (const lr_block_t *cb = callee->first_block; cb; cb = cb->next) {
+            for (const lr_inst_t *src = cb->first; src; src = src->next)
+                n += src->op == LR_OP_RET;
+        }
+        phi = lr_inst_create(a, LR_OP_PHI, call->type, call->dest, NULL, 0);
+        if (phi)
+            phi->operands = lr_arena_array(a, lr_operand_t, 2u * n);
+        if (!phi || (n > 0 && !phi->operands))
+            return -1;
+    }
+    if (!br)
+        return -1;
+    if (prev)
+        prev->next = br;
+    else
+        blk->first = br;
+    blk->last = br;
+
+    for (const lr_block_t *cb = callee->first_block; cb; cb = cb->next) {
+        lr_block_t *nb = bmap[cb->id];
+        for (const lr_inst_t *src = cb->first; src; src = src->next) {
+            lr_inst_t *inst = lr_arena_new(a, lr_inst_t);
+            if (!inst)
+                return -1;
+            *inst = *src;
+            inst->next = NULL;
+            inst->call_tail = LR_CALL_TAIL_NONE;
+            if (src->num_operands > 0) {
+                inst->operands = lr_arena_array(a, lr_operand_t,
+                                                src->num_operands);
+                if (!inst->operands)
+                    return -1;
+            }
+            for (uint32_t i = 0; i < src->num_operands; i++) {
+                lr_operand_t *o = &inst->operands[i];
+                *o = src->operands[i];
+                if (o->kind == LR_VAL_VREG && o->vreg < callee->next_vreg &&
+                    arg_of[o->vreg] != UINT32_MAX) {
+                    *o = call->operands[arg_of[o->vreg]];
+                    o->type = src->operands[i].type;
+                } else if (o->kind == LR_VAL_VREG) {
+                    o->vreg += base;
+                } else if (o->kind == LR_VAL_BLOCK &&
+                           o->block_id < callee->num_blocks &&
+                           bmap[o->block_id]) {
+                    o->block_id = bmap[o->block_id]->id;
+                }
+            }
+            if (inst_defines_dest(src))
+                inst->dest = src->dest + base;
+
+            if (inst->op == LR_OP_RET || inst->op == LR_OP_RET_VOID) {
+                if (phi && inst->op == LR_OP_RET) {
+                    phi->operands[2u * nrets] = inst->operands[0];
+                    phi->operands[2u * nrets].type = call->type;
+                    phi->operands[2u * nrets + 1u] = lr_op_block(nb->id);
+                    nrets++;
+                }
+                inst->op = LR_OP_BR;
+                inst->type = f->module->type_void;
+                inst->operands = lr_arena_array(a, lr_operand_t, 1);
+                if (!inst->operands)
+                    return -1;
+                inst->operands[0] = lr_op_block(c->id);
+                inst->num_operands = 1;
+            }
+            if (inst->op == LR_OP_ALLOCA) {
+                /* Ahead of everything in the caller's entry block. */
+                if (alloca_tail) {
+                    inst->next = alloca_tail->next;
+                    alloca_tail->next = inst;
+                } else {
+                    inst->next = entry->first;
+                    entry->first = inst;
+                }
+                alloca_tail = inst;
+                continue;
+            }
+            if (nb->last)
+                nb->last->next = inst;
+            else
+                nb->first = inst;
+            nb->last = inst;
+        }
+    }
+    if (phi) {
+        phi->num_operands = 2u * nrets;
+        phi->next = c->first;
+        c->first = phi;
+        if (!c->last)
+            c->last = phi;
+    }
+    *cont = c;
+    return 0;
+}
+
+/* Inline the eligible calls f makes.  sites, when known, counts the
+   direct calls to each symbol. */
+static int inline_func_calls(lr_module_t *m, lr_func_t *f, lr_arena_t *a,
+                             const uint32_t *sites) {
+    uint32_t growth = 0;
+    int inlined = 0;
+    lr_block_t *b = f->first_block;
+
+    while (b) {
+        lr_inst_t *prev = NULL;
+        lr_block_t *cont = NULL;
+        for (lr_inst_t *inst = b->first; inst; prev = inst, inst = inst->next) {
+            lr_func_t *g;
+            uint32_t limit = INLINE_MAX_INSTS;
+            if (inst->op != LR_OP_CALL || !(g = inline_callee(m, inst)) ||
+                g == f || g->inline_size == 0)
+                continue;
+            if (sites && g->is_local && sites[g->symbol_id] == 1u)
+                limit = INLINE_SOLE_CALL_MAX_INSTS;
+            if (g->inline_size > limit ||
+                growth + g->inline_size > INLINE_MAX_GROWTH)
+                continue;
+            if (inline_call(f, a, b, prev, inst, g, &cont) != 0)
+                return -1;
+            growth += g->inline_size;
+            inlined++;
+            break;
+        }
+        /* The copied body was expanded when its function was; resume
+           after it. */
+        b = cont ? cont : b->next;
+    }
+    return inlined;
+}
+
+int lr_func_inline_calls(lr_func_t *f, lr_arena_t *a) {
+    lr_module_t *m = f ? f->module : NULL;
+    int inlined;
+
+    if (!m || !a || f->is_decl || !f->first_block ||
+        lr_func_is_finalized(f) || !inline_enabled(m))
+        return 0;
+    if (inline_register(m, f) != 0)
+        return -1;
+    if ((inlined = inline_func_calls(m, f, a, NULL)) < 0)
+        return -1;
+    /* Only functions completed earlier are known here.  A later one that
+       calls back into f closes a cycle unseen, but its own body then
+       holds at most one copy of f: expansion stays bounded. */
+    inline_analyze(m, f, false);
+    return inlined;
+}
+
+int lr_module_inline_calls(lr_module_t *m) {
+    lr_call_sig_entry_t *calls = NULL;
+    uint32_t ncalls = 0, call_cap = 0, *call_buckets = NULL;
+    lr_func_t **funcs = NULL;
+    uint32_t nfuncs = 0, nedges = 0, next_index = 0, nstack = 0, ncs = 0;
+    uint32_t *sites = NULL, *node_of = NULL, *edge_off = NULL, *edges = NULL;
+    uint32_t *index = NULL, *low = NULL, *stack = NULL, *cs = NULL;
+    uint32_t *cursor = NULL;
+    bool *on_stack = NULL;
+    int inlined = 0, rc = -1;
+
+    if (!m || !m->arena || !inline_enabled(m))
+        return 0;
+    for (lr_func_t *f = m->first_func; f; f = f->next) {
+        f->inline_size = 0;
+        f->acyclic = false;
+        if (!f->is_decl && f->first_block && f->symbol_id < m->num_symbols)
+            nfuncs++;
+    }
+    if (nfuncs < 2)
+        return 0;
+    if (m->inline_funcs_cap > 0)
+        memset(m->inline_funcs, 0, sizeof(lr_func_t *) * m->inline_funcs_cap);
+    if (ir_build_call_sig_index_dynamic(m, &calls, &ncalls, &call_buckets,
+                                        &call_cap) != 0)
+        return -1;
+    if (ncalls == 0)
+        return 0;
+
+    funcs = (lr_func_t **)malloc(sizeof(*funcs) * nfuncs);
+    sites = (uint32_t *)calloc(m->num_symbols, sizeof(*sites));
+    node_of = (uint32_t *)malloc(sizeof(*node_of) * m->num_symbols);
+    edge_off = (uint32_t *)calloc(nfuncs + 1u, sizeof(*edge_off));
+    edges = (uint32_t *)malloc(sizeof(*edges) * ncalls);
+    index = (uint32_t *)malloc(sizeof(*index) * nfuncs);
+    low = (uint32_t *)malloc(sizeof(*low) * nfuncs);
+    stack = (uint32_t *)malloc(sizeof(*stack) * nfuncs);
+    cs = (uint32_t *)malloc(sizeof(*cs) * nfuncs);
+    cursor = (uint32_t *)malloc(sizeof(*cursor) * nfuncs);
+    on_stack = (bool *)calloc(nfuncs, sizeof(*on_stack));
+    if (!funcs || !sites || !node_of || !edge_off || !edges || !index ||
+        !low || !stack || !cs || !cursor || !on_stack)
+        goto cleanup;
+    memset(node_of, 0xFF, sizeof(*node_of) * m->num_symbols);
+    nfuncs = 0;
+    for (lr_func_t *f = m->first_func; f; f = f->next) {
+        if (f->is_decl || !f->first_block || f->symbol_id >= m->num_symbols)
+            continue;
+        if (inline_register(m, f) != 0)
+            goto cleanup;
+        node_of[f->symbol_id] = nfuncs;
+        index[nfuncs] = UINT32_MAX;
+        funcs[nfuncs++] = f;
+    }
+    for (uint32_t i = 0; i < ncalls; i++) {
+        if (calls[i].sym_id < m->num_symbols)
+            sites[calls[i].sym_id]++;
+    }
+    /* A symbol also called with another signature stays out of line. */
+    for (uint32_t i = 0; i < nfuncs; i++) {
+        if (ir_call_index_has_signature_conflict(calls, call_buckets,
+                                                 call_cap, funcs[i]))
+            m->inline_funcs[funcs[i]->symbol_id] = NULL;
+    }
+
+    /* Call graph edges, CSR by caller. */
+    for (uint32_t i = 0; i < nfuncs; i++) {
+        edge_off[i] = nedges;
+        for (lr_block_t *b = funcs[i]->first_block; b; b = b->next) {
+            for (lr_inst_t *inst = b->first; inst; inst = inst->next) {
+                lr_func_t *g;
+                if (inst->op == LR_OP_CALL && (g = inline_callee(m, inst)) &&
+                    nedges < ncalls)
+                    edges[nedges++] = node_of[g->symbol_id];
+            }
+        }
+    }
+    edge_off[nfuncs] = nedges;
+
+    /* Tarjan's algorithm emits each strongly connected component after
+       every component it calls into: bottom-up. */
+    for (uint32_t root = 0; root < nfuncs; root++) {
+        if (index[root] != UINT32_MAX)
+            continue;
+        index[root] = low[root] = next_index++;
+        stack[nstack++] = root;
+        on_stack[root] = true;
+        cursor[root] = edge_off[root];
+        cs[ncs++] = root;
+        while (ncs > 0) {
+            uint32_t v = cs[ncs - 1u];
+            if (cursor[v] < edge_off[v + 1u]) {
+                uint32_t w = edges[cursor[v]++];
+                if (index[w] == UINT32_MAX) {
+                    index[w] = low[w] = next_index++;
+                    stack[nstack++] = w;
+                    on_stack[w] = true;
+                    cursor[w] = edge_off[w];
+                    cs[ncs++] = w;
+                } else if (on_stack[w] && index[w] < low[v]) {
+                    low[v] = index[w];
+                }
+                continue;
+            }
+            ncs--;
+            if (ncs > 0 && low[v] < low[cs[ncs - 1u]])
+                low[cs[ncs - 1u]] = low[v];
+            if (low[v] != index[v])
+                continue;
+
+            uint32_t top = nstack;
+            while (stack[--nstack] != v) {}
+            for (uint32_t k = nstack; k < top; k++) {
+                uint32_t n = stack[k];
+                lr_func_t *f = funcs[n];
+                bool in_cycle = top - nstack > 1u;
+                int count;
+                on_stack[n] = false;
+                for (uint32_t e = edge_off[n]; e < edge_off[n + 1u]; e++)
+                    in_cycle |= edges[e] == n;
+                if (!lr_func_is_finalized(f)) {
+                    if ((count = inline_func_calls(m, f, m->arena, sites)) < 0)
+                        goto cleanup;
+                    inlined += count;
+                }
+                inline_analyze(m, f, in_cycle);
+            }
+        }
+    }
+    rc = inlined;
+
+cleanup:
+    free(calls);
+    free(call_buckets);
+    free(funcs);
+    free(sites);
+    free(node_of);
+    free(edge_off);
+    free(edges);
+    free(index);
+    free(low);
+    free(stack);
+    free(cs);
+    free(cursor);
+    free(on_stack);
+    return rc;
+}
+
 size_t lr_type_size(const lr_type_t *t) {
     if (!t) return 0;
     switch (t->kind) {
@@ -2010,6 +4094,12 @@ static uint32_t count_block_predecessors(const lr_func_t *f,
                     inst->operands[2].block_id == target->id) {
                     count++;
                 }
+            } else if (inst->op == LR_OP_SWITCH) {
+                for (uint32_t oi = 1; oi < inst->num_operands; oi++) {
+                    if (inst->operands[oi].kind == LR_VAL_BLOCK &&
+                        inst->operands[oi].block_id == target->id)
+                        count++;
+                }
             }
         }
     }
@@ -2037,6 +4127,14 @@ static void dump_block_predecessors(FILE *out, const lr_func_t *f,
                         (inst->operands[2].kind == LR_VAL_BLOCK &&
                          inst->operands[2].block_id == target->id))) {
                 is_pred = true;
+            } else if (inst->op == LR_OP_SWITCH) {
+                for (uint32_t oi = 1; oi < inst->num_operands; oi++) {
+                    if (inst->operands[oi].kind == LR_VAL_BLOCK &&
+                        inst->operands[oi].block_id == target->id) {
+                        is_pred = true;
+                        break;
+                    }
+                }
             }
             if (!is_pred)
                 continue;
@@ -2478,6 +4576,7 @@ static const char *opcode_name(lr_opcode_t op) {
     case LR_OP_RET_VOID:     return "ret void";
     case LR_OP_BR:           return "br";
     case LR_OP_CONDBR:       return "br";
+    case LR_OP_SWITCH:       return "switch";
     case LR_OP_UNREACHABLE:  return "unreachable";
     case LR_OP_ADD:          return "add";
     case LR_OP_SUB:          return "sub";
@@ -2521,6 +4620,9 @@ static const char *opcode_name(lr_opcode_t op) {
     case LR_OP_FPTRUNC:      return "fptrunc";
     case LR_OP_EXTRACTVALUE: return "extractvalue";
     case LR_OP_INSERTVALUE:  return "insertvalue";
+    case LR_OP_EXTRACTELEMENT: return "extractelement";
+    case LR_OP_INSERTELEMENT:  return "insertelement";
+    case LR_OP_SHUFFLEVECTOR:  return "shufflevector";
     }
     return "?";
 }
@@ -2581,6 +4683,7 @@ static bool inst_has_dest(const lr_inst_t *inst) {
     case LR_OP_RET_VOID:
     case LR_OP_BR:
     case LR_OP_CONDBR:
+    case LR_OP_SWITCH:
     case LR_OP_STORE:
     case LR_OP_UNREACHABLE:
         return false;
@@ -2650,6 +4753,11 @@ void lr_dump_inst_opts(const lr_inst_t *inst, const lr_module_t *m,
     } else {
         const char *opname = no_op_cast ? noop_cast_opcode(inst->type)
                                         : opcode_name(inst->op);
+        if (inst->op == LR_OP_CALL && inst->call_tail == LR_CALL_TAIL)
+            fprintf(out, "tail ");
+        else if (inst->op == LR_OP_CALL &&
+                 inst->call_tail == LR_CALL_MUSTTAIL)
+            fprintf(out, "musttail ");
         if (inst->op == LR_OP_RET_VOID || inst->op == LR_OP_UNREACHABLE)
             fprintf(out, "%s", opname);
         else
@@ -2687,6 +4795,29 @@ void lr_dump_inst_opts(const lr_inst_t *inst, const lr_module_t *m,
         }
         break;
 
+    case LR_OP_SWITCH:
+        if (inst->num_operands >= 2) {
+            if (inst->operands[0].type)
+                print_type(inst->operands[0].type, out);
+            fprintf(out, " ");
+            print_operand(&inst->operands[0], m, f, out);
+            fprintf(out, ", ");
+            print_operand(&inst->operands[1], m, f, out);
+            fprintf(out, " [\n");
+            for (uint32_t i = 2; i + 1 < inst->num_operands; i += 2) {
+                fprintf(out, "    ");
+                if (inst->operands[0].type)
+                    print_type(inst->operands[0].type, out);
+                fprintf(out, " ");
+                print_operand(&inst->operands[i], m, f, out);
+                fprintf(out, ", ");
+                print_operand(&inst->operands[i + 1], m, f, out);
+                fprintf(out, "\n");
+            }
+            fprintf(out, "  ]");
+        }
+        break;
+
     case LR_OP_STORE:
         if (inst->num_operands >= 2) {
             if (inst->operands[0].type)
@@ -3004,6 +5135,41 @@ void lr_dump_inst_opts(const lr_inst_t *inst, const lr_module_t *m,
         }
         break;
 
+    case LR_OP_EXTRACTELEMENT:
+    case LR_OP_INSERTELEMENT:
+        for (uint32_t i = 0; i < inst->num_operands; i++) {
+            if (i > 0)
+                fprintf(out, ", ");
+            if (inst->operands[i].type)
+                print_type(inst->operands[i].type, out);
+            else
+                fprintf(out, "i64");
+            fprintf(out, " ");
+            print_operand(&inst->operands[i], m, f, out);
+        }
+        break;
+
+    case LR_OP_SHUFFLEVECTOR:
+        for (uint32_t i = 0; i < inst->num_operands && i < 2; i++) {
+            if (i > 0)
+                fprintf(out, ", ");
+            if (inst->operands[i].type)
+                print_type(inst->operands[i].type, out);
+            fprintf(out, " ");
+            print_operand(&inst->operands[i], m, f, out);
+        }
+        fprintf(out, ", <%u x i32> <", inst->num_indices);
+        for (uint32_t i = 0; i < inst->num_indices; i++) {
+            if (i > 0)
+                fprintf(out, ", ");
+            if (inst->indices[i] == UINT32_MAX)
+                fprintf(out, "i32 poison");
+            else
+                fprintf(out, "i32 %u", inst->indices[i]);
+        }
+        fprintf(out, ">");
+        break;
+
     default:
         if (is_cast_op(inst->op)) {
             const lr_type_t *src_ty = NULL;
@@ -3195,6 +5361,7 @@ static void merge_deep_copy_func_body(lr_module_t *dest, lr_func_t *df,
             di->align = si->align;
             di->call_external_abi = si->call_external_abi;
             di->call_vararg = si->call_vararg;
+            di->call_tail = si->call_tail;
             di->call_fixed_args = si->call_fixed_args;
 
             if (si->num_indices > 0 && si->indices) {
@@ -3225,6 +5392,7 @@ static void merge_replace_func(lr_module_t *dest, lr_func_t *df,
     df->num_params = sf->num_params;
     df->vararg = sf->vararg;
     df->uses_llvm_abi = sf->uses_llvm_abi;
+    df->is_local = sf->is_local;
 
     if (sf->num_params > 0) {
         df->param_types = lr_arena_array(a, lr_type_t *, sf->num_params);
@@ -3363,6 +5531,7 @@ int lr_module_merge(lr_module_t *dest, lr_module_t *src) {
                     merge_remap_type(dest, sf->ret_type),
                     params, sf->num_params, sf->vararg);
                 nf->uses_llvm_abi = sf->uses_llvm_abi;
+                nf->is_local = sf->is_local;
                 nf->first_block = NULL;
                 nf->last_block = NULL;
                 nf->block_array = NULL;
@@ -3378,6 +5547,142 @@ int lr_module_merge(lr_module_t *dest, lr_module_t *src) {
     return 0;
 }
 
+static lr_inst_t *copy_finalized_inst(lr_module_t *dest, const lr_module_t *src,
+                                      const lr_inst_t *si) {
+    lr_arena_t *a = dest->arena;
+    lr_operand_t *ops = NULL;
+    lr_inst_t *di;
+
+    if (si->num_operands > 0) {
+        ops = lr_arena_array(a, lr_operand_t, si->num_operands);
+        if (!ops)
+            return NULL;
+        for (uint32_t i = 0; i < si->num_operands; i++) {
+            const lr_operand_t *op = &si->operands[i];
+            ops[i] = merge_remap_operand(dest, op, NULL);
+            if (op->kind == LR_VAL_GLOBAL) {
+                const char *name = lr_module_symbol_name(src, op->global_id);
+                ops[i].global_id = name ? lr_module_intern_symbol(dest, name)
+                                        : UINT32_MAX;
+                if (ops[i].global_id == UINT32_MAX)
+                    return NULL;
+            }
+        }
+    }
+
+    di = lr_inst_create(a, si->op, merge_remap_type(dest, si->type), si->dest,
+                        ops, si->num_operands);
+    if (!di)
+        return NULL;
+    di->icmp_pred = si->icmp_pred;
+    di->num_indices = si->num_indices;
+    di->align = si->align;
+    di->call_external_abi = si->call_external_abi;
+    di->call_vararg = si->call_vararg;
+    di->call_tail = si->call_tail;
+    di->call_fixed_args = si->call_fixed_args;
+    if (si->num_indices > 0 && si->indices) {
+        di->indices = lr_arena_array(a, uint32_t, si->num_indices);
+        if (!di->indices)
+            return NULL;
+        memcpy(di->indices, si->indices, sizeof(uint32_t) * si->num_indices);
+    }
+    return di;
+}
+
+lr_func_t *lr_module_copy_func(lr_module_t *dest, const lr_func_t *sf,
+                               bool with_body) {
+    lr_arena_t *a;
+    lr_type_t **params = NULL;
+    lr_func_t *df;
+
+    if (!dest || !sf || !sf->name || !sf->module)
+        return NULL;
+    if (with_body && !lr_func_is_finalized(sf))
+        return NULL;
+    a = dest->arena;
+
+    if (sf->num_params > 0) {
+        params = lr_arena_array(a, lr_type_t *, sf->num_params);
+        if (!params)
+            return NULL;
+        for (uint32_t i = 0; i < sf->num_params; i++)
+            params[i] = merge_remap_type(dest, sf->param_types[i]);
+    }
+    df = lr_func_create(dest, sf->name, merge_remap_type(dest, sf->ret_type),
+                        params, sf->num_params, sf->vararg);
+    if (!df || df->symbol_id == UINT32_MAX)
+        return NULL;
+    if (sf->num_params > 0)
+        memcpy(df->param_vregs, sf->param_vregs,
+               sizeof(uint32_t) * sf->num_params);
+    df->next_vreg = sf->next_vreg;
+    df->uses_llvm_abi = sf->uses_llvm_abi;
+    df->is_local = sf->is_local;
+    df->fast_cc = sf->fast_cc;
+
+    if (sf->first_block && !with_body) {
+        /* Codegen only asks whether a callee has a body. */
+        if (!lr_block_create(df, a, ""))
+            return NULL;
+    } else if (sf->first_block) {
+        df->num_blocks = sf->num_blocks;
+        df->block_array = lr_arena_array(a, lr_block_t *, sf->num_blocks);
+        df->block_inst_offsets = lr_arena_array(a, uint32_t,
+                                                sf->num_blocks + 1u);
+        df->num_linear_insts = sf->num_linear_insts;
+        if (sf->num_linear_insts > 0)
+            df->linear_inst_array = lr_arena_array(a, lr_inst_t *,
+                                                   sf->num_linear_insts);
+        if (!df->block_array || !df->block_inst_offsets ||
+            (sf->num_linear_insts > 0 && !df->linear_inst_array))
+            return NULL;
+        memcpy(df->block_inst_offsets, sf->block_inst_offsets,
+               sizeof(uint32_t) * (sf->num_blocks + 1u));
+
+        for (const lr_block_t *sb = sf->first_block; sb; sb = sb->next) {
+            lr_block_t *db = lr_arena_new(a, lr_block_t);
+            if (!db)
+                return NULL;
+            db->name = sb->name ? lr_arena_strdup(a, sb->name, strlen(sb->name))
+                                : NULL;
+            db->id = sb->id;
+            db->func = df;
+            db->num_insts = sb->num_insts;
+            if (sb->num_insts > 0) {
+                db->inst_array = lr_arena_array(a, lr_inst_t *, sb->num_insts);
+                if (!db->inst_array)
+                    return NULL;
+            }
+            for (uint32_t i = 0; i < sb->num_insts; i++) {
+                lr_inst_t *di = copy_finalized_inst(dest, sf->module,
+                                                    sb->inst_array[i]);
+                if (!di)
+                    return NULL;
+                db->inst_array[i] = di;
+                if (!db->first) db->first = di;
+                else db->last->next = di;
+                db->last = di;
+            }
+            if (!df->first_block) df->first_block = db;
+            else df->last_block->next = db;
+            df->last_block = db;
+            if (sb->id < sf->num_blocks && sf->block_array[sb->id] == sb)
+                df->block_array[sb->id] = db;
+        }
+        for (uint32_t bi = 0; bi < df->num_blocks; bi++) {
+            const lr_block_t *db = df->block_array[bi];
+            if (!db)
+                continue;
+            for (uint32_t i = 0; i < db->num_insts; i++)
+                df->linear_inst_array[df->block_inst_offsets[bi] + i] =
+                    db->inst_array[i];
+        }
+    }
+    df->is_decl = sf->is_decl;
+    return df;
+}
+
 void lr_dump_func_signature(const lr_func_t *f, FILE *out) {
     bool is_decl;
     if (!f || !out)
@@ -3438,6 +5743,7 @@ static bool inst_is_terminator(const lr_inst_t *inst) {
     case LR_OP_RET_VOID:
     case LR_OP_BR:
     case LR_OP_CONDBR:
+    case LR_OP_SWITCH:
     case LR_OP_UNREACHABLE:
         return true;
     default:
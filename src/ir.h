@@ -77,6 +77,7 @@ typedef struct lr_inst {
     uint32_t align;
     bool call_external_abi;
     bool call_vararg;
+    uint8_t call_tail;          /* LR_CALL_TAIL_* marker */
     uint32_t call_fixed_args;
     struct lr_inst *next;
 } lr_inst_t;
@@ -110,6 +111,29 @@ typedef struct lr_block {
     struct lr_block *next;
 } lr_block_t;
 
+/* Control-flow analyses of a function, computed on first request by
+   lr_func_cfg and cached on it until blocks or instructions are added
+   or a pass rewrites a terminator and calls lr_func_invalidate_cfg.
+   Per-block arrays are indexed by block id.  Edges are CSR: the
+   successors of b are succ[succ_off[b] .. succ_off[b + 1]), with
+   duplicate edges folded.  Unreachable blocks have rpo_num, idom and
+   dom_pre UINT32_MAX, and belong to no loop. */
+typedef struct lr_cfg {
+    uint32_t num_blocks;
+    uint32_t *succ_off, *succ;
+    uint32_t *pred_off, *pred;
+    uint32_t *rpo, num_rpo;     /* reachable blocks, reverse postorder */
+    uint32_t *rpo_num;
+    uint32_t *idom;             /* the entry block is its own idom */
+    uint32_t *child_off, *child;/* dominator tree */
+    uint32_t *dom_pre, *dom_post;
+    uint32_t *df_off, *df;      /* dominance frontiers */
+    uint32_t *loop_header;      /* innermost natural loop, or UINT32_MAX */
+    uint32_t *loop_parent;      /* of a header: enclosing loop's header */
+    uint32_t *loop_depth;       /* 0 outside every loop */
+    uint32_t num_loops;
+} lr_cfg_t;
+
 typedef struct lr_func {
     char *name;
     uint32_t symbol_id;
@@ -121,6 +145,10 @@ typedef struct lr_func {
     bool vararg;
     bool is_decl;
     bool uses_llvm_abi;
+    bool is_local;              /* internal/private: named only in its module */
+    bool fast_cc;               /* set by lr_module_mark_fast_cc */
+    bool acyclic;               /* set by the inliner: on no call cycle */
+    uint32_t inline_size;       /* set by the inliner; 0: never inline */
     lr_block_t *first_block;
     lr_block_t *last_block;
     lr_block_t **block_array;
@@ -129,6 +157,7 @@ typedef struct lr_func {
     uint32_t num_linear_insts;
     uint32_t num_blocks;
     uint32_t next_vreg;
+    lr_cfg_t *cfg;              /* see lr_func_cfg */
     struct lr_module *module;
     struct lr_func *next;
 } lr_func_t;
@@ -179,6 +208,9 @@ typedef struct lr_module {
     lr_type_t *type_fp128;
     lr_type_t *type_ptr;
     void *obj_ctx;
+    int opt_level;              /* native backends: > 0 runs loop passes */
+    lr_func_t **inline_funcs;   /* by symbol id, see lr_func_inline_calls */
+    uint32_t inline_funcs_cap;
     bool local_function_collision_scan_dirty;
     void *sym_to_global;  /* lr_global_t** */
     void *sym_to_func;    /* lr_func_t** */
@@ -193,6 +225,7 @@ lr_type_t *lr_type_array(lr_arena_t *a, lr_type_t *elem, uint64_t count);
 lr_type_t *lr_type_vector(lr_arena_t *a, lr_type_t *elem, uint64_t count);
 lr_type_t *lr_type_struct(lr_arena_t *a, lr_type_t **fields, uint32_t n,
                            bool packed, char *name);
+bool lr_type_same(const lr_type_t *a, const lr_type_t *b);
 lr_func_t *lr_func_create(lr_module_t *m, const char *name, lr_type_t *ret,
                            lr_type_t **params, uint32_t num_params, bool vararg);
 lr_func_t *lr_func_declare(lr_module_t *m, const char *name, lr_type_t *ret,
@@ -204,6 +237,35 @@ lr_inst_t *lr_inst_create(lr_arena_t *a, lr_opcode_t op, lr_type_t *type,
 void lr_block_append(lr_block_t *b, lr_inst_t *inst);
 int lr_func_finalize(lr_func_t *f, lr_arena_t *a);
 bool lr_func_is_finalized(const lr_func_t *f);
+/* The function's CFG analyses, allocated in `a` on first use.  Needs
+   block_array; returns NULL without one or on allocation failure. */
+const lr_cfg_t *lr_func_cfg(lr_func_t *f, lr_arena_t *a);
+/* The same analyses built into `a` without caching them on f.  Backends
+   use this: they may run off the thread that owns the module arena. */
+const lr_cfg_t *lr_func_build_cfg(const lr_func_t *f, lr_arena_t *a);
+void lr_func_invalidate_cfg(lr_func_t *f);
+/* Whether block a dominates block b (both reachable). */
+bool lr_cfg_dominates(const lr_cfg_t *g, uint32_t a, uint32_t b);
+/* Promote scalar entry-block allocas that are only loaded and stored to
+   SSA values (phis on the pruned iterated dominance frontier).  Needs
+   block_array but not yet the finalized instruction arrays;
+   lr_func_finalize runs it at opt_level >= 1 (LIRIC_MEM2REG=0/1
+   overrides).  Returns the number of allocas promoted, or -1 on
+   allocation failure. */
+int lr_func_promote_allocas(lr_func_t *f, lr_arena_t *a);
+/* Remove pure instructions (arithmetic, casts, GEPs, compares, selects)
+   that recompute a value already available in a dominating block.  Run
+   by lr_func_finalize after the peephole passes at opt_level >= 1
+   (LIRIC_GVN=0/1 overrides).  Returns the number of instructions
+   removed, or -1 on allocation failure. */
+int lr_func_value_number(lr_func_t *f, lr_arena_t *a);
+/* Hoist loop-invariant instructions (loads only from loops without
+   stores or calls) into loop preheaders, and turn `mul %iv, c` of basic
+   induction variables into induction variables of their own.  Run by
+   lr_func_finalize when the module's opt_level is nonzero.  Returns the
+   number of instructions moved or rewritten, or -1 on allocation
+   failure. */
+int lr_func_optimize_loops(lr_func_t *f, lr_arena_t *a);
 lr_global_t *lr_global_create(lr_module_t *m, const char *name, lr_type_t *type,
                                bool is_const);
 
@@ -218,6 +280,24 @@ const char *lr_module_symbol_name(const lr_module_t *m, uint32_t id);
 lr_func_t *lr_module_lookup_function(const lr_module_t *m, const char *name);
 void lr_module_disambiguate_local_function_collisions(lr_module_t *m);
 bool lr_module_disambiguate_local_function_collisions_if_dirty(lr_module_t *m);
+/* Flag module-local functions that only this module calls, each call
+   directly with the declared signature, and whose parameters and result
+   are scalars; the native backends pass their arguments under the
+   internal convention of lr_target_fast_cc_assign.  LIRIC_FAST_CC=0
+   keeps every function on the platform ABI. */
+void lr_module_mark_fast_cc(lr_module_t *m);
+/* Copy small, non-recursive, module-defined callees into their callers
+   at direct calls with the declared signature, bottom-up over the call
+   graph.  Callees must have scalar parameters and results, a return,
+   and allocas only in their entry block.  Finalized callers are left
+   alone.  Runs at opt_level >= 1; LIRIC_INLINE=0/1 turns it off/on
+   regardless.  Returns the number of calls inlined, or -1 on
+   allocation failure. */
+int lr_module_inline_calls(lr_module_t *m);
+/* The same for one function that is complete but not yet finalized,
+   with only the functions passed here before it as callees; this is how
+   functions compiled one at a time get inlined. */
+int lr_func_inline_calls(lr_func_t *f, lr_arena_t *a);
 
 size_t lr_type_size(const lr_type_t *t);
 size_t lr_type_align(const lr_type_t *t);
@@ -237,6 +317,13 @@ lr_operand_t lr_canonicalize_gep_index(lr_module_t *m, lr_block_t *b,
                                        lr_func_t *f, lr_operand_t idx_op);
 
 int lr_module_merge(lr_module_t *dest, lr_module_t *src);
+/* Append a copy of sf's header to dest, interning its name and the names
+   its instructions use there.  with_body needs sf finalized and copies
+   its body in finalized form; otherwise a function with a body gets one
+   empty block in its place.  Types are copied, so the result does not
+   refer to sf's module.  Returns NULL on allocation failure. */
+lr_func_t *lr_module_copy_func(lr_module_t *dest, const lr_func_t *sf,
+                               bool with_body);
 
 void lr_dump_func_signature(const lr_func_t *f, FILE *out);
 void lr_dump_block_label(const lr_func_t *f, const lr_block_t *b, FILE *out);
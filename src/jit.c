@@ -14,6 +14,7 @@
 #include <stdarg.h>
 #if defined(__unix__) || defined(__APPLE__)
 #include <pthread.h>
+#include <time.h>
 #define LR_HAS_PTHREADS 1
 #else
 #define LR_HAS_PTHREADS 0
@@ -31,6 +32,7 @@ static double lr_jit_now_us(void) {
 #endif
 
 #define CODE_PAGE_SIZE (16 * 1024 * 1024)
+#define CALL_STUB_RESERVE (64 * 1024)
 #define DATA_PAGE_SIZE (64 * 1024 * 1024)
 #define SYM_BUCKET_COUNT 8192u
 #define MISS_BUCKET_COUNT 4096u
@@ -39,6 +41,8 @@ static double lr_jit_now_us(void) {
 #define MATERIALIZE_CACHE_SCHEMA_VERSION 1u
 #define MATERIALIZE_PREFETCH_MAX_THREADS 16u
 #define MATERIALIZE_PREFETCH_MIN_PENDING 2u
+#define TIERUP_DEFAULT_THRESHOLD 10000u
+#define TIERUP_POLL_NS 1000000L
 
 typedef enum lr_lazy_func_state {
     LR_LAZY_FUNC_PENDING = 0,
@@ -70,6 +74,7 @@ typedef struct lr_sig_buf {
 typedef struct lr_mat_cache_entry {
     uint64_t key_hash;
     uint32_t epoch;
+    uint32_t cpu_features;
     uint8_t target_ptr_size;
     const char *target_name;
     uint8_t *module_sig;
@@ -97,6 +102,8 @@ typedef struct lr_materialize_prefetch_task {
 typedef struct lr_materialize_prefetch_worker {
     const lr_target_t *target;
     lr_compile_mode_t mode;
+    uint32_t codegen_flags;
+    uint32_t cpu_features;
     size_t code_cap;
     lr_materialize_prefetch_task_t *tasks;
     uint32_t begin;
@@ -104,6 +111,59 @@ typedef struct lr_materialize_prefetch_worker {
 } lr_materialize_prefetch_worker_t;
 #endif
 
+typedef enum lr_tier_state {
+    LR_TIER_PROFILING = 0, /* tier-0 body behind the trampoline */
+    LR_TIER_COMPILING = 1, /* claimed by a recompiling thread */
+    LR_TIER_READY = 2,     /* optimized code waiting for installation */
+    LR_TIER_INSTALLED = 3,
+    LR_TIER_FAILED = 4,
+} lr_tier_state_t;
+
+/* Data-buffer cell of a tiered function.  The entry trampoline bumps
+   count and jumps through body, so the field offsets (0 and 8) are baked
+   into tierup_emit_trampoline. */
+typedef struct lr_tier_cell {
+    void *body;
+    uint64_t count;
+} lr_tier_cell_t;
+
+typedef struct lr_tier_func {
+    const char *name;          /* the caller's; only used before publishing */
+    lr_arena_t *arena;         /* owns module and func, see tierup_snapshot */
+    lr_module_t *module;
+    lr_func_t *func;
+    lr_tier_cell_t *cell;
+    uint32_t codegen_flags;
+    uint32_t cpu_features;
+    lr_tier_state_t state;
+    uint8_t *code;             /* READY: recompiled, pre-relocation bytes */
+    size_t code_len;
+    lr_cached_reloc_t *relocs;
+    uint32_t num_relocs;
+    void *installed_body;
+    struct lr_tier_func *next;
+    struct lr_tier_func *install_next;
+} lr_tier_func_t;
+
+/* Tier records are arena-allocated by the owning thread and linked into
+   funcs under lock; the recompiler only touches records it has claimed. */
+struct lr_jit_tierup {
+    const lr_target_t *target;
+    size_t code_cap;
+    uint64_t threshold;
+    lr_tier_func_t *funcs;
+    uint32_t num_compiling;
+    uint32_t num_ready;
+#if LR_HAS_PTHREADS
+    pthread_mutex_t lock;
+    pthread_cond_t wake;       /* threshold change or shutdown */
+    pthread_cond_t done;       /* a recompilation finished */
+    pthread_t thread;
+    bool thread_started;
+    bool stop;
+#endif
+};
+
 /*
  * Cache correctness invariants:
  * - Reuse requires exact module/function signature byte equality.
@@ -126,7 +186,11 @@ static lr_lazy_func_entry_t *find_lazy_func_entry(lr_jit_t *j, const char *name,
 static int materialize_lazy_function(lr_jit_t *j, lr_lazy_func_entry_t *entry);
 static int jit_ensure_module_symbols_interned(lr_module_t *m);
 static void *lookup_symbol_hashed(lr_jit_t *j, const char *name, uint32_t hash);
+static uint64_t jit_tierup_threshold_from_env(void);
+static uint32_t tierup_install_ready(lr_jit_t *j);
+static void tierup_destroy(lr_jit_tierup_t *t);
 static const lr_mat_cache_entry_t *materialize_cache_lookup(const lr_target_t *target,
+                                                            uint32_t cpu_features,
                                                             const uint8_t *module_sig,
                                                             size_t module_sig_len,
                                                             const uint8_t *func_sig,
@@ -445,6 +509,8 @@ static int sig_serialize_inst(lr_sig_buf_t *sb, const lr_inst_t *inst,
         return -1;
     if (sig_buf_u8(sb, inst->call_vararg ? 1u : 0u) != 0)
         return -1;
+    if (sig_buf_u8(sb, inst->call_tail) != 0)
+        return -1;
     if (sig_buf_u32(sb, inst->call_fixed_args) != 0)
         return -1;
     if (sig_buf_u32(sb, (uint32_t)inst->icmp_pred) != 0)
@@ -652,6 +718,7 @@ static const uint8_t *arena_dup_bytes(lr_arena_t *arena, const uint8_t *src, siz
 }
 
 static uint64_t materialize_key_hash(const lr_target_t *target,
+                                     uint32_t cpu_features,
                                      const uint8_t *module_sig, size_t module_sig_len,
                                      const uint8_t *func_sig, size_t func_sig_len,
                                      uint32_t epoch) {
@@ -664,6 +731,7 @@ static uint64_t materialize_key_hash(const lr_target_t *target,
     h = hash64_extend(h, &schema, sizeof(schema));
     h = hash64_extend(h, &epoch, sizeof(epoch));
     h = hash64_extend(h, &ptr_size, sizeof(ptr_size));
+    h = hash64_extend(h, &cpu_features, sizeof(cpu_features));
     h = hash64_extend(h, &tname_len, sizeof(tname_len));
     h = hash64_extend(h, target_name, tname_len);
     h = hash64_extend(h, &module_sig_len, sizeof(module_sig_len));
@@ -702,6 +770,7 @@ static void clear_materialize_cache_entries(void) {
 
 static bool materialize_cache_key_matches(const lr_mat_cache_entry_t *entry,
                                           const lr_target_t *target,
+                                          uint32_t cpu_features,
                                           const uint8_t *module_sig, size_t module_sig_len,
                                           const uint8_t *func_sig, size_t func_sig_len,
                                           uint32_t epoch) {
@@ -710,6 +779,8 @@ static bool materialize_cache_key_matches(const lr_mat_cache_entry_t *entry,
         return false;
     if (entry->target_ptr_size != (target ? target->ptr_size : 0u))
         return false;
+    if (entry->cpu_features != cpu_features)
+        return false;
     if (strcmp(entry->target_name ? entry->target_name : "", target_name) != 0)
         return false;
     if (entry->module_sig_len != module_sig_len || entry->func_sig_len != func_sig_len)
@@ -722,6 +793,7 @@ static bool materialize_cache_key_matches(const lr_mat_cache_entry_t *entry,
 }
 
 static const lr_mat_cache_entry_t *materialize_cache_lookup(const lr_target_t *target,
+                                                            uint32_t cpu_features,
                                                             const uint8_t *module_sig,
                                                             size_t module_sig_len,
                                                             const uint8_t *func_sig,
@@ -733,13 +805,15 @@ static const lr_mat_cache_entry_t *materialize_cache_lookup(const lr_target_t *t
         return NULL;
     }
 
-    uint64_t key_hash = materialize_key_hash(target, module_sig, module_sig_len,
+    uint64_t key_hash = materialize_key_hash(target, cpu_features,
+                                             module_sig, module_sig_len,
                                              func_sig, func_sig_len, g_mat_cache_epoch);
     uint32_t bucket = (uint32_t)(key_hash & (MATERIALIZE_CACHE_BUCKET_COUNT - 1u));
     for (lr_mat_cache_entry_t *entry = g_mat_cache_buckets[bucket]; entry; entry = entry->bucket_next) {
         if (entry->key_hash != key_hash)
             continue;
-        if (materialize_cache_key_matches(entry, target, module_sig, module_sig_len,
+        if (materialize_cache_key_matches(entry, target, cpu_features,
+                                          module_sig, module_sig_len,
                                           func_sig, func_sig_len, g_mat_cache_epoch)) {
             if (update_stats)
                 g_mat_cache_hit_count++;
@@ -752,6 +826,7 @@ static const lr_mat_cache_entry_t *materialize_cache_lookup(const lr_target_t *t
 }
 
 static int materialize_cache_insert(const lr_target_t *target,
+                                    uint32_t cpu_features,
                                     const uint8_t *module_sig, size_t module_sig_len,
                                     const uint8_t *func_sig, size_t func_sig_len,
                                     const uint8_t *code, size_t code_len,
@@ -761,13 +836,15 @@ static int materialize_cache_insert(const lr_target_t *target,
         !code || code_len == 0)
         return -1;
 
-    uint64_t key_hash = materialize_key_hash(target, module_sig, module_sig_len,
+    uint64_t key_hash = materialize_key_hash(target, cpu_features,
+                                             module_sig, module_sig_len,
                                              func_sig, func_sig_len, g_mat_cache_epoch);
     uint32_t bucket = (uint32_t)(key_hash & (MATERIALIZE_CACHE_BUCKET_COUNT - 1u));
     for (lr_mat_cache_entry_t *entry = g_mat_cache_buckets[bucket]; entry; entry = entry->bucket_next) {
         if (entry->key_hash != key_hash)
             continue;
-        if (materialize_cache_key_matches(entry, target, module_sig, module_sig_len,
+        if (materialize_cache_key_matches(entry, target, cpu_features,
+                                          module_sig, module_sig_len,
                                           func_sig, func_sig_len, g_mat_cache_epoch))
             return 0;
     }
@@ -777,6 +854,7 @@ static int materialize_cache_insert(const lr_target_t *target,
         return -1;
     entry->key_hash = key_hash;
     entry->epoch = g_mat_cache_epoch;
+    entry->cpu_features = cpu_features;
     entry->target_ptr_size = target->ptr_size;
     entry->target_name = target->name ? strdup(target->name) : strdup("");
     if (!entry->target_name)
@@ -910,6 +988,11 @@ lr_jit_t *lr_jit_create_for_target(const char *target_name) {
     j->target = target;
 
     j->mode = lr_compile_mode_from_env();
+    j->codegen_flags = lr_codegen_flags_from_env();
+    if (lr_cpu_features_resolve(target->name, NULL, true,
+                                &j->cpu_features) != 0)
+        j->cpu_features = 0;
+    j->tierup_threshold = jit_tierup_threshold_from_env();
 
     j->arena = lr_arena_create(0);
     if (!j->arena) {
@@ -932,6 +1015,7 @@ lr_jit_t *lr_jit_create_for_target(const char *target_name) {
     }
 
     j->code_cap = CODE_PAGE_SIZE;
+    j->code_limit = CODE_PAGE_SIZE - CALL_STUB_RESERVE;
     j->code_buf = lr_platform_alloc_jit_code(j->code_cap, &j->map_jit_enabled);
     if (!j->code_buf) {
         free(j->lazy_func_buckets);
@@ -1220,7 +1304,7 @@ static void register_builtin_symbols(lr_jit_t *j) {
             lr_platform_intrinsic_blob_lookup(name, &blob_begin, &blob_end)) {
             size_t blob_size = (size_t)(blob_end - blob_begin);
             size_t dest = align_up(j->code_size, 16);
-            if (dest + blob_size > j->code_cap)
+            if (dest + blob_size > j->code_limit)
                 continue;
             if (make_writable(j) != 0)
                 continue;
@@ -1871,6 +1955,54 @@ static void *alloc_got_slot(lr_jit_t *j, void *target_addr) {
     return slot;
 }
 
+/* True when a direct call at off (PLT32 rel32 or BRANCH26 bl) reaches
+   target without a stub. */
+static bool call_reloc_in_reach(const lr_jit_t *j, uint8_t type, uint32_t off,
+                                uintptr_t target) {
+    int64_t disp = (int64_t)(intptr_t)target -
+                   (int64_t)(intptr_t)(uintptr_t)(j->code_buf + off);
+    if (type == LR_RELOC_X86_64_PLT32)
+        return disp - 4 >= INT32_MIN && disp - 4 <= INT32_MAX;
+    return (disp & 3) == 0 && disp >= -(1LL << 27) && disp < (1LL << 27);
+}
+
+/* Every call site in the code buffer reaches a stub anywhere in it:
+   rel32 spans +-2 GiB and BRANCH26 +-128 MiB. */
+_Static_assert(CODE_PAGE_SIZE <= (1LL << 31),
+               "JIT code buffer must stay within rel32 call reach");
+_Static_assert(CODE_PAGE_SIZE <= (1LL << 27),
+               "JIT code buffer must stay within BRANCH26 call reach");
+_Static_assert(CALL_STUB_RESERVE < CODE_PAGE_SIZE,
+               "call stub reserve must leave room for code");
+
+/* Append a stub jumping to target_addr for calls out of direct reach:
+   "jmp [rip+2]" on x86_64, "ldr x16, #8; br x16" on aarch64, followed by
+   the address.  Code stops at code_limit, so relocations applied once the
+   buffer has filled still find CALL_STUB_RESERVE bytes for stubs. */
+static void *alloc_call_stub(lr_jit_t *j, void *target_addr) {
+    static const uint8_t x86_stub[8] = {
+        0xFF, 0x25, 0x02, 0x00, 0x00, 0x00, 0xCC, 0xCC,
+    };
+    size_t off = align_up(j->code_size, 16);
+    if (!j->target || off + 16 > j->code_cap)
+        return NULL;
+    if (strcmp(j->target->name, "x86_64") == 0) {
+        memcpy(j->code_buf + off, x86_stub, sizeof(x86_stub));
+    } else if (write_u32(j->code_buf, j->code_cap, (uint32_t)off,
+                         0x58000050u) != 0 ||
+               write_u32(j->code_buf, j->code_cap, (uint32_t)off + 4u,
+                         0xD61F0200u) != 0) {
+        return NULL;
+    }
+    if (write_u64(j->code_buf, j->code_cap, (uint32_t)off + 8u,
+                  (uint64_t)(uintptr_t)target_addr) != 0)
+        return NULL;
+    j->code_size = off + 16;
+    if (j->update_active)
+        j->update_dirty = true;
+    return j->code_buf + off;
+}
+
 static int apply_jit_relocs(lr_jit_t *j, const lr_objfile_ctx_t *ctx,
                             uint32_t reloc_start,
                             const char **missing_symbol) {
@@ -1879,14 +2011,17 @@ static int apply_jit_relocs(lr_jit_t *j, const lr_objfile_ctx_t *ctx,
     if (reloc_start > ctx->num_relocs)
         return -1;
     void **got_slots = NULL;
+    void **call_stubs = NULL;
     void **resolved_targets = NULL;
     uint8_t *resolved_mask = NULL;
     if (ctx->num_symbols > 0) {
         got_slots = (void **)calloc(ctx->num_symbols, sizeof(void *));
+        call_stubs = (void **)calloc(ctx->num_symbols, sizeof(void *));
         resolved_targets = (void **)calloc(ctx->num_symbols, sizeof(void *));
         resolved_mask = (uint8_t *)calloc(ctx->num_symbols, sizeof(uint8_t));
-        if (!got_slots || !resolved_targets || !resolved_mask) {
+        if (!got_slots || !call_stubs || !resolved_targets || !resolved_mask) {
             free(got_slots);
+            free(call_stubs);
             free(resolved_targets);
             free(resolved_mask);
             return -1;
@@ -1965,6 +2100,18 @@ static int apply_jit_relocs(lr_jit_t *j, const lr_objfile_ctx_t *ctx,
                 memcpy(got_slots[rel->symbol_idx], &target_addr, sizeof(target_addr));
             }
             patch_target = (uintptr_t)got_slots[rel->symbol_idx];
+        } else if ((rel->type == LR_RELOC_X86_64_PLT32 ||
+                    rel->type == LR_RELOC_ARM64_BRANCH26) &&
+                   !call_reloc_in_reach(j, rel->type, rel->offset,
+                                        patch_target)) {
+            /* One stub per out-of-reach callee, shared by its call sites. */
+            if (!call_stubs[rel->symbol_idx])
+                call_stubs[rel->symbol_idx] = alloc_call_stub(j, target_addr);
+            if (!call_stubs[rel->symbol_idx]) {
+                rc = -1;
+                break;
+            }
+            patch_target = (uintptr_t)call_stubs[rel->symbol_idx];
         }
 
         switch (rel->type) {
@@ -2028,6 +2175,7 @@ static int apply_jit_relocs(lr_jit_t *j, const lr_objfile_ctx_t *ctx,
     }
 
     free(got_slots);
+    free(call_stubs);
     free(resolved_targets);
     free(resolved_mask);
     return rc;
@@ -2086,7 +2234,9 @@ static int replay_cached_function(lr_jit_t *j, lr_objfile_ctx_t *fixup_ctx,
     if (cached_entry->code_len == 0)
         return -1;
 
-    size_t free_space = j->code_cap - j->code_size;
+    size_t free_space = j->code_size < j->code_limit
+                            ? j->code_limit - j->code_size
+                            : 0;
     if (cached_entry->code_len > free_space)
         return -1;
 
@@ -2117,9 +2267,12 @@ static int replay_cached_function(lr_jit_t *j, lr_objfile_ctx_t *fixup_ctx,
 }
 
 static int compile_one_function(lr_jit_t *j, lr_module_t *m, lr_func_t *f,
-                                lr_objfile_ctx_t *fixup_ctx, void **func_addr_out) {
+                                lr_objfile_ctx_t *fixup_ctx,
+                                uint64_t *loop_counter, void **func_addr_out) {
     uint8_t *func_start = j->code_buf + j->code_size;
-    size_t free_space = j->code_cap - j->code_size;
+    size_t free_space = j->code_size < j->code_limit
+                            ? j->code_limit - j->code_size
+                            : 0;
     uint32_t reloc_base = fixup_ctx->num_relocs;
     if (f->name && f->name[0]) {
         uint32_t sym_idx = lr_obj_ensure_symbol(fixup_ctx, f->name, true, 1,
@@ -2133,8 +2286,9 @@ static int compile_one_function(lr_jit_t *j, lr_module_t *m, lr_func_t *f,
     if (j->mode == LR_COMPILE_LLVM) {
         rc = -1; /* per-function streaming unsupported in LLVM mode */
     } else {
-        rc = lr_target_compile(j->target, j->mode, f, m, func_start,
-                               free_space, &code_len, j->arena);
+        rc = lr_target_compile_ex(j->target, j->mode, j->codegen_flags,
+                                  j->cpu_features, loop_counter, f, m,
+                                  func_start, free_space, &code_len, j->arena);
     }
     JIT_PROF_END(compile);
     if (rc != 0)
@@ -2236,12 +2390,15 @@ static void *materialize_prefetch_worker_main(void *arg) {
         memset(&worker_jit, 0, sizeof(worker_jit));
         worker_jit.target = w->target;
         worker_jit.mode = w->mode;
+        worker_jit.codegen_flags = w->codegen_flags;
+        worker_jit.cpu_features = w->cpu_features;
         worker_jit.code_buf = scratch_buf;
         worker_jit.code_cap = w->code_cap;
+        worker_jit.code_limit = w->code_cap;
         worker_jit.arena = worker_arena;
 
         if (compile_one_function(&worker_jit, &module_view, task->entry->func,
-                                 &fixup_ctx, NULL) != 0)
+                                 &fixup_ctx, NULL, NULL) != 0)
             goto worker_done;
         if (worker_jit.code_size == 0)
             goto worker_done;
@@ -2304,7 +2461,8 @@ static uint32_t materialize_prefetch_maybe_add_target(lr_jit_t *j,
     if (!entry->module_sig || entry->module_sig_len == 0 ||
         !entry->func_sig || entry->func_sig_len == 0)
         return count;
-    if (materialize_cache_lookup(j->target, entry->module_sig, entry->module_sig_len,
+    if (materialize_cache_lookup(j->target, j->cpu_features,
+                                 entry->module_sig, entry->module_sig_len,
                                  entry->func_sig, entry->func_sig_len, false))
         return count;
     if (materialize_prefetch_has_task(tasks, count, entry))
@@ -2492,6 +2650,8 @@ static bool materialize_prefetch_module_functions(lr_jit_t *j,
 
         workers[wi].target = j->target;
         workers[wi].mode = j->mode;
+        workers[wi].codegen_flags = j->codegen_flags;
+        workers[wi].cpu_features = j->cpu_features;
         workers[wi].code_cap = j->code_cap;
         workers[wi].tasks = tasks;
         workers[wi].begin = begin;
@@ -2527,7 +2687,7 @@ static bool materialize_prefetch_module_functions(lr_jit_t *j,
     for (uint32_t i = 1; i < pending; i++) {
         lr_materialize_prefetch_task_t *task = &tasks[i];
         if (task->rc == 0 && task->entry && task->code && task->code_len > 0) {
-            (void)materialize_cache_insert(j->target,
+            (void)materialize_cache_insert(j->target, j->cpu_features,
                                            task->entry->module_sig, task->entry->module_sig_len,
                                            task->entry->func_sig, task->entry->func_sig_len,
                                            task->code, task->code_len,
@@ -2546,6 +2706,468 @@ static bool materialize_prefetch_module_functions(lr_jit_t *j,
     return have_trigger;
 }
 
+static uint64_t jit_tierup_threshold_from_env(void) {
+    const char *env = getenv("LIRIC_JIT_TIERUP");
+    if (!env || !env[0])
+        return 0;
+
+    char *end = NULL;
+    unsigned long long parsed = strtoull(env, &end, 10);
+    if (end != env && *end == '\0')
+        return (uint64_t)parsed;
+
+    if (strcmp(env, "false") == 0 || strcmp(env, "FALSE") == 0 ||
+        strcmp(env, "off") == 0 || strcmp(env, "OFF") == 0 ||
+        strcmp(env, "no") == 0 || strcmp(env, "NO") == 0) {
+        return 0;
+    }
+
+    return TIERUP_DEFAULT_THRESHOLD;
+}
+
+static bool jit_tierup_active(const lr_jit_t *j) {
+    if (!j || j->tierup_threshold == 0 || j->mode == LR_COMPILE_LLVM ||
+        !j->target)
+        return false;
+    return strcmp(j->target->name, "x86_64") == 0 ||
+           strcmp(j->target->name, "aarch64") == 0 ||
+           strcmp(j->target->name, "arm64") == 0;
+}
+
+static void tierup_lock(lr_jit_tierup_t *t) {
+#if LR_HAS_PTHREADS
+    pthread_mutex_lock(&t->lock);
+#else
+    (void)t;
+#endif
+}
+
+static void tierup_unlock(lr_jit_tierup_t *t) {
+#if LR_HAS_PTHREADS
+    pthread_mutex_unlock(&t->lock);
+#else
+    (void)t;
+#endif
+}
+
+static lr_jit_tierup_t *tierup_state(lr_jit_t *j) {
+    if (j->tierup)
+        return j->tierup;
+    lr_jit_tierup_t *t = (lr_jit_tierup_t *)calloc(1, sizeof(*t));
+    if (!t)
+        return NULL;
+    t->target = j->target;
+    t->code_cap = j->code_cap;
+    t->threshold = j->tierup_threshold;
+#if LR_HAS_PTHREADS
+    if (pthread_mutex_init(&t->lock, NULL) != 0) {
+        free(t);
+        return NULL;
+    }
+    if (pthread_cond_init(&t->wake, NULL) != 0) {
+        pthread_mutex_destroy(&t->lock);
+        free(t);
+        return NULL;
+    }
+    if (pthread_cond_init(&t->done, NULL) != 0) {
+        pthread_cond_destroy(&t->wake);
+        pthread_mutex_destroy(&t->lock);
+        free(t);
+        return NULL;
+    }
+#endif
+    j->tierup = t;
+    return t;
+}
+
+/* Tier record for f with a fresh data cell; the caller compiles the tier-0
+   body against &cell->count and then calls tierup_emit_trampoline and
+   tierup_publish. */
+static lr_tier_func_t *tierup_new_func(lr_jit_t *j, lr_func_t *f) {
+    if (!f || !f->name || !f->name[0] || !tierup_state(j))
+        return NULL;
+    size_t off = align_up(j->data_size, 16);
+    if (off + sizeof(lr_tier_cell_t) > j->data_cap)
+        return NULL;
+    lr_tier_func_t *tf = lr_arena_new(j->arena, lr_tier_func_t);
+    if (!tf)
+        return NULL;
+    tf->cell = (lr_tier_cell_t *)(void *)(j->data_buf + off);
+    memset(tf->cell, 0, sizeof(*tf->cell));
+    j->data_size = off + sizeof(lr_tier_cell_t);
+    tf->name = f->name;
+    tf->codegen_flags = j->codegen_flags;
+    tf->cpu_features = j->cpu_features;
+    tf->state = LR_TIER_PROFILING;
+    return tf;
+}
+
+/*
+ * Entry trampoline: bump cell->count, then jump to cell->body.
+ *   x86_64:  mov r11, cell; inc qword [r11 + 8]; jmp qword [r11]
+ *   aarch64: ldr x16, =cell; ldr x17, [x16, #8]; add x17, x17, #1;
+ *            str x17, [x16, #8]; ldr x16, [x16]; br x16
+ * r11 and x16/x17 are call-clobbered scratch at function entry.  When
+ * fixup_ctx is given, the function's symbol there is moved onto the
+ * trampoline so calls from the same batch go through it as well.
+ */
+static void *tierup_emit_trampoline(lr_jit_t *j, lr_objfile_ctx_t *fixup_ctx,
+                                    lr_tier_func_t *tf, void *body) {
+    static const uint32_t a64_insns[6] = {
+        0x580000D0u, 0xF9400611u, 0x91000631u,
+        0xF9000611u, 0xF9400210u, 0xD61F0200u,
+    };
+    static const uint8_t x86_tail[7] = {
+        0x49, 0xFF, 0x43, 0x08, 0x41, 0xFF, 0x23,
+    };
+    bool x86 = strcmp(j->target->name, "x86_64") == 0;
+    size_t off = align_up(j->code_size, 16);
+    size_t len = x86 ? 17u : 32u;
+    uint64_t cell = (uint64_t)(uintptr_t)tf->cell;
+    if (!body || off + len > j->code_limit)
+        return NULL;
+
+    if (x86) {
+        j->code_buf[off] = 0x49;
+        j->code_buf[off + 1] = 0xBB;
+        if (write_u64(j->code_buf, j->code_cap, (uint32_t)off + 2u, cell) != 0)
+            return NULL;
+        memcpy(j->code_buf + off + 10, x86_tail, sizeof(x86_tail));
+    } else {
+        for (uint32_t i = 0; i < 6; i++) {
+            if (write_u32(j->code_buf, j->code_cap, (uint32_t)off + 4u * i,
+                          a64_insns[i]) != 0)
+                return NULL;
+        }
+        if (write_u64(j->code_buf, j->code_cap, (uint32_t)off + 24u, cell) != 0)
+            return NULL;
+    }
+    if (fixup_ctx) {
+        uint32_t sym_idx = lr_obj_ensure_symbol(fixup_ctx, tf->name, true, 1,
+                                                (uint32_t)off);
+        if (sym_idx == UINT32_MAX)
+            return NULL;
+        fixup_ctx->symbols[sym_idx].offset = (uint32_t)off;
+    }
+    j->code_size = off + len;
+    tf->cell->body = body;
+    return j->code_buf + off;
+}
+
+/* Copy what recompiling f needs out of m into a module of tf's own: f
+   with its body, and the functions and globals it names as syms (m's
+   symbol cache) resolves them, callees without their bodies.  Runs on
+   the owning thread, so the recompile never reads m, which may change
+   or be freed once lr_jit_add_module returns. */
+static int tierup_snapshot(lr_tier_func_t *tf, lr_module_t *m, lr_func_t *f,
+                           const lr_objfile_ctx_t *syms) {
+    lr_arena_t *arena = lr_arena_create(16 * 1024);
+    lr_module_t *dm = arena ? lr_module_create(arena) : NULL;
+    lr_func_t *df = dm ? lr_module_copy_func(dm, f, true) : NULL;
+    if (!df)
+        goto fail;
+    dm->opt_level = m->opt_level;
+    /* Copying f interned every name it uses; callee headers add none.
+       Of a global, codegen only asks whether it is defined here. */
+    for (uint32_t i = 0, n = dm->num_symbols; i < n; i++) {
+        const char *name = dm->symbol_names[i];
+        uint32_t sid = module_symbol_id(m, name, symbol_hash(name));
+        lr_func_t *sf;
+        if (i == df->symbol_id)
+            continue;
+        if (sid < syms->module_sym_count) {
+            sf = syms->module_sym_funcs[sid];
+            if (!sf && syms->module_sym_defined[sid] &&
+                !lr_global_create(dm, name, dm->type_i8, false))
+                goto fail;
+        } else {
+            sf = lr_module_lookup_function(m, name);
+        }
+        if (sf && !lr_module_copy_func(dm, sf, false))
+            goto fail;
+    }
+    dm->local_function_collision_scan_dirty = false;
+    tf->arena = arena;
+    tf->module = dm;
+    tf->func = df;
+    return 0;
+
+fail:
+    if (arena)
+        lr_arena_destroy(arena);
+    return -1;
+}
+
+static void tierup_release_snapshot(lr_tier_func_t *tf) {
+    if (tf->arena)
+        lr_arena_destroy(tf->arena);
+    tf->arena = NULL;
+    tf->module = NULL;
+    tf->func = NULL;
+}
+
+/* Recompile tf's snapshot with the optimizing pipeline into malloc'd code
+   plus name-based relocations, like the prefetch workers.  Runs off the
+   owning thread and only touches tf, which it has claimed; the
+   relocations name symbols in tf->arena, so that lives until install. */
+static int tierup_compile(const lr_jit_tierup_t *t, lr_tier_func_t *tf) {
+    int rc = -1;
+    lr_arena_t *arena = lr_arena_create(64 * 1024);
+    uint8_t *scratch_buf = (uint8_t *)malloc(t->code_cap);
+    lr_objfile_ctx_t fixup_ctx;
+    memset(&fixup_ctx, 0, sizeof(fixup_ctx));
+    if (!arena || !scratch_buf)
+        goto done;
+    /* Finalizing here would run passes and allocate in the module arena
+       off the owning thread; tierup_snapshot only copies finalized IR. */
+    if (!tf->func || !lr_func_is_finalized(tf->func))
+        goto done;
+
+    fixup_ctx.preserve_symbol_names = true;
+    if (jit_build_module_symbol_cache(&fixup_ctx, tf->module) != 0)
+        goto done;
+    tf->module->obj_ctx = &fixup_ctx;
+
+    lr_jit_t worker_jit;
+    memset(&worker_jit, 0, sizeof(worker_jit));
+    worker_jit.target = t->target;
+    worker_jit.mode = LR_COMPILE_ISEL;
+    worker_jit.codegen_flags = tf->codegen_flags | LR_CODEGEN_REGALLOC;
+    worker_jit.cpu_features = tf->cpu_features;
+    worker_jit.code_buf = scratch_buf;
+    worker_jit.code_cap = t->code_cap;
+    worker_jit.code_limit = t->code_cap;
+    worker_jit.arena = arena;
+
+    if (compile_one_function(&worker_jit, tf->module, tf->func, &fixup_ctx,
+                             NULL, NULL) != 0 ||
+        worker_jit.code_size == 0)
+        goto done;
+
+    tf->code = (uint8_t *)malloc(worker_jit.code_size);
+    if (!tf->code)
+        goto done;
+    memcpy(tf->code, scratch_buf, worker_jit.code_size);
+    tf->code_len = worker_jit.code_size;
+    if (capture_function_relocs(&fixup_ctx, 0, 0, &tf->relocs, &tf->num_relocs) != 0)
+        goto done;
+    rc = 0;
+
+done:
+    if (tf->module)
+        tf->module->obj_ctx = NULL;
+    if (rc != 0) {
+        free(tf->code);
+        tf->code = NULL;
+        tf->code_len = 0;
+        free(tf->relocs);
+        tf->relocs = NULL;
+        tf->num_relocs = 0;
+        tierup_release_snapshot(tf);
+    }
+    jit_free_obj_ctx(&fixup_ctx);
+    free(scratch_buf);
+    if (arena)
+        lr_arena_destroy(arena);
+    return rc;
+}
+
+/* Claim the first profiling function over the threshold (lock held). */
+static lr_tier_func_t *tierup_claim_hot(lr_jit_tierup_t *t) {
+    if (t->threshold == 0)
+        return NULL;
+    for (lr_tier_func_t *tf = t->funcs; tf; tf = tf->next) {
+        if (tf->state != LR_TIER_PROFILING)
+            continue;
+        if (__atomic_load_n(&tf->cell->count, __ATOMIC_RELAXED) < t->threshold)
+            continue;
+        tf->state = LR_TIER_COMPILING;
+        t->num_compiling++;
+        return tf;
+    }
+    return NULL;
+}
+
+/* Record a recompilation result (lock held). */
+static void tierup_finish(lr_jit_tierup_t *t, lr_tier_func_t *tf, int rc) {
+    tf->state = rc == 0 ? LR_TIER_READY : LR_TIER_FAILED;
+    t->num_compiling--;
+    if (rc == 0)
+        __atomic_add_fetch(&t->num_ready, 1u, __ATOMIC_RELEASE);
+#if LR_HAS_PTHREADS
+    pthread_cond_broadcast(&t->done);
+#endif
+}
+
+#if LR_HAS_PTHREADS
+static void *tierup_thread_main(void *arg) {
+    lr_jit_tierup_t *t = (lr_jit_tierup_t *)arg;
+    pthread_mutex_lock(&t->lock);
+    while (!t->stop) {
+        lr_tier_func_t *tf = tierup_claim_hot(t);
+        if (!tf) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += TIERUP_POLL_NS;
+            if (ts.tv_nsec >= 1000000000L) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000L;
+            }
+            (void)pthread_cond_timedwait(&t->wake, &t->lock, &ts);
+            continue;
+        }
+        pthread_mutex_unlock(&t->lock);
+        int rc = tierup_compile(t, tf);
+        pthread_mutex_lock(&t->lock);
+        tierup_finish(t, tf, rc);
+    }
+    pthread_mutex_unlock(&t->lock);
+    return NULL;
+}
+#endif
+
+/* Snapshot f and make tf visible to the recompiler, starting it on first
+   use.  Without a snapshot f just keeps its tier-0 code. */
+static void tierup_publish(lr_jit_t *j, lr_tier_func_t *tf, lr_module_t *m,
+                           lr_func_t *f, const lr_objfile_ctx_t *syms) {
+    lr_jit_tierup_t *t = j->tierup;
+    if (tierup_snapshot(tf, m, f, syms) != 0)
+        return;
+    tierup_lock(t);
+    tf->next = t->funcs;
+    t->funcs = tf;
+    tierup_unlock(t);
+#if LR_HAS_PTHREADS
+    if (!t->thread_started &&
+        pthread_create(&t->thread, NULL, tierup_thread_main, t) == 0)
+        t->thread_started = true;
+#endif
+}
+
+/* Copy tf's recompiled code into the code buffer and resolve its
+   relocations; callees still pending in lazy mode are materialized. */
+static int tierup_install_one(lr_jit_t *j, lr_tier_func_t *tf) {
+    size_t start = align_up(j->code_size, 16);
+    lr_objfile_ctx_t ctx;
+    int rc = -1;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.preserve_symbol_names = true;
+    if (!tf->code || tf->code_len == 0 || start + tf->code_len > j->code_limit)
+        return -1;
+
+    memcpy(j->code_buf + start, tf->code, tf->code_len);
+    j->code_size = start + tf->code_len;
+    for (uint32_t i = 0; i < tf->num_relocs; i++) {
+        const lr_cached_reloc_t *rel = &tf->relocs[i];
+        if (rel->offset >= tf->code_len)
+            goto done;
+        uint32_t sym_idx = lr_obj_ensure_symbol(&ctx, rel->symbol_name, false, 0, 0);
+        if (sym_idx == UINT32_MAX)
+            goto done;
+        lr_obj_add_reloc(&ctx, (uint32_t)start + rel->offset, sym_idx, rel->type);
+    }
+    while (1) {
+        const char *missing_symbol = NULL;
+        if (apply_jit_relocs(j, &ctx, 0, &missing_symbol) == 0)
+            break;
+        lr_lazy_func_entry_t *dep = missing_symbol
+            ? find_lazy_func_entry(j, missing_symbol, symbol_hash(missing_symbol))
+            : NULL;
+        if (!dep || dep->state != LR_LAZY_FUNC_PENDING ||
+            materialize_lazy_function(j, dep) != 0)
+            goto done;
+    }
+    tf->installed_body = j->code_buf + start;
+    rc = 0;
+
+done:
+    jit_free_obj_ctx(&ctx);
+    return rc;
+}
+
+/* Install every READY function, then retarget the trampolines once the new
+   code is executable.  Returns the number installed. */
+static uint32_t tierup_install_ready(lr_jit_t *j) {
+    lr_jit_tierup_t *t = j ? j->tierup : NULL;
+    if (!t || j->materialize_depth > 0 ||
+        __atomic_load_n(&t->num_ready, __ATOMIC_ACQUIRE) == 0)
+        return 0;
+
+    bool own_wx_transition = !j->update_active;
+    size_t code_size_before = j->code_size;
+    lr_tier_func_t *installed = NULL;
+    uint32_t count = 0;
+    if (own_wx_transition && make_writable(j) != 0)
+        return 0;
+
+    j->materialize_depth++;
+    while (1) {
+        lr_tier_func_t *tf = NULL;
+        tierup_lock(t);
+        for (lr_tier_func_t *it = t->funcs; it; it = it->next) {
+            if (it->state == LR_TIER_READY) {
+                tf = it;
+                break;
+            }
+        }
+        if (tf) {
+            tf->state = LR_TIER_INSTALLED;
+            __atomic_sub_fetch(&t->num_ready, 1u, __ATOMIC_RELEASE);
+        }
+        tierup_unlock(t);
+        if (!tf)
+            break;
+
+        if (tierup_install_one(j, tf) == 0) {
+            tf->install_next = installed;
+            installed = tf;
+        } else {
+            tierup_lock(t);
+            tf->state = LR_TIER_FAILED;
+            tierup_unlock(t);
+        }
+        free(tf->code);
+        tf->code = NULL;
+        free(tf->relocs);
+        tf->relocs = NULL;
+        tierup_release_snapshot(tf);
+    }
+    j->materialize_depth--;
+
+    if (j->update_active && j->code_size > code_size_before)
+        j->update_dirty = true;
+    if (own_wx_transition && make_executable_from(j, code_size_before) != 0)
+        return 0;
+    for (lr_tier_func_t *tf = installed; tf; tf = tf->install_next) {
+        __atomic_store_n(&tf->cell->body, tf->installed_body, __ATOMIC_RELEASE);
+        count++;
+    }
+    return count;
+}
+
+static void tierup_destroy(lr_jit_tierup_t *t) {
+    if (!t)
+        return;
+#if LR_HAS_PTHREADS
+    if (t->thread_started) {
+        pthread_mutex_lock(&t->lock);
+        t->stop = true;
+        pthread_cond_broadcast(&t->wake);
+        pthread_mutex_unlock(&t->lock);
+        (void)pthread_join(t->thread, NULL);
+    }
+    pthread_cond_destroy(&t->done);
+    pthread_cond_destroy(&t->wake);
+    pthread_mutex_destroy(&t->lock);
+#endif
+    for (lr_tier_func_t *tf = t->funcs; tf; tf = tf->next) {
+        free(tf->code);
+        free(tf->relocs);
+        tierup_release_snapshot(tf);
+    }
+    free(t);
+}
+
 static int register_lazy_module_functions(lr_jit_t *j, lr_module_t *m,
                                           lr_func_t **funcs, uint32_t nfuncs) {
     if (!j || !m)
@@ -2637,12 +3259,26 @@ static int materialize_lazy_function(lr_jit_t *j, lr_lazy_func_entry_t *entry) {
     entry->state = LR_LAZY_FUNC_COMPILING;
     entry->pending_addr = NULL;
 
+    /* Tier-0 code embeds its counter's address, so it bypasses the shared
+       materialization cache and the prefetch workers. */
+    lr_tier_func_t *tier = NULL;
+    if (jit_tierup_active(j)) {
+        tier = tierup_new_func(j, entry->func);
+        if (!tier)
+            goto done;
+    }
+
     void *func_addr = NULL;
     bool record_cache_stats = (j->materialize_depth == 1u);
-    const lr_mat_cache_entry_t *cached_entry =
-        materialize_cache_lookup(j->target, entry->module_sig, entry->module_sig_len,
-                                 entry->func_sig, entry->func_sig_len,
-                                 record_cache_stats);
+    const lr_mat_cache_entry_t *cached_entry = NULL;
+    if (!tier) {
+        cached_entry = materialize_cache_lookup(j->target, j->cpu_features,
+                                                entry->module_sig,
+                                                entry->module_sig_len,
+                                                entry->func_sig,
+                                                entry->func_sig_len,
+                                                record_cache_stats);
+    }
 
     if (cached_entry) {
         JIT_PROF_START(compile_loop);
@@ -2652,6 +3288,18 @@ static int materialize_lazy_function(lr_jit_t *j, lr_lazy_func_entry_t *entry) {
             rc = -1;
             goto done;
         }
+    } else if (tier) {
+        JIT_PROF_START(compile_loop);
+        int func_rc = compile_one_function(j, entry->module, entry->func, &fixup_ctx,
+                                           &tier->cell->count, &func_addr);
+        JIT_PROF_END(compile_loop);
+        if (func_rc != 0) {
+            rc = func_rc;
+            goto done;
+        }
+        func_addr = tierup_emit_trampoline(j, &fixup_ctx, tier, func_addr);
+        if (!func_addr)
+            goto done;
     } else {
         compiled_from_scratch = true;
         bool used_prefetched_self = false;
@@ -2689,7 +3337,8 @@ static int materialize_lazy_function(lr_jit_t *j, lr_lazy_func_entry_t *entry) {
             compiled_code_base = (uint32_t)j->code_size;
 
             JIT_PROF_START(compile_loop);
-            int func_rc = compile_one_function(j, entry->module, entry->func, &fixup_ctx, &func_addr);
+            int func_rc = compile_one_function(j, entry->module, entry->func, &fixup_ctx,
+                                               NULL, &func_addr);
             JIT_PROF_END(compile_loop);
             if (func_rc != 0) {
                 rc = func_rc;
@@ -2751,6 +3400,8 @@ static int materialize_lazy_function(lr_jit_t *j, lr_lazy_func_entry_t *entry) {
     lr_jit_add_symbol(j, entry->name, entry->pending_addr);
     entry->state = LR_LAZY_FUNC_READY;
     entry->pending_addr = NULL;
+    if (tier)
+        tierup_publish(j, tier, entry->module, entry->func, &fixup_ctx);
 
     /* Re-apply relocations after function symbols exist. */
     if (apply_module_global_relocs(j, entry->module) != 0)
@@ -2759,7 +3410,7 @@ static int materialize_lazy_function(lr_jit_t *j, lr_lazy_func_entry_t *entry) {
     if (compiled_from_scratch && compiled_code_copy &&
         entry->module_sig && entry->module_sig_len > 0 &&
         entry->func_sig && entry->func_sig_len > 0) {
-        (void)materialize_cache_insert(j->target,
+        (void)materialize_cache_insert(j->target, j->cpu_features,
                                        entry->module_sig, entry->module_sig_len,
                                        entry->func_sig, entry->func_sig_len,
                                        compiled_code_copy, compiled_code_len,
@@ -2823,6 +3474,9 @@ int lr_jit_add_module(lr_jit_t *j, lr_module_t *m) {
     }
 
     lr_module_disambiguate_local_function_collisions_if_dirty(m);
+    if (lr_module_inline_calls(m) < 0)
+        return -1;
+    lr_module_mark_fast_cc(m);
 
     bool own_wx_transition = !j->update_active;
     bool lazy_mode = jit_lazy_materialization_enabled();
@@ -2910,13 +3564,37 @@ int lr_jit_add_module(lr_jit_t *j, lr_module_t *m) {
     void **func_addrs = lr_arena_array(j->arena, void *, nfuncs);
     if (!func_addrs)
         goto done;
+    lr_tier_func_t **tiers = NULL;
+    if (jit_tierup_active(j)) {
+        tiers = lr_arena_array(j->arena, lr_tier_func_t *, nfuncs);
+        if (!tiers)
+            goto done;
+    }
     for (uint32_t i = 0; i < nfuncs; i++) {
-        int func_rc = compile_one_function(j, m, funcs[i], &fixup_ctx, &func_addrs[i]);
+        uint64_t *loop_counter = NULL;
+        if (tiers && funcs[i]->name && funcs[i]->name[0]) {
+            tiers[i] = tierup_new_func(j, funcs[i]);
+            if (!tiers[i])
+                goto done;
+            loop_counter = &tiers[i]->cell->count;
+        }
+        int func_rc = compile_one_function(j, m, funcs[i], &fixup_ctx,
+                                           loop_counter, &func_addrs[i]);
         if (func_rc != 0) {
             rc = func_rc;
             goto done;
         }
     }
+    /* Tiered functions are entered through their trampolines, including
+       calls between functions of this module. */
+    for (uint32_t i = 0; tiers && i < nfuncs; i++) {
+        if (!tiers[i])
+            continue;
+        func_addrs[i] = tierup_emit_trampoline(j, &fixup_ctx, tiers[i],
+                                               func_addrs[i]);
+        if (!func_addrs[i])
+            goto done;
+    }
     JIT_PROF_END(compile_loop);
 
     JIT_PROF_START(patch_fixups);
@@ -2932,6 +3610,8 @@ int lr_jit_add_module(lr_jit_t *j, lr_module_t *m) {
     for (uint32_t i = 0; i < nfuncs; i++) {
         if (funcs[i]->name && funcs[i]->name[0] && func_addrs[i])
             lr_jit_add_symbol(j, funcs[i]->name, func_addrs[i]);
+        if (tiers && tiers[i])
+            tierup_publish(j, tiers[i], m, funcs[i], &fixup_ctx);
     }
 
     /* Re-apply relocations after module-defined function symbols exist. */
@@ -2974,6 +3654,7 @@ void lr_jit_begin_update(lr_jit_t *j) {
 void lr_jit_end_update(lr_jit_t *j) {
     if (!j || !j->update_active)
         return;
+    (void)tierup_install_ready(j);
     size_t clear_from = j->update_dirty ? j->update_begin_code_size : j->code_size;
     (void)make_executable_from(j, clear_from);
     j->update_active = false;
@@ -2981,9 +3662,57 @@ void lr_jit_end_update(lr_jit_t *j) {
     j->update_begin_code_size = j->code_size;
 }
 
+void lr_jit_set_tierup_threshold(lr_jit_t *j, uint64_t threshold) {
+    if (!j)
+        return;
+    j->tierup_threshold = threshold;
+    if (j->tierup) {
+        tierup_lock(j->tierup);
+        j->tierup->threshold = threshold;
+#if LR_HAS_PTHREADS
+        pthread_cond_broadcast(&j->tierup->wake);
+#endif
+        tierup_unlock(j->tierup);
+    }
+}
+
+uint32_t lr_jit_tierup_poll(lr_jit_t *j, bool wait) {
+    lr_jit_tierup_t *t = j ? j->tierup : NULL;
+    if (!t)
+        return 0;
+    bool compile_here = wait;
+#if LR_HAS_PTHREADS
+    if (!t->thread_started)
+        compile_here = true;
+#else
+    compile_here = true;
+#endif
+    while (compile_here) {
+        tierup_lock(t);
+        lr_tier_func_t *tf = tierup_claim_hot(t);
+        tierup_unlock(t);
+        if (!tf)
+            break;
+        int rc = tierup_compile(t, tf);
+        tierup_lock(t);
+        tierup_finish(t, tf, rc);
+        tierup_unlock(t);
+    }
+#if LR_HAS_PTHREADS
+    if (wait) {
+        pthread_mutex_lock(&t->lock);
+        while (t->num_compiling > 0)
+            pthread_cond_wait(&t->done, &t->lock);
+        pthread_mutex_unlock(&t->lock);
+    }
+#endif
+    return tierup_install_ready(j);
+}
+
 void *lr_jit_get_symbol(lr_jit_t *j, const char *name) {
     if (!j || !name || !name[0])
         return NULL;
+    (void)tierup_install_ready(j);
     uint32_t hash = symbol_hash(name);
     void *addr = lookup_symbol_hashed(j, name, hash);
     if (addr)
@@ -3077,6 +3806,7 @@ int lr_jit_patch_relocs_from_ex(lr_jit_t *j, const struct lr_objfile_ctx *ctx,
 
 void lr_jit_destroy(lr_jit_t *j) {
     if (!j) return;
+    tierup_destroy(j->tierup);
     lr_llvm_jit_dispose(j);
     for (lr_lib_entry_t *l = j->libs; l; l = l->next) {
         if (l->handle)
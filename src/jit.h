@@ -26,6 +26,7 @@ typedef struct lr_sym_miss_entry {
 } lr_sym_miss_entry_t;
 
 typedef struct lr_lazy_func_entry lr_lazy_func_entry_t;
+typedef struct lr_jit_tierup lr_jit_tierup_t;
 
 struct lr_jit;
 typedef void *(*lr_symbol_provider_resolve_fn)(struct lr_jit *jit, const char *name);
@@ -41,12 +42,15 @@ typedef struct lr_symbol_provider {
 typedef struct lr_jit {
     const lr_target_t *target;
     lr_compile_mode_t mode;
+    uint32_t codegen_flags; /* LR_CODEGEN_* */
+    uint32_t cpu_features;  /* LR_CPU_* the emitted code may assume */
     bool map_jit_enabled;
     bool update_active;
     bool update_dirty;
     uint8_t *code_buf;
     size_t code_size;
     size_t code_cap;
+    size_t code_limit; /* code ends here; the rest of code_cap is for call stubs */
     size_t update_begin_code_size;
     uint8_t *data_buf;
     size_t data_size;
@@ -64,6 +68,8 @@ typedef struct lr_jit {
     lr_lazy_func_entry_t **lazy_func_buckets;
     uint32_t lazy_func_bucket_count;
     uint32_t materialize_depth;
+    uint64_t tierup_threshold; /* 0 = tier-up off */
+    lr_jit_tierup_t *tierup;
     lr_lib_entry_t *libs;
     lr_symbol_provider_t *symbol_providers;
     lr_symbol_provider_t *symbol_providers_tail;
@@ -95,6 +101,27 @@ void *lr_jit_get_symbol(lr_jit_t *j, const char *name);
 void *lr_jit_get_defined_function(lr_jit_t *j, const char *name);
 void *lr_jit_get_function(lr_jit_t *j, const char *name);
 void lr_jit_destroy(lr_jit_t *j);
+
+/*
+ * Tiered compilation.  With a nonzero threshold, functions of modules added
+ * afterwards start as tier-0 code (the JIT's compile mode) that bumps a
+ * per-function counter on every entry and loop-header visit, and are
+ * reached through a fixed entry trampoline, which is also the address
+ * lr_jit_get_function returns.  A background thread recompiles functions
+ * whose counter reaches the threshold with isel and linear-scan register
+ * allocation; installing a recompiled body atomically retargets its
+ * trampoline.  Installation runs on the thread that owns the JIT (it flips
+ * the code buffer's protection): in lr_jit_tierup_poll, lr_jit_get_symbol
+ * and lr_jit_end_update.  Each tiered function is copied out of its module,
+ * with the signatures of what it calls, when its tier-0 code is published,
+ * so the module may change or be freed afterwards as without tier-up.
+ * LIRIC_JIT_TIERUP sets the initial threshold (a count, or "on" for the
+ * default); only x86_64 and aarch64 tier up.
+ */
+void lr_jit_set_tierup_threshold(lr_jit_t *j, uint64_t threshold);
+/* Install recompiled bodies; with wait, first recompile every function
+   already over the threshold.  Returns the number installed. */
+uint32_t lr_jit_tierup_poll(lr_jit_t *j, bool wait);
 struct lr_objfile_ctx;
 int lr_jit_patch_relocs(lr_jit_t *j, const struct lr_objfile_ctx *ctx);
 int lr_jit_patch_relocs_from(lr_jit_t *j, const struct lr_objfile_ctx *ctx,
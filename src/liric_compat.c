@@ -2257,7 +2257,7 @@ static size_t g_embedded_runtime_archive_len = 0;
 /* Singleton JIT reused across lc_module_create() calls to avoid
    repeated 32MB mmap + hash table init per file. */
 static lr_jit_t *g_shared_jit = NULL;
-static lr_session_backend_t g_shared_jit_backend = LR_SESSION_BACKEND_COPY_PATCH;
+static lr_session_backend_t g_shared_jit_backend = LR_SESSION_BACKEND_ISEL;
 
 static int compat_path_exists(const char *path) {
     FILE *f = NULL;
@@ -2826,10 +2826,9 @@ typedef struct lc_alloca_inst {
 typedef struct lc_switch_builder {
     lc_module_compat_t *mod;
     lr_func_t *func;
-    lr_block_t *tail_block;
-    lr_block_t *default_block;
-    lc_value_t *cond;
-    uint32_t case_index;
+    lr_block_t *block;
+    lr_inst_t *inst;        /* LR_OP_SWITCH terminating block */
+    uint32_t op_cap;
 } lc_switch_builder_t;
 
 /* ---- Internal desc_to_op (same as session.c) ---- */
@@ -4018,7 +4017,7 @@ lc_context_t *lc_context_create(void) {
     ctx->type_x86_fp80->kind = LR_TYPE_X86_FP80;
     ctx->type_ptr    = lr_arena_new(ctx->type_arena, lr_type_t);
     ctx->type_ptr->kind = LR_TYPE_PTR;
-    ctx->backend = LR_SESSION_BACKEND_COPY_PATCH;
+    ctx->backend = LC_BACKEND_ISEL;
     return ctx;
 }
 
@@ -4040,14 +4039,14 @@ void lc_context_set_backend(lc_context_t *ctx, int backend) {
         ctx->backend = backend;
         break;
     default:
-        ctx->backend = LC_BACKEND_COPY_PATCH;
+        ctx->backend = LC_BACKEND_ISEL;
         break;
     }
 }
 
 int lc_context_get_backend(const lc_context_t *ctx) {
     if (!ctx)
-        return LC_BACKEND_COPY_PATCH;
+        return LC_BACKEND_ISEL;
     return ctx->backend;
 }
 
@@ -4072,7 +4071,7 @@ lc_module_compat_t *lc_module_create(lc_context_t *ctx, const char *name) {
         free(cm);
         return NULL;
     }
-    switch (ctx ? ctx->backend : LC_BACKEND_COPY_PATCH) {
+    switch (ctx ? ctx->backend : LC_BACKEND_ISEL) {
     case LC_BACKEND_COPY_PATCH:
         cm->deferred_cfg.backend = LR_SESSION_BACKEND_COPY_PATCH;
         break;
@@ -4145,6 +4144,7 @@ static bool compat_inst_has_dest(const lr_inst_t *inst) {
     case LR_OP_RET_VOID:
     case LR_OP_BR:
     case LR_OP_CONDBR:
+    case LR_OP_SWITCH:
     case LR_OP_STORE:
     case LR_OP_UNREACHABLE:
         return false;
@@ -4878,7 +4878,8 @@ bool lc_value_get_prefer_entry_dump(const lc_value_t *val) {
 
 static bool compat_is_terminator_opcode(lr_opcode_t op) {
     return op == LR_OP_RET || op == LR_OP_RET_VOID || op == LR_OP_BR ||
-           op == LR_OP_CONDBR || op == LR_OP_UNREACHABLE;
+           op == LR_OP_CONDBR || op == LR_OP_SWITCH ||
+           op == LR_OP_UNREACHABLE;
 }
 
 int lc_value_move_before_block_terminator(lc_value_t *val) {
@@ -6158,7 +6159,8 @@ bool lc_block_has_terminator(lr_block_t *block) {
     if (!block || !block->last) return false;
     lr_opcode_t op = block->last->op;
     return op == LR_OP_RET || op == LR_OP_RET_VOID || op == LR_OP_BR
-        || op == LR_OP_CONDBR || op == LR_OP_UNREACHABLE;
+        || op == LR_OP_CONDBR || op == LR_OP_SWITCH
+        || op == LR_OP_UNREACHABLE;
 }
 
 bool lc_func_uses_block_id(lr_func_t *func, lr_block_t *skip_block,
@@ -6193,97 +6195,92 @@ void lc_func_remap_block_operands_after_erase(lr_func_t *func,
     }
 }
 
-static bool compat_is_fallback_br_to_default(const lr_block_t *block,
-                                             const lr_block_t *default_block) {
-    if (!block || !block->last || !default_block)
-        return false;
-    if (block->last->op != LR_OP_BR || block->last->num_operands != 1u)
-        return false;
-    if (block->last->operands[0].kind != LR_VAL_BLOCK)
-        return false;
-    return block->last->operands[0].block_id == default_block->id;
-}
-
-static int compat_pop_last_inst(lr_block_t *block) {
-    lr_inst_t *prev = NULL;
-    lr_inst_t *cur = NULL;
-    if (!block || !block->last)
-        return -1;
-    cur = block->first;
-    while (cur && cur != block->last) {
-        prev = cur;
-        cur = cur->next;
-    }
-    if (!cur)
-        return -1;
-    if (prev)
-        prev->next = NULL;
-    else
-        block->first = NULL;
-    block->last = prev;
-    block->inst_array = NULL;
-    block->num_insts = 0;
-    if (block->func)
-        compat_invalidate_func_caches(block->func);
-    return 0;
-}
-
 lc_switch_builder_t *lc_switch_builder_create(lc_module_compat_t *mod,
                                               lr_block_t *origin,
                                               lr_func_t *func,
                                               lc_value_t *cond,
                                               lr_block_t *default_block) {
     lc_switch_builder_t *sw;
+    lr_inst_desc_t inst;
+    lr_operand_desc_t ops[2];
+    lr_inst_t *prev_last;
     if (!mod || !origin || !func || !cond || !default_block)
         return NULL;
 
     (void)lc_block_attach(mod, default_block);
-    lc_create_br(mod, origin, default_block);
+    if (!default_block->func &&
+        block_bind_func_internal(mod, default_block, func) != 0)
+        return NULL;
+    if (default_block->func != func)
+        return NULL;
+
+    /* Cases are appended to this one instruction by add_case; direct
+       sessions defer backend emission to function end, so the block IR
+       is what gets compiled. */
+    memset(&inst, 0, sizeof(inst));
+    ops[0] = lc_value_to_desc(cond);
+    ops[1] = block_operand_desc(default_block);
+    inst.op = LR_OP_SWITCH;
+    inst.type = mod->mod->type_void;
+    inst.operands = ops;
+    inst.num_operands = 2;
+    prev_last = origin->last;
+    (void)compat_emit(mod, origin, func, &inst);
+    if (!origin->last || origin->last == prev_last ||
+        origin->last->op != LR_OP_SWITCH)
+        return NULL;
 
     sw = (lc_switch_builder_t *)calloc(1, sizeof(*sw));
     if (!sw)
         return NULL;
     sw->mod = mod;
     sw->func = func;
-    sw->tail_block = origin;
-    sw->default_block = default_block;
-    sw->cond = cond;
-    sw->case_index = 0;
+    sw->block = origin;
+    sw->inst = origin->last;
+    sw->op_cap = sw->inst->num_operands;
     return sw;
 }
 
 int lc_switch_builder_add_case(lc_switch_builder_t *sw,
                                lc_value_t *on_value,
                                lr_block_t *dest_block) {
-    char name_buf[64];
-    lc_value_t *next_val;
-    lr_block_t *next_block;
-    lc_value_t *cmp;
+    lr_operand_desc_t val_desc;
+    lr_operand_desc_t blk_desc;
+    lr_inst_t *inst;
 
-    if (!sw || !sw->mod || !sw->func || !sw->tail_block || !sw->default_block ||
-        !sw->cond || !on_value || !dest_block) {
+    if (!sw || !sw->mod || !sw->func || !sw->block || !sw->inst ||
+        !on_value || !dest_block) {
         return -1;
     }
-
-    (void)lc_block_attach(sw->mod, dest_block);
-    if (!compat_is_fallback_br_to_default(sw->tail_block, sw->default_block))
+    inst = sw->inst;
+    if (sw->block->last != inst)
         return -1;
-    if (compat_pop_last_inst(sw->tail_block) != 0)
+    val_desc = lc_value_to_desc(on_value);
+    if (val_desc.kind != LR_OP_KIND_IMM_I64)
         return -1;
 
-    snprintf(name_buf, sizeof(name_buf), "switch.case.%u", sw->case_index++);
-    next_val = lc_block_create(sw->mod, sw->func, name_buf);
-    next_block = lc_value_get_block(next_val);
-    if (!next_block)
+    (void)lc_block_attach(sw->mod, dest_block);
+    if (!dest_block->func &&
+        block_bind_func_internal(sw->mod, dest_block, sw->func) != 0)
         return -1;
-
-    cmp = lc_create_icmp_eq(sw->mod, sw->tail_block, sw->func, sw->cond,
-                            on_value, "switch.cmp");
-    if (!cmp)
+    if (dest_block->func != sw->func)
         return -1;
-    lc_create_cond_br(sw->mod, sw->tail_block, cmp, dest_block, next_block);
-    lc_create_br(sw->mod, next_block, sw->default_block);
-    sw->tail_block = next_block;
+    blk_desc = block_operand_desc(dest_block);
+
+    if (inst->num_operands + 2u > sw->op_cap) {
+        uint32_t cap = sw->op_cap < 8u ? 8u : sw->op_cap * 2u;
+        lr_operand_t *ops = lr_arena_array_uninit(sw->mod->mod->arena,
+                                                  lr_operand_t, cap);
+        if (!ops)
+            return -1;
+        memcpy(ops, inst->operands,
+               (size_t)inst->num_operands * sizeof(*ops));
+        inst->operands = ops;
+        sw->op_cap = cap;
+    }
+    inst->operands[inst->num_operands++] = compat_desc_to_operand(&val_desc);
+    inst->operands[inst->num_operands++] = compat_desc_to_operand(&blk_desc);
+    compat_invalidate_func_caches(sw->func);
     return 0;
 }
 
@@ -7573,6 +7570,13 @@ static bool block_branches_to(const lr_block_t *pred, uint32_t succ_block_id) {
             return true;
         }
     }
+    if (term->op == LR_OP_SWITCH) {
+        for (uint32_t oi = 1; oi < term->num_operands; oi++) {
+            if (term->operands[oi].kind == LR_VAL_BLOCK &&
+                term->operands[oi].block_id == succ_block_id)
+                return true;
+        }
+    }
     return false;
 }
 
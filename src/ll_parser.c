@@ -103,9 +103,14 @@ typedef struct lr_parser {
     void *on_func_ctx;
 
     lr_func_t *cur_func;
+    /* Block receiving loads of wide vector constants; NULL outside a
+       function body and while parsing phi incoming values. */
+    lr_block_t *cur_block;
+    uint32_t const_vec_seq;
     lr_session_t *session;
 } lr_parser_t;
 
+static bool shared_local_name(const char *name);
 static const char *scoped_local_global_name(lr_parser_t *p, const char *name);
 
 static void error(lr_parser_t *p, const char *fmt, ...) {
@@ -775,6 +780,9 @@ static lr_operand_t parse_typed_operand(lr_parser_t *p);
 static bool bind_vreg_type(lr_parser_t *p, uint32_t vreg,
                            lr_type_t *expected_type, const char *name,
                            size_t name_len);
+static void emit_inst(lr_parser_t *p, lr_block_t *block, lr_opcode_t op,
+                      lr_type_t *type, uint32_t dest, lr_operand_t *ops,
+                      uint32_t nops);
 
 static lr_type_t *call_result_type(lr_type_t *ty, bool *is_vararg_out,
                                    uint32_t *fixed_args_out) {
@@ -926,6 +934,18 @@ static void skip_attr_payload(lr_parser_t *p) {
 }
 
 /* Skip attribute annotations we don't care about */
+static bool token_equals(const lr_token_t *tok, const char *s) {
+    size_t n = strlen(s);
+    if (!tok || tok->len != n)
+        return false;
+    return memcmp(tok->start, s, n) == 0;
+}
+
+static bool token_is_poison(const lr_token_t *tok) {
+    return tok->kind == LR_TOK_UNDEF ||
+           (tok->kind == LR_TOK_LOCAL_ID && token_equals(tok, "poison"));
+}
+
 static void skip_attrs(lr_parser_t *p) {
     while (true) {
         if (p->cur.kind == LR_TOK_NSW || p->cur.kind == LR_TOK_NUW ||
@@ -950,7 +970,8 @@ static void skip_attrs(lr_parser_t *p) {
                 next(p);
             continue;
         }
-        if (is_bare_identifier(&p->cur)) {
+        /* `poison` lexes as a bare word but is an operand, not an attr. */
+        if (is_bare_identifier(&p->cur) && !token_is_poison(&p->cur)) {
             next(p);
             skip_attr_payload(p);
             continue;
@@ -959,11 +980,21 @@ static void skip_attrs(lr_parser_t *p) {
     }
 }
 
-static bool token_equals(const lr_token_t *tok, const char *s) {
-    size_t n = strlen(s);
-    if (!tok || tok->len != n)
-        return false;
-    return memcmp(tok->start, s, n) == 0;
+/* `tail`, `musttail` and `notail` precede `call` as bare words. */
+static uint8_t parse_tail_marker(lr_parser_t *p) {
+    uint8_t tail;
+    if (!is_bare_identifier(&p->cur))
+        return LR_CALL_TAIL_NONE;
+    if (token_equals(&p->cur, "tail"))
+        tail = LR_CALL_TAIL;
+    else if (token_equals(&p->cur, "musttail"))
+        tail = LR_CALL_MUSTTAIL;
+    else if (token_equals(&p->cur, "notail"))
+        tail = LR_CALL_TAIL_NONE;
+    else
+        return LR_CALL_TAIL_NONE;
+    next(p);
+    return tail;
 }
 
 static void skip_memory_qualifiers(lr_parser_t *p) {
@@ -1114,6 +1145,53 @@ static lr_operand_t parse_struct_constant_fields(lr_parser_t *p,
 
 #define AGG_FIELDS_MAX 16u
 
+/* Vectors wider than an immediate become a load from a private constant
+   global emitted ahead of the instruction being parsed. */
+static lr_operand_t materialize_vector_constant(lr_parser_t *p,
+                                                lr_type_t *type,
+                                                const uint8_t *bytes,
+                                                size_t size) {
+    char name[64];
+    lr_global_t *g;
+    uint32_t sym;
+    uint32_t dest;
+    size_t i;
+
+    for (i = 0; i < size && bytes[i] == 0; i++) {}
+    if (i == size)
+        return lr_op_imm_i64(0, type);
+    if (!p->cur_func)
+        return (lr_operand_t){ .kind = LR_VAL_UNDEF, .type = type };
+
+    snprintf(name, sizeof(name), ".lc.constagg.ll.%llx.%u",
+             (unsigned long long)(uintptr_t)p->module, p->const_vec_seq++);
+    if (p->session) {
+        if (lr_session_global(p->session, name, type, true, bytes, size) ==
+            UINT32_MAX) {
+            error(p, "failed to materialize vector constant");
+            return (lr_operand_t){ .kind = LR_VAL_UNDEF, .type = type };
+        }
+        p->module->last_global->is_local = true;
+    } else {
+        g = lr_global_create(p->module, name, type, true);
+        g->init_data = lr_arena_array(p->arena, uint8_t, size);
+        memcpy(g->init_data, bytes, size);
+        g->init_size = size;
+        g->is_local = true;
+    }
+    sym = lr_frontend_intern_symbol(p->module,
+                                    lr_arena_strdup(p->arena, name,
+                                                    strlen(name)));
+    /* Phi incomings have no block to hold the load; hand the backend the
+       constant's global typed as the vector so the edge copy reads it. */
+    if (!p->cur_block)
+        return lr_op_global(sym, type);
+    dest = lr_vreg_new(p->cur_func);
+    lr_operand_t ops[1] = {lr_op_global(sym, p->module->type_ptr)};
+    emit_inst(p, p->cur_block, LR_OP_LOAD, type, dest, ops, 1);
+    return lr_op_vreg(dest, type);
+}
+
 static lr_operand_t parse_aggregate_constant_operand(lr_parser_t *p, lr_type_t *type) {
     if (check(p, LR_TOK_LBRACE) && type && type->kind == LR_TYPE_STRUCT) {
         lr_operand_t fields[AGG_FIELDS_MAX];
@@ -1125,7 +1203,8 @@ static lr_operand_t parse_aggregate_constant_operand(lr_parser_t *p, lr_type_t *
         uint64_t elem_count = 0;
         size_t elem_size = 0;
         size_t total_size = 0;
-        uint8_t packed[8] = {0};
+        uint8_t packed_small[8] = {0};
+        uint8_t *packed = packed_small;
         uint64_t parsed = 0;
         next(p);
         if (type && type->kind == LR_TYPE_VECTOR &&
@@ -1133,9 +1212,16 @@ static lr_operand_t parse_aggregate_constant_operand(lr_parser_t *p, lr_type_t *
             elem_count = type->array.count;
             elem_size = lr_type_size(type->array.elem);
             total_size = lr_type_size(type);
-            can_pack = (elem_size > 0 && total_size > 0 && total_size <= sizeof(packed));
+            can_pack = elem_size > 0 && total_size > 0;
+            if (can_pack && total_size > sizeof(packed_small)) {
+                packed = lr_arena_array(p->arena, uint8_t, total_size);
+                can_pack = packed != NULL;
+            }
             while (!check(p, LR_TOK_RANGLE) && !check(p, LR_TOK_EOF)) {
                 lr_operand_t elem = parse_typed_operand(p);
+                if (elem.kind != LR_VAL_IMM_I64 && elem.kind != LR_VAL_IMM_F64 &&
+                    elem.kind != LR_VAL_UNDEF)
+                    can_pack = false;
                 if (can_pack && parsed < elem_count) {
                     size_t off = (size_t)parsed * elem_size;
                     if (off + elem_size <= total_size) {
@@ -1151,6 +1237,9 @@ static lr_operand_t parse_aggregate_constant_operand(lr_parser_t *p, lr_type_t *
             expect(p, LR_TOK_RANGLE);
             if (can_pack && parsed == elem_count) {
                 int64_t packed_val = 0;
+                if (total_size > sizeof(packed_small))
+                    return materialize_vector_constant(p, type, packed,
+                                                       total_size);
                 memcpy(&packed_val, packed, total_size);
                 return lr_op_imm_i64(packed_val, type);
             }
@@ -1190,7 +1279,7 @@ static lr_operand_t parse_operand(lr_parser_t *p, lr_type_t *type) {
         next(p);
         return lr_op_null(type);
     }
-    if (check(p, LR_TOK_UNDEF)) {
+    if (token_is_poison(&p->cur)) {
         next(p);
         return (lr_operand_t){ .kind = LR_VAL_UNDEF, .type = type };
     }
@@ -1497,9 +1586,16 @@ static uint32_t stream_emit(lr_parser_t *p, lr_opcode_t op, lr_type_t *type,
                              uint32_t num_indices, uint32_t align,
                              int icmp_pred,
                              int fcmp_pred, bool call_external_abi,
-                             bool call_vararg, uint32_t call_fixed_args) {
-    lr_operand_desc_t desc_ops[66];
-    uint32_t n = nops < 66 ? nops : 66;
+                             bool call_vararg, uint32_t call_fixed_args,
+                             uint8_t call_tail) {
+    lr_operand_desc_t desc_ops_buf[66];
+    lr_operand_desc_t *desc_ops = desc_ops_buf;
+    uint32_t n = nops;
+    if (nops > 66) {
+        desc_ops = lr_arena_array_uninit(p->arena, lr_operand_desc_t, nops);
+        if (!desc_ops)
+            return 0;
+    }
     for (uint32_t i = 0; i < n; i++)
         operand_to_desc(&ops[i], &desc_ops[i]);
 
@@ -1518,6 +1614,7 @@ static uint32_t stream_emit(lr_parser_t *p, lr_opcode_t op, lr_type_t *type,
     desc.call_external_abi = call_external_abi;
     desc.call_vararg = call_vararg;
     desc.call_fixed_args = call_fixed_args;
+    desc.call_tail = call_tail;
 
     return lr_session_emit(p->session, &desc, NULL);
 }
@@ -1541,7 +1638,7 @@ static void emit_inst(lr_parser_t *p, lr_block_t *block, lr_opcode_t op,
     record_dest_type(p, dest, inst_result_type(p, op, type));
     if (p->session) {
         stream_emit(p, op, type, dest, ops, nops, NULL, 0, 0, 0, 0,
-                    false, false, 0);
+                    false, false, 0, 0);
     } else {
         lr_inst_t *inst = lr_inst_create(p->arena, op, type, dest, ops, nops);
         lr_block_append(block, inst);
@@ -1554,7 +1651,7 @@ static void emit_alloca(lr_parser_t *p, lr_block_t *block, lr_type_t *type,
     record_dest_type(p, dest, p->module->type_ptr);
     if (p->session) {
         stream_emit(p, LR_OP_ALLOCA, type, dest, ops, nops, NULL, 0, align,
-                    0, 0, false, false, 0);
+                    0, 0, false, false, 0, 0);
     } else {
         lr_inst_t *inst = lr_inst_create(p->arena, LR_OP_ALLOCA, type, dest,
                                          ops, nops);
@@ -1563,13 +1660,20 @@ static void emit_alloca(lr_parser_t *p, lr_block_t *block, lr_type_t *type,
     }
 }
 
+/* icmp/fcmp yield i1, or <N x i1> when comparing <N x T>. */
+static lr_type_t *cmp_result_type(lr_parser_t *p, const lr_type_t *ty) {
+    if (ty && ty->kind == LR_TYPE_VECTOR)
+        return lr_type_vector(p->arena, p->module->type_i1, ty->array.count);
+    return p->module->type_i1;
+}
+
 static void emit_icmp(lr_parser_t *p, lr_block_t *block, lr_type_t *type,
                        uint32_t dest, lr_operand_t *ops, uint32_t nops,
                        int pred) {
     record_dest_type(p, dest, type);
     if (p->session) {
         stream_emit(p, LR_OP_ICMP, type, dest, ops, nops, NULL, 0, 0,
-                    pred, 0, false, false, 0);
+                    pred, 0, false, false, 0, 0);
     } else {
         lr_inst_t *inst = lr_inst_create(p->arena, LR_OP_ICMP, type,
                                          dest, ops, nops);
@@ -1584,7 +1688,7 @@ static void emit_fcmp(lr_parser_t *p, lr_block_t *block, lr_type_t *type,
     record_dest_type(p, dest, type);
     if (p->session) {
         stream_emit(p, LR_OP_FCMP, type, dest, ops, nops, NULL, 0, 0,
-                    0, pred, false, false, 0);
+                    0, pred, false, false, 0, 0);
     } else {
         lr_inst_t *inst = lr_inst_create(p->arena, LR_OP_FCMP, type,
                                          dest, ops, nops);
@@ -1593,20 +1697,30 @@ static void emit_fcmp(lr_parser_t *p, lr_block_t *block, lr_type_t *type,
     }
 }
 
+/* Unnamed non-void calls still get a vreg of their own: vreg 0 may be a
+   named value, and the passes assume one def per vreg.  The session
+   allocates one itself when handed 0. */
+static uint32_t unnamed_call_dest(lr_parser_t *p, const lr_type_t *ret_ty) {
+    if (p->session || !ret_ty || ret_ty->kind == LR_TYPE_VOID)
+        return 0;
+    return lr_vreg_new(p->cur_func);
+}
+
 static void emit_call(lr_parser_t *p, lr_block_t *block, lr_type_t *ret_ty,
                        uint32_t dest, lr_operand_t *ops, uint32_t nops,
                        bool vararg, uint32_t fixed_args,
-                       bool external_abi) {
+                       bool external_abi, uint8_t tail) {
     record_dest_type(p, dest, ret_ty);
     if (p->session) {
         stream_emit(p, LR_OP_CALL, ret_ty, dest, ops, nops, NULL, 0, 0,
-                    0, 0, external_abi, vararg, fixed_args);
+                    0, 0, external_abi, vararg, fixed_args, tail);
     } else {
         lr_inst_t *inst = lr_inst_create(p->arena, LR_OP_CALL, ret_ty,
                                          dest, ops, nops);
         inst->call_vararg = vararg;
         inst->call_fixed_args = fixed_args;
         inst->call_external_abi = external_abi;
+        inst->call_tail = tail;
         lr_block_append(block, inst);
     }
 }
@@ -1619,7 +1733,7 @@ static void emit_with_indices(lr_parser_t *p, lr_block_t *block,
     record_dest_type(p, dest, type);
     if (p->session) {
         stream_emit(p, op, type, dest, ops, nops, indices, num_indices, 0,
-                    0, 0, false, false, 0);
+                    0, 0, false, false, 0, 0);
     } else {
         lr_inst_t *inst = lr_inst_create(p->arena, op, type, dest, ops, nops);
         inst->indices = lr_arena_array(p->arena, uint32_t, num_indices);
@@ -1647,7 +1761,7 @@ static lr_operand_t canonicalize_gep_index_operand(lr_parser_t *p,
         lr_operand_t cast_ops[1] = {*op};
         if (p->session) {
             stream_emit(p, LR_OP_SEXT, p->module->type_i64, tmp_vreg,
-                        cast_ops, 1, NULL, 0, 0, 0, 0, false, false, 0);
+                        cast_ops, 1, NULL, 0, 0, 0, 0, false, false, 0, 0);
         } else {
             lr_inst_t *cast = lr_inst_create(p->arena, LR_OP_SEXT,
                                              p->module->type_i64,
@@ -1661,11 +1775,66 @@ static lr_operand_t canonicalize_gep_index_operand(lr_parser_t *p,
     return out;
 }
 
+/* Parse a shufflevector mask "<N x i32> <i32 a, ...>" (or zeroinitializer,
+   undef, poison) into a malloc'd lane array; undef lanes are UINT32_MAX. */
+static bool parse_shuffle_mask(lr_parser_t *p, uint32_t **out,
+                               uint32_t *out_count) {
+    lr_type_t *mask_ty = parse_type(p);
+    uint32_t *mask = NULL;
+    uint32_t n = 0;
+    uint32_t cap = 0;
+    uint32_t lanes;
+
+    if (!mask_ty || mask_ty->kind != LR_TYPE_VECTOR || mask_ty->array.count == 0) {
+        error(p, "shufflevector mask must be a vector");
+        return false;
+    }
+    lanes = (uint32_t)mask_ty->array.count;
+    if (!ensure_array_capacity(p, (void **)&mask, &cap, lanes, lanes,
+                               sizeof(*mask), "shufflevector mask"))
+        return false;
+    if (match(p, LR_TOK_LANGLE)) {
+        while (!check(p, LR_TOK_RANGLE) && !check(p, LR_TOK_EOF) && n < lanes) {
+            (void)parse_type(p);
+            if (check(p, LR_TOK_INT_LIT)) {
+                mask[n++] = (uint32_t)p->cur.int_val;
+            } else if (token_is_poison(&p->cur)) {
+                mask[n++] = UINT32_MAX;
+            } else {
+                error(p, "expected constant shufflevector mask lane");
+                free(mask);
+                return false;
+            }
+            next(p);
+            if (!match(p, LR_TOK_COMMA))
+                break;
+        }
+        expect(p, LR_TOK_RANGLE);
+    } else if (match(p, LR_TOK_ZEROINITIALIZER)) {
+        for (; n < lanes; n++)
+            mask[n] = 0;
+    } else if (token_is_poison(&p->cur)) {
+        next(p);
+        for (; n < lanes; n++)
+            mask[n] = UINT32_MAX;
+    }
+    if (n != lanes) {
+        error(p, "malformed shufflevector mask");
+        free(mask);
+        return false;
+    }
+    *out = mask;
+    *out_count = n;
+    return true;
+}
+
 static void parse_instruction(lr_parser_t *p, lr_func_t *func, lr_block_t *block) {
+    p->cur_block = block;
     /* Check for label: */
     if (check(p, LR_TOK_LOCAL_ID)) {
         /* Could be: %x = ... or a label. Peek ahead for = */
         lr_token_t saved = p->cur;
+        size_t saved_pos = p->lex.pos;
         next(p);
         if (check(p, LR_TOK_EQUALS)) {
             /* %x = instruction */
@@ -1673,6 +1842,7 @@ static void parse_instruction(lr_parser_t *p, lr_func_t *func, lr_block_t *block
             name_view_t dest_name = tok_name_view(&saved);
             uint32_t dest = resolve_vreg_n(p, dest_name.s, dest_name.len);
 
+            uint8_t call_tail = parse_tail_marker(p);
             lr_tok_t op_tok = p->cur.kind;
             next(p);
             skip_attrs(p);
@@ -1743,7 +1913,7 @@ static void parse_instruction(lr_parser_t *p, lr_func_t *func, lr_block_t *block
                 expect(p, LR_TOK_COMMA);
                 lr_operand_t rhs = parse_operand(p, ty);
                 lr_operand_t ops[2] = {lhs, rhs};
-                emit_icmp(p, block, p->module->type_i1, dest, ops, 2, pred);
+                emit_icmp(p, block, cmp_result_type(p, ty), dest, ops, 2, pred);
                 break;
             }
 
@@ -1845,7 +2015,7 @@ static void parse_instruction(lr_parser_t *p, lr_func_t *func, lr_block_t *block
                 for (uint32_t i = 0; i < nargs; i++) all_ops[i + 1] = args[i];
                 emit_call(p, block, ret_ty, dest, all_ops, nargs + 1,
                           call_sig_vararg, call_sig_fixed,
-                          callee.kind != LR_VAL_GLOBAL);
+                          callee.kind != LR_VAL_GLOBAL, call_tail);
                 free(all_ops);
                 free(args);
                 /* skip trailing attribute groups */
@@ -1931,6 +2101,7 @@ static void parse_instruction(lr_parser_t *p, lr_func_t *func, lr_block_t *block
             }
 
             case LR_TOK_PHI: {
+                p->cur_block = NULL;
                 lr_type_t *ty = parse_type(p);
                 lr_operand_t *ops = NULL;
                 uint32_t nops = 0;
@@ -1996,50 +2167,45 @@ static void parse_instruction(lr_parser_t *p, lr_func_t *func, lr_block_t *block
             }
 
             case LR_TOK_LOCAL_ID: {
-                if (!token_equals(&p->prev, "extractelement") &&
-                    !token_equals(&p->prev, "insertelement")) {
-                    error(p, "unknown instruction '%.*s'", (int)p->prev.len, p->prev.start);
-                    break;
-                }
                 if (token_equals(&p->prev, "extractelement")) {
-                    lr_operand_t src = parse_typed_operand(p);
-                    uint32_t idx = 0;
+                    lr_operand_t vec = parse_typed_operand(p);
                     lr_type_t *result_ty = p->module->type_i64;
                     expect(p, LR_TOK_COMMA);
-                    {
-                        lr_operand_t idx_op = parse_typed_operand(p);
-                        if (idx_op.kind == LR_VAL_IMM_I64) {
-                            idx = (uint32_t)idx_op.imm_i64;
-                        } else {
-                            error(p, "extractelement currently requires constant index");
-                        }
-                    }
-                    if (src.type &&
-                        (src.type->kind == LR_TYPE_ARRAY ||
-                         src.type->kind == LR_TYPE_VECTOR))
-                        result_ty = src.type->array.elem;
-                    lr_operand_t ops[1] = {src};
-                    uint32_t idx_arr[1] = {idx};
-                    emit_with_indices(p, block, LR_OP_EXTRACTVALUE, result_ty,
-                                      dest, ops, 1, idx_arr, 1);
-                } else {
-                    lr_operand_t agg = parse_typed_operand(p);
+                    lr_operand_t idx = parse_typed_operand(p);
+                    if (vec.type && vec.type->kind == LR_TYPE_VECTOR)
+                        result_ty = vec.type->array.elem;
+                    lr_operand_t ops[2] = {vec, idx};
+                    emit_inst(p, block, LR_OP_EXTRACTELEMENT, result_ty,
+                              dest, ops, 2);
+                } else if (token_equals(&p->prev, "insertelement")) {
+                    lr_operand_t vec = parse_typed_operand(p);
                     expect(p, LR_TOK_COMMA);
-                    lr_operand_t val = parse_typed_operand(p);
+                    lr_operand_t elt = parse_typed_operand(p);
                     expect(p, LR_TOK_COMMA);
-                    uint32_t idx = 0;
-                    {
-                        lr_operand_t idx_op = parse_typed_operand(p);
-                        if (idx_op.kind == LR_VAL_IMM_I64) {
-                            idx = (uint32_t)idx_op.imm_i64;
-                        } else {
-                            error(p, "insertelement currently requires constant index");
-                        }
-                    }
-                    lr_operand_t ops[2] = {agg, val};
-                    uint32_t idx_arr[1] = {idx};
-                    emit_with_indices(p, block, LR_OP_INSERTVALUE, agg.type,
-                                      dest, ops, 2, idx_arr, 1);
+                    lr_operand_t idx = parse_typed_operand(p);
+                    lr_operand_t ops[3] = {vec, elt, idx};
+                    emit_inst(p, block, LR_OP_INSERTELEMENT, vec.type,
+                              dest, ops, 3);
+                } else if (token_equals(&p->prev, "shufflevector")) {
+                    lr_operand_t v1 = parse_typed_operand(p);
+                    expect(p, LR_TOK_COMMA);
+                    lr_operand_t v2 = parse_typed_operand(p);
+                    expect(p, LR_TOK_COMMA);
+                    uint32_t *mask = NULL;
+                    uint32_t nmask = 0;
+                    if (!parse_shuffle_mask(p, &mask, &nmask))
+                        break;
+                    lr_type_t *result_ty = v1.type;
+                    if (v1.type && v1.type->kind == LR_TYPE_VECTOR)
+                        result_ty = lr_type_vector(p->arena,
+                                                   v1.type->array.elem,
+                                                   nmask);
+                    lr_operand_t ops[2] = {v1, v2};
+                    emit_with_indices(p, block, LR_OP_SHUFFLEVECTOR,
+                                      result_ty, dest, ops, 2, mask, nmask);
+                    free(mask);
+                } else {
+                    error(p, "unknown instruction '%.*s'", (int)p->prev.len, p->prev.start);
                 }
                 break;
             }
@@ -2097,7 +2263,7 @@ static void parse_instruction(lr_parser_t *p, lr_func_t *func, lr_block_t *block
                 expect(p, LR_TOK_COMMA);
                 lr_operand_t rhs = parse_operand(p, ty);
                 lr_operand_t ops[2] = {lhs, rhs};
-                emit_fcmp(p, block, p->module->type_i1, dest, ops, 2, pred);
+                emit_fcmp(p, block, cmp_result_type(p, ty), dest, ops, 2, pred);
                 break;
             }
 
@@ -2150,7 +2316,8 @@ static void parse_instruction(lr_parser_t *p, lr_func_t *func, lr_block_t *block
                 for (uint32_t i = 0; i < nargs; i++) all_ops[i + 1] = args[i];
                 emit_call(p, block, ret_ty, dest, all_ops, nargs + 1,
                           call_sig_vararg, call_sig_fixed,
-                          callee.kind != LR_VAL_GLOBAL);
+                          callee.kind != LR_VAL_GLOBAL,
+                          LR_CALL_TAIL_NONE);
                 free(all_ops);
                 free(args);
                 skip_attrs(p);
@@ -2188,10 +2355,12 @@ static void parse_instruction(lr_parser_t *p, lr_func_t *func, lr_block_t *block
            as a bare identifier - shouldn't happen at instruction level.
            Let's re-process as a label. */
         p->cur = saved;
+        p->lex.pos = saved_pos;
         /* fall through to label check below */
     }
 
     /* terminators and void instructions */
+    uint8_t call_tail = parse_tail_marker(p);
     lr_tok_t op_tok = p->cur.kind;
 
     if (op_tok == LR_TOK_RET) {
@@ -2305,15 +2474,20 @@ static void parse_instruction(lr_parser_t *p, lr_func_t *func, lr_block_t *block
     if (op_tok == LR_TOK_SWITCH) {
         next(p);
         lr_type_t *val_ty = parse_type(p);
-        lr_operand_t val = parse_operand(p, val_ty);
+        lr_operand_t *ops = NULL;
+        uint32_t nops = 0;
+        uint32_t ops_cap = 0;
+        if (!ensure_array_capacity(p, (void **)&ops, &ops_cap, 2u, 16u,
+                                   sizeof(*ops), "switch operand list"))
+            return;
+        ops[nops++] = parse_operand(p, val_ty);
         expect(p, LR_TOK_COMMA);
         expect(p, LR_TOK_LABEL);
         name_view_t dname = tok_name_view(&p->cur);
         next(p);
-        uint32_t default_id = resolve_block_n(p, dname.s, dname.len);
+        ops[nops++] = lr_op_block(resolve_block_n(p, dname.s, dname.len));
 
-        struct { int64_t case_val; uint32_t block_id; } cases[256];
-        uint32_t ncases = 0;
+        /* Cases stay on one LR_OP_SWITCH; the backend picks the lowering. */
         expect(p, LR_TOK_LBRACKET);
         while (!check(p, LR_TOK_RBRACKET) && !check(p, LR_TOK_EOF) &&
                !p->had_error) {
@@ -2325,58 +2499,25 @@ static void parse_instruction(lr_parser_t *p, lr_func_t *func, lr_block_t *block
             name_view_t cname = tok_name_view(&p->cur);
             next(p);
             uint32_t cid = resolve_block_n(p, cname.s, cname.len);
-            if (ncases < 256) {
-                cases[ncases].case_val = cv;
-                cases[ncases].block_id = cid;
-                ncases++;
+            if (!ensure_array_capacity(p, (void **)&ops, &ops_cap,
+                                       nops + 2u, 16u, sizeof(*ops),
+                                       "switch operand list")) {
+                free(ops);
+                return;
             }
+            ops[nops++] = lr_op_imm_i64(cv, val_ty);
+            ops[nops++] = lr_op_block(cid);
         }
         expect(p, LR_TOK_RBRACKET);
 
-        if (ncases == 0) {
-            lr_operand_t ops[1] = {lr_op_block(default_id)};
-            emit_inst(p, block, LR_OP_BR, p->module->type_void, 0, ops, 1);
+        if (nops == 2) {
+            emit_inst(p, block, LR_OP_BR, p->module->type_void, 0,
+                      &ops[1], 1);
         } else {
-            for (uint32_t ci = 0; ci < ncases; ci++) {
-                uint32_t cmp_dest = lr_vreg_new(func);
-                lr_operand_t cmp_ops[2] = {
-                    val, lr_op_imm_i64(cases[ci].case_val, val_ty)
-                };
-                emit_icmp(p, block, p->module->type_i1, cmp_dest,
-                          cmp_ops, 2, LR_ICMP_EQ);
-
-                uint32_t next_id;
-                if (ci + 1 < ncases) {
-                    char buf[32];
-                    snprintf(buf, sizeof(buf), "switch.%u.%u", block->id, ci);
-                    lr_block_t *nb = lr_block_create(func, p->arena, buf);
-                    next_id = nb->id;
-                } else {
-                    next_id = default_id;
-                }
-
-                lr_operand_t br_ops[3] = {
-                    lr_op_vreg(cmp_dest, p->module->type_i1),
-                    lr_op_block(cases[ci].block_id),
-                    lr_op_block(next_id)
-                };
-                emit_inst(p, block, LR_OP_CONDBR, p->module->type_void,
-                          0, br_ops, 3);
-
-                if (ci + 1 < ncases) {
-                    block = func->block_array ? NULL :
-                        func->last_block;
-                    if (!block) {
-                        error(p, "switch lowering lost block");
-                        return;
-                    }
-                    if (p->session) {
-                        lr_session_adopt_block(p->session, block->id,
-                                               block, NULL);
-                    }
-                }
-            }
+            emit_inst(p, block, LR_OP_SWITCH, p->module->type_void, 0,
+                      ops, nops);
         }
+        free(ops);
         return;
     }
 
@@ -2429,9 +2570,9 @@ static void parse_instruction(lr_parser_t *p, lr_func_t *func, lr_block_t *block
         }
         all_ops[0] = callee;
         for (uint32_t i = 0; i < nargs; i++) all_ops[i + 1] = args[i];
-        emit_call(p, block, ret_ty, 0, all_ops, nargs + 1,
-                  call_sig_vararg, call_sig_fixed,
-                  callee.kind != LR_VAL_GLOBAL);
+        emit_call(p, block, ret_ty, unnamed_call_dest(p, ret_ty), all_ops,
+                  nargs + 1, call_sig_vararg, call_sig_fixed,
+                  callee.kind != LR_VAL_GLOBAL, call_tail);
         free(all_ops);
         free(args);
         skip_attrs(p);
@@ -2487,9 +2628,10 @@ static void parse_instruction(lr_parser_t *p, lr_func_t *func, lr_block_t *block
         }
         all_ops[0] = callee;
         for (uint32_t i = 0; i < nargs; i++) all_ops[i + 1] = args[i];
-        emit_call(p, block, ret_ty, 0, all_ops, nargs + 1,
-                  call_sig_vararg, call_sig_fixed,
-                  callee.kind != LR_VAL_GLOBAL);
+        emit_call(p, block, ret_ty, unnamed_call_dest(p, ret_ty), all_ops,
+                  nargs + 1, call_sig_vararg, call_sig_fixed,
+                  callee.kind != LR_VAL_GLOBAL,
+                  LR_CALL_TAIL_NONE);
         free(all_ops);
         free(args);
         skip_attrs(p);
@@ -2599,6 +2741,7 @@ static void parse_function_body(lr_parser_t *p, lr_func_t *func, char **param_na
 
     expect(p, LR_TOK_RBRACE);
     p->cur_func = NULL;
+    p->cur_block = NULL;
 }
 
 static lr_type_t *parse_param_type(lr_parser_t *p) {
@@ -2611,6 +2754,9 @@ static void parse_function_def(lr_parser_t *p, bool is_decl) {
     char *name = NULL;
     const char *func_name = NULL;
     bool linkage_local = false;
+    /* skip_attrs() swallows a leading linkage keyword, so note it here;
+       only the loop below decides name scoping. */
+    bool local_func = check(p, LR_TOK_INTERNAL) || check(p, LR_TOK_PRIVATE);
 
     skip_attrs(p);
     while (check(p, LR_TOK_EXTERNAL) || check(p, LR_TOK_INTERNAL) ||
@@ -2632,6 +2778,8 @@ static void parse_function_def(lr_parser_t *p, bool is_decl) {
     func_name = name;
     if (linkage_local && name && name[0])
         func_name = scoped_local_global_name(p, name);
+    local_func = !is_decl && (local_func || linkage_local) &&
+                 !shared_local_name(name);
     next(p);
 
     expect(p, LR_TOK_LPAREN);
@@ -2712,6 +2860,7 @@ static void parse_function_def(lr_parser_t *p, bool is_decl) {
             if (func->next_vreg == 0)
                 func->next_vreg = 1;
             func->uses_llvm_abi = true;
+            func->is_local = local_func;
             uint32_t sym_id = lr_frontend_intern_symbol(p->module, func_name);
             if (linkage_local)
                 register_global_override(p, name, sym_id);
@@ -2736,8 +2885,10 @@ static void parse_function_def(lr_parser_t *p, bool is_decl) {
                                                       ret_type, params,
                                                       nparams, vararg,
                                                       is_decl, &sym_id);
-        if (func)
+        if (func) {
             func->uses_llvm_abi = true;
+            func->is_local = local_func;
+        }
         if (linkage_local)
             register_global_override(p, name, sym_id);
         else if (resolve_global(p, name) == UINT32_MAX)
@@ -2970,8 +3121,9 @@ static void parse_aggregate_initializer(lr_parser_t *p, lr_global_t *g,
         expect(p, LR_TOK_RANGLE);
 }
 
-static const char *scoped_local_global_name(lr_parser_t *p, const char *name) {
-    const char *local_tag = ".__liric_local.";
+/* Local symbols that every module emits under the same name and that
+   are shared across modules rather than scoped to one. */
+static bool shared_local_name(const char *name) {
     static const char *const k_shared_prefixes[] = {
         "__lfortran_module_init_",
         "_copy_",
@@ -2982,17 +3134,25 @@ static const char *scoped_local_global_name(lr_parser_t *p, const char *name) {
         "_VTable_",
         "__module_file_common_block_",
     };
+    if (!name)
+        return false;
+    for (size_t i = 0; i < sizeof(k_shared_prefixes) / sizeof(k_shared_prefixes[0]); i++) {
+        size_t prefix_len = strlen(k_shared_prefixes[i]);
+        if (strncmp(name, k_shared_prefixes[i], prefix_len) == 0)
+            return true;
+    }
+    return false;
+}
+
+static const char *scoped_local_global_name(lr_parser_t *p, const char *name) {
+    const char *local_tag = ".__liric_local.";
     char suffix[32];
     size_t n;
-    size_t i;
     char *scoped;
     if (!p || !p->module || !name || !name[0] || strstr(name, local_tag) != NULL)
         return name;
-    for (i = 0; i < sizeof(k_shared_prefixes) / sizeof(k_shared_prefixes[0]); i++) {
-        size_t prefix_len = strlen(k_shared_prefixes[i]);
-        if (strncmp(name, k_shared_prefixes[i], prefix_len) == 0)
-            return name;
-    }
+    if (shared_local_name(name))
+        return name;
     snprintf(suffix, sizeof(suffix), "%p", (void *)p->module);
     n = strlen(name) + strlen(local_tag) + strlen(suffix) + 1u;
     scoped = lr_arena_array(p->arena, char, n);
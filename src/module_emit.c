@@ -92,6 +92,8 @@ int lr_emit_module_object_path_mode(lr_module_t *module,
         return 0;
     }
 
+    if (module->opt_level < opt_level)
+        module->opt_level = opt_level;
     out = fopen(path, "wb");
     if (!out) {
         emit_err(err, err_cap, "cannot open output file: %s", path);
@@ -162,6 +164,8 @@ int lr_emit_module_object_stream(lr_module_t *module,
 #endif
     }
 
+    if (module->opt_level < opt_level)
+        module->opt_level = opt_level;
     if (lr_emit_object(module, target, out) != 0) {
         emit_err(err, err_cap, "object emission failed");
         return -1;
@@ -201,6 +205,8 @@ int lr_emit_module_executable_path_mode(lr_module_t *module,
         return 0;
     }
 
+    if (module->opt_level < opt_level)
+        module->opt_level = opt_level;
     out = fopen(path, "wb");
     if (!out) {
         emit_err(err, err_cap, "cannot open output file: %s", path);
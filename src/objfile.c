@@ -1494,6 +1494,12 @@ static int obj_build_module(lr_module_t *m, const lr_target_t *target,
     }
 
     lr_module_disambiguate_local_function_collisions_if_dirty(m);
+    if (lr_module_inline_calls(m) < 0) {
+        lr_arena_destroy(arena);
+        obj_build_result_destroy(out);
+        return -1;
+    }
+    lr_module_mark_fast_cc(m);
     out->ctx.preserve_symbol_names = preserve_symbol_names;
     m->obj_ctx = &out->ctx;
     if (lr_obj_build_symbol_cache(&out->ctx, m) != 0) {
@@ -0,0 +1,228 @@
+#include "platform_cpu.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#define LR_CPU_HAVE_CPUID 1
+#endif
+
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#define LR_CPU_HAVE_AUXV 1
+#endif
+
+#if defined(__aarch64__) && defined(__APPLE__)
+#include <sys/sysctl.h>
+#define LR_CPU_HAVE_SYSCTL 1
+#endif
+
+#define LR_CPU_X86_ALL (LR_CPU_X86_POPCNT | LR_CPU_X86_LZCNT | \
+                        LR_CPU_X86_BMI1 | LR_CPU_X86_BMI2 |     \
+                        LR_CPU_X86_SSE41 | LR_CPU_X86_AVX2 |    \
+                        LR_CPU_X86_FMA)
+#define LR_CPU_A64_ALL (LR_CPU_A64_LSE | LR_CPU_A64_FP16 | \
+                        LR_CPU_A64_DOTPROD | LR_CPU_A64_CSSC)
+
+static const struct {
+    const char *name;
+    uint32_t bit;
+} k_cpu_feature_names[] = {
+    {"popcnt", LR_CPU_X86_POPCNT}, {"lzcnt", LR_CPU_X86_LZCNT},
+    {"bmi", LR_CPU_X86_BMI1},      {"bmi2", LR_CPU_X86_BMI2},
+    {"sse4.1", LR_CPU_X86_SSE41},  {"avx2", LR_CPU_X86_AVX2},
+    {"fma", LR_CPU_X86_FMA},       {"lse", LR_CPU_A64_LSE},
+    {"fullfp16", LR_CPU_A64_FP16}, {"dotprod", LR_CPU_A64_DOTPROD},
+    {"cssc", LR_CPU_A64_CSSC},
+};
+
+#ifdef LR_CPU_HAVE_CPUID
+/* XCR0 via xgetbv; AVX state must be enabled by the OS, not just the CPU. */
+static uint64_t cpu_xgetbv0(void) {
+    uint32_t lo, hi;
+    __asm__ volatile(".byte 0x0f, 0x01, 0xd0" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static uint32_t cpu_probe_x86(void) {
+    unsigned a, b, c, d;
+    uint32_t f = 0;
+    bool avx_os = false;
+    if (__get_cpuid(1, &a, &b, &c, &d)) {
+        if (c & (1u << 19))
+            f |= LR_CPU_X86_SSE41;
+        if (c & (1u << 23))
+            f |= LR_CPU_X86_POPCNT;
+        if ((c & (1u << 27)) && (c & (1u << 28)))
+            avx_os = (cpu_xgetbv0() & 0x6u) == 0x6u;
+        if (avx_os && (c & (1u << 12)))
+            f |= LR_CPU_X86_FMA;
+    }
+    if (__get_cpuid(0x80000001u, &a, &b, &c, &d) && (c & (1u << 5)))
+        f |= LR_CPU_X86_LZCNT;
+    if (__get_cpuid_count(7, 0, &a, &b, &c, &d)) {
+        if (b & (1u << 3))
+            f |= LR_CPU_X86_BMI1;
+        if (b & (1u << 8))
+            f |= LR_CPU_X86_BMI2;
+        if (avx_os && (b & (1u << 5)))
+            f |= LR_CPU_X86_AVX2;
+    }
+    return f;
+}
+#endif
+
+#ifdef LR_CPU_HAVE_AUXV
+static uint32_t cpu_probe_a64(void) {
+    unsigned long hw = getauxval(AT_HWCAP);
+    uint32_t f = 0;
+    if (hw & (1ul << 8))    /* HWCAP_ATOMICS */
+        f |= LR_CPU_A64_LSE;
+    if ((hw & (1ul << 9)) && (hw & (1ul << 10))) /* FPHP, ASIMDHP */
+        f |= LR_CPU_A64_FP16;
+    if (hw & (1ul << 20))   /* HWCAP_ASIMDDP */
+        f |= LR_CPU_A64_DOTPROD;
+#ifdef AT_HWCAP2
+    if (getauxval(AT_HWCAP2) & (1ul << 34)) /* HWCAP2_CSSC */
+        f |= LR_CPU_A64_CSSC;
+#endif
+    return f;
+}
+#elif defined(LR_CPU_HAVE_SYSCTL)
+static bool cpu_sysctl_flag(const char *name) {
+    int v = 0;
+    size_t len = sizeof(v);
+    return sysctlbyname(name, &v, &len, NULL, 0) == 0 && v != 0;
+}
+
+static uint32_t cpu_probe_a64(void) {
+    uint32_t f = 0;
+    if (cpu_sysctl_flag("hw.optional.arm.FEAT_LSE"))
+        f |= LR_CPU_A64_LSE;
+    if (cpu_sysctl_flag("hw.optional.arm.FEAT_FP16"))
+        f |= LR_CPU_A64_FP16;
+    if (cpu_sysctl_flag("hw.optional.arm.FEAT_DotProd"))
+        f |= LR_CPU_A64_DOTPROD;
+    if (cpu_sysctl_flag("hw.optional.arm.FEAT_CSSC"))
+        f |= LR_CPU_A64_CSSC;
+    return f;
+}
+#endif
+
+uint32_t lr_platform_cpu_host_features(void) {
+    static bool probed;
+    static uint32_t feats;
+    if (!probed) {
+        uint32_t f = 0;
+#ifdef LR_CPU_HAVE_CPUID
+        f |= cpu_probe_x86();
+#endif
+#if defined(LR_CPU_HAVE_AUXV) || defined(LR_CPU_HAVE_SYSCTL)
+        f |= cpu_probe_a64();
+#endif
+        feats = f;
+        probed = true;
+    }
+    return feats;
+}
+
+uint32_t lr_platform_cpu_target_mask(const char *target_name) {
+    if (!target_name)
+        return 0;
+    if (strcmp(target_name, "x86_64") == 0)
+        return LR_CPU_X86_ALL;
+    if (strcmp(target_name, "aarch64") == 0 || strcmp(target_name, "arm64") == 0)
+        return LR_CPU_A64_ALL;
+    return 0;
+}
+
+bool lr_platform_cpu_target_is_host(const char *target_name) {
+    if (!target_name)
+        return false;
+#if defined(__x86_64__)
+    return strcmp(target_name, "x86_64") == 0;
+#elif defined(__aarch64__)
+    return strcmp(target_name, "aarch64") == 0 ||
+           strcmp(target_name, "arm64") == 0;
+#elif defined(__riscv) && __riscv_xlen == 64
+    return strcmp(target_name, "riscv64") == 0;
+#else
+    return false;
+#endif
+}
+
+int lr_platform_cpu_parse_features(const char *spec, uint32_t *out) {
+    uint32_t feats = 0;
+    const char *p = spec;
+    if (!out)
+        return -1;
+    while (p && *p) {
+        const char *end = strchr(p, ',');
+        size_t n = end ? (size_t)(end - p) : strlen(p);
+        bool remove = false;
+        bool found = false;
+        while (n > 0 && (*p == ' ' || *p == '\t')) {
+            p++;
+            n--;
+        }
+        while (n > 0 && (p[n - 1] == ' ' || p[n - 1] == '\t'))
+            n--;
+        if (n > 0 && (*p == '+' || *p == '-')) {
+            remove = *p == '-';
+            p++;
+            n--;
+        }
+        if (n == 0) {
+            if (remove)
+                return -1;
+        } else if ((n == 4 && memcmp(p, "host", 4) == 0) ||
+                   (n == 6 && memcmp(p, "native", 6) == 0)) {
+            if (remove)
+                feats &= ~lr_platform_cpu_host_features();
+            else
+                feats |= lr_platform_cpu_host_features();
+        } else if ((n == 8 && memcmp(p, "baseline", 8) == 0) ||
+                   (n == 4 && memcmp(p, "none", 4) == 0)) {
+            feats = 0;
+        } else {
+            for (size_t i = 0; i < sizeof(k_cpu_feature_names) /
+                                       sizeof(k_cpu_feature_names[0]); i++) {
+                const char *name = k_cpu_feature_names[i].name;
+                if (strlen(name) == n && memcmp(p, name, n) == 0) {
+                    if (remove)
+                        feats &= ~k_cpu_feature_names[i].bit;
+                    else
+                        feats |= k_cpu_feature_names[i].bit;
+                    found = true;
+                    break;
+                }
+            }
+            if (!found)
+                return -1;
+        }
+        p = end ? end + 1 : NULL;
+    }
+    *out = feats;
+    return 0;
+}
+
+size_t lr_platform_cpu_format_features(uint32_t features, char *buf,
+                                       size_t len) {
+    size_t used = 0;
+    if (buf && len > 0)
+        buf[0] = '\0';
+    for (size_t i = 0; i < sizeof(k_cpu_feature_names) /
+                               sizeof(k_cpu_feature_names[0]); i++) {
+        int n;
+        if (!(features & k_cpu_feature_names[i].bit))
+            continue;
+        n = snprintf(buf && used < len ? buf + used : NULL,
+                     buf && used < len ? len - used : 0, "%s+%s",
+                     used ? "," : "", k_cpu_feature_names[i].name);
+        if (n > 0)
+            used += (size_t)n;
+    }
+    return used;
+}
@@ -0,0 +1,47 @@
+#ifndef LIRIC_PLATFORM_CPU_H
+#define LIRIC_PLATFORM_CPU_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Optional ISA extensions the native backends can emit.  A feature set is
+   a bitmask of these; zero is the baseline every x86-64 / ARMv8.0 host
+   runs.  Bits for one architecture are ignored by the other backends. */
+enum {
+    LR_CPU_X86_POPCNT  = 1u << 0,
+    LR_CPU_X86_LZCNT   = 1u << 1,
+    LR_CPU_X86_BMI1    = 1u << 2,  /* tzcnt */
+    LR_CPU_X86_BMI2    = 1u << 3,  /* shlx/shrx/sarx */
+    LR_CPU_X86_SSE41   = 1u << 4,  /* pmulld */
+    LR_CPU_X86_AVX2    = 1u << 5,  /* 256-bit integer/FP vector ops */
+    LR_CPU_X86_FMA     = 1u << 6,  /* vfmadd */
+    LR_CPU_A64_LSE     = 1u << 16, /* ARMv8.1 atomics */
+    LR_CPU_A64_FP16    = 1u << 17, /* half-precision arithmetic */
+    LR_CPU_A64_DOTPROD = 1u << 18, /* sdot/udot */
+    LR_CPU_A64_CSSC    = 1u << 19, /* scalar cnt/ctz/abs/min/max */
+};
+
+/* Features of the CPU this process runs on (probed once, cached). */
+uint32_t lr_platform_cpu_host_features(void);
+
+/* Mask of the feature bits meaningful for a target name ("x86_64",
+   "aarch64", ...); 0 for targets without optional features. */
+uint32_t lr_platform_cpu_target_mask(const char *target_name);
+
+/* True when code for target_name executes on this host. */
+bool lr_platform_cpu_target_is_host(const char *target_name);
+
+/* Parse a comma-separated feature list (LLVM -mattr names) such as
+   "host,-avx2" or "+popcnt,+bmi2".  "host"/"native" adds every host
+   feature, "baseline"/"none" clears the set, "+name" or "name" adds and "-name"
+   removes.  Parsing starts from the empty set.  Returns 0, or -1 on an
+   unknown name (out untouched). */
+int lr_platform_cpu_parse_features(const char *spec, uint32_t *out);
+
+/* Write features as "+a,+b" (empty string for none) and return the length
+   that would have been written, like snprintf. */
+size_t lr_platform_cpu_format_features(uint32_t features, char *buf,
+                                       size_t len);
+
+#endif
@@ -7,6 +7,7 @@
 #include "llvm_backend.h"
 #include "module_emit.h"
 #include "objfile.h"
+#include "platform/platform_cpu.h"
 #include "platform/platform_os.h"
 #include "runtime_archive.h"
 #include <stdarg.h>
@@ -33,12 +34,20 @@ typedef enum session_backend {
     SESSION_BACKEND_LLVM = 3,
 } session_backend_t;
 
+typedef enum session_regalloc {
+    SESSION_REGALLOC_DEFAULT = 0,
+    SESSION_REGALLOC_NONE = 1,
+    SESSION_REGALLOC_LINEAR_SCAN = 2,
+} session_regalloc_t;
+
 /* Session config mirrors the public lr_session_config_t. */
 typedef struct session_config {
     session_mode_t mode;
     const char *target;
     session_backend_t backend;
     int opt_level;
+    session_regalloc_t regalloc;
+    const char *target_features;
 } session_config_t;
 
 /* Error mirrors the public lr_error_t. */
@@ -71,6 +80,7 @@ typedef struct session_inst_desc {
     int fcmp_pred;
     bool call_external_abi;
     bool call_vararg;
+    uint8_t call_tail;
     uint32_t call_fixed_args;
 } session_inst_desc_t;
 
@@ -205,9 +215,9 @@ struct lr_session {
 /* Derive the direct per-function compile buffer capacity from remaining JIT
    code space, so we do not rely on fixed compile-time buffer limits. */
 static size_t direct_compile_buf_capacity(const struct lr_session *s) {
-    if (!s || !s->jit || s->jit->code_cap <= s->jit->code_size)
+    if (!s || !s->jit || s->jit->code_limit <= s->jit->code_size)
         return 0;
-    return s->jit->code_cap - s->jit->code_size;
+    return s->jit->code_limit - s->jit->code_size;
 }
 
 static int ensure_block(struct lr_session *s, uint32_t block_id,
@@ -278,6 +288,7 @@ static bool is_terminator(lr_opcode_t op) {
     case LR_OP_RET_VOID:
     case LR_OP_BR:
     case LR_OP_CONDBR:
+    case LR_OP_SWITCH:
     case LR_OP_UNREACHABLE:
         return true;
     default:
@@ -291,6 +302,7 @@ static bool opcode_has_dest(lr_opcode_t op, lr_type_t *type) {
     case LR_OP_RET_VOID:
     case LR_OP_BR:
     case LR_OP_CONDBR:
+    case LR_OP_SWITCH:
     case LR_OP_UNREACHABLE:
     case LR_OP_STORE:
         return false;
@@ -624,7 +636,7 @@ static int session_backend_to_mode(session_backend_t backend,
         return -1;
     switch (backend) {
     case SESSION_BACKEND_DEFAULT:
-        *out_mode = LR_COMPILE_COPY_PATCH;
+        *out_mode = LR_COMPILE_ISEL;
         return 0;
     case SESSION_BACKEND_ISEL:
         *out_mode = LR_COMPILE_ISEL;
@@ -642,10 +654,10 @@ static int session_backend_to_mode(session_backend_t backend,
 
 static uint32_t session_runtime_archive_backend(const struct lr_session *s) {
     if (!s)
-        return (uint32_t)SESSION_BACKEND_COPY_PATCH;
+        return (uint32_t)SESSION_BACKEND_ISEL;
     switch (s->cfg.backend) {
     case SESSION_BACKEND_DEFAULT:
-        return (uint32_t)SESSION_BACKEND_COPY_PATCH;
+        return (uint32_t)SESSION_BACKEND_ISEL;
     case SESSION_BACKEND_ISEL:
         return (uint32_t)SESSION_BACKEND_ISEL;
     case SESSION_BACKEND_COPY_PATCH:
@@ -1501,7 +1513,8 @@ static int finish_direct_compile(struct lr_session *s, void **out_addr,
         lr_compile_func_meta_t meta;
         lr_arena_t *arena = s->module->arena;
 
-        if (lr_func_finalize(s->cur_func, arena) != 0) {
+        if (lr_func_inline_calls(s->cur_func, arena) < 0 ||
+            lr_func_finalize(s->cur_func, arena) != 0) {
             err_set(err, S_ERR_BACKEND, "function finalization failed");
             s->module->obj_ctx = NULL;
             if (should_close_update && s->jit->update_active)
@@ -1518,6 +1531,8 @@ static int finish_direct_compile(struct lr_session *s, void **out_addr,
         meta.num_blocks = s->cur_func->num_blocks;
         meta.next_vreg = s->cur_func->next_vreg;
         meta.mode = s->jit->mode;
+        meta.codegen_flags = s->jit->codegen_flags;
+        meta.cpu_features = s->jit->cpu_features;
         meta.jit = s->jit;
 
         rc = s->jit->target->compile_begin(
@@ -1567,7 +1582,7 @@ static int finish_direct_compile(struct lr_session *s, void **out_addr,
     /* Assign final JIT offset now that compile_end has produced the code
        in the per-function temp buffer. */
     s->compile_start = align_up_size(s->jit->code_size, 16u);
-    if (s->compile_start + code_len > s->jit->code_cap) {
+    if (s->compile_start + code_len > s->jit->code_limit) {
         err_set(err, S_ERR_BACKEND, "jit code buffer overflow");
         s->module->obj_ctx = NULL;
         if (should_close_update && s->jit->update_active)
@@ -1739,9 +1754,11 @@ static int emit_ir_instruction(struct lr_session *s, const session_inst_desc_t *
     if (inst->op == LR_OP_CALL) {
         out->call_external_abi = inst->call_external_abi;
         out->call_vararg = inst->call_vararg;
+        out->call_tail = inst->call_tail;
         out->call_fixed_args = inst->call_fixed_args;
     }
-    if ((inst->op == LR_OP_EXTRACTVALUE || inst->op == LR_OP_INSERTVALUE) &&
+    if ((inst->op == LR_OP_EXTRACTVALUE || inst->op == LR_OP_INSERTVALUE ||
+         inst->op == LR_OP_SHUFFLEVECTOR) &&
         inst->num_indices > 0) {
         out->indices = lr_arena_array(s->module->arena, uint32_t,
                                       inst->num_indices);
@@ -2214,7 +2231,7 @@ struct lr_session *lr_session_create(const void *cfg_ptr,
     const session_config_t *cfg = (const session_config_t *)cfg_ptr;
     struct lr_session *s = NULL;
     lr_arena_t *arena = NULL;
-    lr_compile_mode_t mode = LR_COMPILE_COPY_PATCH;
+    lr_compile_mode_t mode = LR_COMPILE_ISEL;
     err_clear(err);
 
     if (cfg) {
@@ -2227,8 +2244,23 @@ struct lr_session *lr_session_create(const void *cfg_ptr,
             err_set(err, S_ERR_ARGUMENT, "invalid session backend");
             return NULL;
         }
+        if (cfg->regalloc != SESSION_REGALLOC_DEFAULT &&
+            cfg->regalloc != SESSION_REGALLOC_NONE &&
+            cfg->regalloc != SESSION_REGALLOC_LINEAR_SCAN) {
+            err_set(err, S_ERR_ARGUMENT, "invalid session regalloc");
+            return NULL;
+        }
+        if (cfg->target_features) {
+            uint32_t feats = 0;
+            if (lr_platform_cpu_parse_features(cfg->target_features,
+                                               &feats) != 0) {
+                err_set(err, S_ERR_ARGUMENT,
+                        "invalid session target features");
+                return NULL;
+            }
+        }
     } else {
-        mode = LR_COMPILE_COPY_PATCH;
+        mode = LR_COMPILE_ISEL;
     }
 
     s = (struct lr_session *)calloc(1, sizeof(*s));
@@ -2242,6 +2274,8 @@ struct lr_session *lr_session_create(const void *cfg_ptr,
         s->cfg.target = cfg->target;
         s->cfg.backend = cfg->backend;
         s->cfg.opt_level = cfg->opt_level;
+        s->cfg.regalloc = cfg->regalloc;
+        s->cfg.target_features = cfg->target_features;
     }
 
     arena = lr_arena_create(0);
@@ -2259,6 +2293,7 @@ struct lr_session *lr_session_create(const void *cfg_ptr,
         err_set(err, S_ERR_BACKEND, "module allocation failed");
         return NULL;
     }
+    s->module->opt_level = s->cfg.opt_level;
 
     if (s->cfg.target && s->cfg.target[0])
         s->jit = lr_jit_create_for_target(s->cfg.target);
@@ -2271,6 +2306,14 @@ struct lr_session *lr_session_create(const void *cfg_ptr,
         return NULL;
     }
     s->jit->mode = mode;
+    if (s->cfg.regalloc == SESSION_REGALLOC_NONE)
+        s->jit->codegen_flags &= ~(uint32_t)LR_CODEGEN_REGALLOC;
+    else if (s->cfg.regalloc == SESSION_REGALLOC_LINEAR_SCAN)
+        s->jit->codegen_flags |= LR_CODEGEN_REGALLOC;
+    if (s->cfg.target_features)
+        (void)lr_cpu_features_resolve(s->jit->target->name,
+                                      s->cfg.target_features, true,
+                                      &s->jit->cpu_features);
 
     return s;
 }
@@ -3094,6 +3137,7 @@ uint32_t lr_session_emit(struct lr_session *s, const void *inst_ptr,
             compile_desc.fcmp_pred = normalized.fcmp_pred;
             compile_desc.call_external_abi = normalized.call_external_abi;
             compile_desc.call_vararg = normalized.call_vararg;
+            compile_desc.call_tail = normalized.call_tail;
             compile_desc.call_fixed_args = normalized.call_fixed_args;
             if (s->jit->target->compile_emit(s->compile_ctx,
                                               &compile_desc) != 0) {
@@ -3180,6 +3224,8 @@ int lr_session_set_module(struct lr_session *s, lr_module_t *module,
         return -1;
     }
     s->module = module;
+    if (module->opt_level < s->cfg.opt_level)
+        module->opt_level = s->cfg.opt_level;
     s->ir_module_jit_ready = false;
     return 0;
 }
@@ -3201,6 +3247,8 @@ static int session_compile_parsed_module(struct lr_session *s, lr_module_t *m,
         return -1;
     }
 
+    if (m->opt_level < s->cfg.opt_level)
+        m->opt_level = s->cfg.opt_level;
     rc = lr_jit_add_module(s->jit, m);
     if (rc != 0) {
         lr_module_free(m);
@@ -3365,7 +3413,7 @@ int lr_session_emit_object(struct lr_session *s, const char *path,
     }
 
     if (lr_emit_module_object_path_mode(s->module, s->cfg.target,
-                                        s->jit ? s->jit->mode : LR_COMPILE_COPY_PATCH,
+                                        s->jit ? s->jit->mode : LR_COMPILE_ISEL,
                                         path, s->cfg.opt_level, backend_err,
                                         sizeof(backend_err)) != 0) {
         err_set(err, S_ERR_BACKEND, "%s",
@@ -3395,7 +3443,7 @@ int lr_session_emit_object_stream(struct lr_session *s, FILE *out,
     }
 
     /* IR mode: compile from IR using session's compile mode */
-    lr_compile_mode_t mode = s->jit ? s->jit->mode : LR_COMPILE_COPY_PATCH;
+    lr_compile_mode_t mode = s->jit ? s->jit->mode : LR_COMPILE_ISEL;
     const lr_target_t *target = session_resolve_target(s);
     if (!target) {
         err_set(err, S_ERR_BACKEND, "target not found");
@@ -3496,7 +3544,7 @@ int lr_session_emit_exe(struct lr_session *s, const char *path,
     entry = session_entry_symbol(s->module);
     if (lr_emit_module_executable_path_mode(
             s->module, s->cfg.target,
-            s->jit ? s->jit->mode : LR_COMPILE_COPY_PATCH,
+            s->jit ? s->jit->mode : LR_COMPILE_ISEL,
             path, entry, s->cfg.opt_level,
             backend_err, sizeof(backend_err)) != 0) {
         err_set(err, S_ERR_BACKEND, "%s",
@@ -28,15 +28,24 @@ const lr_stencil_t *lr_stencil_at_generated(size_t index) {
 
 const lr_stencil_t *lr_stencil_lookup_generated(const char *name) {
 #ifdef LIRIC_HAVE_GENERATED_STENCILS
-    size_t i;
+    /* stencil_gen emits the table sorted by name. */
+    size_t lo = 0;
+    size_t hi = lr_generated_stencils_count;
     if (!name) {
         return NULL;
     }
-    for (i = 0; i < lr_generated_stencils_count; i++) {
-        const lr_stencil_t *st = lr_generated_stencils[i];
-        if (st && st->name && strcmp(st->name, name) == 0) {
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const lr_stencil_t *st = lr_generated_stencils[mid];
+        int cmp = strcmp(st->name, name);
+        if (cmp == 0) {
             return st;
         }
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
 #else
     (void)name;
@@ -1,20 +1,197 @@
 #include "stencil_runtime.h"
 
+#include <pthread.h>
 #include <stddef.h>
 #include <string.h>
 
-typedef struct lr_stencil_lookup_entry {
-    lr_opcode_t op;
-    lr_type_kind_t type_kind;
-    const char *name;
-} lr_stencil_lookup_entry_t;
+/*
+ * Stencil names encode their IR key as
+ *   <op>[_<pred>][_<type>][_<type>|_<nargs>][_frame][_imm]
+ * e.g. add_i32_imm, icmp_slt_i64, sitofp_i32_f64, store_i8_frame, call_i64_2.
+ * The generated table is indexed once into a small open-addressing hash so
+ * per-instruction lookups stay O(1).
+ */
+
+#define STENCIL_INDEX_SIZE 1024u
+
+typedef struct lr_stencil_index_slot {
+    uint32_t key;
+    const lr_stencil_t *st;
+} lr_stencil_index_slot_t;
+
+static lr_stencil_index_slot_t g_stencil_index[STENCIL_INDEX_SIZE];
+static pthread_once_t g_stencil_index_once = PTHREAD_ONCE_INIT;
+
+static const char *const g_stencil_op_names[] = {
+    [LR_OP_RET] = "ret", [LR_OP_BR] = "br", [LR_OP_CONDBR] = "condbr",
+    [LR_OP_ADD] = "add", [LR_OP_SUB] = "sub", [LR_OP_MUL] = "mul",
+    [LR_OP_SDIV] = "sdiv", [LR_OP_SREM] = "srem",
+    [LR_OP_UDIV] = "udiv", [LR_OP_UREM] = "urem",
+    [LR_OP_AND] = "and", [LR_OP_OR] = "or", [LR_OP_XOR] = "xor",
+    [LR_OP_SHL] = "shl", [LR_OP_LSHR] = "lshr", [LR_OP_ASHR] = "ashr",
+    [LR_OP_FADD] = "fadd", [LR_OP_FSUB] = "fsub", [LR_OP_FMUL] = "fmul",
+    [LR_OP_FDIV] = "fdiv", [LR_OP_FREM] = "frem", [LR_OP_FNEG] = "fneg",
+    [LR_OP_ICMP] = "icmp", [LR_OP_FCMP] = "fcmp", [LR_OP_ALLOCA] = "alloca",
+    [LR_OP_LOAD] = "load", [LR_OP_STORE] = "store", [LR_OP_GEP] = "gep",
+    [LR_OP_CALL] = "call", [LR_OP_PHI] = "phi", [LR_OP_SELECT] = "select",
+    [LR_OP_SEXT] = "sext", [LR_OP_ZEXT] = "zext", [LR_OP_TRUNC] = "trunc",
+    [LR_OP_BITCAST] = "bitcast", [LR_OP_PTRTOINT] = "ptrtoint",
+    [LR_OP_INTTOPTR] = "inttoptr", [LR_OP_SITOFP] = "sitofp",
+    [LR_OP_UITOFP] = "uitofp", [LR_OP_FPTOSI] = "fptosi",
+    [LR_OP_FPTOUI] = "fptoui", [LR_OP_FPEXT] = "fpext",
+    [LR_OP_FPTRUNC] = "fptrunc",
+};
+
+static const char *const g_stencil_icmp_names[] = {
+    "eq", "ne", "sgt", "sge", "slt", "sle", "ugt", "uge", "ult", "ule",
+};
+
+static const char *const g_stencil_fcmp_names[] = {
+    "false", "oeq", "ogt", "oge", "olt", "ole", "one", "ord",
+    "ueq", "ugt", "uge", "ult", "ule", "une", "uno", "true",
+};
 
-static const lr_stencil_lookup_entry_t g_stencil_lookup[] = {
-    { LR_OP_ADD,  LR_TYPE_I32,    "add_i32"  },
-    { LR_OP_SUB,  LR_TYPE_I64,    "sub_i64"  },
-    { LR_OP_FADD, LR_TYPE_DOUBLE, "fadd_f64" },
+static const struct {
+    const char *name;
+    lr_type_kind_t kind;
+} g_stencil_type_names[] = {
+    { "void", LR_TYPE_VOID }, { "i1", LR_TYPE_I1 }, { "i8", LR_TYPE_I8 },
+    { "i16", LR_TYPE_I16 }, { "i32", LR_TYPE_I32 }, { "i64", LR_TYPE_I64 },
+    { "f32", LR_TYPE_FLOAT }, { "f64", LR_TYPE_DOUBLE }, { "ptr", LR_TYPE_PTR },
 };
 
+#define STENCIL_ARRAY_LEN(a) (sizeof(a) / sizeof((a)[0]))
+
+static uint32_t stencil_key(uint32_t op, uint32_t kind, uint32_t aux, uint32_t form) {
+    return (op & 0xFFu) | ((kind & 0xFFu) << 8) | ((aux & 0xFFu) << 16) |
+           ((form & 0xFFu) << 24);
+}
+
+static uint32_t stencil_key_hash(uint32_t key) {
+    key ^= key >> 16;
+    key *= 0x7feb352du;
+    key ^= key >> 15;
+    return key & (STENCIL_INDEX_SIZE - 1u);
+}
+
+static int stencil_find_name(const char *const *names, size_t count, const char *tok) {
+    size_t i;
+    for (i = 0; i < count; i++) {
+        if (names[i] && strcmp(names[i], tok) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static int stencil_parse_key(const char *name, uint32_t *out_key) {
+    char buf[64];
+    char *toks[8];
+    size_t ntok = 0;
+    size_t ti = 1;
+    int op;
+    uint32_t kind = LR_TYPE_VOID;
+    uint32_t aux = 0;
+    uint32_t form = 0;
+    bool have_kind = false;
+    size_t len = strlen(name);
+    size_t i;
+
+    if (len == 0 || len >= sizeof(buf)) {
+        return -1;
+    }
+    memcpy(buf, name, len + 1);
+    toks[ntok++] = buf;
+    for (i = 0; i < len; i++) {
+        if (buf[i] != '_') {
+            continue;
+        }
+        if (ntok == STENCIL_ARRAY_LEN(toks)) {
+            return -1;
+        }
+        buf[i] = '\0';
+        toks[ntok++] = &buf[i + 1];
+    }
+
+    op = stencil_find_name(g_stencil_op_names, STENCIL_ARRAY_LEN(g_stencil_op_names), toks[0]);
+    if (op < 0) {
+        return -1;
+    }
+    if (op == LR_OP_ICMP || op == LR_OP_FCMP) {
+        int pred;
+        if (ntok < 2) {
+            return -1;
+        }
+        if (op == LR_OP_ICMP) {
+            pred = stencil_find_name(g_stencil_icmp_names,
+                                     STENCIL_ARRAY_LEN(g_stencil_icmp_names), toks[1]);
+        } else {
+            pred = stencil_find_name(g_stencil_fcmp_names,
+                                     STENCIL_ARRAY_LEN(g_stencil_fcmp_names), toks[1]);
+        }
+        if (pred < 0) {
+            return -1;
+        }
+        aux = (uint32_t)pred;
+        ti = 2;
+    }
+    for (; ti < ntok; ti++) {
+        const char *tok = toks[ti];
+        bool matched = false;
+        if (strcmp(tok, "imm") == 0) {
+            form |= LR_STENCIL_FORM_IMM;
+            continue;
+        }
+        if (strcmp(tok, "frame") == 0) {
+            form |= LR_STENCIL_FORM_FRAME;
+            continue;
+        }
+        if (tok[0] >= '0' && tok[0] <= '9' && tok[1] == '\0') {
+            aux = (uint32_t)(tok[0] - '0');
+            continue;
+        }
+        for (i = 0; i < STENCIL_ARRAY_LEN(g_stencil_type_names); i++) {
+            if (strcmp(g_stencil_type_names[i].name, tok) == 0) {
+                if (have_kind) {
+                    aux = (uint32_t)g_stencil_type_names[i].kind;
+                } else {
+                    kind = (uint32_t)g_stencil_type_names[i].kind;
+                    have_kind = true;
+                }
+                matched = true;
+                break;
+            }
+        }
+        if (!matched) {
+            return -1;
+        }
+    }
+    *out_key = stencil_key((uint32_t)op, kind, aux, form);
+    return 0;
+}
+
+static void stencil_index_build(void) {
+    size_t n = lr_stencil_count_generated();
+    size_t i;
+    if (n > STENCIL_INDEX_SIZE / 2u) {
+        n = STENCIL_INDEX_SIZE / 2u;
+    }
+    for (i = 0; i < n; i++) {
+        const lr_stencil_t *st = lr_stencil_at_generated(i);
+        uint32_t key;
+        uint32_t h;
+        if (!st || !st->name || stencil_parse_key(st->name, &key) != 0) {
+            continue;
+        }
+        h = stencil_key_hash(key);
+        while (g_stencil_index[h].st) {
+            h = (h + 1u) & (STENCIL_INDEX_SIZE - 1u);
+        }
+        g_stencil_index[h].key = key;
+        g_stencil_index[h].st = st;
+    }
+}
+
 static uint64_t stencil_patch_value(const lr_stencil_emit_args_t *args, lr_stencil_hole_t hole) {
     switch (hole) {
     case LR_STENCIL_HOLE_SRC0_OFF:
@@ -36,16 +213,42 @@ static uint64_t stencil_patch_value(const lr_stencil_emit_args_t *args, lr_stenc
     }
 }
 
-const lr_stencil_t *lr_stencil_lookup_for_ir(lr_opcode_t op, lr_type_kind_t type_kind) {
-    size_t i;
-    for (i = 0; i < sizeof(g_stencil_lookup) / sizeof(g_stencil_lookup[0]); i++) {
-        if (g_stencil_lookup[i].op == op && g_stencil_lookup[i].type_kind == type_kind) {
-            return lr_stencil_lookup_generated(g_stencil_lookup[i].name);
+const lr_stencil_t *lr_stencil_lookup_ex(lr_opcode_t op, lr_type_kind_t type_kind,
+                                         uint32_t aux, uint32_t form) {
+    uint32_t key;
+    uint32_t h;
+    if (lr_stencil_count_generated() == 0) {
+        return NULL;
+    }
+    (void)pthread_once(&g_stencil_index_once, stencil_index_build);
+    key = stencil_key((uint32_t)op, (uint32_t)type_kind, aux, form);
+    h = stencil_key_hash(key);
+    while (g_stencil_index[h].st) {
+        if (g_stencil_index[h].key == key) {
+            return g_stencil_index[h].st;
         }
+        h = (h + 1u) & (STENCIL_INDEX_SIZE - 1u);
     }
     return NULL;
 }
 
+const lr_stencil_t *lr_stencil_lookup_for_ir(lr_opcode_t op, lr_type_kind_t type_kind) {
+    return lr_stencil_lookup_ex(op, type_kind, 0, 0);
+}
+
+int lr_stencil_hole_offset(const lr_stencil_t *st, lr_stencil_hole_t hole) {
+    uint8_t i;
+    if (!st) {
+        return -1;
+    }
+    for (i = 0; i < st->n_relocs; i++) {
+        if (st->relocs[i].hole == hole) {
+            return (int)st->relocs[i].offset;
+        }
+    }
+    return -1;
+}
+
 int lr_stencil_emit(uint8_t **code_ptr, uint8_t *code_end,
                     const lr_stencil_t *st, const lr_stencil_emit_args_t *args,
                     bool strip_trailing_ret) {
@@ -86,13 +289,32 @@ int lr_stencil_emit(uint8_t **code_ptr, uint8_t *code_end,
     dst = *code_ptr;
     memcpy(dst, st->bytes, emit_size);
 
+    /* Fixed-size stores: a memcpy with a runtime length is an out-of-line
+       call per hole, which dominated copy-patch emission. */
     for (i = 0; i < st->n_relocs; i++) {
         const lr_stencil_reloc_t *rel = &st->relocs[i];
-        uint64_t value;
-        uint8_t *patch_site;
-        value = stencil_patch_value(args, rel->hole);
-        patch_site = dst + rel->offset;
-        memcpy(patch_site, &value, rel->size);
+        uint64_t value = stencil_patch_value(args, rel->hole);
+        uint8_t *patch_site = dst + rel->offset;
+        switch (rel->size) {
+        case 1: {
+            uint8_t v = (uint8_t)value;
+            memcpy(patch_site, &v, 1);
+            break;
+        }
+        case 2: {
+            uint16_t v = (uint16_t)value;
+            memcpy(patch_site, &v, 2);
+            break;
+        }
+        case 4: {
+            uint32_t v = (uint32_t)value;
+            memcpy(patch_site, &v, 4);
+            break;
+        }
+        default:
+            memcpy(patch_site, &value, 8);
+            break;
+        }
     }
 
     *code_ptr = dst + emit_size;
@@ -17,8 +17,22 @@ typedef struct lr_stencil_emit_args {
     uintptr_t global_addr;
 } lr_stencil_emit_args_t;
 
+/* Operand forms of a stencil, encoded as name suffixes (_frame, _imm). */
+enum {
+    LR_STENCIL_FORM_IMM = 1u << 0,   /* last value operand comes from imm64 */
+    LR_STENCIL_FORM_FRAME = 1u << 1, /* pointer operand is frame + offset */
+};
+
 const lr_stencil_t *lr_stencil_lookup_for_ir(lr_opcode_t op, lr_type_kind_t type_kind);
 
+/* aux is the icmp/fcmp predicate, the destination type kind of int<->fp
+   conversions, or the argument count of calls; 0 otherwise. */
+const lr_stencil_t *lr_stencil_lookup_ex(lr_opcode_t op, lr_type_kind_t type_kind,
+                                         uint32_t aux, uint32_t form);
+
+/* Byte offset of the first patch site for hole, or -1. */
+int lr_stencil_hole_offset(const lr_stencil_t *st, lr_stencil_hole_t hole);
+
 int lr_stencil_emit(uint8_t **code_ptr, uint8_t *code_end,
                     const lr_stencil_t *st, const lr_stencil_emit_args_t *args,
                     bool strip_trailing_ret);
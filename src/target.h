@@ -13,6 +13,12 @@ typedef enum lr_compile_mode {
     LR_COMPILE_LLVM       = 2,  /* Mode C: translate to real LLVM (optional) */
 } lr_compile_mode_t;
 
+/* Optional backend code-quality passes (lr_jit_t.codegen_flags).  Backends
+   that do not implement a pass ignore its bit. */
+enum {
+    LR_CODEGEN_REGALLOC = 1u << 0, /* linear-scan register allocation */
+};
+
 typedef struct lr_jit lr_jit_t;
 
 typedef struct lr_compile_func_meta {
@@ -24,6 +30,9 @@ typedef struct lr_compile_func_meta {
     uint32_t num_blocks;
     uint32_t next_vreg;
     lr_compile_mode_t mode;
+    uint32_t codegen_flags;
+    uint32_t cpu_features; /* LR_CPU_* (platform/platform_cpu.h) */
+    uint64_t *loop_counter; /* tier-0 profile: bumped at loop headers */
     lr_jit_t *jit;
 } lr_compile_func_meta_t;
 
@@ -40,6 +49,7 @@ typedef struct lr_compile_inst_desc {
     int fcmp_pred;
     bool call_external_abi;
     bool call_vararg;
+    uint8_t call_tail;
     uint32_t call_fixed_args;
 } lr_compile_inst_desc_t;
 
@@ -87,10 +97,19 @@ int lr_target_compile(const lr_target_t *target, lr_compile_mode_t mode,
                       lr_func_t *func, lr_module_t *mod,
                       uint8_t *buf, size_t buflen, size_t *out_len,
                       lr_arena_t *arena);
+/* loop_counter, when non-NULL, is incremented each time a loop header
+   block is entered (backends without support ignore it). */
+int lr_target_compile_ex(const lr_target_t *target, lr_compile_mode_t mode,
+                         uint32_t codegen_flags, uint32_t cpu_features,
+                         uint64_t *loop_counter,
+                         lr_func_t *func, lr_module_t *mod,
+                         uint8_t *buf, size_t buflen, size_t *out_len,
+                         lr_arena_t *arena);
 
 /* Replay a finalized function's IR through compile_set_block / compile_emit.
    Used by deferred compilation where IR is accumulated during streaming and
-   compiled after lr_func_finalize (DCE) at function end. */
+   compiled after lr_func_finalize (DCE) at function end.  Blocks flagged
+   by lr_target_cold_blocks are replayed after all other blocks. */
 int lr_replay_function_stream(const lr_target_t *target, void *compile_ctx,
                               const lr_func_t *func);
 
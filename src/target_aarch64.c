@@ -2,6 +2,7 @@
 #include "target_common.h"
 #include "target_shared.h"
 #include "objfile.h"
+#include "platform/platform_cpu.h"
 #include <limits.h>
 #include <math.h>
 #include <stdbool.h>
@@ -22,6 +23,8 @@
  * ISel and encoding are fused into a single compile pass.
  * Stack slots are allocated lazily while emitting instructions; the prologue
  * stack adjustment is patched after emission when final frame size is known.
+ * FP constants use fmov #imm when encodable and otherwise ldr (literal)
+ * from a deduplicated pool appended after the code.
  */
 
 #define FP_SCRATCH0  A64_D0
@@ -65,6 +68,20 @@ typedef struct {
     bool func_is_vararg;
     int32_t vararg_stack_start_off;
     const char *func_name;
+    uint32_t cpu_features; /* LR_CPU_A64_* the code may assume */
+    uint64_t *loop_counter;     /* tier-0 profile counter, or NULL */
+    const bool *loop_headers;   /* by block id, when loop_counter is set */
+    uint32_t num_loop_headers;
+    const uint32_t *vreg_uses;  /* operand uses by vreg, or NULL */
+    uint32_t num_vreg_uses;
+    lr_mem_inline_stats_t mem_inline;
+    lr_slot_coloring_t *slot_coloring; /* NULL: one slot per value */
+    lr_const_pool_t const_pool;
+    bool frame_pinned;          /* calls, moves sp or reads varargs */
+    size_t *teardown_pos;       /* "mov sp, x29" of each frame teardown */
+    uint32_t num_teardowns;
+    uint32_t teardown_cap;
+    uint32_t reloc_base;        /* first obj_ctx reloc of this function */
 } a64_compile_ctx_t;
 
 static size_t align_up_size(size_t value, size_t align) {
@@ -130,9 +147,9 @@ static int32_t alloc_slot(a64_compile_ctx_t *ctx, uint32_t vreg, size_t size) {
     }
 
     if (size < 8) size = 8;
-    ctx->stack_size = (uint32_t)align_up_size(ctx->stack_size, 8);
-    ctx->stack_size += (uint32_t)size;
-    int32_t offset = -(int32_t)ctx->stack_size;
+    int32_t offset = lr_target_frame_slot(ctx->slot_coloring, vreg, false,
+                                          (uint32_t)size, 8,
+                                          &ctx->stack_size);
     if (getenv("LIRIC_DBG_A64_SLOTS") != NULL) {
         fprintf(stderr,
                 "[a64 slot] func=%s vreg=%u off=%d size=%zu\n",
@@ -221,6 +238,26 @@ static uint32_t enc_msub(bool is64, uint8_t rd, uint8_t rn, uint8_t rm, uint8_t
          | ((uint32_t)ra << 10) | ((uint32_t)rn << 5) | rd;
 }
 
+/* smulh/umulh: high 64 bits of the 128-bit product */
+static uint32_t enc_mulh(bool is_signed, uint8_t rd, uint8_t rn, uint8_t rm) {
+    return (is_signed ? 0x9B407C00u : 0x9BC07C00u) | ((uint32_t)rm << 16)
+         | ((uint32_t)rn << 5) | rd;
+}
+
+/* 64-bit sbfm/ubfm; asr/lsr/sxt/uxt/ubfx are all aliases of these. */
+static uint32_t enc_bfm64(bool is_signed, uint8_t rd, uint8_t rn,
+                          uint8_t immr, uint8_t imms) {
+    return (is_signed ? 0x93400000u : 0xD3400000u)
+         | ((uint32_t)(immr & 63u) << 16) | ((uint32_t)(imms & 63u) << 10)
+         | ((uint32_t)rn << 5) | rd;
+}
+
+/* add xd, xn, xm, lsr #sh */
+static uint32_t enc_add_lsr64(uint8_t rd, uint8_t rn, uint8_t rm, uint8_t sh) {
+    return 0x8B400000u | ((uint32_t)rm << 16) | ((uint32_t)(sh & 63u) << 10)
+         | ((uint32_t)rn << 5) | rd;
+}
+
 static uint32_t enc_lslv(bool is64, uint8_t rd, uint8_t rn, uint8_t rm) {
     return (is64 ? 0x9AC02000u : 0x1AC02000u) | ((uint32_t)rm << 16)
          | ((uint32_t)rn << 5) | rd;
@@ -243,6 +280,34 @@ static uint32_t enc_csel(bool is64, uint8_t rd, uint8_t rn, uint8_t rm,
          | ((uint32_t)rn << 5) | rd;
 }
 
+static uint32_t enc_csneg(bool is64, uint8_t rd, uint8_t rn, uint8_t rm,
+                          uint8_t cond) {
+    uint32_t base = is64 ? 0xDA800400u : 0x5A800400u;
+    return base | ((uint32_t)rm << 16) | ((uint32_t)(cond & 0xF) << 12)
+         | ((uint32_t)rn << 5) | rd;
+}
+
+static uint32_t enc_clz(bool is64, uint8_t rd, uint8_t rn) {
+    return (is64 ? 0xDAC01000u : 0x5AC01000u) | ((uint32_t)rn << 5) | rd;
+}
+
+/* FEAT_CSSC scalar cnt/ctz/abs (op 0x1C00/0x1800/0x2000) and
+   smax/umax/smin/umin (op 0x6000/0x6400/0x6800/0x6C00). */
+static uint32_t enc_cssc_unary(bool is64, uint32_t op, uint8_t rd,
+                               uint8_t rn) {
+    return (is64 ? 0xDAC00000u : 0x5AC00000u) | op | ((uint32_t)rn << 5) | rd;
+}
+
+static uint32_t enc_cssc_minmax(bool is64, uint32_t op, uint8_t rd,
+                                uint8_t rn, uint8_t rm) {
+    return (is64 ? 0x9AC00000u : 0x1AC00000u) | op | ((uint32_t)rm << 16)
+         | ((uint32_t)rn << 5) | rd;
+}
+
+static uint32_t enc_rbit(bool is64, uint8_t rd, uint8_t rn) {
+    return (is64 ? 0xDAC00000u : 0x5AC00000u) | ((uint32_t)rn << 5) | rd;
+}
+
 static uint32_t enc_movz(bool is64, uint8_t rd, uint16_t imm16, uint8_t shift16) {
     uint32_t base = is64 ? 0xD2800000u : 0x52800000u;
     return base | ((uint32_t)(shift16 & 3) << 21) | ((uint32_t)imm16 << 5) | rd;
@@ -275,6 +340,28 @@ static uint32_t enc_stur(uint8_t size, uint8_t rt, uint8_t rn, int32_t imm9) {
     return base | ((uint32_t)(imm9 & 0x1FF) << 12) | ((uint32_t)rn << 5) | rt;
 }
 
+/* ldr/str rt, [rn, rm{, lsl #log2(size)}]: register offset, zero-extending
+   loads as enc_ldur. */
+static uint32_t enc_ldst_reg(bool load, uint8_t size, uint8_t rt, uint8_t rn,
+                             uint8_t rm, bool scaled) {
+    uint32_t sz = size == 1 ? 0u : size == 2 ? 1u : size == 4 ? 2u : 3u;
+    return (sz << 30) | 0x38206800u | (load ? 0x00400000u : 0u)
+         | ((uint32_t)rm << 16) | (scaled ? 0x1000u : 0u)
+         | ((uint32_t)rn << 5) | rt;
+}
+
+/* ldp/stp xt, xt2, [rn, #imm] (signed offset, imm a multiple of 8 in
+   [-512, 504]). */
+static uint32_t enc_ldp64(uint8_t rt, uint8_t rt2, uint8_t rn, int32_t imm) {
+    return 0xA9400000u | ((uint32_t)((imm / 8) & 0x7F) << 15)
+         | ((uint32_t)rt2 << 10) | ((uint32_t)rn << 5) | rt;
+}
+
+static uint32_t enc_stp64(uint8_t rt, uint8_t rt2, uint8_t rn, int32_t imm) {
+    return 0xA9000000u | ((uint32_t)((imm / 8) & 0x7F) << 15)
+         | ((uint32_t)rt2 << 10) | ((uint32_t)rn << 5) | rt;
+}
+
 static void emit_move_imm(uint8_t *buf, size_t *pos, size_t len, uint8_t rd,
                           int64_t imm, bool is64) {
     uint64_t v = (uint64_t)imm;
@@ -294,6 +381,19 @@ static void emit_move_imm_ctx(a64_compile_ctx_t *ctx, uint8_t rd,
     invalidate_cached_reg_a64(ctx, rd);
 }
 
+/* Tier-0 profiling through the IP registers: x16 = counter; x17 = [x16];
+   x17 += 1; [x16] = x17. */
+static void emit_profile_count(a64_compile_ctx_t *ctx) {
+    emit_move_imm_ctx(ctx, A64_X16, (int64_t)(uintptr_t)ctx->loop_counter,
+                      true);
+    emit_u32(ctx->buf, &ctx->pos, ctx->buflen,
+             enc_ldur(8, A64_X17, A64_X16, 0));
+    emit_u32(ctx->buf, &ctx->pos, ctx->buflen,
+             enc_add_imm(true, A64_X17, A64_X17, 1));
+    emit_u32(ctx->buf, &ctx->pos, ctx->buflen,
+             enc_stur(8, A64_X17, A64_X16, 0));
+}
+
 static void emit_sp_adjust(uint8_t *buf, size_t *pos, size_t len, uint32_t amount,
                            bool subtract) {
     while (amount > 0) {
@@ -380,6 +480,14 @@ static uint32_t enc_fadd(uint8_t fsize, uint8_t rd, uint8_t rn, uint8_t rm) {
     return base | ((uint32_t)rm << 16) | ((uint32_t)rn << 5) | rd;
 }
 
+/* fmadd: rd = rn * rm + ra, rounded once. */
+static uint32_t enc_fmadd(uint8_t fsize, uint8_t rd, uint8_t rn, uint8_t rm,
+                          uint8_t ra) {
+    uint32_t base = (fsize == 8) ? 0x1F400000u : 0x1F000000u;
+    return base | ((uint32_t)rm << 16) | ((uint32_t)ra << 10)
+         | ((uint32_t)rn << 5) | rd;
+}
+
 static uint32_t enc_fsub(uint8_t fsize, uint8_t rd, uint8_t rn, uint8_t rm) {
     uint32_t base = (fsize == 8) ? 0x1E603800u : 0x1E203800u;
     return base | ((uint32_t)rm << 16) | ((uint32_t)rn << 5) | rd;
@@ -438,6 +546,11 @@ static uint32_t enc_fmov_from_gpr(uint8_t fsize, uint8_t fd, uint8_t xn) {
     return base | ((uint32_t)xn << 5) | fd;
 }
 
+/* fmov xd, dn: raw 64-bit move out of the FP file. */
+static uint32_t enc_fmov_to_gpr(uint8_t xd, uint8_t dn) {
+    return 0x9E660000u | ((uint32_t)dn << 5) | xd;
+}
+
 static uint8_t lr_cc_to_a64(uint8_t cc) {
     switch (cc) {
     case LR_CC_EQ:  return 0;  /* eq */
@@ -527,7 +640,7 @@ static bool call_signature_matches_func(const lr_inst_t *call_inst,
         return false;
     if (call_inst->op != LR_OP_CALL)
         return false;
-    if (func->ret_type != call_inst->type)
+    if (!lr_type_same(func->ret_type, call_inst->type))
         return false;
     num_args = call_inst->num_operands > 0 ? call_inst->num_operands - 1u : 0u;
     if (func->vararg) {
@@ -538,7 +651,8 @@ static bool call_signature_matches_func(const lr_inst_t *call_inst,
     }
     for (uint32_t i = 0; i < func->num_params; i++) {
         const lr_operand_t *arg = &call_inst->operands[i + 1u];
-        if (!func->param_types || func->param_types[i] != arg->type)
+        if (!func->param_types ||
+            !lr_type_same(func->param_types[i], arg->type))
             return false;
     }
     return true;
@@ -665,6 +779,25 @@ static bool direct_call_uses_external_fp_abi(
     return call_external_abi;
 }
 
+/* Module-local callee of a direct call that takes its nargs arguments
+   under the fast_cc convention, or NULL. */
+static lr_func_t *a64_fast_cc_callee(a64_compile_ctx_t *cc,
+                                     const lr_operand_t *callee_op,
+                                     uint32_t nargs) {
+    lr_func_t *f = NULL;
+    if (!cc || !cc->mod || callee_op->kind != LR_VAL_GLOBAL)
+        return NULL;
+    if (callee_op->global_id < cc->sym_count && cc->sym_funcs)
+        f = cc->sym_funcs[callee_op->global_id];
+    if (!f)
+        f = find_module_function_for_call(
+            cc, lr_module_symbol_name(cc->mod, callee_op->global_id));
+    if (!f || !f->fast_cc || f->symbol_id != callee_op->global_id ||
+        f->num_params != nargs || nargs == 0)
+        return NULL;
+    return f;
+}
+
 static const char *normalize_llvm_symbol_name(const char *name) {
     if (!name)
         return NULL;
@@ -703,52 +836,6 @@ static uint8_t llvm_objectsize_bits(const char *name) {
     return 0;
 }
 
-typedef enum a64_int_cmp_intrinsic_kind {
-    A64_INT_CMP_INTRIN_NONE = 0,
-    A64_INT_CMP_INTRIN_UMAX,
-    A64_INT_CMP_INTRIN_UMIN,
-    A64_INT_CMP_INTRIN_SMAX,
-    A64_INT_CMP_INTRIN_SMIN
-} a64_int_cmp_intrinsic_kind_t;
-
-static a64_int_cmp_intrinsic_kind_t classify_llvm_int_cmp_intrinsic(const char *name,
-                                                                     bool *is64_out) {
-    name = normalize_llvm_symbol_name(name);
-    if (is64_out)
-        *is64_out = true;
-    if (!name)
-        return A64_INT_CMP_INTRIN_NONE;
-    if (strcmp(name, "llvm.umax.i64") == 0)
-        return A64_INT_CMP_INTRIN_UMAX;
-    if (strcmp(name, "llvm.umin.i64") == 0)
-        return A64_INT_CMP_INTRIN_UMIN;
-    if (strcmp(name, "llvm.smax.i64") == 0)
-        return A64_INT_CMP_INTRIN_SMAX;
-    if (strcmp(name, "llvm.smin.i64") == 0)
-        return A64_INT_CMP_INTRIN_SMIN;
-    if (strcmp(name, "llvm.umax.i32") == 0) {
-        if (is64_out)
-            *is64_out = false;
-        return A64_INT_CMP_INTRIN_UMAX;
-    }
-    if (strcmp(name, "llvm.umin.i32") == 0) {
-        if (is64_out)
-            *is64_out = false;
-        return A64_INT_CMP_INTRIN_UMIN;
-    }
-    if (strcmp(name, "llvm.smax.i32") == 0) {
-        if (is64_out)
-            *is64_out = false;
-        return A64_INT_CMP_INTRIN_SMAX;
-    }
-    if (strcmp(name, "llvm.smin.i32") == 0) {
-        if (is64_out)
-            *is64_out = false;
-        return A64_INT_CMP_INTRIN_SMIN;
-    }
-    return A64_INT_CMP_INTRIN_NONE;
-}
-
 static uint8_t int_type_width_bits(const lr_type_t *type) {
     size_t fallback_bits = 64;
     if (!type)
@@ -769,6 +856,17 @@ static uint8_t int_type_width_bits(const lr_type_t *type) {
     return (uint8_t)fallback_bits;
 }
 
+/* Plan for a scalar integer div/rem whose divisor is a constant. */
+static bool a64_div_const(const lr_compile_inst_desc_t *desc,
+                          const lr_operand_t *divisor, lr_div_const_t *out) {
+    bool is_signed = desc->op == LR_OP_SDIV || desc->op == LR_OP_SREM;
+    if (divisor->kind != LR_VAL_IMM_I64 || !desc->type ||
+        lr_type_size(desc->type) > 8)
+        return false;
+    return lr_target_div_const_plan(is_signed, int_type_width_bits(desc->type),
+                                    divisor->imm_i64, out);
+}
+
 static bool icmp_pred_is_signed(lr_icmp_pred_t pred) {
     return pred == LR_ICMP_SGT || pred == LR_ICMP_SGE ||
            pred == LR_ICMP_SLT || pred == LR_ICMP_SLE;
@@ -836,18 +934,9 @@ static void emit_load_operand(a64_compile_ctx_t *ctx,
             return;
         emit_load_slot(ctx, op->vreg, reg);
     } else if (op->kind == LR_VAL_IMM_F64) {
-        int64_t imm_bits = 0;
-        if (op->type && op->type->kind == LR_TYPE_FLOAT) {
-            float fv = (float)op->imm_f64;
-            uint32_t bits = 0;
-            memcpy(&bits, &fv, sizeof(bits));
-            imm_bits = (int64_t)(uint64_t)bits;
-        } else {
-            uint64_t bits = 0;
-            memcpy(&bits, &op->imm_f64, sizeof(bits));
-            imm_bits = (int64_t)bits;
-        }
-        emit_move_imm_ctx(ctx, reg, imm_bits, true);
+        uint64_t bits = 0;
+        (void)lr_target_imm_bits(op, &bits);
+        emit_move_imm_ctx(ctx, reg, (int64_t)bits, true);
     } else if (op->kind == LR_VAL_NULL || op->kind == LR_VAL_UNDEF) {
         emit_move_imm_ctx(ctx, reg, 0, true);
     } else if (op->kind == LR_VAL_GLOBAL && ctx->obj_ctx) {
@@ -943,6 +1032,14 @@ static bool a64_is_complex8_fp(const lr_type_t *t) {
     return false;
 }
 
+/* Vectors wider than a GPR, other than the complex(8) HFA, are passed by
+   address in a GP register and returned through the indirect result
+   register X8, as the PCS does for large composites. */
+static bool a64_is_wide_vector(const lr_type_t *t) {
+    return t && t->kind == LR_TYPE_VECTOR && lr_type_size(t) > 8 &&
+           !a64_is_complex16(t);
+}
+
 /* Load the address of an aggregate vreg operand's data into `reg`, whatever
    its storage form (static alloca, indirect pointer slot, or inline slot). */
 static void emit_vreg_data_addr_a64(a64_compile_ctx_t *ctx,
@@ -973,6 +1070,83 @@ static void emit_vreg_data_addr_a64(a64_compile_ctx_t *ctx,
     invalidate_cached_reg_a64(ctx, reg);
 }
 
+/* Divide the 64-bit-extended dividend in x9 by plan->divisor without a
+   div instruction.  Returns the register (x11) holding the quotient, or
+   the remainder n - q * d when want_rem.  Clobbers x10. */
+static uint8_t emit_div_const(a64_compile_ctx_t *cc, bool is_signed,
+                              bool want_rem, const lr_div_const_t *plan) {
+    switch (plan->kind) {
+    case LR_DIV_CONST_IDENT:
+        if (want_rem) {
+            emit_move_imm_ctx(cc, A64_X11, 0, true);
+            return A64_X11;
+        }
+        if (plan->negate)
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     enc_sub_reg(true, A64_X11, 31, A64_X9));
+        else
+            emit_mov_reg(cc->buf, &cc->pos, cc->buflen, A64_X11, A64_X9, true);
+        break;
+    case LR_DIV_CONST_POW2:
+        if (!is_signed) {
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     want_rem ? enc_bfm64(false, A64_X11, A64_X9, 0,
+                                          (uint8_t)(plan->shift - 1))
+                              : enc_bfm64(false, A64_X11, A64_X9,
+                                          plan->shift, 63));
+            return A64_X11;
+        }
+        /* Bias negative dividends by 2^k - 1 so asr rounds toward zero. */
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_bfm64(true, A64_X10, A64_X9, 63, 63));
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_add_lsr64(A64_X11, A64_X9, A64_X10,
+                               (uint8_t)(64 - plan->shift)));
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_bfm64(true, A64_X11, A64_X11, plan->shift, 63));
+        if (plan->negate)
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     enc_sub_reg(true, A64_X11, 31, A64_X11));
+        invalidate_cached_reg_a64(cc, A64_X10);
+        break;
+    case LR_DIV_CONST_MAGIC:
+        emit_move_imm_ctx(cc, A64_X10, (int64_t)plan->magic, true);
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_mulh(is_signed, A64_X11, A64_X9, A64_X10));
+        if (!is_signed) {
+            if (plan->fixup) {
+                emit_u32(cc->buf, &cc->pos, cc->buflen,
+                         enc_sub_reg(true, A64_X10, A64_X9, A64_X11));
+                emit_u32(cc->buf, &cc->pos, cc->buflen,
+                         enc_add_lsr64(A64_X11, A64_X11, A64_X10, 1));
+                emit_u32(cc->buf, &cc->pos, cc->buflen,
+                         enc_bfm64(false, A64_X11, A64_X11,
+                                   (uint8_t)(plan->shift - 1), 63));
+            } else {
+                emit_u32(cc->buf, &cc->pos, cc->buflen,
+                         enc_bfm64(false, A64_X11, A64_X11, plan->shift, 63));
+            }
+            break;
+        }
+        if (plan->fixup)
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     plan->fixup > 0 ? enc_add_reg(true, A64_X11, A64_X11, A64_X9)
+                                     : enc_sub_reg(true, A64_X11, A64_X11, A64_X9));
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_bfm64(true, A64_X11, A64_X11, plan->shift, 63));
+        /* Round toward zero: add one when the quotient is negative. */
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_add_lsr64(A64_X11, A64_X11, A64_X11, 63));
+        break;
+    }
+    if (want_rem) {
+        emit_move_imm_ctx(cc, A64_X10, plan->divisor, true);
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_msub(true, A64_X11, A64_X11, A64_X10, A64_X9));
+    }
+    return A64_X11;
+}
+
 static void emit_load_fp_slot(a64_compile_ctx_t *ctx,
                                uint32_t vreg, uint8_t fpreg, uint8_t fsize) {
     int32_t off = alloc_slot(ctx, vreg, 8);
@@ -985,16 +1159,100 @@ static void emit_store_fp_slot(a64_compile_ctx_t *ctx,
     emit_fp_store(ctx->buf, &ctx->pos, ctx->buflen, fpreg, A64_FP, off, fsize);
 }
 
+/* imm8 of "fmov s/d, #imm" holding the low fsize bytes of bits, or -1
+   when the value has no 8-bit form (sign, 3-bit exponent, 4-bit
+   fraction). */
+static int a64_fp_imm8(uint64_t bits, uint8_t fsize) {
+    uint32_t b;
+    if (fsize == 8) {
+        b = (uint32_t)(bits >> 61) & 1u;
+        if ((bits & 0xFFFFFFFFFFFFull) != 0 ||
+            ((bits >> 54) & 0xFFu) != (b ? 0xFFu : 0u) ||
+            ((bits >> 62) & 1u) == b)
+            return -1;
+        return (int)(((bits >> 56) & 0x80u) | (b << 6) |
+                     ((bits >> 48) & 0x3Fu));
+    }
+    bits &= 0xFFFFFFFFu;
+    b = (uint32_t)(bits >> 29) & 1u;
+    if ((bits & 0x7FFFFu) != 0 ||
+        ((bits >> 25) & 0x1Fu) != (b ? 0x1Fu : 0u) ||
+        ((bits >> 30) & 1u) == b)
+        return -1;
+    return (int)(((bits >> 24) & 0x80u) | (b << 6) | ((bits >> 19) & 0x3Fu));
+}
+
+/* Constant pool loads use ldr (literal), which reaches +-1MB; past this
+   offset the pool might not, so later constants go through X9. */
+#define A64_CONST_POOL_REACH (512u * 1024u)
+
+/* Emit the pool after the code, 8-byte aligned relative to the function
+   start, and point every ldr (literal) at its entry.  Fails if the
+   function outgrew the literal range. */
+static int emit_const_pool_a64(a64_compile_ctx_t *ctx) {
+    const lr_const_pool_t *pool = &ctx->const_pool;
+    size_t base;
+    if (pool->num_refs == 0)
+        return 0;
+    if (ctx->pos & 7u)
+        emit_u32(ctx->buf, &ctx->pos, ctx->buflen, 0); /* udf #0 */
+    base = ctx->pos;
+    for (uint32_t i = 0; i < pool->num_entries; i++) {
+        emit_u32(ctx->buf, &ctx->pos, ctx->buflen,
+                 (uint32_t)pool->entries[i]);
+        emit_u32(ctx->buf, &ctx->pos, ctx->buflen,
+                 (uint32_t)(pool->entries[i] >> 32));
+    }
+    for (uint32_t i = 0; i < pool->num_refs; i++) {
+        size_t at = pool->refs[i].pos;
+        int64_t imm = ((int64_t)(base + (size_t)pool->refs[i].entry * 8u) -
+                       (int64_t)at) / 4;
+        uint32_t insn;
+        if (imm >= (1LL << 18) || at + 4 > ctx->buflen)
+            return -1;
+        insn = ctx->buf[at] | (uint32_t)ctx->buf[at + 1] << 8 |
+               (uint32_t)ctx->buf[at + 2] << 16 |
+               (uint32_t)ctx->buf[at + 3] << 24;
+        patch_u32(ctx->buf, ctx->buflen, at,
+                  insn | (((uint32_t)imm & 0x7FFFFu) << 5));
+    }
+    return 0;
+}
+
 static void emit_load_fp_operand(a64_compile_ctx_t *ctx,
                                   const lr_operand_t *op, uint8_t fpreg,
                                   uint8_t fsize) {
+    uint64_t bits = 0;
     if (op->kind == LR_VAL_VREG) {
         emit_load_fp_slot(ctx, op->vreg, fpreg, fsize);
-    } else {
-        emit_load_operand(ctx, op, A64_X9);
-        emit_u32(ctx->buf, &ctx->pos, ctx->buflen,
-                 enc_fmov_from_gpr(fsize, fpreg, A64_X9));
+        return;
+    }
+    if (lr_target_imm_bits(op, &bits)) {
+        int imm8 = a64_fp_imm8(bits, fsize);
+        if ((fsize == 8 ? bits : (bits & 0xFFFFFFFFu)) == 0) {
+            /* fmov s/d, wzr/xzr */
+            emit_u32(ctx->buf, &ctx->pos, ctx->buflen,
+                     enc_fmov_from_gpr(fsize, fpreg, A64_SP));
+            return;
+        }
+        if (imm8 >= 0) {
+            emit_u32(ctx->buf, &ctx->pos, ctx->buflen,
+                     0x1E201000u | (fsize == 8 ? 1u << 22 : 0u) |
+                     ((uint32_t)imm8 << 13) | fpreg);
+            return;
+        }
+        /* ldr s/d, literal; the offset is patched by emit_const_pool_a64 */
+        if (ctx->pos < A64_CONST_POOL_REACH &&
+            lr_target_const_pool_use(&ctx->const_pool, ctx->arena, bits,
+                                     ctx->pos) == 0) {
+            emit_u32(ctx->buf, &ctx->pos, ctx->buflen,
+                     (fsize == 8 ? 0x5C000000u : 0x1C000000u) | fpreg);
+            return;
+        }
     }
+    emit_load_operand(ctx, op, A64_X9);
+    emit_u32(ctx->buf, &ctx->pos, ctx->buflen,
+             enc_fmov_from_gpr(fsize, fpreg, A64_X9));
 }
 
 static void emit_setcc_a64(a64_compile_ctx_t *ctx, uint8_t cc, uint8_t dst) {
@@ -1028,9 +1286,28 @@ static void emit_setcc_a64(a64_compile_ctx_t *ctx, uint8_t cc, uint8_t dst) {
     invalidate_cached_reg_a64(ctx, dst);
 }
 
-static void emit_epilogue_a64(a64_compile_ctx_t *ctx) {
+static void emit_frame_teardown_a64(a64_compile_ctx_t *ctx) {
+    if (ctx->num_teardowns >= ctx->teardown_cap) {
+        uint32_t new_cap = ctx->teardown_cap == 0 ? 4u : ctx->teardown_cap * 2u;
+        size_t *np = lr_arena_array_uninit(ctx->arena, size_t, new_cap);
+        if (np) {
+            if (ctx->num_teardowns > 0)
+                memcpy(np, ctx->teardown_pos,
+                       sizeof(size_t) * ctx->num_teardowns);
+            ctx->teardown_pos = np;
+            ctx->teardown_cap = new_cap;
+        }
+    }
+    if (ctx->num_teardowns < ctx->teardown_cap)
+        ctx->teardown_pos[ctx->num_teardowns++] = ctx->pos;
+    else
+        ctx->frame_pinned = true;
     emit_u32(ctx->buf, &ctx->pos, ctx->buflen, enc_add_imm(true, A64_SP, A64_FP, 0));
     emit_u32(ctx->buf, &ctx->pos, ctx->buflen, 0xA8C17BFDu); /* ldp x29, x30, [sp], #16 */
+}
+
+static void emit_epilogue_a64(a64_compile_ctx_t *ctx) {
+    emit_frame_teardown_a64(ctx);
     emit_u32(ctx->buf, &ctx->pos, ctx->buflen, 0xD65F03C0u); /* ret */
 }
 
@@ -1244,8 +1521,21 @@ static size_t emit_prologue_a64(a64_compile_ctx_t *ctx) {
     }
 }
 
+/* Frames that fit an imm12 (nearly all of them) take a single
+   "sub sp, sp, #size", or nothing when empty; the rest of the reserved
+   sequence becomes nops.  AAPCS64 has no red zone, so unlike x86-64 a leaf
+   still needs the adjustment whenever it has slots. */
 static void patch_prologue_stack_adjust(a64_compile_ctx_t *ctx, size_t imm_pos,
                                         uint32_t frame_stack_size) {
+    if (frame_stack_size <= 0xFFFu) {
+        patch_u32(ctx->buf, ctx->buflen, imm_pos,
+                  frame_stack_size == 0
+                      ? 0xD503201Fu /* nop */
+                      : enc_sub_imm(true, A64_SP, A64_SP, frame_stack_size));
+        for (size_t i = 1; i < 5; i++)
+            patch_u32(ctx->buf, ctx->buflen, imm_pos + i * 4u, 0xD503201Fu);
+        return;
+    }
     patch_u32(ctx->buf, ctx->buflen, imm_pos + 0,
               enc_movz(true, A64_X15, (uint16_t)(frame_stack_size & 0xFFFFu), 0));
     patch_u32(ctx->buf, ctx->buflen, imm_pos + 4,
@@ -1270,8 +1560,20 @@ typedef struct a64_deferred_term {
     lr_operand_t ops[4];
     uint32_t num_ops;
     uint32_t block_id;
+    lr_operand_t *switch_ops;   /* LR_OP_SWITCH: arena copy of all operands */
 } a64_deferred_term_t;
 
+/* Memory operand [base + (index << shift)] or, without an index,
+   [base + disp]; index is A64_NO_INDEX when absent. */
+#define A64_NO_INDEX 0xFFu
+
+typedef struct {
+    uint8_t base;
+    uint8_t index;
+    uint8_t shift;
+    int32_t disp;
+} a64_addr_t;
+
 typedef struct a64_direct_ctx {
     a64_compile_ctx_t cc;
     size_t prologue_patch_pos;
@@ -1285,6 +1587,30 @@ typedef struct a64_direct_ctx {
     uint32_t phi_copy_count;
     uint32_t phi_copy_cap;
     a64_deferred_term_t deferred;
+    uint32_t vec_lane_vregs;    /* first of 4 vregs for scalarized lanes */
+    int32_t sret_off;           /* slot holding X8 for wide vector returns */
+    /* NZCV from the last icmp, live while nothing follows it in the same
+       block: a condbr or select on flags_vreg uses b.cond/csel on
+       flags_cc.  The cset and store from flags_cmp_end are dropped when
+       that consumer is the only use. */
+    bool flags_valid;
+    uint8_t flags_cc;
+    uint32_t flags_vreg;
+    uint32_t flags_block_id;
+    size_t flags_cmp_end;
+    size_t flags_end;
+    /* Likewise for the last GEP: its registers are set up at addr_ready,
+       and a load or store that is the result's only use addresses
+       addr_mem instead of the add and slot store after it. */
+    bool addr_valid;
+    uint32_t addr_vreg;
+    uint32_t addr_block_id;
+    size_t addr_ready;
+    size_t addr_end;
+    a64_addr_t addr_mem;
+    /* The last call left the frame with a branch; the return that follows
+       it emits nothing. */
+    bool tail_jumped;
 } a64_direct_ctx_t;
 
 static lr_operand_t a64_operand_from_desc(const lr_operand_desc_t *desc) {
@@ -1389,6 +1715,71 @@ static int a64_direct_ensure_phi_copy_cap(a64_direct_ctx_t *ctx) {
     return 0;
 }
 
+/* Scalar edges: move each value once, in an order that never clobbers a
+   pending source, with X16 holding the one value a swap cycle needs.
+   False (nothing emitted) when some copy is wider than a GPR. */
+static bool a64_direct_emit_phi_copies_sequenced(a64_direct_ctx_t *ctx,
+                                                 uint32_t pred,
+                                                 uint32_t succ) {
+    a64_compile_ctx_t *cc = &ctx->cc;
+    uint32_t *idx, *dests;
+    lr_operand_t *srcs;
+    lr_pcopy_step_t *steps;
+    uint32_t n = 0;
+    int num_steps;
+
+    for (uint32_t i = 0; i < ctx->phi_copy_count; i++) {
+        if (ctx->phi_copies[i].pred_block_id != pred ||
+            ctx->phi_copies[i].succ_block_id != succ)
+            continue;
+        if (vreg_slot_size(cc, ctx->phi_copies[i].dest_vreg) > 8)
+            return false;
+        n++;
+    }
+    if (n == 0)
+        return true;
+    idx = lr_arena_array_uninit(cc->arena, uint32_t, n);
+    dests = lr_arena_array_uninit(cc->arena, uint32_t, n);
+    srcs = lr_arena_array_uninit(cc->arena, lr_operand_t, n);
+    steps = lr_arena_array_uninit(cc->arena, lr_pcopy_step_t, 2u * n);
+    if (!idx || !dests || !srcs || !steps)
+        return false;
+    n = 0;
+    for (uint32_t i = 0; i < ctx->phi_copy_count; i++) {
+        if (ctx->phi_copies[i].pred_block_id != pred ||
+            ctx->phi_copies[i].succ_block_id != succ)
+            continue;
+        idx[n] = i;
+        dests[n] = ctx->phi_copies[i].dest_vreg;
+        srcs[n] = ctx->phi_copies[i].src_op;
+        n++;
+    }
+    num_steps = lr_target_sequence_parallel_copies(dests, srcs, n, cc->arena,
+                                                   steps);
+    if (num_steps < 0)
+        return false;
+
+    for (int s = 0; s < num_steps; s++) {
+        uint32_t k = steps[s].index;
+        switch (steps[s].kind) {
+        case LR_PCOPY_SAVE:
+            emit_load_slot(cc, dests[k], A64_X16);
+            break;
+        case LR_PCOPY_RESTORE:
+            emit_store_slot(cc, dests[k], A64_X16);
+            break;
+        default:
+            emit_phi_copy_value(cc, dests[k], &srcs[k]);
+            break;
+        }
+    }
+    /* A destination may have been cached before it was overwritten. */
+    invalidate_cached_gprs_a64(cc);
+    for (uint32_t i = 0; i < n; i++)
+        ctx->phi_copies[idx[i]].emitted = true;
+    return true;
+}
+
 static void a64_direct_emit_phi_copies_for_edge(a64_direct_ctx_t *ctx,
                                                 uint32_t pred,
                                                 uint32_t succ) {
@@ -1396,7 +1787,11 @@ static void a64_direct_emit_phi_copies_for_edge(a64_direct_ctx_t *ctx,
     uint32_t stage_base = ctx->next_vreg;
     uint32_t staged = 0;
 
-    /* PHI inputs are parallel: stage sources first, then write destinations. */
+    if (a64_direct_emit_phi_copies_sequenced(ctx, pred, succ))
+        return;
+
+    /* Aggregate and vector PHIs: stage every source in a fresh slot
+       first, then write the destinations. */
     for (uint32_t i = 0; i < ctx->phi_copy_count; i++) {
         size_t dst_sz;
         uint32_t tmp_vreg;
@@ -1432,6 +1827,12 @@ static void a64_direct_emit_phi_copies_for_edge(a64_direct_ctx_t *ctx,
         } else if (src_op->kind == LR_VAL_UNDEF ||
                    src_op->kind == LR_VAL_NULL) {
             emit_mem_zero_base(cc, A64_FP, tmp_off, dst_sz);
+        } else if (src_op->kind == LR_VAL_GLOBAL &&
+                   src_op->type && src_op->type->kind == LR_TYPE_VECTOR) {
+            /* Wide constant vector incoming: copy from its pool global. */
+            emit_load_operand(cc, src_op, A64_X9);
+            emit_mem_copy_base_to_base(cc, A64_FP, tmp_off, A64_X9, 0,
+                                       dst_sz);
         } else {
             emit_load_operand(cc, src_op, A64_X9);
             emit_store(cc->buf, &cc->pos, cc->buflen, A64_X9,
@@ -1468,115 +1869,642 @@ static void a64_direct_emit_phi_copies_for_edge(a64_direct_ctx_t *ctx,
     }
 }
 
-static int a64_flush_deferred_terminator(a64_direct_ctx_t *ctx) {
-    a64_compile_ctx_t *cc;
-    a64_deferred_term_t *dt;
-    bool dbg_term;
-
-    if (!ctx || !ctx->deferred.pending)
-        return 0;
+/* ---- Inline integer intrinsics ---- */
 
-    cc = &ctx->cc;
-    dt = &ctx->deferred;
-    dbg_term = getenv("LIRIC_DBG_A64_TERM") != NULL;
-    dt->pending = false;
+/* sxtb/sxth (sbfm) or and #0xff/#0xffff (uxtb/uxth) of a w register. */
+static void a64_emit_narrow_ext(a64_compile_ctx_t *cc, uint8_t reg,
+                                uint8_t bits, bool is_signed) {
+    emit_u32(cc->buf, &cc->pos, cc->buflen,
+             (is_signed ? 0x13000000u : 0x12000000u) |
+             ((uint32_t)(bits - 1) << 10) | ((uint32_t)reg << 5) | reg);
+}
 
-    switch (dt->op) {
-    case LR_OP_RET:
-        if (a64_is_complex16(ctx->ret_type)) {
-            /* complex(8): return the {double,double} HFA in d0:d1 (PCS). */
-            emit_vreg_data_addr_a64(cc, &dt->ops[0], A64_X9);
-            emit_fp_load(cc->buf, &cc->pos, cc->buflen, A64_D0, A64_X9, 0, 8);
-            emit_fp_load(cc->buf, &cc->pos, cc->buflen, A64_D1, A64_X9, 8, 8);
-        } else if (a64_is_complex8_fp(ctx->ret_type)) {
-            /* complex(4): return the {float,float} HFA in s0:s1 (PCS). */
-            emit_vreg_data_addr_a64(cc, &dt->ops[0], A64_X9);
-            emit_fp_load(cc->buf, &cc->pos, cc->buflen, A64_D0, A64_X9, 0, 4);
-            emit_fp_load(cc->buf, &cc->pos, cc->buflen, A64_D1, A64_X9, 4, 4);
-        } else if (cc->func_uses_fp_abi && is_fp_abi_type(ctx->ret_type)) {
-            emit_load_fp_operand(cc, &dt->ops[0], A64_D0,
-                                 fp_abi_size(ctx->ret_type));
-        } else {
-            emit_load_operand(cc, &dt->ops[0], A64_X9);
-            emit_mov_reg(cc->buf, &cc->pos, cc->buflen, A64_X0, A64_X9,
-                         true);
+/* Expand a min/max/abs/count/funnel-shift intrinsic call in place of the
+   platform_intrinsics.c helper.  Returns false (emitting nothing) when the
+   width has no sequence here, so the caller falls back to the real call.
+   With FEAT_CSSC, min/max/abs/ctpop/cttz are single instructions. */
+static bool a64_emit_int_intrinsic(a64_compile_ctx_t *cc,
+                                   lr_int_intrinsic_t kind, uint8_t bits,
+                                   const lr_operand_t *ops, uint32_t nops,
+                                   const lr_compile_inst_desc_t *desc) {
+    bool cssc = (cc->cpu_features & LR_CPU_A64_CSSC) != 0;
+    bool is64 = bits == 64;
+    bool narrow = bits < 32;
+    uint8_t cond = 0;
+
+    if (nops < 2)
+        return false;
+    switch (kind) {
+    case LR_INT_INTRIN_UMAX: case LR_INT_INTRIN_UMIN:
+    case LR_INT_INTRIN_SMAX: case LR_INT_INTRIN_SMIN:
+        if (nops < 3)
+            return false;
+        emit_load_operand(cc, &ops[1], A64_X9);
+        emit_load_operand(cc, &ops[2], A64_X10);
+        if (narrow) {
+            bool is_signed = kind == LR_INT_INTRIN_SMAX ||
+                             kind == LR_INT_INTRIN_SMIN;
+            a64_emit_narrow_ext(cc, A64_X9, bits, is_signed);
+            a64_emit_narrow_ext(cc, A64_X10, bits, is_signed);
         }
-        emit_epilogue_a64(cc);
-        break;
-    case LR_OP_RET_VOID:
-        emit_epilogue_a64(cc);
-        break;
-    case LR_OP_UNREACHABLE:
-        /* Frontend-produced tail `unreachable` must still terminate codegen
-           for this function instead of falling through into neighboring code. */
-        emit_epilogue_a64(cc);
-        break;
-    case LR_OP_BR: {
-        if (dbg_term) {
-            fprintf(stderr,
-                    "[a64 term] func=%s op=br pred=%u succ=%u\n",
-                    cc->func_name ? cc->func_name : "<anon>",
-                    dt->block_id, dt->ops[0].block_id);
+        if (cssc) {
+            uint32_t op;
+            switch (kind) {
+            case LR_INT_INTRIN_SMAX: op = 0x6000u; break;
+            case LR_INT_INTRIN_UMAX: op = 0x6400u; break;
+            case LR_INT_INTRIN_SMIN: op = 0x6800u; break;
+            default:                 op = 0x6C00u; break;
+            }
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     enc_cssc_minmax(is64, op, A64_X9, A64_X9, A64_X10));
+            break;
         }
-        a64_direct_emit_phi_copies_for_edge(ctx, dt->block_id,
-                                            dt->ops[0].block_id);
-        if (a64_direct_ensure_fixup_cap(ctx) != 0) return -1;
-        emit_jmp_a64(cc, dt->ops[0].block_id);
-        cc->fixups[cc->num_fixups - 1].source = dt->block_id;
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_subs_reg(is64, A64_X9, A64_X10));
+        switch (kind) {
+        case LR_INT_INTRIN_UMAX: cond = 2; break;  /* hs */
+        case LR_INT_INTRIN_UMIN: cond = 9; break;  /* ls */
+        case LR_INT_INTRIN_SMAX: cond = 10; break; /* ge */
+        default:                 cond = 13; break; /* le */
+        }
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_csel(is64, A64_X9, A64_X9, A64_X10, cond));
         break;
-    }
-    case LR_OP_CONDBR: {
-        size_t true_path_pos;
-        size_t jcc_insn_pos;
-        int64_t jcc_imm;
-        uint8_t cond;
-        uint32_t true_id;
-        uint32_t false_id;
-        emit_load_operand(cc, &dt->ops[0], A64_X9);
+    case LR_INT_INTRIN_ABS:
+        /* cmp x9, #0; cneg x9, x9, mi */
+        emit_load_operand(cc, &ops[1], A64_X9);
+        if (narrow)
+            a64_emit_narrow_ext(cc, A64_X9, bits, true);
+        if (cssc) {
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     enc_cssc_unary(is64, 0x2000u, A64_X9, A64_X9));
+            break;
+        }
         emit_u32(cc->buf, &cc->pos, cc->buflen,
-                 enc_ands_reg(false, A64_X9, A64_X9));
-        true_id = dt->ops[1].block_id;
-        false_id = dt->ops[2].block_id;
-        if (dbg_term) {
-            fprintf(stderr,
-                    "[a64 term] func=%s op=condbr pred=%u t=%u f=%u\n",
-                    cc->func_name ? cc->func_name : "<anon>",
-                    dt->block_id, true_id, false_id);
+                 (is64 ? 0xF100001Fu : 0x7100001Fu) | ((uint32_t)A64_X9 << 5));
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_csneg(is64, A64_X9, A64_X9, A64_X9, 5 /* pl */));
+        break;
+    case LR_INT_INTRIN_CTPOP:
+        emit_load_operand(cc, &ops[1], A64_X9);
+        if (narrow)
+            a64_emit_narrow_ext(cc, A64_X9, bits, false);
+        if (cssc) {
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     enc_cssc_unary(is64, 0x1C00u, A64_X9, A64_X9));
+            break;
         }
-
-        /* Emit edge-specific copies:
-           cmp; b.ne true_path; false_copies; b false; true_path: true_copies; b true */
-        cond = lr_cc_to_a64(LR_CC_NE);
-        jcc_insn_pos = cc->pos;
-        emit_u32(cc->buf, &cc->pos, cc->buflen, 0x54000000u | cond);
-
-        a64_direct_emit_phi_copies_for_edge(ctx, dt->block_id, false_id);
-        if (a64_direct_ensure_fixup_cap(ctx) != 0) return -1;
-        emit_jmp_a64(cc, false_id);
-        cc->fixups[cc->num_fixups - 1].source = dt->block_id;
-
-        true_path_pos = cc->pos;
-        jcc_imm = ((int64_t)true_path_pos - (int64_t)jcc_insn_pos) / 4;
-        patch_u32(cc->buf, cc->buflen, jcc_insn_pos,
-                  0x54000000u |
-                  (((uint32_t)jcc_imm & 0x7FFFFu) << 5) |
-                  cond);
-
-        /* Edge copies must reload their sources from slots, not reuse the
-           scratch-register cache left behind by the branch condition. */
-        invalidate_cached_gprs_a64(cc);
-        a64_direct_emit_phi_copies_for_edge(ctx, dt->block_id, true_id);
-        if (a64_direct_ensure_fixup_cap(ctx) != 0) return -1;
-        emit_jmp_a64(cc, true_id);
-        cc->fixups[cc->num_fixups - 1].source = dt->block_id;
+        if (bits == 32)
+            emit_mov_reg(cc->buf, &cc->pos, cc->buflen, A64_X9, A64_X9, false);
+        /* fmov d16, x9; cnt v16.8b, v16.8b; addv b16, v16.8b; fmov w9, s16 */
+        emit_u32(cc->buf, &cc->pos, cc->buflen, enc_fmov_from_gpr(8, 16, A64_X9));
+        emit_u32(cc->buf, &cc->pos, cc->buflen, 0x0E205A10u);
+        emit_u32(cc->buf, &cc->pos, cc->buflen, 0x0E31BA10u);
+        emit_u32(cc->buf, &cc->pos, cc->buflen, 0x1E260209u);
         break;
-    }
-    default:
+    case LR_INT_INTRIN_CTLZ:
+        emit_load_operand(cc, &ops[1], A64_X9);
+        if (narrow)
+            a64_emit_narrow_ext(cc, A64_X9, bits, false);
+        emit_u32(cc->buf, &cc->pos, cc->buflen, enc_clz(is64, A64_X9, A64_X9));
+        if (narrow)
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     enc_sub_imm(false, A64_X9, A64_X9, 32u - bits));
         break;
-    }
-    return 0;
-}
-
+    case LR_INT_INTRIN_CTTZ:
+        emit_load_operand(cc, &ops[1], A64_X9);
+        /* A guard bit just above the width makes a zero input count to
+           `bits` without a separate compare. */
+        if (bits == 8)
+            emit_u32(cc->buf, &cc->pos, cc->buflen, 0x32180129u); /* orr w9, w9, #0x100 */
+        else if (bits == 16)
+            emit_u32(cc->buf, &cc->pos, cc->buflen, 0x32100129u); /* orr w9, w9, #0x10000 */
+        if (cssc) {
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     enc_cssc_unary(is64, 0x1800u, A64_X9, A64_X9));
+            break;
+        }
+        emit_u32(cc->buf, &cc->pos, cc->buflen, enc_rbit(is64, A64_X9, A64_X9));
+        emit_u32(cc->buf, &cc->pos, cc->buflen, enc_clz(is64, A64_X9, A64_X9));
+        break;
+    case LR_INT_INTRIN_FSHL:
+    case LR_INT_INTRIN_FSHR:
+        if (nops < 4)
+            return false;
+        emit_load_operand(cc, &ops[1], A64_X9);
+        emit_load_operand(cc, &ops[2], A64_X10);
+        emit_load_operand(cc, &ops[3], A64_X11);
+        if (narrow) {
+            /* w9 = a:b, shifted by s modulo the width; keep the high (fshl)
+               or low (fshr) half. */
+            a64_emit_narrow_ext(cc, A64_X9, bits, false);
+            a64_emit_narrow_ext(cc, A64_X10, bits, false);
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     0x2A000000u | ((uint32_t)A64_X9 << 16) | ((uint32_t)bits << 10) |
+                     ((uint32_t)A64_X10 << 5) | A64_X9); /* orr w9, w10, w9, lsl #bits */
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     0x12000000u | ((bits == 8 ? 2u : 3u) << 10) |
+                     ((uint32_t)A64_X11 << 5) | A64_X11); /* and w11, w11, #(bits-1) */
+            if (kind == LR_INT_INTRIN_FSHL) {
+                emit_u32(cc->buf, &cc->pos, cc->buflen,
+                         enc_lslv(false, A64_X9, A64_X9, A64_X11));
+                emit_u32(cc->buf, &cc->pos, cc->buflen,
+                         0x53007C00u | ((uint32_t)bits << 16) |
+                         ((uint32_t)A64_X9 << 5) | A64_X9); /* lsr w9, w9, #bits */
+            } else {
+                emit_u32(cc->buf, &cc->pos, cc->buflen,
+                         enc_lsrv(false, A64_X9, A64_X9, A64_X11));
+                a64_emit_narrow_ext(cc, A64_X9, bits, false);
+            }
+            break;
+        }
+        /* fshl: (a << s) | ((b >> 1) >> ~s), fshr: ((a << 1) << ~s) | (b >> s);
+           the variable shifts use s modulo the width, so s == 0 is exact. */
+        if (kind == LR_INT_INTRIN_FSHL) {
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     enc_lslv(is64, A64_X9, A64_X9, A64_X11));
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     (is64 ? 0xD341FC00u : 0x53017C00u) |
+                     ((uint32_t)A64_X10 << 5) | A64_X10); /* lsr #1 */
+        } else {
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     enc_lsrv(is64, A64_X10, A64_X10, A64_X11));
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     (is64 ? 0xD37FF800u : 0x531F7800u) |
+                     ((uint32_t)A64_X9 << 5) | A64_X9);   /* lsl #1 */
+        }
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 0x2A2003E0u | ((uint32_t)A64_X11 << 16) | A64_X11); /* mvn w11, w11 */
+        if (kind == LR_INT_INTRIN_FSHL)
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     enc_lsrv(is64, A64_X10, A64_X10, A64_X11));
+        else
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     enc_lslv(is64, A64_X9, A64_X9, A64_X11));
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_logic_reg(0xAA000000u, is64, A64_X9, A64_X9, A64_X10));
+        break;
+    default:
+        return false;
+    }
+    if (desc->type && desc->type->kind != LR_TYPE_VOID)
+        emit_store_slot(cc, desc->dest, A64_X9);
+    invalidate_cached_gprs_a64(cc);
+    return true;
+}
+
+/* llvm.fma / llvm.fmuladd as one fmadd (base ARMv8) instead of the libm
+   call. */
+static bool a64_emit_fp_intrinsic(a64_compile_ctx_t *cc,
+                                  lr_fp_intrinsic_t kind, uint8_t bits,
+                                  const lr_operand_t *ops, uint32_t nops,
+                                  const lr_compile_inst_desc_t *desc) {
+    uint8_t fsize = bits == 64 ? 8 : 4;
+    if (kind != LR_FP_INTRIN_FMA || nops < 4)
+        return false;
+    emit_load_fp_operand(cc, &ops[1], FP_SCRATCH0, fsize);
+    emit_load_fp_operand(cc, &ops[2], FP_SCRATCH1, fsize);
+    emit_load_fp_operand(cc, &ops[3], A64_D2, fsize);
+    emit_u32(cc->buf, &cc->pos, cc->buflen,
+             enc_fmadd(fsize, FP_SCRATCH0, FP_SCRATCH0, FP_SCRATCH1, A64_D2));
+    emit_store_fp_slot(cc, desc->dest, FP_SCRATCH0, fsize);
+    invalidate_cached_gprs_a64(cc);
+    return true;
+}
+
+/* Expand a constant-length llvm.memcpy/llvm.memset accepted by
+   lr_target_mem_inline_plan: 16-byte ldp/stp pairs through X11/X12, then
+   one overlapping pair ending at len; shorter lengths use 8/4/2/1-byte
+   ldur/stur.  X9 holds dst and X10 src; both advance when the next pair
+   offset would leave the scaled ldp/stp range. */
+static void a64_emit_mem_intrinsic(a64_compile_ctx_t *cc,
+                                   lr_mem_intrinsic_t kind,
+                                   const lr_operand_t *ops, uint32_t len) {
+    bool is_copy = kind == LR_MEM_INTRIN_MEMCPY;
+    uint32_t base = 0;
+    uint32_t off;
+    if (len == 0)
+        return;
+    emit_load_operand(cc, &ops[1], A64_X9);
+    if (is_copy) {
+        emit_load_operand(cc, &ops[2], A64_X10);
+    } else if (ops[2].kind == LR_VAL_IMM_I64) {
+        uint64_t fill = (uint64_t)(uint8_t)ops[2].imm_i64 * 0x0101010101010101ULL;
+        emit_move_imm_ctx(cc, A64_X11, (int64_t)fill, true);
+    } else {
+        /* x11 = fill byte replicated into all eight bytes */
+        emit_load_operand(cc, &ops[2], A64_X11);
+        a64_emit_narrow_ext(cc, A64_X11, 8, false);
+        emit_move_imm_ctx(cc, A64_X12, 0x0101010101010101LL, true);
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_mul(true, A64_X11, A64_X11, A64_X12));
+    }
+    if (len < 16) {
+        for (off = 0; off < len;) {
+            uint8_t chunk = len - off >= 8 ? 8 : len - off >= 4 ? 4 :
+                            len - off >= 2 ? 2 : 1;
+            if (is_copy)
+                emit_load(cc->buf, &cc->pos, cc->buflen, A64_X11, A64_X10,
+                          (int32_t)off, chunk);
+            emit_store(cc->buf, &cc->pos, cc->buflen, A64_X11, A64_X9,
+                       (int32_t)off, chunk);
+            off += chunk;
+        }
+        invalidate_cached_gprs_a64(cc);
+        return;
+    }
+    for (off = 0; off < len; off += 16) {
+        if (off + 16 > len)
+            off = len - 16;
+        if (off - base > 496 || ((off - base) & 7u) != 0) {
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     enc_add_imm(true, A64_X9, A64_X9, off - base));
+            if (is_copy)
+                emit_u32(cc->buf, &cc->pos, cc->buflen,
+                         enc_add_imm(true, A64_X10, A64_X10, off - base));
+            base = off;
+        }
+        if (is_copy)
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     enc_ldp64(A64_X11, A64_X12, A64_X10, (int32_t)(off - base)));
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_stp64(A64_X11, is_copy ? A64_X12 : A64_X11, A64_X9,
+                           (int32_t)(off - base)));
+    }
+    invalidate_cached_gprs_a64(cc);
+}
+
+/* ---- Switch lowering ---- */
+
+typedef struct a64_switch_patch {
+    size_t insn_pos;
+    int cond;       /* -1 for an unconditional b */
+    uint32_t dest;  /* lr_switch_plan_t dest index */
+} a64_switch_patch_t;
+
+/* x9 holds the zero-extended condition; x10 is scratch. */
+static void a64_switch_cmp_imm(a64_compile_ctx_t *cc, uint64_t value) {
+    if (value < 4096u) {
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 0xF100001Fu | ((uint32_t)value << 10) | ((uint32_t)A64_X9 << 5));
+        return;
+    }
+    emit_move_imm_ctx(cc, A64_X10, (int64_t)value, true);
+    emit_u32(cc->buf, &cc->pos, cc->buflen, enc_subs_reg(true, A64_X9, A64_X10));
+}
+
+static void a64_switch_branch(a64_compile_ctx_t *cc, int cond,
+                              a64_switch_patch_t *patches, uint32_t *npatches,
+                              uint32_t dest) {
+    patches[*npatches].insn_pos = cc->pos;
+    patches[*npatches].cond = cond;
+    patches[*npatches].dest = dest;
+    (*npatches)++;
+    emit_u32(cc->buf, &cc->pos, cc->buflen,
+             cond < 0 ? 0x14000000u : 0x54000000u | (uint32_t)cond);
+}
+
+static void a64_switch_emit_tree(a64_compile_ctx_t *cc,
+                                 const lr_switch_plan_t *plan,
+                                 uint32_t lo, uint32_t hi,
+                                 a64_switch_patch_t *patches,
+                                 uint32_t *npatches) {
+    if (hi - lo <= 3) {
+        for (uint32_t i = lo; i < hi; i++) {
+            a64_switch_cmp_imm(cc, plan->cases[i].value);
+            a64_switch_branch(cc, lr_cc_to_a64(LR_CC_EQ), patches, npatches,
+                              plan->cases[i].dest);
+        }
+        a64_switch_branch(cc, -1, patches, npatches, 0);
+        return;
+    }
+    uint32_t mid = lo + (hi - lo) / 2u;
+    uint8_t lo_cc = lr_cc_to_a64(LR_CC_ULT);
+    size_t left_insn;
+    int64_t imm;
+    a64_switch_cmp_imm(cc, plan->cases[mid].value);
+    left_insn = cc->pos;
+    emit_u32(cc->buf, &cc->pos, cc->buflen, 0x54000000u | lo_cc);
+    a64_switch_emit_tree(cc, plan, mid, hi, patches, npatches);
+    imm = ((int64_t)cc->pos - (int64_t)left_insn) / 4;
+    patch_u32(cc->buf, cc->buflen, left_insn,
+              0x54000000u | (((uint32_t)imm & 0x7FFFFu) << 5) | lo_cc);
+    a64_switch_emit_tree(cc, plan, lo, mid, patches, npatches);
+}
+
+/* Same shape as the x86_64 lowering: dispatch, then one landing pad per
+   distinct successor carrying that edge's phi copies. */
+static int a64_direct_emit_switch(a64_direct_ctx_t *ctx,
+                                  const a64_deferred_term_t *dt) {
+    a64_compile_ctx_t *cc = &ctx->cc;
+    lr_switch_plan_t plan;
+    a64_switch_patch_t *patches;
+    uint32_t npatches = 0;
+    size_t *pads;
+    size_t table_pos = 0;
+    uint64_t table_len = 0;
+
+    if (lr_target_plan_switch(dt->switch_ops, dt->num_ops, cc->arena,
+                              &plan) != 0)
+        return -1;
+    patches = lr_arena_array_uninit(cc->arena, a64_switch_patch_t,
+                                    plan.num_cases * 2u + plan.num_dests + 4u);
+    pads = lr_arena_array_uninit(cc->arena, size_t, plan.num_dests);
+    if (!patches || !pads)
+        return -1;
+
+    if (plan.num_cases > 0) {
+        emit_load_operand(cc, &dt->switch_ops[0], A64_X9);
+        if (plan.bits == 32)
+            emit_mov_reg(cc->buf, &cc->pos, cc->buflen, A64_X9, A64_X9, false);
+        else if (plan.bits == 16)
+            emit_u32(cc->buf, &cc->pos, cc->buflen, 0x12003D29u); /* and w9, w9, #0xffff */
+        else if (plan.bits == 8)
+            emit_u32(cc->buf, &cc->pos, cc->buflen, 0x12001D29u); /* and w9, w9, #0xff */
+        else if (plan.bits == 1)
+            emit_u32(cc->buf, &cc->pos, cc->buflen, 0x12000129u); /* and w9, w9, #1 */
+        invalidate_cached_reg_a64(cc, A64_X9);
+    }
+
+    if (plan.num_cases == 0) {
+        a64_switch_branch(cc, -1, patches, &npatches, 0);
+    } else if (plan.kind == LR_SWITCH_LOWER_BIT_TEST ||
+               plan.kind == LR_SWITCH_LOWER_JUMP_TABLE) {
+        if (plan.min != 0) {
+            if (plan.min < 4096u) {
+                emit_u32(cc->buf, &cc->pos, cc->buflen,
+                         enc_sub_imm(true, A64_X9, A64_X9, (uint32_t)plan.min));
+            } else {
+                emit_move_imm_ctx(cc, A64_X10, (int64_t)plan.min, true);
+                emit_u32(cc->buf, &cc->pos, cc->buflen,
+                         enc_sub_reg(true, A64_X9, A64_X9, A64_X10));
+            }
+        }
+        a64_switch_cmp_imm(cc, plan.range);
+        a64_switch_branch(cc, lr_cc_to_a64(LR_CC_UGT), patches, &npatches, 0);
+        if (plan.kind == LR_SWITCH_LOWER_BIT_TEST) {
+            for (uint32_t d = 1; d < plan.num_dests; d++) {
+                if (plan.bit_masks[d] == 0)
+                    continue;
+                emit_move_imm_ctx(cc, A64_X10, (int64_t)plan.bit_masks[d], true);
+                emit_u32(cc->buf, &cc->pos, cc->buflen,
+                         enc_lsrv(true, A64_X10, A64_X10, A64_X9));
+                emit_u32(cc->buf, &cc->pos, cc->buflen, 0xF240015Fu); /* tst x10, #1 */
+                a64_switch_branch(cc, lr_cc_to_a64(LR_CC_NE), patches,
+                                  &npatches, d);
+            }
+            a64_switch_branch(cc, -1, patches, &npatches, 0);
+        } else {
+            /* adr x10, table; ldrsw x9, [x10, x9, lsl #2];
+               add x9, x10, x9; br x9 */
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     0x10000000u | ((16u >> 2) << 5) | A64_X10);
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     0xB8A07800u | ((uint32_t)A64_X9 << 16) |
+                     ((uint32_t)A64_X10 << 5) | A64_X9);
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     enc_add_reg(true, A64_X9, A64_X10, A64_X9));
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     0xD61F0000u | ((uint32_t)A64_X9 << 5));
+            table_pos = cc->pos;
+            table_len = plan.range + 1u;
+            cc->pos += (size_t)table_len * 4u;
+        }
+    } else {
+        a64_switch_emit_tree(cc, &plan, 0, plan.num_cases,
+                             patches, &npatches);
+    }
+
+    /* The default pad comes first, so a trailing b to it falls through. */
+    if (npatches > 0 && patches[npatches - 1].dest == 0 &&
+        patches[npatches - 1].cond < 0 &&
+        patches[npatches - 1].insn_pos + 4 == cc->pos) {
+        cc->pos -= 4;
+        npatches--;
+    }
+    invalidate_cached_gprs_a64(cc);
+
+    for (uint32_t d = 0; d < plan.num_dests; d++) {
+        pads[d] = cc->pos;
+        invalidate_cached_gprs_a64(cc);
+        a64_direct_emit_phi_copies_for_edge(ctx, dt->block_id, plan.dests[d]);
+        if (a64_direct_ensure_fixup_cap(ctx) != 0)
+            return -1;
+        emit_jmp_a64(cc, plan.dests[d]);
+        cc->fixups[cc->num_fixups - 1].source = dt->block_id;
+    }
+
+    for (uint32_t i = 0; i < npatches; i++) {
+        int64_t imm = ((int64_t)pads[patches[i].dest] -
+                       (int64_t)patches[i].insn_pos) / 4;
+        uint32_t insn = patches[i].cond < 0
+            ? 0x14000000u | ((uint32_t)imm & 0x03FFFFFFu)
+            : 0x54000000u | (((uint32_t)imm & 0x7FFFFu) << 5) |
+              (uint32_t)patches[i].cond;
+        patch_u32(cc->buf, cc->buflen, patches[i].insn_pos, insn);
+    }
+    if (table_len > 0) {
+        uint32_t ci = 0;
+        for (uint64_t v = 0; v < table_len; v++) {
+            uint32_t dest = 0;
+            if (ci < plan.num_cases &&
+                plan.cases[ci].value - plan.min == v)
+                dest = plan.cases[ci++].dest;
+            patch_u32(cc->buf, cc->buflen, table_pos + (size_t)v * 4u,
+                      (uint32_t)(int32_t)((int64_t)pads[dest] -
+                                          (int64_t)table_pos));
+        }
+    }
+    return 0;
+}
+
+#define A64_NO_FUSED_CC 0xFFu
+
+/* Condition code of the icmp defining op while its flags are live (see
+   flags_valid), else A64_NO_FUSED_CC; a single-use result is cut from
+   the buffer instead of being materialized. */
+static uint8_t a64_take_cmp_flags(a64_direct_ctx_t *ctx,
+                                  const lr_operand_t *op,
+                                  uint32_t block_id) {
+    a64_compile_ctx_t *cc = &ctx->cc;
+    if (!ctx->flags_valid || op->kind != LR_VAL_VREG ||
+        op->vreg != ctx->flags_vreg || block_id != ctx->flags_block_id ||
+        cc->pos != ctx->flags_end)
+        return A64_NO_FUSED_CC;
+    ctx->flags_valid = false;
+    if (op->vreg < cc->num_vreg_uses && cc->vreg_uses[op->vreg] == 1) {
+        cc->pos = ctx->flags_cmp_end;
+        invalidate_cached_gprs_a64(cc);
+    }
+    return ctx->flags_cc;
+}
+
+/* The folded address of the GEP defining op when the GEP was emitted
+   just before in this block, op is its only use and a size-byte access
+   can apply its index shift; the add and slot store are cut from the
+   buffer. */
+static bool a64_take_gep_addr(a64_direct_ctx_t *ctx, const lr_operand_t *op,
+                              uint8_t size, a64_addr_t *out) {
+    a64_compile_ctx_t *cc = &ctx->cc;
+    const a64_addr_t *a = &ctx->addr_mem;
+    if (!ctx->addr_valid || op->kind != LR_VAL_VREG ||
+        op->vreg != ctx->addr_vreg ||
+        ctx->addr_block_id != ctx->current_block_id ||
+        cc->pos != ctx->addr_end || op->vreg >= cc->num_vreg_uses ||
+        cc->vreg_uses[op->vreg] != 1)
+        return false;
+    if (a->index != A64_NO_INDEX && a->shift != 0 &&
+        (1u << a->shift) != size)
+        return false;
+    ctx->addr_valid = false;
+    cc->pos = ctx->addr_ready;
+    invalidate_cached_gprs_a64(cc);
+    *out = *a;
+    return true;
+}
+
+/* Load (zero-extending) or store the low size bytes of rt at a. */
+static void a64_emit_access(a64_compile_ctx_t *cc, bool load, uint8_t rt,
+                            const a64_addr_t *a, uint8_t size) {
+    if (a->index != A64_NO_INDEX)
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_ldst_reg(load, size, rt, a->base, a->index,
+                              a->shift != 0));
+    else if (load)
+        emit_load(cc->buf, &cc->pos, cc->buflen, rt, a->base, a->disp, size);
+    else
+        emit_store(cc->buf, &cc->pos, cc->buflen, rt, a->base, a->disp, size);
+}
+
+static int a64_flush_deferred_terminator(a64_direct_ctx_t *ctx) {
+    a64_compile_ctx_t *cc;
+    a64_deferred_term_t *dt;
+    bool dbg_term;
+
+    if (!ctx || !ctx->deferred.pending)
+        return 0;
+
+    cc = &ctx->cc;
+    dt = &ctx->deferred;
+    dbg_term = getenv("LIRIC_DBG_A64_TERM") != NULL;
+    dt->pending = false;
+
+    switch (dt->op) {
+    case LR_OP_RET:
+        if (a64_is_complex16(ctx->ret_type)) {
+            /* complex(8): return the {double,double} HFA in d0:d1 (PCS). */
+            emit_vreg_data_addr_a64(cc, &dt->ops[0], A64_X9);
+            emit_fp_load(cc->buf, &cc->pos, cc->buflen, A64_D0, A64_X9, 0, 8);
+            emit_fp_load(cc->buf, &cc->pos, cc->buflen, A64_D1, A64_X9, 8, 8);
+        } else if (a64_is_complex8_fp(ctx->ret_type)) {
+            /* complex(4): return the {float,float} HFA in s0:s1 (PCS). */
+            emit_vreg_data_addr_a64(cc, &dt->ops[0], A64_X9);
+            emit_fp_load(cc->buf, &cc->pos, cc->buflen, A64_D0, A64_X9, 0, 4);
+            emit_fp_load(cc->buf, &cc->pos, cc->buflen, A64_D1, A64_X9, 4, 4);
+        } else if (a64_is_wide_vector(ctx->ret_type)) {
+            size_t sz = lr_type_size(ctx->ret_type);
+            emit_load(cc->buf, &cc->pos, cc->buflen, A64_X12, A64_FP,
+                      ctx->sret_off, 8);
+            if (dt->ops[0].kind == LR_VAL_VREG)
+                emit_copy_vreg_value_bytes_to_base(cc, dt->ops[0].vreg, sz,
+                                                   A64_X12, 0);
+            else
+                emit_mem_zero_base(cc, A64_X12, 0, sz);
+            emit_mov_reg(cc->buf, &cc->pos, cc->buflen, A64_X0, A64_X12,
+                         true);
+        } else if (cc->func_uses_fp_abi && is_fp_abi_type(ctx->ret_type)) {
+            emit_load_fp_operand(cc, &dt->ops[0], A64_D0,
+                                 fp_abi_size(ctx->ret_type));
+        } else {
+            emit_load_operand(cc, &dt->ops[0], A64_X9);
+            emit_mov_reg(cc->buf, &cc->pos, cc->buflen, A64_X0, A64_X9,
+                         true);
+        }
+        emit_epilogue_a64(cc);
+        break;
+    case LR_OP_RET_VOID:
+        emit_epilogue_a64(cc);
+        break;
+    case LR_OP_UNREACHABLE:
+        /* Frontend-produced tail `unreachable` must still terminate codegen
+           for this function instead of falling through into neighboring code. */
+        emit_epilogue_a64(cc);
+        break;
+    case LR_OP_BR: {
+        if (dbg_term) {
+            fprintf(stderr,
+                    "[a64 term] func=%s op=br pred=%u succ=%u\n",
+                    cc->func_name ? cc->func_name : "<anon>",
+                    dt->block_id, dt->ops[0].block_id);
+        }
+        a64_direct_emit_phi_copies_for_edge(ctx, dt->block_id,
+                                            dt->ops[0].block_id);
+        if (a64_direct_ensure_fixup_cap(ctx) != 0) return -1;
+        emit_jmp_a64(cc, dt->ops[0].block_id);
+        cc->fixups[cc->num_fixups - 1].source = dt->block_id;
+        break;
+    }
+    case LR_OP_CONDBR: {
+        size_t true_path_pos;
+        size_t jcc_insn_pos;
+        int64_t jcc_imm;
+        uint8_t cond;
+        uint8_t cond_cc;
+        uint32_t jcc_base;
+        uint32_t true_id;
+        uint32_t false_id;
+        /* b.cond on the flags of the icmp just before, else cbnz. */
+        cond_cc = a64_take_cmp_flags(ctx, &dt->ops[0], dt->block_id);
+        if (cond_cc == A64_NO_FUSED_CC) {
+            emit_load_operand(cc, &dt->ops[0], A64_X9);
+            jcc_base = 0x35000000u | A64_X9; /* cbnz w9 */
+        } else {
+            cond = lr_cc_to_a64(cond_cc);
+            jcc_base = 0x54000000u | cond;   /* b.cond */
+        }
+        true_id = dt->ops[1].block_id;
+        false_id = dt->ops[2].block_id;
+        if (dbg_term) {
+            fprintf(stderr,
+                    "[a64 term] func=%s op=condbr pred=%u t=%u f=%u\n",
+                    cc->func_name ? cc->func_name : "<anon>",
+                    dt->block_id, true_id, false_id);
+        }
+
+        /* Emit edge-specific copies:
+           cbnz true_path; false_copies; b false; true_path: true_copies; b true */
+        jcc_insn_pos = cc->pos;
+        emit_u32(cc->buf, &cc->pos, cc->buflen, jcc_base);
+
+        a64_direct_emit_phi_copies_for_edge(ctx, dt->block_id, false_id);
+        if (a64_direct_ensure_fixup_cap(ctx) != 0) return -1;
+        emit_jmp_a64(cc, false_id);
+        cc->fixups[cc->num_fixups - 1].source = dt->block_id;
+
+        true_path_pos = cc->pos;
+        jcc_imm = ((int64_t)true_path_pos - (int64_t)jcc_insn_pos) / 4;
+        patch_u32(cc->buf, cc->buflen, jcc_insn_pos,
+                  jcc_base | (((uint32_t)jcc_imm & 0x7FFFFu) << 5));
+
+        /* Edge copies must reload their sources from slots, not reuse the
+           scratch-register cache left behind by the branch condition. */
+        invalidate_cached_gprs_a64(cc);
+        a64_direct_emit_phi_copies_for_edge(ctx, dt->block_id, true_id);
+        if (a64_direct_ensure_fixup_cap(ctx) != 0) return -1;
+        emit_jmp_a64(cc, true_id);
+        cc->fixups[cc->num_fixups - 1].source = dt->block_id;
+        break;
+    }
+    case LR_OP_SWITCH:
+        if (a64_direct_emit_switch(ctx, dt) != 0)
+            return -1;
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
 static int aarch64_compile_begin(void **compile_ctx,
                                  const lr_compile_func_meta_t *func_meta,
                                  lr_module_t *mod,
@@ -1600,6 +2528,21 @@ static int aarch64_compile_begin(void **compile_ctx,
     memset(ctx, 0, sizeof(*ctx));
     ctx->mode = func_meta->mode;
     ctx->next_vreg = func_meta->next_vreg;
+    ctx->cc.cpu_features = func_meta->cpu_features;
+    ctx->cc.loop_counter = func_meta->loop_counter;
+    if (ctx->cc.loop_counter && func_meta->func &&
+        lr_func_is_finalized(func_meta->func))
+        ctx->cc.loop_headers = lr_target_loop_headers(func_meta->func, arena);
+    if (ctx->cc.loop_headers)
+        ctx->cc.num_loop_headers = func_meta->func->num_blocks;
+    if (func_meta->func && lr_func_is_finalized(func_meta->func))
+        ctx->cc.vreg_uses = lr_target_vreg_use_counts(func_meta->func, arena);
+    if (ctx->cc.vreg_uses)
+        ctx->cc.num_vreg_uses = func_meta->func->next_vreg;
+    if (func_meta->func && lr_func_is_finalized(func_meta->func))
+        ctx->cc.slot_coloring = lr_target_slot_coloring_create(
+            func_meta->func, mod, arena);
+    lr_target_const_pool_init(&ctx->cc.const_pool);
     ret_type = func_meta->ret_type ? func_meta->ret_type : mod->type_void;
     ctx->ret_type = ret_type;
     num_params = func_meta->num_params;
@@ -1647,6 +2590,11 @@ static int aarch64_compile_begin(void **compile_ctx,
     cc->func_uses_fp_abi = func_meta->func && func_meta->func->uses_llvm_abi;
     cc->func_is_vararg = func_meta->vararg;
     cc->vararg_stack_start_off = 16;
+    cc->frame_pinned = cc->func_is_vararg;
+    cc->teardown_pos = NULL;
+    cc->num_teardowns = 0;
+    cc->teardown_cap = 0;
+    cc->reloc_base = cc->obj_ctx ? cc->obj_ctx->num_relocs : 0;
     cc->func_name = (func_meta->func && func_meta->func->name)
                         ? func_meta->func->name
                         : "<anon>";
@@ -1675,126 +2623,1196 @@ static int aarch64_compile_begin(void **compile_ctx,
         cc->vararg_stack_start_off = 16 + (int32_t)(stack_used * 8u);
     }
 
-    ctx->prologue_patch_pos = emit_prologue_a64(cc);
+    ctx->prologue_patch_pos = emit_prologue_a64(cc);
+
+    if (a64_is_wide_vector(ret_type)) {
+        ctx->sret_off = alloc_slot(cc, ctx->next_vreg++, 8);
+        emit_store(cc->buf, &cc->pos, cc->buflen, A64_X8, A64_FP,
+                   ctx->sret_off, 8);
+    }
+
+    if (func_meta->func && func_meta->func->fast_cc && num_params > 0) {
+        static const uint8_t param_fp_regs[] = {
+            A64_D0, A64_D1, A64_D2, A64_D3,
+            A64_D4, A64_D5, A64_D6, A64_D7
+        };
+        lr_type_t **param_types = func_meta->param_types;
+        lr_cc_loc_t *locs = lr_arena_array(arena, lr_cc_loc_t, num_params);
+        if (!locs)
+            return -1;
+        (void)lr_target_fast_cc_assign(param_types, num_params, 8, 8, locs);
+        for (uint32_t i = 0; i < num_params; i++) {
+            const lr_type_t *pty = param_types[i];
+            if (locs[i].kind == LR_CC_LOC_FP && is_fp_abi_type(pty)) {
+                emit_store_fp_slot(cc, param_vregs[i],
+                                   param_fp_regs[locs[i].index],
+                                   fp_abi_size(pty));
+            } else if (locs[i].kind == LR_CC_LOC_FP) {
+                emit_u32(cc->buf, &cc->pos, cc->buflen,
+                         enc_fmov_to_gpr(A64_X9,
+                                         param_fp_regs[locs[i].index]));
+                emit_store_slot(cc, param_vregs[i], A64_X9);
+            } else if (locs[i].kind == LR_CC_LOC_GP) {
+                emit_store_slot(cc, param_vregs[i],
+                                param_regs[locs[i].index]);
+            } else {
+                emit_load(cc->buf, &cc->pos, cc->buflen, A64_X9, A64_FP,
+                          16 + (int32_t)(locs[i].index * 8u), 8);
+                emit_store_slot(cc, param_vregs[i], A64_X9);
+            }
+        }
+    } else if (cc->func_uses_fp_abi) {
+        static const uint8_t param_fp_regs[] = {
+            A64_D0, A64_D1, A64_D2, A64_D3,
+            A64_D4, A64_D5, A64_D6, A64_D7
+        };
+        lr_type_t **param_types = func_meta->param_types;
+        uint32_t gp_used = 0;
+        uint32_t fp_used = 0;
+        uint32_t stack_used = 0;
+        for (uint32_t i = 0; i < num_params; i++) {
+            const lr_type_t *pty = param_types ? param_types[i] : NULL;
+            if (a64_is_complex8_fp(pty) && fp_used + 2 <= 8) {
+                /* complex(4) HFA arrives in two single-precision FP regs
+                   (s n, n+1); store both lanes into the 8-byte slot. */
+                int32_t off = alloc_slot(cc, param_vregs[i], 8);
+                emit_fp_store(cc->buf, &cc->pos, cc->buflen,
+                              param_fp_regs[fp_used], A64_FP, off, 4);
+                emit_fp_store(cc->buf, &cc->pos, cc->buflen,
+                              param_fp_regs[fp_used + 1], A64_FP, off + 4, 4);
+                fp_used += 2;
+            } else if (a64_is_complex16(pty) && fp_used + 2 <= 8) {
+                /* complex(8) HFA arrives in two double-precision FP regs
+                   (d n, n+1); store both lanes into the 16-byte slot. */
+                int32_t off = alloc_slot(cc, param_vregs[i], 16);
+                emit_fp_store(cc->buf, &cc->pos, cc->buflen,
+                              param_fp_regs[fp_used], A64_FP, off, 8);
+                emit_fp_store(cc->buf, &cc->pos, cc->buflen,
+                              param_fp_regs[fp_used + 1], A64_FP, off + 8, 8);
+                fp_used += 2;
+            } else if (is_fp_abi_type(pty) && fp_used < 8) {
+                if (getenv("LIRIC_DBG_A64_PARAMS")) {
+                    fprintf(stderr,
+                            "[a64 param] func=%s idx=%u vreg=%u src=fpr%u ty=%d\n",
+                            cc->func_name ? cc->func_name : "<anon>",
+                            i, param_vregs[i], fp_used,
+                            pty ? (int)pty->kind : -1);
+                }
+                emit_store_fp_slot(cc, param_vregs[i],
+                                   param_fp_regs[fp_used],
+                                   fp_abi_size(pty));
+                fp_used++;
+            } else if (!is_fp_abi_type(pty) && gp_used < 8) {
+                if (getenv("LIRIC_DBG_A64_PARAMS")) {
+                    fprintf(stderr,
+                            "[a64 param] func=%s idx=%u vreg=%u src=gpr%u ty=%d\n",
+                            cc->func_name ? cc->func_name : "<anon>",
+                            i, param_vregs[i], gp_used,
+                            pty ? (int)pty->kind : -1);
+                }
+                emit_store_slot(cc, param_vregs[i], param_regs[gp_used]);
+                gp_used++;
+            } else {
+                int32_t caller_off = 16 + (int32_t)(stack_used * 8u);
+                if (is_fp_abi_type(pty)) {
+                    uint8_t fsize = fp_abi_size(pty);
+                    emit_fp_load(cc->buf, &cc->pos, cc->buflen,
+                                 FP_SCRATCH0, A64_FP, caller_off, fsize);
+                    emit_store_fp_slot(cc, param_vregs[i], FP_SCRATCH0,
+                                       fsize);
+                } else {
+                    emit_load(cc->buf, &cc->pos, cc->buflen, A64_X9,
+                              A64_FP, caller_off, 8);
+                    emit_store_slot(cc, param_vregs[i], A64_X9);
+                }
+                stack_used++;
+            }
+        }
+    } else {
+        for (uint32_t i = 0; i < num_params && i < 8; i++)
+            emit_store_slot(cc, param_vregs[i], param_regs[i]);
+        for (uint32_t i = 8; i < num_params; i++) {
+            int32_t caller_off = 16 + (int32_t)(i - 8) * 8;
+            emit_load(cc->buf, &cc->pos, cc->buflen, A64_X9, A64_FP,
+                      caller_off, 8);
+            emit_store_slot(cc, param_vregs[i], A64_X9);
+        }
+    }
+
+    *compile_ctx = ctx;
+    return 0;
+}
+
+static int aarch64_compile_set_block(void *compile_ctx, uint32_t block_id) {
+    a64_direct_ctx_t *ctx = (a64_direct_ctx_t *)compile_ctx;
+    if (!ctx)
+        return -1;
+    /* Flush deferred terminators on block transitions so branch fixups
+       are emitted before we bind the next block entry. This also ensures
+       empty blocks receive concrete offsets and don't leave unresolved
+       placeholder branches (which encode as self-loops on AArch64). */
+    if (ctx->deferred.pending &&
+        (!ctx->has_current_block || ctx->deferred.block_id != block_id)) {
+        if (a64_flush_deferred_terminator(ctx) != 0)
+            return -1;
+    }
+    if (a64_direct_ensure_block_offsets(ctx, block_id) != 0)
+        return -1;
+    ctx->current_block_id = block_id;
+    ctx->has_current_block = true;
+    if (ctx->cc.block_offsets[block_id] == SIZE_MAX) {
+        ctx->cc.block_offsets[block_id] = ctx->cc.pos;
+        ctx->cc.block_entry_offsets[block_id] = ctx->cc.pos;
+        if (block_id < ctx->cc.num_loop_headers &&
+            ctx->cc.loop_headers[block_id])
+            emit_profile_count(&ctx->cc);
+    }
+    if (getenv("LIRIC_DBG_A64_BLOCKS") != NULL) {
+        fprintf(stderr,
+                "[a64 block] func=%s block=%u pos=%zu off=%zu entry=%zu\n",
+                ctx->cc.func_name ? ctx->cc.func_name : "<anon>",
+                block_id,
+                ctx->cc.pos,
+                ctx->cc.block_offsets[block_id],
+                ctx->cc.block_entry_offsets[block_id]);
+    }
+    /* Entering a new block must invalidate cached register mappings before
+       emitting non-PHI instructions, but keep offsets bound for empty blocks. */
+    ctx->block_offset_pending = true;
+    return 0;
+}
+
+/* ---- Vector lowering ---- */
+
+/*
+ * Vector values live in stack slots like other aggregates, one element per
+ * lane at lr_type_size(elem) spacing (i1 lanes take a byte each).  Whole
+ * vectors are processed 16 bytes at a time in V2-V5 with Advanced SIMD
+ * instructions; vectors of 2, 4 or 8 bytes use the low lanes of a register.
+ * Operations without a packed form (division, i64 multiply, casts, ...) are
+ * scalarized: each lane is copied into a reserved lane vreg and the scalar
+ * instruction is emitted through the normal ISel path, so lane semantics
+ * always match the scalar lowering.
+ */
+
+#define A64_VEC_A   A64_D2
+#define A64_VEC_B   A64_D3
+#define A64_VEC_T   A64_D4
+#define A64_VEC_T2  A64_D5
+
+static int aarch64_compile_emit(void *compile_ctx,
+                                const lr_compile_inst_desc_t *desc);
+
+/* Advanced SIMD "three same": Vd = Vn op Vm.  size is the element size
+   field; FP forms pass (a << 1) | sz. */
+static uint32_t enc_vec3(bool q, bool u, uint8_t size, uint8_t opcode,
+                         uint8_t vd, uint8_t vn, uint8_t vm) {
+    return 0x0E200400u | ((uint32_t)q << 30) | ((uint32_t)u << 29)
+         | ((uint32_t)(size & 3u) << 22) | ((uint32_t)vm << 16)
+         | ((uint32_t)(opcode & 0x1Fu) << 11) | ((uint32_t)vn << 5) | vd;
+}
+
+/* Advanced SIMD "two-register misc": Vd = op Vn. */
+static uint32_t enc_vec2(bool q, bool u, uint8_t size, uint8_t opcode,
+                         uint8_t vd, uint8_t vn) {
+    return 0x0E200800u | ((uint32_t)q << 30) | ((uint32_t)u << 29)
+         | ((uint32_t)(size & 3u) << 22) | ((uint32_t)(opcode & 0x1Fu) << 12)
+         | ((uint32_t)vn << 5) | vd;
+}
+
+/* ldur/stur of the low n bytes (1, 2, 4, 8 or 16) of a SIMD register;
+   narrower loads zero the rest of the register. */
+static uint32_t enc_vec_ldst(uint8_t n, bool load, uint8_t vt, uint8_t rn,
+                             int32_t imm9) {
+    uint32_t base;
+    switch (n) {
+    case 1:  base = 0x3C000000u; break;
+    case 2:  base = 0x7C000000u; break;
+    case 4:  base = 0xBC000000u; break;
+    case 8:  base = 0xFC000000u; break;
+    default: base = 0x3C800000u; break;
+    }
+    if (load)
+        base |= 0x00400000u;
+    return base | ((uint32_t)(imm9 & 0x1FF) << 12) | ((uint32_t)rn << 5) | vt;
+}
+
+typedef struct a64_vec_layout {
+    const lr_type_t *elem;
+    uint32_t lanes;
+    uint8_t esz;
+    size_t total;
+} a64_vec_layout_t;
+
+typedef enum {
+    A64_VEC_ZERO,       /* undef, null or zeroinitializer */
+    A64_VEC_FRAME,      /* bytes at [fp + off] */
+    A64_VEC_INDIRECT,   /* pointer to the bytes at [fp + off] */
+    A64_VEC_PTR,        /* operand is the address of the bytes */
+} a64_vec_src_kind_t;
+
+typedef struct a64_vec_src {
+    a64_vec_src_kind_t kind;
+    int32_t off;
+    lr_operand_t op;
+} a64_vec_src_t;
+
+static bool a64_vec_layout(const lr_type_t *ty, a64_vec_layout_t *out) {
+    const lr_type_t *elem;
+    if (!ty || ty->kind != LR_TYPE_VECTOR || !ty->array.elem ||
+        ty->array.count == 0 || ty->array.count > 4096)
+        return false;
+    elem = ty->array.elem;
+    switch (elem->kind) {
+    case LR_TYPE_I1: case LR_TYPE_I8: case LR_TYPE_I16:
+    case LR_TYPE_I32: case LR_TYPE_I64: case LR_TYPE_PTR:
+    case LR_TYPE_FLOAT: case LR_TYPE_DOUBLE:
+        break;
+    default:
+        return false;
+    }
+    out->elem = elem;
+    out->lanes = (uint32_t)ty->array.count;
+    out->esz = (uint8_t)lr_type_size(elem);
+    out->total = (size_t)out->esz * out->lanes;
+    return true;
+}
+
+static bool a64_vec_is_fp(const a64_vec_layout_t *l) {
+    return l->elem->kind == LR_TYPE_FLOAT || l->elem->kind == LR_TYPE_DOUBLE;
+}
+
+/* Bytes per packed step, or 0 when the vector has no packed form.  64-bit
+   lanes only have 128-bit arithmetic forms. */
+static uint8_t a64_vec_chunk(const a64_vec_layout_t *l) {
+    if (l->total % 16 == 0)
+        return 16;
+    if (l->esz < 8 && (l->total == 8 || l->total == 4 || l->total == 2))
+        return (uint8_t)l->total;
+    return 0;
+}
+
+static uint8_t a64_vec_log2(uint8_t esz) {
+    return esz == 1 ? 0 : esz == 2 ? 1 : esz == 4 ? 2 : 3;
+}
+
+static int32_t a64_vec_temp_slot(a64_direct_ctx_t *ctx, size_t size) {
+    return alloc_slot(&ctx->cc, ctx->next_vreg++, size);
+}
+
+/* Constants are written to a fresh frame temporary: an integer immediate
+   is the packed low eight bytes of the vector (zero above, as phi copies
+   treat it), an FP immediate is splatted across the lanes. */
+static void a64_vec_src_init(a64_direct_ctx_t *ctx, const lr_operand_t *op,
+                             const a64_vec_layout_t *l, a64_vec_src_t *out) {
+    a64_compile_ctx_t *cc = &ctx->cc;
+    memset(out, 0, sizeof(*out));
+    switch (op->kind) {
+    case LR_VAL_UNDEF:
+    case LR_VAL_NULL:
+        out->kind = A64_VEC_ZERO;
+        return;
+    case LR_VAL_IMM_I64:
+        if (op->imm_i64 == 0) {
+            out->kind = A64_VEC_ZERO;
+            return;
+        }
+        out->kind = A64_VEC_FRAME;
+        out->off = a64_vec_temp_slot(ctx, align_up_size(l->total, 8));
+        if (l->total > 8)
+            emit_mem_zero_base(cc, A64_FP, out->off + 8, l->total - 8);
+        emit_move_imm_ctx(cc, A64_X9, op->imm_i64, true);
+        emit_store(cc->buf, &cc->pos, cc->buflen, A64_X9, A64_FP, out->off, 8);
+        return;
+    case LR_VAL_IMM_F64: {
+        lr_operand_t lane = *op;
+        lane.type = (lr_type_t *)l->elem;
+        out->kind = A64_VEC_FRAME;
+        out->off = a64_vec_temp_slot(ctx, align_up_size(l->total, 8));
+        emit_load_operand(cc, &lane, A64_X9);
+        for (uint32_t i = 0; i < l->lanes; i++)
+            emit_store(cc->buf, &cc->pos, cc->buflen, A64_X9, A64_FP,
+                       out->off + (int32_t)(i * l->esz), l->esz);
+        return;
+    }
+    case LR_VAL_VREG: {
+        uint32_t v = op->vreg;
+        int32_t static_off = lr_target_lookup_static_alloca_offset(
+            cc->static_alloca_offsets, cc->num_static_alloca_offsets, v);
+        if (static_off != 0) {
+            out->kind = A64_VEC_FRAME;
+            out->off = static_off;
+            return;
+        }
+        if (v >= cc->num_stack_slots || cc->stack_slots[v] == 0) {
+            out->kind = A64_VEC_FRAME;
+            out->off = alloc_slot(cc, v, l->total);
+            return;
+        }
+        out->off = cc->stack_slots[v];
+        out->kind = vreg_uses_indirect_aggregate_storage(cc, v, l->total)
+                    ? A64_VEC_INDIRECT : A64_VEC_FRAME;
+        return;
+    }
+    default:
+        out->kind = A64_VEC_PTR;
+        out->op = *op;
+        return;
+    }
+}
+
+/* Resolve src to [base + disp], loading a pointer into reg if needed. */
+static void a64_vec_src_addr(a64_compile_ctx_t *cc, const a64_vec_src_t *src,
+                             uint8_t reg, uint8_t *base, int32_t *disp) {
+    *base = A64_FP;
+    *disp = 0;
+    switch (src->kind) {
+    case A64_VEC_FRAME:
+        *disp = src->off;
+        return;
+    case A64_VEC_INDIRECT:
+        emit_load(cc->buf, &cc->pos, cc->buflen, reg, A64_FP, src->off, 8);
+        invalidate_cached_reg_a64(cc, reg);
+        *base = reg;
+        return;
+    case A64_VEC_PTR:
+        emit_load_operand(cc, &src->op, reg);
+        invalidate_cached_reg_a64(cc, reg);
+        *base = reg;
+        return;
+    case A64_VEC_ZERO:
+        return;
+    }
+}
+
+static void a64_vec_load_mem(a64_compile_ctx_t *cc, uint8_t vt, uint8_t base,
+                             int32_t disp, size_t n) {
+    if (disp < -256 || disp > 255) {
+        emit_addr(cc->buf, &cc->pos, cc->buflen, A64_X15, base, disp);
+        base = A64_X15;
+        disp = 0;
+    }
+    emit_u32(cc->buf, &cc->pos, cc->buflen,
+             enc_vec_ldst((uint8_t)n, true, vt, base, disp));
+}
+
+static void a64_vec_store_mem(a64_compile_ctx_t *cc, uint8_t vt, uint8_t base,
+                              int32_t disp, size_t n) {
+    if (disp < -256 || disp > 255) {
+        emit_addr(cc->buf, &cc->pos, cc->buflen, A64_X15, base, disp);
+        base = A64_X15;
+        disp = 0;
+    }
+    emit_u32(cc->buf, &cc->pos, cc->buflen,
+             enc_vec_ldst((uint8_t)n, false, vt, base, disp));
+}
+
+static void a64_vec_load_src(a64_compile_ctx_t *cc, uint8_t vt,
+                             const a64_vec_src_t *src, uint8_t base,
+                             int32_t disp, size_t n) {
+    if (src->kind == A64_VEC_ZERO)
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_vec3(true, true, 0, 0x03, vt, vt, vt));   /* eor */
+    else
+        a64_vec_load_mem(cc, vt, base, disp, n);
+}
+
+/* Copy total bytes of src to [dst_base + dst_disp]. */
+static void a64_vec_copy(a64_compile_ctx_t *cc, const a64_vec_src_t *src,
+                         uint8_t dst_base, int32_t dst_disp, size_t total) {
+    uint8_t base;
+    int32_t disp;
+    size_t off = 0;
+    if (src->kind == A64_VEC_ZERO) {
+        emit_mem_zero_base(cc, dst_base, dst_disp, total);
+        return;
+    }
+    a64_vec_src_addr(cc, src, A64_X12, &base, &disp);
+    for (; total - off >= 16; off += 16) {
+        a64_vec_load_mem(cc, A64_VEC_A, base, disp + (int32_t)off, 16);
+        a64_vec_store_mem(cc, A64_VEC_A, dst_base, dst_disp + (int32_t)off, 16);
+    }
+    if (off < total)
+        emit_mem_copy_base_to_base(cc, dst_base, dst_disp + (int32_t)off,
+                                   base, disp + (int32_t)off, total - off);
+}
+
+/* Object symbol of a direct callee, or UINT32_MAX when the callee needs
+   an indirect call. */
+static uint32_t a64_callee_symbol(a64_compile_ctx_t *cc,
+                                  const lr_operand_t *op) {
+    const char *sym_name;
+    if (op->kind != LR_VAL_GLOBAL || op->global_offset != 0 ||
+        !cc->obj_ctx || !cc->mod)
+        return UINT32_MAX;
+    sym_name = lr_module_symbol_name(cc->mod, op->global_id);
+    if (!sym_name)
+        return UINT32_MAX;
+    return lr_obj_ensure_symbol(cc->obj_ctx, sym_name, false, 0, 0);
+}
+
+/* "bl" to a global through a BRANCH26 relocation; the JIT sends callees
+   out of bl reach through a stub.  Returns false when the callee needs an
+   indirect call. */
+static bool a64_emit_call_global(a64_compile_ctx_t *cc,
+                                 const lr_operand_t *op) {
+    uint32_t sym_idx = a64_callee_symbol(cc, op);
+    if (sym_idx == UINT32_MAX)
+        return false;
+    lr_obj_add_reloc(cc->obj_ctx, (uint32_t)cc->pos, sym_idx,
+                     LR_RELOC_ARM64_BRANCH26);
+    emit_u32(cc->buf, &cc->pos, cc->buflen, 0x94000000u);
+    cc->frame_pinned = true;
+    return true;
+}
+
+/* Tail call: restore fp/lr and branch, so the callee returns straight to
+   our caller.  "b" takes the same BRANCH26 relocation (and JIT stub) as
+   "bl"; other callees go through X16. */
+static void a64_emit_tail_jump(a64_compile_ctx_t *cc,
+                               const lr_operand_t *op) {
+    uint32_t sym_idx = a64_callee_symbol(cc, op);
+    if (sym_idx == UINT32_MAX)
+        emit_load_operand(cc, op, A64_X16);
+    emit_frame_teardown_a64(cc);
+    if (sym_idx != UINT32_MAX) {
+        lr_obj_add_reloc(cc->obj_ctx, (uint32_t)cc->pos, sym_idx,
+                         LR_RELOC_ARM64_BRANCH26);
+        emit_u32(cc->buf, &cc->pos, cc->buflen, 0x14000000u);
+        return;
+    }
+    emit_u32(cc->buf, &cc->pos, cc->buflen,
+             0xD61F0000u | ((uint32_t)A64_X16 << 5));      /* br x16 */
+}
+
+/* A call marked tail (and found in tail position by the replay) becomes a
+   branch when its arguments all travel in registers, none points into our
+   frame, and its result comes back where our own return puts it.  Calls
+   failing this, musttail included, stay ordinary calls. */
+static bool a64_can_tail_call(const a64_compile_ctx_t *cc,
+                              const lr_compile_inst_desc_t *desc,
+                              const lr_operand_t *ops, uint32_t stack_bytes,
+                              bool use_fp_abi) {
+    if (desc->call_tail == LR_CALL_TAIL_NONE || stack_bytes > 0)
+        return false;
+    if (is_fp_abi_type(desc->type) && use_fp_abi != cc->func_uses_fp_abi)
+        return false;
+    for (uint32_t i = 1; i < desc->num_operands; i++) {
+        if (a64_is_wide_vector(ops[i].type))
+            return false;
+        if (ops[i].kind == LR_VAL_VREG &&
+            lr_target_lookup_static_alloca_offset(
+                cc->static_alloca_offsets, cc->num_static_alloca_offsets,
+                ops[i].vreg) != 0)
+            return false;
+    }
+    return true;
+}
+
+/* Load a call argument into reg; wide vectors pass their address (see
+   a64_is_wide_vector), constants going through a zeroed temporary. */
+static void a64_emit_call_arg(a64_direct_ctx_t *ctx, const lr_operand_t *op,
+                              uint8_t reg) {
+    a64_compile_ctx_t *cc = &ctx->cc;
+    a64_vec_layout_t l;
+    a64_vec_src_t v;
+    uint8_t base;
+    int32_t disp;
+    if (!a64_is_wide_vector(op->type) || !a64_vec_layout(op->type, &l)) {
+        emit_load_operand(cc, op, reg);
+        return;
+    }
+    a64_vec_src_init(ctx, op, &l, &v);
+    if (v.kind == A64_VEC_ZERO) {
+        v.kind = A64_VEC_FRAME;
+        v.off = a64_vec_temp_slot(ctx, l.total);
+        emit_mem_zero_base(cc, A64_FP, v.off, l.total);
+    }
+    a64_vec_src_addr(cc, &v, reg, &base, &disp);
+    if (base != reg || disp != 0)
+        emit_addr(cc->buf, &cc->pos, cc->buflen, reg, base, disp);
+    invalidate_cached_reg_a64(cc, reg);
+}
+
+/* Turn all-ones/zero lane masks in A into one 0/1 byte per lane, packed
+   into the low bytes of A. */
+static void a64_vec_mask_to_bytes(a64_compile_ctx_t *cc, uint8_t esz) {
+    for (uint8_t lg = a64_vec_log2(esz); lg > 0; lg--)
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_vec2(false, false, (uint8_t)(lg - 1u), 0x12,
+                          A64_VEC_A, A64_VEC_A));               /* xtn */
+    emit_u32(cc->buf, &cc->pos, cc->buflen,
+             enc_vec2(true, true, 0, 0x0B, A64_VEC_A, A64_VEC_A));  /* neg */
+}
+
+/* Emit desc once per lane as a scalar instruction on the reserved lane
+   vregs, staging operand lanes and the result lane through memory. */
+static int a64_vec_emit_per_lane(a64_direct_ctx_t *ctx,
+                                 const lr_compile_inst_desc_t *desc,
+                                 const lr_operand_t *ops) {
+    a64_compile_ctx_t *cc = &ctx->cc;
+    a64_vec_layout_t dl;
+    a64_vec_layout_t sl[3];
+    a64_vec_src_t src[3];
+    bool is_vec[3];
+    lr_operand_desc_t lane_ops[3];
+    lr_compile_inst_desc_t lane;
+    static const uint8_t bases[3] = {A64_X12, A64_X13, A64_X14};
+    uint32_t nops = desc->num_operands;
+    uint32_t base_vreg;
+    int32_t lane_off[4];
+    int32_t dst_off;
+    int rc = 0;
+
+    if (nops > 3 || !a64_vec_layout(desc->type, &dl))
+        return -1;
+    if (ctx->vec_lane_vregs == 0) {
+        ctx->vec_lane_vregs = ctx->next_vreg;
+        ctx->next_vreg += 4u;
+    }
+    base_vreg = ctx->vec_lane_vregs;
+    for (uint32_t j = 0; j < 4; j++)
+        lane_off[j] = alloc_slot(cc, base_vreg + j, 8);
+    dst_off = alloc_slot(cc, desc->dest, dl.total);
+
+    for (uint32_t j = 0; j < nops; j++) {
+        is_vec[j] = a64_vec_layout(ops[j].type, &sl[j]);
+        if (is_vec[j]) {
+            if (sl[j].lanes != dl.lanes)
+                return -1;
+            a64_vec_src_init(ctx, &ops[j], &sl[j], &src[j]);
+            memset(&lane_ops[j], 0, sizeof(lane_ops[j]));
+            lane_ops[j].kind = LR_OP_KIND_VREG;
+            lane_ops[j].vreg = base_vreg + j;
+            lane_ops[j].type = (lr_type_t *)sl[j].elem;
+        } else {
+            lane_ops[j] = desc->operands[j];
+        }
+    }
+    lane = *desc;
+    lane.type = (lr_type_t *)dl.elem;
+    lane.dest = base_vreg + 3u;
+    lane.operands = lane_ops;
+
+    for (uint32_t i = 0; i < dl.lanes && rc == 0; i++) {
+        for (uint32_t j = 0; j < nops; j++) {
+            uint8_t base;
+            int32_t disp;
+            if (!is_vec[j])
+                continue;
+            if (src[j].kind == A64_VEC_ZERO) {
+                emit_store(cc->buf, &cc->pos, cc->buflen, A64_SP, A64_FP,
+                           lane_off[j], 8);                     /* xzr */
+                continue;
+            }
+            a64_vec_src_addr(cc, &src[j], bases[j], &base, &disp);
+            emit_load(cc->buf, &cc->pos, cc->buflen, A64_X9, base,
+                      disp + (int32_t)(i * sl[j].esz), sl[j].esz);
+            emit_store(cc->buf, &cc->pos, cc->buflen, A64_X9, A64_FP,
+                       lane_off[j], 8);
+        }
+        invalidate_cached_gprs_a64(cc);
+        rc = aarch64_compile_emit(ctx, &lane);
+        invalidate_cached_gprs_a64(cc);
+        emit_load(cc->buf, &cc->pos, cc->buflen, A64_X9, A64_FP, lane_off[3],
+                  dl.esz);
+        emit_store(cc->buf, &cc->pos, cc->buflen, A64_X9, A64_FP,
+                   dst_off + (int32_t)(i * dl.esz), dl.esz);
+    }
+    invalidate_cached_gprs_a64(cc);
+    return rc;
+}
+
+/* Packed encoding of A = A op B for one chunk, or 0 when op has no packed
+   form for this layout.  Right shifts negate B first (see emit_binop). */
+static uint32_t a64_vec_binop_insn(lr_opcode_t op, const a64_vec_layout_t *l,
+                                   bool q) {
+    uint8_t size = a64_vec_log2(l->esz);
+    uint8_t sz = l->esz == 8 ? 1 : 0;
+    bool is_i1 = l->elem->kind == LR_TYPE_I1;
+    uint8_t a = A64_VEC_A, b = A64_VEC_B;
+    if (a64_vec_is_fp(l)) {
+        switch (op) {
+        case LR_OP_FADD: return enc_vec3(q, false, sz, 0x1A, a, a, b);
+        case LR_OP_FSUB: return enc_vec3(q, false, (uint8_t)(2u | sz), 0x1A, a, a, b);
+        case LR_OP_FMUL: return enc_vec3(q, true, sz, 0x1B, a, a, b);
+        case LR_OP_FDIV: return enc_vec3(q, true, sz, 0x1F, a, a, b);
+        default:         return 0;
+        }
+    }
+    switch (op) {
+    case LR_OP_AND: return enc_vec3(q, false, 0, 0x03, a, a, b);
+    case LR_OP_OR:  return enc_vec3(q, false, 2, 0x03, a, a, b);
+    case LR_OP_XOR: return enc_vec3(q, true, 0, 0x03, a, a, b);
+    default:        break;
+    }
+    if (is_i1)
+        return 0;
+    switch (op) {
+    case LR_OP_ADD:  return enc_vec3(q, false, size, 0x10, a, a, b);
+    case LR_OP_SUB:  return enc_vec3(q, true, size, 0x10, a, a, b);
+    case LR_OP_MUL:
+        return l->esz == 8 ? 0 : enc_vec3(q, false, size, 0x13, a, a, b);
+    case LR_OP_SHL:
+    case LR_OP_LSHR: return enc_vec3(q, true, size, 0x08, a, a, b);  /* ushl */
+    case LR_OP_ASHR: return enc_vec3(q, false, size, 0x08, a, a, b); /* sshl */
+    default:         return 0;
+    }
+}
+
+static int a64_vec_emit_binop(a64_direct_ctx_t *ctx,
+                              const lr_compile_inst_desc_t *desc,
+                              const lr_operand_t *ops) {
+    a64_compile_ctx_t *cc = &ctx->cc;
+    a64_vec_layout_t l;
+    a64_vec_src_t a, b;
+    uint8_t chunk;
+    uint32_t insn;
+    bool shr;
+    uint8_t abase, bbase;
+    int32_t adisp, bdisp;
+    int32_t dst_off;
+
+    if (!a64_vec_layout(desc->type, &l))
+        return -1;
+    chunk = a64_vec_chunk(&l);
+    insn = chunk ? a64_vec_binop_insn((lr_opcode_t)desc->op, &l, chunk == 16)
+                 : 0;
+    if (insn == 0)
+        return a64_vec_emit_per_lane(ctx, desc, ops);
+    shr = desc->op == LR_OP_LSHR || desc->op == LR_OP_ASHR;
+
+    dst_off = alloc_slot(cc, desc->dest, l.total);
+    a64_vec_src_init(ctx, &ops[0], &l, &a);
+    a64_vec_src_init(ctx, &ops[1], &l, &b);
+    a64_vec_src_addr(cc, &a, A64_X12, &abase, &adisp);
+    a64_vec_src_addr(cc, &b, A64_X13, &bbase, &bdisp);
+    for (size_t off = 0; off < l.total; off += chunk) {
+        a64_vec_load_src(cc, A64_VEC_A, &a, abase, adisp + (int32_t)off, chunk);
+        a64_vec_load_src(cc, A64_VEC_B, &b, bbase, bdisp + (int32_t)off, chunk);
+        if (shr)
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     enc_vec2(true, true, a64_vec_log2(l.esz), 0x0B,
+                              A64_VEC_B, A64_VEC_B));           /* neg */
+        emit_u32(cc->buf, &cc->pos, cc->buflen, insn);
+        a64_vec_store_mem(cc, A64_VEC_A, A64_FP, dst_off + (int32_t)off, chunk);
+    }
+    return 0;
+}
+
+static int a64_vec_emit_fneg(a64_direct_ctx_t *ctx,
+                             const lr_compile_inst_desc_t *desc,
+                             const lr_operand_t *ops) {
+    a64_compile_ctx_t *cc = &ctx->cc;
+    a64_vec_layout_t l;
+    a64_vec_src_t a;
+    uint8_t chunk;
+    uint8_t abase;
+    int32_t adisp;
+    int32_t dst_off;
+
+    if (!a64_vec_layout(desc->type, &l) || !a64_vec_is_fp(&l))
+        return -1;
+    chunk = a64_vec_chunk(&l);
+    if (chunk == 0)
+        return a64_vec_emit_per_lane(ctx, desc, ops);
+    dst_off = alloc_slot(cc, desc->dest, l.total);
+    a64_vec_src_init(ctx, &ops[0], &l, &a);
+    a64_vec_src_addr(cc, &a, A64_X12, &abase, &adisp);
+    for (size_t off = 0; off < l.total; off += chunk) {
+        a64_vec_load_src(cc, A64_VEC_A, &a, abase, adisp + (int32_t)off, chunk);
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_vec2(chunk == 16, true, l.esz == 8 ? 3 : 2, 0x0F,
+                          A64_VEC_A, A64_VEC_A));
+        a64_vec_store_mem(cc, A64_VEC_A, A64_FP, dst_off + (int32_t)off, chunk);
+    }
+    return 0;
+}
+
+/* A = (A pred B) lane masks. */
+static void a64_vec_icmp_mask(a64_compile_ctx_t *cc, lr_icmp_pred_t pred,
+                              uint8_t esz, bool q) {
+    uint8_t size = a64_vec_log2(esz);
+    uint8_t opcode = 0x06;              /* cmgt/cmhi */
+    bool u = false, swap = false, invert = false;
+    switch (pred) {
+    case LR_ICMP_EQ:  opcode = 0x11; u = true; break;
+    case LR_ICMP_NE:  opcode = 0x11; u = true; invert = true; break;
+    case LR_ICMP_SGT: break;
+    case LR_ICMP_SLT: swap = true; break;
+    case LR_ICMP_SGE: opcode = 0x07; break;
+    case LR_ICMP_SLE: opcode = 0x07; swap = true; break;
+    case LR_ICMP_UGT: u = true; break;
+    case LR_ICMP_ULT: u = true; swap = true; break;
+    case LR_ICMP_UGE: opcode = 0x07; u = true; break;
+    case LR_ICMP_ULE: opcode = 0x07; u = true; swap = true; break;
+    }
+    emit_u32(cc->buf, &cc->pos, cc->buflen,
+             swap ? enc_vec3(q, u, size, opcode, A64_VEC_A, A64_VEC_B, A64_VEC_A)
+                  : enc_vec3(q, u, size, opcode, A64_VEC_A, A64_VEC_A, A64_VEC_B));
+    if (invert)
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_vec2(q, true, 0, 0x05, A64_VEC_A, A64_VEC_A));  /* not */
+}
+
+/* A = (A pred B) lane masks; clobbers T.  fcmeq/fcmge/fcmgt are false on
+   NaN, so unordered predicates invert the opposite ordered one. */
+static void a64_vec_fcmp_mask(a64_compile_ctx_t *cc, lr_fcmp_pred_t pred,
+                              uint8_t esz, bool q) {
+    uint8_t sz = esz == 8 ? 1 : 0;
+    uint32_t eq = enc_vec3(q, false, sz, 0x1C, A64_VEC_A, A64_VEC_A, A64_VEC_B);
+    uint32_t ge = enc_vec3(q, true, sz, 0x1C, A64_VEC_A, A64_VEC_A, A64_VEC_B);
+    uint32_t gt = enc_vec3(q, true, (uint8_t)(2u | sz), 0x1C,
+                           A64_VEC_A, A64_VEC_A, A64_VEC_B);
+    uint32_t le = enc_vec3(q, true, sz, 0x1C, A64_VEC_A, A64_VEC_B, A64_VEC_A);
+    uint32_t lt = enc_vec3(q, true, (uint8_t)(2u | sz), 0x1C,
+                           A64_VEC_A, A64_VEC_B, A64_VEC_A);
+    uint32_t insn = 0;
+    bool invert = false;
+    switch (pred) {
+    case LR_FCMP_FALSE:
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_vec3(q, true, 0, 0x03, A64_VEC_A, A64_VEC_A, A64_VEC_A));
+        return;
+    case LR_FCMP_TRUE:
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_vec3(q, true, 0, 0x11, A64_VEC_A, A64_VEC_A, A64_VEC_A));
+        return;
+    case LR_FCMP_ONE: case LR_FCMP_UEQ:
+    case LR_FCMP_ORD: case LR_FCMP_UNO:
+        /* ONE = a > b | b > a, ORD = a >= b | b > a. */
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_vec3(q, true,
+                          (uint8_t)((pred == LR_FCMP_ONE ||
+                                     pred == LR_FCMP_UEQ ? 2u : 0u) | sz),
+                          0x1C, A64_VEC_T, A64_VEC_A, A64_VEC_B));
+        emit_u32(cc->buf, &cc->pos, cc->buflen, lt);
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_vec3(q, false, 2, 0x03, A64_VEC_A, A64_VEC_A, A64_VEC_T));
+        invert = pred == LR_FCMP_UEQ || pred == LR_FCMP_UNO;
+        break;
+    case LR_FCMP_OEQ: insn = eq; break;
+    case LR_FCMP_OGT: insn = gt; break;
+    case LR_FCMP_OGE: insn = ge; break;
+    case LR_FCMP_OLT: insn = lt; break;
+    case LR_FCMP_OLE: insn = le; break;
+    case LR_FCMP_UNE: insn = eq; invert = true; break;
+    case LR_FCMP_ULE: insn = gt; invert = true; break;
+    case LR_FCMP_ULT: insn = ge; invert = true; break;
+    case LR_FCMP_UGE: insn = lt; invert = true; break;
+    case LR_FCMP_UGT: insn = le; invert = true; break;
+    }
+    if (insn)
+        emit_u32(cc->buf, &cc->pos, cc->buflen, insn);
+    if (invert)
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_vec2(q, true, 0, 0x05, A64_VEC_A, A64_VEC_A));  /* not */
+}
+
+static int a64_vec_emit_cmp(a64_direct_ctx_t *ctx,
+                            const lr_compile_inst_desc_t *desc,
+                            const lr_operand_t *ops) {
+    a64_compile_ctx_t *cc = &ctx->cc;
+    a64_vec_layout_t sl, dl;
+    a64_vec_src_t a, b;
+    uint8_t chunk;
+    uint8_t abase, bbase;
+    int32_t adisp, bdisp;
+    int32_t dst_off;
+    bool fp = desc->op == LR_OP_FCMP;
+
+    if (!a64_vec_layout(ops[0].type, &sl) || !a64_vec_layout(desc->type, &dl))
+        return -1;
+    chunk = a64_vec_chunk(&sl);
+    if (fp != a64_vec_is_fp(&sl) || chunk == 0 ||
+        (sl.elem->kind == LR_TYPE_I1 && desc->icmp_pred != LR_ICMP_EQ &&
+         desc->icmp_pred != LR_ICMP_NE))
+        return a64_vec_emit_per_lane(ctx, desc, ops);
+
+    dst_off = alloc_slot(cc, desc->dest, dl.total);
+    a64_vec_src_init(ctx, &ops[0], &sl, &a);
+    a64_vec_src_init(ctx, &ops[1], &sl, &b);
+    a64_vec_src_addr(cc, &a, A64_X12, &abase, &adisp);
+    a64_vec_src_addr(cc, &b, A64_X13, &bbase, &bdisp);
+    for (size_t off = 0; off < sl.total; off += chunk) {
+        a64_vec_load_src(cc, A64_VEC_A, &a, abase, adisp + (int32_t)off, chunk);
+        a64_vec_load_src(cc, A64_VEC_B, &b, bbase, bdisp + (int32_t)off, chunk);
+        if (fp)
+            a64_vec_fcmp_mask(cc, (lr_fcmp_pred_t)desc->fcmp_pred, sl.esz,
+                              chunk == 16);
+        else
+            a64_vec_icmp_mask(cc, (lr_icmp_pred_t)desc->icmp_pred, sl.esz,
+                              chunk == 16);
+        a64_vec_mask_to_bytes(cc, sl.esz);
+        a64_vec_store_mem(cc, A64_VEC_A, A64_FP,
+                          dst_off + (int32_t)(off / sl.esz), chunk / sl.esz);
+    }
+    return 0;
+}
+
+static int a64_vec_emit_select(a64_direct_ctx_t *ctx,
+                               const lr_compile_inst_desc_t *desc,
+                               const lr_operand_t *ops) {
+    a64_compile_ctx_t *cc = &ctx->cc;
+    a64_vec_layout_t l, cl;
+    a64_vec_src_t c, a, b;
+    bool vec_cond = a64_vec_layout(ops[0].type, &cl);
+    uint8_t chunk;
+    uint8_t cbase = A64_FP, abase, bbase;
+    int32_t cdisp = 0, adisp, bdisp;
+    int32_t dst_off;
+
+    if (!a64_vec_layout(desc->type, &l))
+        return -1;
+    chunk = a64_vec_chunk(&l);
+    if (chunk == 0)
+        return a64_vec_emit_per_lane(ctx, desc, ops);
+
+    dst_off = alloc_slot(cc, desc->dest, l.total);
+    if (vec_cond) {
+        a64_vec_src_init(ctx, &ops[0], &cl, &c);
+    } else {
+        /* Scalar condition: broadcast 0 - (cond & 1) to every lane. */
+        emit_load_operand(cc, &ops[0], A64_X9);
+        emit_move_imm_ctx(cc, A64_X10, 1, true);
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_logic_reg(0x8A000000u, true, A64_X9, A64_X9, A64_X10));
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_sub_reg(true, A64_X9, A64_SP, A64_X9));    /* neg */
+        invalidate_cached_reg_a64(cc, A64_X9);
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 0x4E080C00u | ((uint32_t)A64_X9 << 5) | A64_VEC_T2); /* dup .2d */
+    }
+    a64_vec_src_init(ctx, &ops[1], &l, &a);
+    a64_vec_src_init(ctx, &ops[2], &l, &b);
+    if (vec_cond)
+        a64_vec_src_addr(cc, &c, A64_X14, &cbase, &cdisp);
+    a64_vec_src_addr(cc, &a, A64_X12, &abase, &adisp);
+    a64_vec_src_addr(cc, &b, A64_X13, &bbase, &bdisp);
+    for (size_t off = 0; off < l.total; off += chunk) {
+        if (vec_cond) {
+            /* Widen the 0/1 condition bytes to all-ones/zero lanes. */
+            a64_vec_load_src(cc, A64_VEC_T, &c, cbase,
+                             cdisp + (int32_t)(off / l.esz), chunk / l.esz);
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     enc_vec2(true, true, 0, 0x0B, A64_VEC_T, A64_VEC_T));
+            for (uint8_t lg = 0; lg < a64_vec_log2(l.esz); lg++)
+                emit_u32(cc->buf, &cc->pos, cc->buflen,
+                         0x0F00A400u | (1u << (19u + lg)) |
+                         ((uint32_t)A64_VEC_T << 5) | A64_VEC_T);  /* sxtl */
+        } else {
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     enc_vec3(true, false, 2, 0x03, A64_VEC_T, A64_VEC_T2,
+                              A64_VEC_T2));                     /* mov */
+        }
+        a64_vec_load_src(cc, A64_VEC_A, &a, abase, adisp + (int32_t)off, chunk);
+        a64_vec_load_src(cc, A64_VEC_B, &b, bbase, bdisp + (int32_t)off, chunk);
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_vec3(true, true, 1, 0x03, A64_VEC_T, A64_VEC_A,
+                          A64_VEC_B));                          /* bsl */
+        a64_vec_store_mem(cc, A64_VEC_T, A64_FP, dst_off + (int32_t)off, chunk);
+    }
+    return 0;
+}
+
+/* X14 = address of lane idx of the vector at [base + disp] (idx clamped to
+   lane 0 when out of range, which LLVM leaves poison). */
+static void a64_vec_lane_addr(a64_compile_ctx_t *cc, uint8_t base,
+                              int32_t disp, const lr_operand_t *idx,
+                              const a64_vec_layout_t *l) {
+    uint8_t ibits = int_type_width_bits(idx->type);
+    emit_load_operand(cc, idx, A64_X10);
+    if (ibits > 0 && ibits < 64) {
+        emit_move_imm_ctx(cc, A64_X11, (int64_t)((1ull << ibits) - 1u), true);
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_logic_reg(0x8A000000u, true, A64_X10, A64_X10, A64_X11));
+    }
+    emit_move_imm_ctx(cc, A64_X11, (int64_t)l->lanes, true);
+    emit_u32(cc->buf, &cc->pos, cc->buflen,
+             enc_subs_reg(true, A64_X10, A64_X11));
+    emit_u32(cc->buf, &cc->pos, cc->buflen,
+             enc_csel(true, A64_X10, A64_X10, A64_SP, 3));      /* lo */
+    if (l->esz > 1) {
+        emit_move_imm_ctx(cc, A64_X11, a64_vec_log2(l->esz), true);
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 enc_lslv(true, A64_X10, A64_X10, A64_X11));
+    }
+    invalidate_cached_reg_a64(cc, A64_X10);
+    emit_addr(cc->buf, &cc->pos, cc->buflen, A64_X14, base, disp);
+    emit_u32(cc->buf, &cc->pos, cc->buflen,
+             enc_add_reg(true, A64_X14, A64_X14, A64_X10));
+}
+
+static int a64_vec_emit_extract(a64_direct_ctx_t *ctx,
+                                const lr_compile_inst_desc_t *desc,
+                                const lr_operand_t *ops) {
+    a64_compile_ctx_t *cc = &ctx->cc;
+    a64_vec_layout_t l;
+    a64_vec_src_t v;
+    uint8_t base;
+    int32_t disp;
+
+    if (desc->num_operands < 2 || !a64_vec_layout(ops[0].type, &l))
+        return -1;
+    a64_vec_src_init(ctx, &ops[0], &l, &v);
+    if (v.kind == A64_VEC_ZERO) {
+        emit_move_imm_ctx(cc, A64_X9, 0, true);
+    } else if (ops[1].kind == LR_VAL_IMM_I64) {
+        uint64_t lane = (uint64_t)ops[1].imm_i64;
+        if (lane >= l.lanes)
+            lane = 0;
+        a64_vec_src_addr(cc, &v, A64_X12, &base, &disp);
+        emit_load(cc->buf, &cc->pos, cc->buflen, A64_X9, base,
+                  disp + (int32_t)(lane * l.esz), l.esz);
+    } else {
+        a64_vec_src_addr(cc, &v, A64_X12, &base, &disp);
+        a64_vec_lane_addr(cc, base, disp, &ops[1], &l);
+        emit_load(cc->buf, &cc->pos, cc->buflen, A64_X9, A64_X14, 0, l.esz);
+    }
+    invalidate_cached_reg_a64(cc, A64_X9);
+    emit_store_slot(cc, desc->dest, A64_X9);
+    return 0;
+}
+
+static int a64_vec_emit_insert(a64_direct_ctx_t *ctx,
+                               const lr_compile_inst_desc_t *desc,
+                               const lr_operand_t *ops) {
+    a64_compile_ctx_t *cc = &ctx->cc;
+    a64_vec_layout_t l;
+    a64_vec_src_t v;
+    int32_t dst_off;
+
+    if (desc->num_operands < 3 || !a64_vec_layout(desc->type, &l))
+        return -1;
+    dst_off = alloc_slot(cc, desc->dest, l.total);
+    a64_vec_src_init(ctx, &ops[0], &l, &v);
+    a64_vec_copy(cc, &v, A64_FP, dst_off, l.total);
+    invalidate_cached_gprs_a64(cc);
+    if (ops[2].kind == LR_VAL_IMM_I64) {
+        uint64_t lane = (uint64_t)ops[2].imm_i64;
+        if (lane >= l.lanes)
+            return 0;
+        emit_load_operand(cc, &ops[1], A64_X9);
+        emit_store(cc->buf, &cc->pos, cc->buflen, A64_X9, A64_FP,
+                   dst_off + (int32_t)(lane * l.esz), l.esz);
+        return 0;
+    }
+    a64_vec_lane_addr(cc, A64_FP, dst_off, &ops[2], &l);
+    emit_load_operand(cc, &ops[1], A64_X9);
+    emit_store(cc->buf, &cc->pos, cc->buflen, A64_X9, A64_X14, 0, l.esz);
+    return 0;
+}
+
+static int a64_vec_emit_shuffle(a64_direct_ctx_t *ctx,
+                                const lr_compile_inst_desc_t *desc,
+                                const lr_operand_t *ops) {
+    a64_compile_ctx_t *cc = &ctx->cc;
+    a64_vec_layout_t sl, dl;
+    a64_vec_src_t src[2];
+    int32_t dst_off;
 
-    if (cc->func_uses_fp_abi) {
-        static const uint8_t param_fp_regs[] = {
-            A64_D0, A64_D1, A64_D2, A64_D3,
-            A64_D4, A64_D5, A64_D6, A64_D7
-        };
-        lr_type_t **param_types = func_meta->param_types;
-        uint32_t gp_used = 0;
-        uint32_t fp_used = 0;
-        uint32_t stack_used = 0;
-        for (uint32_t i = 0; i < num_params; i++) {
-            const lr_type_t *pty = param_types ? param_types[i] : NULL;
-            if (a64_is_complex8_fp(pty) && fp_used + 2 <= 8) {
-                /* complex(4) HFA arrives in two single-precision FP regs
-                   (s n, n+1); store both lanes into the 8-byte slot. */
-                int32_t off = alloc_slot(cc, param_vregs[i], 8);
-                emit_fp_store(cc->buf, &cc->pos, cc->buflen,
-                              param_fp_regs[fp_used], A64_FP, off, 4);
-                emit_fp_store(cc->buf, &cc->pos, cc->buflen,
-                              param_fp_regs[fp_used + 1], A64_FP, off + 4, 4);
-                fp_used += 2;
-            } else if (a64_is_complex16(pty) && fp_used + 2 <= 8) {
-                /* complex(8) HFA arrives in two double-precision FP regs
-                   (d n, n+1); store both lanes into the 16-byte slot. */
-                int32_t off = alloc_slot(cc, param_vregs[i], 16);
-                emit_fp_store(cc->buf, &cc->pos, cc->buflen,
-                              param_fp_regs[fp_used], A64_FP, off, 8);
-                emit_fp_store(cc->buf, &cc->pos, cc->buflen,
-                              param_fp_regs[fp_used + 1], A64_FP, off + 8, 8);
-                fp_used += 2;
-            } else if (is_fp_abi_type(pty) && fp_used < 8) {
-                if (getenv("LIRIC_DBG_A64_PARAMS")) {
-                    fprintf(stderr,
-                            "[a64 param] func=%s idx=%u vreg=%u src=fpr%u ty=%d\n",
-                            cc->func_name ? cc->func_name : "<anon>",
-                            i, param_vregs[i], fp_used,
-                            pty ? (int)pty->kind : -1);
-                }
-                emit_store_fp_slot(cc, param_vregs[i],
-                                   param_fp_regs[fp_used],
-                                   fp_abi_size(pty));
-                fp_used++;
-            } else if (!is_fp_abi_type(pty) && gp_used < 8) {
-                if (getenv("LIRIC_DBG_A64_PARAMS")) {
-                    fprintf(stderr,
-                            "[a64 param] func=%s idx=%u vreg=%u src=gpr%u ty=%d\n",
-                            cc->func_name ? cc->func_name : "<anon>",
-                            i, param_vregs[i], gp_used,
-                            pty ? (int)pty->kind : -1);
-                }
-                emit_store_slot(cc, param_vregs[i], param_regs[gp_used]);
-                gp_used++;
-            } else {
-                int32_t caller_off = 16 + (int32_t)(stack_used * 8u);
-                if (is_fp_abi_type(pty)) {
-                    uint8_t fsize = fp_abi_size(pty);
-                    emit_fp_load(cc->buf, &cc->pos, cc->buflen,
-                                 FP_SCRATCH0, A64_FP, caller_off, fsize);
-                    emit_store_fp_slot(cc, param_vregs[i], FP_SCRATCH0,
-                                       fsize);
-                } else {
-                    emit_load(cc->buf, &cc->pos, cc->buflen, A64_X9,
-                              A64_FP, caller_off, 8);
-                    emit_store_slot(cc, param_vregs[i], A64_X9);
-                }
-                stack_used++;
-            }
-        }
-    } else {
-        for (uint32_t i = 0; i < num_params && i < 8; i++)
-            emit_store_slot(cc, param_vregs[i], param_regs[i]);
-        for (uint32_t i = 8; i < num_params; i++) {
-            int32_t caller_off = 16 + (int32_t)(i - 8) * 8;
-            emit_load(cc->buf, &cc->pos, cc->buflen, A64_X9, A64_FP,
-                      caller_off, 8);
-            emit_store_slot(cc, param_vregs[i], A64_X9);
+    if (desc->num_operands < 2 || !a64_vec_layout(ops[0].type, &sl) ||
+        !a64_vec_layout(desc->type, &dl) || desc->num_indices != dl.lanes)
+        return -1;
+    dst_off = alloc_slot(cc, desc->dest, dl.total);
+    a64_vec_src_init(ctx, &ops[0], &sl, &src[0]);
+    a64_vec_src_init(ctx, &ops[1], &sl, &src[1]);
+    for (uint32_t i = 0; i < dl.lanes; i++) {
+        uint32_t m = desc->indices[i];
+        const a64_vec_src_t *s;
+        uint8_t base;
+        int32_t disp;
+        if (m == UINT32_MAX || m >= 2u * sl.lanes)
+            continue;
+        s = &src[m < sl.lanes ? 0 : 1];
+        if (s->kind == A64_VEC_ZERO) {
+            emit_store(cc->buf, &cc->pos, cc->buflen, A64_SP, A64_FP,
+                       dst_off + (int32_t)(i * dl.esz), dl.esz);
+            continue;
         }
+        a64_vec_src_addr(cc, s, A64_X12, &base, &disp);
+        emit_load(cc->buf, &cc->pos, cc->buflen, A64_X9, base,
+                  disp + (int32_t)((m % sl.lanes) * sl.esz), sl.esz);
+        emit_store(cc->buf, &cc->pos, cc->buflen, A64_X9, A64_FP,
+                   dst_off + (int32_t)(i * dl.esz), dl.esz);
     }
+    return 0;
+}
 
-    *compile_ctx = ctx;
+static int a64_vec_emit_load(a64_direct_ctx_t *ctx,
+                             const lr_compile_inst_desc_t *desc,
+                             const lr_operand_t *ops) {
+    a64_compile_ctx_t *cc = &ctx->cc;
+    a64_vec_layout_t l;
+    a64_vec_src_t p;
+    int32_t dst_off;
+
+    if (!a64_vec_layout(desc->type, &l))
+        return -1;
+    dst_off = alloc_slot(cc, desc->dest, l.total);
+    memset(&p, 0, sizeof(p));
+    p.kind = A64_VEC_PTR;
+    p.op = ops[0];
+    a64_vec_copy(cc, &p, A64_FP, dst_off, l.total);
     return 0;
 }
 
-static int aarch64_compile_set_block(void *compile_ctx, uint32_t block_id) {
-    a64_direct_ctx_t *ctx = (a64_direct_ctx_t *)compile_ctx;
-    if (!ctx)
+static int a64_vec_emit_store(a64_direct_ctx_t *ctx,
+                              const lr_compile_inst_desc_t *desc,
+                              const lr_operand_t *ops) {
+    a64_compile_ctx_t *cc = &ctx->cc;
+    a64_vec_layout_t l;
+    a64_vec_src_t v;
+
+    (void)desc;
+    if (!a64_vec_layout(ops[0].type, &l))
         return -1;
-    /* Flush deferred terminators on block transitions so branch fixups
-       are emitted before we bind the next block entry. This also ensures
-       empty blocks receive concrete offsets and don't leave unresolved
-       placeholder branches (which encode as self-loops on AArch64). */
-    if (ctx->deferred.pending &&
-        (!ctx->has_current_block || ctx->deferred.block_id != block_id)) {
-        if (a64_flush_deferred_terminator(ctx) != 0)
-            return -1;
+    a64_vec_src_init(ctx, &ops[0], &l, &v);
+    emit_load_operand(cc, &ops[1], A64_X13);
+    invalidate_cached_reg_a64(cc, A64_X13);
+    a64_vec_copy(cc, &v, A64_X13, 0, l.total);
+    return 0;
+}
+
+/* bitcast between vectors wider than a GPR is a byte copy; <N x i1> to
+   or from iN packs lane bytes into bits and back. */
+static int a64_vec_emit_bitcast(a64_direct_ctx_t *ctx,
+                                const lr_compile_inst_desc_t *desc,
+                                const lr_operand_t *ops) {
+    a64_compile_ctx_t *cc = &ctx->cc;
+    a64_vec_layout_t sl, dl;
+    bool src_vec = a64_vec_layout(ops[0].type, &sl);
+    bool dst_vec = a64_vec_layout(desc->type, &dl);
+    a64_vec_src_t v;
+    uint8_t base;
+    int32_t disp;
+    int32_t dst_off;
+
+    if (src_vec && dst_vec) {
+        dst_off = alloc_slot(cc, desc->dest, dl.total);
+        a64_vec_src_init(ctx, &ops[0], &sl, &v);
+        a64_vec_copy(cc, &v, A64_FP, dst_off, dl.total);
+        return 0;
     }
-    if (a64_direct_ensure_block_offsets(ctx, block_id) != 0)
-        return -1;
-    ctx->current_block_id = block_id;
-    ctx->has_current_block = true;
-    if (ctx->cc.block_offsets[block_id] == SIZE_MAX) {
-        ctx->cc.block_offsets[block_id] = ctx->cc.pos;
-        ctx->cc.block_entry_offsets[block_id] = ctx->cc.pos;
+    if (src_vec) {
+        /* <N x i1> -> iN: orr x9, x9, x10, lsl #i per lane byte. */
+        a64_vec_src_init(ctx, &ops[0], &sl, &v);
+        emit_move_imm_ctx(cc, A64_X9, 0, true);
+        if (v.kind != A64_VEC_ZERO) {
+            a64_vec_src_addr(cc, &v, A64_X12, &base, &disp);
+            for (uint32_t i = 0; i < sl.lanes; i++) {
+                emit_load(cc->buf, &cc->pos, cc->buflen, A64_X10, base,
+                          disp + (int32_t)i, 1);
+                emit_u32(cc->buf, &cc->pos, cc->buflen,
+                         0xAA000000u | ((uint32_t)A64_X10 << 16) |
+                         (i << 10) | ((uint32_t)A64_X9 << 5) | A64_X9);
+            }
+        }
+        invalidate_cached_gprs_a64(cc);
+        emit_store_slot(cc, desc->dest, A64_X9);
+        return 0;
     }
-    if (getenv("LIRIC_DBG_A64_BLOCKS") != NULL) {
-        fprintf(stderr,
-                "[a64 block] func=%s block=%u pos=%zu off=%zu entry=%zu\n",
-                ctx->cc.func_name ? ctx->cc.func_name : "<anon>",
-                block_id,
-                ctx->cc.pos,
-                ctx->cc.block_offsets[block_id],
-                ctx->cc.block_entry_offsets[block_id]);
+    /* iN -> <N x i1>: ubfx x10, x9, #i, #1 per lane. */
+    dst_off = alloc_slot(cc, desc->dest, dl.total);
+    emit_load_operand(cc, &ops[0], A64_X9);
+    for (uint32_t i = 0; i < dl.lanes; i++) {
+        emit_u32(cc->buf, &cc->pos, cc->buflen,
+                 0xD3400000u | (i << 16) | (i << 10) |
+                 ((uint32_t)A64_X9 << 5) | A64_X10);
+        emit_store(cc->buf, &cc->pos, cc->buflen, A64_X10, A64_FP,
+                   dst_off + (int32_t)i, 1);
     }
-    /* Entering a new block must invalidate cached register mappings before
-       emitting non-PHI instructions, but keep offsets bound for empty blocks. */
-    ctx->block_offset_pending = true;
+    invalidate_cached_reg_a64(cc, A64_X10);
     return 0;
 }
 
+/* Whether desc is lowered by a64_vec_emit_inst rather than the scalar
+   cases of aarch64_compile_emit. */
+static bool a64_vec_inst(const lr_compile_inst_desc_t *desc,
+                         const lr_operand_t *ops) {
+    a64_vec_layout_t l = {0}, sl = {0};
+    bool dst_vec = a64_vec_layout(desc->type, &l);
+    switch (desc->op) {
+    case LR_OP_EXTRACTELEMENT:
+        return desc->num_operands >= 2 && a64_vec_layout(ops[0].type, &sl);
+    case LR_OP_INSERTELEMENT:
+    case LR_OP_SHUFFLEVECTOR:
+        return dst_vec;
+    case LR_OP_ICMP: case LR_OP_FCMP:
+        return desc->num_operands >= 2 && dst_vec &&
+               a64_vec_layout(ops[0].type, &sl);
+    case LR_OP_ADD: case LR_OP_SUB: case LR_OP_MUL:
+    case LR_OP_SDIV: case LR_OP_SREM: case LR_OP_UDIV: case LR_OP_UREM:
+    case LR_OP_AND: case LR_OP_OR: case LR_OP_XOR:
+    case LR_OP_SHL: case LR_OP_LSHR: case LR_OP_ASHR:
+    case LR_OP_FADD: case LR_OP_FSUB: case LR_OP_FMUL: case LR_OP_FDIV:
+    case LR_OP_FREM:
+        return desc->num_operands >= 2 && dst_vec;
+    case LR_OP_FNEG:
+        return desc->num_operands >= 1 && dst_vec;
+    case LR_OP_SELECT:
+        return desc->num_operands >= 3 && dst_vec;
+    case LR_OP_SEXT: case LR_OP_ZEXT: case LR_OP_TRUNC:
+    case LR_OP_SITOFP: case LR_OP_UITOFP:
+    case LR_OP_FPTOSI: case LR_OP_FPTOUI:
+    case LR_OP_FPEXT: case LR_OP_FPTRUNC:
+    case LR_OP_PTRTOINT: case LR_OP_INTTOPTR:
+        return desc->num_operands >= 1 && dst_vec &&
+               a64_vec_layout(ops[0].type, &sl) && sl.lanes == l.lanes;
+    case LR_OP_LOAD:
+        return desc->num_operands >= 1 && dst_vec && l.total >= 16;
+    case LR_OP_STORE:
+        return desc->num_operands >= 2 &&
+               a64_vec_layout(ops[0].type, &sl) && sl.total >= 16;
+    case LR_OP_BITCAST: {
+        bool src_vec = desc->num_operands >= 1 &&
+                       a64_vec_layout(ops[0].type, &sl);
+        if (src_vec && dst_vec)
+            return l.total > 8 || sl.total > 8;
+        if (src_vec)
+            return sl.elem->kind == LR_TYPE_I1 && sl.lanes <= 64 &&
+                   int_type_width_bits(desc->type) == sl.lanes;
+        if (dst_vec)
+            return l.elem->kind == LR_TYPE_I1 && l.lanes <= 64 &&
+                   int_type_width_bits(ops[0].type) == l.lanes;
+        return false;
+    }
+    default:
+        return false;
+    }
+}
+
+static int a64_vec_emit_inst(a64_direct_ctx_t *ctx,
+                             const lr_compile_inst_desc_t *desc,
+                             const lr_operand_t *ops) {
+    int rc;
+    invalidate_cached_gprs_a64(&ctx->cc);
+    switch (desc->op) {
+    case LR_OP_EXTRACTELEMENT: rc = a64_vec_emit_extract(ctx, desc, ops); break;
+    case LR_OP_INSERTELEMENT:  rc = a64_vec_emit_insert(ctx, desc, ops); break;
+    case LR_OP_SHUFFLEVECTOR:  rc = a64_vec_emit_shuffle(ctx, desc, ops); break;
+    case LR_OP_ICMP: case LR_OP_FCMP:
+        rc = a64_vec_emit_cmp(ctx, desc, ops);
+        break;
+    case LR_OP_ADD: case LR_OP_SUB: case LR_OP_MUL:
+    case LR_OP_AND: case LR_OP_OR: case LR_OP_XOR:
+    case LR_OP_SHL: case LR_OP_LSHR: case LR_OP_ASHR:
+    case LR_OP_FADD: case LR_OP_FSUB: case LR_OP_FMUL: case LR_OP_FDIV:
+        rc = a64_vec_emit_binop(ctx, desc, ops);
+        break;
+    case LR_OP_FNEG:   rc = a64_vec_emit_fneg(ctx, desc, ops); break;
+    case LR_OP_SELECT: rc = a64_vec_emit_select(ctx, desc, ops); break;
+    case LR_OP_LOAD:   rc = a64_vec_emit_load(ctx, desc, ops); break;
+    case LR_OP_STORE:  rc = a64_vec_emit_store(ctx, desc, ops); break;
+    case LR_OP_BITCAST: rc = a64_vec_emit_bitcast(ctx, desc, ops); break;
+    default:
+        rc = a64_vec_emit_per_lane(ctx, desc, ops);
+        break;
+    }
+    invalidate_cached_gprs_a64(&ctx->cc);
+    return rc;
+}
+
 static int aarch64_compile_emit(void *compile_ctx,
                                 const lr_compile_inst_desc_t *desc) {
     a64_direct_ctx_t *ctx = (a64_direct_ctx_t *)compile_ctx;
@@ -1826,6 +3844,11 @@ static int aarch64_compile_emit(void *compile_ctx,
     }
 
     cc = &ctx->cc;
+    if (ctx->tail_jumped) {
+        ctx->tail_jumped = false;
+        if (desc->op == LR_OP_RET || desc->op == LR_OP_RET_VOID)
+            return 0;
+    }
     a64_direct_note_vregs(ctx, desc);
 
     if (a64_direct_ensure_fixup_cap(ctx) != 0)
@@ -1884,11 +3907,18 @@ static int aarch64_compile_emit(void *compile_ctx,
     inst_header.align = desc->align;
     inst_header.call_external_abi = desc->call_external_abi;
     inst_header.call_vararg = desc->call_vararg;
+    inst_header.call_tail = desc->call_tail;
     inst_header.call_fixed_args = desc->call_fixed_args;
     inst_header.indices = (uint32_t *)desc->indices;
     inst_header.num_indices = desc->num_indices;
     cc->current_inst = &inst_header;
 
+    if (a64_vec_inst(desc, ops_ptr)) {
+        int rc = a64_vec_emit_inst(ctx, desc, ops_ptr);
+        cc->current_inst = NULL;
+        return rc;
+    }
+
     switch (desc->op) {
     case LR_OP_RET: {
         ctx->deferred.pending = true;
@@ -1983,6 +4013,7 @@ static int aarch64_compile_emit(void *compile_ctx,
         emit_move_imm_ctx(cc, A64_X16, (int64_t)fn, true);
         emit_u32(cc->buf, &cc->pos, cc->buflen,
                  0xD63F0000u | ((uint32_t)A64_X16 << 5));
+        cc->frame_pinned = true;
         invalidate_cached_gprs_a64(cc);
         emit_store_fp_slot(cc, desc->dest, A64_D0, fsize);
         break;
@@ -1998,11 +4029,27 @@ static int aarch64_compile_emit(void *compile_ctx,
     }
     case LR_OP_SDIV: case LR_OP_SREM:
     case LR_OP_UDIV: case LR_OP_UREM: {
+        bool is_unsigned = (desc->op == LR_OP_UDIV ||
+                            desc->op == LR_OP_UREM);
+        lr_div_const_t plan;
+        if (a64_div_const(desc, &ops[1], &plan)) {
+            uint8_t bits = int_type_width_bits(desc->type);
+            emit_load_operand(cc, &ops[0], A64_X9);
+            if (bits < 64) {
+                emit_u32(cc->buf, &cc->pos, cc->buflen,
+                         enc_bfm64(!is_unsigned, A64_X9, A64_X9, 0,
+                                   (uint8_t)(bits - 1)));
+                invalidate_cached_reg_a64(cc, A64_X9);
+            }
+            emit_store_slot(cc, desc->dest,
+                            emit_div_const(cc, !is_unsigned,
+                                           desc->op == LR_OP_SREM ||
+                                           desc->op == LR_OP_UREM, &plan));
+            break;
+        }
         emit_load_operand(cc, &ops[0], A64_X9);
         emit_load_operand(cc, &ops[1], A64_X10);
         bool is64 = lr_type_size(desc->type) > 4;
-        bool is_unsigned = (desc->op == LR_OP_UDIV ||
-                            desc->op == LR_OP_UREM);
         /* Signed div/rem run as a 32- or 64-bit sdiv, but a sub-word operand
            (i8/i16) is loaded zero-extended, so a negative value carries the
            wrong high bits.  Sign-extend signed operands narrower than the
@@ -2089,17 +4136,29 @@ static int aarch64_compile_emit(void *compile_ctx,
                  enc_subs_reg(is64, A64_X9, A64_X10));
         uint8_t icc = lr_target_cc_from_icmp(
             (lr_icmp_pred_t)desc->icmp_pred);
+        size_t cmp_end = cc->pos;
         emit_setcc_a64(cc, icc, A64_X9);
         emit_store_slot(cc, desc->dest, A64_X9);
+        ctx->flags_valid = true;
+        ctx->flags_cc = icc;
+        ctx->flags_vreg = desc->dest;
+        ctx->flags_block_id = ctx->current_block_id;
+        ctx->flags_cmp_end = cmp_end;
+        ctx->flags_end = cc->pos;
         break;
     }
     case LR_OP_SELECT: {
-        emit_load_operand(cc, &ops[0], A64_X9);
-        emit_u32(cc->buf, &cc->pos, cc->buflen,
-                 enc_ands_reg(false, A64_X9, A64_X9));
+        uint8_t sel_cc = a64_take_cmp_flags(ctx, &ops[0],
+                                            ctx->current_block_id);
+        if (sel_cc == A64_NO_FUSED_CC) {
+            emit_load_operand(cc, &ops[0], A64_X9);
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     enc_ands_reg(false, A64_X9, A64_X9));
+            sel_cc = LR_CC_NE;
+        }
         emit_load_operand(cc, &ops[2], A64_X9);  /* false value */
         emit_load_operand(cc, &ops[1], A64_X10); /* true value */
-        uint8_t cond = lr_cc_to_a64(LR_CC_NE);
+        uint8_t cond = lr_cc_to_a64(sel_cc);
         emit_u32(cc->buf, &cc->pos, cc->buflen,
                  enc_csel(true, A64_X9, A64_X10, A64_X9, cond));
         emit_store_slot(cc, desc->dest, A64_X9);
@@ -2123,6 +4182,20 @@ static int aarch64_compile_emit(void *compile_ctx,
         ctx->deferred.block_id = ctx->current_block_id;
         return 0;
     }
+    case LR_OP_SWITCH: {
+        lr_operand_t *sw_ops = lr_arena_array_uninit(cc->arena, lr_operand_t,
+                                                     nops);
+        if (nops < 2 || !sw_ops)
+            return -1;
+        memcpy(sw_ops, ops_ptr, sizeof(*sw_ops) * nops);
+        ctx->deferred.pending = true;
+        ctx->deferred.op = LR_OP_SWITCH;
+        ctx->deferred.switch_ops = sw_ops;
+        ctx->deferred.num_ops = nops;
+        ctx->deferred.block_id = ctx->current_block_id;
+        cc->current_inst = NULL;
+        return 0;
+    }
     case LR_OP_ALLOCA: {
         size_t elem_sz = lr_type_size(desc->type);
         size_t elem_align = desc->align ? (size_t)desc->align
@@ -2144,10 +4217,10 @@ static int aarch64_compile_emit(void *compile_ctx,
                 count = 1;
             total_sz = elem_sz * (size_t)count;
             if (off == 0) {
-                cc->stack_size = (uint32_t)align_up_size(cc->stack_size,
-                                                         elem_align);
-                cc->stack_size += (uint32_t)total_sz;
-                off = -(int32_t)cc->stack_size;
+                off = lr_target_frame_slot(cc->slot_coloring, desc->dest,
+                                           true, (uint32_t)total_sz,
+                                           (uint32_t)elem_align,
+                                           &cc->stack_size);
                 lr_target_set_static_alloca_offset(
                     cc->arena, &cc->static_alloca_offsets,
                     &cc->num_static_alloca_offsets, desc->dest, off);
@@ -2169,6 +4242,7 @@ static int aarch64_compile_emit(void *compile_ctx,
             emit_move_imm_ctx(cc, A64_X10, -(int64_t)elem_align, true);
             emit_u32(cc->buf, &cc->pos, cc->buflen,
                      enc_logic_reg(0x8A000000u, true, A64_X9, A64_X9, A64_X10));
+            cc->frame_pinned = true;
             emit_u32(cc->buf, &cc->pos, cc->buflen,
                      enc_add_imm(true, A64_X14, A64_SP, 0));
             emit_u32(cc->buf, &cc->pos, cc->buflen,
@@ -2199,10 +4273,17 @@ static int aarch64_compile_emit(void *compile_ctx,
                 }
             }
         }
-        emit_load_operand(cc, &ops[0], A64_X9);
+        a64_addr_t addr;
         size_t load_sz = lr_type_size(desc->type);
         if (load_sz == 0)
             load_sz = 8;
+        if ((load_sz == 1 || load_sz == 2 || load_sz == 4 || load_sz == 8) &&
+            a64_take_gep_addr(ctx, &ops[0], (uint8_t)load_sz, &addr)) {
+            a64_emit_access(cc, true, A64_X9, &addr, (uint8_t)load_sz);
+            emit_store_slot(cc, desc->dest, A64_X9);
+            break;
+        }
+        emit_load_operand(cc, &ops[0], A64_X9);
         if (dbg_ls) {
             fprintf(stderr,
                     "[a64 load] func=%s block=%u dest=%u src_kind=%d src_vreg=%u desc_ty=%d load_sz=%zu\n",
@@ -2242,10 +4323,18 @@ static int aarch64_compile_emit(void *compile_ctx,
                 }
             }
         }
-        emit_load_operand(cc, &ops[1], A64_X10);
+        a64_addr_t addr;
         size_t store_sz = lr_type_size(ops[0].type);
         if (store_sz == 0)
             store_sz = 8;
+        if ((store_sz == 1 || store_sz == 2 || store_sz == 4 ||
+             store_sz == 8) &&
+            a64_take_gep_addr(ctx, &ops[1], (uint8_t)store_sz, &addr)) {
+            emit_load_operand(cc, &ops[0], A64_X11);
+            a64_emit_access(cc, false, A64_X11, &addr, (uint8_t)store_sz);
+            break;
+        }
+        emit_load_operand(cc, &ops[1], A64_X10);
         if (dbg_ls) {
             fprintf(stderr,
                     "[a64 store] func=%s block=%u src_kind=%d src_vreg=%u src_ty=%d ptr_kind=%d ptr_vreg=%u ptr_ty=%d store_sz=%zu\n",
@@ -2278,6 +4367,68 @@ static int aarch64_compile_emit(void *compile_ctx,
         break;
     }
     case LR_OP_GEP: {
+        lr_gep_addr_t ga;
+        if (lr_target_gep_addr(desc->type, ops, nops, &ga) &&
+            (ga.index_op == 0 ||
+             (ga.scale != 0 && ga.scale <= (1u << 31) &&
+              (ga.scale & (ga.scale - 1)) == 0))) {
+            /* base + (index << n) + disp: disp goes into the base, the
+               index into one shifted add, and the address folds into a
+               single following load or store. */
+            int32_t alloca_off = 0;
+            if (ops[0].kind == LR_VAL_VREG)
+                alloca_off = lr_target_lookup_static_alloca_offset(
+                    cc->static_alloca_offsets,
+                    cc->num_static_alloca_offsets, ops[0].vreg);
+            ga.disp += alloca_off;
+            if (ga.disp >= INT32_MIN && ga.disp <= INT32_MAX) {
+                a64_addr_t a;
+                a.base = A64_FP;
+                a.index = A64_NO_INDEX;
+                a.shift = 0;
+                a.disp = (int32_t)ga.disp;
+                if (alloca_off == 0) {
+                    emit_load_operand(cc, &ops[0], A64_X9);
+                    a.base = A64_X9;
+                }
+                if (ga.index_op != 0) {
+                    if (a.disp != 0) {
+                        emit_addr(cc->buf, &cc->pos, cc->buflen, A64_X9,
+                                  a.base, a.disp);
+                        invalidate_cached_reg_a64(cc, A64_X9);
+                        a.base = A64_X9;
+                        a.disp = 0;
+                    }
+                    emit_load_operand(cc, &ops[ga.index_op], A64_X10);
+                    if (ga.index_signext_bytes != 0) {
+                        emit_signext_index_reg(cc, A64_X10,
+                                               ga.index_signext_bytes);
+                        invalidate_cached_reg_a64(cc, A64_X10);
+                    }
+                    a.index = A64_X10;
+                    while ((1ull << a.shift) < ga.scale)
+                        a.shift++;
+                }
+                ctx->addr_ready = cc->pos;
+                if (a.index != A64_NO_INDEX) {
+                    emit_u32(cc->buf, &cc->pos, cc->buflen,
+                             enc_add_reg(true, A64_X9, a.base, a.index) |
+                                 ((uint32_t)a.shift << 10));
+                    invalidate_cached_reg_a64(cc, A64_X9);
+                } else if (a.base != A64_X9 || a.disp != 0) {
+                    emit_addr(cc->buf, &cc->pos, cc->buflen, A64_X9, a.base,
+                              a.disp);
+                    invalidate_cached_reg_a64(cc, A64_X9);
+                }
+                emit_store_slot(cc, desc->dest, A64_X9);
+                ctx->addr_valid = true;
+                ctx->addr_vreg = desc->dest;
+                ctx->addr_block_id = ctx->current_block_id;
+                ctx->addr_end = cc->pos;
+                ctx->addr_mem = a;
+                break;
+            }
+        }
         emit_load_operand(cc, &ops[0], A64_X9);
         const lr_type_t *cur_ty = desc->type;
         for (uint32_t idx = 1; idx < nops; idx++) {
@@ -2300,6 +4451,7 @@ static int aarch64_compile_emit(void *compile_ctx,
                 emit_u32(cc->buf, &cc->pos, cc->buflen,
                          enc_mul(true, A64_X10, A64_X10, A64_X11));
             }
+            invalidate_cached_reg_a64(cc, A64_X10);
             emit_u32(cc->buf, &cc->pos, cc->buflen,
                      enc_add_reg(true, A64_X9, A64_X9, A64_X10));
         }
@@ -2562,30 +4714,27 @@ static int aarch64_compile_emit(void *compile_ctx,
     case LR_OP_CALL: {
         if (ops_ptr[0].kind == LR_VAL_GLOBAL && cc->mod) {
             const char *cname = lr_module_symbol_name(cc->mod, ops_ptr[0].global_id);
-            bool cmp_is64 = true;
-            a64_int_cmp_intrinsic_kind_t cmp_intrin =
-                classify_llvm_int_cmp_intrinsic(cname, &cmp_is64);
+            uint8_t intrin_bits = 0;
+            lr_int_intrinsic_t int_intrin =
+                lr_target_classify_int_intrinsic(cname, &intrin_bits);
             uint8_t objsize_bits = llvm_objectsize_bits(cname);
-            if (cmp_intrin != A64_INT_CMP_INTRIN_NONE) {
-                uint8_t cond = 0;
-                if (nops >= 3) {
-                    emit_load_operand(cc, &ops_ptr[1], A64_X9);
-                    emit_load_operand(cc, &ops_ptr[2], A64_X10);
-                    emit_u32(cc->buf, &cc->pos, cc->buflen,
-                             enc_subs_reg(cmp_is64, A64_X9, A64_X10));
-                    switch (cmp_intrin) {
-                    case A64_INT_CMP_INTRIN_UMAX: cond = 2; break;  /* hs */
-                    case A64_INT_CMP_INTRIN_UMIN: cond = 9; break;  /* ls */
-                    case A64_INT_CMP_INTRIN_SMAX: cond = 10; break; /* ge */
-                    case A64_INT_CMP_INTRIN_SMIN: cond = 13; break; /* le */
-                    default: cond = 0; break;
-                    }
-                    emit_u32(cc->buf, &cc->pos, cc->buflen,
-                             enc_csel(cmp_is64, A64_X9, A64_X9, A64_X10, cond));
-                    if (desc->type && desc->type->kind != LR_TYPE_VOID)
-                        emit_store_slot(cc, desc->dest, A64_X9);
-                }
-                invalidate_cached_gprs_a64(cc);
+            lr_mem_intrinsic_t mem_intrin = lr_target_classify_mem_intrinsic(cname);
+            uint32_t mem_len = 0;
+            uint8_t fp_bits = 0;
+            lr_fp_intrinsic_t fp_intrin =
+                lr_target_classify_fp_intrinsic(cname, &fp_bits);
+            if (int_intrin != LR_INT_INTRIN_NONE &&
+                a64_emit_int_intrinsic(cc, int_intrin, intrin_bits, ops_ptr,
+                                       nops, desc))
+                break;
+            if (fp_intrin != LR_FP_INTRIN_NONE &&
+                a64_emit_fp_intrinsic(cc, fp_intrin, fp_bits, ops_ptr, nops,
+                                      desc))
+                break;
+            if (mem_intrin != LR_MEM_INTRIN_NONE &&
+                lr_target_mem_inline_plan(mem_intrin, ops_ptr, nops,
+                                          &cc->mem_inline, &mem_len)) {
+                a64_emit_mem_intrinsic(cc, mem_intrin, ops_ptr, mem_len);
                 break;
             }
             if (objsize_bits != 0) {
@@ -2657,10 +4806,20 @@ static int aarch64_compile_emit(void *compile_ctx,
         bool call_vararg = desc->call_vararg;
         uint32_t call_fixed_args = desc->call_fixed_args;
         bool darwin_stack_varargs = false;
+        bool tail_call = false;
         uint32_t fixed_args = 0;
+        lr_func_t *fast_callee = NULL;
+        lr_cc_loc_t *fast_locs = NULL;
         use_fp_abi = direct_call_uses_external_fp_abi(
             cc, &ops_ptr[0], desc->call_external_abi, desc->call_vararg,
             desc->call_fixed_args, &call_vararg, &call_fixed_args);
+        if (!desc->call_vararg)
+            fast_callee = a64_fast_cc_callee(cc, &ops_ptr[0], nargs);
+        if (fast_callee) {
+            fast_locs = lr_arena_array(cc->arena, lr_cc_loc_t, nargs);
+            if (!fast_locs)
+                return -1;
+        }
         if (ops_ptr[0].kind == LR_VAL_GLOBAL && cc->mod)
             call_sym_name = lr_module_symbol_name(cc->mod, ops_ptr[0].global_id);
         if (getenv("LIRIC_VERBOSE_CALL_ABI")) {
@@ -2686,7 +4845,11 @@ static int aarch64_compile_emit(void *compile_ctx,
         }
 #endif
 
-        if (use_fp_abi && darwin_stack_varargs) {
+        if (fast_locs) {
+            stack_args = lr_target_fast_cc_assign(fast_callee->param_types,
+                                                  nargs, 8, 8, fast_locs);
+            stack_bytes = ((stack_args * 8 + 15) & ~15u);
+        } else if (use_fp_abi && darwin_stack_varargs) {
             /* Apple ARM64: named stack arguments are packed by their natural
                size (not rounded up to 8), and the variadic save area begins
                at the next 8-byte boundary with each variadic value in an
@@ -2747,10 +4910,45 @@ static int aarch64_compile_emit(void *compile_ctx,
             stack_args = nargs > 8 ? nargs - 8 : 0;
             stack_bytes = ((stack_args * 8 + 15) & ~15u);
         }
+        tail_call = a64_can_tail_call(cc, desc, ops_ptr, stack_bytes,
+                                      use_fp_abi);
         if (stack_bytes > 0)
             emit_sp_adjust(cc->buf, &cc->pos, cc->buflen, stack_bytes, true);
 
-        if (use_fp_abi && darwin_stack_varargs) {
+        if (fast_locs) {
+            static const uint8_t call_fp_regs[] = {
+                A64_D0, A64_D1, A64_D2, A64_D3,
+                A64_D4, A64_D5, A64_D6, A64_D7
+            };
+            /* Stack slots first, then the FP file (GP values bound for
+               it pass through X9), then the GP argument registers. */
+            for (uint32_t i = 0; i < nargs; i++) {
+                if (fast_locs[i].kind != LR_CC_LOC_STACK)
+                    continue;
+                a64_emit_call_arg(ctx, &ops_ptr[i + 1], A64_X9);
+                emit_store(cc->buf, &cc->pos, cc->buflen, A64_X9, A64_SP,
+                           (int32_t)(fast_locs[i].index * 8u), 8);
+            }
+            for (uint32_t i = 0; i < nargs; i++) {
+                const lr_type_t *pty = fast_callee->param_types[i];
+                uint8_t reg = call_fp_regs[fast_locs[i].index];
+                if (fast_locs[i].kind != LR_CC_LOC_FP)
+                    continue;
+                if (is_fp_abi_type(pty)) {
+                    emit_load_fp_operand(cc, &ops_ptr[i + 1], reg,
+                                         fp_abi_size(pty));
+                } else {
+                    a64_emit_call_arg(ctx, &ops_ptr[i + 1], A64_X9);
+                    emit_u32(cc->buf, &cc->pos, cc->buflen,
+                             enc_fmov_from_gpr(8, reg, A64_X9));
+                }
+            }
+            for (uint32_t i = 0; i < nargs; i++) {
+                if (fast_locs[i].kind == LR_CC_LOC_GP)
+                    a64_emit_call_arg(ctx, &ops_ptr[i + 1],
+                                      call_regs[fast_locs[i].index]);
+            }
+        } else if (use_fp_abi && darwin_stack_varargs) {
             static const uint8_t call_fp_regs[] = {
                 A64_D0, A64_D1, A64_D2, A64_D3,
                 A64_D4, A64_D5, A64_D6, A64_D7
@@ -2864,10 +5062,10 @@ static int aarch64_compile_emit(void *compile_ctx,
                                          call_fp_regs[fp_used_emit], fsz);
                     fp_used_emit++;
                 } else if (!is_fp && gp_used < 8) {
-                    emit_load_operand(cc, &ops_ptr[i + 1], call_regs[gp_used]);
+                    a64_emit_call_arg(ctx, &ops_ptr[i + 1], call_regs[gp_used]);
                     gp_used++;
                 } else {
-                    emit_load_operand(cc, &ops_ptr[i + 1], A64_X9);
+                    a64_emit_call_arg(ctx, &ops_ptr[i + 1], A64_X9);
                     emit_store(cc->buf, &cc->pos, cc->buflen,
                                A64_X9, A64_SP, (int32_t)(si * 8), 8);
                     si++;
@@ -2876,17 +5074,35 @@ static int aarch64_compile_emit(void *compile_ctx,
         } else {
             uint32_t nstack = nargs > 8 ? nargs - 8 : 0;
             for (uint32_t i = 0; i < nstack; i++) {
-                emit_load_operand(cc, &ops_ptr[8 + i + 1], A64_X9);
+                a64_emit_call_arg(ctx, &ops_ptr[8 + i + 1], A64_X9);
                 emit_store(cc->buf, &cc->pos, cc->buflen,
                            A64_X9, A64_SP, (int32_t)(i * 8), 8);
             }
             for (uint32_t i = 0; i < nargs && i < 8; i++)
-                emit_load_operand(cc, &ops_ptr[i + 1], call_regs[i]);
+                a64_emit_call_arg(ctx, &ops_ptr[i + 1], call_regs[i]);
         }
 
-        emit_load_operand(cc, &ops_ptr[0], A64_X16);
-        emit_u32(cc->buf, &cc->pos, cc->buflen,
-                 0xD63F0000u | ((uint32_t)A64_X16 << 5));
+        if (a64_is_wide_vector(desc->type) && tail_call) {
+            /* Pass our own result pointer on for the callee to fill. */
+            emit_load(cc->buf, &cc->pos, cc->buflen, A64_X8, A64_FP,
+                      ctx->sret_off, 8);
+        } else if (a64_is_wide_vector(desc->type)) {
+            int32_t ret_off = alloc_slot(cc, desc->dest,
+                                         lr_type_size(desc->type));
+            emit_addr(cc->buf, &cc->pos, cc->buflen, A64_X8, A64_FP, ret_off);
+        }
+        if (tail_call) {
+            a64_emit_tail_jump(cc, &ops_ptr[0]);
+            invalidate_cached_gprs_a64(cc);
+            ctx->tail_jumped = true;
+            break;
+        }
+        if (!a64_emit_call_global(cc, &ops_ptr[0])) {
+            emit_load_operand(cc, &ops_ptr[0], A64_X16);
+            emit_u32(cc->buf, &cc->pos, cc->buflen,
+                     0xD63F0000u | ((uint32_t)A64_X16 << 5));
+            cc->frame_pinned = true;
+        }
 
         if (stack_bytes > 0)
             emit_sp_adjust(cc->buf, &cc->pos, cc->buflen, stack_bytes, false);
@@ -2912,6 +5128,8 @@ static int aarch64_compile_emit(void *compile_ctx,
                               A64_FP, off, 4);
                 emit_fp_store(cc->buf, &cc->pos, cc->buflen, A64_D1,
                               A64_FP, off + 4, 4);
+            } else if (a64_is_wide_vector(desc->type)) {
+                /* Written through X8 by the callee. */
             } else if (ret_fp) {
                 uint8_t rsz = (desc->type->kind == LR_TYPE_FLOAT) ? 4 : 8;
                 emit_store_fp_slot(cc, desc->dest, A64_D0, rsz);
@@ -2943,12 +5161,80 @@ static int aarch64_compile_emit(void *compile_ctx,
     return 0;
 }
 
+/* New offset of pos once the prologue [0, prologue_end) and each 8-byte
+   teardown have been dropped. */
+static size_t a64_leaf_map(const a64_compile_ctx_t *cc, size_t prologue_end,
+                           size_t pos) {
+    uint32_t lo = 0, hi = cc->num_teardowns;
+    if (pos < prologue_end)
+        return 0;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2u;
+        if (cc->teardown_pos[mid] + 8u <= pos)
+            lo = mid + 1u;
+        else
+            hi = mid;
+    }
+    return pos - prologue_end - (size_t)lo * 8u;
+}
+
+/* A leaf that never touched the stack (no slots, calls, sp adjustments or
+   varargs) uses neither x29 nor x30, so the whole prologue and the
+   "mov sp, x29; ldp x29, x30" of each teardown go, and everything recorded
+   by position (fixups, block offsets, constant pool loads and this
+   function's relocations) moves down to match.  Runs before any fixup is
+   patched; the branches patched during emission are local and never span
+   a teardown.  Returns true when the frame was dropped. */
+static bool a64_elide_leaf_frame(a64_direct_ctx_t *ctx) {
+    a64_compile_ctx_t *cc = &ctx->cc;
+    size_t prologue_end = ctx->prologue_patch_pos + 20u;
+    size_t rd = prologue_end, wr = 0;
+
+    if (cc->frame_pinned || cc->stack_size != 0 || cc->pos > cc->buflen ||
+        ctx->prologue_patch_pos != 8u)
+        return false;
+    for (uint32_t i = 0; i < cc->num_teardowns; i++) {
+        size_t len = cc->teardown_pos[i] - rd;
+        memmove(cc->buf + wr, cc->buf + rd, len);
+        wr += len;
+        rd = cc->teardown_pos[i] + 8u;
+    }
+    memmove(cc->buf + wr, cc->buf + rd, cc->pos - rd);
+
+    for (uint32_t i = 0; i < cc->num_fixups; i++) {
+        cc->fixups[i].insn_pos =
+            a64_leaf_map(cc, prologue_end, cc->fixups[i].insn_pos);
+        if (cc->fixups[i].target_pos_hint != SIZE_MAX)
+            cc->fixups[i].target_pos_hint = a64_leaf_map(
+                cc, prologue_end, cc->fixups[i].target_pos_hint);
+    }
+    for (uint32_t i = 0; i < cc->num_block_offsets; i++) {
+        if (cc->block_offsets[i] != SIZE_MAX)
+            cc->block_offsets[i] =
+                a64_leaf_map(cc, prologue_end, cc->block_offsets[i]);
+        if (cc->block_entry_offsets[i] != SIZE_MAX)
+            cc->block_entry_offsets[i] =
+                a64_leaf_map(cc, prologue_end, cc->block_entry_offsets[i]);
+    }
+    if (cc->obj_ctx) {
+        for (uint32_t i = cc->reloc_base; i < cc->obj_ctx->num_relocs; i++)
+            cc->obj_ctx->relocs[i].offset = (uint32_t)a64_leaf_map(
+                cc, prologue_end, cc->obj_ctx->relocs[i].offset);
+    }
+    for (uint32_t i = 0; i < cc->const_pool.num_refs; i++)
+        cc->const_pool.refs[i].pos =
+            a64_leaf_map(cc, prologue_end, cc->const_pool.refs[i].pos);
+    cc->pos = a64_leaf_map(cc, prologue_end, cc->pos);
+    return true;
+}
+
 static int aarch64_compile_end(void *compile_ctx, size_t *out_len) {
     a64_direct_ctx_t *ctx = (a64_direct_ctx_t *)compile_ctx;
     a64_compile_ctx_t *cc;
     bool dbg_fixups = getenv("LIRIC_DBG_A64_FIXUPS") != NULL;
     bool dbg_late_phi = getenv("LIRIC_DBG_A64_LATE_PHI") != NULL;
     uint32_t unresolved_fixups = 0;
+    bool frameless;
     if (!ctx || !out_len)
         return -1;
 
@@ -3032,6 +5318,8 @@ static int aarch64_compile_end(void *compile_ctx, size_t *out_len) {
         }
     }
 
+    frameless = a64_elide_leaf_frame(ctx);
+
     for (uint32_t i = 0; i < cc->num_fixups; i++) {
         size_t target_off = SIZE_MAX;
         if (cc->fixups[i].target == UINT32_MAX) continue;
@@ -3092,14 +5380,22 @@ static int aarch64_compile_end(void *compile_ctx, size_t *out_len) {
         }
     }
 
-    patch_prologue_stack_adjust(cc, ctx->prologue_patch_pos,
-                                (cc->stack_size + 15u) & ~15u);
+    if (!frameless)
+        patch_prologue_stack_adjust(cc, ctx->prologue_patch_pos,
+                                    (cc->stack_size + 15u) & ~15u);
+    if (emit_const_pool_a64(cc) != 0)
+        return -1;
 
     if (unresolved_fixups != 0 && dbg_fixups) {
         fprintf(stderr, "a64 unresolved fixup count func=%s count=%u\n",
                 cc->func_name ? cc->func_name : "<anon>", unresolved_fixups);
     }
 
+    lr_target_mem_inline_report("aarch64", cc->func_name, &cc->mem_inline);
+    lr_target_slot_coloring_report("aarch64", cc->func_name,
+                                   cc->slot_coloring, cc->stack_size);
+    lr_target_const_pool_report("aarch64", cc->func_name, &cc->const_pool);
+
     *out_len = cc->pos;
     if (cc->pos > cc->buflen)
         return -1;
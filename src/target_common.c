@@ -30,6 +30,7 @@ bool lr_target_inst_has_result_slot(const lr_inst_t *inst) {
     case LR_OP_STORE:
     case LR_OP_BR:
     case LR_OP_CONDBR:
+    case LR_OP_SWITCH:
     case LR_OP_RET:
     case LR_OP_RET_VOID:
     case LR_OP_UNREACHABLE:
@@ -1,4 +1,6 @@
 #include "target.h"
+#include "compile_mode.h"
+#include "target_shared.h"
 #include <string.h>
 #include <stdlib.h>
 
@@ -135,6 +137,7 @@ static bool stream_inst_is_terminator(const lr_inst_t *inst) {
     case LR_OP_RET_VOID:
     case LR_OP_BR:
     case LR_OP_CONDBR:
+    case LR_OP_SWITCH:
     case LR_OP_UNREACHABLE:
         return true;
     default:
@@ -142,12 +145,106 @@ static bool stream_inst_is_terminator(const lr_inst_t *inst) {
     }
 }
 
+/* A tail marker only reaches the backend when the call is directly
+   followed by the return of its own result (or by `ret void` for a void
+   call); elsewhere it is an ordinary call. */
+static uint8_t stream_call_tail(const lr_func_t *func, const lr_block_t *b,
+                                uint32_t ii) {
+    const lr_inst_t *call = b->inst_array[ii];
+    const lr_inst_t *ret;
+    if (call->op != LR_OP_CALL || call->call_tail == LR_CALL_TAIL_NONE ||
+        ii + 1 >= b->num_insts)
+        return LR_CALL_TAIL_NONE;
+    ret = b->inst_array[ii + 1];
+    if (!ret)
+        return LR_CALL_TAIL_NONE;
+    if (ret->op == LR_OP_RET_VOID)
+        return call->type && call->type->kind == LR_TYPE_VOID
+                   ? call->call_tail : LR_CALL_TAIL_NONE;
+    if (ret->op == LR_OP_RET && ret->num_operands == 1 && call->dest != 0 &&
+        ret->operands[0].kind == LR_VAL_VREG &&
+        ret->operands[0].vreg == call->dest &&
+        lr_type_same(call->type, func->ret_type))
+        return call->call_tail;
+    return LR_CALL_TAIL_NONE;
+}
+
+static bool cold_split_enabled(void) {
+    static int cached = -1;
+    if (cached < 0) {
+        const char *env = getenv("LIRIC_COLD_SPLIT");
+        cached = !(env && strcmp(env, "0") == 0);
+    }
+    return cached != 0;
+}
+
+static int replay_block(const lr_target_t *target, void *compile_ctx,
+                        const lr_func_t *func, const lr_block_t *b,
+                        lr_operand_desc_t *operands, uint32_t *indices) {
+    bool has_terminator = false;
+    if (target->compile_set_block(compile_ctx, b->id) != 0)
+        return -1;
+    for (uint32_t ii = 0; ii < b->num_insts; ii++) {
+        lr_inst_t *inst = b->inst_array[ii];
+        lr_compile_inst_desc_t desc;
+        memset(&desc, 0, sizeof(desc));
+        desc.op = inst->op;
+        desc.type = inst->type;
+        desc.dest = inst->dest;
+        desc.num_operands = inst->num_operands;
+        desc.num_indices = inst->num_indices;
+        desc.align = inst->align;
+        desc.icmp_pred = (int)inst->icmp_pred;
+        desc.fcmp_pred = (int)inst->fcmp_pred;
+        desc.call_external_abi = inst->call_external_abi;
+        desc.call_vararg = inst->call_vararg;
+        desc.call_fixed_args = inst->call_fixed_args;
+        desc.call_tail = stream_call_tail(func, b, ii);
+
+        if (inst->num_operands > 0) {
+            if (!inst->operands)
+                return -1;
+            for (uint32_t oi = 0; oi < inst->num_operands; oi++) {
+                if (operand_to_desc(&inst->operands[oi], &operands[oi]) != 0)
+                    return -1;
+            }
+            desc.operands = operands;
+        }
+        if (inst->num_indices > 0) {
+            if (!inst->indices)
+                return -1;
+            memcpy(indices, inst->indices, inst->num_indices * sizeof(*indices));
+            desc.indices = indices;
+        }
+
+        if (target->compile_emit(compile_ctx, &desc) != 0)
+            return -1;
+        if (stream_inst_is_terminator(inst))
+            has_terminator = true;
+    }
+
+    if (!has_terminator) {
+        lr_compile_inst_desc_t fallthrough_desc;
+        memset(&fallthrough_desc, 0, sizeof(fallthrough_desc));
+        /* Block terminators are mandatory. If upstream handed us a
+           malformed block without one, terminate conservatively instead
+           of guessing a fallthrough edge from list order. */
+        fallthrough_desc.op = LR_OP_UNREACHABLE;
+        if (target->compile_emit(compile_ctx, &fallthrough_desc) != 0)
+            return -1;
+    }
+    return 0;
+}
+
 int lr_replay_function_stream(const lr_target_t *target, void *compile_ctx,
                               const lr_func_t *func) {
     uint32_t max_operands = 0;
     uint32_t max_indices = 0;
     lr_operand_desc_t *operands = NULL;
     uint32_t *indices = NULL;
+    bool *cold = NULL;
+    uint32_t num_cold = 0;
+    int rc = 0;
 
     if (!target || !compile_ctx || !func ||
         !target->compile_set_block || !target->compile_emit)
@@ -181,87 +278,53 @@ int lr_replay_function_stream(const lr_target_t *target, void *compile_ctx,
         }
     }
 
-    for (const lr_block_t *b = func->first_block; b; b = b->next) {
-        bool has_terminator = false;
-        if (target->compile_set_block(compile_ctx, b->id) != 0) {
-            free(indices);
-            free(operands);
-            return -1;
-        }
-        for (uint32_t ii = 0; ii < b->num_insts; ii++) {
-            lr_inst_t *inst = b->inst_array[ii];
-            lr_compile_inst_desc_t desc;
-            memset(&desc, 0, sizeof(desc));
-            desc.op = inst->op;
-            desc.type = inst->type;
-            desc.dest = inst->dest;
-            desc.num_operands = inst->num_operands;
-            desc.num_indices = inst->num_indices;
-            desc.align = inst->align;
-            desc.icmp_pred = (int)inst->icmp_pred;
-            desc.fcmp_pred = (int)inst->fcmp_pred;
-            desc.call_external_abi = inst->call_external_abi;
-            desc.call_vararg = inst->call_vararg;
-            desc.call_fixed_args = inst->call_fixed_args;
-
-            if (inst->num_operands > 0) {
-                if (!inst->operands) {
-                    free(indices);
-                    free(operands);
-                    return -1;
-                }
-                for (uint32_t oi = 0; oi < inst->num_operands; oi++) {
-                    if (operand_to_desc(&inst->operands[oi], &operands[oi]) != 0) {
-                        free(indices);
-                        free(operands);
-                        return -1;
-                    }
-                }
-                desc.operands = operands;
-            }
-            if (inst->num_indices > 0) {
-                if (!inst->indices) {
-                    free(indices);
-                    free(operands);
-                    return -1;
-                }
-                memcpy(indices, inst->indices, inst->num_indices * sizeof(*indices));
-                desc.indices = indices;
-            }
-
-            if (target->compile_emit(compile_ctx, &desc) != 0) {
-                free(indices);
-                free(operands);
-                return -1;
-            }
-            if (stream_inst_is_terminator(inst))
-                has_terminator = true;
-        }
+    /* Cold blocks (error and unreachable paths) go after every hot block,
+       so the hot path stays contiguous.  Branch fixups are position-based
+       on every backend, so layout order is free.  LIRIC_COLD_SPLIT=0 keeps
+       block-list order. */
+    if (func->num_blocks > 1 && cold_split_enabled()) {
+        cold = (bool *)calloc(func->num_blocks, sizeof(*cold));
+        if (cold)
+            num_cold = lr_target_cold_blocks(func, cold);
+    }
 
-        if (!has_terminator) {
-            lr_compile_inst_desc_t fallthrough_desc;
-            memset(&fallthrough_desc, 0, sizeof(fallthrough_desc));
-            /* Block terminators are mandatory. If upstream handed us a
-               malformed block without one, terminate conservatively instead
-               of guessing a fallthrough edge from list order. */
-            fallthrough_desc.op = LR_OP_UNREACHABLE;
-            if (target->compile_emit(compile_ctx, &fallthrough_desc) != 0) {
-                free(indices);
-                free(operands);
-                return -1;
-            }
-        }
+    for (const lr_block_t *b = func->first_block; b && rc == 0; b = b->next) {
+        if (num_cold > 0 && b->id < func->num_blocks && cold[b->id])
+            continue;
+        rc = replay_block(target, compile_ctx, func, b, operands, indices);
+    }
+    for (const lr_block_t *b = func->first_block;
+         num_cold > 0 && b && rc == 0; b = b->next) {
+        if (b->id < func->num_blocks && cold[b->id])
+            rc = replay_block(target, compile_ctx, func, b, operands, indices);
     }
 
+    free(cold);
     free(indices);
     free(operands);
-    return 0;
+    return rc;
 }
 
 int lr_target_compile(const lr_target_t *target, lr_compile_mode_t mode,
                       lr_func_t *func, lr_module_t *mod,
                       uint8_t *buf, size_t buflen, size_t *out_len,
                       lr_arena_t *arena) {
+    /* Object code may run anywhere: baseline unless LIRIC_CPU_FEATURES
+       says otherwise. */
+    uint32_t cpu_features = 0;
+    if (lr_cpu_features_resolve(target ? target->name : NULL, NULL, false,
+                                &cpu_features) != 0)
+        cpu_features = 0;
+    return lr_target_compile_ex(target, mode, 0, cpu_features, NULL, func,
+                                mod, buf, buflen, out_len, arena);
+}
+
+int lr_target_compile_ex(const lr_target_t *target, lr_compile_mode_t mode,
+                         uint32_t codegen_flags, uint32_t cpu_features,
+                         uint64_t *loop_counter,
+                         lr_func_t *func, lr_module_t *mod,
+                         uint8_t *buf, size_t buflen, size_t *out_len,
+                         lr_arena_t *arena) {
     lr_compile_func_meta_t meta;
     void *compile_ctx = NULL;
     int rc;
@@ -285,6 +348,9 @@ int lr_target_compile(const lr_target_t *target, lr_compile_mode_t mode,
     meta.num_blocks = func->num_blocks;
     meta.next_vreg = func->next_vreg;
     meta.mode = mode;
+    meta.codegen_flags = codegen_flags;
+    meta.cpu_features = cpu_features;
+    meta.loop_counter = loop_counter;
 
     rc = target->compile_begin(&compile_ctx, &meta, mod, buf, buflen, arena);
     if (rc != 0 || !compile_ctx)
@@ -1,4 +1,5 @@
 #include "target_riscv64.h"
+#include "target_shared.h"
 
 #include "ir.h"
 #include "objfile.h"
@@ -13,6 +14,7 @@
 
 #define RV_OPCODE_OP     0x33u
 #define RV_OPCODE_OPIMM  0x13u
+#define RV_OPCODE_OPIMM32 0x1Bu
 #define RV_OPCODE_LUI    0x37u
 #define RV_OPCODE_JAL    0x6Fu
 #define RV_OPCODE_JALR   0x67u
@@ -23,6 +25,8 @@
 #define RV_FUNCT3_OR       0x6u
 #define RV_FUNCT3_XOR      0x4u
 #define RV_FUNCT3_SLL      0x1u
+#define RV_FUNCT3_MULH     0x1u
+#define RV_FUNCT3_MULHU    0x3u
 #define RV_FUNCT3_SRL_SRA  0x5u
 #define RV_FUNCT3_DIV      0x4u
 #define RV_FUNCT3_DIVU     0x5u
@@ -131,11 +135,13 @@ static int rv_emit_li32(rv_emit_ctx_t *ec, uint8_t rd, int32_t imm) {
     if (imm >= -2048 && imm <= 2047)
         return rv_emit32(ec, rv_enc_i(imm, RV_X0, RV_FUNCT3_ADD_SUB, rd, RV_OPCODE_OPIMM));
 
-    int32_t hi20 = (imm + 0x800) & ~0xFFF;
-    int32_t lo12 = imm - hi20;
+    /* Near INT32_MAX the rounded upper part wraps to a negative lui; addiw
+       wraps the sum back into 32 bits and sign-extends it. */
+    int32_t hi20 = (int32_t)(((uint32_t)imm + 0x800u) & ~0xFFFu);
+    int32_t lo12 = (int32_t)((uint32_t)imm - (uint32_t)hi20);
     if (rv_emit32(ec, rv_enc_u(hi20, rd, RV_OPCODE_LUI)) != 0)
         return -1;
-    return rv_emit32(ec, rv_enc_i(lo12, rd, RV_FUNCT3_ADD_SUB, rd, RV_OPCODE_OPIMM));
+    return rv_emit32(ec, rv_enc_i(lo12, rd, RV_FUNCT3_ADD_SUB, rd, RV_OPCODE_OPIMM32));
 }
 
 static int rv_emit_li64(rv_emit_ctx_t *ec, uint8_t rd, uint8_t scratch, int64_t imm) {
@@ -165,6 +171,82 @@ static int rv_emit_li64(rv_emit_ctx_t *ec, uint8_t rd, uint8_t scratch, int64_t
                                   RV_FUNCT3_ADD_SUB, rd, RV_OPCODE_OP));
 }
 
+static int rv_emit_srai(rv_emit_ctx_t *ec, uint8_t rd, uint8_t rs, uint8_t shamt) {
+    return rv_emit32(ec, rv_enc_i((int32_t)(0x400u | (shamt & 0x3Fu)), rs,
+                                  RV_FUNCT3_SRL_SRA, rd, RV_OPCODE_OPIMM));
+}
+
+static int rv_emit_op(rv_emit_ctx_t *ec, uint8_t funct7, uint8_t funct3,
+                      uint8_t rd, uint8_t rs1, uint8_t rs2) {
+    return rv_emit32(ec, rv_enc_r(funct7, rs2, rs1, funct3, rd, RV_OPCODE_OP));
+}
+
+/* i64 div/rem of rs by plan->divisor through mulh/mulhu and shifts.  rd
+   must differ from rs; t0 and t2 are clobbered. */
+static int rv_emit_div_const(rv_emit_ctx_t *ec, uint8_t rd, uint8_t rs,
+                             bool is_signed, bool want_rem,
+                             const lr_div_const_t *plan) {
+    int rc = 0;
+    switch (plan->kind) {
+    case LR_DIV_CONST_IDENT:
+        if (want_rem)
+            return rv_emit_mv(ec, rd, RV_X0);
+        if (plan->negate)
+            return rv_emit_op(ec, RV_FUNCT7_SUB, RV_FUNCT3_ADD_SUB, rd, RV_X0, rs);
+        return rv_emit_mv(ec, rd, rs);
+    case LR_DIV_CONST_POW2:
+        if (!is_signed) {
+            if (!want_rem)
+                return rv_emit_shift_imm(ec, rd, rs, RV_FUNCT3_SRL_SRA, plan->shift);
+            rc |= rv_emit_shift_imm(ec, rd, rs, RV_FUNCT3_SLL,
+                                    (uint8_t)(64 - plan->shift));
+            rc |= rv_emit_shift_imm(ec, rd, rd, RV_FUNCT3_SRL_SRA,
+                                    (uint8_t)(64 - plan->shift));
+            return rc ? -1 : 0;
+        }
+        /* Bias negative dividends by 2^k - 1 so srai rounds toward zero. */
+        rc |= rv_emit_srai(ec, RV_T0, rs, 63);
+        rc |= rv_emit_shift_imm(ec, RV_T0, RV_T0, RV_FUNCT3_SRL_SRA,
+                                (uint8_t)(64 - plan->shift));
+        rc |= rv_emit_op(ec, RV_FUNCT7_ADD, RV_FUNCT3_ADD_SUB, RV_T0, rs, RV_T0);
+        rc |= rv_emit_srai(ec, rd, RV_T0, plan->shift);
+        if (plan->negate)
+            rc |= rv_emit_op(ec, RV_FUNCT7_SUB, RV_FUNCT3_ADD_SUB, rd, RV_X0, rd);
+        break;
+    case LR_DIV_CONST_MAGIC:
+        rc |= rv_emit_li64(ec, RV_T0, RV_T2, (int64_t)plan->magic);
+        rc |= rv_emit_op(ec, RV_FUNCT7_MULDIV,
+                         is_signed ? RV_FUNCT3_MULH : RV_FUNCT3_MULHU,
+                         rd, rs, RV_T0);
+        if (!is_signed) {
+            if (plan->fixup) {
+                rc |= rv_emit_op(ec, RV_FUNCT7_SUB, RV_FUNCT3_ADD_SUB, RV_T0, rs, rd);
+                rc |= rv_emit_shift_imm(ec, RV_T0, RV_T0, RV_FUNCT3_SRL_SRA, 1);
+                rc |= rv_emit_op(ec, RV_FUNCT7_ADD, RV_FUNCT3_ADD_SUB, rd, rd, RV_T0);
+                rc |= rv_emit_shift_imm(ec, rd, rd, RV_FUNCT3_SRL_SRA,
+                                        (uint8_t)(plan->shift - 1));
+            } else {
+                rc |= rv_emit_shift_imm(ec, rd, rd, RV_FUNCT3_SRL_SRA, plan->shift);
+            }
+            break;
+        }
+        if (plan->fixup)
+            rc |= rv_emit_op(ec, plan->fixup > 0 ? RV_FUNCT7_ADD : RV_FUNCT7_SUB,
+                             RV_FUNCT3_ADD_SUB, rd, rd, rs);
+        rc |= rv_emit_srai(ec, rd, rd, plan->shift);
+        /* Round toward zero: add one when the quotient is negative. */
+        rc |= rv_emit_shift_imm(ec, RV_T0, rd, RV_FUNCT3_SRL_SRA, 63);
+        rc |= rv_emit_op(ec, RV_FUNCT7_ADD, RV_FUNCT3_ADD_SUB, rd, rd, RV_T0);
+        break;
+    }
+    if (!rc && want_rem) {
+        rc |= rv_emit_li64(ec, RV_T0, RV_T2, plan->divisor);
+        rc |= rv_emit_op(ec, RV_FUNCT7_MULDIV, RV_FUNCT3_ADD_SUB, RV_T0, rd, RV_T0);
+        rc |= rv_emit_op(ec, RV_FUNCT7_SUB, RV_FUNCT3_ADD_SUB, rd, rs, RV_T0);
+    }
+    return rc ? -1 : 0;
+}
+
 static int rv_emit_fp_move(rv_emit_ctx_t *ec, uint8_t rd, uint8_t rs, bool is_double) {
     uint8_t funct7 = is_double ? 0x11u : 0x10u;
     return rv_emit32(ec, rv_enc_r(funct7, rs, rs, 0x0u, rd, RV_OPCODE_OPFP));
@@ -443,18 +525,22 @@ static int rv_compile_emit(void *compile_ctx,
     case LR_OP_ALLOCA:
     case LR_OP_BR:
     case LR_OP_CONDBR:
+    case LR_OP_EXTRACTELEMENT:
     case LR_OP_EXTRACTVALUE:
     case LR_OP_FCMP:
     case LR_OP_FPTOUI:
     case LR_OP_FREM:
     case LR_OP_GEP:
     case LR_OP_ICMP:
+    case LR_OP_INSERTELEMENT:
     case LR_OP_INSERTVALUE:
     case LR_OP_INTTOPTR:
     case LR_OP_LOAD:
     case LR_OP_PTRTOINT:
     case LR_OP_SELECT:
+    case LR_OP_SHUFFLEVECTOR:
     case LR_OP_STORE:
+    case LR_OP_SWITCH:
     case LR_OP_UITOFP:
     case LR_OP_UNREACHABLE:
         return RV_ERR_UNSUPPORTED_OP;
@@ -554,6 +640,28 @@ static int rv_compile_emit(void *compile_ctx,
 
         uint8_t rd = rv_gpr_tmp_pool[ctx->gpr_next++];
         uint8_t rs1 = 0, rs2 = 0;
+        lr_div_const_t plan;
+        /* Only i64 divides by a constant here: narrower values are not kept
+           extended in registers, so they keep the 64-bit div below. */
+        if ((desc->op == LR_OP_SDIV || desc->op == LR_OP_SREM ||
+             desc->op == LR_OP_UDIV || desc->op == LR_OP_UREM) &&
+            desc->type->kind == LR_TYPE_I64 && ops[1].kind == LR_VAL_IMM_I64 &&
+            lr_target_div_const_plan(desc->op == LR_OP_SDIV ||
+                                     desc->op == LR_OP_SREM,
+                                     64, ops[1].imm_i64, &plan)) {
+            if (rv_operand_gpr(ec, &ops[0], ctx->vmap, ctx->vmap_n,
+                               RV_T1, RV_T0, &rs1) != 0 ||
+                rv_emit_div_const(ec, rd, rs1,
+                                  desc->op == LR_OP_SDIV ||
+                                  desc->op == LR_OP_SREM,
+                                  desc->op == LR_OP_SREM ||
+                                  desc->op == LR_OP_UREM, &plan) != 0)
+                return -1;
+            ctx->vmap[desc->dest].in_use = 1;
+            ctx->vmap[desc->dest].cls = RV_REGCLS_GPR;
+            ctx->vmap[desc->dest].reg = rd;
+            break;
+        }
         if (rv_operand_gpr(ec, &ops[0], ctx->vmap, ctx->vmap_n,
                            RV_T1, RV_T0, &rs1) != 0 ||
             rv_operand_gpr(ec, &ops[1], ctx->vmap, ctx->vmap_n,
@@ -1,4 +1,6 @@
 #include "target_shared.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 int32_t lr_target_lookup_static_alloca_offset(const int32_t *offsets,
@@ -42,3 +44,1368 @@ void lr_target_set_static_alloca_offset(lr_arena_t *arena,
     *offsets = table;
     *num_offsets = cap;
 }
+
+static bool live_inst_defines_dest(const lr_inst_t *inst) {
+    switch (inst->op) {
+    case LR_OP_RET:
+    case LR_OP_RET_VOID:
+    case LR_OP_BR:
+    case LR_OP_CONDBR:
+    case LR_OP_SWITCH:
+    case LR_OP_UNREACHABLE:
+    case LR_OP_STORE:
+        return false;
+    default:
+        return inst->type && inst->type->kind != LR_TYPE_VOID;
+    }
+}
+
+static void live_touch(lr_live_ranges_t *lr, uint32_t vreg, uint32_t pos) {
+    if (vreg >= lr->num_vregs)
+        return;
+    if (lr->start[vreg] == UINT32_MAX || pos < lr->start[vreg])
+        lr->start[vreg] = pos;
+    if (lr->end[vreg] == UINT32_MAX || pos > lr->end[vreg])
+        lr->end[vreg] = pos;
+}
+
+static int live_span_cmp(const void *a, const void *b) {
+    const lr_live_span_t *x = (const lr_live_span_t *)a;
+    const lr_live_span_t *y = (const lr_live_span_t *)b;
+    if (x->lo != y->lo)
+        return x->lo < y->lo ? -1 : 1;
+    if (x->hi != y->hi)
+        return x->hi < y->hi ? -1 : 1;
+    return 0;
+}
+
+/* Widen [*start, *end] over every merged backward span it touches. */
+static void live_widen(const lr_live_ranges_t *lr, uint32_t *start,
+                       uint32_t *end) {
+    const lr_live_span_t *spans = lr->spans;
+    uint32_t s = *start;
+    uint32_t e = *end;
+    uint32_t lo = 0;
+    uint32_t hi = lr->num_spans;
+    /* First span whose end reaches the range start. */
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2u;
+        if (spans[mid].hi < s)
+            lo = mid + 1u;
+        else
+            hi = mid;
+    }
+    for (uint32_t i = lo; i < lr->num_spans && spans[i].lo <= e; i++) {
+        if (spans[i].lo < s)
+            s = spans[i].lo;
+        if (spans[i].hi > e)
+            e = spans[i].hi;
+    }
+    *start = s;
+    *end = e;
+}
+
+int lr_target_compute_live_ranges(const lr_func_t *func, lr_arena_t *arena,
+                                  lr_live_ranges_t *out) {
+    lr_live_span_t *spans = NULL;
+    uint32_t num_spans = 0;
+    uint32_t span_cap = 0;
+    uint32_t prev_id = 0;
+    bool first = true;
+
+    if (!func || !arena || !out || !lr_func_is_finalized(func))
+        return -1;
+
+    memset(out, 0, sizeof(*out));
+    out->num_vregs = func->next_vreg;
+    if (out->num_vregs == 0)
+        return 0;
+    out->start = lr_arena_array_uninit(arena, uint32_t, out->num_vregs);
+    out->end = lr_arena_array_uninit(arena, uint32_t, out->num_vregs);
+    if (!out->start || !out->end)
+        return -1;
+    memset(out->start, 0xFF, sizeof(uint32_t) * out->num_vregs);
+    memset(out->end, 0xFF, sizeof(uint32_t) * out->num_vregs);
+
+    /* Positions follow linear_inst_array, which is block-id order; the
+       backends emit in block-list order, so both must agree. */
+    for (const lr_block_t *b = func->first_block; b; b = b->next) {
+        if (!first && b->id <= prev_id)
+            return -1;
+        prev_id = b->id;
+        first = false;
+    }
+
+    for (uint32_t i = 0; i < func->num_params; i++) {
+        if (func->param_vregs)
+            live_touch(out, func->param_vregs[i], 0);
+    }
+
+    for (uint32_t bi = 0; bi < func->num_blocks; bi++) {
+        uint32_t lo = func->block_inst_offsets[bi];
+        uint32_t hi = func->block_inst_offsets[bi + 1];
+        for (uint32_t li = lo; li < hi; li++) {
+            const lr_inst_t *inst = func->linear_inst_array[li];
+            uint32_t pos = li + 1u;
+            if (inst->op == LR_OP_PHI) {
+                live_touch(out, inst->dest, pos);
+                for (uint32_t oi = 0; oi + 1 < inst->num_operands; oi += 2) {
+                    uint32_t pred = inst->operands[oi + 1].block_id;
+                    uint32_t pred_end;
+                    if (pred >= func->num_blocks)
+                        continue;
+                    pred_end = func->block_inst_offsets[pred + 1];
+                    live_touch(out, inst->dest, pred_end);
+                    if (inst->operands[oi].kind == LR_VAL_VREG)
+                        live_touch(out, inst->operands[oi].vreg, pred_end);
+                }
+                continue;
+            }
+            if (live_inst_defines_dest(inst))
+                live_touch(out, inst->dest, pos);
+            for (uint32_t oi = 0; oi < inst->num_operands; oi++) {
+                const lr_operand_t *op = &inst->operands[oi];
+                uint32_t succ_start;
+                if (op->kind == LR_VAL_VREG) {
+                    live_touch(out, op->vreg, pos);
+                    continue;
+                }
+                if (op->kind != LR_VAL_BLOCK || op->block_id >= func->num_blocks)
+                    continue;
+                succ_start = func->block_inst_offsets[op->block_id] + 1u;
+                if (succ_start > pos)
+                    continue;
+                if (num_spans == span_cap) {
+                    uint32_t new_cap = span_cap == 0 ? 16u : span_cap * 2u;
+                    lr_live_span_t *ns = lr_arena_array_uninit(
+                        arena, lr_live_span_t, new_cap);
+                    if (!ns)
+                        return -1;
+                    if (num_spans > 0)
+                        memcpy(ns, spans, sizeof(*spans) * num_spans);
+                    spans = ns;
+                    span_cap = new_cap;
+                }
+                spans[num_spans].lo = succ_start;
+                spans[num_spans].hi = pos;
+                num_spans++;
+            }
+        }
+    }
+
+    if (num_spans == 0)
+        return 0;
+
+    /* Overlapping backward spans widen each other transitively, so merge
+       them first; each range then needs one lookup on each side. */
+    qsort(spans, num_spans, sizeof(*spans), live_span_cmp);
+    {
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < num_spans; i++) {
+            if (n > 0 && spans[i].lo <= spans[n - 1].hi) {
+                if (spans[i].hi > spans[n - 1].hi)
+                    spans[n - 1].hi = spans[i].hi;
+                continue;
+            }
+            spans[n++] = spans[i];
+        }
+        num_spans = n;
+    }
+
+    out->spans = spans;
+    out->num_spans = num_spans;
+    for (uint32_t v = 0; v < out->num_vregs; v++) {
+        if (out->start[v] != UINT32_MAX)
+            live_widen(out, &out->start[v], &out->end[v]);
+    }
+    return 0;
+}
+
+typedef struct switch_sort_entry {
+    uint64_t value;
+    uint32_t dest;
+    uint32_t order;
+} switch_sort_entry_t;
+
+static int switch_sort_cmp(const void *a, const void *b) {
+    const switch_sort_entry_t *x = (const switch_sort_entry_t *)a;
+    const switch_sort_entry_t *y = (const switch_sort_entry_t *)b;
+    if (x->value != y->value)
+        return x->value < y->value ? -1 : 1;
+    /* Equal values keep source order so the first case wins. */
+    if (x->order != y->order)
+        return x->order < y->order ? -1 : 1;
+    return 0;
+}
+
+static uint8_t switch_cond_bits(const lr_type_t *type) {
+    size_t sz;
+    if (!type)
+        return 64;
+    switch (type->kind) {
+    case LR_TYPE_I1:  return 1;
+    case LR_TYPE_I8:  return 8;
+    case LR_TYPE_I16: return 16;
+    case LR_TYPE_I32: return 32;
+    case LR_TYPE_I64: return 64;
+    default:
+        break;
+    }
+    sz = lr_type_size(type) * 8u;
+    return (sz == 0 || sz > 64) ? 64 : (uint8_t)sz;
+}
+
+bool *lr_target_loop_headers(const lr_func_t *func, lr_arena_t *arena) {
+    uint32_t *order;
+    bool *headers;
+    uint32_t n = 0;
+
+    if (!func || !arena || func->num_blocks == 0)
+        return NULL;
+    order = lr_arena_array_uninit(arena, uint32_t, func->num_blocks);
+    headers = lr_arena_array(arena, bool, func->num_blocks);
+    if (!order || !headers)
+        return NULL;
+    memset(order, 0xFF, sizeof(uint32_t) * func->num_blocks);
+    for (const lr_block_t *b = func->first_block; b; b = b->next) {
+        if (b->id < func->num_blocks)
+            order[b->id] = n++;
+    }
+    for (const lr_block_t *b = func->first_block; b; b = b->next) {
+        const lr_inst_t *term;
+        if (b->id >= func->num_blocks || b->num_insts == 0 || !b->inst_array)
+            continue;
+        term = b->inst_array[b->num_insts - 1];
+        if (!term || (term->op != LR_OP_BR && term->op != LR_OP_CONDBR &&
+                      term->op != LR_OP_SWITCH))
+            continue;
+        for (uint32_t oi = 0; oi < term->num_operands; oi++) {
+            const lr_operand_t *op = &term->operands[oi];
+            if (op->kind != LR_VAL_BLOCK || op->block_id >= func->num_blocks)
+                continue;
+            if (order[op->block_id] <= order[b->id])
+                headers[op->block_id] = true;
+        }
+    }
+    return headers;
+}
+
+uint32_t *lr_target_vreg_use_counts(const lr_func_t *func, lr_arena_t *arena) {
+    uint32_t *uses;
+
+    if (!func || !arena || func->next_vreg == 0)
+        return NULL;
+    uses = lr_arena_array(arena, uint32_t, func->next_vreg);
+    if (!uses)
+        return NULL;
+    for (const lr_block_t *b = func->first_block; b; b = b->next) {
+        if (!b->inst_array)
+            continue;
+        for (uint32_t i = 0; i < b->num_insts; i++) {
+            const lr_inst_t *inst = b->inst_array[i];
+            if (!inst)
+                continue;
+            for (uint32_t oi = 0; oi < inst->num_operands; oi++) {
+                const lr_operand_t *op = &inst->operands[oi];
+                if (op->kind == LR_VAL_VREG && op->vreg < func->next_vreg)
+                    uses[op->vreg]++;
+            }
+        }
+    }
+    return uses;
+}
+
+typedef struct slot_pool_entry {
+    int32_t offset;
+    uint32_t free_after;        /* last live position of any occupant */
+} slot_pool_entry_t;
+
+/* Min-heap on free_after of the slots of one size and alignment. */
+typedef struct slot_pool {
+    uint32_t size;
+    uint32_t align;
+    slot_pool_entry_t *heap;
+    uint32_t count;
+    uint32_t cap;
+} slot_pool_t;
+
+struct lr_slot_coloring {
+    lr_arena_t *arena;
+    lr_live_ranges_t live;
+    uint32_t *mem_start;        /* static alloca memory, by alloca vreg */
+    uint32_t *mem_end;
+    slot_pool_t *pools;
+    uint32_t num_pools;
+    uint32_t pool_cap;
+    uint32_t slots_reused;
+    uint32_t allocas_merged;
+    uint64_t bytes_saved;
+};
+
+static uint64_t g_slot_bytes_saved;
+static uint64_t g_slot_slots_reused;
+
+static bool slot_coloring_enabled(void) {
+    static int cached = -1;
+    if (cached < 0) {
+        const char *env = getenv("LIRIC_SLOT_COLORING");
+        cached = !(env && strcmp(env, "0") == 0);
+    }
+    return cached != 0;
+}
+
+static const char *slot_callee_name(const lr_module_t *mod,
+                                    const lr_inst_t *inst) {
+    const char *name;
+    if (!mod || inst->op != LR_OP_CALL || inst->num_operands == 0 ||
+        inst->operands[0].kind != LR_VAL_GLOBAL)
+        return NULL;
+    name = lr_module_symbol_name(mod, inst->operands[0].global_id);
+    while (name && (*name == '\1' || *name == '_'))
+        name++;
+    return name;
+}
+
+/* Whether operand oi of inst may hold a pointer into a static alloca
+   without letting it escape.  GEP and bitcast results derive from it. */
+static bool slot_alloca_use_ok(const lr_module_t *mod, const lr_inst_t *inst,
+                               uint32_t oi) {
+    const char *name;
+    switch (inst->op) {
+    case LR_OP_LOAD:
+    case LR_OP_ICMP:
+        return true;
+    case LR_OP_STORE:
+        return oi == 1;
+    case LR_OP_GEP:
+    case LR_OP_BITCAST:
+        return oi == 0;
+    case LR_OP_CALL:
+        name = slot_callee_name(mod, inst);
+        return oi > 0 && name &&
+               (strncmp(name, "llvm.memcpy.", 12) == 0 ||
+                strncmp(name, "llvm.memmove.", 13) == 0 ||
+                strncmp(name, "llvm.memset.", 12) == 0 ||
+                strncmp(name, "llvm.lifetime.", 14) == 0);
+    default:
+        return false;
+    }
+}
+
+static void slot_mem_touch(lr_slot_coloring_t *sc, uint32_t root,
+                           uint32_t pos) {
+    if (sc->mem_start[root] == UINT32_MAX || pos < sc->mem_start[root])
+        sc->mem_start[root] = pos;
+    if (sc->mem_end[root] == UINT32_MAX || pos > sc->mem_end[root])
+        sc->mem_end[root] = pos;
+}
+
+/* Memory ranges of the static allocas.  root[v] names the alloca a pointer
+   vreg derives from; an escaping use marks the alloca pinned. */
+static int slot_compute_alloca_ranges(lr_slot_coloring_t *sc,
+                                      const lr_func_t *func,
+                                      const lr_module_t *mod) {
+    uint32_t n = sc->live.num_vregs;
+    uint32_t num_insts = func->block_inst_offsets[func->num_blocks];
+    uint32_t *root = lr_arena_array_uninit(sc->arena, uint32_t, n);
+    bool *pinned = lr_arena_array(sc->arena, bool, n);
+    uint32_t *min_store = lr_arena_array_uninit(sc->arena, uint32_t, n);
+    uint32_t *max_load = lr_arena_array(sc->arena, uint32_t, n);
+    bool any = false;
+    bool changed = true;
+
+    sc->mem_start = lr_arena_array_uninit(sc->arena, uint32_t, n);
+    sc->mem_end = lr_arena_array_uninit(sc->arena, uint32_t, n);
+    if (!root || !pinned || !min_store || !max_load || !sc->mem_start ||
+        !sc->mem_end)
+        return -1;
+    memset(root, 0xFF, sizeof(uint32_t) * n);
+    memset(min_store, 0xFF, sizeof(uint32_t) * n);
+    memset(sc->mem_start, 0xFF, sizeof(uint32_t) * n);
+    memset(sc->mem_end, 0xFF, sizeof(uint32_t) * n);
+
+    /* Same static test as the backends' alloca lowering. */
+    for (uint32_t li = 0; li < num_insts; li++) {
+        const lr_inst_t *inst = func->linear_inst_array[li];
+        if (inst->op == LR_OP_ALLOCA && inst->dest < n &&
+            (inst->num_operands == 0 ||
+             inst->operands[0].kind == LR_VAL_IMM_I64)) {
+            root[inst->dest] = inst->dest;
+            any = true;
+        }
+    }
+    if (!any)
+        return 0;
+
+    /* Derived pointers may be defined after their uses in block order. */
+    while (changed) {
+        changed = false;
+        for (uint32_t li = 0; li < num_insts; li++) {
+            const lr_inst_t *inst = func->linear_inst_array[li];
+            const lr_operand_t *base = inst->num_operands > 0
+                                           ? &inst->operands[0] : NULL;
+            if ((inst->op != LR_OP_GEP && inst->op != LR_OP_BITCAST) ||
+                !base || base->kind != LR_VAL_VREG || base->vreg >= n ||
+                root[base->vreg] == UINT32_MAX || inst->dest >= n ||
+                root[inst->dest] != UINT32_MAX)
+                continue;
+            root[inst->dest] = root[base->vreg];
+            changed = true;
+        }
+    }
+
+    for (uint32_t li = 0; li < num_insts; li++) {
+        const lr_inst_t *inst = func->linear_inst_array[li];
+        uint32_t pos = li + 1u;
+        for (uint32_t oi = 0; oi < inst->num_operands; oi++) {
+            const lr_operand_t *op = &inst->operands[oi];
+            uint32_t r;
+            if (op->kind != LR_VAL_VREG || op->vreg >= n ||
+                root[op->vreg] == UINT32_MAX)
+                continue;
+            r = root[op->vreg];
+            if (!slot_alloca_use_ok(mod, inst, oi)) {
+                pinned[r] = true;
+                continue;
+            }
+            slot_mem_touch(sc, r, pos);
+            if (inst->op == LR_OP_LOAD && inst->type) {
+                uint32_t sz = (uint32_t)lr_type_size(inst->type);
+                if (sz > max_load[r])
+                    max_load[r] = sz;
+            } else if (inst->op == LR_OP_STORE && inst->operands[0].type) {
+                uint32_t sz = (uint32_t)lr_type_size(inst->operands[0].type);
+                if (sz < min_store[r])
+                    min_store[r] = sz;
+            }
+        }
+    }
+
+    for (uint32_t v = 0; v < n; v++) {
+        if (root[v] != v)
+            continue;
+        /* A load wider than some store may read bytes nothing wrote;
+           keep whatever the frame held there rather than another
+           alloca's data. */
+        if (max_load[v] > min_store[v])
+            pinned[v] = true;
+        if (pinned[v] || sc->mem_start[v] == UINT32_MAX) {
+            sc->mem_start[v] = UINT32_MAX;
+            sc->mem_end[v] = UINT32_MAX;
+            continue;
+        }
+        live_widen(&sc->live, &sc->mem_start[v], &sc->mem_end[v]);
+    }
+    return 0;
+}
+
+lr_slot_coloring_t *lr_target_slot_coloring_create(const lr_func_t *func,
+                                                   const lr_module_t *mod,
+                                                   lr_arena_t *arena) {
+    lr_slot_coloring_t *sc;
+    uint32_t num_insts;
+
+    if (!slot_coloring_enabled() || !func || !arena ||
+        !lr_func_is_finalized(func) || func->next_vreg == 0)
+        return NULL;
+    num_insts = func->block_inst_offsets[func->num_blocks];
+    /* A second return from setjmp revives values whose slots were
+       already handed on. */
+    for (uint32_t li = 0; li < num_insts; li++) {
+        const char *name = slot_callee_name(mod, func->linear_inst_array[li]);
+        if (name && strstr(name, "setjmp"))
+            return NULL;
+    }
+    sc = lr_arena_new(arena, lr_slot_coloring_t);
+    if (!sc)
+        return NULL;
+    sc->arena = arena;
+    if (lr_target_compute_live_ranges(func, arena, &sc->live) != 0 ||
+        slot_compute_alloca_ranges(sc, func, mod) != 0)
+        return NULL;
+    return sc;
+}
+
+static slot_pool_t *slot_pool_get(lr_slot_coloring_t *sc, uint32_t size,
+                                  uint32_t align) {
+    slot_pool_t *pool;
+    for (uint32_t i = 0; i < sc->num_pools; i++) {
+        if (sc->pools[i].size == size && sc->pools[i].align == align)
+            return &sc->pools[i];
+    }
+    if (sc->num_pools == sc->pool_cap) {
+        uint32_t new_cap = sc->pool_cap == 0 ? 4u : sc->pool_cap * 2u;
+        slot_pool_t *np = lr_arena_array_uninit(sc->arena, slot_pool_t,
+                                                new_cap);
+        if (!np)
+            return NULL;
+        if (sc->num_pools > 0)
+            memcpy(np, sc->pools, sizeof(*np) * sc->num_pools);
+        sc->pools = np;
+        sc->pool_cap = new_cap;
+    }
+    pool = &sc->pools[sc->num_pools++];
+    memset(pool, 0, sizeof(*pool));
+    pool->size = size;
+    pool->align = align;
+    return pool;
+}
+
+static void slot_heap_sift_down(slot_pool_t *pool, uint32_t i) {
+    for (;;) {
+        uint32_t l = 2u * i + 1u;
+        uint32_t m = i;
+        slot_pool_entry_t tmp;
+        if (l < pool->count &&
+            pool->heap[l].free_after < pool->heap[m].free_after)
+            m = l;
+        if (l + 1u < pool->count &&
+            pool->heap[l + 1u].free_after < pool->heap[m].free_after)
+            m = l + 1u;
+        if (m == i)
+            return;
+        tmp = pool->heap[i];
+        pool->heap[i] = pool->heap[m];
+        pool->heap[m] = tmp;
+        i = m;
+    }
+}
+
+static void slot_heap_push(lr_slot_coloring_t *sc, slot_pool_t *pool,
+                           int32_t offset, uint32_t free_after) {
+    uint32_t i;
+    if (pool->count == pool->cap) {
+        uint32_t new_cap = pool->cap == 0 ? 16u : pool->cap * 2u;
+        slot_pool_entry_t *nh = lr_arena_array_uninit(
+            sc->arena, slot_pool_entry_t, new_cap);
+        if (!nh)
+            return;
+        if (pool->count > 0)
+            memcpy(nh, pool->heap, sizeof(*nh) * pool->count);
+        pool->heap = nh;
+        pool->cap = new_cap;
+    }
+    i = pool->count++;
+    while (i > 0) {
+        uint32_t parent = (i - 1u) / 2u;
+        if (pool->heap[parent].free_after <= free_after)
+            break;
+        pool->heap[i] = pool->heap[parent];
+        i = parent;
+    }
+    pool->heap[i].offset = offset;
+    pool->heap[i].free_after = free_after;
+}
+
+int32_t lr_target_frame_slot(lr_slot_coloring_t *sc, uint32_t vreg,
+                             bool alloca_mem, uint32_t size, uint32_t align,
+                             uint32_t *stack_size) {
+    uint32_t start = UINT32_MAX, end = UINT32_MAX;
+    slot_pool_t *pool = NULL;
+    int32_t offset;
+
+    if (sc && vreg < sc->live.num_vregs) {
+        start = alloca_mem ? sc->mem_start[vreg] : sc->live.start[vreg];
+        end = alloca_mem ? sc->mem_end[vreg] : sc->live.end[vreg];
+    }
+    if (start != UINT32_MAX)
+        pool = slot_pool_get(sc, size, align);
+    /* The slot freed earliest is the only candidate worth checking. */
+    if (pool && pool->count > 0 && pool->heap[0].free_after < start) {
+        offset = pool->heap[0].offset;
+        pool->heap[0].free_after = end;
+        slot_heap_sift_down(pool, 0);
+        sc->slots_reused++;
+        if (alloca_mem)
+            sc->allocas_merged++;
+        sc->bytes_saved += size;
+        return offset;
+    }
+
+    if (align > 1)
+        *stack_size = (*stack_size + align - 1u) / align * align;
+    *stack_size += size;
+    offset = -(int32_t)*stack_size;
+    if (pool)
+        slot_heap_push(sc, pool, offset, end);
+    return offset;
+}
+
+void lr_target_slot_coloring_report(const char *target_name,
+                                    const char *func_name,
+                                    const lr_slot_coloring_t *sc,
+                                    uint32_t frame_size) {
+    if (!sc || sc->slots_reused == 0)
+        return;
+    __atomic_add_fetch(&g_slot_bytes_saved, sc->bytes_saved,
+                       __ATOMIC_RELAXED);
+    __atomic_add_fetch(&g_slot_slots_reused, (uint64_t)sc->slots_reused,
+                       __ATOMIC_RELAXED);
+    if (!getenv("LIRIC_VERBOSE_SLOT_COLORING"))
+        return;
+    fprintf(stderr,
+            "%s slot-coloring: fn=%s frame=%u saved=%llu reused=%u allocas=%u\n",
+            target_name ? target_name : "?",
+            func_name ? func_name : "<anon>",
+            frame_size, (unsigned long long)sc->bytes_saved,
+            sc->slots_reused, sc->allocas_merged);
+}
+
+void lr_target_slot_coloring_reset_stats(void) {
+    __atomic_store_n(&g_slot_bytes_saved, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_slot_slots_reused, 0, __ATOMIC_RELAXED);
+}
+
+uint64_t lr_target_slot_coloring_bytes_saved(void) {
+    return __atomic_load_n(&g_slot_bytes_saved, __ATOMIC_RELAXED);
+}
+
+uint64_t lr_target_slot_coloring_slots_reused(void) {
+    return __atomic_load_n(&g_slot_slots_reused, __ATOMIC_RELAXED);
+}
+
+/* Callees that do not return to the hot path: process exit, assertion
+   and runtime-error reporting (names after slot_callee_name's
+   underscore stripping). */
+static bool cold_callee(const lr_module_t *mod, const lr_inst_t *inst) {
+    static const char *const k_cold[] = {
+        "abort", "exit", "Exit", "assert_fail", "assert_rtn",
+        "stack_chk_fail", "cxa_throw", "llvm.trap",
+        "lcompilers_runtime_error", "lcompilers_print_error",
+        "gfortran_stop_string", "gfortran_error_stop_string",
+        "gfortran_error_stop_numeric", "gfortran_runtime_error",
+        "gfortran_runtime_error_at", "gfortran_os_error",
+    };
+    const char *name = slot_callee_name(mod, inst);
+    if (!name)
+        return false;
+    for (size_t i = 0; i < sizeof(k_cold) / sizeof(k_cold[0]); i++) {
+        if (strcmp(name, k_cold[i]) == 0)
+            return true;
+    }
+    return false;
+}
+
+uint32_t lr_target_cold_blocks(const lr_func_t *func, bool *cold) {
+    uint32_t count = 0;
+    bool changed = true;
+
+    if (!func || !cold || func->num_blocks == 0)
+        return 0;
+    memset(cold, 0, sizeof(bool) * func->num_blocks);
+    for (const lr_block_t *b = func->first_block; b; b = b->next) {
+        if (b->id >= func->num_blocks || b->num_insts == 0 || !b->inst_array)
+            continue;
+        for (uint32_t i = 0; i < b->num_insts; i++) {
+            const lr_inst_t *inst = b->inst_array[i];
+            if (inst && (inst->op == LR_OP_UNREACHABLE ||
+                         cold_callee(func->module, inst))) {
+                cold[b->id] = true;
+                break;
+            }
+        }
+    }
+    /* A block whose every successor is cold only leads to an error. */
+    while (changed) {
+        changed = false;
+        for (const lr_block_t *b = func->first_block; b; b = b->next) {
+            const lr_inst_t *term;
+            bool any = false, all = true;
+            if (b->id >= func->num_blocks || cold[b->id] ||
+                b->num_insts == 0 || !b->inst_array)
+                continue;
+            term = b->inst_array[b->num_insts - 1];
+            if (!term || (term->op != LR_OP_BR && term->op != LR_OP_CONDBR &&
+                          term->op != LR_OP_SWITCH))
+                continue;
+            for (uint32_t oi = 0; oi < term->num_operands; oi++) {
+                const lr_operand_t *op = &term->operands[oi];
+                if (op->kind != LR_VAL_BLOCK)
+                    continue;
+                any = true;
+                if (op->block_id >= func->num_blocks || !cold[op->block_id])
+                    all = false;
+            }
+            if (any && all) {
+                cold[b->id] = true;
+                changed = true;
+            }
+        }
+    }
+    if (func->first_block && func->first_block->id < func->num_blocks)
+        cold[func->first_block->id] = false;
+    for (uint32_t i = 0; i < func->num_blocks; i++)
+        count += cold[i] ? 1u : 0u;
+    return count;
+}
+
+bool lr_target_imm_bits(const lr_operand_t *op, uint64_t *bits) {
+    switch (op->kind) {
+    case LR_VAL_IMM_I64:
+        *bits = (uint64_t)op->imm_i64;
+        return true;
+    case LR_VAL_IMM_F64:
+        if (op->type && op->type->kind == LR_TYPE_FLOAT) {
+            float fv = (float)op->imm_f64;
+            uint32_t fbits = 0;
+            memcpy(&fbits, &fv, sizeof(fbits));
+            *bits = fbits;
+        } else {
+            memcpy(bits, &op->imm_f64, sizeof(*bits));
+        }
+        return true;
+    case LR_VAL_NULL:
+    case LR_VAL_UNDEF:
+        *bits = 0;
+        return true;
+    default:
+        return false;
+    }
+}
+
+static uint64_t g_const_pool_loads;
+static uint64_t g_const_pool_entries;
+
+static bool const_pool_enabled(void) {
+    static int cached = -1;
+    if (cached < 0) {
+        const char *env = getenv("LIRIC_CONST_POOL");
+        cached = !(env && strcmp(env, "0") == 0);
+    }
+    return cached != 0;
+}
+
+void lr_target_const_pool_init(lr_const_pool_t *pool) {
+    if (!pool)
+        return;
+    memset(pool, 0, sizeof(*pool));
+    pool->enabled = const_pool_enabled();
+}
+
+static uint32_t const_pool_slot(uint64_t bits, uint32_t mask) {
+    return (uint32_t)((bits * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+}
+
+/* Index of the entry holding bits, adding it when new; UINT32_MAX when
+   out of memory.  The index table is kept at most half full. */
+static uint32_t const_pool_entry(lr_const_pool_t *pool, lr_arena_t *arena,
+                                 uint64_t bits) {
+    uint32_t mask, h;
+    if (pool->index_cap < (pool->num_entries + 1u) * 2u) {
+        uint32_t cap = pool->index_cap ? pool->index_cap * 2u : 32u;
+        uint32_t *index = lr_arena_array(arena, uint32_t, cap);
+        if (!index)
+            return UINT32_MAX;
+        for (uint32_t i = 0; i < pool->num_entries; i++) {
+            h = const_pool_slot(pool->entries[i], cap - 1u);
+            while (index[h] != 0)
+                h = (h + 1u) & (cap - 1u);
+            index[h] = i + 1u;
+        }
+        pool->index = index;
+        pool->index_cap = cap;
+    }
+    mask = pool->index_cap - 1u;
+    h = const_pool_slot(bits, mask);
+    while (pool->index[h] != 0) {
+        uint32_t e = pool->index[h] - 1u;
+        if (pool->entries[e] == bits)
+            return e;
+        h = (h + 1u) & mask;
+    }
+    if (pool->num_entries >= pool->entry_cap) {
+        uint32_t cap = pool->entry_cap ? pool->entry_cap * 2u : 8u;
+        uint64_t *entries = lr_arena_array_uninit(arena, uint64_t, cap);
+        if (!entries)
+            return UINT32_MAX;
+        if (pool->num_entries > 0)
+            memcpy(entries, pool->entries,
+                   sizeof(*entries) * pool->num_entries);
+        pool->entries = entries;
+        pool->entry_cap = cap;
+    }
+    pool->entries[pool->num_entries] = bits;
+    pool->index[h] = ++pool->num_entries;
+    return pool->num_entries - 1u;
+}
+
+int lr_target_const_pool_use(lr_const_pool_t *pool, lr_arena_t *arena,
+                             uint64_t bits, size_t pos) {
+    uint32_t entry;
+    if (!pool || !arena || !pool->enabled)
+        return -1;
+    if (pool->num_refs >= pool->ref_cap) {
+        uint32_t cap = pool->ref_cap ? pool->ref_cap * 2u : 16u;
+        lr_const_pool_ref_t *refs = lr_arena_array_uninit(
+            arena, lr_const_pool_ref_t, cap);
+        if (!refs)
+            return -1;
+        if (pool->num_refs > 0)
+            memcpy(refs, pool->refs, sizeof(*refs) * pool->num_refs);
+        pool->refs = refs;
+        pool->ref_cap = cap;
+    }
+    entry = const_pool_entry(pool, arena, bits);
+    if (entry == UINT32_MAX)
+        return -1;
+    pool->refs[pool->num_refs].pos = pos;
+    pool->refs[pool->num_refs].entry = entry;
+    pool->num_refs++;
+    return 0;
+}
+
+void lr_target_const_pool_report(const char *target_name,
+                                 const char *func_name,
+                                 const lr_const_pool_t *pool) {
+    if (!pool || pool->num_refs == 0)
+        return;
+    __atomic_add_fetch(&g_const_pool_loads, (uint64_t)pool->num_refs,
+                       __ATOMIC_RELAXED);
+    __atomic_add_fetch(&g_const_pool_entries, (uint64_t)pool->num_entries,
+                       __ATOMIC_RELAXED);
+    if (!getenv("LIRIC_VERBOSE_CONST_POOL"))
+        return;
+    fprintf(stderr, "%s const-pool: fn=%s loads=%u entries=%u bytes=%u\n",
+            target_name ? target_name : "?",
+            func_name ? func_name : "<anon>",
+            pool->num_refs, pool->num_entries, pool->num_entries * 8u);
+}
+
+void lr_target_const_pool_reset_stats(void) {
+    __atomic_store_n(&g_const_pool_loads, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_const_pool_entries, 0, __ATOMIC_RELAXED);
+}
+
+uint64_t lr_target_const_pool_loads(void) {
+    return __atomic_load_n(&g_const_pool_loads, __ATOMIC_RELAXED);
+}
+
+uint64_t lr_target_const_pool_entries(void) {
+    return __atomic_load_n(&g_const_pool_entries, __ATOMIC_RELAXED);
+}
+
+bool lr_target_gep_addr(const lr_type_t *src_type, const lr_operand_t *ops,
+                        uint32_t num_ops, lr_gep_addr_t *out) {
+    const lr_type_t *cur_ty = src_type;
+
+    if (!ops || !out)
+        return false;
+    memset(out, 0, sizeof(*out));
+    for (uint32_t idx = 1; idx < num_ops; idx++) {
+        lr_gep_step_t step;
+        if (!lr_gep_analyze_step(cur_ty, idx == 1, &ops[idx], &step))
+            continue;
+        cur_ty = step.next_type;
+        if (step.is_const) {
+            out->disp += step.const_byte_offset;
+            continue;
+        }
+        if (out->index_op != 0)
+            return false;
+        out->index_op = idx;
+        out->scale = step.runtime_elem_size;
+        out->index_signext_bytes = step.runtime_signext_bytes;
+    }
+    return true;
+}
+
+int lr_target_plan_switch(const lr_operand_t *ops, uint32_t num_ops,
+                          lr_arena_t *arena, lr_switch_plan_t *out) {
+    switch_sort_entry_t *sorted = NULL;
+    bool *dest_used;
+    uint32_t *dest_slots;
+    uint32_t slot_mask;
+    uint64_t mask;
+    uint32_t ncases;
+    uint32_t n = 0;
+    uint32_t case_dests = 0;
+
+    if (!ops || num_ops < 2 || (num_ops & 1u) != 0 || !arena || !out ||
+        ops[1].kind != LR_VAL_BLOCK)
+        return -1;
+
+    memset(out, 0, sizeof(*out));
+    out->bits = switch_cond_bits(ops[0].type);
+    mask = out->bits >= 64 ? UINT64_MAX
+                           : ((UINT64_C(1) << out->bits) - UINT64_C(1));
+    ncases = (num_ops - 2u) / 2u;
+    out->dests = lr_arena_array_uninit(arena, uint32_t, ncases + 1u);
+    dest_used = lr_arena_array(arena, bool, ncases + 1u);
+    /* Open-addressed block_id -> dest index + 1 map, load factor <= 1/2. */
+    slot_mask = 7u;
+    while (slot_mask < 2u * (ncases + 1u))
+        slot_mask = slot_mask * 2u + 1u;
+    dest_slots = lr_arena_array(arena, uint32_t, slot_mask + 1u);
+    if (!out->dests || !dest_used || !dest_slots)
+        return -1;
+    out->dests[0] = ops[1].block_id;
+    out->num_dests = 1;
+    dest_slots[(ops[1].block_id * 2654435761u) & slot_mask] = 1u;
+    if (ncases > 0) {
+        sorted = lr_arena_array_uninit(arena, switch_sort_entry_t, ncases);
+        out->cases = lr_arena_array_uninit(arena, lr_switch_case_t, ncases);
+        if (!sorted || !out->cases)
+            return -1;
+    }
+
+    for (uint32_t i = 0; i < ncases; i++) {
+        const lr_operand_t *val = &ops[2u + i * 2u];
+        const lr_operand_t *blk = &ops[3u + i * 2u];
+        uint32_t slot;
+        uint32_t d;
+        if (val->kind != LR_VAL_IMM_I64 || blk->kind != LR_VAL_BLOCK)
+            return -1;
+        slot = (blk->block_id * 2654435761u) & slot_mask;
+        while (dest_slots[slot] != 0 &&
+               out->dests[dest_slots[slot] - 1u] != blk->block_id)
+            slot = (slot + 1u) & slot_mask;
+        if (dest_slots[slot] == 0) {
+            d = out->num_dests++;
+            out->dests[d] = blk->block_id;
+            dest_slots[slot] = d + 1u;
+        } else {
+            d = dest_slots[slot] - 1u;
+        }
+        sorted[i].value = (uint64_t)val->imm_i64 & mask;
+        sorted[i].dest = d;
+        sorted[i].order = i;
+    }
+
+    if (ncases > 1)
+        qsort(sorted, ncases, sizeof(*sorted), switch_sort_cmp);
+    for (uint32_t i = 0; i < ncases; i++) {
+        if (n > 0 && out->cases[n - 1].value == sorted[i].value)
+            continue;
+        out->cases[n].value = sorted[i].value;
+        out->cases[n].dest = sorted[i].dest;
+        if (!dest_used[sorted[i].dest]) {
+            dest_used[sorted[i].dest] = true;
+            case_dests++;
+        }
+        n++;
+    }
+    out->num_cases = n;
+    out->kind = LR_SWITCH_LOWER_TREE;
+    if (n == 0)
+        return 0;
+
+    out->min = out->cases[0].value;
+    out->range = out->cases[n - 1].value - out->min;
+
+    if (out->range < 64 && case_dests <= LR_SWITCH_BT_MAX_DESTS &&
+        ((case_dests == 1 && n >= 3) ||
+         (case_dests == 2 && n >= 5) ||
+         (case_dests == 3 && n >= 6))) {
+        out->bit_masks = lr_arena_array(arena, uint64_t, out->num_dests);
+        if (!out->bit_masks)
+            return -1;
+        for (uint32_t i = 0; i < n; i++)
+            out->bit_masks[out->cases[i].dest] |=
+                UINT64_C(1) << (out->cases[i].value - out->min);
+        out->kind = LR_SWITCH_LOWER_BIT_TEST;
+    } else if (n >= LR_SWITCH_JT_MIN_CASES &&
+               out->range < LR_SWITCH_JT_MAX_RANGE &&
+               (out->range + 1u) * 2u <= (uint64_t)n * 5u) {
+        out->kind = LR_SWITCH_LOWER_JUMP_TABLE;
+    }
+    return 0;
+}
+
+int lr_target_sequence_parallel_copies(const uint32_t *dests,
+                                       const lr_operand_t *srcs, uint32_t n,
+                                       lr_arena_t *arena,
+                                       lr_pcopy_step_t *steps) {
+    uint32_t *reads, *readers, *ready;
+    bool *pending, *from_scratch;
+    uint32_t num_steps = 0, num_ready = 0, left = 0;
+
+    if (n == 0)
+        return 0;
+    reads = lr_arena_array_uninit(arena, uint32_t, n);
+    readers = lr_arena_array(arena, uint32_t, n);
+    ready = lr_arena_array_uninit(arena, uint32_t, n);
+    pending = lr_arena_array(arena, bool, n);
+    from_scratch = lr_arena_array(arena, bool, n);
+    if (!reads || !readers || !ready || !pending || !from_scratch)
+        return -1;
+
+    /* reads[i]: the copy whose destination copy i reads, if any. */
+    for (uint32_t i = 0; i < n; i++) {
+        reads[i] = UINT32_MAX;
+        if (srcs[i].kind != LR_VAL_VREG)
+            continue;
+        if (srcs[i].vreg == dests[i])
+            continue;
+        for (uint32_t j = 0; j < n; j++) {
+            if (dests[j] == srcs[i].vreg) {
+                reads[i] = j;
+                break;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        if (srcs[i].kind == LR_VAL_VREG && srcs[i].vreg == dests[i])
+            continue;
+        pending[i] = true;
+        left++;
+        if (reads[i] != UINT32_MAX)
+            readers[reads[i]]++;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        if (pending[i] && readers[i] == 0)
+            ready[num_ready++] = i;
+    }
+
+    while (left > 0) {
+        if (num_ready == 0) {
+            /* Only cycles remain: every pending destination has exactly
+               one pending reader.  Park one and let its reader take the
+               old value from the scratch. */
+            uint32_t c = UINT32_MAX;
+            for (uint32_t i = 0; i < n && c == UINT32_MAX; i++) {
+                if (pending[i])
+                    c = i;
+            }
+            for (uint32_t i = 0; i < n; i++) {
+                if (pending[i] && !from_scratch[i] && reads[i] == c) {
+                    from_scratch[i] = true;
+                    break;
+                }
+            }
+            steps[num_steps].kind = LR_PCOPY_SAVE;
+            steps[num_steps++].index = c;
+            readers[c] = 0;
+            ready[num_ready++] = c;
+        }
+        {
+            uint32_t i = ready[--num_ready];
+            steps[num_steps].kind = from_scratch[i] ? LR_PCOPY_RESTORE
+                                                    : LR_PCOPY_MOVE;
+            steps[num_steps++].index = i;
+            pending[i] = false;
+            left--;
+            if (!from_scratch[i] && reads[i] != UINT32_MAX &&
+                --readers[reads[i]] == 0 && pending[reads[i]])
+                ready[num_ready++] = reads[i];
+        }
+    }
+    return (int)num_steps;
+}
+
+uint32_t lr_target_fast_cc_assign(lr_type_t *const *param_types, uint32_t n,
+                                  uint32_t num_gp, uint32_t num_fp,
+                                  lr_cc_loc_t *out) {
+    uint32_t gp = 0, fp = 0, stack = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        const lr_type_t *t = param_types ? param_types[i] : NULL;
+        bool is_fp = t && (t->kind == LR_TYPE_FLOAT ||
+                           t->kind == LR_TYPE_DOUBLE);
+        if (is_fp ? fp < num_fp : gp < num_gp) {
+            out[i].kind = is_fp ? LR_CC_LOC_FP : LR_CC_LOC_GP;
+            out[i].index = is_fp ? fp++ : gp++;
+        } else if (is_fp ? gp < num_gp : fp < num_fp) {
+            out[i].kind = is_fp ? LR_CC_LOC_GP : LR_CC_LOC_FP;
+            out[i].index = is_fp ? gp++ : fp++;
+        } else {
+            out[i].kind = LR_CC_LOC_STACK;
+            out[i].index = stack++;
+        }
+    }
+    return stack;
+}
+
+/* Hacker's Delight magicu(): smallest p with 2^p > nc * (d - 1 - rem(2^p - 1, d)),
+   carried out in 64-bit words. */
+static void div_magic_unsigned(uint64_t d, lr_div_const_t *out) {
+    const uint64_t two63 = (uint64_t)1 << 63;
+    uint64_t nc = UINT64_MAX - (0 - d) % d;
+    uint64_t q1 = two63 / nc, r1 = two63 - q1 * nc;
+    uint64_t q2 = (two63 - 1) / d, r2 = (two63 - 1) - q2 * d;
+    uint64_t delta;
+    unsigned p = 63;
+    bool add = false;
+    do {
+        p++;
+        if (r1 >= nc - r1) {
+            q1 = 2 * q1 + 1;
+            r1 = 2 * r1 - nc;
+        } else {
+            q1 = 2 * q1;
+            r1 = 2 * r1;
+        }
+        if (r2 + 1 >= d - r2) {
+            if (q2 >= two63 - 1)
+                add = true;
+            q2 = 2 * q2 + 1;
+            r2 = 2 * r2 + 1 - d;
+        } else {
+            if (q2 >= two63)
+                add = true;
+            q2 = 2 * q2;
+            r2 = 2 * r2 + 1;
+        }
+        delta = d - 1 - r2;
+    } while (p < 128 && (q1 < delta || (q1 == delta && r1 == 0)));
+    out->magic = q2 + 1;
+    out->shift = (uint8_t)(p - 64);
+    out->fixup = add ? 1 : 0;
+}
+
+/* Hacker's Delight magic() for 2 <= |d| < 2^63. */
+static void div_magic_signed(int64_t d, lr_div_const_t *out) {
+    const uint64_t two63 = (uint64_t)1 << 63;
+    uint64_t ad = d < 0 ? 0 - (uint64_t)d : (uint64_t)d;
+    uint64_t t = two63 + ((uint64_t)d >> 63);
+    uint64_t anc = t - 1 - t % ad;
+    uint64_t q1 = two63 / anc, r1 = two63 - q1 * anc;
+    uint64_t q2 = two63 / ad, r2 = two63 - q2 * ad;
+    uint64_t delta;
+    unsigned p = 63;
+    do {
+        p++;
+        q1 = 2 * q1;
+        r1 = 2 * r1;
+        if (r1 >= anc) {
+            q1++;
+            r1 -= anc;
+        }
+        q2 = 2 * q2;
+        r2 = 2 * r2;
+        if (r2 >= ad) {
+            q2++;
+            r2 -= ad;
+        }
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+    out->magic = q2 + 1;
+    if (d < 0)
+        out->magic = 0 - out->magic;
+    out->shift = (uint8_t)(p - 64);
+    if (d > 0 && (int64_t)out->magic < 0)
+        out->fixup = 1;
+    else if (d < 0 && (int64_t)out->magic > 0)
+        out->fixup = -1;
+    else
+        out->fixup = 0;
+}
+
+bool lr_target_div_const_plan(bool is_signed, uint8_t bits, int64_t imm,
+                              lr_div_const_t *out) {
+    uint64_t ud, mag;
+    if (!out || bits == 0 || bits > 64)
+        return false;
+    memset(out, 0, sizeof(*out));
+    if (bits < 64) {
+        uint64_t mask = ((uint64_t)1 << bits) - 1u;
+        uint64_t v = (uint64_t)imm & mask;
+        if (is_signed && (v >> (bits - 1)) & 1u)
+            v |= ~mask;
+        imm = (int64_t)v;
+    }
+    if (imm == 0 || (is_signed && imm == INT64_MIN) ||
+        (!is_signed && (uint64_t)imm >= ((uint64_t)1 << 63)))
+        return false;
+    out->divisor = imm;
+    ud = (uint64_t)imm;
+    mag = is_signed && imm < 0 ? 0 - ud : ud;
+    if (mag == 1) {
+        out->kind = LR_DIV_CONST_IDENT;
+        out->negate = imm < 0;
+        return true;
+    }
+    if ((mag & (mag - 1)) == 0) {
+        out->kind = LR_DIV_CONST_POW2;
+        while (((uint64_t)1 << out->shift) != mag)
+            out->shift++;
+        out->negate = is_signed && imm < 0;
+        return true;
+    }
+    out->kind = LR_DIV_CONST_MAGIC;
+    if (is_signed) {
+        div_magic_signed(imm, out);
+    } else if (bits < 64) {
+        /* The zero-extended dividend is below 2^bits, so
+           m = floor(2^(bits+l) / d) + 1 with l = ceil(log2 d) is exact
+           (m * d exceeds 2^(bits+l) by at most d <= 2^l) and fits in 64
+           bits.  Pre-shifting m left when bits + l < 64 leaves the whole
+           division to the high multiply; no fixup step is needed. */
+        unsigned l = 0, total;
+        uint64_t q = 0, r = 1;
+        while (((uint64_t)1 << l) < ud)
+            l++;
+        total = bits + l;
+        for (unsigned i = 0; i < total; i++) {
+            r <<= 1;
+            q <<= 1;
+            if (r >= ud) {
+                r -= ud;
+                q |= 1u;
+            }
+        }
+        q++;
+        if (total <= 64) {
+            out->magic = q << (64 - total);
+            out->shift = 0;
+        } else {
+            out->magic = q;
+            out->shift = (uint8_t)(total - 64);
+        }
+    } else {
+        div_magic_unsigned(ud, out);
+    }
+    return true;
+}
+
+lr_int_intrinsic_t lr_target_classify_int_intrinsic(const char *name,
+                                                    uint8_t *bits_out) {
+    static const struct {
+        const char *base;
+        lr_int_intrinsic_t kind;
+    } table[] = {
+        {"umax.", LR_INT_INTRIN_UMAX},   {"umin.", LR_INT_INTRIN_UMIN},
+        {"smax.", LR_INT_INTRIN_SMAX},   {"smin.", LR_INT_INTRIN_SMIN},
+        {"abs.", LR_INT_INTRIN_ABS},     {"ctpop.", LR_INT_INTRIN_CTPOP},
+        {"ctlz.", LR_INT_INTRIN_CTLZ},   {"cttz.", LR_INT_INTRIN_CTTZ},
+        {"fshl.", LR_INT_INTRIN_FSHL},   {"fshr.", LR_INT_INTRIN_FSHR},
+    };
+    const char *suffix = NULL;
+    lr_int_intrinsic_t kind = LR_INT_INTRIN_NONE;
+
+    if (bits_out)
+        *bits_out = 0;
+    if (!name)
+        return LR_INT_INTRIN_NONE;
+    while (*name == '\1' || *name == '_')
+        name++;
+    if (strncmp(name, "llvm.", 5) != 0)
+        return LR_INT_INTRIN_NONE;
+    name += 5;
+    for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++) {
+        size_t n = strlen(table[i].base);
+        if (strncmp(name, table[i].base, n) == 0) {
+            suffix = name + n;
+            kind = table[i].kind;
+            break;
+        }
+    }
+    if (!suffix)
+        return LR_INT_INTRIN_NONE;
+    if (strcmp(suffix, "i8") == 0) {
+        if (bits_out) *bits_out = 8;
+    } else if (strcmp(suffix, "i16") == 0) {
+        if (bits_out) *bits_out = 16;
+    } else if (strcmp(suffix, "i32") == 0) {
+        if (bits_out) *bits_out = 32;
+    } else if (strcmp(suffix, "i64") == 0) {
+        if (bits_out) *bits_out = 64;
+    } else {
+        return LR_INT_INTRIN_NONE;
+    }
+    return kind;
+}
+
+lr_fp_intrinsic_t lr_target_classify_fp_intrinsic(const char *name,
+                                                  uint8_t *bits_out) {
+    const char *suffix;
+
+    if (bits_out)
+        *bits_out = 0;
+    if (!name)
+        return LR_FP_INTRIN_NONE;
+    while (*name == '\1' || *name == '_')
+        name++;
+    if (strncmp(name, "llvm.fma.", 9) == 0)
+        suffix = name + 9;
+    else if (strncmp(name, "llvm.fmuladd.", 13) == 0)
+        suffix = name + 13;
+    else
+        return LR_FP_INTRIN_NONE;
+    if (strcmp(suffix, "f32") == 0) {
+        if (bits_out) *bits_out = 32;
+    } else if (strcmp(suffix, "f64") == 0) {
+        if (bits_out) *bits_out = 64;
+    } else {
+        return LR_FP_INTRIN_NONE;
+    }
+    return LR_FP_INTRIN_FMA;
+}
+
+lr_mem_intrinsic_t lr_target_classify_mem_intrinsic(const char *name) {
+    if (!name)
+        return LR_MEM_INTRIN_NONE;
+    while (*name == '\1' || *name == '_')
+        name++;
+    if (strncmp(name, "llvm.memcpy.", 12) == 0)
+        return LR_MEM_INTRIN_MEMCPY;
+    if (strncmp(name, "llvm.memset.", 12) == 0)
+        return LR_MEM_INTRIN_MEMSET;
+    return LR_MEM_INTRIN_NONE;
+}
+
+uint32_t lr_target_mem_inline_limit(void) {
+    static int cached = -1;
+    if (cached < 0) {
+        const char *env = getenv("LIRIC_MEM_INLINE_MAX");
+        long limit = LR_MEM_INLINE_DEFAULT_MAX;
+        if (env && env[0]) {
+            char *end = NULL;
+            long parsed = strtol(env, &end, 10);
+            if (end != env && *end == '\0' && parsed >= 0)
+                limit = parsed > 4096 ? 4096 : parsed;
+        }
+        cached = (int)limit;
+    }
+    return (uint32_t)cached;
+}
+
+bool lr_target_mem_inline_plan(lr_mem_intrinsic_t kind,
+                               const lr_operand_t *ops, uint32_t nops,
+                               lr_mem_inline_stats_t *stats,
+                               uint32_t *len_out) {
+    bool inline_ok = false;
+    uint64_t len = 0;
+
+    if (len_out)
+        *len_out = 0;
+    if (kind == LR_MEM_INTRIN_NONE)
+        return false;
+    if (ops && nops >= 4 && ops[3].kind == LR_VAL_IMM_I64 &&
+        ops[3].imm_i64 >= 0) {
+        len = (uint64_t)ops[3].imm_i64;
+        inline_ok = len <= lr_target_mem_inline_limit();
+    }
+    if (stats) {
+        if (kind == LR_MEM_INTRIN_MEMCPY) {
+            if (inline_ok) stats->memcpy_inlined++;
+            else stats->memcpy_called++;
+        } else {
+            if (inline_ok) stats->memset_inlined++;
+            else stats->memset_called++;
+        }
+        if (inline_ok)
+            stats->bytes_inlined += len;
+    }
+    if (inline_ok && len_out)
+        *len_out = (uint32_t)len;
+    return inline_ok;
+}
+
+void lr_target_mem_inline_report(const char *target_name,
+                                 const char *func_name,
+                                 const lr_mem_inline_stats_t *stats) {
+    if (!stats || !getenv("LIRIC_VERBOSE_MEM_INLINE"))
+        return;
+    if (stats->memcpy_inlined + stats->memcpy_called +
+        stats->memset_inlined + stats->memset_called == 0)
+        return;
+    fprintf(stderr,
+            "%s mem-inline: fn=%s memcpy=%u/%u memset=%u/%u bytes=%llu limit=%u\n",
+            target_name ? target_name : "?",
+            func_name ? func_name : "<anon>",
+            stats->memcpy_inlined,
+            stats->memcpy_inlined + stats->memcpy_called,
+            stats->memset_inlined,
+            stats->memset_inlined + stats->memset_called,
+            (unsigned long long)stats->bytes_inlined,
+            lr_target_mem_inline_limit());
+}
@@ -12,4 +12,333 @@ void lr_target_set_static_alloca_offset(lr_arena_t *arena,
                                         uint32_t vreg,
                                         int32_t offset);
 
+/* Conservative linear live ranges over a finalized function.
+   Position 0 is function entry (parameters); linear instruction i sits at
+   position i + 1.  Phi sources are read and phi destinations written at
+   the terminator of the incoming block.  Ranges that touch a backward
+   branch span are widened to the whole span, so a value live around a
+   loop stays live for the full loop body.  start[v] == UINT32_MAX marks a
+   vreg that never appears.  spans holds the merged backward-branch spans
+   (lowest position first) the ranges were widened with. */
+typedef struct lr_live_span {
+    uint32_t lo;
+    uint32_t hi;
+} lr_live_span_t;
+
+typedef struct lr_live_ranges {
+    uint32_t *start;
+    uint32_t *end;
+    uint32_t num_vregs;
+    lr_live_span_t *spans;
+    uint32_t num_spans;
+} lr_live_ranges_t;
+
+int lr_target_compute_live_ranges(const lr_func_t *func, lr_arena_t *arena,
+                                  lr_live_ranges_t *out);
+
+/* Loop headers of a finalized function: out[id] is true for blocks that
+   are the target of a branch from themselves or from a block later in
+   block-list order.  Tier-0 code bumps its profile counter there.
+   Returns NULL when func has no blocks or on allocation failure. */
+bool *lr_target_loop_headers(const lr_func_t *func, lr_arena_t *arena);
+
+/* Operand uses per vreg of a finalized function (phi incoming values
+   included), indexed by vreg id up to func->next_vreg.  Backends fold a
+   compare into its consumer when the consumer is the only use.  Returns
+   NULL when func has no vregs or on allocation failure. */
+uint32_t *lr_target_vreg_use_counts(const lr_func_t *func, lr_arena_t *arena);
+
+/* Cold blocks of a finalized function: cold[id] (num_blocks entries) is
+   set for blocks that end in unreachable or call a known no-return or
+   error-reporting function, and for blocks whose every successor is
+   cold.  The entry block is never cold.  Returns the number of cold
+   blocks. */
+uint32_t lr_target_cold_blocks(const lr_func_t *func, bool *cold);
+
+/* Stack slot coloring.  Backends hand out frame slots in emission order;
+   a slot whose occupants are all dead before a new value's live range
+   starts is reused instead of growing the frame.  Values use the live
+   ranges above.  A static alloca's memory is live from the first to the
+   last instruction touching a pointer derived from it (through GEPs and
+   bitcasts), and is merged only when every such pointer is used as a
+   load/store address, an icmp operand or an llvm.mem* / llvm.lifetime
+   argument; anything else pins it for the whole function.  Functions
+   that call setjmp keep one slot per value.
+
+   LIRIC_SLOT_COLORING=0 turns the pass off.  Savings are summed
+   process-wide (lr_target_slot_coloring_bytes_saved) and printed per
+   function at compile_end when LIRIC_VERBOSE_SLOT_COLORING is set. */
+typedef struct lr_slot_coloring lr_slot_coloring_t;
+
+/* NULL when the pass is off or func cannot be analyzed; every
+   lr_target_frame_slot call then grows the frame. */
+lr_slot_coloring_t *lr_target_slot_coloring_create(const lr_func_t *func,
+                                                   const lr_module_t *mod,
+                                                   lr_arena_t *arena);
+
+/* Frame-pointer offset (negative) of size bytes at align for vreg's value,
+   or for the memory of static alloca vreg when alloca_mem.  Reuses a dead
+   slot of the same size and alignment when one exists, otherwise aligns
+   *stack_size up, grows it by size and returns -*stack_size.  sc may be
+   NULL; vregs beyond the function's own (backend temporaries) always get
+   a fresh slot. */
+int32_t lr_target_frame_slot(lr_slot_coloring_t *sc, uint32_t vreg,
+                             bool alloca_mem, uint32_t size, uint32_t align,
+                             uint32_t *stack_size);
+void lr_target_slot_coloring_report(const char *target_name,
+                                    const char *func_name,
+                                    const lr_slot_coloring_t *sc,
+                                    uint32_t frame_size);
+void lr_target_slot_coloring_reset_stats(void);
+uint64_t lr_target_slot_coloring_bytes_saved(void);
+uint64_t lr_target_slot_coloring_slots_reused(void);
+
+/* Per-function constant pool.  FP immediates (and other constants bound
+   for FP registers) are loaded PC-relative from 8-byte entries placed
+   after the function body instead of being built in a GPR and moved
+   over.  Entries are deduplicated by bit pattern; every load site
+   records where its displacement (x86_64 rel32) or instruction (aarch64
+   ldr literal) sits so compile_end can patch it once the pool is placed
+   and any branch relaxation has settled.
+
+   LIRIC_CONST_POOL=0 turns the pool off.  Loads and entries are summed
+   process-wide and printed per function at compile_end when
+   LIRIC_VERBOSE_CONST_POOL is set. */
+typedef struct lr_const_pool_ref {
+    size_t pos;
+    uint32_t entry;
+} lr_const_pool_ref_t;
+
+typedef struct lr_const_pool {
+    uint64_t *entries;
+    uint32_t num_entries;
+    uint32_t entry_cap;
+    uint32_t *index;            /* open addressing, entry + 1, 0 empty */
+    uint32_t index_cap;
+    lr_const_pool_ref_t *refs;
+    uint32_t num_refs;
+    uint32_t ref_cap;
+    bool enabled;
+} lr_const_pool_t;
+
+/* Raw bits of a constant operand as it sits in a register: floats as
+   their f32 bits in the low half, null and undef as zero.  False for
+   non-constant operands and globals. */
+bool lr_target_imm_bits(const lr_operand_t *op, uint64_t *bits);
+
+void lr_target_const_pool_init(lr_const_pool_t *pool);
+
+/* Record a load of bits whose patch site is pos.  Returns -1 (nothing
+   recorded; materialize the constant some other way) when the pool is
+   off or out of memory. */
+int lr_target_const_pool_use(lr_const_pool_t *pool, lr_arena_t *arena,
+                             uint64_t bits, size_t pos);
+void lr_target_const_pool_report(const char *target_name,
+                                 const char *func_name,
+                                 const lr_const_pool_t *pool);
+void lr_target_const_pool_reset_stats(void);
+uint64_t lr_target_const_pool_loads(void);
+uint64_t lr_target_const_pool_entries(void);
+
+/* A GEP (ops[0] base, ops[1..] indices over source element type
+   src_type) as base + index * scale + disp.  index_op is the operand
+   number of the one non-constant index, or 0 when every index is
+   constant.  False when more than one index is non-constant. */
+typedef struct lr_gep_addr {
+    int64_t disp;
+    uint32_t index_op;
+    uint64_t scale;
+    uint8_t index_signext_bytes;
+} lr_gep_addr_t;
+
+bool lr_target_gep_addr(const lr_type_t *src_type, const lr_operand_t *ops,
+                        uint32_t num_ops, lr_gep_addr_t *out);
+
+/* Lowering plan for an LR_OP_SWITCH (operands: cond, default, then
+   case value / block pairs).  Case values are zero-extended to the
+   condition width, sorted and deduplicated (first occurrence wins), and
+   every distinct successor gets one dest index with the default at 0, so
+   a backend can emit a single landing pad (phi copies + jump) per edge.
+   BIT_TEST is picked for a few destinations packed into a 64-value
+   window, JUMP_TABLE for at least LR_SWITCH_JT_MIN_CASES cases with 40%
+   density, and TREE (balanced unsigned compares) otherwise. */
+#define LR_SWITCH_JT_MIN_CASES 4u
+#define LR_SWITCH_JT_MAX_RANGE 4096u
+#define LR_SWITCH_BT_MAX_DESTS 3u
+
+typedef enum lr_switch_lowering {
+    LR_SWITCH_LOWER_TREE = 0,
+    LR_SWITCH_LOWER_JUMP_TABLE,
+    LR_SWITCH_LOWER_BIT_TEST,
+} lr_switch_lowering_t;
+
+typedef struct lr_switch_case {
+    uint64_t value;
+    uint32_t dest;
+} lr_switch_case_t;
+
+typedef struct lr_switch_plan {
+    lr_switch_lowering_t kind;
+    uint8_t bits;
+    uint64_t min;
+    uint64_t range;             /* max - min, valid when num_cases > 0 */
+    lr_switch_case_t *cases;
+    uint32_t num_cases;
+    uint32_t *dests;            /* successor block ids, dests[0] = default */
+    uint32_t num_dests;
+    uint64_t *bit_masks;        /* BIT_TEST: cases of dest i, bit = value - min */
+} lr_switch_plan_t;
+
+int lr_target_plan_switch(const lr_operand_t *ops, uint32_t num_ops,
+                          lr_arena_t *arena, lr_switch_plan_t *out);
+
+/* Sequential order for the parallel copies dests[i] = srcs[i] of one
+   phi edge (dests distinct).  Copies whose source is their own
+   destination are dropped; a copy is placed once no pending copy still
+   reads its destination.  Each remaining cycle is broken by a SAVE of
+   one destination into the backend's scratch register, after which the
+   copy that read it is emitted as a RESTORE from the scratch; the cycle
+   drains before the next SAVE, so one scratch suffices.  steps needs
+   room for 2 * n entries.  Returns the step count, or -1 on allocation
+   failure. */
+typedef enum lr_pcopy_kind {
+    LR_PCOPY_MOVE = 0,          /* dests[index] = srcs[index] */
+    LR_PCOPY_SAVE,              /* scratch = dests[index] (old value) */
+    LR_PCOPY_RESTORE,           /* dests[index] = scratch */
+} lr_pcopy_kind_t;
+
+typedef struct lr_pcopy_step {
+    lr_pcopy_kind_t kind;
+    uint32_t index;
+} lr_pcopy_step_t;
+
+int lr_target_sequence_parallel_copies(const uint32_t *dests,
+                                       const lr_operand_t *srcs, uint32_t n,
+                                       lr_arena_t *arena,
+                                       lr_pcopy_step_t *steps);
+
+/* Argument locations under the internal convention of fast_cc functions
+   (see lr_module_mark_fast_cc).  Integers and pointers take the next of
+   num_gp GP registers and float/double the next of num_fp FP registers,
+   as the platform ABI does; once a class runs out, its arguments move
+   as raw bits into the other class's free registers before falling
+   back to 8-byte stack slots.  Returns the number of stack slots. */
+typedef enum lr_cc_loc_kind {
+    LR_CC_LOC_GP = 0,
+    LR_CC_LOC_FP,
+    LR_CC_LOC_STACK,
+} lr_cc_loc_kind_t;
+
+typedef struct lr_cc_loc {
+    lr_cc_loc_kind_t kind;
+    uint32_t index;
+} lr_cc_loc_t;
+
+uint32_t lr_target_fast_cc_assign(lr_type_t *const *param_types, uint32_t n,
+                                  uint32_t num_gp, uint32_t num_fp,
+                                  lr_cc_loc_t *out);
+
+/* Integer intrinsics the native backends may expand inline instead of
+   calling the platform_intrinsics.c helper.  Only exact overloads such as
+   "llvm.ctpop.i32" match; *bits_out receives the width (8/16/32/64).  A
+   backend that lacks a sequence for the width or CPU still emits the call. */
+typedef enum lr_int_intrinsic {
+    LR_INT_INTRIN_NONE = 0,
+    LR_INT_INTRIN_UMAX,
+    LR_INT_INTRIN_UMIN,
+    LR_INT_INTRIN_SMAX,
+    LR_INT_INTRIN_SMIN,
+    LR_INT_INTRIN_ABS,
+    LR_INT_INTRIN_CTPOP,
+    LR_INT_INTRIN_CTLZ,
+    LR_INT_INTRIN_CTTZ,
+    LR_INT_INTRIN_FSHL,
+    LR_INT_INTRIN_FSHR,
+} lr_int_intrinsic_t;
+
+lr_int_intrinsic_t lr_target_classify_int_intrinsic(const char *name,
+                                                    uint8_t *bits_out);
+
+/* llvm.fma / llvm.fmuladd on float or double (*bits_out = 32/64), which
+   backends with a fused multiply-add instruction expand inline. */
+typedef enum lr_fp_intrinsic {
+    LR_FP_INTRIN_NONE = 0,
+    LR_FP_INTRIN_FMA,
+} lr_fp_intrinsic_t;
+
+lr_fp_intrinsic_t lr_target_classify_fp_intrinsic(const char *name,
+                                                  uint8_t *bits_out);
+
+/* Division of a register by a constant divisor without the hardware
+   divide (Granlund-Montgomery; Hacker's Delight ch. 10).  The dividend is
+   taken at 64 bits, sign-extended for sdiv/srem and zero-extended for
+   udiv/urem, and the quotient q is:
+
+     IDENT  q = n, negated when negate is set (d == 1 or signed d == -1);
+     POW2   unsigned: q = n >> shift;
+            signed:   q = (n + ((n >> 63) >>> (64 - shift))) >> shift,
+                      negated when negate is set;
+     MAGIC  unsigned: h = mulhu(n, magic); q = h >> shift, or with fixup
+                      q = (((n - h) >>> 1) + h) >>> (shift - 1);
+            signed:   h = mulhs(n, magic) + fixup * n; h >>= shift;
+                      q = h + (h >>> 63).
+
+   The remainder is n - q * divisor.  Returns false (hardware divide) for
+   a zero divisor, widths above 64 and the rare divisors whose sequence
+   would not pay off (signed INT64_MIN, unsigned >= 2^63). */
+typedef enum lr_div_const_kind {
+    LR_DIV_CONST_IDENT = 1,
+    LR_DIV_CONST_POW2,
+    LR_DIV_CONST_MAGIC,
+} lr_div_const_kind_t;
+
+typedef struct lr_div_const {
+    lr_div_const_kind_t kind;
+    bool negate;
+    int8_t fixup;
+    uint8_t shift;
+    uint64_t magic;
+    int64_t divisor;            /* d extended to 64 bits like the dividend */
+} lr_div_const_t;
+
+bool lr_target_div_const_plan(bool is_signed, uint8_t bits, int64_t imm,
+                              lr_div_const_t *out);
+
+/* llvm.memcpy / llvm.memset calls whose constant length is at most
+   lr_target_mem_inline_limit() bytes are expanded by the native backends
+   into straight-line wide moves; variable or longer lengths keep calling
+   the helper.  The limit comes from LIRIC_MEM_INLINE_MAX (0 disables) and
+   defaults to LR_MEM_INLINE_DEFAULT_MAX.  Per-function decisions are
+   counted in lr_mem_inline_stats_t and printed at compile_end when
+   LIRIC_VERBOSE_MEM_INLINE is set. */
+#define LR_MEM_INLINE_DEFAULT_MAX 128u
+
+typedef enum lr_mem_intrinsic {
+    LR_MEM_INTRIN_NONE = 0,
+    LR_MEM_INTRIN_MEMCPY,
+    LR_MEM_INTRIN_MEMSET,
+} lr_mem_intrinsic_t;
+
+typedef struct lr_mem_inline_stats {
+    uint32_t memcpy_inlined;
+    uint32_t memcpy_called;
+    uint32_t memset_inlined;
+    uint32_t memset_called;
+    uint64_t bytes_inlined;
+} lr_mem_inline_stats_t;
+
+lr_mem_intrinsic_t lr_target_classify_mem_intrinsic(const char *name);
+uint32_t lr_target_mem_inline_limit(void);
+
+/* Decide whether call operands ops[0..nops) (callee, dst, src/val, len,
+   ...) are expanded inline, record the decision in stats and return the
+   byte count in *len_out.  Zero-length calls are inlined as no-ops. */
+bool lr_target_mem_inline_plan(lr_mem_intrinsic_t kind,
+                               const lr_operand_t *ops, uint32_t nops,
+                               lr_mem_inline_stats_t *stats,
+                               uint32_t *len_out);
+void lr_target_mem_inline_report(const char *target_name,
+                                 const char *func_name,
+                                 const lr_mem_inline_stats_t *stats);
+
 #endif
@@ -3,6 +3,8 @@
 #include "target_shared.h"
 #include "objfile.h"
 #include "jit.h"
+#include "stencil_runtime.h"
+#include "platform/platform_cpu.h"
 #include <math.h>
 #include <stdbool.h>
 #include <string.h>
@@ -22,16 +24,84 @@
  * ISel and encoding are fused into a single compile pass.
  * Stack slots are allocated lazily while emitting instructions; the prologue
  * stack adjustment is patched after emission when final frame size is known.
+ *
+ * With LR_CODEGEN_REGALLOC and a finalized function, a linear-scan pass in
+ * compile_begin homes integer/pointer vregs in GPRs.  Values live over a
+ * call get the callee-saved RBX and R12-R15, so calls need no spill code.
+ * Values whose range has no call can also take RSI, RDI, R8 and R9.
+ * Float and double values whose range has no call go to XMM8-XMM15.
+ * Homed vregs never get a stack slot: the slot load/store helpers become
+ * register moves, and phi copies write the home directly.  Vregs that
+ * reach a raw-slot path (aggregates, vectors, x87) stay slot-based.
+ *
+ * In LR_COMPILE_COPY_PATCH mode, scalar instructions whose operands are
+ * slots, static allocas or constants are emitted by copying a pre-compiled
+ * stencil (stencils/) and patching its slot offsets and immediates; RDI
+ * carries the frame pointer into the stencil.  Calls with up to three
+ * integer arguments and an integer or FP result have stencils too.
+ * Anything without a matching stencil falls back to the ISel path below.
+ * Copy-patch skips slot coloring and use counting, so every value keeps
+ * a slot of its own and compares are never fused into branches.
+ *
+ * Branches are emitted in rel32 form and recorded as fixups.  compile_end
+ * resolves them, then relaxes the code: jumps to the next instruction are
+ * dropped, a jcc over a jmp to its own target is inverted, and branches
+ * that reach are shortened to rel8, repeated to a fixed point before the
+ * code is compacted and every recorded offset is remapped.  FP constants
+ * are then appended as a deduplicated pool that movsd / SSE arithmetic
+ * reads RIP-relative.
+ *
+ * Every function starts with the full rbp frame, but a leaf whose slots
+ * fit the SysV red zone loses its "sub rsp" and epilogue "mov rsp, rbp" in
+ * that compaction, and one with no slots loses the frame entirely (see
+ * x86_frame_drops).
  */
 
 #define FP_SCRATCH0  X86_XMM0
 #define FP_SCRATCH1  X86_XMM1
 
+#define X86_NO_HOME  0xFFu
+#define X86_XMM_HOME 0x10u  /* reg_homes entry X86_XMM_HOME + n is XMMn */
+#define X86_NUM_ALLOC_REGS 9u
+#define X86_NUM_SAVED_ALLOC_REGS 5u
+#define X86_NUM_ALLOC_XMMS 8u
+#define X86_RED_ZONE 128u
+
+/* Callee-saved registers first.  The rest are argument registers that
+   ISel only writes while setting up a call (or fmod for frem), so they
+   can hold values whose live range contains no call. */
+static const uint8_t x86_alloc_regs[X86_NUM_ALLOC_REGS] = {
+    X86_RBX, X86_R12, X86_R13, X86_R14, X86_R15,
+    X86_RSI, X86_RDI, X86_R8, X86_R9
+};
+
+/* ISel never touches XMM8-XMM15: scratch is XMM0/XMM1, arguments and
+   vector lowering stay in XMM0-XMM7.  SysV saves none of them, so they
+   hold float/double values whose live range has no call. */
+static const uint8_t x86_alloc_xmms[X86_NUM_ALLOC_XMMS] = {
+    X86_XMM8, X86_XMM9, X86_XMM10, X86_XMM11,
+    X86_XMM12, X86_XMM13, X86_XMM14, X86_XMM15
+};
+
+/* Fixup kinds: JMP (E9) and JCC (0F 8x) branches may be relaxed to their
+   rel8 forms or dropped; REL32 is any other displacement ending its
+   instruction; TABLE is a jump-table entry relative to base. */
+enum {
+    X86_FIXUP_JMP,
+    X86_FIXUP_JCC,
+    X86_FIXUP_REL32,
+    X86_FIXUP_TABLE,
+};
+
+/* A rel32 at pos against block target or, when target_pos_hint is not
+   SIZE_MAX, against that code offset. */
 typedef struct {
     size_t pos;
     size_t target_pos_hint;
+    size_t base;        /* X86_FIXUP_TABLE only */
     uint32_t target;
     uint32_t source;
+    uint8_t kind;
 } x86_fixup_t;
 
 /* Backend-local compile context replacing the old MIR linked-list state */
@@ -51,8 +121,10 @@ typedef struct {
     x86_fixup_t *fixups;
     uint32_t num_fixups;
     uint32_t fixup_cap;
+    bool fixups_lost;           /* a fixup could not be recorded */
     lr_arena_t *arena;
     lr_objfile_ctx_t *obj_ctx;
+    uint32_t reloc_base;        /* first obj_ctx reloc of this function */
     lr_module_t *mod;
     uint8_t *sym_defined;
     lr_func_t **sym_funcs;
@@ -68,7 +140,28 @@ typedef struct {
     uint32_t vararg_named_fp;
     uint32_t vararg_named_stack_gp;
     lr_jit_t *jit;
+    uint32_t cpu_features; /* LR_CPU_X86_* the code may assume */
+    uint64_t *loop_counter;     /* tier-0 profile counter, or NULL */
+    const bool *loop_headers;   /* by block id, when loop_counter is set */
+    uint32_t num_loop_headers;
+    const uint32_t *vreg_uses;  /* operand uses by vreg, or NULL */
+    uint32_t num_vreg_uses;
     bool func_uses_external_sysv_fp;
+    uint8_t *reg_homes;
+    uint32_t num_reg_homes;
+    uint8_t saved_regs[X86_NUM_SAVED_ALLOC_REGS];
+    int32_t saved_reg_offs[X86_NUM_SAVED_ALLOC_REGS];
+    uint32_t num_saved_regs;
+    bool frame_pinned;          /* calls, moves rsp or runs stencils */
+    bool reads_caller_frame;    /* stack arguments at [rbp+16...] */
+    uint32_t incoming_stack_units; /* 8-byte stack argument words */
+    size_t *epilogue_pos;       /* "mov rsp, rbp" of each epilogue */
+    uint32_t num_epilogues;
+    uint32_t epilogue_cap;
+    const char *func_name;
+    lr_mem_inline_stats_t mem_inline;
+    lr_slot_coloring_t *slot_coloring; /* NULL: one slot per value */
+    lr_const_pool_t const_pool;
 } x86_compile_ctx_t;
 
 static void invalidate_cached_reg(x86_compile_ctx_t *ctx, uint8_t reg) {
@@ -96,6 +189,31 @@ static void set_cached_reg_vreg(x86_compile_ctx_t *ctx, uint8_t reg, uint32_t vr
     if (reg == X86_RCX) ctx->rcx_holds_vreg = vreg;
 }
 
+static bool vreg_is_homed(const x86_compile_ctx_t *ctx, uint32_t vreg) {
+    return ctx && vreg < ctx->num_reg_homes &&
+           ctx->reg_homes[vreg] != X86_NO_HOME;
+}
+
+/* GPR home of vreg; X86_NO_HOME for stack and XMM-homed values. */
+static uint8_t vreg_home_reg(const x86_compile_ctx_t *ctx, uint32_t vreg) {
+    uint8_t home;
+    if (!ctx || vreg >= ctx->num_reg_homes)
+        return X86_NO_HOME;
+    home = ctx->reg_homes[vreg];
+    return home < X86_XMM_HOME ? home : X86_NO_HOME;
+}
+
+/* XMM home of vreg, or X86_NO_HOME. */
+static uint8_t vreg_xmm_home(const x86_compile_ctx_t *ctx, uint32_t vreg) {
+    uint8_t home;
+    if (!ctx || vreg >= ctx->num_reg_homes)
+        return X86_NO_HOME;
+    home = ctx->reg_homes[vreg];
+    if (home == X86_NO_HOME || home < X86_XMM_HOME)
+        return X86_NO_HOME;
+    return (uint8_t)(home - X86_XMM_HOME);
+}
+
 static size_t align_up(size_t value, size_t align) {
     if (align <= 1)
         return value;
@@ -126,7 +244,8 @@ static bool uses_internal_sret_abi(const lr_type_t *type) {
     size_t sz;
     if (!type)
         return false;
-    if (type->kind != LR_TYPE_STRUCT && type->kind != LR_TYPE_ARRAY)
+    if (type->kind != LR_TYPE_STRUCT && type->kind != LR_TYPE_ARRAY &&
+        type->kind != LR_TYPE_VECTOR)
         return false;
     sz = lr_type_size(type);
     return sz > 8;
@@ -159,9 +278,9 @@ static int32_t alloc_slot(x86_compile_ctx_t *ctx, uint32_t vreg,
 
     if (size < 8) size = 8;
     if (align < 8) align = 8;
-    ctx->stack_size = (uint32_t)align_up(ctx->stack_size, align);
-    ctx->stack_size += (uint32_t)size;
-    int32_t offset = -(int32_t)ctx->stack_size;
+    int32_t offset = lr_target_frame_slot(ctx->slot_coloring, vreg, false,
+                                          (uint32_t)size, (uint32_t)align,
+                                          &ctx->stack_size);
     ctx->stack_slots[vreg] = offset;
     ctx->stack_slot_sizes[vreg] = (uint32_t)size;
     return offset;
@@ -247,6 +366,52 @@ static void encode_mem(uint8_t *buf, size_t *pos, size_t len,
         emit_u32(buf, pos, len, (uint32_t)disp);
 }
 
+/* Memory operand [base + index * scale + disp]; index is X86_NO_HOME
+   when absent and never RSP. */
+typedef struct {
+    uint8_t base;
+    uint8_t index;
+    uint8_t scale;
+    int32_t disp;
+} x86_addr_t;
+
+/* encode_mem over an x86_addr_t.  Opcodes above 0xFF are 0x0F-prefixed
+   (movzx); size 8 sets REX.W and size 2 adds the operand-size prefix. */
+static void encode_mem_addr(uint8_t *buf, size_t *pos, size_t len,
+                            uint16_t opcode, uint8_t reg,
+                            const x86_addr_t *a, uint8_t size) {
+    bool has_index = a->index != X86_NO_HOME;
+    bool index_ext = has_index && a->index >= 8;
+    bool need_rex = (size == 8) || (reg >= 8) || (a->base >= 8) || index_ext;
+    uint8_t ss = a->scale == 8 ? 3 : a->scale == 4 ? 2 : a->scale == 2 ? 1 : 0;
+    uint8_t mod;
+
+    if (size == 2) emit_byte(buf, pos, len, 0x66);
+    if (need_rex)
+        emit_byte(buf, pos, len, rex(size == 8, reg >= 8, index_ext,
+                                     a->base >= 8));
+    if (opcode > 0xFF)
+        emit_byte(buf, pos, len, 0x0F);
+    emit_byte(buf, pos, len, (uint8_t)opcode);
+
+    if (a->disp == 0 && (a->base & 7) != 5) mod = 0;
+    else if (a->disp >= -128 && a->disp <= 127) mod = 1;
+    else mod = 2;
+    if (has_index) {
+        emit_byte(buf, pos, len, modrm(mod, reg, 4));
+        emit_byte(buf, pos, len,
+                  (uint8_t)((ss << 6) | ((a->index & 7) << 3) | (a->base & 7)));
+    } else {
+        emit_byte(buf, pos, len, modrm(mod, reg, a->base));
+        if ((a->base & 7) == 4)
+            emit_byte(buf, pos, len, 0x24);
+    }
+    if (mod == 1)
+        emit_byte(buf, pos, len, (uint8_t)(int8_t)a->disp);
+    else if (mod == 2)
+        emit_u32(buf, pos, len, (uint32_t)a->disp);
+}
+
 static uint8_t lr_cc_to_x86(uint8_t cc) {
     switch (cc) {
     case LR_CC_EQ:  return X86_CC_E;
@@ -269,6 +434,8 @@ static void encode_sse_rr(uint8_t *buf, size_t *pos, size_t len,
                            uint8_t prefix, uint8_t op1, uint8_t op2,
                            uint8_t xmm_dst, uint8_t xmm_src) {
     emit_byte(buf, pos, len, prefix);
+    if (xmm_dst >= 8 || xmm_src >= 8)
+        emit_byte(buf, pos, len, rex(false, xmm_dst >= 8, false, xmm_src >= 8));
     emit_byte(buf, pos, len, 0x0F);
     emit_byte(buf, pos, len, op1);
     if (op2 != 0) emit_byte(buf, pos, len, op2);
@@ -279,6 +446,8 @@ static void encode_sse_mem(uint8_t *buf, size_t *pos, size_t len,
                             uint8_t prefix, uint8_t op1, uint8_t op2,
                             uint8_t xmm_reg, uint8_t base, int32_t disp) {
     emit_byte(buf, pos, len, prefix);
+    if (xmm_reg >= 8 || base >= 8)
+        emit_byte(buf, pos, len, rex(false, xmm_reg >= 8, false, base >= 8));
     emit_byte(buf, pos, len, 0x0F);
     emit_byte(buf, pos, len, op1);
     if (op2 != 0) emit_byte(buf, pos, len, op2);
@@ -297,6 +466,49 @@ static void encode_sse_mem(uint8_t *buf, size_t *pos, size_t len,
         emit_u32(buf, pos, len, (uint32_t)disp);
 }
 
+/* Three-byte VEX prefix (C4).  map: 1 = 0F, 2 = 0F38, 3 = 0F3A; pp: 0 =
+   none, 1 = 66, 2 = F3, 3 = F2; vvvv is the extra (non-destructive) source
+   register, 0 when unused. */
+static void encode_vex(uint8_t *buf, size_t *pos, size_t len, uint8_t map,
+                       bool w, uint8_t vvvv, bool l256, uint8_t pp,
+                       uint8_t reg, uint8_t rm) {
+    emit_byte(buf, pos, len, 0xC4);
+    emit_byte(buf, pos, len, (uint8_t)((reg >= 8 ? 0 : 0x80) | 0x40 |
+                                       (rm >= 8 ? 0 : 0x20) | map));
+    emit_byte(buf, pos, len, (uint8_t)((w ? 0x80 : 0) |
+                                       ((~vvvv & 0xFu) << 3) |
+                                       (l256 ? 0x04 : 0) | pp));
+}
+
+static void encode_vex_rr(uint8_t *buf, size_t *pos, size_t len,
+                          uint8_t map, uint8_t pp, bool w, bool l256,
+                          uint8_t op, uint8_t reg, uint8_t vvvv,
+                          uint8_t rm) {
+    encode_vex(buf, pos, len, map, w, vvvv, l256, pp, reg, rm);
+    emit_byte(buf, pos, len, op);
+    emit_byte(buf, pos, len, modrm(3, reg, rm));
+}
+
+static void encode_vex_mem(uint8_t *buf, size_t *pos, size_t len,
+                           uint8_t map, uint8_t pp, bool l256, uint8_t op,
+                           uint8_t reg, uint8_t base, int32_t disp) {
+    encode_vex(buf, pos, len, map, false, 0, l256, pp, reg, base);
+    emit_byte(buf, pos, len, op);
+
+    uint8_t mod;
+    if (disp == 0 && (base & 7) != 5) mod = 0;
+    else if (disp >= -128 && disp <= 127) mod = 1;
+    else mod = 2;
+
+    emit_byte(buf, pos, len, modrm(mod, reg, base));
+    if ((base & 7) == 4)
+        emit_byte(buf, pos, len, 0x24);
+    if (mod == 1)
+        emit_byte(buf, pos, len, (uint8_t)(int8_t)disp);
+    else if (mod == 2)
+        emit_u32(buf, pos, len, (uint32_t)disp);
+}
+
 static void emit_setcc_byte(uint8_t *buf, size_t *pos, size_t len,
                              uint8_t x86cc, uint8_t dst_reg) {
     if (dst_reg >= 8)
@@ -376,6 +588,17 @@ static void emit_fp_setcc(uint8_t *buf, size_t *pos, size_t len,
 
 /* ---- Direct-emission ISel helpers ---- */
 
+/* movq xmm, gpr (to_xmm) or movq gpr, xmm: 66 REX.W 0F 6E / 7E. */
+static void emit_movq_xmm_gpr(x86_compile_ctx_t *ctx, bool to_xmm,
+                              uint8_t xmm, uint8_t gpr) {
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0x66);
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen,
+              rex(true, xmm >= 8, false, gpr >= 8));
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0x0F);
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, to_xmm ? 0x6E : 0x7E);
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, modrm(3, xmm, gpr));
+}
+
 /* Emit: mov reg, [rbp + offset] (load vreg from stack) */
 static void emit_load_slot(x86_compile_ctx_t *ctx, uint32_t vreg, uint8_t reg) {
     /* Static allocas: emit LEA inline instead of loading from slot.
@@ -390,6 +613,19 @@ static void emit_load_slot(x86_compile_ctx_t *ctx, uint32_t vreg, uint8_t reg) {
         set_cached_reg_vreg(ctx, reg, vreg);
         return;
     }
+    uint8_t home = vreg_home_reg(ctx, vreg);
+    if (home != X86_NO_HOME) {
+        if (home != reg)
+            encode_alu_rr(ctx->buf, &ctx->pos, ctx->buflen, 0x89, reg, home, 8);
+        set_cached_reg_vreg(ctx, reg, vreg);
+        return;
+    }
+    home = vreg_xmm_home(ctx, vreg);
+    if (home != X86_NO_HOME) {
+        emit_movq_xmm_gpr(ctx, false, home, reg);
+        set_cached_reg_vreg(ctx, reg, vreg);
+        return;
+    }
     int32_t off = alloc_slot(ctx, vreg, 8, 8);
     encode_mem(ctx->buf, &ctx->pos, ctx->buflen, 0x8B, reg, X86_RBP, off, 8);
     set_cached_reg_vreg(ctx, reg, vreg);
@@ -397,6 +633,18 @@ static void emit_load_slot(x86_compile_ctx_t *ctx, uint32_t vreg, uint8_t reg) {
 
 /* Emit: mov [rbp + offset], reg (store reg to vreg stack slot) */
 static void emit_store_slot(x86_compile_ctx_t *ctx, uint32_t vreg, uint8_t reg) {
+    uint8_t home = vreg_home_reg(ctx, vreg);
+    if (home != X86_NO_HOME) {
+        encode_alu_rr(ctx->buf, &ctx->pos, ctx->buflen, 0x89, home, reg, 8);
+        set_cached_reg_vreg(ctx, reg, vreg);
+        return;
+    }
+    home = vreg_xmm_home(ctx, vreg);
+    if (home != X86_NO_HOME) {
+        emit_movq_xmm_gpr(ctx, true, home, reg);
+        set_cached_reg_vreg(ctx, reg, vreg);
+        return;
+    }
     int32_t off = alloc_slot(ctx, vreg, 8, 8);
     encode_mem(ctx->buf, &ctx->pos, ctx->buflen, 0x89, reg, X86_RBP, off, 8);
     set_cached_reg_vreg(ctx, reg, vreg);
@@ -542,6 +790,17 @@ static uint8_t int_type_width_bits(const lr_type_t *type) {
     return (uint8_t)fallback_bits;
 }
 
+/* Plan for a scalar integer div/rem whose divisor is a constant. */
+static bool x86_div_const(const lr_compile_inst_desc_t *desc,
+                          const lr_operand_t *divisor, lr_div_const_t *out) {
+    bool is_signed = desc->op == LR_OP_SDIV || desc->op == LR_OP_SREM;
+    if (divisor->kind != LR_VAL_IMM_I64 || !desc->type ||
+        lr_type_size(desc->type) > 8)
+        return false;
+    return lr_target_div_const_plan(is_signed, int_type_width_bits(desc->type),
+                                    divisor->imm_i64, out);
+}
+
 static bool call_signature_matches_func(const lr_inst_t *call_inst,
                                         const lr_func_t *func) {
     uint32_t num_args = 0;
@@ -549,7 +808,7 @@ static bool call_signature_matches_func(const lr_inst_t *call_inst,
         return false;
     if (call_inst->op != LR_OP_CALL)
         return false;
-    if (func->ret_type != call_inst->type)
+    if (!lr_type_same(func->ret_type, call_inst->type))
         return false;
     num_args = call_inst->num_operands > 0 ? call_inst->num_operands - 1u : 0u;
     if (func->vararg) {
@@ -560,7 +819,8 @@ static bool call_signature_matches_func(const lr_inst_t *call_inst,
     }
     for (uint32_t i = 0; i < func->num_params; i++) {
         const lr_operand_t *arg = &call_inst->operands[i + 1u];
-        if (!func->param_types || func->param_types[i] != arg->type)
+        if (!func->param_types ||
+            !lr_type_same(func->param_types[i], arg->type))
             return false;
     }
     return true;
@@ -636,18 +896,9 @@ static void emit_load_operand(x86_compile_ctx_t *ctx,
             return;
         emit_load_slot(ctx, op->vreg, reg);
     } else if (op->kind == LR_VAL_IMM_F64) {
-        int64_t imm_bits = 0;
-        if (op->type && op->type->kind == LR_TYPE_FLOAT) {
-            float fv = (float)op->imm_f64;
-            uint32_t bits = 0;
-            memcpy(&bits, &fv, sizeof(bits));
-            imm_bits = (int64_t)(uint64_t)bits;
-        } else {
-            uint64_t bits = 0;
-            memcpy(&bits, &op->imm_f64, sizeof(bits));
-            imm_bits = (int64_t)bits;
-        }
-        emit_mov_imm(ctx, reg, imm_bits, preserve_flags);
+        uint64_t bits = 0;
+        (void)lr_target_imm_bits(op, &bits);
+        emit_mov_imm(ctx, reg, (int64_t)bits, preserve_flags);
     } else if (op->kind == LR_VAL_NULL || op->kind == LR_VAL_UNDEF) {
         emit_mov_imm(ctx, reg, 0, preserve_flags);
     } else if (op->kind == LR_VAL_GLOBAL && ctx->jit && !ctx->obj_ctx) {
@@ -731,6 +982,14 @@ static void emit_load_operand(x86_compile_ctx_t *ctx,
 
 static void emit_load_fp_slot(x86_compile_ctx_t *ctx,
                                uint32_t vreg, uint8_t fpreg, uint8_t fsize) {
+    uint8_t home = vreg_xmm_home(ctx, vreg);
+    if (home != X86_NO_HOME) {
+        /* movapd fpreg, home */
+        if (home != fpreg)
+            encode_sse_rr(ctx->buf, &ctx->pos, ctx->buflen, 0x66, 0x28, 0,
+                          fpreg, home);
+        return;
+    }
     int32_t off = alloc_slot(ctx, vreg, 8, 8);
     uint8_t prefix = (fsize == 8) ? 0xF2 : 0xF3;
     encode_sse_mem(ctx->buf, &ctx->pos, ctx->buflen, prefix, 0x10, 0,
@@ -739,6 +998,13 @@ static void emit_load_fp_slot(x86_compile_ctx_t *ctx,
 
 static void emit_store_fp_slot(x86_compile_ctx_t *ctx,
                                 uint32_t vreg, uint8_t fpreg, uint8_t fsize) {
+    uint8_t home = vreg_xmm_home(ctx, vreg);
+    if (home != X86_NO_HOME) {
+        if (home != fpreg)
+            encode_sse_rr(ctx->buf, &ctx->pos, ctx->buflen, 0x66, 0x28, 0,
+                          home, fpreg);
+        return;
+    }
     int32_t off = alloc_slot(ctx, vreg, 8, 8);
     uint8_t prefix = (fsize == 8) ? 0xF2 : 0xF3;
     encode_sse_mem(ctx->buf, &ctx->pos, ctx->buflen, prefix, 0x11, 0,
@@ -759,21 +1025,84 @@ static void emit_store_fp_mem_base(x86_compile_ctx_t *ctx, uint8_t base,
                    fpreg, base, off);
 }
 
+/* "prefix 0F opc xmm, [rip + disp32]" against the constant pool entry
+   for bits; false (nothing emitted) when the pool is unavailable. */
+static bool emit_sse_pool_op(x86_compile_ctx_t *ctx, uint8_t prefix,
+                             uint8_t opc, uint8_t fpreg, uint64_t bits) {
+    size_t disp_pos = ctx->pos + (fpreg >= 8 ? 5u : 4u);
+    if (lr_target_const_pool_use(&ctx->const_pool, ctx->arena, bits,
+                                 disp_pos) != 0)
+        return false;
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, prefix);
+    if (fpreg >= 8)
+        emit_byte(ctx->buf, &ctx->pos, ctx->buflen,
+                  rex(false, true, false, false));
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0x0F);
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, opc);
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, modrm(0, fpreg, 5));
+    emit_u32(ctx->buf, &ctx->pos, ctx->buflen, 0);
+    return true;
+}
+
+/* Emit the pool after the code, 8-byte aligned relative to the function
+   start, and point every load at its entry.  Runs after relaxation so
+   the recorded displacement positions are final. */
+static void emit_const_pool(x86_compile_ctx_t *ctx) {
+    const lr_const_pool_t *pool = &ctx->const_pool;
+    size_t base;
+    if (pool->num_refs == 0)
+        return;
+    while (ctx->pos & 7u)
+        emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0xCC);
+    base = ctx->pos;
+    for (uint32_t i = 0; i < pool->num_entries; i++)
+        emit_u64(ctx->buf, &ctx->pos, ctx->buflen, pool->entries[i]);
+    for (uint32_t i = 0; i < pool->num_refs; i++) {
+        size_t at = pool->refs[i].pos;
+        size_t to = base + (size_t)pool->refs[i].entry * 8u;
+        patch_u32(ctx->buf, ctx->buflen, at,
+                  (uint32_t)(int32_t)((int64_t)to - (int64_t)(at + 4u)));
+    }
+}
+
 static void emit_load_fp_operand(x86_compile_ctx_t *ctx,
                                   const lr_operand_t *op, uint8_t fpreg,
                                   uint8_t fsize) {
+    uint64_t bits = 0;
     if (op->kind == LR_VAL_VREG) {
         emit_load_fp_slot(ctx, op->vreg, fpreg, fsize);
-    } else {
-        /* Load immediate bits into GPR, then move to XMM */
-        emit_load_operand(ctx, op, X86_RAX);
-        /* movq xmm, reg: 66 REX.W 0F 6E /r */
-        emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0x66);
-        emit_byte(ctx->buf, &ctx->pos, ctx->buflen, rex(true, fpreg >= 8, false, false));
-        emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0x0F);
-        emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0x6E);
-        emit_byte(ctx->buf, &ctx->pos, ctx->buflen, modrm(3, fpreg, X86_RAX));
+        return;
     }
+    if (lr_target_imm_bits(op, &bits)) {
+        if (bits == 0) {
+            /* xorpd xmm, xmm */
+            encode_sse_rr(ctx->buf, &ctx->pos, ctx->buflen, 0x66, 0x57, 0,
+                          fpreg, fpreg);
+            return;
+        }
+        /* movsd xmm, [rip + pool] sets the low 64 bits like movq below */
+        if (emit_sse_pool_op(ctx, 0xF2, 0x10, fpreg, bits))
+            return;
+    }
+    /* Load immediate bits into GPR, then move to XMM */
+    emit_load_operand(ctx, op, X86_RAX);
+    /* movq xmm, reg: 66 REX.W 0F 6E /r */
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0x66);
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, rex(true, fpreg >= 8, false, false));
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0x0F);
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0x6E);
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, modrm(3, fpreg, X86_RAX));
+}
+
+/* XMM register holding op: its home when it has one, else scratch after
+   loading it there. */
+static uint8_t fp_operand_in_reg(x86_compile_ctx_t *ctx,
+                                 const lr_operand_t *op, uint8_t scratch,
+                                 uint8_t fsize) {
+    if (op->kind == LR_VAL_VREG && vreg_xmm_home(ctx, op->vreg) != X86_NO_HOME)
+        return vreg_xmm_home(ctx, op->vreg);
+    emit_load_fp_operand(ctx, op, scratch, fsize);
+    return scratch;
 }
 
 typedef struct x86_fpagg_src {
@@ -924,12 +1253,43 @@ static size_t emit_prologue(x86_compile_ctx_t *ctx) {
     }
 }
 
-/* Emit epilogue: mov rsp, rbp; pop rbp; ret */
-static void emit_epilogue(x86_compile_ctx_t *ctx) {
+/* Tier-0 profiling: mov r11, counter; inc qword [r11]. */
+static void emit_profile_count(x86_compile_ctx_t *ctx) {
+    emit_mov_imm(ctx, X86_R11, (int64_t)(uintptr_t)ctx->loop_counter, false);
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, rex(true, false, false, true));
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0xFF);
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, modrm(0, 0, X86_R11 & 7));
+}
+
+/* Restore allocator registers; mov rsp, rbp; pop rbp */
+static void emit_frame_teardown(x86_compile_ctx_t *ctx) {
+    for (uint32_t i = 0; i < ctx->num_saved_regs; i++)
+        encode_mem(ctx->buf, &ctx->pos, ctx->buflen, 0x8B,
+                   ctx->saved_regs[i], X86_RBP, ctx->saved_reg_offs[i], 8);
+    if (ctx->num_epilogues >= ctx->epilogue_cap) {
+        uint32_t new_cap = ctx->epilogue_cap == 0 ? 4u : ctx->epilogue_cap * 2u;
+        size_t *np = lr_arena_array_uninit(ctx->arena, size_t, new_cap);
+        if (np) {
+            if (ctx->num_epilogues > 0)
+                memcpy(np, ctx->epilogue_pos,
+                       sizeof(size_t) * ctx->num_epilogues);
+            ctx->epilogue_pos = np;
+            ctx->epilogue_cap = new_cap;
+        }
+    }
+    if (ctx->num_epilogues < ctx->epilogue_cap)
+        ctx->epilogue_pos[ctx->num_epilogues++] = ctx->pos;
+    else
+        ctx->frame_pinned = true;
     emit_byte(ctx->buf, &ctx->pos, ctx->buflen, rex(true, false, false, false));
     emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0x89);
     emit_byte(ctx->buf, &ctx->pos, ctx->buflen, modrm(3, X86_RBP, X86_RSP)); /* mov rsp, rbp */
     emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0x5D); /* pop rbp */
+}
+
+/* Emit epilogue: frame teardown; ret */
+static void emit_epilogue(x86_compile_ctx_t *ctx) {
+    emit_frame_teardown(ctx);
     emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0xC3); /* ret */
 }
 
@@ -1066,6 +1426,121 @@ static void emit_sign_extend_value(x86_compile_ctx_t *ctx, uint8_t reg,
     }
 }
 
+/* shl/shr/sar (ext 4/5/7) of a 64-bit register by an immediate. */
+static void emit_shift_imm64(x86_compile_ctx_t *ctx, uint8_t ext, uint8_t reg,
+                             uint8_t imm) {
+    if (imm == 0)
+        return;
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, rex(true, false, false, reg >= 8));
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0xC1);
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, modrm(3, ext, reg));
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, imm);
+    invalidate_cached_reg(ctx, reg);
+}
+
+static void emit_neg64(x86_compile_ctx_t *ctx, uint8_t reg) {
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, rex(true, false, false, reg >= 8));
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0xF7);
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, modrm(3, 3, reg));
+    invalidate_cached_reg(ctx, reg);
+}
+
+/* sdiv/udiv/srem/urem of rax by a constant, following
+   lr_target_div_const_plan.  rax holds the dividend, already extended to
+   64 bits; it is kept in rcx for the fixup and remainder steps, rdx and
+   r11 are scratch.  Returns the register holding the result. */
+static uint8_t emit_div_const(x86_compile_ctx_t *ctx, bool is_signed,
+                              bool want_rem, const lr_div_const_t *plan) {
+    encode_alu_rr(ctx->buf, &ctx->pos, ctx->buflen, 0x89, X86_RCX, X86_RAX, 8);
+    switch (plan->kind) {
+    case LR_DIV_CONST_IDENT:
+        if (want_rem) {
+            emit_mov_imm(ctx, X86_RAX, 0, false);
+            invalidate_cached_reg(ctx, X86_RAX);
+            invalidate_cached_reg(ctx, X86_RCX);
+            return X86_RAX;
+        }
+        if (plan->negate)
+            emit_neg64(ctx, X86_RAX);
+        break;
+    case LR_DIV_CONST_POW2:
+        if (!is_signed) {
+            if (want_rem) {
+                emit_mov_imm(ctx, X86_R11, plan->divisor - 1, false);
+                encode_alu_rr(ctx->buf, &ctx->pos, ctx->buflen, 0x21,
+                              X86_RAX, X86_R11, 8);
+                invalidate_cached_reg(ctx, X86_RAX);
+                invalidate_cached_reg(ctx, X86_RCX);
+                invalidate_cached_reg(ctx, X86_R11);
+                return X86_RAX;
+            }
+            emit_shift_imm64(ctx, 5, X86_RAX, plan->shift);
+            break;
+        }
+        /* Bias negative dividends by 2^k - 1 so sar rounds toward zero. */
+        encode_alu_rr(ctx->buf, &ctx->pos, ctx->buflen, 0x89, X86_RDX, X86_RAX, 8);
+        emit_shift_imm64(ctx, 7, X86_RDX, 63);
+        emit_shift_imm64(ctx, 5, X86_RDX, (uint8_t)(64 - plan->shift));
+        encode_alu_rr(ctx->buf, &ctx->pos, ctx->buflen, 0x01, X86_RAX, X86_RDX, 8);
+        emit_shift_imm64(ctx, 7, X86_RAX, plan->shift);
+        if (plan->negate)
+            emit_neg64(ctx, X86_RAX);
+        break;
+    case LR_DIV_CONST_MAGIC:
+        emit_mov_imm(ctx, X86_R11, (int64_t)plan->magic, false);
+        /* mul r11 / imul r11: rdx = high half of rax * r11 */
+        emit_byte(ctx->buf, &ctx->pos, ctx->buflen, rex(true, false, false, true));
+        emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0xF7);
+        emit_byte(ctx->buf, &ctx->pos, ctx->buflen,
+                  modrm(3, is_signed ? 5 : 4, X86_R11));
+        if (!is_signed) {
+            if (plan->fixup) {
+                encode_alu_rr(ctx->buf, &ctx->pos, ctx->buflen, 0x89,
+                              X86_RAX, X86_RCX, 8);
+                encode_alu_rr(ctx->buf, &ctx->pos, ctx->buflen, 0x29,
+                              X86_RAX, X86_RDX, 8);
+                emit_shift_imm64(ctx, 5, X86_RAX, 1);
+                encode_alu_rr(ctx->buf, &ctx->pos, ctx->buflen, 0x01,
+                              X86_RAX, X86_RDX, 8);
+                emit_shift_imm64(ctx, 5, X86_RAX, (uint8_t)(plan->shift - 1));
+            } else {
+                encode_alu_rr(ctx->buf, &ctx->pos, ctx->buflen, 0x89,
+                              X86_RAX, X86_RDX, 8);
+                emit_shift_imm64(ctx, 5, X86_RAX, plan->shift);
+            }
+            break;
+        }
+        if (plan->fixup)
+            encode_alu_rr(ctx->buf, &ctx->pos, ctx->buflen,
+                          plan->fixup > 0 ? 0x01 : 0x29, X86_RDX, X86_RCX, 8);
+        emit_shift_imm64(ctx, 7, X86_RDX, plan->shift);
+        /* Round toward zero: add one when the quotient is negative. */
+        encode_alu_rr(ctx->buf, &ctx->pos, ctx->buflen, 0x89, X86_RAX, X86_RDX, 8);
+        emit_shift_imm64(ctx, 5, X86_RAX, 63);
+        encode_alu_rr(ctx->buf, &ctx->pos, ctx->buflen, 0x01, X86_RAX, X86_RDX, 8);
+        break;
+    }
+    invalidate_cached_reg(ctx, X86_RAX);
+    invalidate_cached_reg(ctx, X86_RCX);
+    invalidate_cached_reg(ctx, X86_RDX);
+    invalidate_cached_reg(ctx, X86_R11);
+    if (!want_rem)
+        return X86_RAX;
+    /* n - q * d */
+    if (plan->divisor >= INT32_MIN && plan->divisor <= INT32_MAX) {
+        emit_byte(ctx->buf, &ctx->pos, ctx->buflen, rex(true, false, false, false));
+        emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0x69);
+        emit_byte(ctx->buf, &ctx->pos, ctx->buflen, modrm(3, X86_RAX, X86_RAX));
+        emit_u32(ctx->buf, &ctx->pos, ctx->buflen, (uint32_t)(int32_t)plan->divisor);
+    } else {
+        emit_mov_imm(ctx, X86_R11, plan->divisor, false);
+        emit_imul_rr(ctx, X86_RAX, X86_R11, 8);
+    }
+    encode_alu_rr(ctx->buf, &ctx->pos, ctx->buflen, 0x29, X86_RCX, X86_RAX, 8);
+    invalidate_cached_reg(ctx, X86_RAX);
+    return X86_RCX;
+}
+
 /* Emit a movzx mem load for sub-dword sizes: movzx reg, byte/word [base+disp] */
 static void emit_movzx_mem(x86_compile_ctx_t *ctx, uint8_t dst, uint8_t base,
                             int32_t disp, uint8_t size) {
@@ -1230,6 +1705,21 @@ static void emit_phi_copy_value(x86_compile_ctx_t *cc,
     if (!cc || !src_op)
         return;
     if (dst_sz <= 8) {
+        uint8_t home = vreg_home_reg(cc, dest_vreg);
+        uint8_t xmm = vreg_xmm_home(cc, dest_vreg);
+        /* A register destination is written in place: one move, or a
+           constant materialized straight into it. */
+        if (home != X86_NO_HOME || xmm != X86_NO_HOME) {
+            if (cached_reg_holds_vreg(cc, X86_RAX, dest_vreg))
+                invalidate_cached_reg(cc, X86_RAX);
+            if (cached_reg_holds_vreg(cc, X86_RCX, dest_vreg))
+                invalidate_cached_reg(cc, X86_RCX);
+            if (home != X86_NO_HOME)
+                emit_load_operand(cc, src_op, home);
+            else
+                emit_load_fp_operand(cc, src_op, xmm, 8);
+            return;
+        }
         emit_load_operand(cc, src_op, X86_RAX);
         emit_store_slot(cc, dest_vreg, X86_RAX);
         return;
@@ -1251,20 +1741,72 @@ static void emit_phi_copy_value(x86_compile_ctx_t *cc,
     emit_mem_zero_base(cc, X86_RBP, dst_off + 8, dst_sz - 8);
 }
 
+static x86_fixup_t *new_fixup(x86_compile_ctx_t *ctx, size_t pos,
+                              uint8_t kind) {
+    x86_fixup_t *f;
+    if (ctx->num_fixups >= ctx->fixup_cap) {
+        uint32_t new_cap = ctx->fixup_cap == 0 ? 16u : ctx->fixup_cap * 2u;
+        x86_fixup_t *nf = lr_arena_array_uninit(ctx->arena, x86_fixup_t,
+                                                new_cap);
+        if (!nf) {
+            ctx->fixups_lost = true;
+            return NULL;
+        }
+        if (ctx->fixup_cap > 0)
+            memcpy(nf, ctx->fixups, sizeof(x86_fixup_t) * ctx->fixup_cap);
+        ctx->fixups = nf;
+        ctx->fixup_cap = new_cap;
+    }
+    f = &ctx->fixups[ctx->num_fixups++];
+    f->pos = pos;
+    f->target_pos_hint = SIZE_MAX;
+    f->base = 0;
+    f->target = UINT32_MAX;
+    f->source = UINT32_MAX;
+    f->kind = kind;
+    return f;
+}
+
+/* Record a rel32 at pos (ending the branch instruction) to be resolved
+   against target_block in compile_end. */
+static void add_branch_fixup(x86_compile_ctx_t *ctx, size_t pos,
+                             uint32_t target_block, uint32_t source_block,
+                             uint8_t kind) {
+    x86_fixup_t *f = new_fixup(ctx, pos, kind);
+    if (!f)
+        return;
+    if (target_block < ctx->num_block_offsets)
+        f->target_pos_hint = ctx->block_entry_offsets[target_block];
+    f->target = target_block;
+    f->source = source_block;
+}
+
+/* Record a rel32 at pos against the code offset target_pos. */
+static void add_pos_fixup(x86_compile_ctx_t *ctx, size_t pos,
+                          size_t target_pos, uint8_t kind) {
+    x86_fixup_t *f = new_fixup(ctx, pos, kind);
+    if (f)
+        f->target_pos_hint = target_pos;
+}
+
+/* Kind of a stencil's branch hole at pos: relaxable when it ends a plain
+   jmp or jcc rel32 at end. */
+static uint8_t stencil_branch_kind(const x86_compile_ctx_t *ctx, size_t pos,
+                                   size_t end) {
+    if (pos + 4 != end || end > ctx->buflen || pos < 2)
+        return X86_FIXUP_REL32;
+    if (ctx->buf[pos - 1] == 0xE9)
+        return X86_FIXUP_JMP;
+    if (ctx->buf[pos - 2] == 0x0F && (ctx->buf[pos - 1] & 0xF0) == 0x80)
+        return X86_FIXUP_JCC;
+    return X86_FIXUP_REL32;
+}
+
 static void emit_jmp_sourced(x86_compile_ctx_t *ctx, uint32_t target_block,
                              uint32_t source_block) {
     emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0xE9);
-    if (ctx->num_fixups < ctx->fixup_cap) {
-        ctx->fixups[ctx->num_fixups].pos = ctx->pos;
-        if (target_block < ctx->num_block_offsets)
-            ctx->fixups[ctx->num_fixups].target_pos_hint =
-                ctx->block_entry_offsets[target_block];
-        else
-            ctx->fixups[ctx->num_fixups].target_pos_hint = SIZE_MAX;
-        ctx->fixups[ctx->num_fixups].target = target_block;
-        ctx->fixups[ctx->num_fixups].source = source_block;
-        ctx->num_fixups++;
-    }
+    add_branch_fixup(ctx, ctx->pos, target_block, source_block,
+                     X86_FIXUP_JMP);
     emit_u32(ctx->buf, &ctx->pos, ctx->buflen, 0);
 }
 
@@ -1273,12 +1815,64 @@ static void emit_jmp(x86_compile_ctx_t *ctx, uint32_t target_block) {
 }
 
 static void emit_call_r10(x86_compile_ctx_t *ctx) {
+    ctx->frame_pinned = true;
     emit_byte(ctx->buf, &ctx->pos, ctx->buflen, rex(false, false, false, true));
     emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0xFF);
     emit_byte(ctx->buf, &ctx->pos, ctx->buflen, modrm(3, 2, X86_R10));
 }
 
+/* Object symbol of a direct callee, or UINT32_MAX when the callee needs
+   an indirect call. */
+static uint32_t x86_callee_symbol(x86_compile_ctx_t *ctx,
+                                  const lr_operand_t *op) {
+    const char *sym_name;
+    if (op->kind != LR_VAL_GLOBAL || op->global_offset != 0 ||
+        !ctx->obj_ctx || !ctx->mod)
+        return UINT32_MAX;
+    sym_name = lr_module_symbol_name(ctx->mod, op->global_id);
+    if (!sym_name)
+        return UINT32_MAX;
+    return lr_obj_ensure_symbol(ctx->obj_ctx, sym_name, false, 0, 0);
+}
+
+/* "call rel32" to a global through a PLT32 relocation; the JIT sends
+   callees out of rel32 reach through a stub.  Returns false when the
+   callee needs an indirect call. */
+static bool emit_call_global(x86_compile_ctx_t *ctx,
+                             const lr_operand_t *op) {
+    uint32_t sym_idx = x86_callee_symbol(ctx, op);
+    if (sym_idx == UINT32_MAX)
+        return false;
+    ctx->frame_pinned = true;
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0xE8);
+    lr_obj_add_reloc(ctx->obj_ctx, (uint32_t)ctx->pos, sym_idx,
+                     LR_RELOC_X86_64_PLT32);
+    emit_u32(ctx->buf, &ctx->pos, ctx->buflen, 0);
+    return true;
+}
+
+/* Tail call: tear the frame down and jump, so the callee returns straight
+   to our caller.  "jmp rel32" takes the same PLT32 relocation (and JIT
+   stub) as a call; other callees go through R10. */
+static void emit_tail_jump(x86_compile_ctx_t *ctx, const lr_operand_t *op) {
+    uint32_t sym_idx = x86_callee_symbol(ctx, op);
+    if (sym_idx == UINT32_MAX)
+        emit_load_operand(ctx, op, X86_R10);
+    emit_frame_teardown(ctx);
+    if (sym_idx != UINT32_MAX) {
+        emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0xE9);
+        lr_obj_add_reloc(ctx->obj_ctx, (uint32_t)ctx->pos, sym_idx,
+                         LR_RELOC_X86_64_PLT32);
+        emit_u32(ctx->buf, &ctx->pos, ctx->buflen, 0);
+        return;
+    }
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, rex(false, false, false, true));
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0xFF);
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, modrm(3, 4, X86_R10));
+}
+
 static void emit_frame_alloc(x86_compile_ctx_t *ctx, uint32_t bytes) {
+    ctx->frame_pinned = true;
     emit_byte(ctx->buf, &ctx->pos, ctx->buflen, rex(true, false, false, false));
     emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0x81);
     emit_byte(ctx->buf, &ctx->pos, ctx->buflen, modrm(3, 5, X86_RSP));
@@ -1304,6 +1898,9 @@ static void emit_fcmp(x86_compile_ctx_t *ctx, uint8_t dst, uint8_t src, uint8_t
     if (fsize == 8) {
         encode_sse_rr(ctx->buf, &ctx->pos, ctx->buflen, 0x66, 0x2E, 0, dst, src);
     } else {
+        if (dst >= 8 || src >= 8)
+            emit_byte(ctx->buf, &ctx->pos, ctx->buflen,
+                      rex(false, dst >= 8, false, src >= 8));
         emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0x0F);
         emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0x2E);
         emit_byte(ctx->buf, &ctx->pos, ctx->buflen, modrm(3, dst, src));
@@ -1412,6 +2009,260 @@ static void emit_cmovcc(x86_compile_ctx_t *ctx, uint8_t cc, uint8_t dst,
     invalidate_cached_reg(ctx, dst);
 }
 
+/* ---- Inline integer intrinsics ---- */
+
+/* [prefix] [REX] 0F op /r with both operands registers. */
+static void emit_0f_rr(x86_compile_ctx_t *ctx, uint8_t prefix, uint8_t op,
+                       uint8_t reg, uint8_t rm, uint8_t size) {
+    if (prefix)
+        emit_byte(ctx->buf, &ctx->pos, ctx->buflen, prefix);
+    if (size == 8 || reg >= 8 || rm >= 8)
+        emit_byte(ctx->buf, &ctx->pos, ctx->buflen,
+                  rex(size == 8, reg >= 8, false, rm >= 8));
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, 0x0F);
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, op);
+    emit_byte(ctx->buf, &ctx->pos, ctx->buflen, modrm(3, reg, rm));
+}
+
+/* llvm.fma / llvm.fmuladd as vfmadd213ss/sd (a = a * b + c) when the code
+   may use FMA3; otherwise the caller emits the libm-backed call. */
+static bool x86_emit_fp_intrinsic(x86_compile_ctx_t *cc,
+                                  lr_fp_intrinsic_t kind, uint8_t bits,
+                                  const lr_operand_t *ops, uint32_t nops,
+                                  uint32_t dest) {
+    uint8_t fsize = bits == 64 ? 8 : 4;
+    if (kind != LR_FP_INTRIN_FMA || nops < 4 ||
+        !(cc->cpu_features & LR_CPU_X86_FMA))
+        return false;
+    emit_load_fp_operand(cc, &ops[1], X86_XMM0, fsize);
+    emit_load_fp_operand(cc, &ops[2], X86_XMM1, fsize);
+    emit_load_fp_operand(cc, &ops[3], X86_XMM2, fsize);
+    encode_vex_rr(cc->buf, &cc->pos, cc->buflen, 2, 1, fsize == 8, false,
+                  0xA9, X86_XMM0, X86_XMM1, X86_XMM2);
+    emit_store_fp_slot(cc, dest, X86_XMM0, fsize);
+    return true;
+}
+
+/* Expand a min/max/abs/count/funnel-shift intrinsic call in place of the
+   platform_intrinsics.c helper.  Returns false (emitting nothing) when the
+   width or CPU has no sequence here, so the caller emits the real call.
+   ctlz/cttz without lzcnt/tzcnt use bsr/bsf plus a cmov for zero. */
+static bool x86_emit_int_intrinsic(x86_compile_ctx_t *cc,
+                                   lr_int_intrinsic_t kind, uint8_t bits,
+                                   const lr_operand_t *ops, uint32_t nops,
+                                   const lr_type_t *ret_type, uint32_t dest) {
+    uint32_t feats = cc->cpu_features;
+    uint8_t sz = bits == 64 ? 8 : 4;
+    bool narrow = bits < 32;
+
+    if (nops < 2)
+        return false;
+    switch (kind) {
+    case LR_INT_INTRIN_UMAX: case LR_INT_INTRIN_UMIN:
+    case LR_INT_INTRIN_SMAX: case LR_INT_INTRIN_SMIN: {
+        uint8_t take_b;
+        bool is_signed = kind == LR_INT_INTRIN_SMAX ||
+                         kind == LR_INT_INTRIN_SMIN;
+        if (nops < 3)
+            return false;
+        switch (kind) {
+        case LR_INT_INTRIN_UMAX: take_b = LR_CC_ULT; break;
+        case LR_INT_INTRIN_UMIN: take_b = LR_CC_UGT; break;
+        case LR_INT_INTRIN_SMAX: take_b = LR_CC_SLT; break;
+        default:                 take_b = LR_CC_SGT; break;
+        }
+        emit_load_operand(cc, &ops[1], X86_RAX);
+        emit_load_operand(cc, &ops[2], X86_RCX);
+        if (narrow) {
+            /* Compare sub-word values extended to 64 bits. */
+            if (is_signed) {
+                emit_movsx_rr(cc, X86_RAX, X86_RAX, bits / 8);
+                emit_movsx_rr(cc, X86_RCX, X86_RCX, bits / 8);
+            } else {
+                emit_movzx_rr(cc, X86_RAX, X86_RAX, bits / 8);
+                emit_movzx_rr(cc, X86_RCX, X86_RCX, bits / 8);
+            }
+            sz = 8;
+        }
+        encode_alu_rr(cc->buf, &cc->pos, cc->buflen, 0x39, X86_RAX, X86_RCX, sz);
+        emit_cmovcc(cc, take_b, X86_RAX, X86_RCX, sz);
+        break;
+    }
+    case LR_INT_INTRIN_ABS:
+        /* mov rcx, rax; neg rcx; test rax, rax; cmovl rax, rcx */
+        emit_load_operand(cc, &ops[1], X86_RAX);
+        if (narrow) {
+            emit_movsx_rr(cc, X86_RAX, X86_RAX, bits / 8);
+            sz = 8;
+        }
+        encode_alu_rr(cc->buf, &cc->pos, cc->buflen, 0x89, X86_RCX, X86_RAX, sz);
+        if (sz == 8)
+            emit_byte(cc->buf, &cc->pos, cc->buflen, rex(true, false, false, false));
+        emit_byte(cc->buf, &cc->pos, cc->buflen, 0xF7);
+        emit_byte(cc->buf, &cc->pos, cc->buflen, modrm(3, 3, X86_RCX));
+        encode_alu_rr(cc->buf, &cc->pos, cc->buflen, 0x85, X86_RAX, X86_RAX, sz);
+        emit_cmovcc(cc, LR_CC_SLT, X86_RAX, X86_RCX, sz);
+        break;
+    case LR_INT_INTRIN_CTPOP:
+        if (!(feats & LR_CPU_X86_POPCNT))
+            return false;
+        emit_load_operand(cc, &ops[1], X86_RAX);
+        if (narrow)
+            emit_movzx_rr(cc, X86_RAX, X86_RAX, bits == 8 ? 1 : 2);
+        emit_0f_rr(cc, 0xF3, 0xB8, X86_RAX, X86_RAX, sz);
+        break;
+    case LR_INT_INTRIN_CTLZ:
+        emit_load_operand(cc, &ops[1], X86_RAX);
+        if (narrow)
+            emit_movzx_rr(cc, X86_RAX, X86_RAX, bits == 8 ? 1 : 2);
+        if (feats & LR_CPU_X86_LZCNT) {
+            emit_0f_rr(cc, 0xF3, 0xBD, X86_RAX, X86_RAX, sz);
+        } else {
+            /* bsr leaves ZF set for zero; 2W-1 xor (W-1) yields W. */
+            emit_mov_imm(cc, X86_RCX, sz * 16 - 1, false);
+            emit_0f_rr(cc, 0, 0xBD, X86_RAX, X86_RAX, sz);
+            emit_cmovcc(cc, LR_CC_EQ, X86_RAX, X86_RCX, sz);
+            emit_byte(cc->buf, &cc->pos, cc->buflen, 0x83); /* xor eax, W-1 */
+            emit_byte(cc->buf, &cc->pos, cc->buflen, modrm(3, 6, X86_RAX));
+            emit_byte(cc->buf, &cc->pos, cc->buflen, (uint8_t)(sz * 8 - 1));
+        }
+        if (narrow) {
+            emit_byte(cc->buf, &cc->pos, cc->buflen, 0x83); /* sub eax, 32-bits */
+            emit_byte(cc->buf, &cc->pos, cc->buflen, modrm(3, 5, X86_RAX));
+            emit_byte(cc->buf, &cc->pos, cc->buflen, (uint8_t)(32 - bits));
+        }
+        break;
+    case LR_INT_INTRIN_CTTZ:
+        emit_load_operand(cc, &ops[1], X86_RAX);
+        if (narrow) {
+            /* or eax, 1 << bits: a guard bit caps the count at the width. */
+            emit_byte(cc->buf, &cc->pos, cc->buflen, 0x0D);
+            emit_u32(cc->buf, &cc->pos, cc->buflen, 1u << bits);
+        }
+        if (feats & LR_CPU_X86_BMI1) {
+            emit_0f_rr(cc, 0xF3, 0xBC, X86_RAX, X86_RAX, sz);
+        } else {
+            emit_mov_imm(cc, X86_RCX, sz * 8, false);
+            emit_0f_rr(cc, 0, 0xBC, X86_RAX, X86_RAX, sz);
+            emit_cmovcc(cc, LR_CC_EQ, X86_RAX, X86_RCX, sz);
+        }
+        break;
+    case LR_INT_INTRIN_FSHL:
+    case LR_INT_INTRIN_FSHR:
+        if (nops < 4)
+            return false;
+        emit_load_operand(cc, &ops[1], X86_RAX);
+        emit_load_operand(cc, &ops[2], X86_RDX);
+        emit_load_operand(cc, &ops[3], X86_RCX);
+        if (narrow) {
+            /* eax = a:b, then shift the concatenation by s modulo the width
+               and keep the high (fshl) or low (fshr) half. */
+            emit_movzx_rr(cc, X86_RAX, X86_RAX, bits / 8);
+            emit_movzx_rr(cc, X86_RDX, X86_RDX, bits / 8);
+            emit_byte(cc->buf, &cc->pos, cc->buflen, 0xC1);          /* shl eax, bits */
+            emit_byte(cc->buf, &cc->pos, cc->buflen, modrm(3, 4, X86_RAX));
+            emit_byte(cc->buf, &cc->pos, cc->buflen, bits);
+            encode_alu_rr(cc->buf, &cc->pos, cc->buflen, 0x09, X86_RAX, X86_RDX, 4);
+            emit_byte(cc->buf, &cc->pos, cc->buflen, 0x83);          /* and ecx, bits-1 */
+            emit_byte(cc->buf, &cc->pos, cc->buflen, modrm(3, 4, X86_RCX));
+            emit_byte(cc->buf, &cc->pos, cc->buflen, (uint8_t)(bits - 1));
+            if (kind == LR_INT_INTRIN_FSHL) {
+                emit_shift(cc, 4, X86_RAX, 4);
+                emit_byte(cc->buf, &cc->pos, cc->buflen, 0xC1);      /* shr eax, bits */
+                emit_byte(cc->buf, &cc->pos, cc->buflen, modrm(3, 5, X86_RAX));
+                emit_byte(cc->buf, &cc->pos, cc->buflen, bits);
+            } else {
+                emit_shift(cc, 5, X86_RAX, 4);
+                emit_movzx_rr(cc, X86_RAX, X86_RAX, bits / 8);
+            }
+            break;
+        }
+        /* shld/shrd mask cl to the operand width, as fshl/fshr require. */
+        if (kind == LR_INT_INTRIN_FSHL) {
+            emit_0f_rr(cc, 0, 0xA5, X86_RDX, X86_RAX, sz); /* shld rax, rdx, cl */
+        } else {
+            emit_0f_rr(cc, 0, 0xAD, X86_RAX, X86_RDX, sz); /* shrd rdx, rax, cl */
+            encode_alu_rr(cc->buf, &cc->pos, cc->buflen, 0x89, X86_RAX, X86_RDX, 8);
+        }
+        break;
+    default:
+        return false;
+    }
+    invalidate_cached_gprs(cc);
+    if (ret_type && ret_type->kind != LR_TYPE_VOID)
+        emit_store_slot(cc, dest, X86_RAX);
+    return true;
+}
+
+/* Expand a constant-length llvm.memcpy/llvm.memset accepted by
+   lr_target_mem_inline_plan.  Lengths of 16 and up move 16-byte movdqu
+   chunks through XMM0 and finish with one overlapping chunk ending at len;
+   shorter lengths use 8/4/2/1-byte GPR moves. */
+static void x86_emit_mem_intrinsic(x86_compile_ctx_t *cc,
+                                   lr_mem_intrinsic_t kind,
+                                   const lr_operand_t *ops, uint32_t len) {
+    uint32_t off;
+    if (len == 0)
+        return;
+    emit_load_operand(cc, &ops[1], X86_RAX);
+    if (kind == LR_MEM_INTRIN_MEMCPY) {
+        emit_load_operand(cc, &ops[2], X86_RCX);
+        if (len < 16) {
+            emit_mem_copy_base_to_base(cc, X86_RAX, 0, X86_RCX, 0, len);
+        } else {
+            for (off = 0; off + 16 <= len; off += 16) {
+                encode_sse_mem(cc->buf, &cc->pos, cc->buflen, 0xF3, 0x6F, 0,
+                               X86_XMM0, X86_RCX, (int32_t)off);
+                encode_sse_mem(cc->buf, &cc->pos, cc->buflen, 0xF3, 0x7F, 0,
+                               X86_XMM0, X86_RAX, (int32_t)off);
+            }
+            if (off < len) {
+                encode_sse_mem(cc->buf, &cc->pos, cc->buflen, 0xF3, 0x6F, 0,
+                               X86_XMM0, X86_RCX, (int32_t)(len - 16));
+                encode_sse_mem(cc->buf, &cc->pos, cc->buflen, 0xF3, 0x7F, 0,
+                               X86_XMM0, X86_RAX, (int32_t)(len - 16));
+            }
+        }
+        invalidate_cached_gprs(cc);
+        return;
+    }
+
+    /* rdx = fill byte replicated into all eight bytes */
+    if (ops[2].kind == LR_VAL_IMM_I64) {
+        uint64_t fill = (uint64_t)(uint8_t)ops[2].imm_i64 * 0x0101010101010101ULL;
+        emit_mov_imm(cc, X86_RDX, (int64_t)fill, false);
+    } else {
+        emit_load_operand(cc, &ops[2], X86_RDX);
+        emit_movzx_rr(cc, X86_RDX, X86_RDX, 1);
+        emit_mov_imm(cc, X86_R11, 0x0101010101010101LL, false);
+        emit_imul_rr(cc, X86_RDX, X86_R11, 8);
+    }
+    if (len < 16) {
+        for (off = 0; off < len;) {
+            uint8_t chunk = len - off >= 8 ? 8 : len - off >= 4 ? 4 :
+                            len - off >= 2 ? 2 : 1;
+            emit_mem_store_sized(cc, X86_RDX, X86_RAX, (int32_t)off, chunk);
+            off += chunk;
+        }
+    } else {
+        /* movq xmm0, rdx; punpcklqdq xmm0, xmm0 */
+        emit_byte(cc->buf, &cc->pos, cc->buflen, 0x66);
+        emit_byte(cc->buf, &cc->pos, cc->buflen, rex(true, false, false, false));
+        emit_byte(cc->buf, &cc->pos, cc->buflen, 0x0F);
+        emit_byte(cc->buf, &cc->pos, cc->buflen, 0x6E);
+        emit_byte(cc->buf, &cc->pos, cc->buflen, modrm(3, X86_XMM0, X86_RDX));
+        encode_sse_rr(cc->buf, &cc->pos, cc->buflen, 0x66, 0x6C, 0,
+                      X86_XMM0, X86_XMM0);
+        for (off = 0; off + 16 <= len; off += 16)
+            encode_sse_mem(cc->buf, &cc->pos, cc->buflen, 0xF3, 0x7F, 0,
+                           X86_XMM0, X86_RAX, (int32_t)off);
+        if (off < len)
+            encode_sse_mem(cc->buf, &cc->pos, cc->buflen, 0xF3, 0x7F, 0,
+                           X86_XMM0, X86_RAX, (int32_t)(len - 16));
+    }
+    invalidate_cached_gprs(cc);
+}
+
 /* ---- Streaming direct-emission ISel ------------------------------------ */
 
 typedef struct x86_stream_phi_copy {
@@ -1432,6 +2283,7 @@ typedef struct x86_deferred_term {
     lr_operand_t ops[4];
     uint32_t num_ops;
     uint32_t block_id;
+    lr_operand_t *switch_ops;   /* LR_OP_SWITCH: arena copy of all operands */
 } x86_deferred_term_t;
 
 typedef struct x86_direct_ctx {
@@ -1447,6 +2299,40 @@ typedef struct x86_direct_ctx {
     uint32_t phi_copy_count;
     uint32_t phi_copy_cap;
     x86_deferred_term_t deferred;
+    /* Copy-patch add+ret supernode: the last integer binop emitted as a
+       stencil, re-emitted through ISel when the next instruction returns
+       it so the value stays in RAX. */
+    lr_compile_inst_desc_t cp_last_desc;
+    lr_operand_desc_t cp_last_ops[2];
+    size_t cp_last_start;
+    size_t cp_last_end;
+    bool cp_last_valid;
+    /* First of the lane vregs used to scalarize vector instructions
+       (three operands and a result); 0 until first needed. */
+    uint32_t vec_lane_vregs;
+    /* Flags set by the last ISel icmp.  They still hold while nothing has
+       been emitted after it in the same block, so a condbr or select on
+       flags_vreg can jcc/cmov on flags_cc directly.  The setcc and store
+       start at flags_cmp_end and are dropped when the select or branch is
+       the only use. */
+    bool flags_valid;
+    uint8_t flags_cc;
+    uint32_t flags_vreg;
+    uint32_t flags_block_id;
+    size_t flags_cmp_end;
+    size_t flags_end;
+    /* Likewise for the last GEP lowered to a single lea: its operands are
+       in place at addr_ready, and a load or store that is the result's
+       only use addresses addr_mem directly instead. */
+    bool addr_valid;
+    uint32_t addr_vreg;
+    uint32_t addr_block_id;
+    size_t addr_ready;
+    size_t addr_end;
+    x86_addr_t addr_mem;
+    /* The last call left the frame with a jump; the return that follows
+       it emits nothing. */
+    bool tail_jumped;
 } x86_direct_ctx_t;
 
 static lr_operand_t operand_from_desc(const lr_operand_desc_t *desc) {
@@ -1492,21 +2378,6 @@ static void direct_note_vregs(x86_direct_ctx_t *ctx,
     }
 }
 
-static int direct_ensure_fixup_cap(x86_direct_ctx_t *ctx) {
-    x86_compile_ctx_t *cc = &ctx->cc;
-    if (cc->num_fixups < cc->fixup_cap)
-        return 0;
-    uint32_t new_cap = cc->fixup_cap == 0 ? 16u : cc->fixup_cap * 2u;
-    x86_fixup_t *nf = lr_arena_array_uninit(cc->arena, x86_fixup_t, new_cap);
-    if (!nf)
-        return -1;
-    if (cc->fixup_cap > 0)
-        memcpy(nf, cc->fixups, sizeof(x86_fixup_t) * cc->fixup_cap);
-    cc->fixups = nf;
-    cc->fixup_cap = new_cap;
-    return 0;
-}
-
 static int direct_ensure_block_offsets(x86_direct_ctx_t *ctx,
                                        uint32_t block_id) {
     x86_compile_ctx_t *cc = &ctx->cc;
@@ -1564,26 +2435,106 @@ static bool direct_phi_copy_matches_edge(const x86_stream_phi_copy_t *copy,
     return true;
 }
 
-static void direct_emit_phi_copies_for_edge(x86_direct_ctx_t *ctx,
-                                            uint32_t pred,
-                                            uint32_t succ,
-                                            bool only_unemitted) {
+static bool direct_edge_has_phi_copies(const x86_direct_ctx_t *ctx,
+                                       uint32_t pred, uint32_t succ) {
+    for (uint32_t i = 0; i < ctx->phi_copy_count; i++) {
+        if (direct_phi_copy_matches_edge(&ctx->phi_copies[i], pred, succ,
+                                         false))
+            return true;
+    }
+    return false;
+}
+
+/* Scalar edges: move each value once, in an order that never clobbers a
+   pending source, with R11 holding the one value a swap cycle needs.
+   False (nothing emitted) when some copy is wider than a GPR. */
+static bool direct_emit_phi_copies_sequenced(x86_direct_ctx_t *ctx,
+                                             uint32_t pred,
+                                             uint32_t succ,
+                                             bool only_unemitted) {
     x86_compile_ctx_t *cc = &ctx->cc;
-    uint32_t stage_base = ctx->next_vreg;
-    uint32_t staged = 0;
+    uint32_t *idx, *dests;
+    lr_operand_t *srcs;
+    lr_pcopy_step_t *steps;
+    uint32_t n = 0;
+    int num_steps;
 
-    /* PHI inputs are parallel: stage sources first, then write destinations. */
     for (uint32_t i = 0; i < ctx->phi_copy_count; i++) {
-        size_t dst_sz;
-        int32_t tmp_off;
-        uint32_t tmp_vreg;
-        const lr_operand_t *src_op;
-
         if (!direct_phi_copy_matches_edge(&ctx->phi_copies[i], pred, succ,
                                           only_unemitted))
             continue;
-
-        src_op = &ctx->phi_copies[i].src_op;
+        if (vreg_slot_size(cc, ctx->phi_copies[i].dest_vreg) > 8)
+            return false;
+        n++;
+    }
+    if (n == 0)
+        return true;
+    idx = lr_arena_array_uninit(cc->arena, uint32_t, n);
+    dests = lr_arena_array_uninit(cc->arena, uint32_t, n);
+    srcs = lr_arena_array_uninit(cc->arena, lr_operand_t, n);
+    steps = lr_arena_array_uninit(cc->arena, lr_pcopy_step_t, 2u * n);
+    if (!idx || !dests || !srcs || !steps)
+        return false;
+    n = 0;
+    for (uint32_t i = 0; i < ctx->phi_copy_count; i++) {
+        if (!direct_phi_copy_matches_edge(&ctx->phi_copies[i], pred, succ,
+                                          only_unemitted))
+            continue;
+        idx[n] = i;
+        dests[n] = ctx->phi_copies[i].dest_vreg;
+        srcs[n] = ctx->phi_copies[i].src_op;
+        n++;
+    }
+    num_steps = lr_target_sequence_parallel_copies(dests, srcs, n, cc->arena,
+                                                   steps);
+    if (num_steps < 0)
+        return false;
+
+    for (int s = 0; s < num_steps; s++) {
+        uint32_t k = steps[s].index;
+        switch (steps[s].kind) {
+        case LR_PCOPY_SAVE:
+            emit_load_slot(cc, dests[k], X86_R11);
+            break;
+        case LR_PCOPY_RESTORE:
+            emit_store_slot(cc, dests[k], X86_R11);
+            break;
+        default:
+            emit_phi_copy_value(cc, dests[k], &srcs[k]);
+            break;
+        }
+    }
+    /* A destination may have been cached before it was overwritten. */
+    invalidate_cached_gprs(cc);
+    for (uint32_t i = 0; i < n; i++)
+        ctx->phi_copies[idx[i]].emitted = true;
+    return true;
+}
+
+static void direct_emit_phi_copies_for_edge(x86_direct_ctx_t *ctx,
+                                            uint32_t pred,
+                                            uint32_t succ,
+                                            bool only_unemitted) {
+    x86_compile_ctx_t *cc = &ctx->cc;
+    uint32_t stage_base = ctx->next_vreg;
+    uint32_t staged = 0;
+
+    if (direct_emit_phi_copies_sequenced(ctx, pred, succ, only_unemitted))
+        return;
+
+    /* Aggregate and vector PHIs: stage every source in a fresh slot
+       first, then write the destinations. */
+    for (uint32_t i = 0; i < ctx->phi_copy_count; i++) {
+        size_t dst_sz;
+        int32_t tmp_off;
+        uint32_t tmp_vreg;
+        const lr_operand_t *src_op;
+
+        if (!direct_phi_copy_matches_edge(&ctx->phi_copies[i], pred, succ,
+                                          only_unemitted))
+            continue;
+
+        src_op = &ctx->phi_copies[i].src_op;
         dst_sz = vreg_slot_size(cc, ctx->phi_copies[i].dest_vreg);
         if (dst_sz < 8)
             dst_sz = 8;
@@ -1601,6 +2552,12 @@ static void direct_emit_phi_copies_for_edge(x86_direct_ctx_t *ctx,
         } else if (src_op->kind == LR_VAL_UNDEF ||
                    src_op->kind == LR_VAL_NULL) {
             emit_mem_zero_base(cc, X86_RBP, tmp_off, dst_sz);
+        } else if (src_op->kind == LR_VAL_GLOBAL &&
+                   src_op->type && src_op->type->kind == LR_TYPE_VECTOR) {
+            /* Wide constant vector incoming: copy from its pool global. */
+            emit_load_operand(cc, src_op, X86_RAX);
+            emit_mem_copy_base_to_base(cc, X86_RBP, tmp_off, X86_RAX, 0,
+                                       dst_sz);
         } else {
             emit_load_operand(cc, src_op, X86_RAX);
             emit_mem_store_sized(cc, X86_RAX, X86_RBP, tmp_off, 8);
@@ -1628,10 +2585,416 @@ static void direct_emit_phi_copies_for_edge(x86_direct_ctx_t *ctx,
     }
 }
 
+/* ---- Switch lowering ---- */
+
+typedef struct x86_switch_patch {
+    size_t pos;     /* rel32 displacement to patch */
+    uint32_t dest;  /* lr_switch_plan_t dest index */
+    uint8_t kind;   /* X86_FIXUP_JMP or X86_FIXUP_JCC */
+} x86_switch_patch_t;
+
+/* cmp/sub rax, imm for a zero-extended case value; values outside the
+   sign-extended imm32 range go through RCX. */
+static void x86_switch_alu_imm(x86_compile_ctx_t *cc, uint8_t ext,
+                               uint64_t value) {
+    if (value <= 0x7FFFFFFFu || value >= UINT64_C(0xFFFFFFFF80000000)) {
+        int32_t imm = (int32_t)(uint32_t)value;
+        emit_byte(cc->buf, &cc->pos, cc->buflen, rex(true, false, false, false));
+        if (imm >= -128 && imm <= 127) {
+            emit_byte(cc->buf, &cc->pos, cc->buflen, 0x83);
+            emit_byte(cc->buf, &cc->pos, cc->buflen, modrm(3, ext, X86_RAX));
+            emit_byte(cc->buf, &cc->pos, cc->buflen, (uint8_t)(int8_t)imm);
+        } else {
+            emit_byte(cc->buf, &cc->pos, cc->buflen, 0x81);
+            emit_byte(cc->buf, &cc->pos, cc->buflen, modrm(3, ext, X86_RAX));
+            emit_u32(cc->buf, &cc->pos, cc->buflen, (uint32_t)imm);
+        }
+        return;
+    }
+    emit_mov_imm(cc, X86_RCX, (int64_t)value, false);
+    encode_alu_rr(cc->buf, &cc->pos, cc->buflen,
+                  ext == 5 ? 0x29 : 0x39, X86_RAX, X86_RCX, 8);
+}
+
+/* jcc/jmp rel32 to a switch landing pad, patched once pads are placed. */
+static void x86_switch_branch(x86_compile_ctx_t *cc, int x86cc,
+                              x86_switch_patch_t *patches, uint32_t *npatches,
+                              uint32_t dest) {
+    if (x86cc < 0) {
+        emit_byte(cc->buf, &cc->pos, cc->buflen, 0xE9);
+    } else {
+        emit_byte(cc->buf, &cc->pos, cc->buflen, 0x0F);
+        emit_byte(cc->buf, &cc->pos, cc->buflen, (uint8_t)(0x80 + x86cc));
+    }
+    patches[*npatches].pos = cc->pos;
+    patches[*npatches].dest = dest;
+    patches[*npatches].kind = x86cc < 0 ? X86_FIXUP_JMP : X86_FIXUP_JCC;
+    (*npatches)++;
+    emit_u32(cc->buf, &cc->pos, cc->buflen, 0);
+}
+
+/* Balanced binary search over sorted cases [lo, hi); short runs become a
+   linear compare chain ending in a jump to the default pad. */
+static void x86_switch_emit_tree(x86_compile_ctx_t *cc,
+                                 const lr_switch_plan_t *plan,
+                                 uint32_t lo, uint32_t hi,
+                                 x86_switch_patch_t *patches,
+                                 uint32_t *npatches) {
+    if (hi - lo <= 3) {
+        for (uint32_t i = lo; i < hi; i++) {
+            x86_switch_alu_imm(cc, 7, plan->cases[i].value);
+            x86_switch_branch(cc, X86_CC_E, patches, npatches,
+                              plan->cases[i].dest);
+        }
+        x86_switch_branch(cc, -1, patches, npatches, 0);
+        return;
+    }
+    uint32_t mid = lo + (hi - lo) / 2u;
+    size_t left_disp;
+    x86_switch_alu_imm(cc, 7, plan->cases[mid].value);
+    emit_byte(cc->buf, &cc->pos, cc->buflen, 0x0F);
+    emit_byte(cc->buf, &cc->pos, cc->buflen, (uint8_t)(0x80 + X86_CC_B));
+    left_disp = cc->pos;
+    emit_u32(cc->buf, &cc->pos, cc->buflen, 0);
+    x86_switch_emit_tree(cc, plan, mid, hi, patches, npatches);
+    add_pos_fixup(cc, left_disp, cc->pos, X86_FIXUP_JCC);
+    x86_switch_emit_tree(cc, plan, lo, mid, patches, npatches);
+}
+
+/* Dispatch code for LR_OP_SWITCH followed by one landing pad per distinct
+   successor.  Each pad applies that edge's phi copies and ends in a single
+   sourced jump, so late phi stubs in compile_end see one fixup per edge. */
+static int direct_emit_switch(x86_direct_ctx_t *ctx,
+                              const x86_deferred_term_t *dt) {
+    x86_compile_ctx_t *cc = &ctx->cc;
+    lr_switch_plan_t plan;
+    x86_switch_patch_t *patches;
+    uint32_t npatches = 0;
+    size_t *pads;
+    size_t table_pos = 0;
+    uint64_t table_len = 0;
+
+    if (lr_target_plan_switch(dt->switch_ops, dt->num_ops, cc->arena,
+                              &plan) != 0)
+        return -1;
+    /* Tree: cases + one default exit per leaf; bit test: dests + 2. */
+    patches = lr_arena_array_uninit(cc->arena, x86_switch_patch_t,
+                                    plan.num_cases * 2u + plan.num_dests + 4u);
+    pads = lr_arena_array_uninit(cc->arena, size_t, plan.num_dests);
+    if (!patches || !pads)
+        return -1;
+
+    if (plan.num_cases > 0) {
+        emit_load_operand(cc, &dt->switch_ops[0], X86_RAX);
+        if (plan.bits == 32)
+            encode_alu_rr(cc->buf, &cc->pos, cc->buflen, 0x89,
+                          X86_RAX, X86_RAX, 4);
+        else if (plan.bits == 16 || plan.bits == 8)
+            emit_movzx_rr(cc, X86_RAX, X86_RAX, plan.bits == 8 ? 1 : 2);
+        else if (plan.bits < 64) {
+            /* and rax, (1 << bits) - 1 */
+            emit_byte(cc->buf, &cc->pos, cc->buflen, rex(true, false, false, false));
+            emit_byte(cc->buf, &cc->pos, cc->buflen, 0x83);
+            emit_byte(cc->buf, &cc->pos, cc->buflen, modrm(3, 4, X86_RAX));
+            emit_byte(cc->buf, &cc->pos, cc->buflen,
+                      (uint8_t)((1u << plan.bits) - 1u));
+        }
+        invalidate_cached_reg(cc, X86_RAX);
+    }
+
+    if (plan.num_cases == 0) {
+        x86_switch_branch(cc, -1, patches, &npatches, 0);
+    } else if (plan.kind == LR_SWITCH_LOWER_BIT_TEST) {
+        if (plan.min != 0)
+            x86_switch_alu_imm(cc, 5, plan.min);
+        x86_switch_alu_imm(cc, 7, plan.range);
+        x86_switch_branch(cc, X86_CC_A, patches, &npatches, 0);
+        for (uint32_t d = 1; d < plan.num_dests; d++) {
+            if (plan.bit_masks[d] == 0)
+                continue;
+            emit_mov_imm(cc, X86_RCX, (int64_t)plan.bit_masks[d], false);
+            /* bt rcx, rax */
+            emit_byte(cc->buf, &cc->pos, cc->buflen, rex(true, false, false, false));
+            emit_byte(cc->buf, &cc->pos, cc->buflen, 0x0F);
+            emit_byte(cc->buf, &cc->pos, cc->buflen, 0xA3);
+            emit_byte(cc->buf, &cc->pos, cc->buflen, modrm(3, X86_RAX, X86_RCX));
+            x86_switch_branch(cc, X86_CC_B, patches, &npatches, d);
+        }
+        x86_switch_branch(cc, -1, patches, &npatches, 0);
+    } else if (plan.kind == LR_SWITCH_LOWER_JUMP_TABLE) {
+        size_t lea_disp;
+        if (plan.min != 0)
+            x86_switch_alu_imm(cc, 5, plan.min);
+        x86_switch_alu_imm(cc, 7, plan.range);
+        x86_switch_branch(cc, X86_CC_A, patches, &npatches, 0);
+        /* lea rcx, [rip + table]; movsxd rax, [rcx + rax*4];
+           add rax, rcx; jmp rax */
+        emit_byte(cc->buf, &cc->pos, cc->buflen, rex(true, false, false, false));
+        emit_byte(cc->buf, &cc->pos, cc->buflen, 0x8D);
+        emit_byte(cc->buf, &cc->pos, cc->buflen, modrm(0, X86_RCX, 5));
+        lea_disp = cc->pos;
+        emit_u32(cc->buf, &cc->pos, cc->buflen, 0);
+        emit_byte(cc->buf, &cc->pos, cc->buflen, rex(true, false, false, false));
+        emit_byte(cc->buf, &cc->pos, cc->buflen, 0x63);
+        emit_byte(cc->buf, &cc->pos, cc->buflen, modrm(0, X86_RAX, 4));
+        emit_byte(cc->buf, &cc->pos, cc->buflen,
+                  (uint8_t)((2u << 6) | (X86_RAX << 3) | X86_RCX));
+        encode_alu_rr(cc->buf, &cc->pos, cc->buflen, 0x01, X86_RAX, X86_RCX, 8);
+        emit_byte(cc->buf, &cc->pos, cc->buflen, 0xFF);
+        emit_byte(cc->buf, &cc->pos, cc->buflen, modrm(3, 4, X86_RAX));
+        table_pos = cc->pos;
+        table_len = plan.range + 1u;
+        add_pos_fixup(cc, lea_disp, table_pos, X86_FIXUP_REL32);
+        cc->pos += (size_t)table_len * 4u;
+    } else {
+        x86_switch_emit_tree(cc, &plan, 0, plan.num_cases,
+                             patches, &npatches);
+    }
+
+    /* The default pad comes first, so a trailing jump to it falls through. */
+    if (npatches > 0 && patches[npatches - 1].dest == 0 &&
+        patches[npatches - 1].pos + 4 == cc->pos &&
+        cc->pos >= 5 && cc->pos - 5 < cc->buflen &&
+        cc->buf[cc->pos - 5] == 0xE9) {
+        cc->pos -= 5;
+        npatches--;
+    }
+    invalidate_cached_gprs(cc);
+
+    for (uint32_t d = 0; d < plan.num_dests; d++) {
+        pads[d] = cc->pos;
+        invalidate_cached_gprs(cc);
+        direct_emit_phi_copies_for_edge(ctx, dt->block_id, plan.dests[d],
+                                        false);
+        emit_jmp_sourced(cc, plan.dests[d], dt->block_id);
+    }
+
+    for (uint32_t i = 0; i < npatches; i++)
+        add_pos_fixup(cc, patches[i].pos, pads[patches[i].dest],
+                      patches[i].kind);
+    if (table_len > 0) {
+        uint32_t ci = 0;
+        for (uint64_t v = 0; v < table_len; v++) {
+            uint32_t dest = 0;
+            x86_fixup_t *f;
+            if (ci < plan.num_cases &&
+                plan.cases[ci].value - plan.min == v)
+                dest = plan.cases[ci++].dest;
+            f = new_fixup(cc, table_pos + (size_t)v * 4u, X86_FIXUP_TABLE);
+            if (f) {
+                f->target_pos_hint = pads[dest];
+                f->base = table_pos;
+            }
+        }
+    }
+    return 0;
+}
+
 /* Flush a deferred terminator (BR, CONDBR, RET, RET_VOID) that was
    saved during compile_emit. Phi copies are edge-specific; unconditional
    branches can emit them directly, while conditional branches use late
    edge stubs in compile_end(). */
+/* ---- Copy-and-patch emission (LR_COMPILE_COPY_PATCH) ---- */
+
+typedef enum {
+    X86_CP_NONE = 0,
+    X86_CP_SLOT,  /* value lives in the 8-byte slot at rbp + off */
+    X86_CP_FRAME, /* value is the address rbp + off (static alloca) */
+    X86_CP_IMM,   /* value is a compile-time 64-bit constant */
+    X86_CP_SYM,   /* value is the address of object symbol index *out */
+} x86_cp_operand_t;
+
+static x86_cp_operand_t x86_cp_classify(x86_compile_ctx_t *cc,
+                                        const lr_operand_t *op,
+                                        int64_t *out) {
+    *out = 0;
+    switch (op->kind) {
+    case LR_VAL_VREG: {
+        int32_t alloca_off = lr_target_lookup_static_alloca_offset(
+            cc->static_alloca_offsets, cc->num_static_alloca_offsets,
+            op->vreg);
+        if (alloca_off != 0) {
+            *out = alloca_off;
+            return X86_CP_FRAME;
+        }
+        if (vreg_is_homed(cc, op->vreg))
+            return X86_CP_NONE;
+        *out = alloc_slot(cc, op->vreg, 8, 8);
+        return X86_CP_SLOT;
+    }
+    case LR_VAL_IMM_I64:
+        *out = op->imm_i64;
+        return X86_CP_IMM;
+    case LR_VAL_IMM_F64:
+        if (op->type && op->type->kind == LR_TYPE_FLOAT) {
+            float fv = (float)op->imm_f64;
+            uint32_t bits = 0;
+            memcpy(&bits, &fv, sizeof(bits));
+            *out = (int64_t)(uint64_t)bits;
+        } else {
+            uint64_t bits = 0;
+            memcpy(&bits, &op->imm_f64, sizeof(bits));
+            *out = (int64_t)bits;
+        }
+        return X86_CP_IMM;
+    case LR_VAL_NULL:
+    case LR_VAL_UNDEF:
+        return X86_CP_IMM;
+    case LR_VAL_GLOBAL: {
+        const char *sym_name;
+        void *addr = NULL;
+        if (!cc->jit)
+            return X86_CP_NONE;
+        sym_name = lr_module_symbol_name(cc->mod, op->global_id);
+        if (cc->obj_ctx) {
+            /* Absolute 64-bit relocations carry no addend here. */
+            uint32_t sym_idx;
+            if (!sym_name || op->global_offset != 0)
+                return X86_CP_NONE;
+            sym_idx = lr_obj_ensure_symbol(cc->obj_ctx, sym_name, false, 0, 0);
+            if (sym_idx == UINT32_MAX)
+                return X86_CP_NONE;
+            *out = sym_idx;
+            return X86_CP_SYM;
+        }
+        if (sym_name)
+            addr = lr_jit_get_symbol(cc->jit, sym_name);
+        *out = (int64_t)(uintptr_t)addr + op->global_offset;
+        return X86_CP_IMM;
+    }
+    default:
+        return X86_CP_NONE;
+    }
+}
+
+/* Stencil type kinds: integers keep their width and pointers use i64;
+   LR_TYPE_VOID means no stencil applies. */
+static lr_type_kind_t x86_cp_int_kind(const lr_type_t *type) {
+    if (!type)
+        return LR_TYPE_VOID;
+    switch (type->kind) {
+    case LR_TYPE_I1: case LR_TYPE_I8: case LR_TYPE_I16:
+    case LR_TYPE_I32: case LR_TYPE_I64:
+        return type->kind;
+    case LR_TYPE_PTR:
+        return LR_TYPE_I64;
+    default:
+        return LR_TYPE_VOID;
+    }
+}
+
+static lr_type_kind_t x86_cp_fp_kind(const lr_type_t *type) {
+    if (type && (type->kind == LR_TYPE_FLOAT || type->kind == LR_TYPE_DOUBLE))
+        return type->kind;
+    return LR_TYPE_VOID;
+}
+
+/* Memory access width of a scalar load/store, as an integer kind. */
+static lr_type_kind_t x86_cp_mem_kind(const lr_type_t *type) {
+    if (!type)
+        return LR_TYPE_VOID;
+    switch (type->kind) {
+    case LR_TYPE_I1: case LR_TYPE_I8:
+        return LR_TYPE_I8;
+    case LR_TYPE_I16:
+        return LR_TYPE_I16;
+    case LR_TYPE_I32: case LR_TYPE_FLOAT:
+        return LR_TYPE_I32;
+    case LR_TYPE_I64: case LR_TYPE_DOUBLE: case LR_TYPE_PTR:
+        return LR_TYPE_I64;
+    default:
+        return LR_TYPE_VOID;
+    }
+}
+
+/* Copy one stencil: mov rdi, rbp; <patched body>.  Stencils that call out
+   are entered with rsp 8 mod 16 like a real callee.  Unless sym_idx is
+   UINT32_MAX, sym_hole is left to an absolute relocation against it.
+   Returns the offset of the stencil body, for hole lookups. */
+static size_t x86_cp_emit(x86_compile_ctx_t *cc, const lr_stencil_t *st,
+                          const lr_stencil_emit_args_t *args,
+                          bool call_frame, lr_stencil_hole_t sym_hole,
+                          uint32_t sym_idx) {
+    size_t start;
+    uint8_t *code;
+    /* Stencils are compiled C and may use the red zone below rsp. */
+    cc->frame_pinned = true;
+    if (call_frame)
+        emit_frame_alloc(cc, 8);
+    encode_alu_rr(cc->buf, &cc->pos, cc->buflen, 0x89, X86_RDI, X86_RBP, 8);
+    start = cc->pos;
+    code = cc->buf + cc->pos;
+    if (cc->pos < cc->buflen &&
+        lr_stencil_emit(&code, cc->buf + cc->buflen, st, args, false) == 0)
+        cc->pos = (size_t)(code - cc->buf);
+    else
+        cc->pos += st->size;
+    if (sym_idx != UINT32_MAX && cc->obj_ctx) {
+        int hole = lr_stencil_hole_offset(st, sym_hole);
+        if (hole >= 0)
+            lr_obj_add_reloc(cc->obj_ctx, (uint32_t)(start + (size_t)hole),
+                             sym_idx, LR_RELOC_X86_64_64);
+    }
+    if (call_frame)
+        emit_frame_free(cc, 8);
+    invalidate_cached_gprs(cc);
+    return start;
+}
+
+#define X86_NO_FUSED_CC 0xFFu
+
+/* Condition code of the icmp defining op when its flags are still live
+   (see flags_valid), else X86_NO_FUSED_CC.  A single-use result is never
+   materialized: the setcc and store are cut from the buffer. */
+static uint8_t direct_take_cmp_flags(x86_direct_ctx_t *ctx,
+                                     const lr_operand_t *op,
+                                     uint32_t block_id) {
+    x86_compile_ctx_t *cc = &ctx->cc;
+    if (!ctx->flags_valid || op->kind != LR_VAL_VREG ||
+        op->vreg != ctx->flags_vreg || block_id != ctx->flags_block_id ||
+        cc->pos != ctx->flags_end)
+        return X86_NO_FUSED_CC;
+    ctx->flags_valid = false;
+    if (op->vreg < cc->num_vreg_uses && cc->vreg_uses[op->vreg] == 1) {
+        cc->pos = ctx->flags_cmp_end;
+        invalidate_cached_gprs(cc);
+    }
+    return ctx->flags_cc;
+}
+
+/* The folded address of the GEP defining op when the GEP was emitted
+   just before in this block and op is its only use; its lea and store are
+   cut from the buffer. */
+static bool direct_take_gep_addr(x86_direct_ctx_t *ctx,
+                                 const lr_operand_t *op, x86_addr_t *out) {
+    x86_compile_ctx_t *cc = &ctx->cc;
+    if (!ctx->addr_valid || op->kind != LR_VAL_VREG ||
+        op->vreg != ctx->addr_vreg ||
+        ctx->addr_block_id != ctx->current_block_id ||
+        cc->pos != ctx->addr_end || op->vreg >= cc->num_vreg_uses ||
+        cc->vreg_uses[op->vreg] != 1)
+        return false;
+    ctx->addr_valid = false;
+    cc->pos = ctx->addr_ready;
+    invalidate_cached_gprs(cc);
+    *out = ctx->addr_mem;
+    return true;
+}
+
+/* Register holding op: its allocated home when it has one, else scratch
+   after loading it there. */
+static uint8_t operand_in_reg(x86_compile_ctx_t *cc, const lr_operand_t *op,
+                              uint8_t scratch) {
+    if (op->kind == LR_VAL_VREG &&
+        lr_target_lookup_static_alloca_offset(
+            cc->static_alloca_offsets, cc->num_static_alloca_offsets,
+            op->vreg) == 0 &&
+        vreg_home_reg(cc, op->vreg) != X86_NO_HOME)
+        return vreg_home_reg(cc, op->vreg);
+    emit_load_operand(cc, op, scratch);
+    return scratch;
+}
+
 static int flush_deferred_terminator(x86_direct_ctx_t *ctx) {
     x86_compile_ctx_t *cc;
     x86_deferred_term_t *dt;
@@ -1736,8 +3099,28 @@ static int flush_deferred_terminator(x86_direct_ctx_t *ctx) {
     case LR_OP_BR: {
         direct_emit_phi_copies_for_edge(ctx, dt->block_id,
                                         dt->ops[0].block_id, false);
-        if (direct_ensure_fixup_cap(ctx) != 0) return -1;
         uint32_t target_id = dt->ops[0].block_id;
+        if (ctx->mode == LR_COMPILE_COPY_PATCH) {
+            const lr_stencil_t *st = lr_stencil_lookup_for_ir(LR_OP_BR,
+                                                              LR_TYPE_VOID);
+            int hole = lr_stencil_hole_offset(st,
+                                              LR_STENCIL_HOLE_BRANCH_REL);
+            if (st && hole >= 0) {
+                uint8_t *code = cc->buf + cc->pos;
+                size_t start = cc->pos;
+                if (cc->pos < cc->buflen &&
+                    lr_stencil_emit(&code, cc->buf + cc->buflen, st,
+                                    NULL, false) == 0)
+                    cc->pos = (size_t)(code - cc->buf);
+                else
+                    cc->pos += st->size;
+                add_branch_fixup(cc, start + (size_t)hole, target_id,
+                                 dt->block_id,
+                                 stencil_branch_kind(cc, start + (size_t)hole,
+                                                     cc->pos));
+                break;
+            }
+        }
         emit_jmp_sourced(cc, target_id, dt->block_id);
         break;
     }
@@ -1745,46 +3128,75 @@ static int flush_deferred_terminator(x86_direct_ctx_t *ctx) {
         uint32_t true_id;
         uint32_t false_id;
         size_t jcc_disp_pos;
-        size_t true_path_pos;
-        int32_t rel32;
+        uint8_t jcc_kind;
+        bool jcc_to_block;
         uint8_t x86cc;
-        emit_load_operand(cc, &dt->ops[0], X86_RAX);
-        encode_alu_rr(cc->buf, &cc->pos, cc->buflen, 0x85,
-                      X86_RAX, X86_RAX, 1);
+        uint8_t cond_cc;
+        const lr_stencil_t *cond_st = NULL;
+        int cond_hole = -1;
+        int64_t cond_off = 0;
 
         true_id = dt->ops[1].block_id;
         false_id = dt->ops[2].block_id;
 
         /* Emit edge-specific copies:
-           test; jne true_path; false_copies; jmp false; true_path: true_copies; jmp true */
-        x86cc = lr_cc_to_x86(LR_CC_NE);
-        emit_byte(cc->buf, &cc->pos, cc->buflen, 0x0F);
-        emit_byte(cc->buf, &cc->pos, cc->buflen, (uint8_t)(0x80 + x86cc));
-        jcc_disp_pos = cc->pos;
-        emit_u32(cc->buf, &cc->pos, cc->buflen, 0);
+           test; jne true; false_copies; jmp false
+           or, when the true edge already has copies,
+           test; jne true_path; false_copies; jmp false; true_path: true_copies; jmp true
+           A condition computed by the icmp just before branches on its
+           flags (cmp; jcc) instead of being reloaded and tested. */
+        jcc_to_block = !direct_edge_has_phi_copies(ctx, dt->block_id,
+                                                   true_id);
+        cond_cc = direct_take_cmp_flags(ctx, &dt->ops[0], dt->block_id);
+        if (cond_cc == X86_NO_FUSED_CC && ctx->mode == LR_COMPILE_COPY_PATCH &&
+            x86_cp_classify(cc, &dt->ops[0], &cond_off) == X86_CP_SLOT) {
+            cond_st = lr_stencil_lookup_for_ir(LR_OP_CONDBR, LR_TYPE_I1);
+            cond_hole = lr_stencil_hole_offset(cond_st,
+                                               LR_STENCIL_HOLE_BRANCH_REL);
+        }
+        if (cond_st && cond_hole >= 0) {
+            lr_stencil_emit_args_t args;
+            memset(&args, 0, sizeof(args));
+            args.src0_off = (int32_t)cond_off;
+            jcc_disp_pos = x86_cp_emit(cc, cond_st, &args, false,
+                                       LR_STENCIL_HOLE_IMM64, UINT32_MAX) +
+                           (size_t)cond_hole;
+            jcc_kind = stencil_branch_kind(cc, jcc_disp_pos, cc->pos);
+        } else {
+            if (cond_cc == X86_NO_FUSED_CC) {
+                emit_load_operand(cc, &dt->ops[0], X86_RAX);
+                encode_alu_rr(cc->buf, &cc->pos, cc->buflen, 0x85,
+                              X86_RAX, X86_RAX, 1);
+                cond_cc = LR_CC_NE;
+            }
+            x86cc = lr_cc_to_x86(cond_cc);
+            emit_byte(cc->buf, &cc->pos, cc->buflen, 0x0F);
+            emit_byte(cc->buf, &cc->pos, cc->buflen, (uint8_t)(0x80 + x86cc));
+            jcc_disp_pos = cc->pos;
+            emit_u32(cc->buf, &cc->pos, cc->buflen, 0);
+            jcc_kind = X86_FIXUP_JCC;
+        }
+        if (jcc_to_block)
+            add_branch_fixup(cc, jcc_disp_pos, true_id, dt->block_id,
+                             jcc_kind);
 
         direct_emit_phi_copies_for_edge(ctx, dt->block_id, false_id, false);
-        if (direct_ensure_fixup_cap(ctx) != 0) return -1;
         emit_jmp_sourced(cc, false_id, dt->block_id);
-
-        true_path_pos = cc->pos;
-        rel32 = (int32_t)((int64_t)true_path_pos -
-                          (int64_t)(jcc_disp_pos + 4));
-        if (jcc_disp_pos + 4 <= cc->buflen) {
-            cc->buf[jcc_disp_pos + 0] = (uint8_t)(rel32);
-            cc->buf[jcc_disp_pos + 1] = (uint8_t)(rel32 >> 8);
-            cc->buf[jcc_disp_pos + 2] = (uint8_t)(rel32 >> 16);
-            cc->buf[jcc_disp_pos + 3] = (uint8_t)(rel32 >> 24);
-        }
+        if (jcc_to_block)
+            break;
+        add_pos_fixup(cc, jcc_disp_pos, cc->pos, jcc_kind);
 
         /* Edge copies must reload their sources from slots, not reuse the
            scratch-register cache left behind by the branch condition. */
         invalidate_cached_gprs(cc);
         direct_emit_phi_copies_for_edge(ctx, dt->block_id, true_id, false);
-        if (direct_ensure_fixup_cap(ctx) != 0) return -1;
         emit_jmp_sourced(cc, true_id, dt->block_id);
         break;
     }
+    case LR_OP_SWITCH:
+        if (direct_emit_switch(ctx, dt) != 0)
+            return -1;
+        break;
     default:
         break;
     }
@@ -1861,282 +3273,2298 @@ static bool direct_call_uses_external_sysv_abi(x86_compile_ctx_t *cc,
     return call_external_abi;
 }
 
-static bool function_uses_external_sysv_fp_abi(const lr_compile_func_meta_t *func_meta) {
-    if (!func_meta || !func_meta->func)
-        return false;
-    return func_meta->func->uses_llvm_abi;
-}
-
-static int x86_64_compile_begin(void **compile_ctx,
-                                const lr_compile_func_meta_t *func_meta,
-                                lr_module_t *mod,
-                                uint8_t *buf, size_t buflen,
-                                lr_arena_t *arena) {
-    static const uint8_t param_regs[] = {
-        X86_RDI, X86_RSI, X86_RDX, X86_RCX, X86_R8, X86_R9
-    };
-    static const uint8_t param_fp_regs[] = {
-        X86_XMM0, X86_XMM1, X86_XMM2, X86_XMM3,
-        X86_XMM4, X86_XMM5, X86_XMM6, X86_XMM7
-    };
-    x86_direct_ctx_t *ctx = NULL;
-    uint32_t initial_slots;
-    uint32_t *param_vregs = NULL;
-    uint32_t num_params;
-    bool vararg;
-    lr_type_t *ret_type;
-
-    if (!compile_ctx || !func_meta || !mod || !arena)
-        return -1;
-
-    ctx = lr_arena_new(arena, x86_direct_ctx_t);
-    if (!ctx)
-        return -1;
-    memset(ctx, 0, sizeof(*ctx));
-    ctx->mode = func_meta->mode;
-    ctx->next_vreg = func_meta->next_vreg;
-    ret_type = func_meta->ret_type ? func_meta->ret_type : mod->type_void;
-    ctx->ret_type = ret_type;
-    num_params = func_meta->num_params;
-    vararg = func_meta->vararg;
-    lr_type_t **param_types = func_meta->param_types;
+/* Emit one instruction as a stencil in copy-patch mode.  Returns false,
+   having emitted nothing, when no stencil covers the instruction's types or
+   operand forms; the caller then falls back to ISel. */
+static bool direct_cp_emit_inst(x86_compile_ctx_t *cc,
+                                const lr_compile_inst_desc_t *desc,
+                                lr_operand_t *ops) {
+    lr_stencil_emit_args_t args;
+    const lr_stencil_t *st = NULL;
+    const lr_stencil_t *st_post = NULL;
+    lr_type_kind_t kind;
+    x86_cp_operand_t k0, k1, k2;
+    int64_t v0 = 0, v1 = 0, v2 = 0;
+    int64_t post_imm = 0;
+    lr_stencil_hole_t sym_hole = LR_STENCIL_HOLE_IMM64;
+    uint32_t sym_idx = UINT32_MAX;
+    uint32_t nops = desc->num_operands;
+    bool call_frame = false;
+    bool has_dest = true;
 
-    if (func_meta->func && func_meta->func->param_vregs) {
-        param_vregs = func_meta->func->param_vregs;
-    } else if (num_params > 0) {
-        param_vregs = lr_arena_array(arena, uint32_t, num_params);
-        if (!param_vregs) return -1;
-        for (uint32_t i = 0; i < num_params; i++) {
-            param_vregs[i] = i + 1u;
-            if (ctx->next_vreg <= i + 1u)
-                ctx->next_vreg = i + 2u;
+    memset(&args, 0, sizeof(args));
+    switch (desc->op) {
+    case LR_OP_ADD: case LR_OP_SUB: case LR_OP_MUL:
+    case LR_OP_SDIV: case LR_OP_SREM: case LR_OP_UDIV: case LR_OP_UREM:
+    case LR_OP_AND: case LR_OP_OR: case LR_OP_XOR:
+    case LR_OP_SHL: case LR_OP_LSHR: case LR_OP_ASHR:
+    case LR_OP_ICMP: {
+        const lr_operand_t *lhs = &ops[0];
+        const lr_operand_t *rhs = &ops[1];
+        uint32_t aux = 0;
+        bool commutative = desc->op == LR_OP_ADD || desc->op == LR_OP_MUL ||
+                           desc->op == LR_OP_AND || desc->op == LR_OP_OR ||
+                           desc->op == LR_OP_XOR;
+        if (nops < 2)
+            return false;
+        if (desc->op == LR_OP_ICMP) {
+            kind = x86_cp_int_kind(ops[0].type);
+            aux = (uint32_t)desc->icmp_pred;
+            if (kind == LR_TYPE_I1 && desc->icmp_pred != LR_ICMP_EQ &&
+                desc->icmp_pred != LR_ICMP_NE)
+                return false;
+        } else {
+            kind = x86_cp_int_kind(desc->type);
+            if (kind == LR_TYPE_I1 && desc->op != LR_OP_AND &&
+                desc->op != LR_OP_OR && desc->op != LR_OP_XOR)
+                return false;
+        }
+        if (kind == LR_TYPE_VOID)
+            return false;
+        if (kind == LR_TYPE_I1)
+            kind = LR_TYPE_I8;
+        if (commutative && lhs->kind != LR_VAL_VREG) {
+            lhs = &ops[1];
+            rhs = &ops[0];
+        }
+        k0 = x86_cp_classify(cc, lhs, &v0);
+        k1 = x86_cp_classify(cc, rhs, &v1);
+        if (k0 != X86_CP_SLOT || (k1 != X86_CP_SLOT && k1 != X86_CP_IMM))
+            return false;
+        if (desc->op == LR_OP_SDIV || desc->op == LR_OP_SREM ||
+            desc->op == LR_OP_UDIV || desc->op == LR_OP_UREM) {
+            /* The stencil divides by a patched hole; ISel's multiply-high
+               sequence is cheaper. */
+            lr_div_const_t plan;
+            if (x86_div_const(desc, rhs, &plan))
+                return false;
         }
+        st = lr_stencil_lookup_ex(desc->op, kind, aux,
+                                  k1 == X86_CP_IMM ? LR_STENCIL_FORM_IMM : 0);
+        args.src0_off = (int32_t)v0;
+        args.src1_off = (int32_t)v1;
+        args.imm64 = v1;
+        break;
     }
-
-    initial_slots = ctx->next_vreg > 64 ? ctx->next_vreg : 64;
-    x86_compile_ctx_t *cc = &ctx->cc;
-    cc->buf = buf;
-    cc->buflen = buflen;
-    cc->pos = 0;
-    cc->stack_size = 0;
-    cc->stack_slots = lr_arena_array(arena, int32_t, initial_slots);
-    cc->stack_slot_sizes = lr_arena_array(arena, uint32_t, initial_slots);
-    cc->num_stack_slots = initial_slots;
-    cc->static_alloca_offsets = NULL;
-    cc->num_static_alloca_offsets = 0;
-    cc->block_offsets = lr_arena_array_uninit(arena, size_t, 8);
-    cc->block_entry_offsets = lr_arena_array_uninit(arena, size_t, 8);
-    cc->num_block_offsets = 8;
-    for (uint32_t i = 0; i < 8; i++) cc->block_offsets[i] = SIZE_MAX;
-    for (uint32_t i = 0; i < 8; i++) cc->block_entry_offsets[i] = SIZE_MAX;
-    cc->fixups = lr_arena_array_uninit(arena, x86_fixup_t, 16);
-    cc->num_fixups = 0;
-    cc->fixup_cap = 16;
-    cc->arena = arena;
-    cc->obj_ctx = mod ? mod->obj_ctx : NULL;
-    cc->mod = mod;
-    cc->jit = func_meta ? func_meta->jit : NULL;
-    cc->sym_defined = NULL;
-    cc->sym_funcs = NULL;
-    cc->sym_count = 0;
-    cc->rax_holds_vreg = UINT32_MAX;
-    cc->rcx_holds_vreg = UINT32_MAX;
-    cc->current_inst = NULL;
-    cc->func_uses_internal_sret = false;
-    cc->sret_ptr_off = 0;
-    cc->func_is_vararg = false;
-    cc->vararg_rsa_off = 0;
-    cc->vararg_named_gp = 0;
-    cc->vararg_named_fp = 0;
-    cc->vararg_named_stack_gp = 0;
-    cc->func_uses_external_sysv_fp = function_uses_external_sysv_fp_abi(func_meta);
-
-    attach_obj_symbol_meta_cache(cc);
-
-    ctx->prologue_patch_pos = emit_prologue(cc);
-
-    cc->func_uses_internal_sret = uses_internal_sret_abi(ret_type) &&
-                                  !fp_abi_two_lane_aggregate(ret_type, NULL,
+    case LR_OP_FADD: case LR_OP_FSUB: case LR_OP_FMUL: case LR_OP_FDIV:
+    case LR_OP_FCMP: {
+        uint32_t aux = 0;
+        bool rhs_imm;
+        if (nops < 2)
+            return false;
+        if (desc->op == LR_OP_FCMP) {
+            kind = x86_cp_fp_kind(ops[0].type);
+            aux = (uint32_t)desc->fcmp_pred;
+            if (desc->fcmp_pred == LR_FCMP_FALSE ||
+                desc->fcmp_pred == LR_FCMP_TRUE)
+                return false;
+        } else {
+            kind = x86_cp_fp_kind(desc->type);
+        }
+        if (kind == LR_TYPE_VOID)
+            return false;
+        rhs_imm = ops[1].kind == LR_VAL_IMM_F64 ||
+                  ops[1].kind == LR_VAL_NULL || ops[1].kind == LR_VAL_UNDEF;
+        k0 = x86_cp_classify(cc, &ops[0], &v0);
+        k1 = x86_cp_classify(cc, &ops[1], &v1);
+        if (k0 != X86_CP_SLOT ||
+            !(k1 == X86_CP_SLOT || (k1 == X86_CP_IMM && rhs_imm)))
+            return false;
+        /* ISel reads a constant right operand from the constant pool,
+           which beats the stencil's movabs + movq. */
+        if (desc->op != LR_OP_FCMP && ops[1].kind == LR_VAL_IMM_F64 &&
+            cc->const_pool.enabled)
+            return false;
+        st = lr_stencil_lookup_ex(desc->op, kind, aux,
+                                  k1 == X86_CP_IMM ? LR_STENCIL_FORM_IMM : 0);
+        args.src0_off = (int32_t)v0;
+        args.src1_off = (int32_t)v1;
+        args.imm64 = v1;
+        break;
+    }
+    case LR_OP_FNEG:
+    case LR_OP_FPTOSI: case LR_OP_FPTOUI:
+    case LR_OP_FPEXT: case LR_OP_FPTRUNC: {
+        lr_type_kind_t dst_kind;
+        if (nops < 1)
+            return false;
+        kind = x86_cp_fp_kind(ops[0].type);
+        if (desc->op == LR_OP_FPTOSI || desc->op == LR_OP_FPTOUI)
+            dst_kind = x86_cp_int_kind(desc->type);
+        else
+            dst_kind = x86_cp_fp_kind(desc->type);
+        if (kind == LR_TYPE_VOID || dst_kind == LR_TYPE_VOID)
+            return false;
+        if ((desc->op == LR_OP_FPEXT && kind != LR_TYPE_FLOAT) ||
+            (desc->op == LR_OP_FPTRUNC && kind != LR_TYPE_DOUBLE))
+            return false;
+        if (x86_cp_classify(cc, &ops[0], &v0) != X86_CP_SLOT)
+            return false;
+        /* fptoui shares the 64-bit truncating conversion, as in ISel. */
+        st = lr_stencil_lookup_ex(desc->op == LR_OP_FPTOUI ? LR_OP_FPTOSI
+                                                           : desc->op,
+                                  kind, 0, 0);
+        args.src0_off = (int32_t)v0;
+        break;
+    }
+    case LR_OP_SEXT: case LR_OP_ZEXT: case LR_OP_TRUNC:
+    case LR_OP_SITOFP: case LR_OP_UITOFP: {
+        lr_type_kind_t src_kind;
+        lr_type_kind_t dst_kind;
+        if (nops < 1)
+            return false;
+        src_kind = x86_cp_int_kind(ops[0].type);
+        if (desc->op == LR_OP_SITOFP || desc->op == LR_OP_UITOFP)
+            dst_kind = x86_cp_fp_kind(desc->type);
+        else
+            dst_kind = x86_cp_int_kind(desc->type);
+        if (src_kind == LR_TYPE_VOID || dst_kind == LR_TYPE_VOID)
+            return false;
+        if (x86_cp_classify(cc, &ops[0], &v0) != X86_CP_SLOT)
+            return false;
+        if (desc->op == LR_OP_SITOFP || desc->op == LR_OP_UITOFP)
+            st = lr_stencil_lookup_ex(desc->op, src_kind,
+                                      (uint32_t)dst_kind, 0);
+        else if (desc->op == LR_OP_TRUNC)
+            st = lr_stencil_lookup_for_ir(
+                dst_kind == LR_TYPE_I64 ? LR_OP_BITCAST : LR_OP_TRUNC,
+                dst_kind);
+        else
+            st = lr_stencil_lookup_for_ir(
+                src_kind == LR_TYPE_I64 ? LR_OP_BITCAST : desc->op,
+                src_kind);
+        args.src0_off = (int32_t)v0;
+        break;
+    }
+    case LR_OP_BITCAST: case LR_OP_PTRTOINT: case LR_OP_INTTOPTR:
+        if (nops < 1 || x86_cp_mem_kind(ops[0].type) == LR_TYPE_VOID ||
+            x86_cp_mem_kind(desc->type) == LR_TYPE_VOID)
+            return false;
+        k0 = x86_cp_classify(cc, &ops[0], &v0);
+        if (k0 == X86_CP_SLOT) {
+            st = lr_stencil_lookup_for_ir(LR_OP_BITCAST, LR_TYPE_I64);
+        } else if (k0 == X86_CP_FRAME) {
+            st = lr_stencil_lookup_ex(LR_OP_GEP, LR_TYPE_VOID, 0,
+                                      LR_STENCIL_FORM_FRAME |
+                                      LR_STENCIL_FORM_IMM);
+        } else {
+            return false;
+        }
+        args.src0_off = (int32_t)v0;
+        break;
+    case LR_OP_LOAD: {
+        uint32_t form = 0;
+        kind = x86_cp_mem_kind(desc->type);
+        if (nops < 1 || kind == LR_TYPE_VOID)
+            return false;
+        k0 = x86_cp_classify(cc, &ops[0], &v0);
+        if (k0 == X86_CP_FRAME) {
+            form = LR_STENCIL_FORM_FRAME;
+        } else if (k0 == X86_CP_IMM) {
+            form = LR_STENCIL_FORM_IMM;
+        } else if (k0 == X86_CP_SYM) {
+            form = LR_STENCIL_FORM_IMM;
+            sym_idx = (uint32_t)v0;
+            v0 = 0;
+        } else if (k0 != X86_CP_SLOT) {
+            return false;
+        }
+        st = lr_stencil_lookup_ex(LR_OP_LOAD, kind, 0, form);
+        args.src0_off = (int32_t)v0;
+        args.imm64 = v0;
+        break;
+    }
+    case LR_OP_STORE: {
+        uint32_t form = 0;
+        if (nops < 2)
+            return false;
+        kind = x86_cp_mem_kind(ops[0].type);
+        if (kind == LR_TYPE_VOID)
+            return false;
+        k0 = x86_cp_classify(cc, &ops[0], &v0);
+        k1 = x86_cp_classify(cc, &ops[1], &v1);
+        if (k0 == X86_CP_IMM) {
+            form |= LR_STENCIL_FORM_IMM;
+        } else if (k0 == X86_CP_SYM) {
+            form |= LR_STENCIL_FORM_IMM;
+            sym_idx = (uint32_t)v0;
+            v0 = 0;
+        } else if (k0 != X86_CP_SLOT) {
+            return false;
+        }
+        if (k1 == X86_CP_FRAME)
+            form |= LR_STENCIL_FORM_FRAME;
+        else if (k1 != X86_CP_SLOT)
+            return false;
+        st = lr_stencil_lookup_ex(LR_OP_STORE, kind, 0, form);
+        args.src0_off = (int32_t)v0;
+        args.src1_off = (int32_t)v1;
+        args.imm64 = v0;
+        has_dest = false;
+        break;
+    }
+    case LR_OP_GEP: {
+        const lr_type_t *cur_ty = desc->type;
+        int64_t const_off = 0;
+        uint32_t rt_idx = 0;
+        size_t rt_scale = 0;
+        lr_type_kind_t rt_kind = LR_TYPE_VOID;
+        if (nops < 1)
+            return false;
+        k0 = x86_cp_classify(cc, &ops[0], &v0);
+        if (k0 != X86_CP_SLOT && k0 != X86_CP_FRAME)
+            return false;
+        for (uint32_t idx = 1; idx < nops; idx++) {
+            lr_gep_step_t step;
+            if (!lr_gep_analyze_step(cur_ty, idx == 1, &ops[idx], &step))
+                continue;
+            cur_ty = step.next_type;
+            if (step.is_const) {
+                const_off += step.const_byte_offset;
+                continue;
+            }
+            if (rt_idx != 0 || !ops[idx].type)
+                return false;
+            if (ops[idx].type->kind == LR_TYPE_I32 ||
+                ops[idx].type->kind == LR_TYPE_I64)
+                rt_kind = ops[idx].type->kind;
+            else
+                return false;
+            rt_idx = idx;
+            rt_scale = step.runtime_elem_size;
+        }
+        args.src0_off = (int32_t)v0;
+        if (rt_idx == 0) {
+            st = lr_stencil_lookup_ex(LR_OP_GEP, LR_TYPE_VOID, 0,
+                                      LR_STENCIL_FORM_IMM |
+                                      (k0 == X86_CP_FRAME ?
+                                           LR_STENCIL_FORM_FRAME : 0));
+            args.imm64 = const_off;
+            break;
+        }
+        if (x86_cp_classify(cc, &ops[rt_idx], &v1) != X86_CP_SLOT)
+            return false;
+        st = lr_stencil_lookup_ex(LR_OP_GEP, rt_kind, 0,
+                                  k0 == X86_CP_FRAME ?
+                                      LR_STENCIL_FORM_FRAME : 0);
+        if (const_off != 0) {
+            st_post = lr_stencil_lookup_ex(LR_OP_GEP, LR_TYPE_VOID, 0,
+                                           LR_STENCIL_FORM_IMM);
+            if (!st_post)
+                return false;
+            post_imm = const_off;
+        }
+        args.src1_off = (int32_t)v1;
+        args.imm64 = (int64_t)rt_scale;
+        break;
+    }
+    case LR_OP_SELECT:
+        if (nops < 3 || (x86_cp_int_kind(desc->type) == LR_TYPE_VOID &&
+                         x86_cp_fp_kind(desc->type) == LR_TYPE_VOID))
+            return false;
+        k0 = x86_cp_classify(cc, &ops[0], &v0);
+        k1 = x86_cp_classify(cc, &ops[1], &v1);
+        k2 = x86_cp_classify(cc, &ops[2], &v2);
+        if (k0 != X86_CP_SLOT || k1 != X86_CP_SLOT || k2 != X86_CP_SLOT)
+            return false;
+        st = lr_stencil_lookup_for_ir(LR_OP_SELECT, LR_TYPE_I64);
+        args.src0_off = (int32_t)v0;
+        args.src1_off = (int32_t)v1;
+        args.imm64 = v2;
+        break;
+    case LR_OP_CALL: {
+        const char *cname;
+        lr_func_t *callee_func = NULL;
+        bool callee_vararg = false;
+        uint32_t nargs;
+        if (nops < 1 || nops > 4 || ops[0].kind != LR_VAL_GLOBAL ||
+            !cc->jit || !cc->mod || desc->call_tail != LR_CALL_TAIL_NONE)
+            return false;
+        cname = lr_module_symbol_name(cc->mod, ops[0].global_id);
+        if (!cname || strncmp(cname, "llvm.", 5) == 0)
+            return false;
+        (void)direct_call_uses_external_sysv_abi(
+            cc, &ops[0], desc->call_external_abi, desc->call_vararg,
+            &callee_func, &callee_vararg);
+        if (callee_vararg || desc->call_vararg)
+            return false;
+        if (!desc->type || desc->type->kind == LR_TYPE_VOID) {
+            kind = LR_TYPE_VOID;
+            has_dest = false;
+        } else if (x86_cp_int_kind(desc->type) != LR_TYPE_VOID) {
+            kind = LR_TYPE_I64;
+        } else if ((kind = x86_cp_fp_kind(desc->type)) == LR_TYPE_VOID) {
+            return false;
+        }
+        nargs = nops - 1;
+        for (uint32_t i = 0; i < nargs; i++) {
+            int64_t off = 0;
+            if (x86_cp_int_kind(ops[i + 1].type) == LR_TYPE_VOID ||
+                x86_cp_classify(cc, &ops[i + 1], &off) != X86_CP_SLOT)
+                return false;
+            if (i == 0)
+                args.src0_off = (int32_t)off;
+            else if (i == 1)
+                args.src1_off = (int32_t)off;
+            else
+                args.imm64 = off;
+        }
+        k0 = x86_cp_classify(cc, &ops[0], &v0);
+        if (k0 == X86_CP_SYM) {
+            sym_hole = LR_STENCIL_HOLE_FUNC_ADDR;
+            sym_idx = (uint32_t)v0;
+            v0 = 0;
+        } else if (k0 != X86_CP_IMM || v0 == 0) {
+            return false;
+        }
+        st = lr_stencil_lookup_ex(LR_OP_CALL, kind, nargs, 0);
+        args.func_addr = (uintptr_t)v0;
+        call_frame = true;
+        break;
+    }
+    default:
+        return false;
+    }
+
+    if (!st)
+        return false;
+    if (has_dest) {
+        if (desc->dest == 0 || vreg_is_homed(cc, desc->dest))
+            return false;
+        args.dst_off = alloc_slot(cc, desc->dest, 8, 8);
+    }
+    (void)x86_cp_emit(cc, st, &args, call_frame, sym_hole, sym_idx);
+    if (st_post) {
+        lr_stencil_emit_args_t post;
+        memset(&post, 0, sizeof(post));
+        post.src0_off = args.dst_off;
+        post.dst_off = args.dst_off;
+        post.imm64 = post_imm;
+        (void)x86_cp_emit(cc, st_post, &post, false, LR_STENCIL_HOLE_IMM64,
+                          UINT32_MAX);
+    }
+    return true;
+}
+
+/* ---- Linear-scan register allocation (LR_CODEGEN_REGALLOC) ---- */
+
+enum {
+    X86_RA_UNSEEN = 0,
+    X86_RA_OK = 1,      /* GPR class */
+    X86_RA_REJECT = 2,
+    X86_RA_OK_FP = 3,   /* XMM class */
+};
+
+static bool x86_regalloc_type_ok(const lr_type_t *type) {
+    if (!type)
+        return false;
+    switch (type->kind) {
+    case LR_TYPE_I1: case LR_TYPE_I8: case LR_TYPE_I16:
+    case LR_TYPE_I32: case LR_TYPE_I64: case LR_TYPE_PTR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool x86_regalloc_fp_type_ok(const lr_type_t *type) {
+    return type && (type->kind == LR_TYPE_FLOAT ||
+                    type->kind == LR_TYPE_DOUBLE);
+}
+
+/* Ops whose result is written only through emit_store_slot, or
+   emit_store_fp_slot for the XMM class. */
+static bool x86_regalloc_def_ok(const lr_inst_t *inst) {
+    switch (inst->op) {
+    case LR_OP_ADD: case LR_OP_SUB: case LR_OP_MUL:
+    case LR_OP_SDIV: case LR_OP_SREM: case LR_OP_UDIV: case LR_OP_UREM:
+    case LR_OP_AND: case LR_OP_OR: case LR_OP_XOR:
+    case LR_OP_SHL: case LR_OP_LSHR: case LR_OP_ASHR:
+    case LR_OP_ICMP: case LR_OP_FCMP:
+    case LR_OP_GEP:
+    case LR_OP_SEXT: case LR_OP_ZEXT: case LR_OP_TRUNC:
+    case LR_OP_PTRTOINT: case LR_OP_INTTOPTR:
+    case LR_OP_FPTOSI: case LR_OP_FPTOUI:
+        return x86_regalloc_type_ok(inst->type);
+    case LR_OP_SELECT: case LR_OP_LOAD: case LR_OP_BITCAST:
+    case LR_OP_CALL: case LR_OP_PHI:
+        return x86_regalloc_type_ok(inst->type) ||
+               x86_regalloc_fp_type_ok(inst->type);
+    case LR_OP_FADD: case LR_OP_FSUB: case LR_OP_FMUL: case LR_OP_FDIV:
+    case LR_OP_FREM: case LR_OP_FNEG:
+    case LR_OP_SITOFP: case LR_OP_UITOFP: case LR_OP_FPEXT:
+        return x86_regalloc_fp_type_ok(inst->type);
+    case LR_OP_FPTRUNC:
+        /* An x87 source is converted straight into the slot. */
+        return x86_regalloc_fp_type_ok(inst->type) &&
+               inst->num_operands > 0 &&
+               x86_regalloc_fp_type_ok(inst->operands[0].type);
+    default:
+        return false;
+    }
+}
+
+/* Whether operand `oi` of `inst` is read only through emit_load_operand,
+   or emit_load_fp_operand for the XMM class. */
+static bool x86_regalloc_use_ok(x86_compile_ctx_t *cc, lr_inst_t *inst,
+                                uint32_t oi, const lr_type_t *ret_type) {
+    const lr_operand_t *op = &inst->operands[oi];
+    switch (inst->op) {
+    case LR_OP_FADD: case LR_OP_FSUB: case LR_OP_FMUL: case LR_OP_FDIV:
+    case LR_OP_FREM: case LR_OP_FNEG: case LR_OP_FCMP:
+    case LR_OP_FPTOSI: case LR_OP_FPTOUI: case LR_OP_FPTRUNC:
+        return x86_regalloc_fp_type_ok(op->type);
+    case LR_OP_FPEXT:
+        /* Extending to x87 reads the source slot directly. */
+        return x86_regalloc_fp_type_ok(op->type) &&
+               x86_regalloc_fp_type_ok(inst->type);
+    case LR_OP_ADD: case LR_OP_SUB: case LR_OP_MUL:
+    case LR_OP_SDIV: case LR_OP_SREM: case LR_OP_UDIV: case LR_OP_UREM:
+    case LR_OP_AND: case LR_OP_OR: case LR_OP_XOR:
+    case LR_OP_SHL: case LR_OP_LSHR: case LR_OP_ASHR:
+    case LR_OP_ICMP: case LR_OP_SELECT: case LR_OP_CONDBR:
+    case LR_OP_SWITCH:
+    case LR_OP_ALLOCA: case LR_OP_LOAD: case LR_OP_GEP:
+    case LR_OP_SEXT: case LR_OP_ZEXT: case LR_OP_TRUNC:
+    case LR_OP_BITCAST: case LR_OP_PTRTOINT: case LR_OP_INTTOPTR:
+    case LR_OP_SITOFP: case LR_OP_UITOFP:
+        return true;
+    case LR_OP_STORE: {
+        size_t sz = lr_type_size(inst->operands[0].type);
+        return oi == 1 || sz <= 8;
+    }
+    case LR_OP_RET:
+        return (x86_regalloc_type_ok(ret_type) ||
+                x86_regalloc_fp_type_ok(ret_type)) &&
+               !cc->func_uses_internal_sret;
+    case LR_OP_PHI:
+        return x86_regalloc_type_ok(inst->type) ||
+               x86_regalloc_fp_type_ok(inst->type);
+    case LR_OP_CALL: {
+        lr_func_t *callee = NULL;
+        const lr_type_t *abi_ty;
+        if (oi == 0)
+            return true;
+        /* Every FP argument path loads through a home-aware helper. */
+        if (x86_regalloc_fp_type_ok(op->type))
+            return true;
+        if (!x86_regalloc_type_ok(op->type))
+            return false;
+        cc->current_inst = inst;
+        (void)direct_call_uses_external_sysv_abi(
+            cc, &inst->operands[0], inst->call_external_abi,
+            inst->call_vararg, &callee, NULL);
+        cc->current_inst = NULL;
+        abi_ty = call_arg_abi_type(callee, oi - 1u, op);
+        return !is_fp_abi_type(abi_ty) &&
+               !fp_abi_two_lane_aggregate(abi_ty, NULL, NULL);
+    }
+    default:
+        return false;
+    }
+}
+
+static bool x86_regalloc_calls_setjmp(const lr_module_t *mod,
+                                      const lr_inst_t *inst) {
+    const char *name;
+    if (inst->op != LR_OP_CALL || inst->num_operands == 0 ||
+        inst->operands[0].kind != LR_VAL_GLOBAL)
+        return false;
+    name = lr_module_symbol_name((lr_module_t *)mod,
+                                 inst->operands[0].global_id);
+    return name && strstr(name, "setjmp") != NULL;
+}
+
+static int x86_regalloc_interval_cmp(const void *a, const void *b) {
+    const uint32_t *x = (const uint32_t *)a;
+    const uint32_t *y = (const uint32_t *)b;
+    if (x[1] != y[1])
+        return x[1] < y[1] ? -1 : 1;
+    return x[0] < y[0] ? -1 : (x[0] > y[0] ? 1 : 0);
+}
+
+/* Whether a call clobbers a value live over [start, end]; calls holds
+   the ascending positions of the function's calls.  A call that only
+   reads the value still counts: its argument setup writes the argument
+   registers before every operand is loaded. */
+static bool x86_regalloc_spans_call(const uint32_t *calls, uint32_t num_calls,
+                                    uint32_t start, uint32_t end) {
+    uint32_t lo = 0, hi = num_calls;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2u;
+        if (calls[mid] <= start)
+            lo = mid + 1u;
+        else
+            hi = mid;
+    }
+    return lo < num_calls && calls[lo] <= end;
+}
+
+/* Linear scan of one register class over the sorted intervals, skipping
+   vregs of the other class.  GPRs: x86_alloc_regs, callee-saved first.
+   XMM: x86_alloc_xmms, all caller-saved.  reg_used collects the GPRs
+   handed out. */
+static void x86_regalloc_scan(x86_compile_ctx_t *cc,
+                              const lr_live_ranges_t *lr,
+                              const uint8_t *state, const uint64_t *weight,
+                              const uint32_t *intervals,
+                              uint32_t num_intervals,
+                              const uint32_t *calls, uint32_t num_calls,
+                              bool fp, bool *reg_used) {
+    const uint8_t *regs = fp ? x86_alloc_xmms : x86_alloc_regs;
+    uint32_t num_regs = fp ? X86_NUM_ALLOC_XMMS : X86_NUM_ALLOC_REGS;
+    uint32_t num_saved = fp ? 0u : X86_NUM_SAVED_ALLOC_REGS;
+    uint8_t home_base = fp ? X86_XMM_HOME : 0u;
+    uint32_t active[X86_NUM_ALLOC_REGS + X86_NUM_ALLOC_XMMS];
+    uint32_t active_reg[X86_NUM_ALLOC_REGS + X86_NUM_ALLOC_XMMS];
+    uint32_t num_active = 0;
+    bool reg_free[X86_NUM_ALLOC_REGS + X86_NUM_ALLOC_XMMS];
+
+    for (uint32_t r = 0; r < num_regs; r++)
+        reg_free[r] = true;
+
+    for (uint32_t i = 0; i < num_intervals; i++) {
+        uint32_t v = intervals[2u * i];
+        uint32_t start = lr->start[v];
+        uint32_t n = 0;
+        uint32_t r;
+        uint32_t num_ok;
+        uint32_t pick;
+        bool any_reg;
+        if ((state[v] == X86_RA_OK_FP) != fp)
+            continue;
+        if (fp) {
+            /* Argument setup only writes XMM0-XMM7, so a call may read
+               the value; it must not be live after one.  Parameters come
+               out of XMM0-XMM7 too, never clobbering an XMM8+ home. */
+            any_reg = !x86_regalloc_spans_call(calls, num_calls, start,
+                                               lr->end[v] - 1u);
+        } else {
+            /* Parameters (start 0) are copied out of the argument
+               registers in the prologue, so only callee-saved homes are
+               safe for them. */
+            any_reg = start > 0 &&
+                      !x86_regalloc_spans_call(calls, num_calls, start,
+                                               lr->end[v]);
+        }
+        /* Expire intervals that ended before this one starts. */
+        for (uint32_t a = 0; a < num_active; a++) {
+            if (lr->end[active[a]] < start) {
+                reg_free[active_reg[a]] = true;
+                continue;
+            }
+            active[n] = active[a];
+            active_reg[n++] = active_reg[a];
+        }
+        num_active = n;
+
+        /* Prefer a caller-saved register: it needs no save and restore,
+           and leaves the callee-saved ones for values live over calls. */
+        num_ok = any_reg ? num_regs : num_saved;
+        pick = UINT32_MAX;
+        for (r = num_saved; r < num_ok && pick == UINT32_MAX; r++)
+            if (reg_free[r])
+                pick = r;
+        for (r = 0; r < num_saved && pick == UINT32_MAX; r++)
+            if (reg_free[r])
+                pick = r;
+        if (pick != UINT32_MAX) {
+            reg_free[pick] = false;
+            if (!fp)
+                reg_used[pick] = true;
+            cc->reg_homes[v] = (uint8_t)(home_base + regs[pick]);
+            active[num_active] = v;
+            active_reg[num_active++] = pick;
+            continue;
+        }
+
+        /* Spill the lightest interval in a register v may use, and of
+           those the one that ends last. */
+        {
+            uint32_t far = UINT32_MAX;
+            for (uint32_t a = 0; a < num_active; a++) {
+                uint32_t av = active[a];
+                if (active_reg[a] >= num_ok)
+                    continue;
+                if (far == UINT32_MAX || weight[av] < weight[active[far]] ||
+                    (weight[av] == weight[active[far]] &&
+                     lr->end[av] > lr->end[active[far]]))
+                    far = a;
+            }
+            if (far != UINT32_MAX &&
+                (weight[active[far]] < weight[v] ||
+                 (weight[active[far]] == weight[v] &&
+                  lr->end[active[far]] > lr->end[v]))) {
+                cc->reg_homes[v] = cc->reg_homes[active[far]];
+                cc->reg_homes[active[far]] = X86_NO_HOME;
+                active[far] = v;
+            }
+        }
+    }
+}
+
+/* Poletto-Sarkar linear scan over conservative live ranges, once for
+   integer/pointer values in GPRs and once for float/double values in
+   XMM registers.  Fills cc->reg_homes; any failure leaves every vreg on
+   the stack. */
+static void x86_regalloc_assign(x86_compile_ctx_t *cc, lr_func_t *func,
+                                const lr_type_t *ret_type,
+                                lr_type_t **param_types) {
+    lr_live_ranges_t lr;
+    uint8_t *state;
+    uint32_t *def_pos;
+    uint32_t *last_use;
+    uint64_t *weight;
+    const lr_cfg_t *cfg = NULL;
+    uint32_t bi = 0;
+    uint32_t *intervals;
+    uint32_t num_intervals = 0;
+    uint32_t *calls;
+    uint32_t num_calls = 0;
+    bool reg_used[X86_NUM_ALLOC_REGS] = {false};
+
+    if (!func || func->next_vreg == 0 || func->vararg)
+        return;
+    if (lr_target_compute_live_ranges(func, cc->arena, &lr) != 0)
+        return;
+
+    state = lr_arena_array(cc->arena, uint8_t, lr.num_vregs);
+    def_pos = lr_arena_array_uninit(cc->arena, uint32_t, lr.num_vregs);
+    last_use = lr_arena_array(cc->arena, uint32_t, lr.num_vregs);
+    weight = lr_arena_array(cc->arena, uint64_t, lr.num_vregs);
+    calls = lr_arena_array_uninit(cc->arena, uint32_t,
+                                  func->block_inst_offsets[func->num_blocks] + 1u);
+    if (!state || !def_pos || !last_use || !weight || !calls)
+        return;
+    /* Use the CFG finalize left behind, or build a private one: this can
+       run on tier-up or prefetch threads, which must not touch the
+       module arena or func->cfg. */
+    cfg = func->cfg ? func->cfg : lr_func_build_cfg(func, cc->arena);
+    memset(def_pos, 0xFF, sizeof(uint32_t) * lr.num_vregs);
+    for (uint32_t i = 0; i < func->num_params && func->param_vregs; i++) {
+        uint32_t v = func->param_vregs[i];
+        const lr_type_t *pty = param_types ? param_types[i] : NULL;
+        if (v < lr.num_vregs)
+            state[v] = x86_regalloc_type_ok(pty) ? X86_RA_OK :
+                       x86_regalloc_fp_type_ok(pty) ? X86_RA_OK_FP :
+                       X86_RA_REJECT;
+    }
+    for (uint32_t li = 0; li < func->block_inst_offsets[func->num_blocks]; li++) {
+        lr_inst_t *inst = func->linear_inst_array[li];
+        uint32_t depth;
+        uint64_t w;
+        if (x86_regalloc_calls_setjmp(cc->mod, inst))
+            return;
+        if (inst->op == LR_OP_CALL || inst->op == LR_OP_FREM)
+            calls[num_calls++] = li + 1u;
+        while (li >= func->block_inst_offsets[bi + 1u])
+            bi++;
+        /* Each def and use weighs 8^loop depth (capped), so values used
+           in inner loops are the last to be spilled. */
+        depth = cfg ? cfg->loop_depth[bi] : 0;
+        w = UINT64_C(1) << (3u * (depth < 4u ? depth : 4u));
+        if (inst->dest < lr.num_vregs)
+            weight[inst->dest] += w;
+        if (inst->dest < lr.num_vregs && inst->op != LR_OP_RET &&
+            inst->op != LR_OP_RET_VOID && inst->op != LR_OP_BR &&
+            inst->op != LR_OP_CONDBR && inst->op != LR_OP_SWITCH &&
+            inst->op != LR_OP_UNREACHABLE &&
+            inst->op != LR_OP_STORE && inst->type &&
+            inst->type->kind != LR_TYPE_VOID) {
+            bool ok = x86_regalloc_def_ok(inst) &&
+                      !(inst->op == LR_OP_LOAD && lr_type_size(inst->type) > 8);
+            uint8_t cls = x86_regalloc_fp_type_ok(inst->type)
+                          ? X86_RA_OK_FP : X86_RA_OK;
+            uint8_t *st = &state[inst->dest];
+            if (!ok || *st == X86_RA_REJECT ||
+                (*st != X86_RA_UNSEEN && *st != cls))
+                *st = X86_RA_REJECT;
+            else
+                *st = cls;
+            if (inst->op != LR_OP_PHI)
+                def_pos[inst->dest] = li + 1u;
+        }
+        for (uint32_t oi = 0; oi < inst->num_operands; oi++) {
+            const lr_operand_t *op = &inst->operands[oi];
+            if (op->kind != LR_VAL_VREG || op->vreg >= lr.num_vregs)
+                continue;
+            if (!x86_regalloc_use_ok(cc, inst, oi, ret_type))
+                state[op->vreg] = X86_RA_REJECT;
+            weight[op->vreg] += w;
+            /* Phi sources are read at the predecessor's terminator. */
+            if (inst->op == LR_OP_PHI)
+                last_use[op->vreg] = UINT32_MAX;
+            else if (last_use[op->vreg] < li + 1u)
+                last_use[op->vreg] = li + 1u;
+        }
+    }
+
+    intervals = lr_arena_array_uninit(cc->arena, uint32_t, 2u * lr.num_vregs);
+    if (!intervals)
+        return;
+    for (uint32_t v = 0; v < lr.num_vregs; v++) {
+        if ((state[v] != X86_RA_OK && state[v] != X86_RA_OK_FP) ||
+            lr.start[v] == UINT32_MAX)
+            continue;
+        /* A value consumed only by the next instruction is already served
+           by the RAX/RCX cache; a register would buy nothing.  XMM values
+           have no such cache. */
+        if (state[v] == X86_RA_OK && def_pos[v] != UINT32_MAX &&
+            last_use[v] <= def_pos[v] + 1u)
+            continue;
+        intervals[2u * num_intervals] = v;
+        intervals[2u * num_intervals + 1u] = lr.start[v];
+        num_intervals++;
+    }
+    if (num_intervals == 0)
+        return;
+    qsort(intervals, num_intervals, 2u * sizeof(uint32_t),
+          x86_regalloc_interval_cmp);
+
+    cc->reg_homes = lr_arena_array_uninit(cc->arena, uint8_t, lr.num_vregs);
+    if (!cc->reg_homes)
+        return;
+    memset(cc->reg_homes, X86_NO_HOME, lr.num_vregs);
+    cc->num_reg_homes = lr.num_vregs;
+    x86_regalloc_scan(cc, &lr, state, weight, intervals, num_intervals,
+                      calls, num_calls, false, reg_used);
+    x86_regalloc_scan(cc, &lr, state, weight, intervals, num_intervals,
+                      calls, num_calls, true, reg_used);
+
+    for (uint32_t r = 0; r < X86_NUM_SAVED_ALLOC_REGS; r++) {
+        if (reg_used[r])
+            cc->saved_regs[cc->num_saved_regs++] = x86_alloc_regs[r];
+    }
+}
+
+static bool function_uses_external_sysv_fp_abi(const lr_compile_func_meta_t *func_meta) {
+    if (!func_meta || !func_meta->func)
+        return false;
+    return func_meta->func->uses_llvm_abi;
+}
+
+static int x86_64_compile_begin(void **compile_ctx,
+                                const lr_compile_func_meta_t *func_meta,
+                                lr_module_t *mod,
+                                uint8_t *buf, size_t buflen,
+                                lr_arena_t *arena) {
+    static const uint8_t param_regs[] = {
+        X86_RDI, X86_RSI, X86_RDX, X86_RCX, X86_R8, X86_R9
+    };
+    static const uint8_t param_fp_regs[] = {
+        X86_XMM0, X86_XMM1, X86_XMM2, X86_XMM3,
+        X86_XMM4, X86_XMM5, X86_XMM6, X86_XMM7
+    };
+    x86_direct_ctx_t *ctx = NULL;
+    uint32_t initial_slots;
+    uint32_t *param_vregs = NULL;
+    uint32_t num_params;
+    bool vararg;
+    lr_type_t *ret_type;
+
+    if (!compile_ctx || !func_meta || !mod || !arena)
+        return -1;
+
+    ctx = lr_arena_new(arena, x86_direct_ctx_t);
+    if (!ctx)
+        return -1;
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->mode = func_meta->mode;
+    ctx->next_vreg = func_meta->next_vreg;
+    ret_type = func_meta->ret_type ? func_meta->ret_type : mod->type_void;
+    ctx->ret_type = ret_type;
+    num_params = func_meta->num_params;
+    vararg = func_meta->vararg;
+    lr_type_t **param_types = func_meta->param_types;
+
+    if (func_meta->func && func_meta->func->param_vregs) {
+        param_vregs = func_meta->func->param_vregs;
+    } else if (num_params > 0) {
+        param_vregs = lr_arena_array(arena, uint32_t, num_params);
+        if (!param_vregs) return -1;
+        for (uint32_t i = 0; i < num_params; i++) {
+            param_vregs[i] = i + 1u;
+            if (ctx->next_vreg <= i + 1u)
+                ctx->next_vreg = i + 2u;
+        }
+    }
+
+    initial_slots = ctx->next_vreg > 64 ? ctx->next_vreg : 64;
+    x86_compile_ctx_t *cc = &ctx->cc;
+    cc->buf = buf;
+    cc->buflen = buflen;
+    cc->pos = 0;
+    cc->stack_size = 0;
+    cc->stack_slots = lr_arena_array(arena, int32_t, initial_slots);
+    cc->stack_slot_sizes = lr_arena_array(arena, uint32_t, initial_slots);
+    cc->num_stack_slots = initial_slots;
+    cc->static_alloca_offsets = NULL;
+    cc->num_static_alloca_offsets = 0;
+    cc->block_offsets = lr_arena_array_uninit(arena, size_t, 8);
+    cc->block_entry_offsets = lr_arena_array_uninit(arena, size_t, 8);
+    cc->num_block_offsets = 8;
+    for (uint32_t i = 0; i < 8; i++) cc->block_offsets[i] = SIZE_MAX;
+    for (uint32_t i = 0; i < 8; i++) cc->block_entry_offsets[i] = SIZE_MAX;
+    cc->fixups = lr_arena_array_uninit(arena, x86_fixup_t, 16);
+    cc->num_fixups = 0;
+    cc->fixup_cap = 16;
+    cc->arena = arena;
+    cc->obj_ctx = mod ? mod->obj_ctx : NULL;
+    cc->reloc_base = cc->obj_ctx ? cc->obj_ctx->num_relocs : 0;
+    cc->mod = mod;
+    cc->jit = func_meta ? func_meta->jit : NULL;
+    cc->cpu_features = func_meta ? func_meta->cpu_features : 0;
+    cc->loop_counter = func_meta ? func_meta->loop_counter : NULL;
+    cc->loop_headers = NULL;
+    if (cc->loop_counter && func_meta->func &&
+        lr_func_is_finalized(func_meta->func))
+        cc->loop_headers = lr_target_loop_headers(func_meta->func, arena);
+    cc->num_loop_headers = cc->loop_headers ? func_meta->func->num_blocks : 0;
+    cc->vreg_uses = NULL;
+    cc->num_vreg_uses = 0;
+    cc->slot_coloring = NULL;
+    lr_target_const_pool_init(&cc->const_pool);
+    /* Copy-patch trades frame size and compare fusion for compile time:
+       every value keeps a slot of its own. */
+    if (func_meta && func_meta->func && lr_func_is_finalized(func_meta->func) &&
+        func_meta->mode != LR_COMPILE_COPY_PATCH) {
+        cc->vreg_uses = lr_target_vreg_use_counts(func_meta->func, arena);
+        if (cc->vreg_uses)
+            cc->num_vreg_uses = func_meta->func->next_vreg;
+        cc->slot_coloring = lr_target_slot_coloring_create(func_meta->func,
+                                                           mod, arena);
+    }
+    cc->sym_defined = NULL;
+    cc->sym_funcs = NULL;
+    cc->sym_count = 0;
+    cc->rax_holds_vreg = UINT32_MAX;
+    cc->rcx_holds_vreg = UINT32_MAX;
+    cc->current_inst = NULL;
+    cc->func_uses_internal_sret = false;
+    cc->sret_ptr_off = 0;
+    cc->func_is_vararg = false;
+    cc->vararg_rsa_off = 0;
+    cc->vararg_named_gp = 0;
+    cc->vararg_named_fp = 0;
+    cc->vararg_named_stack_gp = 0;
+    cc->func_uses_external_sysv_fp = function_uses_external_sysv_fp_abi(func_meta);
+    cc->reg_homes = NULL;
+    cc->num_reg_homes = 0;
+    cc->num_saved_regs = 0;
+    cc->frame_pinned = false;
+    cc->reads_caller_frame = false;
+    cc->incoming_stack_units = 0;
+    cc->epilogue_pos = NULL;
+    cc->num_epilogues = 0;
+    cc->epilogue_cap = 0;
+    cc->func_name = (func_meta->func && func_meta->func->name)
+                        ? func_meta->func->name
+                        : "<anon>";
+
+    attach_obj_symbol_meta_cache(cc);
+
+    ctx->prologue_patch_pos = emit_prologue(cc);
+
+    cc->func_uses_internal_sret = uses_internal_sret_abi(ret_type) &&
+                                  !fp_abi_two_lane_aggregate(ret_type, NULL,
                                                              NULL);
+    /* Stencils address every value through its slot, so copy-patch mode
+       keeps the plain stack layout. */
+    if ((func_meta->codegen_flags & LR_CODEGEN_REGALLOC) &&
+        func_meta->mode != LR_COMPILE_COPY_PATCH &&
+        func_meta->func && lr_func_is_finalized(func_meta->func)) {
+        x86_regalloc_assign(cc, func_meta->func, ret_type, param_types);
+        for (uint32_t i = 0; i < cc->num_saved_regs; i++) {
+            cc->saved_reg_offs[i] = alloc_temp_slot(cc, 8, 8);
+            encode_mem(cc->buf, &cc->pos, cc->buflen, 0x89,
+                       cc->saved_regs[i], X86_RBP, cc->saved_reg_offs[i], 8);
+        }
+    }
     if (cc->func_uses_internal_sret) {
         cc->sret_ptr_off = alloc_temp_slot(cc, 8, 8);
         emit_mem_store_sized(cc, X86_RDI, X86_RBP, cc->sret_ptr_off, 8);
     }
 
-    {
-        uint32_t gp_used = cc->func_uses_internal_sret ? 1u : 0u;
-        uint32_t fp_used = 0u;
-        uint32_t stack_used = 0u;
-        uint32_t named_gp_total = cc->func_uses_internal_sret ? 1u : 0u;
-        uint32_t named_fp_total = 0u;
+    {
+        uint32_t gp_used = cc->func_uses_internal_sret ? 1u : 0u;
+        uint32_t fp_used = 0u;
+        uint32_t stack_used = 0u;
+        uint32_t named_gp_total = cc->func_uses_internal_sret ? 1u : 0u;
+        uint32_t named_fp_total = 0u;
+        lr_cc_loc_t *fast_locs = NULL;
+
+        if (func_meta->func && func_meta->func->fast_cc && num_params > 0) {
+            fast_locs = lr_arena_array(arena, lr_cc_loc_t, num_params);
+            if (!fast_locs)
+                return -1;
+            stack_used = lr_target_fast_cc_assign(param_types, num_params,
+                                                  6, 8, fast_locs);
+        }
+
+        for (uint32_t i = 0; i < num_params; i++) {
+            const lr_type_t *pty = NULL;
+            uint8_t agg_lane_size = 0;
+            uint8_t agg_lane_count = 0;
+            uint32_t agg_stack_units = 0;
+            if (param_types)
+                pty = param_types[i];
+
+            if (fast_locs) {
+                const lr_cc_loc_t *loc = &fast_locs[i];
+                if (loc->kind == LR_CC_LOC_FP && is_fp_abi_type(pty)) {
+                    emit_store_fp_slot(cc, param_vregs[i],
+                                       param_fp_regs[loc->index],
+                                       fp_abi_size(pty));
+                } else if (loc->kind == LR_CC_LOC_FP) {
+                    /* movq rax, xmm */
+                    emit_0f_rr(cc, 0x66, 0x7E, param_fp_regs[loc->index],
+                               X86_RAX, 8);
+                    emit_store_slot(cc, param_vregs[i], X86_RAX);
+                } else if (loc->kind == LR_CC_LOC_GP) {
+                    emit_store_slot(cc, param_vregs[i],
+                                    param_regs[loc->index]);
+                } else {
+                    encode_mem(cc->buf, &cc->pos, cc->buflen, 0x8B,
+                               X86_RAX, X86_RBP,
+                               16 + (int32_t)(loc->index * 8u), 8);
+                    emit_store_slot(cc, param_vregs[i], X86_RAX);
+                }
+                continue;
+            }
+            if (fp_abi_two_lane_aggregate(pty, &agg_lane_size,
+                                          &agg_lane_count))
+                agg_stack_units = (uint32_t)(((uint32_t)agg_lane_size *
+                                              (uint32_t)agg_lane_count + 7u) / 8u);
+
+            if (cc->func_uses_external_sysv_fp) {
+                if (is_fp_abi_type(pty))
+                    named_fp_total++;
+                else if (agg_stack_units != 0)
+                    named_fp_total += agg_lane_count;
+                else
+                    named_gp_total++;
+            } else {
+                named_gp_total++;
+            }
+
+            if (cc->func_uses_external_sysv_fp) {
+                if (is_fp_abi_type(pty) && fp_used < 8) {
+                    emit_store_fp_slot(cc, param_vregs[i], param_fp_regs[fp_used],
+                                       fp_abi_size(pty));
+                    fp_used++;
+                    continue;
+                }
+
+                if (agg_stack_units != 0 && fp_used + agg_lane_count <= 8) {
+                    size_t dst_sz = lr_type_size(pty);
+                    size_t dst_align = lr_type_align(pty);
+                    int32_t dst_off;
+                    if (dst_align < 8) dst_align = 8;
+                    if (dst_sz < 8) dst_sz = 8;
+                    dst_off = alloc_slot(cc, param_vregs[i], dst_sz, dst_align);
+                    emit_store_fp_mem_base(cc, X86_RBP, dst_off,
+                                           param_fp_regs[fp_used], agg_lane_size);
+                    if (agg_lane_count > 1 &&
+                        dst_sz >= (size_t)(2u * (size_t)agg_lane_size)) {
+                        emit_store_fp_mem_base(cc, X86_RBP,
+                                               dst_off + (int32_t)agg_lane_size,
+                                               param_fp_regs[fp_used + 1],
+                                               agg_lane_size);
+                    }
+                    fp_used += agg_lane_count;
+                    continue;
+                }
+
+                if (!is_fp_abi_type(pty) && agg_stack_units == 0 && gp_used < 6) {
+                    emit_store_slot(cc, param_vregs[i], param_regs[gp_used]);
+                    gp_used++;
+                    continue;
+                }
+
+                {
+                    int32_t caller_off = 16 + (int32_t)(stack_used * 8u);
+                    if (is_fp_abi_type(pty)) {
+                        uint8_t fsize = fp_abi_size(pty);
+                        emit_load_fp_mem_base(cc, X86_RBP, caller_off,
+                                              FP_SCRATCH0, fsize);
+                        emit_store_fp_slot(cc, param_vregs[i], FP_SCRATCH0, fsize);
+                        stack_used++;
+                    } else if (agg_stack_units != 0) {
+                        size_t dst_sz = lr_type_size(pty);
+                        size_t dst_align = lr_type_align(pty);
+                        int32_t dst_off;
+                        if (dst_align < 8) dst_align = 8;
+                        if (dst_sz < 8) dst_sz = 8;
+                        dst_off = alloc_slot(cc, param_vregs[i], dst_sz, dst_align);
+                        emit_load_fp_mem_base(cc, X86_RBP, caller_off,
+                                              FP_SCRATCH0, agg_lane_size);
+                        emit_store_fp_mem_base(cc, X86_RBP, dst_off,
+                                               FP_SCRATCH0, agg_lane_size);
+                        if (agg_stack_units > 1 &&
+                            dst_sz >= (size_t)(2u * (size_t)agg_lane_size)) {
+                            emit_load_fp_mem_base(cc, X86_RBP,
+                                                  caller_off + (int32_t)agg_lane_size,
+                                                  FP_SCRATCH0, agg_lane_size);
+                            emit_store_fp_mem_base(cc, X86_RBP,
+                                                   dst_off + (int32_t)agg_lane_size,
+                                                   FP_SCRATCH0, agg_lane_size);
+                        }
+                        stack_used += agg_stack_units;
+                    } else {
+                        encode_mem(cc->buf, &cc->pos, cc->buflen, 0x8B,
+                                   X86_RAX, X86_RBP, caller_off, 8);
+                        emit_store_slot(cc, param_vregs[i], X86_RAX);
+                        stack_used++;
+                    }
+                }
+                continue;
+            }
+
+            if (gp_used < 6) {
+                emit_store_slot(cc, param_vregs[i], param_regs[gp_used]);
+                gp_used++;
+            } else {
+                int32_t caller_off = 16 + (int32_t)((gp_used - 6u) * 8u);
+                encode_mem(cc->buf, &cc->pos, cc->buflen, 0x8B,
+                           X86_RAX, X86_RBP, caller_off, 8);
+                emit_store_slot(cc, param_vregs[i], X86_RAX);
+                gp_used++;
+            }
+        }
+
+        cc->reads_caller_frame = stack_used > 0 || gp_used > 6;
+        cc->incoming_stack_units = gp_used > 6 ? stack_used + gp_used - 6u
+                                               : stack_used;
+        if (vararg) {
+            uint32_t named_gp_regs = named_gp_total;
+            uint32_t named_fp_regs = named_fp_total;
+            if (named_gp_regs > 6)
+                named_gp_regs = 6;
+            if (named_fp_regs > 8)
+                named_fp_regs = 8;
+            cc->vararg_named_gp = named_gp_regs;
+            cc->vararg_named_fp = named_fp_regs;
+            cc->vararg_named_stack_gp =
+                named_gp_total > 6 ? named_gp_total - 6 : 0;
+        }
+    }
+
+    cc->func_is_vararg = vararg;
+    if (vararg) {
+        /* SysV register save area: 6*8 GP + 8*16 FP = 176 bytes. */
+        cc->vararg_rsa_off = alloc_temp_slot(cc, 176, 16);
+        for (uint32_t i = 0; i < 6; i++)
+            emit_mem_store_sized(cc, param_regs[i], X86_RBP,
+                                 cc->vararg_rsa_off + (int32_t)(i * 8), 8);
+        for (uint32_t i = 0; i < 8; i++) {
+            emit_store_fp_mem_base(cc, X86_RBP,
+                                   cc->vararg_rsa_off + 48 + (int32_t)(i * 16),
+                                   param_fp_regs[i], 8);
+        }
+    }
+
+    *compile_ctx = ctx;
+    return 0;
+}
+
+static int x86_64_compile_set_block(void *compile_ctx, uint32_t block_id) {
+    x86_direct_ctx_t *ctx = (x86_direct_ctx_t *)compile_ctx;
+    if (!ctx)
+        return -1;
+    /* Flush deferred terminators on block transitions so branch fixups
+       are emitted before binding the next block entry. This also guarantees
+       empty blocks are assigned offsets instead of leaving placeholder
+       branch displacements unresolved. */
+    if (ctx->deferred.pending &&
+        (!ctx->has_current_block || ctx->deferred.block_id != block_id)) {
+        if (flush_deferred_terminator(ctx) != 0)
+            return -1;
+    }
+    if (direct_ensure_block_offsets(ctx, block_id) != 0)
+        return -1;
+    ctx->current_block_id = block_id;
+    ctx->has_current_block = true;
+    if (ctx->cc.block_offsets[block_id] == SIZE_MAX) {
+        ctx->cc.block_offsets[block_id] = ctx->cc.pos;
+        ctx->cc.block_entry_offsets[block_id] = ctx->cc.pos;
+        if (block_id < ctx->cc.num_loop_headers &&
+            ctx->cc.loop_headers[block_id])
+            emit_profile_count(&ctx->cc);
+    }
+    /* Entering a new block must invalidate cached register mappings before
+       emitting non-PHI instructions, but keep offsets bound for empty blocks. */
+    ctx->block_offset_pending = true;
+    return 0;
+}
+
+/* Internal calls pass aggregates wider than 8 bytes by address: the callee
+   keeps the incoming pointer in an 8-byte slot, which
+   vreg_uses_indirect_aggregate_storage recognizes.  Values already held
+   that way go through emit_load_operand unchanged; full-size slots are
+   passed by lea and constants are materialized in a temporary first. */
+static bool emit_aggregate_call_arg(x86_compile_ctx_t *cc,
+                                    const lr_operand_t *op, uint8_t reg) {
+    size_t total;
+    int32_t off;
+    if (!uses_internal_sret_abi(op->type))
+        return false;
+    total = lr_type_size(op->type);
+    if (op->kind == LR_VAL_VREG) {
+        if (op->vreg >= cc->num_stack_slots ||
+            cc->stack_slots[op->vreg] == 0 ||
+            cc->stack_slot_sizes[op->vreg] < total)
+            return false;
+        off = cc->stack_slots[op->vreg];
+    } else if (op->kind == LR_VAL_UNDEF || op->kind == LR_VAL_NULL ||
+               op->kind == LR_VAL_IMM_I64) {
+        off = alloc_temp_slot(cc, align_up(total, 8), 16);
+        emit_mem_zero_base(cc, X86_RBP, off, total);
+        if (op->kind == LR_VAL_IMM_I64) {
+            emit_mov_imm(cc, X86_RAX, op->imm_i64, false);
+            emit_mem_store_sized(cc, X86_RAX, X86_RBP, off, 8);
+        }
+        invalidate_cached_reg(cc, X86_RAX);
+    } else {
+        return false;
+    }
+    encode_mem(cc->buf, &cc->pos, cc->buflen, 0x8D, reg, X86_RBP, off, 8);
+    invalidate_cached_reg(cc, reg);
+    return true;
+}
+
+/* A call marked tail (and found in tail position by the replay) becomes a
+   jump when nothing it is handed lives in our frame and its stack
+   arguments fit in our own incoming area.  Both sides must agree on the
+   hidden result pointer, which is then passed straight through.  Calls
+   failing this, musttail included, stay ordinary calls. */
+static bool x86_can_tail_call(const x86_compile_ctx_t *cc,
+                              const lr_compile_inst_desc_t *desc,
+                              const lr_operand_t *ops, uint32_t stack_args,
+                              bool internal_sret) {
+    if (desc->call_tail == LR_CALL_TAIL_NONE ||
+        internal_sret != cc->func_uses_internal_sret)
+        return false;
+    if (stack_args > 0 &&
+        (cc->func_is_vararg || stack_args > cc->incoming_stack_units))
+        return false;
+    for (uint32_t i = 1; i < desc->num_operands; i++) {
+        if (uses_internal_sret_abi(ops[i].type))
+            return false;
+        if (ops[i].kind == LR_VAL_VREG &&
+            lr_target_lookup_static_alloca_offset(
+                cc->static_alloca_offsets, cc->num_static_alloca_offsets,
+                ops[i].vreg) != 0)
+            return false;
+    }
+    return true;
+}
+
+/* ---- Vector lowering ---- */
+
+/*
+ * Vector values live in stack slots like other aggregates, one element per
+ * lane at lr_type_size(elem) spacing (i1 lanes take a byte each).  Whole
+ * vectors are processed 16 bytes at a time in XMM2-XMM5 with SSE2 packed
+ * instructions; vectors of 4 or 8 bytes use the low lanes of a register.
+ * Operations without a packed form (division, i8/i64 multiply, variable
+ * shifts, casts, ...) are scalarized: each lane is copied into a reserved
+ * lane vreg and the scalar instruction is emitted through the normal ISel
+ * path, so lane semantics always match the scalar lowering.
+ */
+
+#define X86_VEC_A   X86_XMM2
+#define X86_VEC_B   X86_XMM3
+#define X86_VEC_T   X86_XMM4
+#define X86_VEC_T2  X86_XMM5
+
+static int x86_64_compile_emit(void *compile_ctx,
+                               const lr_compile_inst_desc_t *desc);
+
+typedef struct x86_vec_layout {
+    const lr_type_t *elem;
+    uint32_t lanes;
+    uint8_t esz;
+    size_t total;
+} x86_vec_layout_t;
+
+typedef enum {
+    X86_VEC_ZERO,       /* undef, null or zeroinitializer */
+    X86_VEC_FRAME,      /* bytes at [rbp + off] */
+    X86_VEC_INDIRECT,   /* pointer to the bytes at [rbp + off] */
+    X86_VEC_PTR,        /* operand is the address of the bytes */
+} x86_vec_src_kind_t;
+
+typedef struct x86_vec_src {
+    x86_vec_src_kind_t kind;
+    int32_t off;
+    lr_operand_t op;
+} x86_vec_src_t;
+
+static bool x86_vec_layout(const lr_type_t *ty, x86_vec_layout_t *out) {
+    const lr_type_t *elem;
+    if (!ty || ty->kind != LR_TYPE_VECTOR || !ty->array.elem ||
+        ty->array.count == 0 || ty->array.count > 4096)
+        return false;
+    elem = ty->array.elem;
+    switch (elem->kind) {
+    case LR_TYPE_I1: case LR_TYPE_I8: case LR_TYPE_I16:
+    case LR_TYPE_I32: case LR_TYPE_I64: case LR_TYPE_PTR:
+    case LR_TYPE_FLOAT: case LR_TYPE_DOUBLE:
+        break;
+    default:
+        return false;
+    }
+    out->elem = elem;
+    out->lanes = (uint32_t)ty->array.count;
+    out->esz = (uint8_t)lr_type_size(elem);
+    out->total = (size_t)out->esz * out->lanes;
+    return true;
+}
+
+static bool x86_vec_is_fp(const x86_vec_layout_t *l) {
+    return l->elem->kind == LR_TYPE_FLOAT || l->elem->kind == LR_TYPE_DOUBLE;
+}
+
+/* Bytes per packed step, or 0 when the vector has no packed form. */
+static uint8_t x86_vec_chunk(const x86_vec_layout_t *l) {
+    if (l->total % 16 == 0)
+        return 16;
+    if (l->total == 8 || l->total == 4)
+        return (uint8_t)l->total;
+    return 0;
+}
+
+static uint8_t x86_vec_log2(uint8_t esz) {
+    return esz == 1 ? 0 : esz == 2 ? 1 : esz == 4 ? 2 : 3;
+}
+
+static int32_t x86_vec_dest_slot(x86_compile_ctx_t *cc, uint32_t dest,
+                                 size_t total) {
+    return alloc_slot(cc, dest, total, 16);
+}
+
+/* Constants are written to a fresh frame temporary: an integer immediate
+   is the packed low eight bytes of the vector (zero above, as phi copies
+   treat it), an FP immediate is splatted across the lanes. */
+static void x86_vec_src_init(x86_compile_ctx_t *cc, const lr_operand_t *op,
+                             const x86_vec_layout_t *l, x86_vec_src_t *out) {
+    memset(out, 0, sizeof(*out));
+    switch (op->kind) {
+    case LR_VAL_UNDEF:
+    case LR_VAL_NULL:
+        out->kind = X86_VEC_ZERO;
+        return;
+    case LR_VAL_IMM_I64:
+        if (op->imm_i64 == 0) {
+            out->kind = X86_VEC_ZERO;
+            return;
+        }
+        out->kind = X86_VEC_FRAME;
+        out->off = alloc_temp_slot(cc, align_up(l->total, 8), 16);
+        if (l->total > 8)
+            emit_mem_zero_base(cc, X86_RBP, out->off + 8, l->total - 8);
+        emit_mov_imm(cc, X86_RAX, op->imm_i64, false);
+        emit_mem_store_sized(cc, X86_RAX, X86_RBP, out->off, 8);
+        return;
+    case LR_VAL_IMM_F64: {
+        lr_operand_t lane = *op;
+        lane.type = (lr_type_t *)l->elem;
+        out->kind = X86_VEC_FRAME;
+        out->off = alloc_temp_slot(cc, align_up(l->total, 8), 16);
+        emit_load_operand(cc, &lane, X86_RAX);
+        for (uint32_t i = 0; i < l->lanes; i++)
+            emit_mem_store_sized(cc, X86_RAX, X86_RBP,
+                                 out->off + (int32_t)(i * l->esz), l->esz);
+        return;
+    }
+    case LR_VAL_VREG: {
+        uint32_t v = op->vreg;
+        if (v >= cc->num_stack_slots || cc->stack_slots[v] == 0) {
+            out->kind = X86_VEC_FRAME;
+            out->off = alloc_slot(cc, v, l->total, 16);
+            return;
+        }
+        out->off = cc->stack_slots[v];
+        out->kind = vreg_uses_indirect_aggregate_storage(cc, v, l->total)
+                    ? X86_VEC_INDIRECT : X86_VEC_FRAME;
+        return;
+    }
+    default:
+        out->kind = X86_VEC_PTR;
+        out->op = *op;
+        return;
+    }
+}
+
+/* Resolve src to [base + disp], loading a pointer into reg if needed. */
+static void x86_vec_src_addr(x86_compile_ctx_t *cc, const x86_vec_src_t *src,
+                             uint8_t reg, uint8_t *base, int32_t *disp) {
+    *base = X86_RBP;
+    *disp = 0;
+    switch (src->kind) {
+    case X86_VEC_FRAME:
+        *disp = src->off;
+        return;
+    case X86_VEC_INDIRECT:
+        encode_mem(cc->buf, &cc->pos, cc->buflen, 0x8B, reg, X86_RBP,
+                   src->off, 8);
+        invalidate_cached_reg(cc, reg);
+        *base = reg;
+        return;
+    case X86_VEC_PTR:
+        emit_load_operand(cc, &src->op, reg);
+        invalidate_cached_reg(cc, reg);
+        *base = reg;
+        return;
+    case X86_VEC_ZERO:
+        return;
+    }
+}
+
+/* 66 0F op /r on two XMM registers (packed-integer form). */
+static void x86_vec_rr(x86_compile_ctx_t *cc, uint8_t op, uint8_t dst,
+                       uint8_t src) {
+    emit_0f_rr(cc, 0x66, op, dst, src, 4);
+}
+
+/* psll/psrl/psra by immediate: 66 0F op /ext ib. */
+static void x86_vec_shift_imm(x86_compile_ctx_t *cc, uint8_t op, uint8_t ext,
+                              uint8_t xmm, uint8_t count) {
+    emit_0f_rr(cc, 0x66, op, ext, xmm, 4);
+    emit_byte(cc->buf, &cc->pos, cc->buflen, count);
+}
+
+static void x86_vec_pshufd(x86_compile_ctx_t *cc, uint8_t dst, uint8_t src,
+                           uint8_t order) {
+    emit_0f_rr(cc, 0x66, 0x70, dst, src, 4);
+    emit_byte(cc->buf, &cc->pos, cc->buflen, order);
+}
+
+/* movd xmm, eax or movd eax, xmm. */
+static void x86_vec_movd_from_eax(x86_compile_ctx_t *cc, uint8_t xmm) {
+    emit_0f_rr(cc, 0x66, 0x6E, xmm, X86_RAX, 4);
+}
+
+static void x86_vec_movd_to_eax(x86_compile_ctx_t *cc, uint8_t xmm) {
+    emit_0f_rr(cc, 0x66, 0x7E, xmm, X86_RAX, 4);
+    invalidate_cached_reg(cc, X86_RAX);
+}
+
+/* Load the low n bytes (16, 8, 4, 2 or 1) of xmm from memory, zeroing the
+   rest. */
+static void x86_vec_load_mem(x86_compile_ctx_t *cc, uint8_t xmm,
+                             uint8_t base, int32_t disp, size_t n) {
+    if (n == 16) {
+        encode_sse_mem(cc->buf, &cc->pos, cc->buflen, 0xF3, 0x6F, 0,
+                       xmm, base, disp);
+    } else if (n == 8) {
+        encode_sse_mem(cc->buf, &cc->pos, cc->buflen, 0xF3, 0x7E, 0,
+                       xmm, base, disp);
+    } else if (n == 4) {
+        encode_sse_mem(cc->buf, &cc->pos, cc->buflen, 0x66, 0x6E, 0,
+                       xmm, base, disp);
+    } else {
+        emit_mem_load_sized(cc, X86_RAX, base, disp, (uint8_t)n);
+        invalidate_cached_reg(cc, X86_RAX);
+        x86_vec_movd_from_eax(cc, xmm);
+    }
+}
+
+/* Store the low n bytes (16, 8, 4, 2 or 1) of xmm. */
+static void x86_vec_store_mem(x86_compile_ctx_t *cc, uint8_t xmm,
+                              uint8_t base, int32_t disp, size_t n) {
+    if (n == 16) {
+        encode_sse_mem(cc->buf, &cc->pos, cc->buflen, 0xF3, 0x7F, 0,
+                       xmm, base, disp);
+    } else if (n == 8) {
+        encode_sse_mem(cc->buf, &cc->pos, cc->buflen, 0x66, 0xD6, 0,
+                       xmm, base, disp);
+    } else if (n == 4) {
+        encode_sse_mem(cc->buf, &cc->pos, cc->buflen, 0x66, 0x7E, 0,
+                       xmm, base, disp);
+    } else {
+        x86_vec_movd_to_eax(cc, xmm);
+        emit_mem_store_sized(cc, X86_RAX, base, disp, (uint8_t)n);
+    }
+}
+
+static void x86_vec_load_src(x86_compile_ctx_t *cc, uint8_t xmm,
+                             const x86_vec_src_t *src, uint8_t base,
+                             int32_t disp, size_t n) {
+    if (src->kind == X86_VEC_ZERO)
+        x86_vec_rr(cc, 0xEF, xmm, xmm);
+    else
+        x86_vec_load_mem(cc, xmm, base, disp, n);
+}
+
+/* 32-byte (ymm) forms for AVX2 code: vmovdqu load/store, or vpxor for a
+   zero source. */
+static void x86_vec_load_src256(x86_compile_ctx_t *cc, uint8_t ymm,
+                                const x86_vec_src_t *src, uint8_t base,
+                                int32_t disp) {
+    if (src->kind == X86_VEC_ZERO)
+        encode_vex_rr(cc->buf, &cc->pos, cc->buflen, 1, 1, false, true,
+                      0xEF, ymm, ymm, ymm);
+    else
+        encode_vex_mem(cc->buf, &cc->pos, cc->buflen, 1, 2, true, 0x6F,
+                       ymm, base, disp);
+}
 
-        for (uint32_t i = 0; i < num_params; i++) {
-            const lr_type_t *pty = NULL;
-            uint8_t agg_lane_size = 0;
-            uint8_t agg_lane_count = 0;
-            uint32_t agg_stack_units = 0;
-            if (param_types)
-                pty = param_types[i];
-            if (fp_abi_two_lane_aggregate(pty, &agg_lane_size,
-                                          &agg_lane_count))
-                agg_stack_units = (uint32_t)(((uint32_t)agg_lane_size *
-                                              (uint32_t)agg_lane_count + 7u) / 8u);
+static void x86_vec_store_mem256(x86_compile_ctx_t *cc, uint8_t ymm,
+                                 uint8_t base, int32_t disp) {
+    encode_vex_mem(cc->buf, &cc->pos, cc->buflen, 1, 2, true, 0x7F,
+                   ymm, base, disp);
+}
 
-            if (cc->func_uses_external_sysv_fp) {
-                if (is_fp_abi_type(pty))
-                    named_fp_total++;
-                else if (agg_stack_units != 0)
-                    named_fp_total += agg_lane_count;
-                else
-                    named_gp_total++;
-            } else {
-                named_gp_total++;
-            }
+/* Copy total bytes of src to [dst_base + dst_disp]. */
+static void x86_vec_copy(x86_compile_ctx_t *cc, const x86_vec_src_t *src,
+                         uint8_t dst_base, int32_t dst_disp, size_t total) {
+    uint8_t base;
+    int32_t disp;
+    size_t off = 0;
+    if (src->kind == X86_VEC_ZERO) {
+        emit_mem_zero_base(cc, dst_base, dst_disp, total);
+        return;
+    }
+    x86_vec_src_addr(cc, src, X86_R10, &base, &disp);
+    for (; total - off >= 16; off += 16) {
+        x86_vec_load_mem(cc, X86_VEC_A, base, disp + (int32_t)off, 16);
+        x86_vec_store_mem(cc, X86_VEC_A, dst_base, dst_disp + (int32_t)off, 16);
+    }
+    if (off < total)
+        emit_mem_copy_base_to_base(cc, dst_base, dst_disp + (int32_t)off,
+                                   base, disp + (int32_t)off, total - off);
+}
 
-            if (cc->func_uses_external_sysv_fp) {
-                if (is_fp_abi_type(pty) && fp_used < 8) {
-                    emit_store_fp_slot(cc, param_vregs[i], param_fp_regs[fp_used],
-                                       fp_abi_size(pty));
-                    fp_used++;
-                    continue;
-                }
+/* Broadcast a 32-bit pattern to every dword of xmm. */
+static void x86_vec_splat32(x86_compile_ctx_t *cc, uint8_t xmm,
+                            uint32_t pattern) {
+    emit_mov_imm(cc, X86_RAX, (int64_t)pattern, false);
+    x86_vec_movd_from_eax(cc, xmm);
+    x86_vec_pshufd(cc, xmm, xmm, 0x00);
+}
 
-                if (agg_stack_units != 0 && fp_used + agg_lane_count <= 8) {
-                    size_t dst_sz = lr_type_size(pty);
-                    size_t dst_align = lr_type_align(pty);
-                    int32_t dst_off;
-                    if (dst_align < 8) dst_align = 8;
-                    if (dst_sz < 8) dst_sz = 8;
-                    dst_off = alloc_slot(cc, param_vregs[i], dst_sz, dst_align);
-                    emit_store_fp_mem_base(cc, X86_RBP, dst_off,
-                                           param_fp_regs[fp_used], agg_lane_size);
-                    if (agg_lane_count > 1 &&
-                        dst_sz >= (size_t)(2u * (size_t)agg_lane_size)) {
-                        emit_store_fp_mem_base(cc, X86_RBP,
-                                               dst_off + (int32_t)agg_lane_size,
-                                               param_fp_regs[fp_used + 1],
-                                               agg_lane_size);
-                    }
-                    fp_used += agg_lane_count;
-                    continue;
-                }
+/* Turn all-ones/zero lane masks in A into one 0/1 byte per lane, packed
+   into the low bytes of A. */
+static void x86_vec_mask_to_bytes(x86_compile_ctx_t *cc, uint8_t esz) {
+    if (esz == 8)
+        x86_vec_pshufd(cc, X86_VEC_A, X86_VEC_A, 0x08);
+    if (esz >= 4)
+        x86_vec_rr(cc, 0x6B, X86_VEC_A, X86_VEC_A);     /* packssdw */
+    if (esz >= 2)
+        x86_vec_rr(cc, 0x63, X86_VEC_A, X86_VEC_A);     /* packsswb */
+    x86_vec_rr(cc, 0xEF, X86_VEC_T, X86_VEC_T);
+    x86_vec_rr(cc, 0xF8, X86_VEC_T, X86_VEC_A);         /* psubb */
+    x86_vec_rr(cc, 0x6F, X86_VEC_A, X86_VEC_T);         /* movdqa */
+}
 
-                if (!is_fp_abi_type(pty) && agg_stack_units == 0 && gp_used < 6) {
-                    emit_store_slot(cc, param_vregs[i], param_regs[gp_used]);
-                    gp_used++;
-                    continue;
-                }
+/* Packed opcode (66 0F op) for an integer binop, or 0. */
+static uint8_t x86_vec_int_binop(lr_opcode_t op, const x86_vec_layout_t *l) {
+    static const uint8_t add[4] = {0xFC, 0xFD, 0xFE, 0xD4};
+    static const uint8_t sub[4] = {0xF8, 0xF9, 0xFA, 0xFB};
+    bool is_i1 = l->elem->kind == LR_TYPE_I1;
+    switch (op) {
+    case LR_OP_ADD: return is_i1 ? 0 : add[x86_vec_log2(l->esz)];
+    case LR_OP_SUB: return is_i1 ? 0 : sub[x86_vec_log2(l->esz)];
+    case LR_OP_AND: return 0xDB;
+    case LR_OP_OR:  return 0xEB;
+    case LR_OP_XOR: return 0xEF;
+    case LR_OP_MUL: return l->esz == 2 ? 0xD5 : 0;
+    default:        return 0;
+    }
+}
 
-                {
-                    int32_t caller_off = 16 + (int32_t)(stack_used * 8u);
-                    if (is_fp_abi_type(pty)) {
-                        uint8_t fsize = fp_abi_size(pty);
-                        emit_load_fp_mem_base(cc, X86_RBP, caller_off,
-                                              FP_SCRATCH0, fsize);
-                        emit_store_fp_slot(cc, param_vregs[i], FP_SCRATCH0, fsize);
-                        stack_used++;
-                    } else if (agg_stack_units != 0) {
-                        size_t dst_sz = lr_type_size(pty);
-                        size_t dst_align = lr_type_align(pty);
-                        int32_t dst_off;
-                        if (dst_align < 8) dst_align = 8;
-                        if (dst_sz < 8) dst_sz = 8;
-                        dst_off = alloc_slot(cc, param_vregs[i], dst_sz, dst_align);
-                        emit_load_fp_mem_base(cc, X86_RBP, caller_off,
-                                              FP_SCRATCH0, agg_lane_size);
-                        emit_store_fp_mem_base(cc, X86_RBP, dst_off,
-                                               FP_SCRATCH0, agg_lane_size);
-                        if (agg_stack_units > 1 &&
-                            dst_sz >= (size_t)(2u * (size_t)agg_lane_size)) {
-                            emit_load_fp_mem_base(cc, X86_RBP,
-                                                  caller_off + (int32_t)agg_lane_size,
-                                                  FP_SCRATCH0, agg_lane_size);
-                            emit_store_fp_mem_base(cc, X86_RBP,
-                                                   dst_off + (int32_t)agg_lane_size,
-                                                   FP_SCRATCH0, agg_lane_size);
-                        }
-                        stack_used += agg_stack_units;
-                    } else {
-                        encode_mem(cc->buf, &cc->pos, cc->buflen, 0x8B,
-                                   X86_RAX, X86_RBP, caller_off, 8);
-                        emit_store_slot(cc, param_vregs[i], X86_RAX);
-                        stack_used++;
-                    }
-                }
-                continue;
-            }
+/* Shift count for a shift whose amount is one immediate in every lane. */
+static bool x86_vec_uniform_shift(const lr_operand_t *amt,
+                                  const x86_vec_layout_t *l,
+                                  uint8_t *count) {
+    uint64_t raw;
+    uint64_t lane_mask;
+    uint64_t first;
+    if (amt->kind != LR_VAL_IMM_I64 || l->total > 8)
+        return false;
+    raw = (uint64_t)amt->imm_i64;
+    lane_mask = l->esz == 8 ? UINT64_MAX : ((uint64_t)1 << (l->esz * 8)) - 1u;
+    first = raw & lane_mask;
+    for (uint32_t i = 1; i < l->lanes; i++) {
+        if (((raw >> (i * l->esz * 8u)) & lane_mask) != first)
+            return false;
+    }
+    if (first >= (uint64_t)l->esz * 8u)
+        return false;
+    *count = (uint8_t)first;
+    return true;
+}
 
-            if (gp_used < 6) {
-                emit_store_slot(cc, param_vregs[i], param_regs[gp_used]);
-                gp_used++;
+/* Emit desc once per lane as a scalar instruction on the reserved lane
+   vregs, staging operand lanes and the result lane through memory. */
+static int x86_vec_emit_per_lane(x86_direct_ctx_t *ctx,
+                                 const lr_compile_inst_desc_t *desc,
+                                 const lr_operand_t *ops) {
+    x86_compile_ctx_t *cc = &ctx->cc;
+    x86_vec_layout_t dl;
+    x86_vec_layout_t sl[3];
+    x86_vec_src_t src[3];
+    bool is_vec[3];
+    lr_operand_desc_t lane_ops[3];
+    lr_compile_inst_desc_t lane;
+    lr_compile_mode_t saved_mode = ctx->mode;
+    uint32_t nops = desc->num_operands;
+    uint32_t base_vreg;
+    int32_t lane_off[4];
+    int32_t dst_off;
+    int rc = 0;
+
+    if (nops > 3 || !x86_vec_layout(desc->type, &dl))
+        return -1;
+    if (ctx->vec_lane_vregs == 0) {
+        ctx->vec_lane_vregs = ctx->next_vreg;
+        ctx->next_vreg += 4u;
+    }
+    base_vreg = ctx->vec_lane_vregs;
+    for (uint32_t j = 0; j < 4; j++)
+        lane_off[j] = alloc_slot(cc, base_vreg + j, 8, 8);
+    dst_off = x86_vec_dest_slot(cc, desc->dest, dl.total);
+
+    for (uint32_t j = 0; j < nops; j++) {
+        is_vec[j] = x86_vec_layout(ops[j].type, &sl[j]);
+        if (is_vec[j]) {
+            if (sl[j].lanes != dl.lanes)
+                return -1;
+            x86_vec_src_init(cc, &ops[j], &sl[j], &src[j]);
+            memset(&lane_ops[j], 0, sizeof(lane_ops[j]));
+            lane_ops[j].kind = LR_OP_KIND_VREG;
+            lane_ops[j].vreg = base_vreg + j;
+            lane_ops[j].type = (lr_type_t *)sl[j].elem;
+        } else {
+            lane_ops[j] = desc->operands[j];
+        }
+    }
+    lane = *desc;
+    lane.type = (lr_type_t *)dl.elem;
+    lane.dest = base_vreg + 3u;
+    lane.operands = lane_ops;
+
+    ctx->mode = LR_COMPILE_ISEL;
+    for (uint32_t i = 0; i < dl.lanes && rc == 0; i++) {
+        for (uint32_t j = 0; j < nops; j++) {
+            uint8_t base;
+            int32_t disp;
+            if (!is_vec[j])
+                continue;
+            if (src[j].kind == X86_VEC_ZERO) {
+                emit_mov_imm(cc, X86_RAX, 0, false);
             } else {
-                int32_t caller_off = 16 + (int32_t)((gp_used - 6u) * 8u);
-                encode_mem(cc->buf, &cc->pos, cc->buflen, 0x8B,
-                           X86_RAX, X86_RBP, caller_off, 8);
-                emit_store_slot(cc, param_vregs[i], X86_RAX);
-                gp_used++;
+                x86_vec_src_addr(cc, &src[j], X86_R11, &base, &disp);
+                emit_mem_load_sized(cc, X86_RAX, base,
+                                    disp + (int32_t)(i * sl[j].esz),
+                                    sl[j].esz);
             }
+            emit_mem_store_sized(cc, X86_RAX, X86_RBP, lane_off[j], 8);
         }
+        invalidate_cached_gprs(cc);
+        rc = x86_64_compile_emit(ctx, &lane);
+        invalidate_cached_gprs(cc);
+        emit_mem_load_sized(cc, X86_RAX, X86_RBP, lane_off[3], dl.esz);
+        emit_mem_store_sized(cc, X86_RAX, X86_RBP,
+                             dst_off + (int32_t)(i * dl.esz), dl.esz);
+    }
+    ctx->mode = saved_mode;
+    invalidate_cached_gprs(cc);
+    return rc;
+}
 
-        if (vararg) {
-            uint32_t named_gp_regs = named_gp_total;
-            uint32_t named_fp_regs = named_fp_total;
-            if (named_gp_regs > 6)
-                named_gp_regs = 6;
-            if (named_fp_regs > 8)
-                named_fp_regs = 8;
-            cc->vararg_named_gp = named_gp_regs;
-            cc->vararg_named_fp = named_fp_regs;
-            cc->vararg_named_stack_gp =
-                named_gp_total > 6 ? named_gp_total - 6 : 0;
+static int x86_vec_emit_binop(x86_direct_ctx_t *ctx,
+                              const lr_compile_inst_desc_t *desc,
+                              const lr_operand_t *ops) {
+    x86_compile_ctx_t *cc = &ctx->cc;
+    x86_vec_layout_t l;
+    x86_vec_src_t a, b;
+    uint8_t chunk;
+    uint8_t prefix = 0x66;
+    uint8_t opc = 0;
+    uint8_t shift_op = 0, shift_ext = 0, shift_count = 0;
+    bool mul32 = false;
+    bool pmulld = false;
+    uint8_t abase, bbase;
+    int32_t adisp, bdisp;
+    int32_t dst_off;
+
+    if (!x86_vec_layout(desc->type, &l))
+        return -1;
+    chunk = x86_vec_chunk(&l);
+    if (x86_vec_is_fp(&l)) {
+        prefix = l.esz == 8 ? 0x66 : 0;
+        switch (desc->op) {
+        case LR_OP_FADD: opc = 0x58; break;
+        case LR_OP_FSUB: opc = 0x5C; break;
+        case LR_OP_FMUL: opc = 0x59; break;
+        case LR_OP_FDIV: opc = 0x5E; break;
+        default: break;
+        }
+    } else if (desc->op == LR_OP_SHL || desc->op == LR_OP_LSHR ||
+               desc->op == LR_OP_ASHR) {
+        if (l.esz >= 2 && x86_vec_uniform_shift(&ops[1], &l, &shift_count) &&
+            !(desc->op == LR_OP_ASHR && l.esz == 8)) {
+            shift_op = (uint8_t)(0x70 + x86_vec_log2(l.esz));
+            shift_ext = desc->op == LR_OP_SHL ? 6 :
+                        desc->op == LR_OP_LSHR ? 2 : 4;
+        }
+    } else if (desc->op == LR_OP_MUL && l.esz == 4) {
+        mul32 = true;
+        pmulld = (cc->cpu_features & LR_CPU_X86_SSE41) != 0;
+    } else {
+        opc = x86_vec_int_binop((lr_opcode_t)desc->op, &l);
+    }
+    if (chunk == 0 || (opc == 0 && shift_op == 0 && !mul32))
+        return x86_vec_emit_per_lane(ctx, desc, ops);
+
+    dst_off = x86_vec_dest_slot(cc, desc->dest, l.total);
+    x86_vec_src_init(cc, &ops[0], &l, &a);
+    if (shift_op == 0)
+        x86_vec_src_init(cc, &ops[1], &l, &b);
+    else
+        b.kind = X86_VEC_ZERO;
+    x86_vec_src_addr(cc, &a, X86_R10, &abase, &adisp);
+    x86_vec_src_addr(cc, &b, X86_R11, &bbase, &bdisp);
+    size_t off = 0;
+    if ((cc->cpu_features & LR_CPU_X86_AVX2) && chunk == 16 &&
+        l.total >= 32 && (opc != 0 || mul32)) {
+        /* Whole ymm steps as VEX.256 a = a op b; the vzeroupper keeps the
+           legacy-SSE code that follows free of transition stalls. */
+        uint8_t map = mul32 ? 2 : 1;
+        uint8_t pp = prefix == 0x66 ? 1 : 0;
+        uint8_t vop = mul32 ? 0x40 : opc;
+        for (; l.total - off >= 32; off += 32) {
+            x86_vec_load_src256(cc, X86_VEC_A, &a, abase,
+                                adisp + (int32_t)off);
+            x86_vec_load_src256(cc, X86_VEC_B, &b, bbase,
+                                bdisp + (int32_t)off);
+            encode_vex_rr(cc->buf, &cc->pos, cc->buflen, map, pp, false,
+                          true, vop, X86_VEC_A, X86_VEC_A, X86_VEC_B);
+            x86_vec_store_mem256(cc, X86_VEC_A, X86_RBP,
+                                 dst_off + (int32_t)off);
+        }
+        emit_byte(cc->buf, &cc->pos, cc->buflen, 0xC5);
+        emit_byte(cc->buf, &cc->pos, cc->buflen, 0xF8);
+        emit_byte(cc->buf, &cc->pos, cc->buflen, 0x77);
+    }
+    for (; off < l.total; off += chunk) {
+        x86_vec_load_src(cc, X86_VEC_A, &a, abase, adisp + (int32_t)off, chunk);
+        if (shift_op) {
+            x86_vec_shift_imm(cc, shift_op, shift_ext, X86_VEC_A, shift_count);
+        } else if (mul32 && pmulld) {
+            x86_vec_load_src(cc, X86_VEC_B, &b, bbase, bdisp + (int32_t)off,
+                             chunk);
+            encode_sse_rr(cc->buf, &cc->pos, cc->buflen, 0x66, 0x38, 0x40,
+                          X86_VEC_A, X86_VEC_B);
+        } else if (mul32) {
+            /* pmuludq on even and odd lanes, then interleave the low
+               halves of the 64-bit products. */
+            x86_vec_load_src(cc, X86_VEC_B, &b, bbase, bdisp + (int32_t)off,
+                             chunk);
+            x86_vec_rr(cc, 0x6F, X86_VEC_T, X86_VEC_A);
+            x86_vec_rr(cc, 0xF4, X86_VEC_T, X86_VEC_B);
+            x86_vec_shift_imm(cc, 0x73, 2, X86_VEC_A, 32);
+            x86_vec_shift_imm(cc, 0x73, 2, X86_VEC_B, 32);
+            x86_vec_rr(cc, 0xF4, X86_VEC_A, X86_VEC_B);
+            x86_vec_pshufd(cc, X86_VEC_T, X86_VEC_T, 0x08);
+            x86_vec_pshufd(cc, X86_VEC_A, X86_VEC_A, 0x08);
+            x86_vec_rr(cc, 0x62, X86_VEC_T, X86_VEC_A);
+            x86_vec_rr(cc, 0x6F, X86_VEC_A, X86_VEC_T);
+        } else {
+            x86_vec_load_src(cc, X86_VEC_B, &b, bbase, bdisp + (int32_t)off,
+                             chunk);
+            emit_0f_rr(cc, prefix, opc, X86_VEC_A, X86_VEC_B, 4);
         }
+        x86_vec_store_mem(cc, X86_VEC_A, X86_RBP, dst_off + (int32_t)off,
+                          chunk);
     }
+    return 0;
+}
 
-    cc->func_is_vararg = vararg;
-    if (vararg) {
-        /* SysV register save area: 6*8 GP + 8*16 FP = 176 bytes. */
-        cc->vararg_rsa_off = alloc_temp_slot(cc, 176, 16);
-        for (uint32_t i = 0; i < 6; i++)
-            emit_mem_store_sized(cc, param_regs[i], X86_RBP,
-                                 cc->vararg_rsa_off + (int32_t)(i * 8), 8);
-        for (uint32_t i = 0; i < 8; i++) {
-            emit_store_fp_mem_base(cc, X86_RBP,
-                                   cc->vararg_rsa_off + 48 + (int32_t)(i * 16),
-                                   param_fp_regs[i], 8);
+static int x86_vec_emit_fneg(x86_direct_ctx_t *ctx,
+                             const lr_compile_inst_desc_t *desc,
+                             const lr_operand_t *ops) {
+    x86_compile_ctx_t *cc = &ctx->cc;
+    x86_vec_layout_t l;
+    x86_vec_src_t a;
+    uint8_t chunk;
+    uint8_t abase;
+    int32_t adisp;
+    int32_t dst_off;
+
+    if (!x86_vec_layout(desc->type, &l) || !x86_vec_is_fp(&l))
+        return -1;
+    chunk = x86_vec_chunk(&l);
+    if (chunk == 0)
+        return x86_vec_emit_per_lane(ctx, desc, ops);
+    dst_off = x86_vec_dest_slot(cc, desc->dest, l.total);
+    x86_vec_src_init(cc, &ops[0], &l, &a);
+    x86_vec_src_addr(cc, &a, X86_R10, &abase, &adisp);
+    /* Sign-bit mask: all ones shifted left by the lane width - 1. */
+    x86_vec_rr(cc, 0x76, X86_VEC_T, X86_VEC_T);
+    if (l.esz == 8)
+        x86_vec_shift_imm(cc, 0x73, 6, X86_VEC_T, 63);
+    else
+        x86_vec_shift_imm(cc, 0x72, 6, X86_VEC_T, 31);
+    for (size_t off = 0; off < l.total; off += chunk) {
+        x86_vec_load_src(cc, X86_VEC_A, &a, abase, adisp + (int32_t)off, chunk);
+        x86_vec_rr(cc, 0xEF, X86_VEC_A, X86_VEC_T);
+        x86_vec_store_mem(cc, X86_VEC_A, X86_RBP, dst_off + (int32_t)off,
+                          chunk);
+    }
+    return 0;
+}
+
+/* A = (A pred B) lane masks; clobbers B, T and T2. */
+static void x86_vec_icmp_mask(x86_compile_ctx_t *cc, lr_icmp_pred_t pred,
+                              uint8_t esz) {
+    static const uint32_t sign[4] = {0x80808080u, 0x80008000u,
+                                     0x80000000u, 0x80000000u};
+    uint8_t lg = x86_vec_log2(esz);
+    bool eq = false, swap = false, invert = false, is_unsigned = false;
+    switch (pred) {
+    case LR_ICMP_EQ:  eq = true; break;
+    case LR_ICMP_NE:  eq = true; invert = true; break;
+    case LR_ICMP_SGT: break;
+    case LR_ICMP_SLT: swap = true; break;
+    case LR_ICMP_SGE: swap = true; invert = true; break;
+    case LR_ICMP_SLE: invert = true; break;
+    case LR_ICMP_UGT: is_unsigned = true; break;
+    case LR_ICMP_ULT: is_unsigned = true; swap = true; break;
+    case LR_ICMP_UGE: is_unsigned = true; swap = true; invert = true; break;
+    case LR_ICMP_ULE: is_unsigned = true; invert = true; break;
+    }
+    if (is_unsigned) {
+        x86_vec_splat32(cc, X86_VEC_T2, sign[lg]);
+        x86_vec_rr(cc, 0xEF, X86_VEC_A, X86_VEC_T2);
+        x86_vec_rr(cc, 0xEF, X86_VEC_B, X86_VEC_T2);
+    }
+    if (eq) {
+        x86_vec_rr(cc, (uint8_t)(0x74 + lg), X86_VEC_A, X86_VEC_B);
+    } else if (swap) {
+        x86_vec_rr(cc, 0x6F, X86_VEC_T, X86_VEC_B);
+        x86_vec_rr(cc, (uint8_t)(0x64 + lg), X86_VEC_T, X86_VEC_A);
+        x86_vec_rr(cc, 0x6F, X86_VEC_A, X86_VEC_T);
+    } else {
+        x86_vec_rr(cc, (uint8_t)(0x64 + lg), X86_VEC_A, X86_VEC_B);
+    }
+    if (invert) {
+        x86_vec_rr(cc, 0x76, X86_VEC_T, X86_VEC_T);
+        x86_vec_rr(cc, 0xEF, X86_VEC_A, X86_VEC_T);
+    }
+}
+
+/* cmpps/cmppd A, src, imm. */
+static void x86_vec_cmpp(x86_compile_ctx_t *cc, uint8_t prefix, uint8_t dst,
+                         uint8_t src, uint8_t imm) {
+    emit_0f_rr(cc, prefix, 0xC2, dst, src, 4);
+    emit_byte(cc->buf, &cc->pos, cc->buflen, imm);
+}
+
+/* A = (A pred B) lane masks; clobbers T. */
+static void x86_vec_fcmp_mask(x86_compile_ctx_t *cc, lr_fcmp_pred_t pred,
+                              uint8_t esz) {
+    uint8_t prefix = esz == 8 ? 0x66 : 0;
+    int imm = -1;
+    bool swap = false;
+    switch (pred) {
+    case LR_FCMP_FALSE:
+        x86_vec_rr(cc, 0xEF, X86_VEC_A, X86_VEC_A);
+        return;
+    case LR_FCMP_TRUE:
+        x86_vec_rr(cc, 0x76, X86_VEC_A, X86_VEC_A);
+        return;
+    case LR_FCMP_ONE:
+    case LR_FCMP_UEQ:
+        /* ONE = ORD & NEQ, UEQ = UNORD | EQ. */
+        x86_vec_rr(cc, 0x6F, X86_VEC_T, X86_VEC_A);
+        x86_vec_cmpp(cc, prefix, X86_VEC_T, X86_VEC_B,
+                     pred == LR_FCMP_ONE ? 7 : 3);
+        x86_vec_cmpp(cc, prefix, X86_VEC_A, X86_VEC_B,
+                     pred == LR_FCMP_ONE ? 4 : 0);
+        x86_vec_rr(cc, pred == LR_FCMP_ONE ? 0xDB : 0xEB,
+                   X86_VEC_A, X86_VEC_T);
+        return;
+    case LR_FCMP_OEQ: imm = 0; break;
+    case LR_FCMP_OLT: imm = 1; break;
+    case LR_FCMP_OLE: imm = 2; break;
+    case LR_FCMP_UNO: imm = 3; break;
+    case LR_FCMP_UNE: imm = 4; break;
+    case LR_FCMP_UGE: imm = 5; break;
+    case LR_FCMP_UGT: imm = 6; break;
+    case LR_FCMP_ORD: imm = 7; break;
+    case LR_FCMP_OGT: imm = 1; swap = true; break;
+    case LR_FCMP_OGE: imm = 2; swap = true; break;
+    case LR_FCMP_ULT: imm = 6; swap = true; break;
+    case LR_FCMP_ULE: imm = 5; swap = true; break;
+    }
+    if (swap) {
+        x86_vec_rr(cc, 0x6F, X86_VEC_T, X86_VEC_B);
+        x86_vec_cmpp(cc, prefix, X86_VEC_T, X86_VEC_A, (uint8_t)imm);
+        x86_vec_rr(cc, 0x6F, X86_VEC_A, X86_VEC_T);
+    } else {
+        x86_vec_cmpp(cc, prefix, X86_VEC_A, X86_VEC_B, (uint8_t)imm);
+    }
+}
+
+static int x86_vec_emit_cmp(x86_direct_ctx_t *ctx,
+                            const lr_compile_inst_desc_t *desc,
+                            const lr_operand_t *ops) {
+    x86_compile_ctx_t *cc = &ctx->cc;
+    x86_vec_layout_t sl, dl;
+    x86_vec_src_t a, b;
+    uint8_t chunk;
+    uint8_t abase, bbase;
+    int32_t adisp, bdisp;
+    int32_t dst_off;
+    bool fp = desc->op == LR_OP_FCMP;
+
+    if (!x86_vec_layout(ops[0].type, &sl) || !x86_vec_layout(desc->type, &dl))
+        return -1;
+    chunk = x86_vec_chunk(&sl);
+    if (fp != x86_vec_is_fp(&sl) || chunk == 0 ||
+        (!fp && sl.esz == 8) ||
+        (sl.elem->kind == LR_TYPE_I1 && desc->icmp_pred != LR_ICMP_EQ &&
+         desc->icmp_pred != LR_ICMP_NE))
+        return x86_vec_emit_per_lane(ctx, desc, ops);
+
+    dst_off = x86_vec_dest_slot(cc, desc->dest, dl.total);
+    x86_vec_src_init(cc, &ops[0], &sl, &a);
+    x86_vec_src_init(cc, &ops[1], &sl, &b);
+    x86_vec_src_addr(cc, &a, X86_R10, &abase, &adisp);
+    x86_vec_src_addr(cc, &b, X86_R11, &bbase, &bdisp);
+    for (size_t off = 0; off < sl.total; off += chunk) {
+        x86_vec_load_src(cc, X86_VEC_A, &a, abase, adisp + (int32_t)off, chunk);
+        x86_vec_load_src(cc, X86_VEC_B, &b, bbase, bdisp + (int32_t)off, chunk);
+        if (fp)
+            x86_vec_fcmp_mask(cc, (lr_fcmp_pred_t)desc->fcmp_pred, sl.esz);
+        else
+            x86_vec_icmp_mask(cc, (lr_icmp_pred_t)desc->icmp_pred, sl.esz);
+        x86_vec_mask_to_bytes(cc, sl.esz);
+        x86_vec_store_mem(cc, X86_VEC_A, X86_RBP,
+                          dst_off + (int32_t)(off / sl.esz), chunk / sl.esz);
+    }
+    return 0;
+}
+
+static int x86_vec_emit_select(x86_direct_ctx_t *ctx,
+                               const lr_compile_inst_desc_t *desc,
+                               const lr_operand_t *ops) {
+    x86_compile_ctx_t *cc = &ctx->cc;
+    x86_vec_layout_t l, cl;
+    x86_vec_src_t c, a, b;
+    bool vec_cond = x86_vec_layout(ops[0].type, &cl);
+    uint8_t chunk;
+    uint8_t cbase = X86_RBP, abase, bbase;
+    int32_t cdisp = 0, adisp, bdisp;
+    int32_t dst_off;
+
+    if (!x86_vec_layout(desc->type, &l))
+        return -1;
+    chunk = x86_vec_chunk(&l);
+    if (chunk == 0)
+        return x86_vec_emit_per_lane(ctx, desc, ops);
+
+    dst_off = x86_vec_dest_slot(cc, desc->dest, l.total);
+    if (vec_cond) {
+        x86_vec_src_init(cc, &ops[0], &cl, &c);
+    } else {
+        /* Scalar condition: broadcast 0 - (cond & 1) to every lane. */
+        emit_load_operand(cc, &ops[0], X86_RAX);
+        emit_byte(cc->buf, &cc->pos, cc->buflen, 0x83);
+        emit_byte(cc->buf, &cc->pos, cc->buflen, modrm(3, 4, X86_RAX));
+        emit_byte(cc->buf, &cc->pos, cc->buflen, 0x01);
+        emit_byte(cc->buf, &cc->pos, cc->buflen, rex(true, false, false, false));
+        emit_byte(cc->buf, &cc->pos, cc->buflen, 0xF7);
+        emit_byte(cc->buf, &cc->pos, cc->buflen, modrm(3, 3, X86_RAX));
+        invalidate_cached_reg(cc, X86_RAX);
+        x86_vec_movd_from_eax(cc, X86_VEC_T2);
+        x86_vec_pshufd(cc, X86_VEC_T2, X86_VEC_T2, 0x00);
+    }
+    x86_vec_src_init(cc, &ops[1], &l, &a);
+    x86_vec_src_init(cc, &ops[2], &l, &b);
+    if (vec_cond)
+        x86_vec_src_addr(cc, &c, X86_RDX, &cbase, &cdisp);
+    x86_vec_src_addr(cc, &a, X86_R10, &abase, &adisp);
+    x86_vec_src_addr(cc, &b, X86_R11, &bbase, &bdisp);
+    for (size_t off = 0; off < l.total; off += chunk) {
+        if (vec_cond) {
+            /* Widen the 0/1 condition bytes to all-ones/zero lanes. */
+            x86_vec_load_src(cc, X86_VEC_T2, &c, cbase,
+                             cdisp + (int32_t)(off / l.esz), chunk / l.esz);
+            x86_vec_rr(cc, 0xEF, X86_VEC_T, X86_VEC_T);
+            x86_vec_rr(cc, 0xF8, X86_VEC_T, X86_VEC_T2);
+            if (l.esz >= 2)
+                x86_vec_rr(cc, 0x60, X86_VEC_T, X86_VEC_T);
+            if (l.esz >= 4)
+                x86_vec_rr(cc, 0x61, X86_VEC_T, X86_VEC_T);
+            if (l.esz == 8)
+                x86_vec_rr(cc, 0x62, X86_VEC_T, X86_VEC_T);
+            x86_vec_rr(cc, 0x6F, X86_VEC_T2, X86_VEC_T);
+        }
+        x86_vec_load_src(cc, X86_VEC_A, &a, abase, adisp + (int32_t)off, chunk);
+        x86_vec_load_src(cc, X86_VEC_B, &b, bbase, bdisp + (int32_t)off, chunk);
+        x86_vec_rr(cc, 0x6F, X86_VEC_T, X86_VEC_T2);
+        x86_vec_rr(cc, 0xDB, X86_VEC_A, X86_VEC_T);      /* pand */
+        x86_vec_rr(cc, 0xDF, X86_VEC_T, X86_VEC_B);      /* pandn */
+        x86_vec_rr(cc, 0xEB, X86_VEC_A, X86_VEC_T);      /* por */
+        x86_vec_store_mem(cc, X86_VEC_A, X86_RBP, dst_off + (int32_t)off,
+                          chunk);
+    }
+    return 0;
+}
+
+/* R11 = address of lane idx of src (idx clamped to lane 0 when out of
+   range, which LLVM leaves poison). */
+static void x86_vec_lane_addr(x86_compile_ctx_t *cc, const x86_vec_src_t *src,
+                              uint8_t src_base, int32_t src_disp,
+                              const lr_operand_t *idx,
+                              const x86_vec_layout_t *l) {
+    uint8_t isz = (uint8_t)lr_type_size(idx->type);
+    (void)src;
+    emit_load_operand(cc, idx, X86_RCX);
+    if (isz == 1 || isz == 2)
+        emit_movzx_rr(cc, X86_RCX, X86_RCX, isz);
+    else if (isz == 4)
+        encode_alu_rr(cc->buf, &cc->pos, cc->buflen, 0x89, X86_RCX, X86_RCX, 4);
+    invalidate_cached_reg(cc, X86_RCX);
+    emit_mov_imm(cc, X86_RDX, (int64_t)l->lanes, false);
+    encode_alu_rr(cc->buf, &cc->pos, cc->buflen, 0x39, X86_RCX, X86_RDX, 8);
+    emit_mov_imm(cc, X86_RDX, 0, true);
+    emit_cmovcc(cc, LR_CC_UGE, X86_RCX, X86_RDX, 8);
+    if (l->esz > 1) {
+        emit_byte(cc->buf, &cc->pos, cc->buflen, rex(true, false, false, false));
+        emit_byte(cc->buf, &cc->pos, cc->buflen, 0xC1);
+        emit_byte(cc->buf, &cc->pos, cc->buflen, modrm(3, 4, X86_RCX));
+        emit_byte(cc->buf, &cc->pos, cc->buflen, x86_vec_log2(l->esz));
+    }
+    encode_mem(cc->buf, &cc->pos, cc->buflen, 0x8D, X86_R11, src_base,
+               src_disp, 8);
+    encode_alu_rr(cc->buf, &cc->pos, cc->buflen, 0x01, X86_R11, X86_RCX, 8);
+}
+
+static int x86_vec_emit_extract(x86_direct_ctx_t *ctx,
+                                const lr_compile_inst_desc_t *desc,
+                                const lr_operand_t *ops) {
+    x86_compile_ctx_t *cc = &ctx->cc;
+    x86_vec_layout_t l;
+    x86_vec_src_t v;
+    uint8_t base;
+    int32_t disp;
+
+    if (desc->num_operands < 2 || !x86_vec_layout(ops[0].type, &l))
+        return -1;
+    x86_vec_src_init(cc, &ops[0], &l, &v);
+    if (v.kind == X86_VEC_ZERO) {
+        emit_mov_imm(cc, X86_RAX, 0, false);
+    } else if (ops[1].kind == LR_VAL_IMM_I64) {
+        uint64_t lane = (uint64_t)ops[1].imm_i64;
+        if (lane >= l.lanes)
+            lane = 0;
+        x86_vec_src_addr(cc, &v, X86_R10, &base, &disp);
+        emit_mem_load_sized(cc, X86_RAX, base,
+                            disp + (int32_t)(lane * l.esz), l.esz);
+    } else {
+        x86_vec_src_addr(cc, &v, X86_R10, &base, &disp);
+        x86_vec_lane_addr(cc, &v, base, disp, &ops[1], &l);
+        emit_mem_load_sized(cc, X86_RAX, X86_R11, 0, l.esz);
+    }
+    invalidate_cached_reg(cc, X86_RAX);
+    emit_store_slot(cc, desc->dest, X86_RAX);
+    return 0;
+}
+
+static int x86_vec_emit_insert(x86_direct_ctx_t *ctx,
+                               const lr_compile_inst_desc_t *desc,
+                               const lr_operand_t *ops) {
+    x86_compile_ctx_t *cc = &ctx->cc;
+    x86_vec_layout_t l;
+    x86_vec_src_t v;
+    int32_t dst_off;
+
+    if (desc->num_operands < 3 || !x86_vec_layout(desc->type, &l))
+        return -1;
+    dst_off = x86_vec_dest_slot(cc, desc->dest, l.total);
+    x86_vec_src_init(cc, &ops[0], &l, &v);
+    x86_vec_copy(cc, &v, X86_RBP, dst_off, l.total);
+    invalidate_cached_gprs(cc);
+    if (ops[2].kind == LR_VAL_IMM_I64) {
+        uint64_t lane = (uint64_t)ops[2].imm_i64;
+        if (lane >= l.lanes)
+            return 0;
+        emit_load_operand(cc, &ops[1], X86_RAX);
+        emit_mem_store_sized(cc, X86_RAX, X86_RBP,
+                             dst_off + (int32_t)(lane * l.esz), l.esz);
+        return 0;
+    }
+    x86_vec_lane_addr(cc, &v, X86_RBP, dst_off, &ops[2], &l);
+    emit_load_operand(cc, &ops[1], X86_RAX);
+    emit_mem_store_sized(cc, X86_RAX, X86_R11, 0, l.esz);
+    return 0;
+}
+
+static int x86_vec_emit_shuffle(x86_direct_ctx_t *ctx,
+                                const lr_compile_inst_desc_t *desc,
+                                const lr_operand_t *ops) {
+    x86_compile_ctx_t *cc = &ctx->cc;
+    x86_vec_layout_t sl, dl;
+    x86_vec_src_t src[2];
+    int32_t dst_off;
+    uint32_t used = 0;
+
+    if (desc->num_operands < 2 || !x86_vec_layout(ops[0].type, &sl) ||
+        !x86_vec_layout(desc->type, &dl) || desc->num_indices != dl.lanes)
+        return -1;
+    dst_off = x86_vec_dest_slot(cc, desc->dest, dl.total);
+    x86_vec_src_init(cc, &ops[0], &sl, &src[0]);
+    x86_vec_src_init(cc, &ops[1], &sl, &src[1]);
+    for (uint32_t i = 0; i < dl.lanes; i++) {
+        uint32_t m = desc->indices[i];
+        if (m != UINT32_MAX && m < 2u * sl.lanes)
+            used |= m < sl.lanes ? 1u : 2u;
+    }
+
+    /* One 16-byte source with dword or qword lanes: a single pshufd. */
+    if (sl.total == 16 && dl.total == 16 && (sl.esz == 4 || sl.esz == 8) &&
+        (used == 1u || used == 2u) &&
+        src[used == 1u ? 0 : 1].kind != X86_VEC_ZERO) {
+        const x86_vec_src_t *s = &src[used == 1u ? 0 : 1];
+        uint8_t order = 0;
+        uint8_t base;
+        int32_t disp;
+        for (uint32_t i = 0; i < dl.lanes; i++) {
+            uint32_t m = desc->indices[i];
+            uint32_t lane = m == UINT32_MAX ? i : m % sl.lanes;
+            if (sl.esz == 4)
+                order |= (uint8_t)(lane << (2u * i));
+            else
+                order |= (uint8_t)(((lane * 2u) | ((lane * 2u + 1u) << 2))
+                                   << (4u * i));
         }
+        x86_vec_src_addr(cc, s, X86_R10, &base, &disp);
+        x86_vec_load_mem(cc, X86_VEC_A, base, disp, 16);
+        x86_vec_pshufd(cc, X86_VEC_A, X86_VEC_A, order);
+        x86_vec_store_mem(cc, X86_VEC_A, X86_RBP, dst_off, 16);
+        return 0;
     }
 
-    *compile_ctx = ctx;
+    for (uint32_t i = 0; i < dl.lanes; i++) {
+        uint32_t m = desc->indices[i];
+        const x86_vec_src_t *s;
+        uint8_t base;
+        int32_t disp;
+        if (m == UINT32_MAX || m >= 2u * sl.lanes)
+            continue;
+        s = &src[m < sl.lanes ? 0 : 1];
+        if (s->kind == X86_VEC_ZERO) {
+            emit_mov_imm(cc, X86_RAX, 0, false);
+        } else {
+            x86_vec_src_addr(cc, s, X86_R10, &base, &disp);
+            emit_mem_load_sized(cc, X86_RAX, base,
+                                disp + (int32_t)((m % sl.lanes) * sl.esz),
+                                sl.esz);
+        }
+        emit_mem_store_sized(cc, X86_RAX, X86_RBP,
+                             dst_off + (int32_t)(i * dl.esz), dl.esz);
+    }
     return 0;
 }
 
-static int x86_64_compile_set_block(void *compile_ctx, uint32_t block_id) {
-    x86_direct_ctx_t *ctx = (x86_direct_ctx_t *)compile_ctx;
-    if (!ctx)
+static int x86_vec_emit_load(x86_direct_ctx_t *ctx,
+                             const lr_compile_inst_desc_t *desc,
+                             const lr_operand_t *ops) {
+    x86_compile_ctx_t *cc = &ctx->cc;
+    x86_vec_layout_t l;
+    x86_vec_src_t p;
+    int32_t dst_off;
+
+    if (!x86_vec_layout(desc->type, &l))
         return -1;
-    /* Flush deferred terminators on block transitions so branch fixups
-       are emitted before binding the next block entry. This also guarantees
-       empty blocks are assigned offsets instead of leaving placeholder
-       branch displacements unresolved. */
-    if (ctx->deferred.pending &&
-        (!ctx->has_current_block || ctx->deferred.block_id != block_id)) {
-        if (flush_deferred_terminator(ctx) != 0)
-            return -1;
-    }
-    if (direct_ensure_block_offsets(ctx, block_id) != 0)
+    dst_off = x86_vec_dest_slot(cc, desc->dest, l.total);
+    memset(&p, 0, sizeof(p));
+    p.kind = X86_VEC_PTR;
+    p.op = ops[0];
+    x86_vec_copy(cc, &p, X86_RBP, dst_off, l.total);
+    return 0;
+}
+
+static int x86_vec_emit_store(x86_direct_ctx_t *ctx,
+                              const lr_compile_inst_desc_t *desc,
+                              const lr_operand_t *ops) {
+    x86_compile_ctx_t *cc = &ctx->cc;
+    x86_vec_layout_t l;
+    x86_vec_src_t v;
+
+    (void)desc;
+    if (!x86_vec_layout(ops[0].type, &l))
         return -1;
-    ctx->current_block_id = block_id;
-    ctx->has_current_block = true;
-    if (ctx->cc.block_offsets[block_id] == SIZE_MAX) {
-        ctx->cc.block_offsets[block_id] = ctx->cc.pos;
-        ctx->cc.block_entry_offsets[block_id] = ctx->cc.pos;
+    x86_vec_src_init(cc, &ops[0], &l, &v);
+    emit_load_operand(cc, &ops[1], X86_RCX);
+    invalidate_cached_reg(cc, X86_RCX);
+    x86_vec_copy(cc, &v, X86_RCX, 0, l.total);
+    return 0;
+}
+
+/* bitcast between vectors wider than a GPR is a byte copy; <N x i1> to
+   or from iN packs lane bytes into bits and back. */
+static int x86_vec_emit_bitcast(x86_direct_ctx_t *ctx,
+                                const lr_compile_inst_desc_t *desc,
+                                const lr_operand_t *ops) {
+    x86_compile_ctx_t *cc = &ctx->cc;
+    x86_vec_layout_t sl, dl;
+    bool src_vec = x86_vec_layout(ops[0].type, &sl);
+    bool dst_vec = x86_vec_layout(desc->type, &dl);
+    x86_vec_src_t v;
+    uint8_t base;
+    int32_t disp;
+    int32_t dst_off;
+
+    if (src_vec && dst_vec) {
+        dst_off = x86_vec_dest_slot(cc, desc->dest, dl.total);
+        x86_vec_src_init(cc, &ops[0], &sl, &v);
+        x86_vec_copy(cc, &v, X86_RBP, dst_off, dl.total);
+        return 0;
+    }
+    if (src_vec) {
+        /* <N x i1> -> iN. */
+        x86_vec_src_init(cc, &ops[0], &sl, &v);
+        if (v.kind == X86_VEC_ZERO) {
+            emit_mov_imm(cc, X86_RAX, 0, false);
+        } else if (sl.lanes == 16 || sl.lanes == 8 || sl.lanes == 4) {
+            x86_vec_src_addr(cc, &v, X86_R10, &base, &disp);
+            x86_vec_load_mem(cc, X86_VEC_A, base, disp, sl.lanes);
+            x86_vec_shift_imm(cc, 0x71, 6, X86_VEC_A, 7);
+            emit_0f_rr(cc, 0x66, 0xD7, X86_RAX, X86_VEC_A, 4);  /* pmovmskb */
+        } else {
+            x86_vec_src_addr(cc, &v, X86_R10, &base, &disp);
+            emit_mov_imm(cc, X86_RAX, 0, false);
+            for (uint32_t i = 0; i < sl.lanes; i++) {
+                emit_movzx_mem(cc, X86_RDX, base, disp + (int32_t)i, 1);
+                if (i > 0) {
+                    emit_byte(cc->buf, &cc->pos, cc->buflen,
+                              rex(true, false, false, false));
+                    emit_byte(cc->buf, &cc->pos, cc->buflen, 0xC1);
+                    emit_byte(cc->buf, &cc->pos, cc->buflen,
+                              modrm(3, 4, X86_RDX));
+                    emit_byte(cc->buf, &cc->pos, cc->buflen, (uint8_t)i);
+                }
+                encode_alu_rr(cc->buf, &cc->pos, cc->buflen, 0x09,
+                              X86_RAX, X86_RDX, 8);
+            }
+        }
+        invalidate_cached_reg(cc, X86_RAX);
+        emit_store_slot(cc, desc->dest, X86_RAX);
+        return 0;
+    }
+    /* iN -> <N x i1>. */
+    dst_off = x86_vec_dest_slot(cc, desc->dest, dl.total);
+    emit_load_operand(cc, &ops[0], X86_RAX);
+    for (uint32_t i = 0; i < dl.lanes; i++) {
+        encode_alu_rr(cc->buf, &cc->pos, cc->buflen, 0x89, X86_RDX, X86_RAX, 8);
+        if (i > 0) {
+            emit_byte(cc->buf, &cc->pos, cc->buflen,
+                      rex(true, false, false, false));
+            emit_byte(cc->buf, &cc->pos, cc->buflen, 0xC1);
+            emit_byte(cc->buf, &cc->pos, cc->buflen, modrm(3, 5, X86_RDX));
+            emit_byte(cc->buf, &cc->pos, cc->buflen, (uint8_t)i);
+        }
+        emit_byte(cc->buf, &cc->pos, cc->buflen, 0x83);
+        emit_byte(cc->buf, &cc->pos, cc->buflen, modrm(3, 4, X86_RDX));
+        emit_byte(cc->buf, &cc->pos, cc->buflen, 0x01);
+        emit_mem_store_sized(cc, X86_RDX, X86_RBP, dst_off + (int32_t)i, 1);
     }
-    /* Entering a new block must invalidate cached register mappings before
-       emitting non-PHI instructions, but keep offsets bound for empty blocks. */
-    ctx->block_offset_pending = true;
     return 0;
 }
 
+/* Whether desc is lowered by x86_vec_emit_inst rather than the scalar
+   cases of x86_64_compile_emit. */
+static bool x86_vec_inst(const lr_compile_inst_desc_t *desc,
+                         const lr_operand_t *ops) {
+    x86_vec_layout_t l = {0}, sl = {0};
+    bool dst_vec = x86_vec_layout(desc->type, &l);
+    switch (desc->op) {
+    case LR_OP_EXTRACTELEMENT:
+        return desc->num_operands >= 2 && x86_vec_layout(ops[0].type, &sl);
+    case LR_OP_INSERTELEMENT:
+    case LR_OP_SHUFFLEVECTOR:
+        return dst_vec;
+    case LR_OP_ICMP: case LR_OP_FCMP:
+        return desc->num_operands >= 2 && dst_vec &&
+               x86_vec_layout(ops[0].type, &sl);
+    case LR_OP_ADD: case LR_OP_SUB: case LR_OP_MUL:
+    case LR_OP_SDIV: case LR_OP_SREM: case LR_OP_UDIV: case LR_OP_UREM:
+    case LR_OP_AND: case LR_OP_OR: case LR_OP_XOR:
+    case LR_OP_SHL: case LR_OP_LSHR: case LR_OP_ASHR:
+    case LR_OP_FADD: case LR_OP_FSUB: case LR_OP_FMUL: case LR_OP_FDIV:
+    case LR_OP_FREM:
+        return desc->num_operands >= 2 && dst_vec;
+    case LR_OP_FNEG:
+        return desc->num_operands >= 1 && dst_vec;
+    case LR_OP_SELECT:
+        return desc->num_operands >= 3 && dst_vec;
+    case LR_OP_SEXT: case LR_OP_ZEXT: case LR_OP_TRUNC:
+    case LR_OP_SITOFP: case LR_OP_UITOFP:
+    case LR_OP_FPTOSI: case LR_OP_FPTOUI:
+    case LR_OP_FPEXT: case LR_OP_FPTRUNC:
+    case LR_OP_PTRTOINT: case LR_OP_INTTOPTR:
+        return desc->num_operands >= 1 && dst_vec &&
+               x86_vec_layout(ops[0].type, &sl) && sl.lanes == l.lanes;
+    case LR_OP_LOAD:
+        return desc->num_operands >= 1 && dst_vec && l.total >= 16;
+    case LR_OP_STORE:
+        return desc->num_operands >= 2 &&
+               x86_vec_layout(ops[0].type, &sl) && sl.total >= 16;
+    case LR_OP_BITCAST: {
+        bool src_vec = desc->num_operands >= 1 &&
+                       x86_vec_layout(ops[0].type, &sl);
+        if (src_vec && dst_vec)
+            return l.total > 8 || sl.total > 8;
+        if (src_vec)
+            return sl.elem->kind == LR_TYPE_I1 && sl.lanes <= 64 &&
+                   int_type_width_bits(desc->type) == sl.lanes;
+        if (dst_vec)
+            return l.elem->kind == LR_TYPE_I1 && l.lanes <= 64 &&
+                   int_type_width_bits(ops[0].type) == l.lanes;
+        return false;
+    }
+    default:
+        return false;
+    }
+}
+
+static int x86_vec_emit_inst(x86_direct_ctx_t *ctx,
+                             const lr_compile_inst_desc_t *desc,
+                             const lr_operand_t *ops) {
+    int rc;
+    invalidate_cached_gprs(&ctx->cc);
+    switch (desc->op) {
+    case LR_OP_EXTRACTELEMENT: rc = x86_vec_emit_extract(ctx, desc, ops); break;
+    case LR_OP_INSERTELEMENT:  rc = x86_vec_emit_insert(ctx, desc, ops); break;
+    case LR_OP_SHUFFLEVECTOR:  rc = x86_vec_emit_shuffle(ctx, desc, ops); break;
+    case LR_OP_ICMP: case LR_OP_FCMP:
+        rc = x86_vec_emit_cmp(ctx, desc, ops);
+        break;
+    case LR_OP_ADD: case LR_OP_SUB: case LR_OP_MUL:
+    case LR_OP_AND: case LR_OP_OR: case LR_OP_XOR:
+    case LR_OP_SHL: case LR_OP_LSHR: case LR_OP_ASHR:
+    case LR_OP_FADD: case LR_OP_FSUB: case LR_OP_FMUL: case LR_OP_FDIV:
+        rc = x86_vec_emit_binop(ctx, desc, ops);
+        break;
+    case LR_OP_FNEG:   rc = x86_vec_emit_fneg(ctx, desc, ops); break;
+    case LR_OP_SELECT: rc = x86_vec_emit_select(ctx, desc, ops); break;
+    case LR_OP_LOAD:   rc = x86_vec_emit_load(ctx, desc, ops); break;
+    case LR_OP_STORE:  rc = x86_vec_emit_store(ctx, desc, ops); break;
+    case LR_OP_BITCAST: rc = x86_vec_emit_bitcast(ctx, desc, ops); break;
+    default:
+        rc = x86_vec_emit_per_lane(ctx, desc, ops);
+        break;
+    }
+    invalidate_cached_gprs(&ctx->cc);
+    return rc;
+}
+
 static int x86_64_compile_emit(void *compile_ctx,
                                const lr_compile_inst_desc_t *desc) {
     x86_direct_ctx_t *ctx = (x86_direct_ctx_t *)compile_ctx;
@@ -2169,9 +5597,13 @@ static int x86_64_compile_emit(void *compile_ctx,
     }
 
     cc = &ctx->cc;
+    if (ctx->tail_jumped) {
+        ctx->tail_jumped = false;
+        if (desc->op == LR_OP_RET || desc->op == LR_OP_RET_VOID)
+            return 0;
+    }
     direct_note_vregs(ctx, desc);
-
-    if (direct_ensure_fixup_cap(ctx) != 0)
+    if (cc->fixups_lost)
         return -1;
 
     uint32_t nops = desc->num_operands;
@@ -2194,12 +5626,52 @@ static int x86_64_compile_emit(void *compile_ctx,
     inst_header.align = desc->align;
     inst_header.call_external_abi = desc->call_external_abi;
     inst_header.call_vararg = desc->call_vararg;
+    inst_header.call_tail = desc->call_tail;
     inst_header.call_fixed_args = desc->call_fixed_args;
     inst_header.indices = (uint32_t *)desc->indices;
     inst_header.num_indices = desc->num_indices;
 
     cc->current_inst = &inst_header;
 
+    if (x86_vec_inst(desc, ops)) {
+        int rc = x86_vec_emit_inst(ctx, desc, ops);
+        ctx->cp_last_valid = false;
+        cc->current_inst = NULL;
+        return rc;
+    }
+
+    if (ctx->mode == LR_COMPILE_COPY_PATCH) {
+        bool fuse_ret = ctx->cp_last_valid && cc->pos == ctx->cp_last_end &&
+                        desc->op == LR_OP_RET && nops > 0 &&
+                        ops[0].kind == LR_VAL_VREG &&
+                        ops[0].vreg == ctx->cp_last_desc.dest;
+        size_t start = cc->pos;
+        ctx->cp_last_valid = false;
+        if (fuse_ret) {
+            cc->pos = ctx->cp_last_start;
+            invalidate_cached_gprs(cc);
+            ctx->mode = LR_COMPILE_ISEL;
+            int rc = x86_64_compile_emit(ctx, &ctx->cp_last_desc);
+            ctx->mode = LR_COMPILE_COPY_PATCH;
+            if (rc != 0)
+                return -1;
+            cc->current_inst = &inst_header;
+        } else if (direct_cp_emit_inst(cc, desc, ops)) {
+            if (desc->op >= LR_OP_ADD && desc->op <= LR_OP_ASHR &&
+                nops == 2) {
+                ctx->cp_last_desc = *desc;
+                memcpy(ctx->cp_last_ops, desc->operands,
+                       sizeof(ctx->cp_last_ops));
+                ctx->cp_last_desc.operands = ctx->cp_last_ops;
+                ctx->cp_last_start = start;
+                ctx->cp_last_end = cc->pos;
+                ctx->cp_last_valid = true;
+            }
+            cc->current_inst = NULL;
+            return 0;
+        }
+    }
+
     switch (desc->op) {
     case LR_OP_RET: {
         ctx->deferred.pending = true;
@@ -2297,9 +5769,8 @@ static int x86_64_compile_emit(void *compile_ctx,
         }
         uint8_t fsize = (desc->type &&
                          desc->type->kind == LR_TYPE_FLOAT) ? 4 : 8;
-        emit_load_fp_operand(cc, &ops[0], FP_SCRATCH0, fsize);
-        emit_load_fp_operand(cc, &ops[1], FP_SCRATCH1, fsize);
         uint8_t op1;
+        uint64_t rhs_bits = 0;
         switch (desc->op) {
         case LR_OP_FADD: op1 = 0x58; break;
         case LR_OP_FSUB: op1 = 0x5C; break;
@@ -2307,7 +5778,16 @@ static int x86_64_compile_emit(void *compile_ctx,
         case LR_OP_FDIV: op1 = 0x5E; break;
         default: op1 = 0x58; break;
         }
-        emit_sse_arith(cc, op1, FP_SCRATCH0, FP_SCRATCH1, fsize);
+        emit_load_fp_operand(cc, &ops[0], FP_SCRATCH0, fsize);
+        /* A constant right operand is read straight from the pool. */
+        if (!(ops[1].kind == LR_VAL_IMM_F64 &&
+              lr_target_imm_bits(&ops[1], &rhs_bits) &&
+              emit_sse_pool_op(cc, fsize == 8 ? 0xF2 : 0xF3, op1,
+                               FP_SCRATCH0, rhs_bits))) {
+            emit_sse_arith(cc, op1, FP_SCRATCH0,
+                           fp_operand_in_reg(cc, &ops[1], FP_SCRATCH1, fsize),
+                           fsize);
+        }
         emit_store_fp_slot(cc, desc->dest, FP_SCRATCH0, fsize);
         break;
     }
@@ -2361,6 +5841,17 @@ static int x86_64_compile_emit(void *compile_ctx,
         break;
     }
     case LR_OP_SDIV: case LR_OP_SREM: {
+        lr_div_const_t plan;
+        if (x86_div_const(desc, &ops[1], &plan)) {
+            uint8_t bits = int_type_width_bits(desc->type);
+            uint8_t res_reg;
+            emit_load_operand(cc, &ops[0], X86_RAX);
+            emit_sign_extend_value(cc, X86_RAX, bits);
+            res_reg = emit_div_const(cc, true, desc->op == LR_OP_SREM, &plan);
+            emit_sign_extend_value(cc, res_reg, bits);
+            emit_store_slot(cc, desc->dest, res_reg);
+            break;
+        }
         emit_load_operand(cc, &ops[0], X86_RAX);
         emit_load_operand(cc, &ops[1], X86_RCX);
         {
@@ -2385,6 +5876,22 @@ static int x86_64_compile_emit(void *compile_ctx,
         break;
     }
     case LR_OP_UDIV: case LR_OP_UREM: {
+        lr_div_const_t plan;
+        if (x86_div_const(desc, &ops[1], &plan)) {
+            uint8_t bits = int_type_width_bits(desc->type);
+            emit_load_operand(cc, &ops[0], X86_RAX);
+            if (bits < 64) {
+                emit_mov_imm(cc, X86_R11,
+                             (int64_t)(((uint64_t)1 << bits) - 1u), false);
+                encode_alu_rr(cc->buf, &cc->pos, cc->buflen, 0x21,
+                              X86_RAX, X86_R11, 8);
+                invalidate_cached_reg(cc, X86_RAX);
+            }
+            emit_store_slot(cc, desc->dest,
+                            emit_div_const(cc, false,
+                                           desc->op == LR_OP_UREM, &plan));
+            break;
+        }
         emit_load_operand(cc, &ops[0], X86_RAX);
         emit_load_operand(cc, &ops[1], X86_RCX);
         {
@@ -2412,6 +5919,27 @@ static int x86_64_compile_emit(void *compile_ctx,
         break;
     }
     case LR_OP_SHL: case LR_OP_LSHR: case LR_OP_ASHR: {
+        uint8_t shift_size = (uint8_t)lr_type_size(desc->type);
+        if ((cc->cpu_features & LR_CPU_X86_BMI2) &&
+            (shift_size == 4 || shift_size == 8)) {
+            /* shlx/shrx/sarx: the count may sit in any register and the
+               flags are left alone. */
+            uint8_t pp = desc->op == LR_OP_SHL ? 1 :
+                         desc->op == LR_OP_LSHR ? 3 : 2;
+            uint8_t count = X86_RCX;
+            emit_load_operand(cc, &ops[0], X86_RAX);
+            if (ops[1].kind == LR_VAL_VREG &&
+                vreg_home_reg(cc, ops[1].vreg) != X86_NO_HOME)
+                count = vreg_home_reg(cc, ops[1].vreg);
+            else
+                emit_load_operand(cc, &ops[1], X86_RCX);
+            encode_vex_rr(cc->buf, &cc->pos, cc->buflen, 2, pp,
+                          shift_size == 8, false, 0xF7, X86_RAX, count,
+                          X86_RAX);
+            invalidate_cached_reg(cc, X86_RAX);
+            emit_store_slot(cc, desc->dest, X86_RAX);
+            break;
+        }
         emit_load_operand(cc, &ops[0], X86_RAX);
         emit_load_operand(cc, &ops[1], X86_RCX);
         uint8_t ext;
@@ -2421,8 +5949,7 @@ static int x86_64_compile_emit(void *compile_ctx,
         case LR_OP_ASHR: ext = 7; break;
         default: ext = 4; break;
         }
-        emit_shift(cc, ext, X86_RAX,
-                   (uint8_t)lr_type_size(desc->type));
+        emit_shift(cc, ext, X86_RAX, shift_size);
         emit_store_slot(cc, desc->dest, X86_RAX);
         break;
     }
@@ -2434,18 +5961,30 @@ static int x86_64_compile_emit(void *compile_ctx,
                       (uint8_t)lr_type_size(ops[0].type));
         uint8_t icc = lr_target_cc_from_icmp(
             (lr_icmp_pred_t)desc->icmp_pred);
+        size_t cmp_end = cc->pos;
         emit_setcc(cc, icc, X86_RAX);
-        emit_movzx_rr(cc, X86_RAX, X86_RAX, 1);
         emit_store_slot(cc, desc->dest, X86_RAX);
+        ctx->flags_valid = true;
+        ctx->flags_cc = icc;
+        ctx->flags_vreg = desc->dest;
+        ctx->flags_block_id = ctx->current_block_id;
+        ctx->flags_cmp_end = cmp_end;
+        ctx->flags_end = cc->pos;
         break;
     }
     case LR_OP_SELECT: {
-        emit_load_operand(cc, &ops[0], X86_RAX);
-        encode_alu_rr(cc->buf, &cc->pos, cc->buflen, 0x85,
-                      X86_RAX, X86_RAX, 1);
+        /* Loads below keep the flags (see emit_load_operand). */
+        uint8_t sel_cc = direct_take_cmp_flags(ctx, &ops[0],
+                                               ctx->current_block_id);
+        if (sel_cc == X86_NO_FUSED_CC) {
+            emit_load_operand(cc, &ops[0], X86_RAX);
+            encode_alu_rr(cc->buf, &cc->pos, cc->buflen, 0x85,
+                          X86_RAX, X86_RAX, 1);
+            sel_cc = LR_CC_NE;
+        }
         emit_load_operand(cc, &ops[2], X86_RAX);
         emit_load_operand(cc, &ops[1], X86_RCX);
-        emit_cmovcc(cc, LR_CC_NE, X86_RAX, X86_RCX, 8);
+        emit_cmovcc(cc, sel_cc, X86_RAX, X86_RCX, 8);
         emit_store_slot(cc, desc->dest, X86_RAX);
         break;
     }
@@ -2469,6 +6008,20 @@ static int x86_64_compile_emit(void *compile_ctx,
         cc->current_inst = NULL;
         return 0;
     }
+    case LR_OP_SWITCH: {
+        lr_operand_t *sw_ops = lr_arena_array_uninit(cc->arena, lr_operand_t,
+                                                     nops);
+        if (nops < 2 || !sw_ops)
+            return -1;
+        memcpy(sw_ops, ops, sizeof(*sw_ops) * nops);
+        ctx->deferred.pending = true;
+        ctx->deferred.op = LR_OP_SWITCH;
+        ctx->deferred.switch_ops = sw_ops;
+        ctx->deferred.num_ops = nops;
+        ctx->deferred.block_id = ctx->current_block_id;
+        cc->current_inst = NULL;
+        return 0;
+    }
     case LR_OP_ALLOCA: {
         size_t elem_sz = lr_type_size(desc->type);
         size_t elem_align = desc->align ? (size_t)desc->align
@@ -2488,10 +6041,10 @@ static int x86_64_compile_emit(void *compile_ctx,
                 cc->static_alloca_offsets, cc->num_static_alloca_offsets,
                 desc->dest);
             if (off == 0) {
-                cc->stack_size = (uint32_t)align_up(cc->stack_size,
-                                                     elem_align);
-                cc->stack_size += (uint32_t)total_sz;
-                off = -(int32_t)cc->stack_size;
+                off = lr_target_frame_slot(cc->slot_coloring, desc->dest,
+                                           true, (uint32_t)total_sz,
+                                           (uint32_t)elem_align,
+                                           &cc->stack_size);
                 lr_target_set_static_alloca_offset(
                     cc->arena, &cc->static_alloca_offsets,
                     &cc->num_static_alloca_offsets, desc->dest, off);
@@ -2517,14 +6070,35 @@ static int x86_64_compile_emit(void *compile_ctx,
                           X86_RSP, X86_RAX, 8);
             encode_alu_rr(cc->buf, &cc->pos, cc->buflen, 0x89,
                           X86_RAX, X86_RSP, 8);
+            cc->frame_pinned = true;
             emit_store_slot(cc, desc->dest, X86_RAX);
         }
         break;
     }
     case LR_OP_LOAD: {
-        emit_load_operand(cc, &ops[0], X86_RAX);
+        x86_addr_t addr;
         size_t load_sz = lr_type_size(desc->type);
         if (load_sz == 0) load_sz = 8;
+        if (load_sz <= 8 && direct_take_gep_addr(ctx, &ops[0], &addr)) {
+            uint8_t sz = (uint8_t)load_sz;
+            if (sz < 4)
+                encode_mem_addr(cc->buf, &cc->pos, cc->buflen,
+                                sz == 1 ? 0x0FB6 : 0x0FB7, X86_RAX, &addr, 8);
+            else
+                encode_mem_addr(cc->buf, &cc->pos, cc->buflen, 0x8B,
+                                X86_RAX, &addr, sz);
+            invalidate_cached_reg(cc, X86_RAX);
+            emit_store_slot(cc, desc->dest, X86_RAX);
+            break;
+        }
+        emit_load_operand(cc, &ops[0], X86_RAX);
+        if (vreg_xmm_home(cc, desc->dest) != X86_NO_HOME) {
+            /* movsd / movss home, [rax] */
+            emit_load_fp_mem_base(cc, X86_RAX, 0,
+                                  vreg_xmm_home(cc, desc->dest),
+                                  (uint8_t)load_sz);
+            break;
+        }
         if (load_sz > 8) {
             size_t load_align = lr_type_align(desc->type);
             int32_t dst_off = alloc_slot(cc, desc->dest, load_sz,
@@ -2543,9 +6117,17 @@ static int x86_64_compile_emit(void *compile_ctx,
         break;
     }
     case LR_OP_STORE: {
-        emit_load_operand(cc, &ops[1], X86_RCX);
+        x86_addr_t addr;
         size_t store_sz = lr_type_size(ops[0].type);
         if (store_sz == 0) store_sz = 8;
+        if (store_sz <= 8 && direct_take_gep_addr(ctx, &ops[1], &addr)) {
+            uint8_t src = operand_in_reg(cc, &ops[0], X86_R10);
+            encode_mem_addr(cc->buf, &cc->pos, cc->buflen,
+                            store_sz == 1 ? 0x88 : 0x89, src, &addr,
+                            (uint8_t)store_sz);
+            break;
+        }
+        emit_load_operand(cc, &ops[1], X86_RCX);
         if (store_sz > 8) {
             if (ops[0].kind == LR_VAL_IMM_I64 && ops[0].imm_i64 == 0) {
                 emit_mem_zero_base(cc, X86_RCX, 0, store_sz);
@@ -2593,12 +6175,70 @@ static int x86_64_compile_emit(void *compile_ctx,
             emit_mem_zero_base(cc, X86_RCX, 0, store_sz);
             break;
         }
+        if (ops[0].kind == LR_VAL_VREG &&
+            vreg_xmm_home(cc, ops[0].vreg) != X86_NO_HOME) {
+            emit_store_fp_mem_base(cc, X86_RCX, 0,
+                                   vreg_xmm_home(cc, ops[0].vreg),
+                                   (uint8_t)store_sz);
+            break;
+        }
         emit_load_operand(cc, &ops[0], X86_RAX);
         emit_mem_store_sized(cc, X86_RAX, X86_RCX, 0,
                              (uint8_t)store_sz);
         break;
     }
     case LR_OP_GEP: {
+        lr_gep_addr_t ga;
+        if (lr_target_gep_addr(desc->type, ops, nops, &ga) &&
+            (ga.index_op == 0 || ga.scale == 1 || ga.scale == 2 ||
+             ga.scale == 4 || ga.scale == 8)) {
+            /* base + index * {1,2,4,8} + disp32: one lea, and the address
+               folds into a single following load or store. */
+            x86_addr_t a;
+            int32_t alloca_off = 0;
+            if (ops[0].kind == LR_VAL_VREG)
+                alloca_off = lr_target_lookup_static_alloca_offset(
+                    cc->static_alloca_offsets,
+                    cc->num_static_alloca_offsets, ops[0].vreg);
+            if (alloca_off != 0)
+                ga.disp += alloca_off;
+            if (ga.disp >= INT32_MIN && ga.disp <= INT32_MAX) {
+                a.base = alloca_off != 0 ? X86_RBP
+                                         : operand_in_reg(cc, &ops[0], X86_RAX);
+                a.index = X86_NO_HOME;
+                a.scale = 1;
+                a.disp = (int32_t)ga.disp;
+                if (ga.index_op != 0) {
+                    const lr_operand_t *io = &ops[ga.index_op];
+                    a.scale = (uint8_t)ga.scale;
+                    if (ga.index_signext_bytes == 0) {
+                        a.index = operand_in_reg(cc, io, X86_RCX);
+                    } else {
+                        emit_load_operand(cc, io, X86_RCX);
+                        if (ga.index_signext_bytes == 4)
+                            emit_movsxd(cc, X86_RCX, X86_RCX);
+                        else
+                            emit_movsx_rr(cc, X86_RCX, X86_RCX,
+                                          ga.index_signext_bytes);
+                        a.index = X86_RCX;
+                    }
+                }
+                ctx->addr_ready = cc->pos;
+                if (a.base != X86_RAX || a.index != X86_NO_HOME ||
+                    a.disp != 0) {
+                    encode_mem_addr(cc->buf, &cc->pos, cc->buflen, 0x8D,
+                                    X86_RAX, &a, 8);
+                    invalidate_cached_reg(cc, X86_RAX);
+                }
+                emit_store_slot(cc, desc->dest, X86_RAX);
+                ctx->addr_valid = true;
+                ctx->addr_vreg = desc->dest;
+                ctx->addr_block_id = ctx->current_block_id;
+                ctx->addr_end = cc->pos;
+                ctx->addr_mem = a;
+                break;
+            }
+        }
         emit_load_operand(cc, &ops[0], X86_RAX);
         const lr_type_t *cur_ty = desc->type;
         for (uint32_t idx = 1; idx < nops; idx++) {
@@ -2678,8 +6318,8 @@ static int x86_64_compile_emit(void *compile_ctx,
         uint8_t fsize = (ops[0].type &&
                          ops[0].type->kind == LR_TYPE_FLOAT) ? 4 : 8;
         emit_load_fp_operand(cc, &ops[0], FP_SCRATCH0, fsize);
-        emit_load_fp_operand(cc, &ops[1], FP_SCRATCH1, fsize);
-        emit_fcmp(cc, FP_SCRATCH0, FP_SCRATCH1, fsize);
+        emit_fcmp(cc, FP_SCRATCH0,
+                  fp_operand_in_reg(cc, &ops[1], FP_SCRATCH1, fsize), fsize);
         uint8_t fcc = lr_target_cc_from_fcmp(
             (lr_fcmp_pred_t)desc->fcmp_pred);
         emit_setcc(cc, fcc, X86_RAX);
@@ -2994,6 +6634,35 @@ static int x86_64_compile_emit(void *compile_ctx,
             }
             if (x86_is_llvm_va_end_name(cname))
                 break;
+            {
+                uint8_t intrin_bits = 0;
+                lr_int_intrinsic_t int_intrin =
+                    lr_target_classify_int_intrinsic(cname, &intrin_bits);
+                if (int_intrin != LR_INT_INTRIN_NONE &&
+                    x86_emit_int_intrinsic(cc, int_intrin, intrin_bits, ops,
+                                           nops, desc->type, desc->dest))
+                    break;
+            }
+            {
+                uint8_t fp_bits = 0;
+                lr_fp_intrinsic_t fp_intrin =
+                    lr_target_classify_fp_intrinsic(cname, &fp_bits);
+                if (fp_intrin != LR_FP_INTRIN_NONE &&
+                    x86_emit_fp_intrinsic(cc, fp_intrin, fp_bits, ops, nops,
+                                          desc->dest))
+                    break;
+            }
+            {
+                uint32_t mem_len = 0;
+                lr_mem_intrinsic_t mem_intrin =
+                    lr_target_classify_mem_intrinsic(cname);
+                if (mem_intrin != LR_MEM_INTRIN_NONE &&
+                    lr_target_mem_inline_plan(mem_intrin, ops, nops,
+                                              &cc->mem_inline, &mem_len)) {
+                    x86_emit_mem_intrinsic(cc, mem_intrin, ops, mem_len);
+                    break;
+                }
+            }
             if (x86_is_llvm_va_copy_name(cname)) {
                 if (nops >= 3) {
                     emit_load_operand(cc, &ops[1], X86_RAX);
@@ -3026,20 +6695,40 @@ static int x86_64_compile_emit(void *compile_ctx,
         bool use_external_sysv_fp = false;
         bool callee_vararg = false;
         bool internal_sret = false;
+        bool tail_call = false;
+        uint8_t arg_base = X86_RSP;
+        int32_t arg_base_off = 0;
         uint32_t internal_gp_start = 0;
         uint32_t internal_gp_cap = 6;
+        lr_cc_loc_t *fast_locs = NULL;
 
         use_external_sysv_fp = direct_call_uses_external_sysv_abi(
             cc, &ops[0], desc->call_external_abi, desc->call_vararg,
             &callee_func, &callee_vararg);
-        internal_sret = !use_external_sysv_fp &&
-                        uses_internal_sret_abi(desc->type);
+        if (callee_func && callee_func->fast_cc && !desc->call_vararg &&
+            ops[0].kind == LR_VAL_GLOBAL &&
+            ops[0].global_id == callee_func->symbol_id &&
+            nargs == callee_func->num_params && nargs > 0) {
+            fast_locs = lr_arena_array(cc->arena, lr_cc_loc_t, nargs);
+            if (!fast_locs)
+                return -1;
+        }
+        /* Wide vectors use the hidden result pointer under either ABI, as
+           compile_begin does for the callee. */
+        internal_sret = uses_internal_sret_abi(desc->type) &&
+                        !fp_abi_two_lane_aggregate(desc->type, NULL, NULL) &&
+                        (!use_external_sysv_fp ||
+                         desc->type->kind == LR_TYPE_VECTOR);
         if (internal_sret) {
             internal_gp_start = 1;
             internal_gp_cap = 5;
         }
 
-        if (use_external_sysv_fp) {
+        if (fast_locs) {
+            stack_args = lr_target_fast_cc_assign(callee_func->param_types,
+                                                  nargs, 6, 8, fast_locs);
+        } else if (use_external_sysv_fp) {
+            gp_used = internal_gp_start;
             for (uint32_t i = 0; i < nargs; i++) {
                 const lr_type_t *arg_type = call_arg_abi_type(
                     callee_func, i, &ops[i + 1]);
@@ -3066,13 +6755,68 @@ static int x86_64_compile_emit(void *compile_ctx,
                 nargs - internal_gp_cap : 0;
         }
 
-        stack_bytes = ((stack_args * 8 + 15) & ~15u);
-        if (stack_bytes > 0)
-            emit_frame_alloc(cc, stack_bytes);
+        tail_call = x86_can_tail_call(cc, desc, ops, stack_args,
+                                      internal_sret);
+        if (tail_call) {
+            /* Stack arguments overwrite our own incoming ones, which the
+               prologue has already copied into slots. */
+            arg_base = X86_RBP;
+            arg_base_off = 16;
+        } else {
+            stack_bytes = ((stack_args * 8 + 15) & ~15u);
+            if (stack_bytes > 0)
+                emit_frame_alloc(cc, stack_bytes);
+        }
 
-        if (use_external_sysv_fp) {
+        if (internal_sret && tail_call) {
+            /* Pass our own result pointer on for the callee to fill. */
+            emit_mem_load_sized(cc, X86_RDI, X86_RBP, cc->sret_ptr_off, 8);
+        } else if (internal_sret) {
+            size_t dst_sz = lr_type_size(desc->type);
+            size_t dst_align = lr_type_align(desc->type);
+            int32_t doff;
+            if (dst_align < 8) dst_align = 8;
+            if (dst_sz < 8) dst_sz = 8;
+            doff = alloc_slot(cc, desc->dest, dst_sz, dst_align);
+            encode_mem(cc->buf, &cc->pos, cc->buflen, 0x8D,
+                       X86_RDI, X86_RBP, doff, 8);
+        }
+
+        if (fast_locs) {
+            /* Stack slots go first, staged through RAX before any
+               argument register is live; FP-file locations next, since
+               a GP value bound for an XMM register also passes through
+               RAX. */
+            for (uint32_t i = 0; i < nargs; i++) {
+                if (fast_locs[i].kind != LR_CC_LOC_STACK)
+                    continue;
+                emit_load_operand(cc, &ops[i + 1], X86_RAX);
+                encode_mem(cc->buf, &cc->pos, cc->buflen, 0x89,
+                           X86_RAX, arg_base,
+                           arg_base_off + (int32_t)(fast_locs[i].index * 8u),
+                           8);
+            }
+            for (uint32_t i = 0; i < nargs; i++) {
+                const lr_type_t *pty = callee_func->param_types[i];
+                uint8_t reg = call_fp_regs[fast_locs[i].index];
+                if (fast_locs[i].kind != LR_CC_LOC_FP)
+                    continue;
+                if (is_fp_abi_type(pty)) {
+                    emit_load_external_fp_call_arg(cc, &ops[i + 1], pty, reg);
+                } else {
+                    emit_load_operand(cc, &ops[i + 1], X86_RAX);
+                    /* movq xmm, rax */
+                    emit_0f_rr(cc, 0x66, 0x6E, reg, X86_RAX, 8);
+                }
+            }
+            for (uint32_t i = 0; i < nargs; i++) {
+                if (fast_locs[i].kind == LR_CC_LOC_GP)
+                    emit_load_operand(cc, &ops[i + 1],
+                                      call_regs[fast_locs[i].index]);
+            }
+        } else if (use_external_sysv_fp) {
             uint32_t stack_idx = 0;
-            gp_used = 0;
+            gp_used = internal_gp_start;
             fp_used = 0;
             for (uint32_t i = 0; i < nargs; i++) {
                 const lr_type_t *arg_type = call_arg_abi_type(
@@ -3104,15 +6848,31 @@ static int x86_64_compile_emit(void *compile_ctx,
                 }
                 if (!is_fp_abi_type(arg_type) && !is_fp_agg &&
                     gp_used < 6) {
-                    emit_load_operand(cc, &ops[i + 1],
-                                      call_regs[gp_used]);
+                    if (!(arg_type && arg_type->kind == LR_TYPE_VECTOR &&
+                          emit_aggregate_call_arg(cc, &ops[i + 1],
+                                                  call_regs[gp_used])))
+                        emit_load_operand(cc, &ops[i + 1],
+                                          call_regs[gp_used]);
                     gp_used++;
                     continue;
                 }
+                if (is_fp_abi_type(arg_type) &&
+                    !(ops[i + 1].type &&
+                      ops[i + 1].type->kind == LR_TYPE_PTR)) {
+                    /* Stage the bits through RAX: FP_SCRATCH0 is XMM0,
+                       which already holds the first FP argument. */
+                    emit_load_operand(cc, &ops[i + 1], X86_RAX);
+                    encode_mem(cc->buf, &cc->pos, cc->buflen, 0x89,
+                               X86_RAX, arg_base,
+                               arg_base_off + (int32_t)(stack_idx * 8), 8);
+                    stack_idx++;
+                    continue;
+                }
                 if (is_fp_abi_type(arg_type)) {
                     emit_load_external_fp_call_arg(cc, &ops[i + 1], arg_type,
                                                    FP_SCRATCH0);
-                    emit_store_fp_mem_base(cc, X86_RSP,
+                    emit_store_fp_mem_base(cc, arg_base,
+                                           arg_base_off +
                                            (int32_t)(stack_idx * 8),
                                            FP_SCRATCH0,
                                            fp_abi_size(arg_type));
@@ -3131,50 +6891,55 @@ static int x86_64_compile_emit(void *compile_ctx,
                         x86_fpagg_load_elem(cc, &src, off, FP_SCRATCH0,
                                             agg_lane_size);
                         emit_store_fp_mem_base(
-                            cc, X86_RSP,
-                            (int32_t)((stack_idx + lane) * 8u),
+                            cc, arg_base,
+                            arg_base_off + (int32_t)((stack_idx + lane) * 8u),
                             FP_SCRATCH0, agg_lane_size);
                     }
                     stack_idx += agg_stack_units;
                     continue;
                 }
-                emit_load_operand(cc, &ops[i + 1], X86_RAX);
+                if (!(arg_type && arg_type->kind == LR_TYPE_VECTOR &&
+                      emit_aggregate_call_arg(cc, &ops[i + 1], X86_RAX)))
+                    emit_load_operand(cc, &ops[i + 1], X86_RAX);
                 encode_mem(cc->buf, &cc->pos, cc->buflen, 0x89,
-                           X86_RAX, X86_RSP,
-                           (int32_t)(stack_idx * 8), 8);
+                           X86_RAX, arg_base,
+                           arg_base_off + (int32_t)(stack_idx * 8), 8);
                 stack_idx++;
             }
             fp_used_for_call = fp_used;
         } else {
             uint32_t nstack = nargs > internal_gp_cap ?
                 nargs - internal_gp_cap : 0;
-            if (internal_sret) {
-                size_t dst_sz = lr_type_size(desc->type);
-                size_t dst_align = lr_type_align(desc->type);
-                int32_t doff;
-                if (dst_align < 8) dst_align = 8;
-                if (dst_sz < 8) dst_sz = 8;
-                doff = alloc_slot(cc, desc->dest, dst_sz, dst_align);
-                encode_mem(cc->buf, &cc->pos, cc->buflen, 0x8D,
-                           X86_RDI, X86_RBP, doff, 8);
-            }
             for (uint32_t i = 0; i < nstack; i++) {
                 uint32_t arg_idx = internal_gp_cap + i;
-                emit_load_operand(cc, &ops[arg_idx + 1], X86_RAX);
+                if (!emit_aggregate_call_arg(cc, &ops[arg_idx + 1], X86_RAX))
+                    emit_load_operand(cc, &ops[arg_idx + 1], X86_RAX);
                 encode_mem(cc->buf, &cc->pos, cc->buflen, 0x89,
-                           X86_RAX, X86_RSP, (int32_t)(i * 8), 8);
+                           X86_RAX, arg_base,
+                           arg_base_off + (int32_t)(i * 8), 8);
+            }
+            for (uint32_t i = 0; i < nargs && i < internal_gp_cap; i++) {
+                uint8_t reg = call_regs[internal_gp_start + i];
+                if (!emit_aggregate_call_arg(cc, &ops[i + 1], reg))
+                    emit_load_operand(cc, &ops[i + 1], reg);
             }
-            for (uint32_t i = 0; i < nargs && i < internal_gp_cap; i++)
-                emit_load_operand(cc, &ops[i + 1],
-                                  call_regs[internal_gp_start + i]);
         }
 
         if (callee_vararg)
             emit_mov_imm(cc, X86_RAX, (int64_t)fp_used_for_call,
                          false);
 
-        emit_load_operand(cc, &ops[0], X86_R10);
-        emit_call_r10(cc);
+        if (tail_call) {
+            emit_tail_jump(cc, &ops[0]);
+            invalidate_cached_gprs(cc);
+            ctx->tail_jumped = true;
+            break;
+        }
+
+        if (!emit_call_global(cc, &ops[0])) {
+            emit_load_operand(cc, &ops[0], X86_R10);
+            emit_call_r10(cc);
+        }
 
         if (stack_bytes > 0)
             emit_frame_free(cc, stack_bytes);
@@ -3221,7 +6986,8 @@ static int x86_64_compile_emit(void *compile_ctx,
         size_t phi_al = desc->type ? lr_type_align(desc->type) : 8;
         if (phi_sz < 8) phi_sz = 8;
         if (phi_al < 8) phi_al = 8;
-        (void)alloc_slot(cc, desc->dest, phi_sz, phi_al);
+        if (!vreg_is_homed(cc, desc->dest))
+            (void)alloc_slot(cc, desc->dest, phi_sz, phi_al);
         break;
     }
     case LR_OP_UNREACHABLE:
@@ -3239,6 +7005,264 @@ static int x86_64_compile_emit(void *compile_ctx,
     return 0;
 }
 
+/* ---- Branch relaxation ---- */
+
+/* A relaxable jmp/jcc: [start, end) is its rel32 form, size what it
+   currently takes (end - start, 2 for rel8, 0 once dropped).  Frame
+   instructions elided by x86_frame_drops ride along as non-branch
+   entries of size 0. */
+typedef struct {
+    size_t start;
+    size_t end;
+    size_t target;
+    uint32_t fixup;
+    uint8_t cc;
+    uint8_t size;
+    bool is_jcc;
+    bool is_branch;
+} x86_relax_t;
+
+typedef struct {
+    size_t start;
+    size_t end;
+} x86_span_t;
+
+static int x86_relax_cmp(const void *a, const void *b) {
+    size_t sa = ((const x86_relax_t *)a)->start;
+    size_t sb = ((const x86_relax_t *)b)->start;
+    return sa < sb ? -1 : sa > sb ? 1 : 0;
+}
+
+static int x86_size_cmp(const void *a, const void *b) {
+    size_t sa = *(const size_t *)a;
+    size_t sb = *(const size_t *)b;
+    return sa < sb ? -1 : sa > sb ? 1 : 0;
+}
+
+/* New offset of pos: less the bytes saved by every branch ending at or
+   before it.  saved[i] is the total saved by r[0..i-1]. */
+static size_t x86_relax_map(const x86_relax_t *r, const size_t *saved,
+                            uint32_t n, size_t pos) {
+    uint32_t lo = 0, hi = n;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2u;
+        if (r[mid].end <= pos)
+            lo = mid + 1u;
+        else
+            hi = mid;
+    }
+    return pos - saved[lo];
+}
+
+static void x86_relax_sums(const x86_relax_t *r, size_t *saved, uint32_t n) {
+    saved[0] = 0;
+    for (uint32_t i = 0; i < n; i++)
+        saved[i + 1] = saved[i] + (r[i].end - r[i].start) - r[i].size;
+}
+
+static size_t x86_fixup_target(const x86_compile_ctx_t *cc,
+                               const x86_fixup_t *f) {
+    if (f->target_pos_hint != SIZE_MAX)
+        return f->target_pos_hint;
+    if (f->target < cc->num_block_offsets)
+        return cc->block_entry_offsets[f->target];
+    return SIZE_MAX;
+}
+
+/* Resolve every fixup and relax branches in place: drop jumps to the
+   next instruction, turn "jcc L; jmp M; L:" into "jncc M", and use rel8
+   where it reaches.  Sizes only shrink, so iterating to a fixed point
+   terminates; the code is then compacted, dropping the given spans as
+   well, and fixups, block offsets, constant pool loads and this
+   function's relocations are remapped. */
+static int x86_relax_branches(x86_compile_ctx_t *cc, const x86_span_t *drops,
+                              uint32_t num_drops) {
+    uint32_t nf = cc->num_fixups;
+    uint32_t n = 0, nlabels = 0;
+    x86_relax_t *r;
+    size_t *saved, *labels, *targets;
+    size_t rd = 0, wr = 0;
+    bool changed = true;
+
+    if (nf == 0 && num_drops == 0)
+        return 0;
+    r = lr_arena_array_uninit(cc->arena, x86_relax_t, nf + num_drops);
+    saved = lr_arena_array_uninit(cc->arena, size_t, nf + num_drops + 1u);
+    labels = lr_arena_array_uninit(cc->arena, size_t, nf + 1u);
+    targets = lr_arena_array_uninit(cc->arena, size_t, nf + 1u);
+    if (!r || !saved || !labels || !targets)
+        return -1;
+
+    for (uint32_t i = 0; i < num_drops; i++) {
+        r[n].start = drops[i].start;
+        r[n].end = drops[i].end;
+        r[n].target = SIZE_MAX;
+        r[n].fixup = UINT32_MAX;
+        r[n].cc = 0;
+        r[n].size = 0;
+        r[n].is_jcc = false;
+        r[n].is_branch = false;
+        n++;
+    }
+
+    for (uint32_t i = 0; i < nf; i++) {
+        const x86_fixup_t *f = &cc->fixups[i];
+        size_t start;
+        targets[i] = x86_fixup_target(cc, f);
+        if (targets[i] == SIZE_MAX || f->pos + 4 > cc->pos)
+            continue;
+        labels[nlabels++] = targets[i];
+        if (f->kind != X86_FIXUP_JMP && f->kind != X86_FIXUP_JCC)
+            continue;
+        start = f->pos - (f->kind == X86_FIXUP_JCC ? 2u : 1u);
+        if (targets[i] > start && targets[i] < f->pos + 4)
+            continue;
+        r[n].start = start;
+        r[n].end = f->pos + 4;
+        r[n].target = targets[i];
+        r[n].fixup = i;
+        r[n].cc = f->kind == X86_FIXUP_JCC ? (cc->buf[f->pos - 1] & 0x0F) : 0;
+        r[n].size = (uint8_t)(r[n].end - start);
+        r[n].is_jcc = f->kind == X86_FIXUP_JCC;
+        r[n].is_branch = true;
+        n++;
+    }
+    qsort(r, n, sizeof(*r), x86_relax_cmp);
+    qsort(labels, nlabels, sizeof(*labels), x86_size_cmp);
+
+    for (uint32_t i = 0; i + 1 < n; i++) {
+        x86_relax_t *j = &r[i], *k = &r[i + 1];
+        if (j->is_jcc && k->is_branch && !k->is_jcc && j->end == k->start &&
+            j->target == k->end &&
+            !(k->target >= k->start && k->target < k->end) &&
+            !bsearch(&k->start, labels, nlabels, sizeof(*labels),
+                     x86_size_cmp)) {
+            j->cc ^= 1u;
+            j->target = k->target;
+            k->size = 0;
+        }
+    }
+
+    while (changed) {
+        changed = false;
+        x86_relax_sums(r, saved, n);
+        for (uint32_t i = 0; i < n; i++) {
+            size_t at, to;
+            int64_t disp;
+            if (r[i].size == 0)
+                continue;
+            at = x86_relax_map(r, saved, n, r[i].start);
+            to = x86_relax_map(r, saved, n, r[i].target);
+            if (r[i].target >= r[i].end) {
+                disp = (int64_t)to - (int64_t)x86_relax_map(r, saved, n,
+                                                            r[i].end);
+                if (disp == 0) {
+                    r[i].size = 0;
+                    changed = true;
+                    continue;
+                }
+            } else {
+                disp = (int64_t)to - (int64_t)(at + 2u);
+            }
+            if (r[i].size > 2 && disp >= -128 && disp <= 127) {
+                r[i].size = 2;
+                changed = true;
+            }
+        }
+    }
+    x86_relax_sums(r, saved, n);
+    if (saved[n] == 0)
+        goto patch;
+
+    for (uint32_t i = 0; i < n; i++) {
+        size_t len = r[i].start - rd;
+        int64_t rel;
+        memmove(cc->buf + wr, cc->buf + rd, len);
+        wr += len;
+        rd = r[i].end;
+        if (!r[i].is_branch)
+            continue;
+        rel = (int64_t)x86_relax_map(r, saved, n, r[i].target) -
+              (int64_t)(wr + r[i].size);
+        if (r[i].size == 2) {
+            cc->buf[wr++] = r[i].is_jcc ? (uint8_t)(0x70u | r[i].cc) : 0xEB;
+            cc->buf[wr++] = (uint8_t)(int8_t)rel;
+        } else if (r[i].size != 0) {
+            if (r[i].is_jcc) {
+                cc->buf[wr++] = 0x0F;
+                cc->buf[wr++] = (uint8_t)(0x80u | r[i].cc);
+            } else {
+                cc->buf[wr++] = 0xE9;
+            }
+            patch_u32(cc->buf, cc->buflen, wr, (uint32_t)(int32_t)rel);
+            wr += 4;
+        }
+        cc->fixups[r[i].fixup].target = UINT32_MAX;
+        cc->fixups[r[i].fixup].target_pos_hint = SIZE_MAX;
+    }
+    memmove(cc->buf + wr, cc->buf + rd, cc->pos - rd);
+    cc->pos = wr + (cc->pos - rd);
+
+    for (uint32_t i = 0; i < cc->num_block_offsets; i++) {
+        if (cc->block_offsets[i] != SIZE_MAX)
+            cc->block_offsets[i] =
+                x86_relax_map(r, saved, n, cc->block_offsets[i]);
+        if (cc->block_entry_offsets[i] != SIZE_MAX)
+            cc->block_entry_offsets[i] =
+                x86_relax_map(r, saved, n, cc->block_entry_offsets[i]);
+    }
+    if (cc->obj_ctx) {
+        for (uint32_t i = cc->reloc_base; i < cc->obj_ctx->num_relocs; i++)
+            cc->obj_ctx->relocs[i].offset = (uint32_t)x86_relax_map(
+                r, saved, n, cc->obj_ctx->relocs[i].offset);
+    }
+    for (uint32_t i = 0; i < cc->const_pool.num_refs; i++)
+        cc->const_pool.refs[i].pos =
+            x86_relax_map(r, saved, n, cc->const_pool.refs[i].pos);
+
+patch:
+    /* Relaxed branches were written above (and marked resolved); the
+       remaining displacements are computed in the final layout. */
+    for (uint32_t i = 0; i < nf; i++) {
+        x86_fixup_t *f = &cc->fixups[i];
+        size_t pos, base;
+        if (targets[i] == SIZE_MAX ||
+            (f->target == UINT32_MAX && f->target_pos_hint == SIZE_MAX))
+            continue;
+        pos = x86_relax_map(r, saved, n, f->pos);
+        base = f->kind == X86_FIXUP_TABLE
+                   ? x86_relax_map(r, saved, n, f->base)
+                   : pos + 4;
+        patch_u32(cc->buf, cc->buflen, pos,
+                  (uint32_t)(int32_t)((int64_t)x86_relax_map(r, saved, n,
+                                                             targets[i]) -
+                                      (int64_t)base));
+    }
+    return 0;
+}
+
+/* Frame instructions a leaf can do without.  With no calls, stencils or
+   rsp adjustments the slots fit below rsp in the 128-byte red zone, so
+   "sub rsp" and each "mov rsp, rbp" go; with no slots, saved registers or
+   stack arguments rbp is unused and push/pop rbp go too.  Returns the
+   number of spans written to out (at most num_epilogues + 1). */
+static uint32_t x86_frame_drops(const x86_compile_ctx_t *cc, size_t imm_pos,
+                                uint32_t frame_size, x86_span_t *out) {
+    uint32_t n = 0;
+    bool frameless;
+    if (cc->frame_pinned || frame_size > X86_RED_ZONE)
+        return 0;
+    frameless = frame_size == 0 && cc->num_saved_regs == 0 &&
+                !cc->reads_caller_frame;
+    out[n].start = imm_pos - (frameless ? 7u : 3u);
+    out[n++].end = imm_pos + 4u;
+    for (uint32_t i = 0; i < cc->num_epilogues; i++) {
+        out[n].start = cc->epilogue_pos[i];
+        out[n++].end = cc->epilogue_pos[i] + (frameless ? 4u : 3u);
+    }
+    return n;
+}
+
 static int x86_64_compile_end(void *compile_ctx, size_t *out_len) {
     x86_direct_ctx_t *ctx = (x86_direct_ctx_t *)compile_ctx;
     x86_compile_ctx_t *cc;
@@ -3283,48 +7307,34 @@ static int x86_64_compile_end(void *compile_ctx, size_t *out_len) {
             invalidate_cached_gprs(cc);
             direct_emit_phi_copies_for_edge(ctx, source, target, true);
             invalidate_cached_gprs(cc);
-            if (direct_ensure_fixup_cap(ctx) != 0)
-                return -1;
             emit_jmp(cc, target);
-            cc->fixups[fi].target = UINT32_MAX;
-            if (cc->fixups[fi].pos + 4 <= cc->buflen) {
-                int32_t rel = (int32_t)((int64_t)stub_pos -
-                                        (int64_t)(cc->fixups[fi].pos + 4));
-                cc->buf[cc->fixups[fi].pos + 0] = (uint8_t)(rel);
-                cc->buf[cc->fixups[fi].pos + 1] = (uint8_t)(rel >> 8);
-                cc->buf[cc->fixups[fi].pos + 2] = (uint8_t)(rel >> 16);
-                cc->buf[cc->fixups[fi].pos + 3] = (uint8_t)(rel >> 24);
-            }
-        }
-    }
-
-    for (uint32_t i = 0; i < cc->num_fixups; i++) {
-        size_t fix_pos = cc->fixups[i].pos;
-        size_t target_off = SIZE_MAX;
-        uint32_t target = cc->fixups[i].target;
-        if (target == UINT32_MAX)
-            continue;
-        if (cc->fixups[i].target_pos_hint != SIZE_MAX)
-            target_off = cc->fixups[i].target_pos_hint;
-        else if (target < cc->num_block_offsets &&
-                 cc->block_entry_offsets[target] != SIZE_MAX)
-            target_off = cc->block_entry_offsets[target];
-        if (target_off != SIZE_MAX && fix_pos + 4 <= cc->buflen) {
-            int32_t rel = (int32_t)((int64_t)target_off -
-                                    (int64_t)(fix_pos + 4));
-            cc->buf[fix_pos + 0] = (uint8_t)(rel);
-            cc->buf[fix_pos + 1] = (uint8_t)(rel >> 8);
-            cc->buf[fix_pos + 2] = (uint8_t)(rel >> 16);
-            cc->buf[fix_pos + 3] = (uint8_t)(rel >> 24);
+            cc->fixups[fi].target_pos_hint = stub_pos;
         }
     }
+    if (cc->fixups_lost)
+        return -1;
 
-    {
+    if (cc->pos <= cc->buflen) {
         uint32_t frame_stack_size = (cc->stack_size + 15u) & ~15u;
+        x86_span_t *drops = lr_arena_array_uninit(cc->arena, x86_span_t,
+                                                  cc->num_epilogues + 1u);
+        uint32_t num_drops = 0;
         patch_u32(cc->buf, cc->buflen, ctx->prologue_patch_pos,
                   frame_stack_size);
+        if (!drops)
+            return -1;
+        num_drops = x86_frame_drops(cc, ctx->prologue_patch_pos,
+                                    frame_stack_size, drops);
+        if (x86_relax_branches(cc, drops, num_drops) != 0)
+            return -1;
+        emit_const_pool(cc);
     }
 
+    lr_target_mem_inline_report("x86_64", cc->func_name, &cc->mem_inline);
+    lr_target_slot_coloring_report("x86_64", cc->func_name,
+                                   cc->slot_coloring, cc->stack_size);
+    lr_target_const_pool_report("x86_64", cc->func_name, &cc->const_pool);
+
     *out_len = cc->pos;
     if (cc->pos > cc->buflen)
         return -1;
@@ -3347,7 +7357,8 @@ static int x86_64_compile_add_phi_copy(void *compile_ctx,
         size_t al = src_op->type ? lr_type_align(src_op->type) : 8;
         if (sz < 8) sz = 8;
         if (al < 8) al = 8;
-        (void)alloc_slot(&ctx->cc, dest_vreg, sz, al);
+        if (!vreg_is_homed(&ctx->cc, dest_vreg))
+            (void)alloc_slot(&ctx->cc, dest_vreg, sz, al);
     }
 
     x86_stream_phi_copy_t *entry = &ctx->phi_copies[ctx->phi_copy_count++];
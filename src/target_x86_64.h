@@ -15,6 +15,8 @@ enum {
 enum {
     X86_XMM0 = 0, X86_XMM1 = 1, X86_XMM2 = 2, X86_XMM3 = 3,
     X86_XMM4 = 4, X86_XMM5 = 5, X86_XMM6 = 6, X86_XMM7 = 7,
+    X86_XMM8 = 8, X86_XMM9 = 9, X86_XMM10 = 10, X86_XMM11 = 11,
+    X86_XMM12 = 12, X86_XMM13 = 13, X86_XMM14 = 14, X86_XMM15 = 15,
 };
 
 /* x86_64 condition codes */
@@ -1017,6 +1017,7 @@ static bool opcode_has_dest(lr_opcode_t op, lr_type_t *type) {
     case LR_OP_RET_VOID:
     case LR_OP_BR:
     case LR_OP_CONDBR:
+    case LR_OP_SWITCH:
     case LR_OP_UNREACHABLE:
     case LR_OP_STORE:
         return false;
@@ -1105,6 +1106,7 @@ static int replay_function_to_session(const lr_module_t *src_mod,
             desc.fcmp_pred = inst->fcmp_pred;
             desc.call_external_abi = inst->call_external_abi;
             desc.call_vararg = inst->call_vararg;
+            desc.call_tail = inst->call_tail;
             desc.call_fixed_args = inst->call_fixed_args;
 
             if (desc.num_operands > 0) {
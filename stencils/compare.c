@@ -0,0 +1,72 @@
+#include "stencil.h"
+
+/*
+ * icmp/fcmp.  The i1 result is stored zero-extended to 8 bytes, matching
+ * the setcc + movzx sequence of the ISel path.
+ */
+
+#define ICMP(pred, bits, expr) \
+    LR_STENCIL(icmp_##pred##_i##bits) { \
+        uint##bits##_t a = LR_SLOT_AS(uint##bits##_t, frame, src0_off); \
+        uint##bits##_t b = LR_SLOT_AS(uint##bits##_t, frame, src1_off); \
+        LR_SLOT_AS(uint64_t, frame, dst_off) = (uint64_t)(expr); \
+        LR_CONTINUE(); \
+    } \
+    LR_STENCIL(icmp_##pred##_i##bits##_imm) { \
+        uint##bits##_t a = LR_SLOT_AS(uint##bits##_t, frame, src0_off); \
+        uint##bits##_t b = (uint##bits##_t)LR_IMM64(); \
+        LR_SLOT_AS(uint64_t, frame, dst_off) = (uint64_t)(expr); \
+        LR_CONTINUE(); \
+    }
+
+#define ICMPS(bits) \
+    ICMP(eq, bits, a == b) \
+    ICMP(ne, bits, a != b) \
+    ICMP(sgt, bits, (int##bits##_t)a > (int##bits##_t)b) \
+    ICMP(sge, bits, (int##bits##_t)a >= (int##bits##_t)b) \
+    ICMP(slt, bits, (int##bits##_t)a < (int##bits##_t)b) \
+    ICMP(sle, bits, (int##bits##_t)a <= (int##bits##_t)b) \
+    ICMP(ugt, bits, a > b) \
+    ICMP(uge, bits, a >= b) \
+    ICMP(ult, bits, a < b) \
+    ICMP(ule, bits, a <= b)
+
+ICMPS(8)
+ICMPS(16)
+ICMPS(32)
+ICMPS(64)
+
+#define FCMP(pred, suffix, T, U, expr) \
+    LR_STENCIL(fcmp_##pred##_##suffix) { \
+        T a = LR_SLOT_AS(T, frame, src0_off); \
+        T b = LR_SLOT_AS(T, frame, src1_off); \
+        LR_SLOT_AS(uint64_t, frame, dst_off) = (uint64_t)(expr); \
+        LR_CONTINUE(); \
+    } \
+    LR_STENCIL(fcmp_##pred##_##suffix##_imm) { \
+        T a = LR_SLOT_AS(T, frame, src0_off); \
+        U bits = (U)LR_IMM64(); \
+        T b; \
+        __builtin_memcpy(&b, &bits, sizeof(b)); \
+        LR_SLOT_AS(uint64_t, frame, dst_off) = (uint64_t)(expr); \
+        LR_CONTINUE(); \
+    }
+
+#define FCMPS(suffix, T, U) \
+    FCMP(oeq, suffix, T, U, a == b) \
+    FCMP(ogt, suffix, T, U, a > b) \
+    FCMP(oge, suffix, T, U, a >= b) \
+    FCMP(olt, suffix, T, U, a < b) \
+    FCMP(ole, suffix, T, U, a <= b) \
+    FCMP(one, suffix, T, U, __builtin_islessgreater(a, b)) \
+    FCMP(ord, suffix, T, U, !__builtin_isunordered(a, b)) \
+    FCMP(ueq, suffix, T, U, !__builtin_islessgreater(a, b)) \
+    FCMP(ugt, suffix, T, U, !(a <= b)) \
+    FCMP(uge, suffix, T, U, !(a < b)) \
+    FCMP(ult, suffix, T, U, !(a >= b)) \
+    FCMP(ule, suffix, T, U, !(a > b)) \
+    FCMP(une, suffix, T, U, a != b) \
+    FCMP(uno, suffix, T, U, __builtin_isunordered(a, b))
+
+FCMPS(f32, float, uint32_t)
+FCMPS(f64, double, uint64_t)
@@ -0,0 +1,66 @@
+#include "stencil.h"
+
+/*
+ * Control flow, select and calls.
+ *
+ * br and condbr leave the branch displacement to the backend's fixup list.
+ * select reads the condition from src0, the true value from src1 and the
+ * false value from the slot whose offset is in imm64.  call_<ret>_<n>
+ * passes n integer/pointer slots (src0, src1, then the slot at imm64) in
+ * RDI/RSI/RDX and stores an integer, double or float result; the backend
+ * keeps the call 16-byte aligned by entering it like a real call frame.
+ */
+
+LR_STENCIL(br) {
+    (void)frame;
+    __hole_branch_rel();
+}
+
+LR_STENCIL(condbr_i1) {
+    __asm__ volatile("cmpb $0, %0\n\tjne __hole_branch_rel"
+                     : : "m"(LR_SLOT_AS(uint8_t, frame, src0_off)));
+    LR_CONTINUE();
+}
+
+LR_STENCIL(select_i64) {
+    uint64_t t = LR_SLOT_AS(uint64_t, frame, src1_off);
+    uint64_t f = *(uint64_t *)(frame + (intptr_t)LR_IMM64());
+    LR_SLOT_AS(uint64_t, frame, dst_off) =
+        LR_SLOT_AS(uint8_t, frame, src0_off) ? t : f;
+    LR_CONTINUE();
+}
+
+#define LR_ARG0 LR_SLOT_AS(uint64_t, frame, src0_off)
+#define LR_ARG1 LR_SLOT_AS(uint64_t, frame, src1_off)
+#define LR_ARG2 (*(uint64_t *)(frame + (intptr_t)LR_IMM64()))
+
+#define CALL_STENCILS(rname, R, store) \
+    LR_STENCIL(call_##rname##_0) { \
+        store(((R (*)(void))LR_FUNC_ADDR())()); \
+        LR_CONTINUE(); \
+    } \
+    LR_STENCIL(call_##rname##_1) { \
+        store(((R (*)(uint64_t))LR_FUNC_ADDR())(LR_ARG0)); \
+        LR_CONTINUE(); \
+    } \
+    LR_STENCIL(call_##rname##_2) { \
+        store(((R (*)(uint64_t, uint64_t))LR_FUNC_ADDR())(LR_ARG0, \
+                                                            LR_ARG1)); \
+        LR_CONTINUE(); \
+    } \
+    LR_STENCIL(call_##rname##_3) { \
+        uint64_t a2 = LR_ARG2; \
+        store(((R (*)(uint64_t, uint64_t, uint64_t))LR_FUNC_ADDR())( \
+            LR_ARG0, LR_ARG1, a2)); \
+        LR_CONTINUE(); \
+    }
+
+#define STORE_NONE(x) (void)(x)
+#define STORE_I64(x) LR_SLOT_AS(uint64_t, frame, dst_off) = (x)
+#define STORE_F64(x) LR_SLOT_AS(double, frame, dst_off) = (x)
+#define STORE_F32(x) LR_SLOT_AS(float, frame, dst_off) = (x)
+
+CALL_STENCILS(void, void, STORE_NONE)
+CALL_STENCILS(i64, uint64_t, STORE_I64)
+CALL_STENCILS(f64, double, STORE_F64)
+CALL_STENCILS(f32, float, STORE_F32)
@@ -0,0 +1,103 @@
+#include "stencil.h"
+
+/*
+ * Casts.  sext/zext are keyed by source width and always fill the whole
+ * 8-byte slot; trunc is keyed by destination width.  fptosi/fptoui use the
+ * 64-bit truncating conversion for every integer width, like the ISel path.
+ */
+
+LR_STENCIL(sext_i1) {
+    LR_SLOT_AS(uint64_t, frame, dst_off) =
+        (uint64_t)-(int64_t)(LR_SLOT_AS(uint8_t, frame, src0_off) & 1u);
+    LR_CONTINUE();
+}
+
+LR_STENCIL(zext_i1) {
+    LR_SLOT_AS(uint64_t, frame, dst_off) =
+        (uint64_t)(LR_SLOT_AS(uint8_t, frame, src0_off) & 1u);
+    LR_CONTINUE();
+}
+
+LR_STENCIL(trunc_i1) {
+    LR_SLOT_AS(uint64_t, frame, dst_off) =
+        (uint64_t)(LR_SLOT_AS(uint8_t, frame, src0_off) & 1u);
+    LR_CONTINUE();
+}
+
+#define INT_EXT(bits) \
+    LR_STENCIL(sext_i##bits) { \
+        LR_SLOT_AS(uint64_t, frame, dst_off) = \
+            (uint64_t)(int64_t)LR_SLOT_AS(int##bits##_t, frame, src0_off); \
+        LR_CONTINUE(); \
+    } \
+    LR_STENCIL(zext_i##bits) { \
+        LR_SLOT_AS(uint64_t, frame, dst_off) = \
+            (uint64_t)LR_SLOT_AS(uint##bits##_t, frame, src0_off); \
+        LR_CONTINUE(); \
+    } \
+    LR_STENCIL(trunc_i##bits) { \
+        LR_SLOT_AS(uint64_t, frame, dst_off) = \
+            (uint64_t)LR_SLOT_AS(uint##bits##_t, frame, src0_off); \
+        LR_CONTINUE(); \
+    }
+
+INT_EXT(8)
+INT_EXT(16)
+INT_EXT(32)
+
+/* bitcast/ptrtoint/inttoptr between 8-byte scalars: a plain slot copy. */
+LR_STENCIL(bitcast_i64) {
+    LR_SLOT_AS(uint64_t, frame, dst_off) = LR_SLOT_AS(uint64_t, frame, src0_off);
+    LR_CONTINUE();
+}
+
+#define INT_TO_FP(bits) \
+    LR_STENCIL(sitofp_i##bits##_f32) { \
+        LR_SLOT_AS(float, frame, dst_off) = \
+            (float)LR_SLOT_AS(int##bits##_t, frame, src0_off); \
+        LR_CONTINUE(); \
+    } \
+    LR_STENCIL(sitofp_i##bits##_f64) { \
+        LR_SLOT_AS(double, frame, dst_off) = \
+            (double)LR_SLOT_AS(int##bits##_t, frame, src0_off); \
+        LR_CONTINUE(); \
+    } \
+    LR_STENCIL(uitofp_i##bits##_f32) { \
+        LR_SLOT_AS(float, frame, dst_off) = \
+            (float)LR_SLOT_AS(uint##bits##_t, frame, src0_off); \
+        LR_CONTINUE(); \
+    } \
+    LR_STENCIL(uitofp_i##bits##_f64) { \
+        LR_SLOT_AS(double, frame, dst_off) = \
+            (double)LR_SLOT_AS(uint##bits##_t, frame, src0_off); \
+        LR_CONTINUE(); \
+    }
+
+INT_TO_FP(8)
+INT_TO_FP(16)
+INT_TO_FP(32)
+INT_TO_FP(64)
+
+LR_STENCIL(fptosi_f32) {
+    LR_SLOT_AS(int64_t, frame, dst_off) =
+        (int64_t)LR_SLOT_AS(float, frame, src0_off);
+    LR_CONTINUE();
+}
+
+LR_STENCIL(fptosi_f64) {
+    LR_SLOT_AS(int64_t, frame, dst_off) =
+        (int64_t)LR_SLOT_AS(double, frame, src0_off);
+    LR_CONTINUE();
+}
+
+LR_STENCIL(fpext_f32) {
+    LR_SLOT_AS(double, frame, dst_off) =
+        (double)LR_SLOT_AS(float, frame, src0_off);
+    LR_CONTINUE();
+}
+
+LR_STENCIL(fptrunc_f64) {
+    LR_SLOT_AS(float, frame, dst_off) =
+        (float)LR_SLOT_AS(double, frame, src0_off);
+    LR_CONTINUE();
+}
@@ -0,0 +1,44 @@
+#include "stencil.h"
+
+/*
+ * Scalar float/double arithmetic.  The _imm forms take the raw IEEE bits of
+ * the right-hand constant from the imm64 hole.
+ */
+
+#define FP_BINOP(name, suffix, T, U, op) \
+    LR_STENCIL(name##_##suffix) { \
+        T a = LR_SLOT_AS(T, frame, src0_off); \
+        T b = LR_SLOT_AS(T, frame, src1_off); \
+        LR_SLOT_AS(T, frame, dst_off) = a op b; \
+        LR_CONTINUE(); \
+    } \
+    LR_STENCIL(name##_##suffix##_imm) { \
+        T a = LR_SLOT_AS(T, frame, src0_off); \
+        U bits = (U)LR_IMM64(); \
+        T b; \
+        __builtin_memcpy(&b, &bits, sizeof(b)); \
+        LR_SLOT_AS(T, frame, dst_off) = a op b; \
+        LR_CONTINUE(); \
+    }
+
+#define FP_BINOPS(suffix, T, U) \
+    FP_BINOP(fadd, suffix, T, U, +) \
+    FP_BINOP(fsub, suffix, T, U, -) \
+    FP_BINOP(fmul, suffix, T, U, *) \
+    FP_BINOP(fdiv, suffix, T, U, /)
+
+FP_BINOPS(f32, float, uint32_t)
+FP_BINOPS(f64, double, uint64_t)
+
+/* fneg flips the sign bit, so -0.0 and NaN payloads come out right. */
+LR_STENCIL(fneg_f32) {
+    LR_SLOT_AS(uint32_t, frame, dst_off) =
+        LR_SLOT_AS(uint32_t, frame, src0_off) ^ UINT32_C(0x80000000);
+    LR_CONTINUE();
+}
+
+LR_STENCIL(fneg_f64) {
+    LR_SLOT_AS(uint64_t, frame, dst_off) =
+        LR_SLOT_AS(uint64_t, frame, src0_off) ^ UINT64_C(0x8000000000000000);
+    LR_CONTINUE();
+}
@@ -0,0 +1,45 @@
+#include "stencil.h"
+
+/*
+ * Integer binary operators for i8/i16/i32/i64.  Operands are read at their
+ * IR width; results are zero-extended into the 8-byte destination slot.
+ * Shift counts are masked like the x86 shift instructions the ISel path
+ * uses, and narrow signed division runs at 64 bits as it does there.
+ */
+
+#define INT_BINOP(name, bits, W, expr) \
+    LR_STENCIL(name##_i##bits) { \
+        uint##bits##_t a = LR_SLOT_AS(uint##bits##_t, frame, src0_off); \
+        uint##bits##_t b = LR_SLOT_AS(uint##bits##_t, frame, src1_off); \
+        LR_SLOT_AS(uint64_t, frame, dst_off) = (uint##bits##_t)(expr); \
+        LR_CONTINUE(); \
+    } \
+    LR_STENCIL(name##_i##bits##_imm) { \
+        uint##bits##_t a = LR_SLOT_AS(uint##bits##_t, frame, src0_off); \
+        uint##bits##_t b = (uint##bits##_t)LR_IMM64(); \
+        LR_SLOT_AS(uint64_t, frame, dst_off) = (uint##bits##_t)(expr); \
+        LR_CONTINUE(); \
+    }
+
+#define INT_BINOPS(bits, W, SW, M) \
+    INT_BINOP(add, bits, W, (W)a + (W)b) \
+    INT_BINOP(sub, bits, W, (W)a - (W)b) \
+    INT_BINOP(mul, bits, W, (W)a * (W)b) \
+    INT_BINOP(and, bits, W, a & b) \
+    INT_BINOP(or, bits, W, a | b) \
+    INT_BINOP(xor, bits, W, a ^ b) \
+    INT_BINOP(shl, bits, W, (W)a << (b & (M))) \
+    INT_BINOP(lshr, bits, W, (W)a >> (b & (M))) \
+    INT_BINOP(ashr, bits, W, \
+              (SW)(int##bits##_t)a >> (b & (M))) \
+    INT_BINOP(sdiv, bits, W, \
+              (int64_t)(int##bits##_t)a / (int64_t)(int##bits##_t)b) \
+    INT_BINOP(srem, bits, W, \
+              (int64_t)(int##bits##_t)a % (int64_t)(int##bits##_t)b) \
+    INT_BINOP(udiv, bits, W, (W)a / (W)b) \
+    INT_BINOP(urem, bits, W, (W)a % (W)b)
+
+INT_BINOPS(8, uint32_t, int32_t, 31)
+INT_BINOPS(16, uint32_t, int32_t, 31)
+INT_BINOPS(32, uint32_t, int32_t, 31)
+INT_BINOPS(64, uint64_t, int64_t, 63)
@@ -0,0 +1,93 @@
+#include "stencil.h"
+
+/*
+ * Loads, stores and address arithmetic.
+ *
+ * Pointer operands come in three forms: a slot holding the pointer (no
+ * suffix), a static alloca whose address is frame + src0/src1 (_frame), or
+ * an absolute address in the imm64 hole (_imm, loads only).  Store values
+ * are in src0 and the pointer in src1, in IR operand order; store _imm forms
+ * take the value from the imm64 hole.  Loads zero-extend into the slot.
+ */
+
+#define LOAD(bits) \
+    LR_STENCIL(load_i##bits) { \
+        const uint##bits##_t *p = \
+            LR_SLOT_AS(const uint##bits##_t *, frame, src0_off); \
+        LR_SLOT_AS(uint64_t, frame, dst_off) = (uint64_t)*p; \
+        LR_CONTINUE(); \
+    } \
+    LR_STENCIL(load_i##bits##_frame) { \
+        LR_SLOT_AS(uint64_t, frame, dst_off) = \
+            (uint64_t)LR_SLOT_AS(uint##bits##_t, frame, src0_off); \
+        LR_CONTINUE(); \
+    } \
+    LR_STENCIL(load_i##bits##_imm) { \
+        const uint##bits##_t *p = (const uint##bits##_t *)LR_IMM64(); \
+        LR_SLOT_AS(uint64_t, frame, dst_off) = (uint64_t)*p; \
+        LR_CONTINUE(); \
+    }
+
+#define STORE(bits) \
+    LR_STENCIL(store_i##bits) { \
+        uint##bits##_t *p = LR_SLOT_AS(uint##bits##_t *, frame, src1_off); \
+        *p = LR_SLOT_AS(uint##bits##_t, frame, src0_off); \
+        LR_CONTINUE(); \
+    } \
+    LR_STENCIL(store_i##bits##_imm) { \
+        uint##bits##_t *p = LR_SLOT_AS(uint##bits##_t *, frame, src1_off); \
+        *p = (uint##bits##_t)LR_IMM64(); \
+        LR_CONTINUE(); \
+    } \
+    LR_STENCIL(store_i##bits##_frame) { \
+        LR_SLOT_AS(uint##bits##_t, frame, src1_off) = \
+            LR_SLOT_AS(uint##bits##_t, frame, src0_off); \
+        LR_CONTINUE(); \
+    } \
+    LR_STENCIL(store_i##bits##_frame_imm) { \
+        LR_SLOT_AS(uint##bits##_t, frame, src1_off) = \
+            (uint##bits##_t)LR_IMM64(); \
+        LR_CONTINUE(); \
+    }
+
+LOAD(8)
+LOAD(16)
+LOAD(32)
+LOAD(64)
+STORE(8)
+STORE(16)
+STORE(32)
+STORE(64)
+
+/* gep with constant steps folded into one byte offset (imm64). */
+LR_STENCIL(gep_imm) {
+    LR_SLOT_AS(uint64_t, frame, dst_off) =
+        LR_SLOT_AS(uint64_t, frame, src0_off) + LR_IMM64();
+    LR_CONTINUE();
+}
+
+LR_STENCIL(gep_frame_imm) {
+    LR_SLOT_AS(uint64_t, frame, dst_off) =
+        (uint64_t)(uintptr_t)LR_SLOT(frame, src0_off) + LR_IMM64();
+    LR_CONTINUE();
+}
+
+/* gep with one runtime index in src1, scaled by the element size in imm64. */
+#define GEP_INDEX(bits) \
+    LR_STENCIL(gep_i##bits) { \
+        int64_t idx = (int64_t)LR_SLOT_AS(int##bits##_t, frame, src1_off); \
+        LR_SLOT_AS(uint64_t, frame, dst_off) = \
+            LR_SLOT_AS(uint64_t, frame, src0_off) + \
+            (uint64_t)idx * LR_IMM64(); \
+        LR_CONTINUE(); \
+    } \
+    LR_STENCIL(gep_i##bits##_frame) { \
+        int64_t idx = (int64_t)LR_SLOT_AS(int##bits##_t, frame, src1_off); \
+        LR_SLOT_AS(uint64_t, frame, dst_off) = \
+            (uint64_t)(uintptr_t)LR_SLOT(frame, src0_off) + \
+            (uint64_t)idx * LR_IMM64(); \
+        LR_CONTINUE(); \
+    }
+
+GEP_INDEX(32)
+GEP_INDEX(64)
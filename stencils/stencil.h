@@ -0,0 +1,51 @@
+#ifndef LIRIC_STENCIL_H
+#define LIRIC_STENCIL_H
+
+/*
+ * Shared conventions for copy-and-patch stencils.
+ *
+ * Every stencil is a function `stencil_<name>(uint8_t *frame)` compiled by
+ * stencil_gen into its own section.  `frame` is the RBP of the function being
+ * compiled; vreg slots are addressed as frame + <offset hole>.  Holes are
+ * undefined symbols whose relocations stencil_gen turns into patch sites:
+ *
+ *   __hole_src0_off / __hole_src1_off / __hole_dst_off   slot offsets (32S)
+ *   __hole_imm64                                         64-bit immediate
+ *   __hole_func_addr                                     64-bit callee address
+ *   __hole_branch_rel                                    rel32 branch target
+ *   __hole_continue                                      fall-through, resolved
+ *                                                        by stencil_gen itself
+ *
+ * Stencils end in a tail call to __hole_continue instead of returning, so the
+ * compiler never places a `ret` inside the copied bytes.  They are built with
+ * -mcmodel=kernel: slot offsets are negative, and only that model keeps the
+ * compiler from materializing a hole address with a zero-extending mov.
+ */
+
+#include <stdint.h>
+
+extern char __hole_src0_off;
+extern char __hole_src1_off;
+extern char __hole_dst_off;
+extern void __hole_continue(void);
+extern void __hole_branch_rel(void);
+
+#define LR_SLOT(frame, hole) ((frame) + (intptr_t)&__hole_##hole)
+#define LR_SLOT_AS(T, frame, hole) (*(T *)LR_SLOT(frame, hole))
+
+/* movabs keeps the full 64-bit value; a plain &sym would be truncated to a
+   32-bit relocation under the small code model. */
+#define LR_HOLE_U64(sym) ({ \
+    uint64_t lr_hole_v_; \
+    __asm__("movabs $" #sym ", %0" : "=r"(lr_hole_v_)); \
+    lr_hole_v_; \
+})
+#define LR_IMM64() LR_HOLE_U64(__hole_imm64)
+#define LR_FUNC_ADDR() LR_HOLE_U64(__hole_func_addr)
+
+#define LR_CONTINUE() __hole_continue()
+
+#define LR_STENCIL(name) \
+    __attribute__((used)) void stencil_##name(uint8_t *frame)
+
+#endif
@@ -0,0 +1,28 @@
+if(NOT DEFINED CLI OR NOT DEFINED INPUT)
+    message(FATAL_ERROR "CLI and INPUT are required")
+endif()
+
+# The loop reads a global it never stores: -O2 hoists the load out of
+# the loop in --jit mode, -O0 leaves it in place.  Both print the sum.
+foreach(level 0 2)
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -E env LIRIC_VERBOSE_LOOP_OPT=1
+                "${CLI}" --jit -O${level} "${INPUT}"
+        RESULT_VARIABLE rc
+        OUTPUT_VARIABLE out
+        ERROR_VARIABLE err
+    )
+    if(NOT rc EQUAL 0)
+        message(FATAL_ERROR "--jit -O${level} failed rc=${rc}\nstdout:\n${out}\nstderr:\n${err}")
+    endif()
+    string(STRIP "${out}" out)
+    if(NOT out STREQUAL "205")
+        message(FATAL_ERROR "--jit -O${level} printed '${out}', expected 205")
+    endif()
+    if(level EQUAL 0 AND err MATCHES "loop-opt:")
+        message(FATAL_ERROR "--jit -O0 ran loop optimization:\n${err}")
+    endif()
+    if(level EQUAL 2 AND NOT err MATCHES "loop-opt: fn=main hoisted=1")
+        message(FATAL_ERROR "--jit -O2 did not hoist the load:\n${err}")
+    endif()
+endforeach()
@@ -0,0 +1,18 @@
+@scale = global i32 7
+
+define i32 @main() {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i1, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s1, %loop ]
+  %k = load i32, ptr @scale
+  %m = mul i32 %i, 3
+  %t = add i32 %m, %k
+  %s1 = add i32 %s, %t
+  %i1 = add i32 %i, 1
+  %c = icmp slt i32 %i1, 10
+  br i1 %c, label %loop, label %done
+done:
+  ret i32 %s1
+}
@@ -3,8 +3,10 @@
 #include "../src/jit.h"
 #include "../src/ll_parser.h"
 #include "../src/objfile.h"
+#include "../src/platform/platform_cpu.h"
 #include "../src/target.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #define TEST_ASSERT(cond, msg) do { \
@@ -484,3 +486,869 @@ int test_codegen_select_zero_keeps_mov_for_flags(void) {
     lr_arena_destroy(arena);
     return 0;
 }
+
+static int has_0f_op(const uint8_t *code, size_t code_len, uint8_t lo,
+                     uint8_t hi) {
+    for (size_t i = 0; i + 1 < code_len; i++) {
+        if (code[i] == 0x0F && code[i + 1] >= lo && code[i + 1] <= hi)
+            return 1;
+    }
+    return 0;
+}
+
+/* jcc with condition nibble cc, in rel8 (7x) or rel32 (0F 8x) form. */
+static int has_jcc(const uint8_t *code, size_t code_len, uint8_t cc) {
+    for (size_t i = 0; i + 1 < code_len; i++) {
+        if (code[i] == (uint8_t)(0x70 | cc))
+            return 1;
+        if (code[i] == 0x0F && code[i + 1] == (uint8_t)(0x80 | cc))
+            return 1;
+    }
+    return 0;
+}
+
+int test_codegen_fuses_icmp_into_branch_and_select(void) {
+    const char *src =
+        "define i64 @br(i64 %x, i64 %y) {\n"
+        "entry:\n"
+        "  %c = icmp slt i64 %x, %y\n"
+        "  br i1 %c, label %a, label %b\n"
+        "a:\n"
+        "  ret i64 1\n"
+        "b:\n"
+        "  ret i64 2\n"
+        "}\n"
+        "define i64 @sel(i64 %x, i64 %y) {\n"
+        "entry:\n"
+        "  %c = icmp slt i64 %x, %y\n"
+        "  %r = select i1 %c, i64 %x, i64 %y\n"
+        "  ret i64 %r\n"
+        "}\n"
+        "define i32 @multi(i32 %x, i32 %y) {\n"
+        "entry:\n"
+        "  %c = icmp ugt i32 %x, %y\n"
+        "  br i1 %c, label %a, label %b\n"
+        "a:\n"
+        "  %z = zext i1 %c to i32\n"
+        "  ret i32 %z\n"
+        "b:\n"
+        "  ret i32 7\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    char err[256] = {0};
+
+    lr_module_t *m = lr_parse_ll_text(src, strlen(src), arena, err, sizeof(err));
+    TEST_ASSERT(m != NULL, err);
+
+    const lr_target_t *target = lr_target_host();
+    TEST_ASSERT(target != NULL, "host target exists");
+    if (strcmp(target->name, "x86_64") != 0) {
+        lr_arena_destroy(arena);
+        return 0;
+    }
+
+    lr_func_t *f_br = m->first_func;
+    lr_func_t *f_sel = f_br->next;
+    lr_func_t *f_multi = f_sel->next;
+    uint8_t code[4096];
+    size_t code_len = 0;
+    int rc = lr_target_compile(target, LR_COMPILE_ISEL, f_br, m, code,
+                               sizeof(code), &code_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "branch compile succeeds");
+    /* "jl a; jmp b; a:" is relaxed into "jge b". */
+    TEST_ASSERT(has_jcc(code, code_len, 0xD), "cmp feeds jge");
+    TEST_ASSERT(!has_0f_op(code, code_len, 0x90, 0x9F),
+                "single-use compare is not materialized");
+
+    rc = lr_target_compile(target, LR_COMPILE_ISEL, f_sel, m, code,
+                           sizeof(code), &code_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "select compile succeeds");
+    TEST_ASSERT(has_0f_op(code, code_len, 0x4C, 0x4C), "cmp feeds cmovl");
+    TEST_ASSERT(!has_0f_op(code, code_len, 0x90, 0x9F),
+                "select compare is not materialized");
+
+    rc = lr_target_compile(target, LR_COMPILE_ISEL, f_multi, m, code,
+                           sizeof(code), &code_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "multi-use compile succeeds");
+    TEST_ASSERT(has_0f_op(code, code_len, 0x97, 0x97),
+                "compare with other uses is still materialized");
+    TEST_ASSERT(has_jcc(code, code_len, 0x6),
+                "branch still reads the compare flags");
+
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+/* opcode with a SIB memory operand of the given scale (ss field). */
+static int has_sib_op(const uint8_t *code, size_t code_len, uint8_t op,
+                      uint8_t ss) {
+    for (size_t i = 0; i + 2 < code_len; i++) {
+        if (code[i] == op && (code[i + 1] & 0x07) == 0x04 &&
+            (code[i + 1] & 0xC0) != 0xC0 && (code[i + 2] >> 6) == ss)
+            return 1;
+    }
+    return 0;
+}
+
+int test_codegen_folds_gep_into_load_store(void) {
+    const char *src =
+        "define i32 @ld(ptr %p, i64 %i) {\n"
+        "entry:\n"
+        "  %q = getelementptr i32, ptr %p, i64 %i\n"
+        "  %v = load i32, ptr %q\n"
+        "  ret i32 %v\n"
+        "}\n"
+        "define void @st(ptr %p, i32 %i, i64 %v) {\n"
+        "entry:\n"
+        "  %q = getelementptr i64, ptr %p, i32 %i\n"
+        "  store i64 %v, ptr %q\n"
+        "  ret void\n"
+        "}\n"
+        "define i32 @multi(ptr %p, i64 %i) {\n"
+        "entry:\n"
+        "  %q = getelementptr i32, ptr %p, i64 %i\n"
+        "  %v = load i32, ptr %q\n"
+        "  store i32 0, ptr %q\n"
+        "  ret i32 %v\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    char err[256] = {0};
+
+    lr_module_t *m = lr_parse_ll_text(src, strlen(src), arena, err, sizeof(err));
+    TEST_ASSERT(m != NULL, err);
+
+    const lr_target_t *target = lr_target_host();
+    TEST_ASSERT(target != NULL, "host target exists");
+    if (strcmp(target->name, "x86_64") != 0) {
+        lr_arena_destroy(arena);
+        return 0;
+    }
+
+    lr_func_t *f_ld = m->first_func;
+    lr_func_t *f_st = f_ld->next;
+    lr_func_t *f_multi = f_st->next;
+    uint8_t code[4096];
+    size_t code_len = 0;
+    int rc = lr_target_compile(target, LR_COMPILE_ISEL, f_ld, m, code,
+                               sizeof(code), &code_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "load compile succeeds");
+    TEST_ASSERT(has_sib_op(code, code_len, 0x8B, 2),
+                "load addresses [base + index*4]");
+    TEST_ASSERT(!has_sib_op(code, code_len, 0x8D, 2),
+                "single-use address is not materialized");
+
+    rc = lr_target_compile(target, LR_COMPILE_ISEL, f_st, m, code,
+                           sizeof(code), &code_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "store compile succeeds");
+    TEST_ASSERT(has_sib_op(code, code_len, 0x89, 3),
+                "store addresses [base + index*8]");
+    TEST_ASSERT(!has_sib_op(code, code_len, 0x8D, 3),
+                "single-use address is not materialized");
+
+    rc = lr_target_compile(target, LR_COMPILE_ISEL, f_multi, m, code,
+                           sizeof(code), &code_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "multi-use compile succeeds");
+    TEST_ASSERT(has_sib_op(code, code_len, 0x8D, 2),
+                "address with two uses is still computed by lea");
+
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+static size_t find_bytes(const uint8_t *code, size_t code_len,
+                         const uint8_t *pat, size_t pat_len) {
+    for (size_t i = 0; i + pat_len <= code_len; i++) {
+        if (memcmp(code + i, pat, pat_len) == 0)
+            return i;
+    }
+    return SIZE_MAX;
+}
+
+int test_codegen_relaxes_x86_branches(void) {
+    static const uint8_t cmp_rax_rcx[] = {0x48, 0x39, 0xC8};
+    static const uint8_t mov_rax_2[] = {0x48, 0xC7, 0xC0, 0x02, 0, 0, 0};
+    char src[4096];
+    int n = snprintf(src, sizeof(src), "%s",
+        "define i64 @ft(i64 %x) {\n"
+        "entry:\n"
+        "  br label %next\n"
+        "next:\n"
+        "  ret i64 %x\n"
+        "}\n"
+        "define i64 @flat(i64 %x) {\n"
+        "entry:\n"
+        "  ret i64 %x\n"
+        "}\n"
+        "define i64 @count(i64 %n, ptr %p) {\n"
+        "entry:\n"
+        "  store i64 0, ptr %p\n"
+        "  br label %l\n"
+        "l:\n"
+        "  %i = load i64, ptr %p\n"
+        "  %j = add i64 %i, 1\n"
+        "  store i64 %j, ptr %p\n"
+        "  %c = icmp slt i64 %j, %n\n"
+        "  br i1 %c, label %l, label %e\n"
+        "e:\n"
+        "  ret i64 %j\n"
+        "}\n"
+        "define i64 @far(i64 %x, i64 %y) {\n"
+        "entry:\n"
+        "  %c = icmp slt i64 %x, %y\n"
+        "  br i1 %c, label %a, label %b\n"
+        "a:\n"
+        "  %v0 = add i64 %x, 1\n");
+    /* Enough code in %a that the branch over it needs rel32. */
+    for (int i = 1; i < 16; i++)
+        n += snprintf(src + n, sizeof(src) - (size_t)n,
+                      "  %%v%d = add i64 %%v%d, %d\n", i, i - 1, i + 1);
+    snprintf(src + n, sizeof(src) - (size_t)n, "%s",
+             "  ret i64 %v15\n"
+             "b:\n"
+             "  ret i64 2\n"
+             "}\n");
+    lr_arena_t *arena = lr_arena_create(0);
+    char err[256] = {0};
+
+    lr_module_t *m = lr_parse_ll_text(src, strlen(src), arena, err, sizeof(err));
+    TEST_ASSERT(m != NULL, err);
+
+    const lr_target_t *target = lr_target_host();
+    TEST_ASSERT(target != NULL, "host target exists");
+    if (strcmp(target->name, "x86_64") != 0) {
+        lr_arena_destroy(arena);
+        return 0;
+    }
+
+    lr_func_t *f_ft = m->first_func;
+    lr_func_t *f_flat = f_ft->next;
+    lr_func_t *f_count = f_flat->next;
+    lr_func_t *f_far = f_count->next;
+    uint8_t code[4096], flat[4096];
+    size_t code_len = 0, flat_len = 0, at;
+    int rc = lr_target_compile(target, LR_COMPILE_ISEL, f_ft, m, code,
+                               sizeof(code), &code_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "fall-through compile succeeds");
+    rc = lr_target_compile(target, LR_COMPILE_ISEL, f_flat, m, flat,
+                           sizeof(flat), &flat_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "flat compile succeeds");
+    TEST_ASSERT(code_len == flat_len && memcmp(code, flat, code_len) == 0,
+                "jump to the next block is dropped");
+
+    rc = lr_target_compile(target, LR_COMPILE_ISEL, f_count, m, code,
+                           sizeof(code), &code_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "loop compile succeeds");
+    at = find_bytes(code, code_len, cmp_rax_rcx, sizeof(cmp_rax_rcx));
+    TEST_ASSERT(at != SIZE_MAX && at + 5 <= code_len, "loop compare found");
+    TEST_ASSERT_EQ(code[at + 3], 0x7C, "back edge is jl rel8");
+    TEST_ASSERT((int8_t)code[at + 4] < 0, "back edge jumps backwards");
+    TEST_ASSERT(code[at + 5] != 0xE9 && code[at + 5] != 0xEB,
+                "exit falls through without a jmp");
+
+    rc = lr_target_compile(target, LR_COMPILE_ISEL, f_far, m, code,
+                           sizeof(code), &code_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "far compile succeeds");
+    at = find_bytes(code, code_len, cmp_rax_rcx, sizeof(cmp_rax_rcx));
+    TEST_ASSERT(at != SIZE_MAX && at + 9 <= code_len, "far compare found");
+    TEST_ASSERT(code[at + 3] == 0x0F && code[at + 4] == 0x8D,
+                "inverted branch over the long block is jge rel32");
+    {
+        int32_t rel;
+        size_t dest;
+        memcpy(&rel, code + at + 5, sizeof(rel));
+        dest = at + 9 + (size_t)(int64_t)rel;
+        TEST_ASSERT(rel > 127, "long block is out of rel8 reach");
+        TEST_ASSERT(dest + sizeof(mov_rax_2) <= code_len &&
+                        memcmp(code + dest, mov_rax_2, sizeof(mov_rax_2)) == 0,
+                    "jge lands on the ret 2 block");
+    }
+
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_codegen_elides_leaf_frames(void) {
+    static const uint8_t sub_rsp[] = {0x48, 0x81, 0xEC};
+    static const uint8_t mov_rsp_rbp[] = {0x48, 0x89, 0xEC};
+    const char *src =
+        "define i64 @k() {\n"
+        "entry:\n"
+        "  ret i64 7\n"
+        "}\n"
+        "define i64 @leaf(i64 %a, i64 %b) {\n"
+        "entry:\n"
+        "  %s = add i64 %a, %b\n"
+        "  ret i64 %s\n"
+        "}\n"
+        "define i64 @caller(i64 %a) {\n"
+        "entry:\n"
+        "  %r = call i64 @k()\n"
+        "  %s = add i64 %r, %a\n"
+        "  ret i64 %s\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    char err[256] = {0};
+
+    lr_module_t *m = lr_parse_ll_text(src, strlen(src), arena, err, sizeof(err));
+    TEST_ASSERT(m != NULL, err);
+
+    const lr_target_t *target = lr_target_host();
+    TEST_ASSERT(target != NULL, "host target exists");
+    if (strcmp(target->name, "x86_64") != 0) {
+        lr_arena_destroy(arena);
+        return 0;
+    }
+
+    lr_func_t *f_k = m->first_func;
+    lr_func_t *f_leaf = f_k->next;
+    lr_func_t *f_caller = f_leaf->next;
+    uint8_t code[4096];
+    size_t code_len = 0;
+    int rc = lr_target_compile(target, LR_COMPILE_ISEL, f_k, m, code,
+                               sizeof(code), &code_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "constant compile succeeds");
+    TEST_ASSERT(code_len > 0 && code[0] != 0x55, "no slots: rbp is not pushed");
+    TEST_ASSERT_EQ(code[code_len - 1], 0xC3, "frameless body ends in ret");
+
+    rc = lr_target_compile(target, LR_COMPILE_ISEL, f_leaf, m, code,
+                           sizeof(code), &code_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "leaf compile succeeds");
+    TEST_ASSERT_EQ(code[0], 0x55, "leaf with slots keeps rbp");
+    TEST_ASSERT(find_bytes(code, code_len, sub_rsp, sizeof(sub_rsp)) ==
+                    SIZE_MAX,
+                "leaf slots live in the red zone");
+    TEST_ASSERT(find_bytes(code, code_len, mov_rsp_rbp,
+                           sizeof(mov_rsp_rbp)) == SIZE_MAX,
+                "leaf epilogue does not restore rsp");
+
+    rc = lr_target_compile(target, LR_COMPILE_ISEL, f_caller, m, code,
+                           sizeof(code), &code_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "caller compile succeeds");
+    TEST_ASSERT(find_bytes(code, code_len, sub_rsp, sizeof(sub_rsp)) !=
+                    SIZE_MAX,
+                "function with a call allocates its frame");
+    TEST_ASSERT(find_bytes(code, code_len, mov_rsp_rbp,
+                           sizeof(mov_rsp_rbp)) != SIZE_MAX,
+                "function with a call restores rsp");
+
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+/* One checker per (op, width, divisor): sweeps count dividends from start
+   by step and counts where "op n, <const>" differs from the hardware
+   divide "op n, %d" with the same divisor passed at run time. */
+static int append_div_const_checker(char *buf, size_t cap, size_t *len,
+                                    const char *op, unsigned bits,
+                                    int64_t d, unsigned id) {
+    char conv[128];
+    int n;
+    if (bits == 64)
+        snprintf(conv, sizeof(conv), "  %%s0 = add i64 %%start, 0\n"
+                                     "  %%t0 = add i64 %%step, 0\n"
+                                     "  %%d0 = add i64 %%d, 0\n");
+    else
+        snprintf(conv, sizeof(conv), "  %%s0 = trunc i64 %%start to i%u\n"
+                                     "  %%t0 = trunc i64 %%step to i%u\n"
+                                     "  %%d0 = trunc i64 %%d to i%u\n",
+                 bits, bits, bits);
+    n = snprintf(buf + *len, cap - *len,
+        "define i32 @chk%u(i64 %%start, i64 %%step, i64 %%count, i64 %%d) {\n"
+        "entry:\n"
+        "%s"
+        "  br label %%loop\n"
+        "loop:\n"
+        "  %%i = phi i64 [0, %%entry], [%%i1, %%loop]\n"
+        "  %%n = phi i%u [%%s0, %%entry], [%%n1, %%loop]\n"
+        "  %%bad = phi i32 [0, %%entry], [%%bad1, %%loop]\n"
+        "  %%q = %s i%u %%n, %lld\n"
+        "  %%w = %s i%u %%n, %%d0\n"
+        "  %%ne = icmp ne i%u %%q, %%w\n"
+        "  %%z = zext i1 %%ne to i32\n"
+        "  %%bad1 = add i32 %%bad, %%z\n"
+        "  %%n1 = add i%u %%n, %%t0\n"
+        "  %%i1 = add i64 %%i, 1\n"
+        "  %%c = icmp ult i64 %%i1, %%count\n"
+        "  br i1 %%c, label %%loop, label %%done\n"
+        "done:\n"
+        "  ret i32 %%bad1\n"
+        "}\n",
+        id, conv, bits, op, bits, (long long)d, op, bits, bits, bits);
+    if (n < 0 || (size_t)n >= cap - *len)
+        return -1;
+    *len += (size_t)n;
+    return 0;
+}
+
+int test_codegen_div_by_constant(void) {
+    static const char *const ops[] = {"sdiv", "srem", "udiv", "urem"};
+    static const unsigned widths[] = {8, 16, 32, 64};
+    static const int64_t divisors[] = {
+        1, 2, 3, 5, 6, 7, 10, 12, 25, 60, 100, 125, 127, 641, 1000, 4096,
+        65535, 65537, 1000000007, (1LL << 30) + 1, INT32_MAX,
+        -1, -2, -3, -7, -10, -128, -1000, -65536,
+        INT64_MAX / 3, INT64_MAX, INT64_MIN + 1, INT64_MIN,
+    };
+    typedef struct {
+        unsigned bits;
+        int64_t d;
+        const char *op;
+    } checker_t;
+    typedef int32_t (*chk_fn_t)(int64_t, int64_t, int64_t, int64_t);
+    const size_t cap = 1u << 20;
+    char *src = malloc(cap);
+    checker_t *chk = malloc(sizeof(*chk) * 4 * 4 *
+                            (sizeof(divisors) / sizeof(divisors[0])));
+    size_t len = 0;
+    unsigned nchk = 0;
+    TEST_ASSERT(src != NULL && chk != NULL, "buffers");
+
+    for (unsigned w = 0; w < 4; w++) {
+        unsigned bits = widths[w];
+        for (unsigned k = 0; k < sizeof(divisors) / sizeof(divisors[0]); k++) {
+            int64_t d = divisors[k];
+            if (bits < 64) {
+                uint64_t mask = ((uint64_t)1 << bits) - 1u;
+                uint64_t v = (uint64_t)d & mask;
+                if ((v >> (bits - 1)) & 1u)
+                    v |= ~mask;
+                d = (int64_t)v;
+            }
+            if (d == 0)
+                continue;
+            for (unsigned o = 0; o < 4; o++) {
+                /* INT64_MIN / -1 traps in the reference sdiv. */
+                if (bits == 64 && d == -1 && o < 2)
+                    continue;
+                TEST_ASSERT(append_div_const_checker(src, cap, &len, ops[o],
+                                                     bits, d, nchk) == 0,
+                            "checker source fits");
+                chk[nchk].bits = bits;
+                chk[nchk].d = d;
+                chk[nchk].op = ops[o];
+                nchk++;
+            }
+        }
+    }
+
+    lr_arena_t *arena = lr_arena_create(0);
+    char err[256] = {0};
+    lr_module_t *m = lr_parse_ll_text(src, len, arena, err, sizeof(err));
+    TEST_ASSERT(m != NULL, err);
+    lr_jit_t *jit = lr_jit_create();
+    TEST_ASSERT(jit != NULL, "jit create");
+    TEST_ASSERT_EQ(lr_jit_add_module(jit, m), 0, "jit add module");
+
+    for (unsigned i = 0; i < nchk; i++) {
+        char name[32];
+        chk_fn_t fn;
+        int32_t bad = 0;
+        snprintf(name, sizeof(name), "chk%u", i);
+        LR_JIT_GET_FN(fn, jit, name);
+        TEST_ASSERT(fn != NULL, "checker lookup");
+        if (chk[i].bits <= 16) {
+            /* Every dividend. */
+            bad += fn(0, 1, 1LL << chk[i].bits, chk[i].d);
+        } else if (chk[i].bits == 32) {
+            bad += fn(0, 0x9E3779B1LL, 1LL << 16, chk[i].d);
+            bad += fn(INT32_MIN, 1, 512, chk[i].d);
+            bad += fn(-256, 1, 512, chk[i].d);
+            bad += fn(INT32_MAX - 255, 1, 256, chk[i].d);
+        } else {
+            bad += fn(0, (int64_t)0x9E3779B97F4A7C15ULL, 1LL << 15, chk[i].d);
+            bad += fn(INT64_MIN, 1, 512, chk[i].d);
+            bad += fn(-256, 1, 512, chk[i].d);
+            bad += fn(INT64_MAX - 255, 1, 256, chk[i].d);
+            bad += fn(0xFFFFFF00LL, 1, 512, chk[i].d);
+        }
+        if (bad != 0) {
+            fprintf(stderr, "  %s i%u by %lld: %d mismatches\n", chk[i].op,
+                    chk[i].bits, (long long)chk[i].d, (int)bad);
+            TEST_ASSERT(0, "division by constant matches the hardware divide");
+        }
+    }
+    lr_jit_destroy(jit);
+
+    {
+        const lr_target_t *target = lr_target_host();
+        static const uint8_t div_rcx[] = {0x48, 0xF7, 0xF1};
+        static const uint8_t idiv_rcx[] = {0x48, 0xF7, 0xF9};
+        const char *one =
+            "define i32 @f(i32 %x) {\n"
+            "entry:\n"
+            "  %a = udiv i32 %x, 10\n"
+            "  %b = srem i32 %x, 7\n"
+            "  %c = add i32 %a, %b\n"
+            "  ret i32 %c\n"
+            "}\n";
+        uint8_t code[4096];
+        size_t code_len = 0;
+        lr_module_t *m1;
+        TEST_ASSERT(target != NULL, "host target exists");
+        if (strcmp(target->name, "x86_64") == 0) {
+            m1 = lr_parse_ll_text(one, strlen(one), arena, err, sizeof(err));
+            TEST_ASSERT(m1 != NULL, err);
+            TEST_ASSERT_EQ(lr_target_compile(target, LR_COMPILE_ISEL,
+                                             m1->first_func, m1, code,
+                                             sizeof(code), &code_len, arena),
+                           0, "compile succeeds");
+            TEST_ASSERT(find_bytes(code, code_len, div_rcx,
+                                   sizeof(div_rcx)) == SIZE_MAX &&
+                            find_bytes(code, code_len, idiv_rcx,
+                                       sizeof(idiv_rcx)) == SIZE_MAX,
+                        "constant divisors do not use div/idiv");
+        }
+    }
+
+    lr_arena_destroy(arena);
+    free(chk);
+    free(src);
+    return 0;
+}
+
+static bool has_a64_insn(const uint8_t *code, size_t code_len,
+                          uint32_t insn) {
+    for (size_t i = 0; i + 4 <= code_len; i += 4) {
+        uint32_t w = (uint32_t)code[i] | (uint32_t)code[i + 1] << 8 |
+                     (uint32_t)code[i + 2] << 16 | (uint32_t)code[i + 3] << 24;
+        if (w == insn)
+            return true;
+    }
+    return false;
+}
+
+int test_codegen_elides_aarch64_leaf_frames(void) {
+    const uint32_t stp_fp_lr = 0xA9BF7BFDu;
+    const uint32_t ldp_fp_lr = 0xA8C17BFDu;
+    const uint32_t nop = 0xD503201Fu;
+    const char *src =
+        "define i64 @k() {\n"
+        "entry:\n"
+        "  ret i64 7\n"
+        "}\n"
+        "define i64 @pick() {\n"
+        "entry:\n"
+        "  br label %a\n"
+        "a:\n"
+        "  br label %b\n"
+        "b:\n"
+        "  ret i64 3\n"
+        "}\n"
+        "define i64 @caller() {\n"
+        "entry:\n"
+        "  %r = call i64 @k()\n"
+        "  ret i64 %r\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    char err[256] = {0};
+
+    lr_module_t *m = lr_parse_ll_text(src, strlen(src), arena, err, sizeof(err));
+    TEST_ASSERT(m != NULL, err);
+
+    const lr_target_t *target = lr_target_by_name("aarch64");
+    TEST_ASSERT(target != NULL, "aarch64 target exists");
+
+    lr_func_t *f_k = m->first_func;
+    lr_func_t *f_pick = f_k->next;
+    lr_func_t *f_caller = f_pick->next;
+    uint8_t code[4096];
+    size_t code_len = 0;
+    int rc = lr_target_compile(target, LR_COMPILE_ISEL, f_k, m, code,
+                               sizeof(code), &code_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "constant compile succeeds");
+    TEST_ASSERT_EQ(code_len, 12, "mov, mov, ret");
+    TEST_ASSERT(!has_a64_insn(code, code_len, stp_fp_lr),
+                "leaf does not save fp/lr");
+    TEST_ASSERT(!has_a64_insn(code, code_len, ldp_fp_lr),
+                "leaf does not restore fp/lr");
+    TEST_ASSERT(!has_a64_insn(code, code_len, nop), "no prologue padding");
+
+    rc = lr_target_compile(target, LR_COMPILE_ISEL, f_pick, m, code,
+                           sizeof(code), &code_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "branching leaf compile succeeds");
+    TEST_ASSERT(!has_a64_insn(code, code_len, stp_fp_lr),
+                "branching leaf does not save fp/lr");
+    TEST_ASSERT(!has_a64_insn(code, code_len, ldp_fp_lr),
+                "branching leaf does not restore fp/lr");
+    TEST_ASSERT(!has_a64_insn(code, code_len, nop),
+                "branching leaf has no padding");
+    TEST_ASSERT(has_a64_insn(code, code_len, 0x14000001u),
+                "branches still reach the next block");
+
+    rc = lr_target_compile(target, LR_COMPILE_ISEL, f_caller, m, code,
+                           sizeof(code), &code_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "caller compile succeeds");
+    TEST_ASSERT(has_a64_insn(code, code_len, stp_fp_lr),
+                "function with a call saves fp/lr");
+    TEST_ASSERT(has_a64_insn(code, code_len, ldp_fp_lr),
+                "function with a call restores fp/lr");
+
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+static int count_loads_from_rbp(const uint8_t *code, size_t code_len) {
+    int count = 0;
+    for (size_t i = 0; i + 2 < code_len; i++) {
+        if ((code[i + 0] == 0x48 || code[i + 0] == 0x4C) &&
+            code[i + 1] == 0x8B &&
+            ((code[i + 2] & 0xC7) == 0x45 || (code[i + 2] & 0xC7) == 0x85)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static int has_rbx_save_to_rbp(const uint8_t *code, size_t code_len) {
+    for (size_t i = 0; i + 2 < code_len; i++) {
+        if (code[i + 0] == 0x48 && code[i + 1] == 0x89 &&
+            (code[i + 2] == 0x5D || code[i + 2] == 0x9D))
+            return 1;
+    }
+    return 0;
+}
+
+int test_codegen_regalloc_homes_loop_values(void) {
+    const char *src =
+        "define i64 @f(i64 %n) {\n"
+        "entry:\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %i = phi i64 [ 0, %entry ], [ %i1, %loop ]\n"
+        "  %s = phi i64 [ 0, %entry ], [ %s1, %loop ]\n"
+        "  %s1 = add i64 %s, %i\n"
+        "  %i1 = add i64 %i, 1\n"
+        "  %c = icmp slt i64 %i1, %n\n"
+        "  br i1 %c, label %loop, label %done\n"
+        "done:\n"
+        "  ret i64 %s1\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    char err[256] = {0};
+
+    lr_module_t *m = lr_parse_ll_text(src, strlen(src), arena, err, sizeof(err));
+    TEST_ASSERT(m != NULL, err);
+
+    const lr_target_t *target = lr_target_host();
+    TEST_ASSERT(target != NULL, "host target exists");
+    if (strcmp(target->name, "x86_64") != 0) {
+        lr_arena_destroy(arena);
+        return 0;
+    }
+
+    uint8_t plain[4096];
+    uint8_t alloc[4096];
+    size_t plain_len = 0;
+    size_t alloc_len = 0;
+    int rc = lr_target_compile_ex(target, LR_COMPILE_ISEL, 0, 0, NULL,
+                                  m->first_func, m, plain, sizeof(plain),
+                                  &plain_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "stack-slot compile succeeds");
+    rc = lr_target_compile_ex(target, LR_COMPILE_ISEL, LR_CODEGEN_REGALLOC, 0,
+                              NULL, m->first_func, m, alloc, sizeof(alloc),
+                              &alloc_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "register-allocated compile succeeds");
+    TEST_ASSERT(!has_rbx_save_to_rbp(plain, plain_len),
+                "stack-slot code leaves callee-saved registers alone");
+    TEST_ASSERT(has_rbx_save_to_rbp(alloc, alloc_len),
+                "allocator saves the callee-saved register it uses");
+    TEST_ASSERT(count_loads_from_rbp(alloc, alloc_len) <
+                count_loads_from_rbp(plain, plain_len),
+                "loop values are read from registers, not stack slots");
+
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_codegen_regalloc_leaf_uses_caller_saved(void) {
+    /* No parameters and no calls: every home can be a caller-saved
+       argument register, so nothing needs saving. */
+    const char *src =
+        "define i64 @f() {\n"
+        "entry:\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %i = phi i64 [ 0, %entry ], [ %i1, %loop ]\n"
+        "  %s = phi i64 [ 0, %entry ], [ %s1, %loop ]\n"
+        "  %s1 = add i64 %s, %i\n"
+        "  %i1 = add i64 %i, 1\n"
+        "  %c = icmp slt i64 %i1, 100\n"
+        "  br i1 %c, label %loop, label %done\n"
+        "done:\n"
+        "  ret i64 %s1\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    char err[256] = {0};
+
+    lr_module_t *m = lr_parse_ll_text(src, strlen(src), arena, err, sizeof(err));
+    TEST_ASSERT(m != NULL, err);
+
+    const lr_target_t *target = lr_target_host();
+    TEST_ASSERT(target != NULL, "host target exists");
+    if (strcmp(target->name, "x86_64") != 0) {
+        lr_arena_destroy(arena);
+        return 0;
+    }
+
+    uint8_t plain[4096];
+    uint8_t alloc[4096];
+    size_t plain_len = 0;
+    size_t alloc_len = 0;
+    int rc = lr_target_compile_ex(target, LR_COMPILE_ISEL, 0, 0, NULL,
+                                  m->first_func, m, plain, sizeof(plain),
+                                  &plain_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "stack-slot compile succeeds");
+    rc = lr_target_compile_ex(target, LR_COMPILE_ISEL, LR_CODEGEN_REGALLOC, 0,
+                              NULL, m->first_func, m, alloc, sizeof(alloc),
+                              &alloc_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "register-allocated compile succeeds");
+    TEST_ASSERT(!has_rbx_save_to_rbp(alloc, alloc_len),
+                "leaf values take caller-saved registers first");
+    TEST_ASSERT(count_loads_from_rbp(alloc, alloc_len) <
+                count_loads_from_rbp(plain, plain_len),
+                "loop values are read from registers, not stack slots");
+
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+/* movsd/movss xmm, [rbp + disp] */
+static int count_fp_loads_from_rbp(const uint8_t *code, size_t code_len) {
+    int count = 0;
+    for (size_t i = 0; i + 3 < code_len; i++) {
+        size_t j = i + 1;
+        if (code[i] != 0xF2 && code[i] != 0xF3)
+            continue;
+        if (code[j] == 0x44)
+            j++;
+        if (j + 2 < code_len && code[j] == 0x0F && code[j + 1] == 0x10 &&
+            ((code[j + 2] & 0xC7) == 0x45 || (code[j + 2] & 0xC7) == 0x85))
+            count++;
+    }
+    return count;
+}
+
+/* movapd xmm8-15, xmm8-15 */
+static int count_high_xmm_moves(const uint8_t *code, size_t code_len) {
+    int count = 0;
+    for (size_t i = 0; i + 4 < code_len; i++) {
+        if (code[i] == 0x66 && code[i + 1] == 0x45 && code[i + 2] == 0x0F &&
+            code[i + 3] == 0x28 && (code[i + 4] & 0xC0) == 0xC0)
+            count++;
+    }
+    return count;
+}
+
+int test_codegen_regalloc_homes_fp_values(void) {
+    /* a and b swap every trip; with XMM homes the phi copies are
+       register moves and nothing FP goes through a stack slot. */
+    const char *src =
+        "define double @f(i64 %n) {\n"
+        "entry:\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %i = phi i64 [ 0, %entry ], [ %i1, %loop ]\n"
+        "  %a = phi double [ 1.0, %entry ], [ %b, %loop ]\n"
+        "  %b = phi double [ 2.0, %entry ], [ %c, %loop ]\n"
+        "  %c = fadd double %a, %b\n"
+        "  %i1 = add i64 %i, 1\n"
+        "  %k = icmp slt i64 %i1, %n\n"
+        "  br i1 %k, label %loop, label %done\n"
+        "done:\n"
+        "  ret double %c\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    char err[256] = {0};
+
+    lr_module_t *m = lr_parse_ll_text(src, strlen(src), arena, err, sizeof(err));
+    TEST_ASSERT(m != NULL, err);
+
+    const lr_target_t *target = lr_target_host();
+    TEST_ASSERT(target != NULL, "host target exists");
+    if (strcmp(target->name, "x86_64") != 0) {
+        lr_arena_destroy(arena);
+        return 0;
+    }
+
+    uint8_t plain[4096];
+    uint8_t alloc[4096];
+    size_t plain_len = 0;
+    size_t alloc_len = 0;
+    int rc = lr_target_compile_ex(target, LR_COMPILE_ISEL, 0, 0, NULL,
+                                  m->first_func, m, plain, sizeof(plain),
+                                  &plain_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "stack-slot compile succeeds");
+    rc = lr_target_compile_ex(target, LR_COMPILE_ISEL, LR_CODEGEN_REGALLOC, 0,
+                              NULL, m->first_func, m, alloc, sizeof(alloc),
+                              &alloc_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "register-allocated compile succeeds");
+    TEST_ASSERT(count_fp_loads_from_rbp(plain, plain_len) > 0,
+                "stack-slot code reads FP values from slots");
+    TEST_ASSERT_EQ(count_fp_loads_from_rbp(alloc, alloc_len), 0,
+                   "FP values live in XMM registers");
+    TEST_ASSERT(count_high_xmm_moves(alloc, alloc_len) > 0,
+                "phi copies move XMM homes register to register");
+
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+static int count_vex_0f38_op(const uint8_t *code, size_t code_len,
+                             uint8_t op) {
+    int count = 0;
+    for (size_t i = 0; i + 3 < code_len; i++) {
+        if (code[i] == 0xC4 && (code[i + 1] & 0x1F) == 0x02 &&
+            code[i + 3] == op)
+            count++;
+    }
+    return count;
+}
+
+int test_codegen_x86_cpu_feature_tiers(void) {
+    const char *src =
+        "declare double @llvm.fma.f64(double, double, double)\n"
+        "define double @f(i64 %a, i64 %n, double %x, double %y) {\n"
+        "entry:\n"
+        "  %s = shl i64 %a, %n\n"
+        "  %t = ashr i64 %s, %n\n"
+        "  %d = sitofp i64 %t to double\n"
+        "  %r = call double @llvm.fma.f64(double %d, double %x, double %y)\n"
+        "  ret double %r\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    char err[256] = {0};
+    lr_module_t *m = lr_parse_ll_text(src, strlen(src), arena, err, sizeof(err));
+    TEST_ASSERT(m != NULL, err);
+
+    const lr_target_t *target = lr_target_by_name("x86_64");
+    TEST_ASSERT(target != NULL, "x86_64 target exists");
+    lr_func_t *f = m->first_func;
+    while (f && f->is_decl)
+        f = f->next;
+    TEST_ASSERT(f != NULL, "parsed function exists");
+
+    uint8_t base[4096];
+    uint8_t tiered[4096];
+    size_t base_len = 0;
+    size_t tiered_len = 0;
+    int rc = lr_target_compile_ex(target, LR_COMPILE_ISEL, 0, 0, NULL,
+                                  f, m, base, sizeof(base),
+                                  &base_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "baseline compile succeeds");
+    rc = lr_target_compile_ex(target, LR_COMPILE_ISEL, 0,
+                              LR_CPU_X86_BMI2 | LR_CPU_X86_FMA, NULL,
+                              f, m, tiered, sizeof(tiered),
+                              &tiered_len, arena);
+    TEST_ASSERT_EQ(rc, 0, "bmi2+fma compile succeeds");
+    TEST_ASSERT_EQ(count_vex_0f38_op(base, base_len, 0xF7), 0,
+                   "baseline code has no shlx/sarx");
+    TEST_ASSERT_EQ(count_vex_0f38_op(base, base_len, 0xA9), 0,
+                   "baseline code has no vfmadd");
+    TEST_ASSERT_EQ(count_vex_0f38_op(tiered, tiered_len, 0xF7), 2,
+                   "bmi2 shifts use shlx/sarx");
+    TEST_ASSERT_EQ(count_vex_0f38_op(tiered, tiered_len, 0xA9), 1,
+                   "fma is one vfmadd213sd");
+
+    lr_arena_destroy(arena);
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include "jit.h"
 #include "ir.h"
 #include "ll_parser.h"
+#include "stencil_runtime.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -58,17 +59,17 @@ static void set_compile_mode_env(const char *value) {
 }
 
 /*
- * Create a JIT instance in copy-and-patch mode by temporarily setting
+ * Create a JIT instance in the given compile mode by temporarily setting
  * the LIRIC_COMPILE_MODE env var.
  */
-static lr_jit_t *create_cp_jit(void) {
+static lr_jit_t *create_jit_in_mode(const char *mode) {
     const char *old = getenv("LIRIC_COMPILE_MODE");
     char saved[64] = {0};
     if (old) {
         size_t n = strlen(old);
         if (n < sizeof(saved)) memcpy(saved, old, n + 1);
     }
-    set_compile_mode_env("copy_patch");
+    set_compile_mode_env(mode);
     lr_jit_t *jit = lr_jit_create();
     if (saved[0])
         set_compile_mode_env(saved);
@@ -77,6 +78,10 @@ static lr_jit_t *create_cp_jit(void) {
     return jit;
 }
 
+static lr_jit_t *create_cp_jit(void) {
+    return create_jit_in_mode("copy_patch");
+}
+
 int test_cp_add_i32(void) {
     const char *src =
         "define i32 @add(i32 %a, i32 %b) {\n"
@@ -239,12 +244,15 @@ int test_cp_sdiv_srem(void) {
 }
 
 int test_cp_fallback_to_isel(void) {
-    /* icmp + select aren't supported by C&P; it should fall back to ISel. */
+    /* frem has no stencil; it should fall back to ISel mid-function. */
     const char *src =
         "define i32 @max(i32 %a, i32 %b) {\n"
         "entry:\n"
-        "  %cmp = icmp sgt i32 %a, %b\n"
-        "  %r = select i1 %cmp, i32 %a, i32 %b\n"
+        "  %fa = sitofp i32 %a to double\n"
+        "  %fr = frem double %fa, 1.0e9\n"
+        "  %ia = fptosi double %fr to i32\n"
+        "  %cmp = icmp sgt i32 %ia, %b\n"
+        "  %r = select i1 %cmp, i32 %ia, i32 %b\n"
         "  ret i32 %r\n"
         "}\n";
     lr_arena_t *arena = lr_arena_create(0);
@@ -375,3 +383,441 @@ int test_cp_add_ret_supernode_i64(void) {
     lr_arena_destroy(arena);
     return 0;
 }
+
+int test_cp_loop_phi_gep_memory(void) {
+    const char *src =
+        "%pair = type { i32, i64 }\n"
+        "define i64 @sum(ptr %p, ptr %q, i32 %n) {\n"
+        "entry:\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %i = phi i32 [ 0, %entry ], [ %inext, %body ]\n"
+        "  %acc = phi i64 [ 0, %entry ], [ %acc3, %body ]\n"
+        "  %c = icmp slt i32 %i, %n\n"
+        "  br i1 %c, label %body, label %done\n"
+        "body:\n"
+        "  %ep = getelementptr i64, ptr %p, i32 %i\n"
+        "  %v = load i64, ptr %ep\n"
+        "  %acc2 = add i64 %acc, %v\n"
+        "  %fp = getelementptr %pair, ptr %q, i32 %i, i32 1\n"
+        "  %f = load i64, ptr %fp\n"
+        "  %acc3 = add i64 %acc2, %f\n"
+        "  store i64 %acc3, ptr %ep\n"
+        "  %inext = add i32 %i, 1\n"
+        "  br label %loop\n"
+        "done:\n"
+        "  ret i64 %acc\n"
+        "}\n";
+    struct { int32_t a; int64_t b; } pairs[4] = {
+        {1, 100}, {2, 200}, {3, 300}, {4, 400}
+    };
+    int64_t vals[4] = {1, 2, 3, 4};
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *m = parse(src, arena);
+    TEST_ASSERT(m != NULL, "parse");
+
+    lr_jit_t *jit = create_cp_jit();
+    TEST_ASSERT(jit != NULL, "create jit");
+    TEST_ASSERT_EQ(lr_jit_add_module(jit, m), 0, "jit add module");
+
+    typedef int64_t (*fn_t)(int64_t *, void *, int32_t);
+    fn_t fn; LR_JIT_GET_FN(fn, jit, "sum");
+    TEST_ASSERT(fn != NULL, "function lookup");
+
+    TEST_ASSERT_EQ(fn(vals, pairs, 0), 0, "sum over empty range");
+    /* acc: 0 -> 101 -> 303 -> 606 -> 1010 (each step adds vals[i] and
+       pairs[i].b, then stores the running total back into vals[i]). */
+    TEST_ASSERT_EQ(fn(vals, pairs, 4), 1010, "sum over 4 elements");
+    TEST_ASSERT_EQ(vals[0], 101, "store through gep");
+    TEST_ASSERT_EQ(vals[3], 1010, "store through gep (last)");
+
+    lr_jit_destroy(jit);
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_cp_alloca_casts_fp(void) {
+    const char *src =
+        "define double @mix(i32 %a, double %x) {\n"
+        "entry:\n"
+        "  %slot = alloca i32\n"
+        "  store i32 %a, ptr %slot\n"
+        "  %v = load i32, ptr %slot\n"
+        "  %w = sext i32 %v to i64\n"
+        "  %neg = icmp slt i64 %w, 0\n"
+        "  %m = mul i64 %w, -1\n"
+        "  %abs = select i1 %neg, i64 %m, i64 %w\n"
+        "  %f = sitofp i64 %abs to double\n"
+        "  %y = fmul double %f, %x\n"
+        "  %z = fadd double %y, 5.000000e-01\n"
+        "  %h = fptrunc double %z to float\n"
+        "  %g = fpext float %h to double\n"
+        "  ret double %g\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *m = parse(src, arena);
+    TEST_ASSERT(m != NULL, "parse");
+
+    lr_jit_t *jit = create_cp_jit();
+    TEST_ASSERT(jit != NULL, "create jit");
+    TEST_ASSERT_EQ(lr_jit_add_module(jit, m), 0, "jit add module");
+
+    typedef double (*fn_t)(int32_t, double);
+    fn_t fn; LR_JIT_GET_FN(fn, jit, "mix");
+    TEST_ASSERT(fn != NULL, "function lookup");
+
+    TEST_ASSERT(fn(-3, 2.0) == 6.5, "mix(-3, 2.0)");
+    TEST_ASSERT(fn(4, 0.25) == 1.5, "mix(4, 0.25)");
+
+    lr_jit_destroy(jit);
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_cp_call_between_stencils(void) {
+    const char *src =
+        "define i64 @add2(i64 %a, i64 %b) {\n"
+        "entry:\n"
+        "  %s = add i64 %a, %b\n"
+        "  ret i64 %s\n"
+        "}\n"
+        "define i64 @caller(i64 %a) {\n"
+        "entry:\n"
+        "  %t = call i64 @add2(i64 %a, i64 %a)\n"
+        "  %v = xor i64 %t, %a\n"
+        "  %u = call i64 @add2(i64 %v, i64 1)\n"
+        "  %r = mul i64 %u, 3\n"
+        "  ret i64 %r\n"
+        "}\n";
+    const uint8_t mov_rdi_rbp[] = {0x48, 0x89, 0xEF};
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *m = parse(src, arena);
+    TEST_ASSERT(m != NULL, "parse");
+
+    lr_jit_t *jit = create_cp_jit();
+    TEST_ASSERT(jit != NULL, "create jit");
+    TEST_ASSERT_EQ(lr_jit_add_module(jit, m), 0, "jit add module");
+
+    typedef int64_t (*fn_t)(int64_t);
+    fn_t fn; LR_JIT_GET_FN(fn, jit, "caller");
+    TEST_ASSERT(fn != NULL, "function lookup");
+    /* caller(a) = (((a + a) ^ a) + 1) * 3 */
+    TEST_ASSERT_EQ(fn(10), 93, "caller(10)");
+    TEST_ASSERT_EQ(fn(-1), 6, "caller(-1)");
+
+    {
+        uint8_t *start = (uint8_t *)lr_jit_get_function(jit, "caller");
+        size_t code_off;
+        TEST_ASSERT(start != NULL, "caller code start");
+        code_off = (size_t)(start - jit->code_buf);
+        TEST_ASSERT(code_off < jit->code_size, "caller code offset");
+        TEST_ASSERT(count_pattern(start, jit->code_size - code_off,
+                                  mov_rdi_rbp, sizeof(mov_rdi_rbp)) > 0,
+                    "caller is stitched from stencils");
+    }
+
+    lr_jit_destroy(jit);
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_cp_calls_three_args_fp_return(void) {
+    const char *src =
+        "define i64 @mad(i64 %a, i64 %b, i64 %c) {\n"
+        "entry:\n"
+        "  %m = mul i64 %a, %b\n"
+        "  %r = sub i64 %m, %c\n"
+        "  ret i64 %r\n"
+        "}\n"
+        "define double @half(i64 %a) {\n"
+        "entry:\n"
+        "  %f = sitofp i64 %a to double\n"
+        "  %h = fmul double %f, 5.000000e-01\n"
+        "  ret double %h\n"
+        "}\n"
+        "define float @third(i64 %a, i64 %b, i64 %c) {\n"
+        "entry:\n"
+        "  %s = add i64 %a, %b\n"
+        "  %t = add i64 %s, %c\n"
+        "  %f = sitofp i64 %t to float\n"
+        "  %q = fdiv float %f, 3.000000e+00\n"
+        "  ret float %q\n"
+        "}\n"
+        "define double @caller(i64 %a, i64 %b) {\n"
+        "entry:\n"
+        "  %x = add i64 %a, 1\n"
+        "  %m = call i64 @mad(i64 %a, i64 %b, i64 %x)\n"
+        "  %h = call double @half(i64 %m)\n"
+        "  %t = call float @third(i64 %m, i64 %b, i64 %x)\n"
+        "  %te = fpext float %t to double\n"
+        "  %r = fadd double %h, %te\n"
+        "  ret double %r\n"
+        "}\n";
+    static const uint32_t rets[] = {LR_TYPE_VOID, LR_TYPE_I64,
+                                    LR_TYPE_DOUBLE, LR_TYPE_FLOAT};
+    for (size_t i = 0; i < sizeof(rets) / sizeof(rets[0]); i++) {
+        for (uint32_t n = 0; n <= 3; n++)
+            TEST_ASSERT(lr_stencil_lookup_ex(LR_OP_CALL,
+                                             (lr_type_kind_t)rets[i], n,
+                                             0) != NULL,
+                        "call stencil for each return kind and arity");
+    }
+
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *m = parse(src, arena);
+    TEST_ASSERT(m != NULL, "parse");
+    lr_jit_t *jit = create_cp_jit();
+    TEST_ASSERT(jit != NULL, "create jit");
+    TEST_ASSERT_EQ(lr_jit_add_module(jit, m), 0, "jit add module");
+
+    typedef double (*fn_t)(int64_t, int64_t);
+    fn_t fn; LR_JIT_GET_FN(fn, jit, "caller");
+    TEST_ASSERT(fn != NULL, "function lookup");
+    /* m = a * b - (a + 1); m / 2 + (float)(m + b + a + 1) / 3 */
+    TEST_ASSERT(fn(2, 5) == 3.5 + 5.0, "caller(2, 5)");
+    TEST_ASSERT(fn(-3, 3) == -3.5 - 2.0, "caller(-3, 3)");
+
+    lr_jit_destroy(jit);
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_cp_matches_isel_differential(void) {
+    const char *src =
+        "define internal i64 @mix2(i64 %a, i64 %b) {\n"
+        "entry:\n"
+        "  %x = xor i64 %a, %b\n"
+        "  %m = mul i64 %x, 31\n"
+        "  %r = sub i64 %m, %a\n"
+        "  ret i64 %r\n"
+        "}\n"
+        "define i64 @arith(i64 %a, i64 %b) {\n"
+        "entry:\n"
+        "  %d = or i64 %b, 1\n"
+        "  %s = and i64 %b, 63\n"
+        "  %t0 = add i64 %a, %b\n"
+        "  %t1 = sub i64 %t0, %d\n"
+        "  %t2 = mul i64 %t1, %a\n"
+        "  %t3 = sdiv i64 %t2, %d\n"
+        "  %t4 = srem i64 %a, %d\n"
+        "  %t5 = udiv i64 %t2, %d\n"
+        "  %t6 = urem i64 %b, %d\n"
+        "  %t7 = shl i64 %a, %s\n"
+        "  %t8 = lshr i64 %t2, %s\n"
+        "  %t9 = ashr i64 %t1, %s\n"
+        "  %u0 = xor i64 %t3, %t4\n"
+        "  %u1 = or i64 %t5, %t6\n"
+        "  %u2 = and i64 %t7, %t8\n"
+        "  %u3 = add i64 %u0, %u1\n"
+        "  %u4 = sub i64 %u2, %t9\n"
+        "  %u5 = xor i64 %u3, %u4\n"
+        "  ret i64 %u5\n"
+        "}\n"
+        "define i32 @cmp(i32 %a, i32 %b) {\n"
+        "entry:\n"
+        "  %c0 = icmp eq i32 %a, %b\n"
+        "  %c1 = icmp ne i32 %a, %b\n"
+        "  %c2 = icmp slt i32 %a, %b\n"
+        "  %c3 = icmp sle i32 %a, %b\n"
+        "  %c4 = icmp sgt i32 %a, %b\n"
+        "  %c5 = icmp sge i32 %a, %b\n"
+        "  %c6 = icmp ult i32 %a, %b\n"
+        "  %c7 = icmp ule i32 %a, %b\n"
+        "  %c8 = icmp ugt i32 %a, %b\n"
+        "  %c9 = icmp uge i32 %a, %b\n"
+        "  %z0 = zext i1 %c0 to i32\n"
+        "  %z1 = zext i1 %c1 to i32\n"
+        "  %z2 = zext i1 %c2 to i32\n"
+        "  %z3 = zext i1 %c3 to i32\n"
+        "  %z4 = zext i1 %c4 to i32\n"
+        "  %z5 = zext i1 %c5 to i32\n"
+        "  %z6 = zext i1 %c6 to i32\n"
+        "  %z7 = zext i1 %c7 to i32\n"
+        "  %z8 = zext i1 %c8 to i32\n"
+        "  %z9 = zext i1 %c9 to i32\n"
+        "  %s1 = shl i32 %z1, 1\n"
+        "  %s2 = shl i32 %z2, 2\n"
+        "  %s3 = shl i32 %z3, 3\n"
+        "  %s4 = shl i32 %z4, 4\n"
+        "  %s5 = shl i32 %z5, 5\n"
+        "  %s6 = shl i32 %z6, 6\n"
+        "  %s7 = shl i32 %z7, 7\n"
+        "  %s8 = shl i32 %z8, 8\n"
+        "  %s9 = shl i32 %z9, 9\n"
+        "  %o1 = or i32 %z0, %s1\n"
+        "  %o2 = or i32 %o1, %s2\n"
+        "  %o3 = or i32 %o2, %s3\n"
+        "  %o4 = or i32 %o3, %s4\n"
+        "  %o5 = or i32 %o4, %s5\n"
+        "  %o6 = or i32 %o5, %s6\n"
+        "  %o7 = or i32 %o6, %s7\n"
+        "  %o8 = or i32 %o7, %s8\n"
+        "  %o9 = or i32 %o8, %s9\n"
+        "  %mx = select i1 %c4, i32 %a, i32 %b\n"
+        "  %hi = shl i32 %mx, 10\n"
+        "  %r = xor i32 %o9, %hi\n"
+        "  ret i32 %r\n"
+        "}\n"
+        "define i64 @loop(i64 %n, i64 %k) {\n"
+        "entry:\n"
+        "  %lim = and i64 %n, 255\n"
+        "  br label %head\n"
+        "head:\n"
+        "  %i = phi i64 [ 0, %entry ], [ %inext, %latch ]\n"
+        "  %acc = phi i64 [ %k, %entry ], [ %acc2, %latch ]\n"
+        "  %c = icmp ult i64 %i, %lim\n"
+        "  br i1 %c, label %body, label %done\n"
+        "body:\n"
+        "  %odd = and i64 %i, 1\n"
+        "  %isodd = icmp ne i64 %odd, 0\n"
+        "  br i1 %isodd, label %odd_bb, label %even_bb\n"
+        "odd_bb:\n"
+        "  %a1 = call i64 @mix2(i64 %acc, i64 %i)\n"
+        "  br label %latch\n"
+        "even_bb:\n"
+        "  %a2 = add i64 %acc, %i\n"
+        "  br label %latch\n"
+        "latch:\n"
+        "  %acc2 = phi i64 [ %a1, %odd_bb ], [ %a2, %even_bb ]\n"
+        "  %inext = add i64 %i, 1\n"
+        "  br label %head\n"
+        "done:\n"
+        "  ret i64 %acc\n"
+        "}\n"
+        "define i64 @mem(ptr %p, i64 %seed) {\n"
+        "entry:\n"
+        "  %tmp = alloca [8 x i32]\n"
+        "  br label %fill\n"
+        "fill:\n"
+        "  %i = phi i64 [ 0, %entry ], [ %inext, %fill ]\n"
+        "  %v = mul i64 %seed, %i\n"
+        "  %ep = getelementptr i64, ptr %p, i64 %i\n"
+        "  %old = load i64, ptr %ep\n"
+        "  %nv = add i64 %old, %v\n"
+        "  store i64 %nv, ptr %ep\n"
+        "  %tp = getelementptr [8 x i32], ptr %tmp, i64 0, i64 %i\n"
+        "  %tv = trunc i64 %nv to i32\n"
+        "  store i32 %tv, ptr %tp\n"
+        "  %inext = add i64 %i, 1\n"
+        "  %more = icmp slt i64 %inext, 8\n"
+        "  br i1 %more, label %fill, label %sum\n"
+        "sum:\n"
+        "  %t3p = getelementptr [8 x i32], ptr %tmp, i64 0, i64 3\n"
+        "  %t3 = load i32, ptr %t3p\n"
+        "  %t7p = getelementptr [8 x i32], ptr %tmp, i64 0, i64 7\n"
+        "  %t7 = load i32, ptr %t7p\n"
+        "  %s3 = sext i32 %t3 to i64\n"
+        "  %z7 = zext i32 %t7 to i64\n"
+        "  %r = add i64 %s3, %z7\n"
+        "  ret i64 %r\n"
+        "}\n"
+        "define double @fp(double %x, double %y) {\n"
+        "entry:\n"
+        "  %s = fadd double %x, %y\n"
+        "  %d = fsub double %x, %y\n"
+        "  %m = fmul double %s, %d\n"
+        "  %q = fdiv double %m, 4.000000e+00\n"
+        "  %lt = fcmp olt double %x, %y\n"
+        "  %mn = select i1 %lt, double %x, double %y\n"
+        "  %i = fptosi double %q to i64\n"
+        "  %f = sitofp i64 %i to double\n"
+        "  %t = fadd double %f, %mn\n"
+        "  %h = fptrunc double %t to float\n"
+        "  %g = fpext float %h to double\n"
+        "  ret double %g\n"
+        "}\n";
+    static const int64_t inputs[] = {
+        0, 1, -1, 7, -13, 64, 1000003, 0x7fffffffLL, -0x80000000LL,
+        0x123456789abcLL
+    };
+    static const double fp_inputs[] = {
+        0.0, 1.5, -2.25, 3.0e5, -7.125, 0.0625
+    };
+    const size_t n_in = sizeof(inputs) / sizeof(inputs[0]);
+    const size_t n_fp = sizeof(fp_inputs) / sizeof(fp_inputs[0]);
+    typedef int64_t (*i64_fn_t)(int64_t, int64_t);
+    typedef int32_t (*i32_fn_t)(int32_t, int32_t);
+    typedef int64_t (*mem_fn_t)(int64_t *, int64_t);
+    typedef double (*fp_fn_t)(double, double);
+    static const char *const i64_names[] = {"arith", "loop"};
+    lr_arena_t *a_isel = lr_arena_create(0);
+    lr_arena_t *a_cp = lr_arena_create(0);
+    lr_module_t *m_isel = parse(src, a_isel);
+    lr_module_t *m_cp = parse(src, a_cp);
+    TEST_ASSERT(m_isel != NULL && m_cp != NULL, "parse");
+
+    lr_jit_t *j_isel = create_jit_in_mode("isel");
+    lr_jit_t *j_cp = create_cp_jit();
+    TEST_ASSERT(j_isel != NULL && j_cp != NULL, "create jits");
+    TEST_ASSERT_EQ(j_isel->mode, LR_COMPILE_ISEL, "isel jit mode");
+    TEST_ASSERT_EQ(j_cp->mode, LR_COMPILE_COPY_PATCH, "copy_patch jit mode");
+    TEST_ASSERT_EQ(lr_jit_add_module(j_isel, m_isel), 0, "isel add module");
+    TEST_ASSERT_EQ(lr_jit_add_module(j_cp, m_cp), 0, "copy_patch add module");
+
+    for (size_t f = 0; f < sizeof(i64_names) / sizeof(i64_names[0]); f++) {
+        i64_fn_t fi, fc;
+        LR_JIT_GET_FN(fi, j_isel, i64_names[f]);
+        LR_JIT_GET_FN(fc, j_cp, i64_names[f]);
+        TEST_ASSERT(fi != NULL && fc != NULL, "i64 function lookup");
+        for (size_t x = 0; x < n_in; x++) {
+            for (size_t y = 0; y < n_in; y++) {
+                int64_t ri = fi(inputs[x], inputs[y]);
+                int64_t rc = fc(inputs[x], inputs[y]);
+                if (ri != rc)
+                    fprintf(stderr, "  %s(%lld, %lld)\n", i64_names[f],
+                            (long long)inputs[x], (long long)inputs[y]);
+                TEST_ASSERT_EQ(rc, ri, "copy_patch matches isel");
+            }
+        }
+    }
+
+    {
+        i32_fn_t fi, fc;
+        LR_JIT_GET_FN(fi, j_isel, "cmp");
+        LR_JIT_GET_FN(fc, j_cp, "cmp");
+        TEST_ASSERT(fi != NULL && fc != NULL, "cmp lookup");
+        for (size_t x = 0; x < n_in; x++) {
+            for (size_t y = 0; y < n_in; y++) {
+                int32_t a = (int32_t)inputs[x], b = (int32_t)inputs[y];
+                TEST_ASSERT_EQ(fc(a, b), fi(a, b), "cmp: copy_patch matches isel");
+            }
+        }
+    }
+
+    {
+        mem_fn_t fi, fc;
+        LR_JIT_GET_FN(fi, j_isel, "mem");
+        LR_JIT_GET_FN(fc, j_cp, "mem");
+        TEST_ASSERT(fi != NULL && fc != NULL, "mem lookup");
+        for (size_t x = 0; x < n_in; x++) {
+            int64_t bi[8], bc[8];
+            for (int k = 0; k < 8; k++)
+                bi[k] = bc[k] = inputs[(x + (size_t)k) % n_in];
+            TEST_ASSERT_EQ(fc(bc, inputs[x]), fi(bi, inputs[x]),
+                           "mem: copy_patch matches isel");
+            TEST_ASSERT(memcmp(bi, bc, sizeof(bi)) == 0,
+                        "mem: stored array matches isel");
+        }
+    }
+
+    {
+        fp_fn_t fi, fc;
+        LR_JIT_GET_FN(fi, j_isel, "fp");
+        LR_JIT_GET_FN(fc, j_cp, "fp");
+        TEST_ASSERT(fi != NULL && fc != NULL, "fp lookup");
+        for (size_t x = 0; x < n_fp; x++) {
+            for (size_t y = 0; y < n_fp; y++) {
+                double ri = fi(fp_inputs[x], fp_inputs[y]);
+                double rc = fc(fp_inputs[x], fp_inputs[y]);
+                TEST_ASSERT(memcmp(&ri, &rc, sizeof(ri)) == 0,
+                            "fp: copy_patch matches isel bit for bit");
+            }
+        }
+    }
+
+    lr_jit_destroy(j_isel);
+    lr_jit_destroy(j_cp);
+    lr_arena_destroy(a_isel);
+    lr_arena_destroy(a_cp);
+    return 0;
+}
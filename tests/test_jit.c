@@ -5,11 +5,13 @@
 #include "../src/objfile.h"
 #include "../src/llvm_backend.h"
 #include "../src/platform/platform.h"
+#include "../src/target_shared.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <math.h>
 
 #if defined(_WIN32)
 static int lr_test_setenv(const char *name, const char *value, int overwrite) {
@@ -179,7 +181,7 @@ static int set_compile_mode_env(const char *value, char **old_value, int *had_ol
 static void restore_compile_mode_env(char *old_value, int had_old_value) {
     if (had_old_value) {
         (void)lr_test_setenv("LIRIC_COMPILE_MODE",
-                             old_value ? old_value : "copy_patch", 1);
+                             old_value ? old_value : "isel", 1);
     } else {
         (void)lr_test_unsetenv("LIRIC_COMPILE_MODE");
     }
@@ -615,6 +617,277 @@ int test_jit_branch(void) {
     return 0;
 }
 
+int test_jit_switch_jump_table(void) {
+    const char *src =
+        "define i32 @sel(i32 %x) {\n"
+        "entry:\n"
+        "  switch i32 %x, label %def [\n"
+        "    i32 10, label %a\n"
+        "    i32 11, label %b\n"
+        "    i32 12, label %c\n"
+        "    i32 14, label %a\n"
+        "    i32 15, label %b\n"
+        "    i32 17, label %c\n"
+        "    i32 12, label %a\n"
+        "  ]\n"
+        "a:\n"
+        "  br label %done\n"
+        "b:\n"
+        "  br label %done\n"
+        "c:\n"
+        "  %cx = add i32 %x, 100\n"
+        "  br label %done\n"
+        "def:\n"
+        "  br label %done\n"
+        "done:\n"
+        "  %r = phi i32 [1, %a], [2, %b], [%cx, %c], [-1, %def]\n"
+        "  ret i32 %r\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *m = parse(src, arena);
+    TEST_ASSERT(m != NULL, "parse");
+
+    lr_jit_t *jit = lr_jit_create();
+    int rc = lr_jit_add_module(jit, m);
+    TEST_ASSERT_EQ(rc, 0, "jit add module");
+
+    typedef int (*fn_t)(int);
+    fn_t fn; LR_JIT_GET_FN(fn, jit, "sel");
+    TEST_ASSERT(fn != NULL, "function lookup");
+
+    TEST_ASSERT_EQ(fn(10), 1, "sel(10)");
+    TEST_ASSERT_EQ(fn(11), 2, "sel(11)");
+    TEST_ASSERT_EQ(fn(12), 112, "first duplicate case wins");
+    TEST_ASSERT_EQ(fn(13), -1, "hole goes to default");
+    TEST_ASSERT_EQ(fn(14), 1, "sel(14)");
+    TEST_ASSERT_EQ(fn(15), 2, "sel(15)");
+    TEST_ASSERT_EQ(fn(17), 117, "sel(17)");
+    TEST_ASSERT_EQ(fn(9), -1, "below range");
+    TEST_ASSERT_EQ(fn(18), -1, "above range");
+    TEST_ASSERT_EQ(fn(-1), -1, "negative wraps above range");
+
+    lr_jit_destroy(jit);
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_jit_switch_bit_test_and_tree(void) {
+    const char *src =
+        "define i32 @vowel(i8 %ch) {\n"
+        "entry:\n"
+        "  switch i8 %ch, label %no [\n"
+        "    i8 97, label %yes\n"
+        "    i8 101, label %yes\n"
+        "    i8 105, label %yes\n"
+        "    i8 111, label %yes\n"
+        "    i8 117, label %yes\n"
+        "  ]\n"
+        "yes:\n"
+        "  ret i32 1\n"
+        "no:\n"
+        "  ret i32 0\n"
+        "}\n"
+        "define i64 @sparse(i64 %x) {\n"
+        "entry:\n"
+        "  switch i64 %x, label %done [\n"
+        "    i64 -5000000000, label %a\n"
+        "    i64 -7, label %b\n"
+        "    i64 3, label %a\n"
+        "    i64 900, label %b\n"
+        "    i64 70000, label %c\n"
+        "    i64 5000000000, label %c\n"
+        "  ]\n"
+        "a:\n"
+        "  br label %done\n"
+        "b:\n"
+        "  br label %done\n"
+        "c:\n"
+        "  br label %done\n"
+        "done:\n"
+        "  %r = phi i64 [0, %entry], [1, %a], [2, %b], [3, %c]\n"
+        "  ret i64 %r\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *m = parse(src, arena);
+    TEST_ASSERT(m != NULL, "parse");
+
+    lr_jit_t *jit = lr_jit_create();
+    int rc = lr_jit_add_module(jit, m);
+    TEST_ASSERT_EQ(rc, 0, "jit add module");
+
+    typedef int (*vowel_fn_t)(char);
+    typedef int64_t (*sparse_fn_t)(int64_t);
+    vowel_fn_t vowel; LR_JIT_GET_FN(vowel, jit, "vowel");
+    sparse_fn_t sparse; LR_JIT_GET_FN(sparse, jit, "sparse");
+    TEST_ASSERT(vowel != NULL, "vowel lookup");
+    TEST_ASSERT(sparse != NULL, "sparse lookup");
+
+    TEST_ASSERT_EQ(vowel('a'), 1, "a is a vowel");
+    TEST_ASSERT_EQ(vowel('u'), 1, "u is a vowel");
+    TEST_ASSERT_EQ(vowel('b'), 0, "b is not a vowel");
+    TEST_ASSERT_EQ(vowel('z'), 0, "z is not a vowel");
+    TEST_ASSERT_EQ(vowel('A'), 0, "A is below range");
+
+    TEST_ASSERT_EQ(sparse(-5000000000LL), 1, "sparse(-5e9)");
+    TEST_ASSERT_EQ(sparse(-7), 2, "sparse(-7)");
+    TEST_ASSERT_EQ(sparse(3), 1, "sparse(3)");
+    TEST_ASSERT_EQ(sparse(900), 2, "sparse(900)");
+    TEST_ASSERT_EQ(sparse(70000), 3, "sparse(70000)");
+    TEST_ASSERT_EQ(sparse(5000000000LL), 3, "sparse(5e9)");
+    TEST_ASSERT_EQ(sparse(4), 0, "sparse(4) defaults");
+    TEST_ASSERT_EQ(sparse(-8), 0, "sparse(-8) defaults");
+
+    lr_jit_destroy(jit);
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_jit_int_intrinsics_inline(void) {
+    const char *src =
+        "declare i32 @llvm.smax.i32(i32, i32)\n"
+        "declare i64 @llvm.umin.i64(i64, i64)\n"
+        "declare i8 @llvm.smin.i8(i8, i8)\n"
+        "declare i16 @llvm.umax.i16(i16, i16)\n"
+        "declare i64 @llvm.abs.i64(i64, i1)\n"
+        "declare i8 @llvm.abs.i8(i8, i1)\n"
+        "declare i32 @llvm.ctpop.i32(i32)\n"
+        "declare i64 @llvm.ctlz.i64(i64, i1)\n"
+        "declare i16 @llvm.ctlz.i16(i16, i1)\n"
+        "declare i8 @llvm.cttz.i8(i8, i1)\n"
+        "declare i64 @llvm.fshl.i64(i64, i64, i64)\n"
+        "declare i32 @llvm.fshr.i32(i32, i32, i32)\n"
+        "declare i8 @llvm.fshr.i8(i8, i8, i8)\n"
+        "define i32 @smax32(i32 %a, i32 %b) {\n"
+        "  %r = call i32 @llvm.smax.i32(i32 %a, i32 %b)\n"
+        "  ret i32 %r\n"
+        "}\n"
+        "define i64 @umin64(i64 %a, i64 %b) {\n"
+        "  %r = call i64 @llvm.umin.i64(i64 %a, i64 %b)\n"
+        "  ret i64 %r\n"
+        "}\n"
+        "define i32 @smin8(i32 %a, i32 %b) {\n"
+        "  %x = trunc i32 %a to i8\n"
+        "  %y = trunc i32 %b to i8\n"
+        "  %r = call i8 @llvm.smin.i8(i8 %x, i8 %y)\n"
+        "  %z = sext i8 %r to i32\n"
+        "  ret i32 %z\n"
+        "}\n"
+        "define i32 @umax16(i32 %a, i32 %b) {\n"
+        "  %x = trunc i32 %a to i16\n"
+        "  %y = trunc i32 %b to i16\n"
+        "  %r = call i16 @llvm.umax.i16(i16 %x, i16 %y)\n"
+        "  %z = zext i16 %r to i32\n"
+        "  ret i32 %z\n"
+        "}\n"
+        "define i64 @abs64(i64 %a) {\n"
+        "  %r = call i64 @llvm.abs.i64(i64 %a, i1 false)\n"
+        "  ret i64 %r\n"
+        "}\n"
+        "define i32 @abs8(i32 %a) {\n"
+        "  %x = trunc i32 %a to i8\n"
+        "  %r = call i8 @llvm.abs.i8(i8 %x, i1 false)\n"
+        "  %z = zext i8 %r to i32\n"
+        "  ret i32 %z\n"
+        "}\n"
+        "define i32 @ctpop32(i32 %a) {\n"
+        "  %r = call i32 @llvm.ctpop.i32(i32 %a)\n"
+        "  ret i32 %r\n"
+        "}\n"
+        "define i64 @ctlz64(i64 %a) {\n"
+        "  %r = call i64 @llvm.ctlz.i64(i64 %a, i1 false)\n"
+        "  ret i64 %r\n"
+        "}\n"
+        "define i32 @ctlz16(i32 %a) {\n"
+        "  %x = trunc i32 %a to i16\n"
+        "  %r = call i16 @llvm.ctlz.i16(i16 %x, i1 false)\n"
+        "  %z = zext i16 %r to i32\n"
+        "  ret i32 %z\n"
+        "}\n"
+        "define i32 @cttz8(i32 %a) {\n"
+        "  %x = trunc i32 %a to i8\n"
+        "  %r = call i8 @llvm.cttz.i8(i8 %x, i1 false)\n"
+        "  %z = zext i8 %r to i32\n"
+        "  ret i32 %z\n"
+        "}\n"
+        "define i64 @fshl64(i64 %a, i64 %b, i64 %s) {\n"
+        "  %r = call i64 @llvm.fshl.i64(i64 %a, i64 %b, i64 %s)\n"
+        "  ret i64 %r\n"
+        "}\n"
+        "define i32 @fshr32(i32 %a, i32 %b, i32 %s) {\n"
+        "  %r = call i32 @llvm.fshr.i32(i32 %a, i32 %b, i32 %s)\n"
+        "  ret i32 %r\n"
+        "}\n"
+        "define i32 @fshr8(i32 %a, i32 %b, i32 %s) {\n"
+        "  %x = trunc i32 %a to i8\n"
+        "  %y = trunc i32 %b to i8\n"
+        "  %t = trunc i32 %s to i8\n"
+        "  %r = call i8 @llvm.fshr.i8(i8 %x, i8 %y, i8 %t)\n"
+        "  %z = zext i8 %r to i32\n"
+        "  ret i32 %z\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *m = parse(src, arena);
+    TEST_ASSERT(m != NULL, "parse");
+
+    lr_jit_t *jit = lr_jit_create();
+    int rc = lr_jit_add_module(jit, m);
+    TEST_ASSERT_EQ(rc, 0, "jit add module");
+
+    typedef int32_t (*fn32_2_t)(int32_t, int32_t);
+    typedef int32_t (*fn32_1_t)(int32_t);
+    typedef int32_t (*fn32_3_t)(int32_t, int32_t, int32_t);
+    typedef uint64_t (*fn64_2_t)(uint64_t, uint64_t);
+    typedef uint64_t (*fn64_1_t)(uint64_t);
+    typedef uint64_t (*fn64_3_t)(uint64_t, uint64_t, uint64_t);
+    fn32_2_t smax32; LR_JIT_GET_FN(smax32, jit, "smax32");
+    fn64_2_t umin64; LR_JIT_GET_FN(umin64, jit, "umin64");
+    fn32_2_t smin8; LR_JIT_GET_FN(smin8, jit, "smin8");
+    fn32_2_t umax16; LR_JIT_GET_FN(umax16, jit, "umax16");
+    fn64_1_t abs64; LR_JIT_GET_FN(abs64, jit, "abs64");
+    fn32_1_t abs8; LR_JIT_GET_FN(abs8, jit, "abs8");
+    fn32_1_t ctpop32; LR_JIT_GET_FN(ctpop32, jit, "ctpop32");
+    fn64_1_t ctlz64; LR_JIT_GET_FN(ctlz64, jit, "ctlz64");
+    fn32_1_t ctlz16; LR_JIT_GET_FN(ctlz16, jit, "ctlz16");
+    fn32_1_t cttz8; LR_JIT_GET_FN(cttz8, jit, "cttz8");
+    fn64_3_t fshl64; LR_JIT_GET_FN(fshl64, jit, "fshl64");
+    fn32_3_t fshr32; LR_JIT_GET_FN(fshr32, jit, "fshr32");
+    fn32_3_t fshr8; LR_JIT_GET_FN(fshr8, jit, "fshr8");
+    TEST_ASSERT(smax32 && umin64 && smin8 && umax16 && abs64 && abs8 &&
+                ctpop32 && ctlz64 && ctlz16 && cttz8 && fshl64 && fshr32 &&
+                fshr8, "function lookup");
+
+    TEST_ASSERT_EQ(smax32(-3, 2), 2, "smax i32");
+    TEST_ASSERT_EQ(smax32(INT32_MIN, -1), -1, "smax i32 negative");
+    TEST_ASSERT_EQ(umin64(UINT64_MAX, 7), 7, "umin i64");
+    TEST_ASSERT_EQ(smin8(0x7f, 0x80), -128, "smin i8 compares signed");
+    TEST_ASSERT_EQ(smin8(0x105, 3), 3, "smin i8 ignores high bits");
+    TEST_ASSERT_EQ(umax16(0x8000, 0x7fff), 0x8000, "umax i16 compares unsigned");
+    TEST_ASSERT_EQ(abs64((uint64_t)-42), 42, "abs i64");
+    TEST_ASSERT_EQ(abs64((uint64_t)INT64_MIN), (uint64_t)INT64_MIN,
+                   "abs i64 of INT_MIN wraps");
+    TEST_ASSERT_EQ(abs8(0xfb), 5, "abs i8");
+    TEST_ASSERT_EQ(abs8(0x80), 0x80, "abs i8 of INT_MIN wraps");
+    TEST_ASSERT_EQ(ctpop32(-1), 32, "ctpop i32 all ones");
+    TEST_ASSERT_EQ(ctpop32(0x10101), 3, "ctpop i32");
+    TEST_ASSERT_EQ(ctlz64(0), 64, "ctlz i64 of zero");
+    TEST_ASSERT_EQ(ctlz64(1), 63, "ctlz i64 of one");
+    TEST_ASSERT_EQ(ctlz16(0x10000), 16, "ctlz i16 of zero");
+    TEST_ASSERT_EQ(ctlz16(0x00ff), 8, "ctlz i16");
+    TEST_ASSERT_EQ(cttz8(0x100), 8, "cttz i8 of zero");
+    TEST_ASSERT_EQ(cttz8(0x28), 3, "cttz i8");
+    TEST_ASSERT_EQ(fshl64(0x0123456789abcdefULL, 0xfedcba9876543210ULL, 68),
+                   0x123456789abcdeffULL, "fshl i64 shift modulo width");
+    TEST_ASSERT_EQ(fshl64(5, 9, 0), 5, "fshl i64 by zero");
+    TEST_ASSERT_EQ(fshr32(0x12345678, (int32_t)0x9abcdef0, 8), 0x789abcde,
+                   "fshr i32");
+    TEST_ASSERT_EQ(fshr8(0, 128, 21), 4, "fshr i8 shift modulo width");
+    TEST_ASSERT_EQ(fshr8(0x0f, 0xf0, 4), 0xff, "fshr i8");
+
+    lr_jit_destroy(jit);
+    lr_arena_destroy(arena);
+    return 0;
+}
+
 int test_jit_loop(void) {
     const char *src =
         "define i32 @sum(i32 %n) {\n"
@@ -652,6 +925,578 @@ int test_jit_loop(void) {
     return 0;
 }
 
+int test_jit_tierup_recompiles_hot_function(void) {
+    const char *src =
+        "define i32 @sum(i32 %n) {\n"
+        "entry:\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %i = phi i32 [0, %entry], [%i_next, %loop]\n"
+        "  %acc = phi i32 [0, %entry], [%acc_next, %loop]\n"
+        "  %i_next = add i32 %i, 1\n"
+        "  %acc_next = add i32 %acc, %i_next\n"
+        "  %done = icmp eq i32 %i_next, %n\n"
+        "  br i1 %done, label %exit, label %loop\n"
+        "exit:\n"
+        "  ret i32 %acc_next\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *m = parse(src, arena);
+    TEST_ASSERT(m != NULL, "parse");
+
+    lr_jit_t *jit = lr_jit_create();
+    TEST_ASSERT(jit != NULL, "jit create");
+    lr_jit_set_tierup_threshold(jit, 50);
+    int rc = lr_jit_add_module(jit, m);
+    TEST_ASSERT_EQ(rc, 0, "jit add module");
+
+    typedef int (*fn_t)(int);
+    fn_t fn; LR_JIT_GET_FN(fn, jit, "sum");
+    TEST_ASSERT(fn != NULL, "function lookup");
+    TEST_ASSERT_EQ(fn(10), 55, "tier-0 sum(10) == 55");
+    TEST_ASSERT_EQ(lr_jit_tierup_poll(jit, true), 0, "cold function stays");
+
+    /* 100 loop-header visits push the counter past the threshold. */
+    TEST_ASSERT_EQ(fn(100), 5050, "tier-0 sum(100) == 5050");
+#if defined(__x86_64__) || defined(_M_X64) || defined(__aarch64__)
+    TEST_ASSERT_EQ(lr_jit_tierup_poll(jit, true), 1, "hot function recompiled");
+#endif
+    TEST_ASSERT_EQ(lr_jit_tierup_poll(jit, true), 0, "recompiled only once");
+
+    fn_t again; LR_JIT_GET_FN(again, jit, "sum");
+    TEST_ASSERT(again == fn, "entry address is stable across tiers");
+    TEST_ASSERT_EQ(fn(10), 55, "tier-1 sum(10) == 55");
+    TEST_ASSERT_EQ(fn(1), 1, "tier-1 sum(1) == 1");
+    TEST_ASSERT_EQ(fn(1000), 500500, "tier-1 sum(1000) == 500500");
+
+    lr_jit_destroy(jit);
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_jit_tierup_concurrent_add_module(void) {
+    const char *src =
+        "@bias = global i32 3\n"
+        "define internal i32 @step(i32 %x) {\n"
+        "entry:\n"
+        "  %b = load i32, ptr @bias\n"
+        "  %r = add i32 %x, %b\n"
+        "  ret i32 %r\n"
+        "}\n"
+        "define i32 @sum(i32 %n) {\n"
+        "entry:\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %i = phi i32 [0, %entry], [%i_next, %loop]\n"
+        "  %acc = phi i32 [0, %entry], [%acc_next, %loop]\n"
+        "  %i_next = add i32 %i, 1\n"
+        "  %s = call i32 @step(i32 %i_next)\n"
+        "  %acc_next = add i32 %acc, %s\n"
+        "  %done = icmp eq i32 %i_next, %n\n"
+        "  br i1 %done, label %exit, label %loop\n"
+        "exit:\n"
+        "  ret i32 %acc_next\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *m = parse(src, arena);
+    TEST_ASSERT(m != NULL, "parse");
+
+    lr_jit_t *jit = lr_jit_create();
+    TEST_ASSERT(jit != NULL, "jit create");
+    lr_jit_set_tierup_threshold(jit, 50);
+    TEST_ASSERT_EQ(lr_jit_add_module(jit, m), 0, "jit add module");
+
+    typedef int (*fn_t)(int);
+    fn_t fn; LR_JIT_GET_FN(fn, jit, "sum");
+    TEST_ASSERT(fn != NULL, "function lookup");
+    TEST_ASSERT_EQ(fn(100), 5350, "tier-0 sum(100) == 5350");
+
+    /* The recompile works from a snapshot, so the module may go while the
+       tier-up thread runs; scribble over it first so stale reads show. */
+    for (lr_arena_chunk_t *c = arena->head; c; c = c->next)
+        memset(c->data, 0xA5, c->used);
+    lr_arena_destroy(arena);
+
+    /* More modules arrive while sum is being recompiled. */
+    enum { NUM_ADDED = 64 };
+    lr_arena_t *add_arena = lr_arena_create(0);
+    TEST_ASSERT(add_arena != NULL, "arena create");
+    for (int k = 0; k < NUM_ADDED; k++) {
+        char add_src[128];
+        snprintf(add_src, sizeof(add_src),
+                 "define i32 @add%d(i32 %%x) {\n"
+                 "entry:\n"
+                 "  %%r = add i32 %%x, %d\n"
+                 "  ret i32 %%r\n"
+                 "}\n", k, k);
+        lr_module_t *add = parse(add_src, add_arena);
+        TEST_ASSERT(add != NULL, "parse added module");
+        TEST_ASSERT_EQ(lr_jit_add_module(jit, add), 0, "add module during tier-up");
+    }
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__aarch64__)
+    TEST_ASSERT(lr_jit_tierup_poll(jit, true) >= 1, "hot functions recompiled");
+#endif
+    TEST_ASSERT_EQ(fn(10), 85, "tier-1 sum(10) == 85");
+    TEST_ASSERT_EQ(fn(1000), 503500, "tier-1 sum(1000) == 503500");
+    for (int k = 0; k < NUM_ADDED; k++) {
+        char name[16];
+        snprintf(name, sizeof(name), "add%d", k);
+        fn_t add_fn; LR_JIT_GET_FN(add_fn, jit, name);
+        TEST_ASSERT(add_fn != NULL, "added function lookup");
+        TEST_ASSERT_EQ(add_fn(1), 1 + k, "added function result");
+    }
+
+    lr_jit_destroy(jit);
+    lr_arena_destroy(add_arena);
+    return 0;
+}
+
+static int64_t direct_call_host_add(int64_t a, int64_t b) {
+    return a + b;
+}
+
+/* True when the rel32 call at code[at] lands on want, directly or through
+   a "jmp [rip+2]; .quad want" stub inside code[0, len). */
+static int x86_call_reaches(const uint8_t *code, size_t len, size_t at,
+                            const void *want) {
+    static const uint8_t stub[6] = {0xFF, 0x25, 0x02, 0x00, 0x00, 0x00};
+    int32_t rel;
+    int64_t dest;
+    uint64_t addr;
+    memcpy(&rel, code + at + 1, sizeof(rel));
+    dest = (int64_t)at + 5 + rel;
+    if ((uintptr_t)code + (uintptr_t)dest == (uintptr_t)want)
+        return 1;
+    if (dest < 0 || (uint64_t)dest + 16 > len ||
+        memcmp(code + dest, stub, sizeof(stub)) != 0)
+        return 0;
+    memcpy(&addr, code + dest + 8, sizeof(addr));
+    return addr == (uint64_t)(uintptr_t)want;
+}
+
+int test_jit_direct_calls_and_stubs(void) {
+    const char *src =
+        "declare i64 @host_add(i64, i64)\n"
+        "define internal i64 @twice(i64 %x) {\n"
+        "entry:\n"
+        "  %r = add i64 %x, %x\n"
+        "  ret i64 %r\n"
+        "}\n"
+        "define i64 @f(i64 %x) {\n"
+        "entry:\n"
+        "  %a = call i64 @twice(i64 %x)\n"
+        "  %b = call i64 @host_add(i64 %a, i64 100)\n"
+        "  %c = call i64 @host_add(i64 %b, i64 %x)\n"
+        "  ret i64 %c\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *m = parse(src, arena);
+    TEST_ASSERT(m != NULL, "parse");
+
+    lr_jit_t *jit = lr_jit_create();
+    TEST_ASSERT(jit != NULL, "jit create");
+    lr_jit_add_symbol(jit, "host_add",
+                      (void *)(uintptr_t)&direct_call_host_add);
+    int rc = lr_jit_add_module(jit, m);
+    TEST_ASSERT_EQ(rc, 0, "jit add module");
+
+    typedef int64_t (*fn_t)(int64_t);
+    fn_t fn; LR_JIT_GET_FN(fn, jit, "f");
+    TEST_ASSERT(fn != NULL, "function lookup");
+    TEST_ASSERT_EQ(fn(5), 115, "f(5) = 2*5 + 100 + 5");
+
+    if (strcmp(lr_jit_target_name(jit), "x86_64") == 0 && !jit->tierup) {
+        const uint8_t *code = NULL;
+        void *twice = lr_jit_get_symbol(jit, "twice");
+        size_t start, end = jit->code_size;
+        int internal_calls = 0, host_calls = 0;
+        memcpy(&code, &fn, sizeof(code));
+        start = (size_t)(code - jit->code_buf);
+        code = jit->code_buf;
+        for (size_t i = start; i + 5 <= end; i++) {
+            if (code[i] != 0xE8)
+                continue;
+            if (twice && x86_call_reaches(code, end, i, twice))
+                internal_calls++;
+            else if (x86_call_reaches(code, end, i,
+                                      (void *)(uintptr_t)&direct_call_host_add))
+                host_calls++;
+        }
+        TEST_ASSERT_EQ(internal_calls, 1, "module-internal call is call rel32");
+        TEST_ASSERT_EQ(host_calls, 2, "host calls are call rel32 (via stub if far)");
+    }
+
+    lr_jit_destroy(jit);
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+/* A function that fills the code buffer up to code_limit still gets its
+   call stub: stubs may use the CALL_STUB_RESERVE bytes past the limit. */
+int test_jit_call_stub_reserve(void) {
+    const char *src =
+        "declare i64 @host_add(i64, i64)\n"
+        "define i64 @g(i64 %x) {\n"
+        "entry:\n"
+        "  %r = call i64 @host_add(i64 %x, i64 1)\n"
+        "  ret i64 %r\n"
+        "}\n";
+    static uint8_t probe[4096];
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *m = parse(src, arena);
+    TEST_ASSERT(m != NULL, "parse");
+
+    lr_jit_t *jit = lr_jit_create();
+    TEST_ASSERT(jit != NULL, "jit create");
+    if (jit->tierup_threshold != 0 || jit->mode != LR_COMPILE_ISEL ||
+        getenv("LIRIC_JIT_LAZY") != NULL) {
+        lr_jit_destroy(jit);
+        lr_arena_destroy(arena);
+        return 0;
+    }
+    TEST_ASSERT(jit->code_limit < jit->code_cap, "call stubs have a reserve");
+
+    lr_func_t *g = m->first_func;
+    while (g && strcmp(g->name, "g") != 0)
+        g = g->next;
+    TEST_ASSERT(g != NULL, "find g");
+    size_t len = 0;
+    int rc = lr_target_compile_ex(jit->target, jit->mode, jit->codegen_flags,
+                                  jit->cpu_features, NULL, g, m,
+                                  probe, sizeof(probe), &len, arena);
+    TEST_ASSERT_EQ(rc, 0, "probe compile");
+    TEST_ASSERT(len > 0 && len < jit->code_limit, "probe length");
+
+    /* g ends within 16 bytes of code_limit, so its stub (if host_add is
+       out of direct reach) starts at code_limit. */
+    jit->code_size = (jit->code_limit - len) & ~(size_t)15u;
+    lr_jit_add_symbol(jit, "host_add",
+                      (void *)(uintptr_t)&direct_call_host_add);
+    rc = lr_jit_add_module(jit, m);
+    TEST_ASSERT_EQ(rc, 0, "jit add module at the code limit");
+
+    typedef int64_t (*fn_t)(int64_t);
+    fn_t fn; LR_JIT_GET_FN(fn, jit, "g");
+    TEST_ASSERT(fn != NULL, "function lookup");
+    TEST_ASSERT_EQ(fn(41), 42, "g(41) calls host_add");
+    TEST_ASSERT(jit->code_size <= jit->code_limit ||
+                    jit->code_size == jit->code_limit + 16,
+                "stub sits at the start of the reserve");
+
+    lr_jit_destroy(jit);
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_jit_tail_calls(void) {
+    /* Each recursion would need a fresh frame without tail-call lowering;
+       a million levels is well past the default 8 MiB stack. */
+    const char *src =
+        "define i64 @sum(i64 %n, i64 %acc) {\n"
+        "entry:\n"
+        "  %z = icmp eq i64 %n, 0\n"
+        "  br i1 %z, label %done, label %rec\n"
+        "rec:\n"
+        "  %n1 = sub i64 %n, 1\n"
+        "  %a1 = add i64 %acc, %n\n"
+        "  %r = tail call i64 @sum(i64 %n1, i64 %a1)\n"
+        "  ret i64 %r\n"
+        "done:\n"
+        "  ret i64 %acc\n"
+        "}\n"
+        "define i64 @many(i64 %a, i64 %b, i64 %c, i64 %d, i64 %e, i64 %f,\n"
+        "                 i64 %g, i64 %h) {\n"
+        "entry:\n"
+        "  %z = icmp eq i64 %a, 0\n"
+        "  br i1 %z, label %done, label %rec\n"
+        "rec:\n"
+        "  %a1 = sub i64 %a, 1\n"
+        "  %r = tail call i64 @many(i64 %a1, i64 %b, i64 %c, i64 %d, i64 %e,\n"
+        "                           i64 %f, i64 %h, i64 %g)\n"
+        "  ret i64 %r\n"
+        "done:\n"
+        "  %g10 = mul i64 %g, 10\n"
+        "  %gh = add i64 %g10, %h\n"
+        "  %s = add i64 %gh, %f\n"
+        "  ret i64 %s\n"
+        "}\n"
+        "define void @even(ptr %o, i64 %n) {\n"
+        "entry:\n"
+        "  %z = icmp eq i64 %n, 0\n"
+        "  br i1 %z, label %done, label %rec\n"
+        "rec:\n"
+        "  %n1 = sub i64 %n, 1\n"
+        "  musttail call void @odd(ptr %o, i64 %n1)\n"
+        "  ret void\n"
+        "done:\n"
+        "  store i64 1, ptr %o\n"
+        "  ret void\n"
+        "}\n"
+        "define void @odd(ptr %o, i64 %n) {\n"
+        "entry:\n"
+        "  %z = icmp eq i64 %n, 0\n"
+        "  br i1 %z, label %done, label %rec\n"
+        "rec:\n"
+        "  %n1 = sub i64 %n, 1\n"
+        "  musttail call void @even(ptr %o, i64 %n1)\n"
+        "  ret void\n"
+        "done:\n"
+        "  store i64 0, ptr %o\n"
+        "  ret void\n"
+        "}\n"
+        "define i64 @ind(ptr %fp, i64 %n, i64 %acc) {\n"
+        "entry:\n"
+        "  %z = icmp eq i64 %n, 0\n"
+        "  br i1 %z, label %done, label %rec\n"
+        "rec:\n"
+        "  %n1 = sub i64 %n, 1\n"
+        "  %a1 = add i64 %acc, 2\n"
+        "  %r = tail call i64 %fp(ptr %fp, i64 %n1, i64 %a1)\n"
+        "  ret i64 %r\n"
+        "done:\n"
+        "  ret i64 %acc\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *m = parse(src, arena);
+    TEST_ASSERT(m != NULL, "parse");
+
+    lr_jit_t *jit = lr_jit_create();
+    TEST_ASSERT(jit != NULL, "jit create");
+    int rc = lr_jit_add_module(jit, m);
+    TEST_ASSERT_EQ(rc, 0, "jit add module");
+
+    typedef int64_t (*sum_fn_t)(int64_t, int64_t);
+    typedef int64_t (*many_fn_t)(int64_t, int64_t, int64_t, int64_t,
+                                 int64_t, int64_t, int64_t, int64_t);
+    typedef void (*parity_fn_t)(int64_t *, int64_t);
+    typedef int64_t (*ind_fn_t)(void *, int64_t, int64_t);
+    sum_fn_t sum; LR_JIT_GET_FN(sum, jit, "sum");
+    many_fn_t many; LR_JIT_GET_FN(many, jit, "many");
+    parity_fn_t even; LR_JIT_GET_FN(even, jit, "even");
+    ind_fn_t ind; LR_JIT_GET_FN(ind, jit, "ind");
+    TEST_ASSERT(sum && many && even && ind, "function lookup");
+
+    TEST_ASSERT_EQ(sum(1000000, 0), 500000500000LL, "sum(1e6) runs in constant stack");
+    TEST_ASSERT_EQ(many(1000000, 0, 0, 0, 0, 100, 1, 2), 112,
+                   "stack arguments are rewritten in the incoming area");
+    TEST_ASSERT_EQ(many(3, 0, 0, 0, 0, 100, 1, 2), 121, "odd depth swaps stack args");
+
+    int64_t parity = -1;
+    even(&parity, 1000001);
+    TEST_ASSERT_EQ(parity, 0, "musttail mutual recursion");
+    even(&parity, 1000000);
+    TEST_ASSERT_EQ(parity, 1, "musttail mutual recursion (even)");
+
+    void *ind_addr = NULL;
+    memcpy(&ind_addr, &ind, sizeof(ind_addr));
+    TEST_ASSERT_EQ(ind(ind_addr, 1000000, 1), 2000001, "indirect tail call");
+
+    lr_jit_destroy(jit);
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_jit_slot_coloring_shares_frame(void) {
+    /* %a is dead once its sum is taken, so %b and the second loop's values
+       may reuse its memory and slots; results must not change. */
+    const char *src =
+        "define i64 @phases(i64 %n) {\n"
+        "entry:\n"
+        "  %a = alloca [16 x i64]\n"
+        "  %b = alloca [16 x i64]\n"
+        "  br label %fill_a\n"
+        "fill_a:\n"
+        "  %i = phi i64 [ 0, %entry ], [ %i1, %fill_a ]\n"
+        "  %pa = getelementptr [16 x i64], ptr %a, i64 0, i64 %i\n"
+        "  %v = mul i64 %i, %n\n"
+        "  store i64 %v, ptr %pa\n"
+        "  %i1 = add i64 %i, 1\n"
+        "  %ca = icmp slt i64 %i1, 16\n"
+        "  br i1 %ca, label %fill_a, label %sum_a\n"
+        "sum_a:\n"
+        "  %j = phi i64 [ 0, %fill_a ], [ %j1, %sum_a ]\n"
+        "  %s = phi i64 [ 0, %fill_a ], [ %s1, %sum_a ]\n"
+        "  %qa = getelementptr [16 x i64], ptr %a, i64 0, i64 %j\n"
+        "  %x = load i64, ptr %qa\n"
+        "  %s1 = add i64 %s, %x\n"
+        "  %j1 = add i64 %j, 1\n"
+        "  %cs = icmp slt i64 %j1, 16\n"
+        "  br i1 %cs, label %sum_a, label %fill_b\n"
+        "fill_b:\n"
+        "  %k = phi i64 [ 0, %sum_a ], [ %k1, %fill_b ]\n"
+        "  %pb = getelementptr [16 x i64], ptr %b, i64 0, i64 %k\n"
+        "  %w = add i64 %k, %s1\n"
+        "  store i64 %w, ptr %pb\n"
+        "  %k1 = add i64 %k, 1\n"
+        "  %cb = icmp slt i64 %k1, 16\n"
+        "  br i1 %cb, label %fill_b, label %done\n"
+        "done:\n"
+        "  %p0 = getelementptr [16 x i64], ptr %b, i64 0, i64 0\n"
+        "  %p15 = getelementptr [16 x i64], ptr %b, i64 0, i64 15\n"
+        "  %b0 = load i64, ptr %p0\n"
+        "  %b15 = load i64, ptr %p15\n"
+        "  %r = add i64 %b0, %b15\n"
+        "  ret i64 %r\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *m = parse(src, arena);
+    TEST_ASSERT(m != NULL, "parse");
+
+    lr_target_slot_coloring_reset_stats();
+    lr_jit_t *jit = lr_jit_create();
+    TEST_ASSERT(jit != NULL, "jit create");
+    jit->mode = LR_COMPILE_ISEL;
+    int rc = lr_jit_add_module(jit, m);
+    TEST_ASSERT_EQ(rc, 0, "jit add module");
+
+    typedef int64_t (*fn_t)(int64_t);
+    fn_t fn; LR_JIT_GET_FN(fn, jit, "phases");
+    TEST_ASSERT(fn != NULL, "function lookup");
+    /* s1 = 120 * n; b[0] + b[15] = 2 * s1 + 15 */
+    TEST_ASSERT_EQ(fn(3), 735, "phases(3)");
+    TEST_ASSERT_EQ(fn(-2), -465, "phases(-2)");
+    if (!jit->tierup)
+        TEST_ASSERT(lr_target_slot_coloring_bytes_saved() >= 128,
+                    "second array reuses the first one's memory");
+
+    lr_jit_destroy(jit);
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_jit_fp_constant_pool(void) {
+    /* Repeated, zero, negative-zero and fmov-encodable constants in a loop
+       and in a float function; the pool shares entries by bit pattern. */
+    const char *src =
+        "define double @horner(double %x, i64 %n) {\n"
+        "entry:\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %i = phi i64 [ 0, %entry ], [ %i1, %loop ]\n"
+        "  %acc = phi double [ 0.0, %entry ], [ %a4, %loop ]\n"
+        "  %a1 = fmul double %acc, 0x3FB999999999999A\n"
+        "  %a2 = fadd double %a1, 1.25\n"
+        "  %t = fmul double %x, 0x3FB999999999999A\n"
+        "  %a3 = fadd double %a2, %t\n"
+        "  %a4 = fadd double %a3, 0.0\n"
+        "  %i1 = add i64 %i, 1\n"
+        "  %c = icmp slt i64 %i1, %n\n"
+        "  br i1 %c, label %loop, label %done\n"
+        "done:\n"
+        "  %r = fsub double 3.0e2, %a4\n"
+        "  %z = fmul double %r, -0.0\n"
+        "  %r2 = fadd double %r, %z\n"
+        "  ret double %r2\n"
+        "}\n"
+        "define float @scale(float %x) {\n"
+        "  %a = fmul float %x, 0x3FB99999A0000000\n"
+        "  %b = fadd float %a, 2.5\n"
+        "  %c = fdiv float %b, 0x3FB99999A0000000\n"
+        "  ret float %c\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *m = parse(src, arena);
+    TEST_ASSERT(m != NULL, "parse");
+
+    lr_target_const_pool_reset_stats();
+    lr_jit_t *jit = lr_jit_create();
+    TEST_ASSERT(jit != NULL, "jit create");
+    int rc = lr_jit_add_module(jit, m);
+    TEST_ASSERT_EQ(rc, 0, "jit add module");
+
+    typedef double (*horner_t)(double, int64_t);
+    typedef float (*scale_t)(float);
+    horner_t horner; LR_JIT_GET_FN(horner, jit, "horner");
+    scale_t scale; LR_JIT_GET_FN(scale, jit, "scale");
+    TEST_ASSERT(horner != NULL && scale != NULL, "function lookup");
+
+    double acc = 0.0;
+    for (int i = 0; i < 20; i++)
+        acc = acc * 0.1 + 1.25 + 2.0 * 0.1 + 0.0;
+    double want = 300.0 - acc;
+    want = want + want * -0.0;
+    TEST_ASSERT(horner(2.0, 20) == want, "horner(2.0, 20)");
+    TEST_ASSERT(horner(-1.5, 1) == 300.0 - (1.25 + -1.5 * 0.1),
+                "horner(-1.5, 1)");
+    float fw = (4.0f * 0.1f + 2.5f) / 0.1f;
+    TEST_ASSERT(scale(4.0f) == fw, "scale(4.0f)");
+    if (!jit->tierup && lr_target_const_pool_loads() > 0)
+        TEST_ASSERT(lr_target_const_pool_entries() <
+                        lr_target_const_pool_loads(),
+                    "repeated constants share pool entries");
+
+    lr_jit_destroy(jit);
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_jit_phi_swap_cycles(void) {
+    /* Both loop edges permute the loop-carried values: a swap, a
+       three-way rotation, an unchanged value and a copy out of the swap. */
+    const char *src =
+        "define i64 @perm(i64 %n) {\n"
+        "entry:\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %i = phi i64 [ 0, %entry ], [ %i1, %odd ], [ %i1, %even ]\n"
+        "  %x = phi i64 [ 1, %entry ], [ %y, %odd ], [ %x, %even ]\n"
+        "  %y = phi i64 [ 2, %entry ], [ %x, %odd ], [ %z, %even ]\n"
+        "  %z = phi i64 [ 3, %entry ], [ %z, %odd ], [ %w, %even ]\n"
+        "  %w = phi i64 [ 4, %entry ], [ %x, %odd ], [ %y, %even ]\n"
+        "  %i1 = add i64 %i, 1\n"
+        "  %b = and i64 %i, 1\n"
+        "  %c = icmp eq i64 %b, 0\n"
+        "  %more = icmp slt i64 %i1, %n\n"
+        "  br i1 %c, label %even, label %odd\n"
+        "even:\n"
+        "  br i1 %more, label %loop, label %done\n"
+        "odd:\n"
+        "  br i1 %more, label %loop, label %done\n"
+        "done:\n"
+        "  %x1 = mul i64 %x, 1000\n"
+        "  %y1 = mul i64 %y, 100\n"
+        "  %z1 = mul i64 %z, 10\n"
+        "  %s1 = add i64 %x1, %y1\n"
+        "  %s2 = add i64 %s1, %z1\n"
+        "  %s3 = add i64 %s2, %w\n"
+        "  ret i64 %s3\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *m = parse(src, arena);
+    TEST_ASSERT(m != NULL, "parse");
+
+    lr_jit_t *jit = lr_jit_create();
+    TEST_ASSERT(jit != NULL, "jit create");
+    int rc = lr_jit_add_module(jit, m);
+    TEST_ASSERT_EQ(rc, 0, "jit add module");
+
+    typedef int64_t (*perm_t)(int64_t);
+    perm_t perm; LR_JIT_GET_FN(perm, jit, "perm");
+    TEST_ASSERT(perm != NULL, "function lookup");
+
+    for (int64_t n = 1; n <= 9; n++) {
+        int64_t x = 1, y = 2, z = 3, w = 4;
+        for (int64_t i = 0; i < n; i++) {
+            int64_t nx, ny, nz, nw;
+            if (i + 1 >= n)
+                break;
+            if ((i & 1) == 0) {
+                nx = x; ny = z; nz = w; nw = y;
+            } else {
+                nx = y; ny = x; nz = z; nw = x;
+            }
+            x = nx; y = ny; z = nz; w = nw;
+        }
+        TEST_ASSERT_EQ(perm(n), x * 1000 + y * 100 + z * 10 + w,
+                       "permuted loop values");
+    }
+
+    lr_jit_destroy(jit);
+    lr_arena_destroy(arena);
+    return 0;
+}
+
 int test_jit_alloca_load_store(void) {
     const char *src =
         "define i32 @swap_add(i32 %a, i32 %b) {\n"
@@ -2611,15 +3456,150 @@ int test_jit_llvm_intrinsic_memcpy_memset(void) {
     TEST_ASSERT(m != NULL, "parse");
 
     lr_jit_t *jit = lr_jit_create();
-    TEST_ASSERT(jit != NULL, "jit create");
-
+    TEST_ASSERT(jit != NULL, "jit create");
+
+    int rc = lr_jit_add_module(jit, m);
+    TEST_ASSERT_EQ(rc, 0, "jit add module");
+
+    typedef int (*fn_t)(void);
+    fn_t fn; LR_JIT_GET_FN(fn, jit, "copy_fill");
+    TEST_ASSERT(fn != NULL, "function lookup");
+    TEST_ASSERT_EQ(fn(), 65, "memset/memcpy wrappers set byte to 'A'");
+
+    lr_jit_destroy(jit);
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_jit_mem_intrinsics_inline(void) {
+    const char *src =
+        "declare void @llvm.memcpy.p0.p0.i64(ptr, ptr, i64, i1)\n"
+        "declare void @llvm.memset.p0.i64(ptr, i8, i64, i1)\n"
+        "define void @fill(ptr %d, ptr %s, i8 %v) {\n"
+        "entry:\n"
+        "  %d1 = getelementptr i8, ptr %d, i64 1\n"
+        "  %s3 = getelementptr i8, ptr %s, i64 3\n"
+        "  call void @llvm.memcpy.p0.p0.i64(ptr %d1, ptr %s3, i64 37, i1 false)\n"
+        "  %d40 = getelementptr i8, ptr %d, i64 40\n"
+        "  call void @llvm.memset.p0.i64(ptr %d40, i8 %v, i64 21, i1 false)\n"
+        "  %d61 = getelementptr i8, ptr %d, i64 61\n"
+        "  call void @llvm.memset.p0.i64(ptr %d61, i8 -86, i64 7, i1 false)\n"
+        "  %d70 = getelementptr i8, ptr %d, i64 70\n"
+        "  call void @llvm.memcpy.p0.p0.i64(ptr %d70, ptr %s, i64 5000, i1 false)\n"
+        "  %d6000 = getelementptr i8, ptr %d, i64 6000\n"
+        "  call void @llvm.memcpy.p0.p0.i64(ptr %d6000, ptr %s, i64 0, i1 false)\n"
+        "  ret void\n"
+        "}\n";
+    static uint8_t dst[6001];
+    static uint8_t srcbuf[5000];
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *m = parse(src, arena);
+    TEST_ASSERT(m != NULL, "parse");
+
+    lr_jit_t *jit = lr_jit_create();
+    int rc = lr_jit_add_module(jit, m);
+    TEST_ASSERT_EQ(rc, 0, "jit add module");
+
+    typedef void (*fn_t)(uint8_t *, const uint8_t *, uint8_t);
+    fn_t fn; LR_JIT_GET_FN(fn, jit, "fill");
+    TEST_ASSERT(fn != NULL, "function lookup");
+
+    for (size_t i = 0; i < sizeof(srcbuf); i++)
+        srcbuf[i] = (uint8_t)(i * 7 + 3);
+    memset(dst, 0x11, sizeof(dst));
+    fn(dst, srcbuf, 0x5a);
+
+    TEST_ASSERT_EQ(dst[0], 0x11, "byte before memcpy untouched");
+    TEST_ASSERT(memcmp(dst + 1, srcbuf + 3, 37) == 0, "37-byte memcpy");
+    TEST_ASSERT_EQ(dst[38], 0x11, "byte after memcpy untouched");
+    for (size_t i = 40; i < 61; i++)
+        TEST_ASSERT_EQ(dst[i], 0x5a, "variable-byte memset");
+    for (size_t i = 61; i < 68; i++)
+        TEST_ASSERT_EQ(dst[i], 0xaa, "constant-byte memset");
+    TEST_ASSERT_EQ(dst[68], 0x11, "byte after memset untouched");
+    TEST_ASSERT(memcmp(dst + 70, srcbuf, 5000) == 0, "large memcpy calls out");
+    TEST_ASSERT_EQ(dst[6000], 0x11, "zero-length memcpy");
+
+    lr_jit_destroy(jit);
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_jit_vector_ops(void) {
+    const char *src =
+        "define internal <8 x i32> @madd(<8 x i32> %a, <8 x i32> %b) {\n"
+        "entry:\n"
+        "  %m = mul <8 x i32> %a, %b\n"
+        "  %r = add <8 x i32> %m, <i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7, i32 8>\n"
+        "  ret <8 x i32> %r\n"
+        "}\n"
+        "define void @vec(ptr %a, ptr %b, ptr %o, i32 %k) {\n"
+        "entry:\n"
+        "  %x = load <8 x i32>, ptr %a, align 4\n"
+        "  %y = load <8 x i32>, ptr %b, align 4\n"
+        "  %m = call <8 x i32> @madd(<8 x i32> %x, <8 x i32> %y)\n"
+        "  store <8 x i32> %m, ptr %o, align 4\n"
+        "  %c = icmp sgt <8 x i32> %x, %y\n"
+        "  %s = select <8 x i1> %c, <8 x i32> %x, <8 x i32> %y\n"
+        "  %sh = ashr <8 x i32> %s, <i32 1, i32 1, i32 1, i32 1, i32 2, i32 2, i32 2, i32 2>\n"
+        "  %o1 = getelementptr i32, ptr %o, i64 8\n"
+        "  store <8 x i32> %sh, ptr %o1, align 4\n"
+        "  %e = extractelement <8 x i32> %x, i32 %k\n"
+        "  %n = insertelement <8 x i32> %y, i32 %e, i32 0\n"
+        "  %r = shufflevector <8 x i32> %n, <8 x i32> %x, "
+        "<4 x i32> <i32 0, i32 9, i32 7, i32 15>\n"
+        "  %o2 = getelementptr i32, ptr %o, i64 16\n"
+        "  store <4 x i32> %r, ptr %o2, align 4\n"
+        "  %f = sitofp <8 x i32> %x to <8 x float>\n"
+        "  %g = fmul <8 x float> %f, <float 0.5, float 0.5, float 0.5, float 0.5, "
+        "float 0.5, float 0.5, float 0.5, float 0.5>\n"
+        "  %fc = fcmp olt <8 x float> %g, zeroinitializer\n"
+        "  %z = zext <8 x i1> %fc to <8 x i32>\n"
+        "  %o3 = getelementptr i32, ptr %o, i64 20\n"
+        "  store <8 x i32> %z, ptr %o3, align 4\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %i = phi i32 [ 0, %entry ], [ %i1, %loop ]\n"
+        "  %acc = phi <4 x i32> [ <i32 100, i32 200, i32 300, i32 400>, %entry ], [ %acc1, %loop ]\n"
+        "  %acc1 = sub <4 x i32> %acc, <i32 1, i32 2, i32 3, i32 4>\n"
+        "  %i1 = add i32 %i, 1\n"
+        "  %done = icmp eq i32 %i1, 10\n"
+        "  br i1 %done, label %exit, label %loop\n"
+        "exit:\n"
+        "  %o4 = getelementptr i32, ptr %o, i64 28\n"
+        "  store <4 x i32> %acc1, ptr %o4, align 4\n"
+        "  ret void\n"
+        "}\n";
+    int32_t a[8] = {3, -4, 5, -6, 7, -8, 9, -10};
+    int32_t b[8] = {2, 2, -2, -2, 11, 11, -11, -11};
+    int32_t out[32];
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *m = parse(src, arena);
+    TEST_ASSERT(m != NULL, "parse");
+
+    lr_jit_t *jit = lr_jit_create();
     int rc = lr_jit_add_module(jit, m);
     TEST_ASSERT_EQ(rc, 0, "jit add module");
 
-    typedef int (*fn_t)(void);
-    fn_t fn; LR_JIT_GET_FN(fn, jit, "copy_fill");
+    typedef void (*fn_t)(const int32_t *, const int32_t *, int32_t *, int32_t);
+    fn_t fn; LR_JIT_GET_FN(fn, jit, "vec");
     TEST_ASSERT(fn != NULL, "function lookup");
-    TEST_ASSERT_EQ(fn(), 65, "memset/memcpy wrappers set byte to 'A'");
+
+    memset(out, 0, sizeof(out));
+    fn(a, b, out, 5);
+    for (int i = 0; i < 8; i++) {
+        int32_t s = a[i] > b[i] ? a[i] : b[i];
+        TEST_ASSERT_EQ(out[i], a[i] * b[i] + i + 1, "wide vector call mul/add");
+        TEST_ASSERT_EQ(out[8 + i], s >> (i < 4 ? 1 : 2), "select + ashr");
+        TEST_ASSERT_EQ(out[20 + i], a[i] < 0, "sitofp/fmul/fcmp lanes");
+    }
+    TEST_ASSERT_EQ(out[16], a[5], "variable extract feeds insert");
+    TEST_ASSERT_EQ(out[17], a[1], "shuffle picks second operand");
+    TEST_ASSERT_EQ(out[18], b[7], "shuffle picks first operand");
+    TEST_ASSERT_EQ(out[19], a[7], "shuffle last lane");
+    for (int i = 0; i < 4; i++)
+        TEST_ASSERT_EQ(out[28 + i], (i + 1) * 100 - 10 * (i + 1),
+                       "constant vector phi incoming");
 
     lr_jit_destroy(jit);
     lr_arena_destroy(arena);
@@ -3611,3 +4591,860 @@ int test_jit_late_frame_patch_and_phi_slots(void) {
     lr_arena_destroy(arena);
     return 0;
 }
+
+int test_jit_regalloc_loop_calls_and_phi_swap(void) {
+    const char *src =
+        "define i64 @mix(i64 %x) {\n"
+        "entry:\n"
+        "  %a = mul i64 %x, 3\n"
+        "  %b = add i64 %a, 1\n"
+        "  %c = mul i64 %b, %x\n"
+        "  %d = sub i64 %c, %a\n"
+        "  %e = xor i64 %d, %b\n"
+        "  %f = add i64 %e, %c\n"
+        "  ret i64 %f\n"
+        "}\n"
+        "define i64 @sum(i64 %n) {\n"
+        "entry:\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %i = phi i64 [ 0, %entry ], [ %i1, %loop ]\n"
+        "  %s = phi i64 [ 0, %entry ], [ %s1, %loop ]\n"
+        "  %k = call i64 @mix(i64 %i)\n"
+        "  %t = add i64 %s, %k\n"
+        "  %s1 = add i64 %t, %i\n"
+        "  %i1 = add i64 %i, 1\n"
+        "  %c = icmp slt i64 %i1, %n\n"
+        "  br i1 %c, label %loop, label %done\n"
+        "done:\n"
+        "  ret i64 %s1\n"
+        "}\n"
+        "define i64 @swap(i64 %n) {\n"
+        "entry:\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %i = phi i64 [ 0, %entry ], [ %i1, %loop ]\n"
+        "  %a = phi i64 [ 1, %entry ], [ %b, %loop ]\n"
+        "  %b = phi i64 [ 2, %entry ], [ %a, %loop ]\n"
+        "  %i1 = add i64 %i, 1\n"
+        "  %c = icmp slt i64 %i1, %n\n"
+        "  br i1 %c, label %loop, label %done\n"
+        "done:\n"
+        "  %hi = mul i64 %a, 10\n"
+        "  %r = add i64 %hi, %b\n"
+        "  ret i64 %r\n"
+        "}\n";
+    int64_t expect_sum = 0;
+    for (int64_t i = 0; i < 20; i++) {
+        int64_t a = i * 3, b = a + 1, c = b * i, d = c - a;
+        expect_sum += ((d ^ b) + c) + i;
+    }
+
+    for (int pass = 0; pass < 2; pass++) {
+        lr_arena_t *arena = lr_arena_create(0);
+        lr_module_t *m = parse(src, arena);
+        TEST_ASSERT(m != NULL, "parse");
+
+        lr_jit_t *jit = lr_jit_create();
+        TEST_ASSERT(jit != NULL, "jit create");
+        jit->mode = LR_COMPILE_ISEL;
+        jit->codegen_flags = pass ? LR_CODEGEN_REGALLOC : 0u;
+        int rc = lr_jit_add_module(jit, m);
+        TEST_ASSERT_EQ(rc, 0, "jit add module");
+
+        typedef int64_t (*fn_t)(int64_t);
+        fn_t sum; LR_JIT_GET_FN(sum, jit, "sum");
+        fn_t swap; LR_JIT_GET_FN(swap, jit, "swap");
+        TEST_ASSERT(sum != NULL && swap != NULL, "function lookup");
+
+        TEST_ASSERT_EQ(sum(20), expect_sum, "loop keeps values live across calls");
+        TEST_ASSERT_EQ(swap(1), 12, "swap after one iteration");
+        TEST_ASSERT_EQ(swap(2), 21, "phi swap is a parallel copy");
+        TEST_ASSERT_EQ(swap(7), 12, "phi swap after odd iterations");
+
+        lr_jit_destroy(jit);
+        lr_arena_destroy(arena);
+    }
+    return 0;
+}
+
+int test_jit_fast_cc_internal_calls(void) {
+    /* @mix runs out of GP registers and @fps out of FP registers; @taken
+       has its address stored and must keep the platform convention. */
+    const char *src =
+        "define internal double @mix(i64 %a0, double %d0, i64 %a1, double %d1, i64 %a2, double %d2, i64 %a3, double %d3, i64 %a4, double %d4, i64 %a5, double %d5, i64 %a6, double %d6, i64 %a7, double %d7, float %f) {\n"
+        "entry:\n"
+        "  %ca0 = sitofp i64 %a0 to double\n"
+        "  %ma0 = fmul double %ca0, 1.0\n"
+        "  %sa0 = fadd double 0.0, %ma0\n"
+        "  %md0 = fmul double %d0, 2.0\n"
+        "  %sd0 = fadd double %sa0, %md0\n"
+        "  %ca1 = sitofp i64 %a1 to double\n"
+        "  %ma1 = fmul double %ca1, 3.0\n"
+        "  %sa1 = fadd double %sd0, %ma1\n"
+        "  %md1 = fmul double %d1, 4.0\n"
+        "  %sd1 = fadd double %sa1, %md1\n"
+        "  %ca2 = sitofp i64 %a2 to double\n"
+        "  %ma2 = fmul double %ca2, 5.0\n"
+        "  %sa2 = fadd double %sd1, %ma2\n"
+        "  %md2 = fmul double %d2, 6.0\n"
+        "  %sd2 = fadd double %sa2, %md2\n"
+        "  %ca3 = sitofp i64 %a3 to double\n"
+        "  %ma3 = fmul double %ca3, 7.0\n"
+        "  %sa3 = fadd double %sd2, %ma3\n"
+        "  %md3 = fmul double %d3, 8.0\n"
+        "  %sd3 = fadd double %sa3, %md3\n"
+        "  %ca4 = sitofp i64 %a4 to double\n"
+        "  %ma4 = fmul double %ca4, 9.0\n"
+        "  %sa4 = fadd double %sd3, %ma4\n"
+        "  %md4 = fmul double %d4, 10.0\n"
+        "  %sd4 = fadd double %sa4, %md4\n"
+        "  %ca5 = sitofp i64 %a5 to double\n"
+        "  %ma5 = fmul double %ca5, 11.0\n"
+        "  %sa5 = fadd double %sd4, %ma5\n"
+        "  %md5 = fmul double %d5, 12.0\n"
+        "  %sd5 = fadd double %sa5, %md5\n"
+        "  %ca6 = sitofp i64 %a6 to double\n"
+        "  %ma6 = fmul double %ca6, 13.0\n"
+        "  %sa6 = fadd double %sd5, %ma6\n"
+        "  %md6 = fmul double %d6, 14.0\n"
+        "  %sd6 = fadd double %sa6, %md6\n"
+        "  %ca7 = sitofp i64 %a7 to double\n"
+        "  %ma7 = fmul double %ca7, 15.0\n"
+        "  %sa7 = fadd double %sd6, %ma7\n"
+        "  %md7 = fmul double %d7, 16.0\n"
+        "  %sd7 = fadd double %sa7, %md7\n"
+        "  %cf = fpext float %f to double\n"
+        "  %mf = fmul double %cf, 17.0\n"
+        "  %sf = fadd double %sd7, %mf\n"
+        "  ret double %sf\n"
+        "}\n"
+        "define internal double @fps(double %x0, double %x1, double %x2, double %x3, double %x4, double %x5, double %x6, double %x7, double %x8, double %x9, double %x10, double %x11, i32 %n) {\n"
+        "entry:\n"
+        "  %mx0 = fmul double %x0, 1.0\n"
+        "  %sx0 = fadd double 0.0, %mx0\n"
+        "  %mx1 = fmul double %x1, 2.0\n"
+        "  %sx1 = fadd double %sx0, %mx1\n"
+        "  %mx2 = fmul double %x2, 3.0\n"
+        "  %sx2 = fadd double %sx1, %mx2\n"
+        "  %mx3 = fmul double %x3, 4.0\n"
+        "  %sx3 = fadd double %sx2, %mx3\n"
+        "  %mx4 = fmul double %x4, 5.0\n"
+        "  %sx4 = fadd double %sx3, %mx4\n"
+        "  %mx5 = fmul double %x5, 6.0\n"
+        "  %sx5 = fadd double %sx4, %mx5\n"
+        "  %mx6 = fmul double %x6, 7.0\n"
+        "  %sx6 = fadd double %sx5, %mx6\n"
+        "  %mx7 = fmul double %x7, 8.0\n"
+        "  %sx7 = fadd double %sx6, %mx7\n"
+        "  %mx8 = fmul double %x8, 9.0\n"
+        "  %sx8 = fadd double %sx7, %mx8\n"
+        "  %mx9 = fmul double %x9, 10.0\n"
+        "  %sx9 = fadd double %sx8, %mx9\n"
+        "  %mx10 = fmul double %x10, 11.0\n"
+        "  %sx10 = fadd double %sx9, %mx10\n"
+        "  %mx11 = fmul double %x11, 12.0\n"
+        "  %sx11 = fadd double %sx10, %mx11\n"
+        "  %cn = sitofp i32 %n to double\n"
+        "  %mn = fmul double %cn, 13.0\n"
+        "  %sn = fadd double %sx11, %mn\n"
+        "  ret double %sn\n"
+        "}\n"
+        "define internal double @taken(i64 %x) {\n"
+        "entry:\n"
+        "  %c = sitofp i64 %x to double\n"
+        "  ret double %c\n"
+        "}\n"
+        "@slot = global ptr @taken\n"
+        "define double @drive(i64 %k, double %y) {\n"
+        "entry:\n"
+        "  %ia0 = add i64 %k, 0\n"
+        "  %ya1 = fadd double %y, 1.0\n"
+        "  %ia2 = add i64 %k, 2\n"
+        "  %ya3 = fadd double %y, 3.0\n"
+        "  %ia4 = add i64 %k, 4\n"
+        "  %ya5 = fadd double %y, 5.0\n"
+        "  %ia6 = add i64 %k, 6\n"
+        "  %ya7 = fadd double %y, 7.0\n"
+        "  %ia8 = add i64 %k, 8\n"
+        "  %ya9 = fadd double %y, 9.0\n"
+        "  %ia10 = add i64 %k, 10\n"
+        "  %ya11 = fadd double %y, 11.0\n"
+        "  %ia12 = add i64 %k, 12\n"
+        "  %ya13 = fadd double %y, 13.0\n"
+        "  %ia14 = add i64 %k, 14\n"
+        "  %ya15 = fadd double %y, 15.0\n"
+        "  %fa = fptrunc double %y to float\n"
+        "  %r1 = call double @mix(i64 %ia0, double %ya1, i64 %ia2, double %ya3, i64 %ia4, double %ya5, i64 %ia6, double %ya7, i64 %ia8, double %ya9, i64 %ia10, double %ya11, i64 %ia12, double %ya13, i64 %ia14, double %ya15, float %fa)\n"
+        "  %ya17 = fadd double %y, 17.0\n"
+        "  %r2 = call double @fps(double %ya1, double %ya3, double %ya5, double %ya7, double %ya9, double %ya11, double %ya13, double %ya15, double %ya17, double 0.25, double %y, double -2.0, i32 7)\n"
+        "  %fp = load ptr, ptr @slot\n"
+        "  %r3 = call double %fp(i64 %k)\n"
+        "  %t1 = fadd double %r1, %r2\n"
+        "  %t2 = fadd double %t1, %r3\n"
+        "  ret double %t2\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *m = parse(src, arena);
+    TEST_ASSERT(m != NULL, "parse");
+
+    lr_jit_t *jit = lr_jit_create();
+    TEST_ASSERT(jit != NULL, "jit create");
+    int rc = lr_jit_add_module(jit, m);
+    TEST_ASSERT_EQ(rc, 0, "jit add module");
+
+    lr_func_t *mix = lr_module_lookup_function(m, "mix");
+    lr_func_t *taken = lr_module_lookup_function(m, "taken");
+    lr_func_t *drive_fn = lr_module_lookup_function(m, "drive");
+    TEST_ASSERT(mix && taken && drive_fn, "functions present");
+    if (getenv("LIRIC_FAST_CC") == NULL) {
+        TEST_ASSERT(mix->fast_cc, "internal callee uses fast convention");
+    }
+    TEST_ASSERT(!taken->fast_cc, "address-taken function keeps ABI");
+    TEST_ASSERT(!drive_fn->fast_cc, "exported function keeps ABI");
+
+    typedef double (*drive_t)(int64_t, double);
+    drive_t drive; LR_JIT_GET_FN(drive, jit, "drive");
+    TEST_ASSERT(drive != NULL, "function lookup");
+
+    for (int64_t k = -3; k <= 3; k += 3) {
+        double y = 0.5 * (double)k + 0.25;
+        double ya[18], r1 = 0.0, r2 = 0.0;
+        for (int i = 0; i < 18; i++)
+            ya[i] = y + (double)i;
+        for (int i = 0; i < 16; i++)
+            r1 += (i & 1) ? ya[i] * (double)(i + 1)
+                          : (double)(k + i) * (double)(i + 1);
+        r1 += (double)(float)y * 17.0;
+        for (int i = 0; i < 9; i++)
+            r2 += ya[2 * i + 1] * (double)(i + 1);
+        r2 += 0.25 * 10.0;
+        r2 += y * 11.0;
+        r2 += -2.0 * 12.0;
+        r2 += 7.0 * 13.0;
+        double want = r1 + r2 + (double)k;
+        double got = drive(k, y);
+        TEST_ASSERT(got == want, "fast convention arguments");
+    }
+
+    lr_jit_destroy(jit);
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_jit_cold_blocks_moved_out_of_loop(void) {
+    /* The error paths sit between the loop blocks in source order and are
+       emitted after them; the loop must still branch around them. */
+    const char *src =
+        "declare void @abort()\n"
+        "define i64 @sum(ptr %a, i64 %n) {\n"
+        "entry:\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %i = phi i64 [ 0, %entry ], [ %i1, %next ]\n"
+        "  %acc = phi i64 [ 0, %entry ], [ %acc1, %next ]\n"
+        "  %pa = getelementptr i64, ptr %a, i64 %i\n"
+        "  %v = load i64, ptr %pa\n"
+        "  %neg = icmp slt i64 %v, 0\n"
+        "  br i1 %neg, label %fail, label %ok\n"
+        "fail:\n"
+        "  call void @abort()\n"
+        "  unreachable\n"
+        "ok:\n"
+        "  %big = icmp sgt i64 %v, 1000\n"
+        "  br i1 %big, label %dead, label %next\n"
+        "dead:\n"
+        "  unreachable\n"
+        "next:\n"
+        "  %acc1 = add i64 %acc, %v\n"
+        "  %i1 = add i64 %i, 1\n"
+        "  %more = icmp slt i64 %i1, %n\n"
+        "  br i1 %more, label %loop, label %done\n"
+        "done:\n"
+        "  ret i64 %acc1\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *m = parse(src, arena);
+    TEST_ASSERT(m != NULL, "parse");
+
+    lr_jit_t *jit = lr_jit_create();
+    TEST_ASSERT(jit != NULL, "jit create");
+    int rc = lr_jit_add_module(jit, m);
+    TEST_ASSERT_EQ(rc, 0, "jit add module");
+
+    typedef int64_t (*sum_t)(const int64_t *, int64_t);
+    sum_t sum; LR_JIT_GET_FN(sum, jit, "sum");
+    TEST_ASSERT(sum != NULL, "function lookup");
+
+    int64_t vals[6] = {3, 1, 4, 1, 5, 9};
+    TEST_ASSERT_EQ(sum(vals, 6), 23, "loop over hot blocks");
+    TEST_ASSERT_EQ(sum(vals, 1), 3, "single trip");
+
+    lr_jit_destroy(jit);
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_jit_promoted_allocas(void) {
+    /* Frontend-style locals: the swap of a and b becomes a pair of phis
+       that must be copied in parallel on the back edge. */
+    const char *src =
+        "define i64 @fib(i64 %n) {\n"
+        "entry:\n"
+        "  %a = alloca i64\n"
+        "  %b = alloca i64\n"
+        "  %k = alloca i32\n"
+        "  %w = alloca double\n"
+        "  store i64 0, ptr %a\n"
+        "  store i64 1, ptr %b\n"
+        "  store i32 0, ptr %k\n"
+        "  store double 0.0, ptr %w\n"
+        "  br label %head\n"
+        "head:\n"
+        "  %kv = load i32, ptr %k\n"
+        "  %kw = sext i32 %kv to i64\n"
+        "  %more = icmp slt i64 %kw, %n\n"
+        "  br i1 %more, label %body, label %done\n"
+        "body:\n"
+        "  %av = load i64, ptr %a\n"
+        "  %bv = load i64, ptr %b\n"
+        "  %sum = add i64 %av, %bv\n"
+        "  store i64 %bv, ptr %a\n"
+        "  store i64 %sum, ptr %b\n"
+        "  %odd = and i32 %kv, 1\n"
+        "  %isodd = icmp ne i32 %odd, 0\n"
+        "  br i1 %isodd, label %bump, label %latch\n"
+        "bump:\n"
+        "  %wv = load double, ptr %w\n"
+        "  %w1 = fadd double %wv, 0.5\n"
+        "  store double %w1, ptr %w\n"
+        "  br label %latch\n"
+        "latch:\n"
+        "  %k1 = add i32 %kv, 1\n"
+        "  store i32 %k1, ptr %k\n"
+        "  br label %head\n"
+        "done:\n"
+        "  %r = load i64, ptr %a\n"
+        "  %wf = load double, ptr %w\n"
+        "  %wi = fptosi double %wf to i64\n"
+        "  %r1 = mul i64 %r, 100\n"
+        "  %r2 = add i64 %r1, %wi\n"
+        "  ret i64 %r2\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *m = parse(src, arena);
+    TEST_ASSERT(m != NULL, "parse");
+
+    lr_jit_t *jit = lr_jit_create();
+    TEST_ASSERT(jit != NULL, "jit create");
+    int rc = lr_jit_add_module(jit, m);
+    TEST_ASSERT_EQ(rc, 0, "jit add module");
+
+    typedef int64_t (*fib_t)(int64_t);
+    fib_t fib; LR_JIT_GET_FN(fib, jit, "fib");
+    TEST_ASSERT(fib != NULL, "function lookup");
+
+    TEST_ASSERT_EQ(fib(0), 0, "no iterations");
+    TEST_ASSERT_EQ(fib(1), 100, "fib(1)");
+    TEST_ASSERT_EQ(fib(10), 5502, "fib(10) with five odd bumps");
+    TEST_ASSERT_EQ(fib(20), 676505, "fib(20) with ten odd bumps");
+
+    lr_jit_destroy(jit);
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_jit_value_numbered_addresses(void) {
+    /* Row-major a[i][j] recomputed in each arm of the branch, as array
+       code does; the arms reuse the address from the loop header. */
+    const char *src =
+        "define i64 @rowsum(ptr %a, i64 %rows, i64 %cols, i64 %j) {\n"
+        "entry:\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %i = phi i64 [ 0, %entry ], [ %i1, %latch ]\n"
+        "  %acc = phi i64 [ 0, %entry ], [ %acc1, %latch ]\n"
+        "  %row = mul i64 %i, %cols\n"
+        "  %idx = add i64 %row, %j\n"
+        "  %p = getelementptr i64, ptr %a, i64 %idx\n"
+        "  %v = load i64, ptr %p\n"
+        "  %neg = icmp slt i64 %v, 0\n"
+        "  br i1 %neg, label %flip, label %keep\n"
+        "flip:\n"
+        "  %row2 = mul i64 %cols, %i\n"
+        "  %idx2 = add i64 %j, %row2\n"
+        "  %p2 = getelementptr i64, ptr %a, i64 %idx2\n"
+        "  %nv = sub i64 0, %v\n"
+        "  store i64 %nv, ptr %p2\n"
+        "  br label %latch\n"
+        "keep:\n"
+        "  %row3 = mul i64 %i, %cols\n"
+        "  %idx3 = add i64 %row3, %j\n"
+        "  %p3 = getelementptr i64, ptr %a, i64 %idx3\n"
+        "  %w = load i64, ptr %p3\n"
+        "  br label %latch\n"
+        "latch:\n"
+        "  %x = phi i64 [ %nv, %flip ], [ %w, %keep ]\n"
+        "  %acc1 = add i64 %acc, %x\n"
+        "  %i1 = add i64 %i, 1\n"
+        "  %more = icmp slt i64 %i1, %rows\n"
+        "  br i1 %more, label %loop, label %done\n"
+        "done:\n"
+        "  ret i64 %acc1\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *m = parse(src, arena);
+    TEST_ASSERT(m != NULL, "parse");
+
+    lr_jit_t *jit = lr_jit_create();
+    TEST_ASSERT(jit != NULL, "jit create");
+    int rc = lr_jit_add_module(jit, m);
+    TEST_ASSERT_EQ(rc, 0, "jit add module");
+
+    typedef int64_t (*rowsum_t)(int64_t *, int64_t, int64_t, int64_t);
+    rowsum_t rowsum; LR_JIT_GET_FN(rowsum, jit, "rowsum");
+    TEST_ASSERT(rowsum != NULL, "function lookup");
+
+    int64_t a[3][4] = {
+        {  1, -2,  3,  4 },
+        {  5,  6, -7,  8 },
+        { -9, 10, 11, 12 },
+    };
+    TEST_ASSERT_EQ(rowsum(&a[0][0], 3, 4, 1), 18, "column 1");
+    TEST_ASSERT_EQ(a[0][1], 2, "negative entry flipped in place");
+    TEST_ASSERT_EQ(rowsum(&a[0][0], 3, 4, 2), 21, "column 2");
+    TEST_ASSERT_EQ(a[1][2], 7, "negative entry flipped in place");
+    TEST_ASSERT_EQ(rowsum(&a[0][0], 3, 4, 0), 15, "column 0");
+
+    lr_jit_destroy(jit);
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_jit_regalloc_loop_weighted_spills(void) {
+    /* c0..c7 are live across the loop nest but only read after it; the
+       inner-loop values outweigh them for the nine allocatable
+       registers. */
+    const char *src =
+        "define i64 @nest(i64 %n) {\n"
+        "entry:\n"
+        "  %c0 = mul i64 %n, 3\n"
+        "  %c1 = mul i64 %n, 5\n"
+        "  %c2 = mul i64 %n, 7\n"
+        "  %c3 = mul i64 %n, 11\n"
+        "  %c4 = mul i64 %n, 13\n"
+        "  %c5 = mul i64 %n, 17\n"
+        "  %c6 = mul i64 %n, 19\n"
+        "  %c7 = mul i64 %n, 23\n"
+        "  br label %outer\n"
+        "outer:\n"
+        "  %i = phi i64 [ 0, %entry ], [ %i1, %olatch ]\n"
+        "  %acc = phi i64 [ 0, %entry ], [ %acc2, %olatch ]\n"
+        "  br label %inner\n"
+        "inner:\n"
+        "  %j = phi i64 [ 0, %outer ], [ %j1, %inner ]\n"
+        "  %a = phi i64 [ %acc, %outer ], [ %a1, %inner ]\n"
+        "  %ij = mul i64 %i, %j\n"
+        "  %t = add i64 %ij, %j\n"
+        "  %a1 = add i64 %a, %t\n"
+        "  %j1 = add i64 %j, 1\n"
+        "  %jc = icmp slt i64 %j1, %n\n"
+        "  br i1 %jc, label %inner, label %olatch\n"
+        "olatch:\n"
+        "  %acc2 = add i64 %a1, %i\n"
+        "  %i1 = add i64 %i, 1\n"
+        "  %ic = icmp slt i64 %i1, %n\n"
+        "  br i1 %ic, label %outer, label %done\n"
+        "done:\n"
+        "  %s0 = add i64 %acc2, %c0\n"
+        "  %s1 = add i64 %s0, %c1\n"
+        "  %s2 = add i64 %s1, %c2\n"
+        "  %s3 = add i64 %s2, %c3\n"
+        "  %s4 = add i64 %s3, %c4\n"
+        "  %s5 = add i64 %s4, %c5\n"
+        "  %s6 = add i64 %s5, %c6\n"
+        "  %s7 = add i64 %s6, %c7\n"
+        "  ret i64 %s7\n"
+        "}\n";
+    int64_t expect = 0;
+    for (int64_t i = 0; i < 9; i++) {
+        for (int64_t j = 0; j < 9; j++)
+            expect += i * j + j;
+        expect += i;
+    }
+    expect += 9 * (3 + 5 + 7 + 11 + 13 + 17 + 19 + 23);
+
+    for (int pass = 0; pass < 2; pass++) {
+        lr_arena_t *arena = lr_arena_create(0);
+        lr_module_t *m = parse(src, arena);
+        TEST_ASSERT(m != NULL, "parse");
+
+        lr_jit_t *jit = lr_jit_create();
+        TEST_ASSERT(jit != NULL, "jit create");
+        jit->mode = LR_COMPILE_ISEL;
+        jit->codegen_flags = pass ? LR_CODEGEN_REGALLOC : 0u;
+        int rc = lr_jit_add_module(jit, m);
+        TEST_ASSERT_EQ(rc, 0, "jit add module");
+
+        typedef int64_t (*fn_t)(int64_t);
+        fn_t nest; LR_JIT_GET_FN(nest, jit, "nest");
+        TEST_ASSERT(nest != NULL, "function lookup");
+        TEST_ASSERT_EQ(nest(9), expect, "loop nest under register pressure");
+        TEST_ASSERT_EQ(nest(1), 98, "single trip");
+
+        lr_jit_destroy(jit);
+        lr_arena_destroy(arena);
+    }
+    return 0;
+}
+
+static int64_t regalloc_leaf8_ref(int64_t x) {
+    uint64_t ux = (uint64_t)x;
+    uint64_t a = ux + 1, b = ux * 3, c = ux ^ 85, d = ux - 7, e = ux << 2;
+    uint64_t f = ux | 9, g = ux & 1023;
+    uint64_t s = a + b + c + d + e + f + g;
+    return (int64_t)(s * a + b);
+}
+
+int test_jit_regalloc_caller_saved_around_calls(void) {
+    /* leaf8 keeps eight values live with no call in sight, so they go to
+       caller-saved registers.  In across, a, b and t live over a call or
+       an frem (a call to fmod) and must stay in callee-saved ones. */
+    const char *src =
+        "define i64 @leaf8(i64 %x) {\n"
+        "entry:\n"
+        "  %a = add i64 %x, 1\n"
+        "  %b = mul i64 %x, 3\n"
+        "  %c = xor i64 %x, 85\n"
+        "  %d = sub i64 %x, 7\n"
+        "  %e = shl i64 %x, 2\n"
+        "  %f = or i64 %x, 9\n"
+        "  %g = and i64 %x, 1023\n"
+        "  %h = add i64 %a, %b\n"
+        "  %s1 = add i64 %h, %c\n"
+        "  %s2 = add i64 %s1, %d\n"
+        "  %s3 = add i64 %s2, %e\n"
+        "  %s4 = add i64 %s3, %f\n"
+        "  %s5 = add i64 %s4, %g\n"
+        "  %m = mul i64 %s5, %a\n"
+        "  %r = add i64 %m, %b\n"
+        "  ret i64 %r\n"
+        "}\n"
+        "define i64 @across(i64 %x) {\n"
+        "entry:\n"
+        "  %a = add i64 %x, 1\n"
+        "  %b = mul i64 %x, 3\n"
+        "  %p = xor i64 %a, %b\n"
+        "  %q = add i64 %p, %b\n"
+        "  %k = call i64 @leaf8(i64 %a)\n"
+        "  %k2 = call i64 @leaf8(i64 %q)\n"
+        "  %t = add i64 %k, %b\n"
+        "  %u = xor i64 %t, %k2\n"
+        "  %u2 = mul i64 %u, %a\n"
+        "  %lo = and i64 %u2, 1048575\n"
+        "  %fx = sitofp i64 %lo to double\n"
+        "  %fr = frem double %fx, 1.000000e+03\n"
+        "  %fi = fptosi double %fr to i64\n"
+        "  %v = add i64 %fi, %t\n"
+        "  %w = add i64 %v, %b\n"
+        "  ret i64 %w\n"
+        "}\n";
+    static const int64_t xs[] = {0, 1, -1, 42, -1000, 123456789};
+
+    for (int pass = 0; pass < 2; pass++) {
+        lr_arena_t *arena = lr_arena_create(0);
+        lr_module_t *m = parse(src, arena);
+        TEST_ASSERT(m != NULL, "parse");
+
+        lr_jit_t *jit = lr_jit_create();
+        TEST_ASSERT(jit != NULL, "jit create");
+        jit->mode = LR_COMPILE_ISEL;
+        jit->codegen_flags = pass ? LR_CODEGEN_REGALLOC : 0u;
+        int rc = lr_jit_add_module(jit, m);
+        TEST_ASSERT_EQ(rc, 0, "jit add module");
+
+        typedef int64_t (*fn_t)(int64_t);
+        fn_t leaf8; LR_JIT_GET_FN(leaf8, jit, "leaf8");
+        fn_t across; LR_JIT_GET_FN(across, jit, "across");
+        TEST_ASSERT(leaf8 != NULL && across != NULL, "function lookup");
+
+        for (size_t i = 0; i < sizeof(xs) / sizeof(xs[0]); i++) {
+            uint64_t x = (uint64_t)xs[i];
+            uint64_t a = x + 1, b = x * 3, q = (a ^ b) + b;
+            uint64_t t = (uint64_t)regalloc_leaf8_ref((int64_t)a) + b;
+            uint64_t u = t ^ (uint64_t)regalloc_leaf8_ref((int64_t)q);
+            int64_t lo = (int64_t)((u * a) & 1048575u);
+            int64_t fi = (int64_t)fmod((double)lo, 1000.0);
+            int64_t want = (int64_t)((uint64_t)fi + t + b);
+            TEST_ASSERT_EQ(leaf8(xs[i]), regalloc_leaf8_ref(xs[i]),
+                           "eight live values without calls");
+            TEST_ASSERT_EQ(across(xs[i]), want,
+                           "values survive calls and frem");
+        }
+
+        lr_jit_destroy(jit);
+        lr_arena_destroy(arena);
+    }
+    return 0;
+}
+
+static double regalloc_fp_swap_ref(int64_t n, double s) {
+    double a = s, b = 1.0, acc = 0.0, acc2 = 0.0;
+    float f = 1.5f, last_f = 1.5f;
+    for (int64_t i = 0; i < n; i++) {
+        double t;
+        last_f = f;
+        acc2 = (acc + a * 3.0) * 0.5 + b;
+        f = (float)acc2;
+        t = a;
+        a = b;
+        b = t;
+        acc = acc2;
+    }
+    return acc2 + (double)last_f;
+}
+
+int test_jit_regalloc_fp_values(void) {
+    /* leafswap has no call, so a, b and acc take XMM homes and the a/b
+       swap is a register cycle.  In swap, a, b, acc and f live over a
+       call and must stay in slots; h and the temporaries may not. */
+    const char *src =
+        "define double @half(double %x) {\n"
+        "entry:\n"
+        "  %y = fmul double %x, 5.000000e-01\n"
+        "  ret double %y\n"
+        "}\n"
+        "define double @leafswap(i64 %n) {\n"
+        "entry:\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %i = phi i64 [ 0, %entry ], [ %i1, %loop ]\n"
+        "  %a = phi double [ 1.0, %entry ], [ %b, %loop ]\n"
+        "  %b = phi double [ 2.0, %entry ], [ %a, %loop ]\n"
+        "  %acc = phi double [ 0.0, %entry ], [ %acc1, %loop ]\n"
+        "  %x = sitofp i64 %i to double\n"
+        "  %m = fmul double %a, %x\n"
+        "  %acc1 = fadd double %acc, %m\n"
+        "  %i1 = add i64 %i, 1\n"
+        "  %k = icmp slt i64 %i1, %n\n"
+        "  br i1 %k, label %loop, label %done\n"
+        "done:\n"
+        "  ret double %acc1\n"
+        "}\n"
+        "define double @swap(i64 %n, double %s) {\n"
+        "entry:\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %i = phi i64 [ 0, %entry ], [ %i1, %loop ]\n"
+        "  %a = phi double [ %s, %entry ], [ %b, %loop ]\n"
+        "  %b = phi double [ 1.0, %entry ], [ %a, %loop ]\n"
+        "  %acc = phi double [ 0.0, %entry ], [ %acc2, %loop ]\n"
+        "  %f = phi float [ 1.5, %entry ], [ %f1, %loop ]\n"
+        "  %t = fmul double %a, 3.000000e+00\n"
+        "  %acc1 = fadd double %acc, %t\n"
+        "  %h = call double @half(double %acc1)\n"
+        "  %acc2 = fadd double %h, %b\n"
+        "  %f1 = fptrunc double %acc2 to float\n"
+        "  %i1 = add i64 %i, 1\n"
+        "  %k = icmp slt i64 %i1, %n\n"
+        "  br i1 %k, label %loop, label %done\n"
+        "done:\n"
+        "  %fd = fpext float %f to double\n"
+        "  %r = fadd double %acc2, %fd\n"
+        "  ret double %r\n"
+        "}\n";
+    static const int64_t ns[] = {1, 2, 3, 10};
+
+    for (int pass = 0; pass < 2; pass++) {
+        lr_arena_t *arena = lr_arena_create(0);
+        lr_module_t *m = parse(src, arena);
+        TEST_ASSERT(m != NULL, "parse");
+
+        lr_jit_t *jit = lr_jit_create();
+        TEST_ASSERT(jit != NULL, "jit create");
+        jit->mode = LR_COMPILE_ISEL;
+        jit->codegen_flags = pass ? LR_CODEGEN_REGALLOC : 0u;
+        int rc = lr_jit_add_module(jit, m);
+        TEST_ASSERT_EQ(rc, 0, "jit add module");
+
+        typedef double (*leaf_fn_t)(int64_t);
+        typedef double (*swap_fn_t)(int64_t, double);
+        leaf_fn_t leafswap; LR_JIT_GET_FN(leafswap, jit, "leafswap");
+        swap_fn_t swap; LR_JIT_GET_FN(swap, jit, "swap");
+        TEST_ASSERT(leafswap != NULL && swap != NULL, "function lookup");
+
+        for (size_t i = 0; i < sizeof(ns) / sizeof(ns[0]); i++) {
+            double a = 1.0, b = 2.0, acc = 0.0;
+            for (int64_t j = 0; j < ns[i]; j++) {
+                double t = a;
+                acc += a * (double)j;
+                a = b;
+                b = t;
+            }
+            TEST_ASSERT(leafswap(ns[i]) == acc, "XMM phi cycle");
+            TEST_ASSERT(swap(ns[i], -2.25) == regalloc_fp_swap_ref(ns[i], -2.25),
+                        "FP values survive calls");
+        }
+
+        lr_jit_destroy(jit);
+        lr_arena_destroy(arena);
+    }
+    return 0;
+}
+
+int test_jit_loop_optimized_module(void) {
+    /* Row-major walk with a loop-invariant scale read through a pointer:
+       at opt_level 1 the load and i*cols leave the inner loop. */
+    const char *src =
+        "define i64 @scaled(ptr %a, ptr %scale, i64 %rows, i64 %cols) {\n"
+        "entry:\n"
+        "  br label %outer\n"
+        "outer:\n"
+        "  %i = phi i64 [ 0, %entry ], [ %i1, %olatch ]\n"
+        "  %acc = phi i64 [ 0, %entry ], [ %acc2, %olatch ]\n"
+        "  br label %inner\n"
+        "inner:\n"
+        "  %j = phi i64 [ 0, %outer ], [ %j1, %inner ]\n"
+        "  %s = phi i64 [ %acc, %outer ], [ %s1, %inner ]\n"
+        "  %k = load i64, ptr %scale\n"
+        "  %row = mul i64 %i, %cols\n"
+        "  %idx = add i64 %row, %j\n"
+        "  %p = getelementptr i64, ptr %a, i64 %idx\n"
+        "  %v = load i64, ptr %p\n"
+        "  %jk = mul i64 %j, %k\n"
+        "  %t = mul i64 %v, %k\n"
+        "  %u = add i64 %t, %jk\n"
+        "  %s1 = add i64 %s, %u\n"
+        "  %j1 = add i64 %j, 1\n"
+        "  %jc = icmp slt i64 %j1, %cols\n"
+        "  br i1 %jc, label %inner, label %olatch\n"
+        "olatch:\n"
+        "  %acc2 = add i64 %s1, %i\n"
+        "  %i1 = add i64 %i, 1\n"
+        "  %ic = icmp slt i64 %i1, %rows\n"
+        "  br i1 %ic, label %outer, label %done\n"
+        "done:\n"
+        "  ret i64 %acc2\n"
+        "}\n";
+    int64_t a[3][5];
+    int64_t scale = 3, expect = 0;
+    for (int64_t i = 0; i < 3; i++) {
+        for (int64_t j = 0; j < 5; j++) {
+            a[i][j] = i * 7 - j * 2 + 1;
+            expect += a[i][j] * scale + j * scale;
+        }
+        expect += i;
+    }
+
+    for (int level = 0; level < 2; level++) {
+        lr_arena_t *arena = lr_arena_create(0);
+        lr_module_t *m = parse(src, arena);
+        TEST_ASSERT(m != NULL, "parse");
+        m->opt_level = level;
+
+        lr_jit_t *jit = lr_jit_create();
+        TEST_ASSERT(jit != NULL, "jit create");
+        int rc = lr_jit_add_module(jit, m);
+        TEST_ASSERT_EQ(rc, 0, "jit add module");
+
+        typedef int64_t (*fn_t)(int64_t *, int64_t *, int64_t, int64_t);
+        fn_t scaled; LR_JIT_GET_FN(scaled, jit, "scaled");
+        TEST_ASSERT(scaled != NULL, "function lookup");
+        TEST_ASSERT_EQ(scaled(&a[0][0], &scale, 3, 5), expect, "3x5 walk");
+        TEST_ASSERT_EQ(scaled(&a[0][0], &scale, 1, 1), 3, "single trip");
+
+        lr_jit_destroy(jit);
+        lr_arena_destroy(arena);
+    }
+    return 0;
+}
+
+int test_jit_inlined_module_calls(void) {
+    /* Small helpers called from a loop, one with two returns and one
+       writing through a pointer; fact recurses and stays a call. */
+    const char *src =
+        "define internal i32 @clamp(i32 %x, i32 %lo, i32 %hi) {\n"
+        "entry:\n"
+        "  %c1 = icmp slt i32 %x, %lo\n"
+        "  br i1 %c1, label %low, label %chk\n"
+        "low:\n"
+        "  ret i32 %lo\n"
+        "chk:\n"
+        "  %c2 = icmp sgt i32 %x, %hi\n"
+        "  %r = select i1 %c2, i32 %hi, i32 %x\n"
+        "  ret i32 %r\n"
+        "}\n"
+        "define internal void @put(ptr %o, i64 %i, i32 %v) {\n"
+        "entry:\n"
+        "  %p = getelementptr i32, ptr %o, i64 %i\n"
+        "  store i32 %v, ptr %p\n"
+        "  ret void\n"
+        "}\n"
+        "define internal i32 @fact(i32 %n) {\n"
+        "entry:\n"
+        "  %z = icmp sle i32 %n, 1\n"
+        "  br i1 %z, label %base, label %rec\n"
+        "base:\n"
+        "  ret i32 1\n"
+        "rec:\n"
+        "  %n1 = sub i32 %n, 1\n"
+        "  %f = call i32 @fact(i32 %n1)\n"
+        "  %r = mul i32 %n, %f\n"
+        "  ret i32 %r\n"
+        "}\n"
+        "define i32 @walk(ptr %a, ptr %o, i64 %n) {\n"
+        "entry:\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %i = phi i64 [ 0, %entry ], [ %i1, %loop ]\n"
+        "  %s = phi i32 [ 0, %entry ], [ %s1, %loop ]\n"
+        "  %pa = getelementptr i32, ptr %a, i64 %i\n"
+        "  %x = load i32, ptr %pa\n"
+        "  %sq = mul i32 %x, %x\n"
+        "  %c = call i32 @clamp(i32 %sq, i32 2, i32 50)\n"
+        "  %k = and i32 %x, 7\n"
+        "  %f = call i32 @fact(i32 %k)\n"
+        "  %v = add i32 %c, %f\n"
+        "  call void @put(ptr %o, i64 %i, i32 %v)\n"
+        "  %s1 = add i32 %s, %v\n"
+        "  %i1 = add i64 %i, 1\n"
+        "  %more = icmp ult i64 %i1, %n\n"
+        "  br i1 %more, label %loop, label %done\n"
+        "done:\n"
+        "  ret i32 %s1\n"
+        "}\n";
+    static const int32_t fact_tab[8] = {1, 1, 2, 6, 24, 120, 720, 5040};
+    int32_t a[9] = {0, 1, -1, 3, 5, 7, -9, 12, 4};
+    int32_t expect_out[9], expect = 0;
+    for (int i = 0; i < 9; i++) {
+        int32_t sq = a[i] * a[i];
+        int32_t c = sq < 2 ? 2 : sq > 50 ? 50 : sq;
+        expect_out[i] = c + fact_tab[a[i] & 7];
+        expect += expect_out[i];
+    }
+
+    for (int level = 0; level < 2; level++) {
+        lr_arena_t *arena = lr_arena_create(0);
+        lr_module_t *m = parse(src, arena);
+        TEST_ASSERT(m != NULL, "parse");
+        m->opt_level = level;
+
+        lr_jit_t *jit = lr_jit_create();
+        TEST_ASSERT(jit != NULL, "jit create");
+        int rc = lr_jit_add_module(jit, m);
+        TEST_ASSERT_EQ(rc, 0, "jit add module");
+
+        typedef int32_t (*fn_t)(int32_t *, int32_t *, int64_t);
+        fn_t walk; LR_JIT_GET_FN(walk, jit, "walk");
+        TEST_ASSERT(walk != NULL, "function lookup");
+        int32_t out[9] = {0};
+        TEST_ASSERT_EQ(walk(a, out, 9), expect, "sum over nine elements");
+        for (int i = 0; i < 9; i++)
+            TEST_ASSERT_EQ(out[i], expect_out[i], "stored element");
+        TEST_ASSERT_EQ(walk(a + 4, out, 1), 25 + 120, "single trip");
+
+        lr_jit_destroy(jit);
+        lr_arena_destroy(arena);
+    }
+    return 0;
+}
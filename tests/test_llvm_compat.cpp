@@ -2105,7 +2105,7 @@ static int test_replace_all_uses_with_rewrites_existing_operands() {
     return 0;
 }
 
-static int test_switch_add_case_builds_dispatch_chain() {
+static int test_switch_add_case_builds_switch_inst() {
     ScopedEnvVar policy("LIRIC_POLICY", "ir");
     llvm::LLVMContext ctx;
     llvm::Module mod("switch_add_case", ctx);
@@ -2127,6 +2127,19 @@ static int test_switch_add_case_builds_dispatch_chain() {
     TEST_ASSERT(sw != nullptr, "CreateSwitch");
     sw->addCase(llvm::ConstantInt::get(i32, 1), case1);
     sw->addCase(llvm::ConstantInt::get(i32, 2), case2);
+    sw->addCase(llvm::ConstantInt::get(i32, 5), case1);
+
+    lr_module_t *ir = lc_module_get_ir(mod.getCompat());
+    TEST_ASSERT(ir != nullptr, "switch module IR");
+    lr_func_t *f = ir->first_func;
+    while (f && (!f->name || std::strcmp(f->name, "switch_case_fn") != 0))
+        f = f->next;
+    TEST_ASSERT(f != nullptr && f->first_block != nullptr, "switch function");
+    struct lr_inst *term = f->first_block->last;
+    TEST_ASSERT(term != nullptr && term->op == LR_OP_SWITCH,
+                "addCase extends one switch instruction");
+    TEST_ASSERT_EQ(term->num_operands, 8, "condition, default, three cases");
+    TEST_ASSERT_EQ(f->num_blocks, 4, "no compare-chain blocks added");
 
     builder.SetInsertPoint(case1);
     builder.CreateRet(llvm::ConstantInt::get(i32, 11));
@@ -2143,6 +2156,7 @@ static int test_switch_add_case_builds_dispatch_chain() {
     TEST_ASSERT(fp != nullptr, "lookup switch_case_fn");
     TEST_ASSERT_EQ(fp(1), 11, "switch case 1");
     TEST_ASSERT_EQ(fp(2), 22, "switch case 2");
+    TEST_ASSERT_EQ(fp(5), 11, "switch case 5 shares case1");
     TEST_ASSERT_EQ(fp(9), 33, "switch default");
     return 0;
 }
@@ -2682,7 +2696,7 @@ int main() {
 
     fprintf(stderr, "\nJIT smoke tests:\n");
     RUN_TEST(test_replace_all_uses_with_rewrites_existing_operands);
-    RUN_TEST(test_switch_add_case_builds_dispatch_chain);
+    RUN_TEST(test_switch_add_case_builds_switch_inst);
     RUN_TEST(test_jit_smoke_ret_42);
     RUN_TEST(test_kaleidoscope_jit_smoke_ret_42);
     RUN_TEST(test_jit_smoke_alloca_store_load_i32);
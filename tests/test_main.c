@@ -56,6 +56,7 @@ int test_parser_store_with_struct_constant(void);
 int test_parser_store_packed_struct_float_pair(void);
 int test_parser_store_packed_struct_double_pair(void);
 int test_parser_urem_instruction(void);
+int test_parser_switch_single_instruction(void);
 int test_parser_udiv_instruction(void);
 int test_parser_frem_instruction(void);
 int test_parser_canonical_phi_pairs(void);
@@ -77,6 +78,7 @@ int test_parser_cast_expr_in_aggregate_init(void);
 int test_parser_streaming_callback_order(void);
 int test_parser_streaming_callback_error_propagates(void);
 int test_parser_vector_type_roundtrip(void);
+int test_parser_vector_element_ops(void);
 int test_codegen_ret_42(void);
 int test_codegen_add(void);
 int test_codegen_skip_redundant_immediate_reload(void);
@@ -84,7 +86,17 @@ int test_codegen_reuse_cached_vreg_across_scratch_regs(void);
 int test_codegen_keep_store_for_next_inst_multiuse_vreg(void);
 int test_codegen_zero_immediate_uses_xor_when_flags_dead(void);
 int test_codegen_select_zero_keeps_mov_for_flags(void);
+int test_codegen_fuses_icmp_into_branch_and_select(void);
+int test_codegen_folds_gep_into_load_store(void);
+int test_codegen_relaxes_x86_branches(void);
+int test_codegen_elides_leaf_frames(void);
+int test_codegen_elides_aarch64_leaf_frames(void);
+int test_codegen_div_by_constant(void);
 int test_codegen_x86_global_reloc_uses_abs64_when_jit_and_objctx(void);
+int test_codegen_regalloc_homes_loop_values(void);
+int test_codegen_regalloc_leaf_uses_caller_saved(void);
+int test_codegen_regalloc_homes_fp_values(void);
+int test_codegen_x86_cpu_feature_tiers(void);
 int test_host_target_name(void);
 int test_create_host_target(void);
 int test_create_unknown_target_fails(void);
@@ -95,11 +107,12 @@ int test_target_riscv64_split_resolves(void);
 int test_target_copy_patch_entrypoints_available(void);
 int test_target_requires_full_streaming_hooks(void);
 int test_target_copy_patch_fallback_matches_isel_for_non_x86(void);
-int test_target_copy_patch_matches_isel_for_x86_streaming(void);
+int test_target_copy_patch_stitches_stencils_for_x86_streaming(void);
 int test_target_x86_streaming_hooks_isel_smoke(void);
 int test_target_x86_streaming_hooks_copy_patch_smoke(void);
 int test_target_x86_streaming_hooks_phi_smoke(void);
 int test_target_aarch64_streaming_hooks_smoke(void);
+int test_target_aarch64_streaming_switch_jump_table(void);
 int test_target_aarch64_streaming_fp_convert_ops(void);
 int test_target_riscv64_streaming_hooks_smoke(void);
 int test_target_riscv64_streaming_reports_unsupported_ops(void);
@@ -110,8 +123,27 @@ int test_platform_jit_page_transitions(void);
 int test_platform_time_ns_monotonic(void);
 int test_platform_dlsym_default_malloc(void);
 int test_platform_run_process_exit_status(void);
+int test_platform_cpu_feature_spec(void);
 int test_symbol_provider_prefers_jit_table(void);
 int test_target_shared_static_alloca_table(void);
+int test_target_shared_live_ranges_widen_over_loops(void);
+int test_target_shared_plan_switch(void);
+int test_target_shared_classify_int_intrinsic(void);
+int test_target_shared_mem_inline_plan(void);
+int test_target_shared_slot_coloring(void);
+int test_target_shared_const_pool(void);
+int test_target_shared_parallel_copies(void);
+int test_target_shared_fast_cc_assign(void);
+int test_target_shared_cold_blocks(void);
+int test_ir_promote_allocas(void);
+int test_ir_finalize_promotes_from_opt1(void);
+int test_ir_value_number(void);
+int test_ir_value_number_vector_types(void);
+int test_ir_value_number_multi_def(void);
+int test_ir_cfg_loops(void);
+int test_ir_optimize_loops(void);
+int test_ir_optimize_loops_multi_def(void);
+int test_ir_inline_calls(void);
 int test_ir_finalize_builds_dense_arrays(void);
 int test_ir_finalize_peephole_constant_identity_and_branch(void);
 int test_ir_finalize_redundant_load_elimination(void);
@@ -128,7 +160,27 @@ int test_jit_arithmetic(void);
 int test_jit_icmp(void);
 int test_jit_select_immediate_zero(void);
 int test_jit_branch(void);
+int test_jit_switch_jump_table(void);
+int test_jit_switch_bit_test_and_tree(void);
+int test_jit_int_intrinsics_inline(void);
 int test_jit_loop(void);
+int test_jit_tierup_recompiles_hot_function(void);
+int test_jit_tierup_concurrent_add_module(void);
+int test_jit_direct_calls_and_stubs(void);
+int test_jit_call_stub_reserve(void);
+int test_jit_tail_calls(void);
+int test_jit_slot_coloring_shares_frame(void);
+int test_jit_fp_constant_pool(void);
+int test_jit_phi_swap_cycles(void);
+int test_jit_fast_cc_internal_calls(void);
+int test_jit_cold_blocks_moved_out_of_loop(void);
+int test_jit_promoted_allocas(void);
+int test_jit_value_numbered_addresses(void);
+int test_jit_regalloc_loop_weighted_spills(void);
+int test_jit_regalloc_caller_saved_around_calls(void);
+int test_jit_regalloc_fp_values(void);
+int test_jit_loop_optimized_module(void);
+int test_jit_inlined_module_calls(void);
 int test_jit_alloca_load_store(void);
 int test_jit_typeless_load_defaults_to_ptr_width(void);
 int test_jit_alloca_many_static_slots(void);
@@ -167,6 +219,8 @@ int test_jit_llvm_intrinsic_fabs_f32(void);
 int test_jit_llvm_intrinsic_extended_blob_coverage(void);
 int test_jit_llvm_intrinsic_powi_f32_i32(void);
 int test_jit_llvm_intrinsic_memcpy_memset(void);
+int test_jit_mem_intrinsics_inline(void);
+int test_jit_vector_ops(void);
 int test_jit_llvm_intrinsic_memmove(void);
 int test_jit_gep_struct_field(void);
 int test_jit_gep_array_index(void);
@@ -194,6 +248,7 @@ int test_jit_fcmp_oeq(void);
 int test_jit_fp_arithmetic_chain(void);
 int test_jit_insert_extractvalue_struct_fields(void);
 int test_jit_late_frame_patch_and_phi_slots(void);
+int test_jit_regalloc_loop_calls_and_phi_swap(void);
 int test_jit_packed_struct_float_constant(void);
 int test_jit_packed_struct_double_constant(void);
 int test_e2e_ret_42(void);
@@ -231,6 +286,8 @@ int test_session_llvm_abi_float_value_arg(void);
 int test_session_arithmetic_chain(void);
 int test_session_stream_stencil_fast_path(void);
 int test_session_stream_isel_fast_path(void);
+int test_session_regalloc_config(void);
+int test_session_target_features_config(void);
 int test_session_direct_llvm_mode_stream_contract(void);
 int test_session_direct_llvm_forward_ref_lookup_contract(void);
 int test_session_direct_forward_ref_lookup_contract(void);
@@ -244,7 +301,9 @@ int test_session_icmp_result_to_slot(void);
 int test_session_sub_word_ashr_signed(void);
 int test_session_alloca_load_store(void);
 int test_session_loop_phi(void);
+int test_session_switch_many_cases(void);
 int test_session_call(void);
+int test_session_direct_inline_small_helper(void);
 int test_session_operand_global_offset_propagates_to_ir(void);
 int test_session_select(void);
 int test_session_ir_print(void);
@@ -340,6 +399,11 @@ int test_cp_fallback_to_isel(void);
 int test_cp_immediate_operand(void);
 int test_cp_add_ret_supernode_i32(void);
 int test_cp_add_ret_supernode_i64(void);
+int test_cp_loop_phi_gep_memory(void);
+int test_cp_alloca_casts_fp(void);
+int test_cp_call_between_stencils(void);
+int test_cp_calls_three_args_fp_return(void);
+int test_cp_matches_isel_differential(void);
 #endif
 
 #if defined(__linux__) && (defined(__x86_64__) || defined(_M_X64))
@@ -349,6 +413,7 @@ int test_stencil_gen_deterministic_output(void);
 int test_stencil_gen_missing_input_fails(void);
 int test_stencil_runtime_lookup_known_entries(void);
 int test_stencil_runtime_lookup_unknown_entry_returns_null(void);
+int test_stencil_runtime_lookup_keyed_entries(void);
 int test_stencil_runtime_emit_patches_all_holes(void);
 int test_stencil_runtime_emit_strip_trailing_ret(void);
 int test_stencil_runtime_emit_rejects_small_buffer(void);
@@ -382,6 +447,7 @@ int main(void) {
     RUN_TEST(test_parser_store_packed_struct_float_pair);
     RUN_TEST(test_parser_store_packed_struct_double_pair);
     RUN_TEST(test_parser_urem_instruction);
+    RUN_TEST(test_parser_switch_single_instruction);
     RUN_TEST(test_parser_udiv_instruction);
     RUN_TEST(test_parser_frem_instruction);
     RUN_TEST(test_parser_canonical_phi_pairs);
@@ -403,6 +469,7 @@ int main(void) {
     RUN_TEST(test_parser_streaming_callback_order);
     RUN_TEST(test_parser_streaming_callback_error_propagates);
     RUN_TEST(test_parser_vector_type_roundtrip);
+    RUN_TEST(test_parser_vector_element_ops);
 
     fprintf(stderr, "\nCodegen tests:\n");
     RUN_TEST(test_codegen_ret_42);
@@ -412,7 +479,17 @@ int main(void) {
     RUN_TEST(test_codegen_keep_store_for_next_inst_multiuse_vreg);
     RUN_TEST(test_codegen_zero_immediate_uses_xor_when_flags_dead);
     RUN_TEST(test_codegen_select_zero_keeps_mov_for_flags);
+    RUN_TEST(test_codegen_fuses_icmp_into_branch_and_select);
+    RUN_TEST(test_codegen_folds_gep_into_load_store);
+    RUN_TEST(test_codegen_relaxes_x86_branches);
+    RUN_TEST(test_codegen_elides_leaf_frames);
+    RUN_TEST(test_codegen_elides_aarch64_leaf_frames);
+    RUN_TEST(test_codegen_div_by_constant);
     RUN_TEST(test_codegen_x86_global_reloc_uses_abs64_when_jit_and_objctx);
+    RUN_TEST(test_codegen_regalloc_homes_loop_values);
+    RUN_TEST(test_codegen_regalloc_leaf_uses_caller_saved);
+    RUN_TEST(test_codegen_regalloc_homes_fp_values);
+    RUN_TEST(test_codegen_x86_cpu_feature_tiers);
 
     fprintf(stderr, "\nTarget tests:\n");
     RUN_TEST(test_host_target_name);
@@ -425,11 +502,12 @@ int main(void) {
     RUN_TEST(test_target_copy_patch_entrypoints_available);
     RUN_TEST(test_target_requires_full_streaming_hooks);
     RUN_TEST(test_target_copy_patch_fallback_matches_isel_for_non_x86);
-    RUN_TEST(test_target_copy_patch_matches_isel_for_x86_streaming);
+    RUN_TEST(test_target_copy_patch_stitches_stencils_for_x86_streaming);
     RUN_TEST(test_target_x86_streaming_hooks_isel_smoke);
     RUN_TEST(test_target_x86_streaming_hooks_copy_patch_smoke);
     RUN_TEST(test_target_x86_streaming_hooks_phi_smoke);
     RUN_TEST(test_target_aarch64_streaming_hooks_smoke);
+    RUN_TEST(test_target_aarch64_streaming_switch_jump_table);
     RUN_TEST(test_target_aarch64_streaming_fp_convert_ops);
     RUN_TEST(test_target_riscv64_streaming_hooks_smoke);
     RUN_TEST(test_target_riscv64_streaming_reports_unsupported_ops);
@@ -440,8 +518,27 @@ int main(void) {
     RUN_TEST(test_platform_time_ns_monotonic);
     RUN_TEST(test_platform_dlsym_default_malloc);
     RUN_TEST(test_platform_run_process_exit_status);
+    RUN_TEST(test_platform_cpu_feature_spec);
     RUN_TEST(test_symbol_provider_prefers_jit_table);
     RUN_TEST(test_target_shared_static_alloca_table);
+    RUN_TEST(test_target_shared_live_ranges_widen_over_loops);
+    RUN_TEST(test_target_shared_plan_switch);
+    RUN_TEST(test_target_shared_classify_int_intrinsic);
+    RUN_TEST(test_target_shared_mem_inline_plan);
+    RUN_TEST(test_target_shared_slot_coloring);
+    RUN_TEST(test_target_shared_const_pool);
+    RUN_TEST(test_target_shared_parallel_copies);
+    RUN_TEST(test_target_shared_fast_cc_assign);
+    RUN_TEST(test_target_shared_cold_blocks);
+    RUN_TEST(test_ir_promote_allocas);
+    RUN_TEST(test_ir_finalize_promotes_from_opt1);
+    RUN_TEST(test_ir_value_number);
+    RUN_TEST(test_ir_value_number_vector_types);
+    RUN_TEST(test_ir_value_number_multi_def);
+    RUN_TEST(test_ir_cfg_loops);
+    RUN_TEST(test_ir_optimize_loops);
+    RUN_TEST(test_ir_optimize_loops_multi_def);
+    RUN_TEST(test_ir_inline_calls);
     RUN_TEST(test_ir_finalize_builds_dense_arrays);
     RUN_TEST(test_ir_finalize_peephole_constant_identity_and_branch);
     RUN_TEST(test_ir_finalize_redundant_load_elimination);
@@ -460,7 +557,27 @@ int main(void) {
     RUN_TEST(test_jit_icmp);
     RUN_TEST(test_jit_select_immediate_zero);
     RUN_TEST(test_jit_branch);
+    RUN_TEST(test_jit_switch_jump_table);
+    RUN_TEST(test_jit_switch_bit_test_and_tree);
+    RUN_TEST(test_jit_int_intrinsics_inline);
     RUN_TEST(test_jit_loop);
+    RUN_TEST(test_jit_tierup_recompiles_hot_function);
+    RUN_TEST(test_jit_tierup_concurrent_add_module);
+    RUN_TEST(test_jit_direct_calls_and_stubs);
+    RUN_TEST(test_jit_call_stub_reserve);
+    RUN_TEST(test_jit_tail_calls);
+    RUN_TEST(test_jit_slot_coloring_shares_frame);
+    RUN_TEST(test_jit_fp_constant_pool);
+    RUN_TEST(test_jit_phi_swap_cycles);
+    RUN_TEST(test_jit_fast_cc_internal_calls);
+    RUN_TEST(test_jit_cold_blocks_moved_out_of_loop);
+    RUN_TEST(test_jit_promoted_allocas);
+    RUN_TEST(test_jit_value_numbered_addresses);
+    RUN_TEST(test_jit_regalloc_loop_weighted_spills);
+    RUN_TEST(test_jit_regalloc_caller_saved_around_calls);
+    RUN_TEST(test_jit_regalloc_fp_values);
+    RUN_TEST(test_jit_loop_optimized_module);
+    RUN_TEST(test_jit_inlined_module_calls);
     RUN_TEST(test_jit_alloca_load_store);
     RUN_TEST(test_jit_typeless_load_defaults_to_ptr_width);
     RUN_TEST(test_jit_alloca_many_static_slots);
@@ -499,6 +616,8 @@ int main(void) {
     RUN_TEST(test_jit_llvm_intrinsic_extended_blob_coverage);
     RUN_TEST(test_jit_llvm_intrinsic_powi_f32_i32);
     RUN_TEST(test_jit_llvm_intrinsic_memcpy_memset);
+    RUN_TEST(test_jit_mem_intrinsics_inline);
+    RUN_TEST(test_jit_vector_ops);
     RUN_TEST(test_jit_llvm_intrinsic_memmove);
     RUN_TEST(test_jit_gep_struct_field);
     RUN_TEST(test_jit_gep_array_index);
@@ -526,6 +645,7 @@ int main(void) {
     RUN_TEST(test_jit_fp_arithmetic_chain);
     RUN_TEST(test_jit_insert_extractvalue_struct_fields);
     RUN_TEST(test_jit_late_frame_patch_and_phi_slots);
+    RUN_TEST(test_jit_regalloc_loop_calls_and_phi_swap);
     RUN_TEST(test_jit_packed_struct_float_constant);
     RUN_TEST(test_jit_packed_struct_double_constant);
 
@@ -577,6 +697,8 @@ int main(void) {
     RUN_TEST(test_session_arithmetic_chain);
     RUN_TEST(test_session_stream_stencil_fast_path);
     RUN_TEST(test_session_stream_isel_fast_path);
+    RUN_TEST(test_session_regalloc_config);
+    RUN_TEST(test_session_target_features_config);
     RUN_TEST(test_session_direct_llvm_mode_stream_contract);
     RUN_TEST(test_session_direct_llvm_forward_ref_lookup_contract);
     RUN_TEST(test_session_direct_forward_ref_lookup_contract);
@@ -590,7 +712,9 @@ int main(void) {
     RUN_TEST(test_session_sub_word_ashr_signed);
     RUN_TEST(test_session_alloca_load_store);
     RUN_TEST(test_session_loop_phi);
+    RUN_TEST(test_session_switch_many_cases);
     RUN_TEST(test_session_call);
+    RUN_TEST(test_session_direct_inline_small_helper);
     RUN_TEST(test_session_operand_global_offset_propagates_to_ir);
     RUN_TEST(test_session_select);
     RUN_TEST(test_session_ir_print);
@@ -696,6 +820,11 @@ int main(void) {
     RUN_TEST(test_cp_immediate_operand);
     RUN_TEST(test_cp_add_ret_supernode_i32);
     RUN_TEST(test_cp_add_ret_supernode_i64);
+    RUN_TEST(test_cp_loop_phi_gep_memory);
+    RUN_TEST(test_cp_alloca_casts_fp);
+    RUN_TEST(test_cp_call_between_stencils);
+    RUN_TEST(test_cp_calls_three_args_fp_return);
+    RUN_TEST(test_cp_matches_isel_differential);
 #endif
 
 #if defined(__linux__) && (defined(__x86_64__) || defined(_M_X64))
@@ -708,6 +837,7 @@ int main(void) {
     fprintf(stderr, "\nStencil runtime tests:\n");
     RUN_TEST(test_stencil_runtime_lookup_known_entries);
     RUN_TEST(test_stencil_runtime_lookup_unknown_entry_returns_null);
+    RUN_TEST(test_stencil_runtime_lookup_keyed_entries);
     RUN_TEST(test_stencil_runtime_emit_patches_all_holes);
     RUN_TEST(test_stencil_runtime_emit_strip_trailing_ret);
     RUN_TEST(test_stencil_runtime_emit_rejects_small_buffer);
@@ -667,6 +667,59 @@ int test_parser_urem_instruction(void) {
     return 0;
 }
 
+int test_parser_switch_single_instruction(void) {
+    const char *src =
+        "define i32 @f(i32 %x) {\n"
+        "entry:\n"
+        "  switch i32 %x, label %def [\n"
+        "    i32 1, label %a\n"
+        "    i32 -2, label %b\n"
+        "    i32 3, label %a\n"
+        "  ]\n"
+        "a:\n"
+        "  ret i32 10\n"
+        "b:\n"
+        "  ret i32 20\n"
+        "def:\n"
+        "  ret i32 0\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    char err[256] = {0};
+    FILE *tmp;
+    char dump[1024] = {0};
+    size_t nread = 0;
+
+    lr_module_t *m = lr_parse_ll_text(src, strlen(src), arena, err, sizeof(err));
+    TEST_ASSERT(m != NULL, err);
+
+    lr_func_t *f = m->first_func;
+    TEST_ASSERT(f != NULL, "function exists");
+    TEST_ASSERT_EQ(f->num_blocks, 4, "no compare-chain blocks synthesized");
+    lr_inst_t *inst = f->first_block->first;
+    TEST_ASSERT(inst != NULL, "instruction exists");
+    TEST_ASSERT_EQ(inst->op, LR_OP_SWITCH, "switch parsed as one instruction");
+    TEST_ASSERT(inst->next == NULL, "switch terminates the entry block");
+    TEST_ASSERT_EQ(inst->num_operands, 8, "cond, default and three cases");
+    TEST_ASSERT_EQ(inst->operands[1].kind, LR_VAL_BLOCK, "default is a block");
+    TEST_ASSERT_EQ(inst->operands[4].imm_i64, -2, "case value preserved");
+
+    tmp = tmpfile();
+    TEST_ASSERT(tmp != NULL, "tmpfile for dump");
+    lr_module_dump(m, tmp);
+    fflush(tmp);
+    rewind(tmp);
+    nread = fread(dump, 1, sizeof(dump) - 1, tmp);
+    dump[nread] = '\0';
+    fclose(tmp);
+
+    TEST_ASSERT(strstr(dump, "switch i32 %") != NULL, "dump prints switch");
+    TEST_ASSERT(strstr(dump, "i32 -2, label %b") != NULL,
+                "dump prints case list");
+
+    lr_arena_destroy(arena);
+    return 0;
+}
+
 int test_parser_udiv_instruction(void) {
     const char *src =
         "define i32 @f(i32 %a, i32 %b) {\n"
@@ -1518,6 +1571,48 @@ int test_parser_streaming_callback_error_propagates(void) {
     return 0;
 }
 
+int test_parser_vector_element_ops(void) {
+    const char *src =
+        "define <4 x i32> @f(<4 x i32> %a, <4 x i32> %b, i32 %i) {\n"
+        "entry:\n"
+        "  %c = icmp slt <4 x i32> %a, %b\n"
+        "  %s = select <4 x i1> %c, <4 x i32> %a, <4 x i32> %b\n"
+        "  %e = extractelement <4 x i32> %s, i32 %i\n"
+        "  %n = insertelement <4 x i32> %s, i32 %e, i32 0\n"
+        "  %r = shufflevector <4 x i32> %n, <4 x i32> poison, "
+        "<4 x i32> <i32 3, i32 undef, i32 1, i32 0>\n"
+        "  ret <4 x i32> %r\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    char err[256] = {0};
+    lr_module_t *m;
+    lr_inst_t *inst;
+
+    m = lr_parse_ll_text(src, strlen(src), arena, err, sizeof(err));
+    TEST_ASSERT(m != NULL, err);
+    inst = m->first_func->first_block->first;
+
+    TEST_ASSERT_EQ(inst->op, LR_OP_ICMP, "icmp first");
+    TEST_ASSERT_EQ(inst->type->kind, LR_TYPE_VECTOR, "vector icmp yields vector");
+    TEST_ASSERT_EQ(inst->type->array.count, 4, "vector icmp keeps lane count");
+    TEST_ASSERT_EQ(inst->type->array.elem->kind, LR_TYPE_I1, "vector icmp lanes are i1");
+    inst = inst->next->next;
+    TEST_ASSERT_EQ(inst->op, LR_OP_EXTRACTELEMENT, "extractelement parsed");
+    TEST_ASSERT_EQ(inst->type->kind, LR_TYPE_I32, "extractelement yields lane type");
+    inst = inst->next;
+    TEST_ASSERT_EQ(inst->op, LR_OP_INSERTELEMENT, "insertelement parsed");
+    TEST_ASSERT_EQ(inst->num_operands, 3, "insertelement has 3 operands");
+    inst = inst->next;
+    TEST_ASSERT_EQ(inst->op, LR_OP_SHUFFLEVECTOR, "shufflevector parsed");
+    TEST_ASSERT_EQ(inst->operands[1].kind, LR_VAL_UNDEF, "poison operand");
+    TEST_ASSERT_EQ(inst->num_indices, 4, "mask has 4 lanes");
+    TEST_ASSERT_EQ(inst->indices[0], 3, "mask lane 0");
+    TEST_ASSERT_EQ(inst->indices[1], UINT32_MAX, "undef mask lane");
+
+    lr_arena_destroy(arena);
+    return 0;
+}
+
 int test_parser_vector_type_roundtrip(void) {
     const char *src =
         "define <2 x float> @id(<2 x float> %x) {\n"
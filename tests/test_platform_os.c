@@ -1,7 +1,9 @@
+#include "platform/platform_cpu.h"
 #include "platform/platform_os.h"
 
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #define TEST_ASSERT(cond, msg) do { \
     if (!(cond)) { \
@@ -68,3 +70,51 @@ int test_platform_run_process_exit_status(void) {
 #endif
     return 0;
 }
+
+int test_platform_cpu_feature_spec(void) {
+    uint32_t host = lr_platform_cpu_host_features();
+    uint32_t f = 0;
+    char buf[64];
+    size_t n;
+
+    TEST_ASSERT_EQ(lr_platform_cpu_parse_features("", &f), 0, "empty spec");
+    TEST_ASSERT_EQ(f, 0, "empty spec is baseline");
+    TEST_ASSERT_EQ(lr_platform_cpu_parse_features("host", &f), 0, "host");
+    TEST_ASSERT_EQ(f, host, "host spec");
+    TEST_ASSERT_EQ(lr_platform_cpu_parse_features("+popcnt, bmi2,-popcnt",
+                                                  &f), 0, "list");
+    TEST_ASSERT_EQ(f, LR_CPU_X86_BMI2, "later entries win");
+    TEST_ASSERT_EQ(lr_platform_cpu_parse_features("host,-avx2", &f), 0,
+                   "host minus");
+    TEST_ASSERT_EQ(f, host & ~(uint32_t)LR_CPU_X86_AVX2, "host minus avx2");
+    TEST_ASSERT_EQ(lr_platform_cpu_parse_features("fma,baseline,cssc", &f),
+                   0, "baseline resets");
+    TEST_ASSERT_EQ(f, LR_CPU_A64_CSSC, "baseline resets the set");
+
+    f = 7;
+    TEST_ASSERT_EQ(lr_platform_cpu_parse_features("+avx512", &f), -1,
+                   "unknown feature");
+    TEST_ASSERT_EQ(f, 7, "output untouched on error");
+    TEST_ASSERT_EQ(lr_platform_cpu_parse_features("-", &f), -1,
+                   "bare sign");
+
+    TEST_ASSERT_EQ(lr_platform_cpu_target_mask("x86_64") & LR_CPU_A64_CSSC,
+                   0, "x86 mask excludes aarch64 bits");
+    TEST_ASSERT(lr_platform_cpu_target_mask("aarch64") & LR_CPU_A64_CSSC,
+                "aarch64 mask has cssc");
+    TEST_ASSERT_EQ(lr_platform_cpu_target_mask("riscv64"), 0,
+                   "riscv64 has no optional features");
+
+    n = lr_platform_cpu_format_features(LR_CPU_X86_POPCNT | LR_CPU_X86_FMA,
+                                        buf, sizeof(buf));
+    TEST_ASSERT(strcmp(buf, "+popcnt,+fma") == 0, "format");
+    TEST_ASSERT_EQ(n, strlen("+popcnt,+fma"), "format length");
+    n = lr_platform_cpu_format_features(LR_CPU_X86_POPCNT | LR_CPU_X86_FMA,
+                                        buf, 5);
+    TEST_ASSERT(strcmp(buf, "+pop") == 0, "format truncates");
+    TEST_ASSERT_EQ(n, strlen("+popcnt,+fma"), "truncated length");
+    TEST_ASSERT_EQ(lr_platform_cpu_parse_features("+popcnt,+fma", &f), 0,
+                   "format round-trips");
+    TEST_ASSERT_EQ(f, LR_CPU_X86_POPCNT | LR_CPU_X86_FMA, "round-trip set");
+    return 0;
+}
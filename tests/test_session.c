@@ -537,6 +537,109 @@ int test_session_stream_isel_fast_path(void) {
 #endif
 }
 
+int test_session_regalloc_config(void) {
+    lr_session_config_t cfg = {0};
+    lr_error_t err;
+    lr_session_t *s;
+    lr_type_t *i64;
+    lr_type_t *params[2];
+    uint32_t a, b, prod, sum;
+    void *addr = NULL;
+    typedef int64_t (*fn_t)(int64_t, int64_t);
+    fn_t fn;
+    int rc;
+
+    cfg.mode = LR_MODE_DIRECT;
+    cfg.backend = LR_SESSION_BACKEND_ISEL;
+    cfg.regalloc = (lr_session_regalloc_t)7;
+    s = lr_session_create(&cfg, &err);
+    TEST_ASSERT(s == NULL, "unknown regalloc rejected");
+    TEST_ASSERT_EQ(err.code, LR_ERR_ARGUMENT, "unknown regalloc is an argument error");
+
+    cfg.regalloc = LR_SESSION_REGALLOC_LINEAR_SCAN;
+    s = lr_session_create(&cfg, &err);
+    TEST_ASSERT(s != NULL, "session create with linear scan");
+
+    i64 = lr_type_i64_s(s);
+    params[0] = i64;
+    params[1] = i64;
+    rc = lr_session_func_begin(s, "session_regalloc", i64, params, 2, false, &err);
+    TEST_ASSERT_EQ(rc, 0, "func begin");
+    a = lr_session_param(s, 0);
+    b = lr_session_param(s, 1);
+    rc = lr_session_set_block(s, lr_session_block(s), &err);
+    TEST_ASSERT_EQ(rc, 0, "set block");
+    prod = lr_emit_mul(s, i64, LR_VREG(a, i64), LR_VREG(b, i64));
+    sum = lr_emit_add(s, i64, LR_VREG(a, i64), LR_VREG(b, i64));
+    sum = lr_emit_sub(s, i64, LR_VREG(prod, i64), LR_VREG(sum, i64));
+    lr_emit_ret(s, LR_VREG(sum, i64));
+    rc = lr_session_func_end(s, &addr, &err);
+    TEST_ASSERT_EQ(rc, 0, "func end");
+    TEST_ASSERT(addr != NULL, "compiled function address");
+
+    fn_ptr_cast(&fn, addr);
+    TEST_ASSERT_EQ(fn(6, 7), 29, "linear-scan session result");
+
+    lr_session_destroy(s);
+    return 0;
+}
+
+int test_session_target_features_config(void) {
+    static const char *const specs[] = {"baseline", "host"};
+    lr_session_config_t cfg = {0};
+    lr_error_t err;
+    lr_session_t *s;
+
+    cfg.mode = LR_MODE_DIRECT;
+    cfg.backend = LR_SESSION_BACKEND_ISEL;
+    cfg.target_features = "host,+no-such-feature";
+    s = lr_session_create(&cfg, &err);
+    TEST_ASSERT(s == NULL, "unknown target feature rejected");
+    TEST_ASSERT_EQ(err.code, LR_ERR_ARGUMENT,
+                   "unknown target feature is an argument error");
+
+    /* The same shifts compile with and without the optional extensions
+       (shlx/sarx under BMI2) and agree. */
+    for (size_t i = 0; i < sizeof(specs) / sizeof(specs[0]); i++) {
+        lr_type_t *i64;
+        lr_type_t *params[2];
+        uint32_t a, b, shl, sar;
+        void *addr = NULL;
+        typedef int64_t (*fn_t)(int64_t, int64_t);
+        fn_t fn;
+        int rc;
+
+        cfg.target_features = specs[i];
+        s = lr_session_create(&cfg, &err);
+        TEST_ASSERT(s != NULL, "session create with target features");
+
+        i64 = lr_type_i64_s(s);
+        params[0] = i64;
+        params[1] = i64;
+        rc = lr_session_func_begin(s, "session_features", i64, params, 2,
+                                   false, &err);
+        TEST_ASSERT_EQ(rc, 0, "func begin");
+        a = lr_session_param(s, 0);
+        b = lr_session_param(s, 1);
+        rc = lr_session_set_block(s, lr_session_block(s), &err);
+        TEST_ASSERT_EQ(rc, 0, "set block");
+        shl = lr_emit_shl(s, i64, LR_VREG(a, i64), LR_VREG(b, i64));
+        sar = lr_emit_ashr(s, i64, LR_VREG(a, i64), LR_VREG(b, i64));
+        shl = lr_emit_add(s, i64, LR_VREG(shl, i64), LR_VREG(sar, i64));
+        lr_emit_ret(s, LR_VREG(shl, i64));
+        rc = lr_session_func_end(s, &addr, &err);
+        TEST_ASSERT_EQ(rc, 0, "func end");
+        TEST_ASSERT(addr != NULL, "compiled function address");
+
+        fn_ptr_cast(&fn, addr);
+        TEST_ASSERT_EQ(fn(-96, 3), -768 + -12, "shift result");
+        TEST_ASSERT_EQ(fn(5, 40), (int64_t)5 << 40, "wide shift result");
+
+        lr_session_destroy(s);
+    }
+    return 0;
+}
+
 int test_session_direct_llvm_mode_stream_contract(void) {
     lr_session_config_t cfg = {0};
     lr_error_t err = {0};
@@ -1353,6 +1456,62 @@ int test_session_loop_phi(void) {
     return 0;
 }
 
+int test_session_switch_many_cases(void) {
+    lr_session_config_t cfg = {0};
+    lr_error_t err;
+    lr_session_t *s = lr_session_create(&cfg, &err);
+    TEST_ASSERT(s != NULL, "session create");
+
+    lr_type_t *i32 = lr_type_i32_s(s);
+    lr_type_t *params[] = {i32};
+    int64_t case_vals[200];
+    uint32_t case_blocks[200];
+
+    int rc = lr_session_func_begin(s, "session_switch", i32, params, 1, false, &err);
+    TEST_ASSERT_EQ(rc, 0, "func begin");
+
+    uint32_t vx = lr_session_param(s, 0);
+    uint32_t entry_id = lr_session_block(s);
+    uint32_t dest_ids[3];
+    for (uint32_t i = 0; i < 3; i++)
+        dest_ids[i] = lr_session_block(s);
+    uint32_t def_id = lr_session_block(s);
+
+    /* More cases than one emit call carries: exercises the spill chain. */
+    for (uint32_t i = 0; i < 200; i++) {
+        case_vals[i] = (int64_t)i * 3 - 100;
+        case_blocks[i] = dest_ids[i % 3];
+    }
+
+    lr_session_set_block(s, entry_id, &err);
+    lr_emit_switch(s, LR_VREG(vx, i32), def_id, case_vals, case_blocks, 200);
+
+    for (uint32_t i = 0; i < 3; i++) {
+        lr_session_set_block(s, dest_ids[i], &err);
+        lr_emit_ret(s, LR_IMM(i + 1, i32));
+    }
+    lr_session_set_block(s, def_id, &err);
+    lr_emit_ret(s, LR_IMM(0, i32));
+
+    void *addr = NULL;
+    rc = lr_session_func_end(s, &addr, &err);
+    TEST_ASSERT_EQ(rc, 0, "func end");
+
+    typedef int (*fn_t)(int);
+    fn_t fn;
+    fn_ptr_cast(&fn, addr);
+    TEST_ASSERT_EQ(fn(-100), 1, "first case");
+    TEST_ASSERT_EQ(fn(-97), 2, "second case");
+    TEST_ASSERT_EQ(fn(281), 2, "case in first spill block");
+    TEST_ASSERT_EQ(fn(497), 2, "last case");
+    TEST_ASSERT_EQ(fn(494), 1, "case in last spill block");
+    TEST_ASSERT_EQ(fn(-99), 0, "gap goes to default");
+    TEST_ASSERT_EQ(fn(500), 0, "past the last case goes to default");
+
+    lr_session_destroy(s);
+    return 0;
+}
+
 int test_session_call(void) {
     lr_session_config_t cfg = {0};
     lr_error_t err;
@@ -1401,6 +1560,92 @@ int test_session_call(void) {
     return 0;
 }
 
+/* A two-block helper built before its caller is inlined into it at
+   opt_level 1 and called out of line at opt_level 0. */
+static int session_inline_case(int opt_level, int *a_out, int *b_out,
+                               bool *caller_calls) {
+    lr_session_config_t cfg = {0};
+    lr_error_t err;
+    cfg.opt_level = opt_level;
+    lr_session_t *s = lr_session_create(&cfg, &err);
+    if (!s)
+        return -1;
+
+    lr_type_t *i32 = lr_type_i32_s(s);
+    lr_type_t *i1 = lr_type_i1_s(s);
+    lr_type_t *ptr = lr_type_ptr_s(s);
+    lr_type_t *params[] = {i32};
+
+    /* define i32 @abs(i32 %x): two returns */
+    if (lr_session_func_begin(s, "session_inl_abs", i32, params, 1, false,
+                              &err) != 0)
+        return -1;
+    uint32_t x = lr_session_param(s, 0);
+    uint32_t entry = lr_session_block(s);
+    uint32_t neg = lr_session_block(s);
+    uint32_t pos = lr_session_block(s);
+    lr_session_set_block(s, entry, &err);
+    uint32_t lt = lr_emit_icmp(s, LR_CMP_SLT, LR_VREG(x, i32), LR_IMM(0, i32));
+    lr_emit_condbr(s, LR_VREG(lt, i1), neg, pos);
+    lr_session_set_block(s, neg, &err);
+    uint32_t nx = lr_emit_sub(s, i32, LR_IMM(0, i32), LR_VREG(x, i32));
+    lr_emit_ret(s, LR_VREG(nx, i32));
+    lr_session_set_block(s, pos, &err);
+    lr_emit_ret(s, LR_VREG(x, i32));
+    if (lr_session_func_end(s, NULL, &err) != 0)
+        return -1;
+
+    /* define i32 @dist(i32 %a): abs(a - 5) + 1 */
+    if (lr_session_func_begin(s, "session_inl_dist", i32, params, 1, false,
+                              &err) != 0)
+        return -1;
+    uint32_t a = lr_session_param(s, 0);
+    uint32_t b0 = lr_session_block(s);
+    lr_session_set_block(s, b0, &err);
+    uint32_t d = lr_emit_sub(s, i32, LR_VREG(a, i32), LR_IMM(5, i32));
+    uint32_t abs_sym = lr_session_intern(s, "session_inl_abs");
+    lr_operand_desc_t args[] = {LR_VREG(d, i32)};
+    uint32_t r = lr_emit_call(s, i32, LR_GLOBAL(abs_sym, ptr), args, 1);
+    uint32_t r1 = lr_emit_add(s, i32, LR_VREG(r, i32), LR_IMM(1, i32));
+    lr_emit_ret(s, LR_VREG(r1, i32));
+    void *addr = NULL;
+    if (lr_session_func_end(s, &addr, &err) != 0 || !addr)
+        return -1;
+
+    typedef int (*fn_t)(int);
+    fn_t fn;
+    fn_ptr_cast(&fn, addr);
+    *a_out = fn(2);
+    *b_out = fn(9);
+
+    *caller_calls = false;
+    for (lr_func_t *f = lr_session_module(s)->first_func; f; f = f->next) {
+        if (strcmp(f->name, "session_inl_dist") != 0)
+            continue;
+        for (lr_block_t *bb = f->first_block; bb; bb = bb->next)
+            for (lr_inst_t *inst = bb->first; inst; inst = inst->next)
+                if (inst->op == LR_OP_CALL)
+                    *caller_calls = true;
+    }
+
+    lr_session_destroy(s);
+    return 0;
+}
+
+int test_session_direct_inline_small_helper(void) {
+    for (int level = 0; level < 2; level++) {
+        int a = 0, b = 0;
+        bool calls = false;
+        TEST_ASSERT_EQ(session_inline_case(level, &a, &b, &calls), 0,
+                       "session build");
+        TEST_ASSERT_EQ(a, 4, "dist(2) == 4");
+        TEST_ASSERT_EQ(b, 5, "dist(9) == 5");
+        TEST_ASSERT(calls == (level == 0),
+                    "helper inlined only at opt_level 1");
+    }
+    return 0;
+}
+
 int test_session_operand_global_offset_propagates_to_ir(void) {
     lr_session_config_t cfg = {0};
     lr_error_t err;
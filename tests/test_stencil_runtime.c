@@ -26,10 +26,44 @@ int test_stencil_runtime_lookup_known_entries(void) {
 }
 
 int test_stencil_runtime_lookup_unknown_entry_returns_null(void) {
-    TEST_ASSERT(lr_stencil_lookup_for_ir(LR_OP_MUL, LR_TYPE_I64) == NULL,
+    TEST_ASSERT(lr_stencil_lookup_for_ir(LR_OP_FREM, LR_TYPE_DOUBLE) == NULL,
                 "unsupported opcode lookup");
-    TEST_ASSERT(lr_stencil_lookup_for_ir(LR_OP_ADD, LR_TYPE_I64) == NULL,
+    TEST_ASSERT(lr_stencil_lookup_for_ir(LR_OP_ADD, LR_TYPE_STRUCT) == NULL,
                 "unsupported opcode/type pair lookup");
+    TEST_ASSERT(lr_stencil_lookup_ex(LR_OP_SDIV, LR_TYPE_I32, 0,
+                                     LR_STENCIL_FORM_FRAME) == NULL,
+                "unsupported operand form lookup");
+    return 0;
+}
+
+int test_stencil_runtime_lookup_keyed_entries(void) {
+#if defined(__linux__) && (defined(__x86_64__) || defined(_M_X64))
+    const lr_stencil_t *st;
+    st = lr_stencil_lookup_ex(LR_OP_ICMP, LR_TYPE_I32, LR_ICMP_SLT, 0);
+    TEST_ASSERT(st != NULL && strcmp(st->name, "icmp_slt_i32") == 0,
+                "icmp predicate key");
+    st = lr_stencil_lookup_ex(LR_OP_ADD, LR_TYPE_I64, 0, LR_STENCIL_FORM_IMM);
+    TEST_ASSERT(st != NULL && strcmp(st->name, "add_i64_imm") == 0,
+                "immediate form key");
+    st = lr_stencil_lookup_ex(LR_OP_SITOFP, LR_TYPE_I32, LR_TYPE_DOUBLE, 0);
+    TEST_ASSERT(st != NULL && strcmp(st->name, "sitofp_i32_f64") == 0,
+                "conversion destination key");
+    st = lr_stencil_lookup_ex(LR_OP_STORE, LR_TYPE_I8, 0,
+                              LR_STENCIL_FORM_FRAME | LR_STENCIL_FORM_IMM);
+    TEST_ASSERT(st != NULL && strcmp(st->name, "store_i8_frame_imm") == 0,
+                "frame+immediate form key");
+    st = lr_stencil_lookup_ex(LR_OP_CALL, LR_TYPE_I64, 2, 0);
+    TEST_ASSERT(st != NULL && strcmp(st->name, "call_i64_2") == 0,
+                "call arity key");
+    TEST_ASSERT(lr_stencil_hole_offset(st, LR_STENCIL_HOLE_FUNC_ADDR) >= 0,
+                "call stencil has callee hole");
+    st = lr_stencil_lookup_for_ir(LR_OP_BR, LR_TYPE_VOID);
+    TEST_ASSERT(st != NULL &&
+                lr_stencil_hole_offset(st, LR_STENCIL_HOLE_BRANCH_REL) >= 0,
+                "br stencil has branch hole");
+    TEST_ASSERT(lr_stencil_hole_offset(st, LR_STENCIL_HOLE_IMM64) < 0,
+                "br stencil has no immediate hole");
+#endif
     return 0;
 }
 
@@ -1,7 +1,9 @@
 #include "../src/arena.h"
 #include "../src/ir.h"
+#include "../src/ll_parser.h"
 #include "../src/target_shared.h"
 #include <stdio.h>
+#include <string.h>
 
 #define TEST_ASSERT(cond, msg) do { \
     if (!(cond)) { \
@@ -216,10 +218,12 @@ int test_ir_finalize_peephole_constant_identity_and_branch(void) {
 int test_ir_finalize_redundant_load_elimination(void) {
     lr_arena_t *arena = lr_arena_create(0);
     lr_module_t *mod = lr_module_create(arena);
-    lr_func_t *func = lr_func_create(mod, "redundant_load", mod->type_i32, NULL, 0, false);
+    lr_type_t *params[1] = { mod->type_ptr };
+    lr_func_t *func = lr_func_create(mod, "redundant_load", mod->type_i32, params, 1, false);
     lr_block_t *entry = lr_block_create(func, arena, "entry");
 
-    uint32_t ptr = lr_vreg_new(func);
+    /* Memory behind a pointer argument: a local alloca would be promoted. */
+    uint32_t ptr = func->param_vregs[0];
     uint32_t load0 = lr_vreg_new(func);
     uint32_t load1 = lr_vreg_new(func);
     uint32_t sum = lr_vreg_new(func);
@@ -235,7 +239,6 @@ int test_ir_finalize_redundant_load_elimination(void) {
     };
     lr_operand_t ret_ops[1] = { lr_op_vreg(sum, mod->type_i32) };
 
-    lr_block_append(entry, lr_inst_create(arena, LR_OP_ALLOCA, mod->type_i32, ptr, NULL, 0));
     lr_block_append(entry, lr_inst_create(arena, LR_OP_STORE, mod->type_void, 0, store_ops, 2));
     lr_block_append(entry, lr_inst_create(arena, LR_OP_LOAD, mod->type_i32, load0, load_ptr_ops, 1));
     lr_block_append(entry, lr_inst_create(arena, LR_OP_LOAD, mod->type_i32, load1, load_ptr_ops, 1));
@@ -245,12 +248,12 @@ int test_ir_finalize_redundant_load_elimination(void) {
     TEST_ASSERT_EQ(lr_func_finalize(func, arena), 0, "finalize succeeds");
     TEST_ASSERT_EQ(count_block_opcode(entry, LR_OP_LOAD), 1,
                    "second load from same address is eliminated");
-    TEST_ASSERT_EQ(entry->inst_array[3]->op, LR_OP_ADD, "add stays in expected slot");
-    TEST_ASSERT_EQ(entry->inst_array[3]->operands[0].kind, LR_VAL_VREG, "add lhs remains vreg");
-    TEST_ASSERT_EQ(entry->inst_array[3]->operands[1].kind, LR_VAL_VREG, "add rhs remains vreg");
-    TEST_ASSERT_EQ(entry->inst_array[3]->operands[0].vreg, load0,
+    TEST_ASSERT_EQ(entry->inst_array[2]->op, LR_OP_ADD, "add stays in expected slot");
+    TEST_ASSERT_EQ(entry->inst_array[2]->operands[0].kind, LR_VAL_VREG, "add lhs remains vreg");
+    TEST_ASSERT_EQ(entry->inst_array[2]->operands[1].kind, LR_VAL_VREG, "add rhs remains vreg");
+    TEST_ASSERT_EQ(entry->inst_array[2]->operands[0].vreg, load0,
                    "add lhs uses first load result");
-    TEST_ASSERT_EQ(entry->inst_array[3]->operands[1].vreg, load0,
+    TEST_ASSERT_EQ(entry->inst_array[2]->operands[1].vreg, load0,
                    "add rhs reuses first load result");
 
     lr_arena_destroy(arena);
@@ -260,11 +263,12 @@ int test_ir_finalize_redundant_load_elimination(void) {
 int test_ir_finalize_redundant_load_kept_after_store(void) {
     lr_arena_t *arena = lr_arena_create(0);
     lr_module_t *mod = lr_module_create(arena);
+    lr_type_t *params[1] = { mod->type_ptr };
     lr_func_t *func = lr_func_create(mod, "redundant_load_store_barrier",
-                                     mod->type_i32, NULL, 0, false);
+                                     mod->type_i32, params, 1, false);
     lr_block_t *entry = lr_block_create(func, arena, "entry");
 
-    uint32_t ptr = lr_vreg_new(func);
+    uint32_t ptr = func->param_vregs[0];
     uint32_t load0 = lr_vreg_new(func);
     uint32_t load1 = lr_vreg_new(func);
     uint32_t sum = lr_vreg_new(func);
@@ -284,7 +288,6 @@ int test_ir_finalize_redundant_load_kept_after_store(void) {
     };
     lr_operand_t ret_ops[1] = { lr_op_vreg(sum, mod->type_i32) };
 
-    lr_block_append(entry, lr_inst_create(arena, LR_OP_ALLOCA, mod->type_i32, ptr, NULL, 0));
     lr_block_append(entry, lr_inst_create(arena, LR_OP_STORE, mod->type_void, 0, store0_ops, 2));
     lr_block_append(entry, lr_inst_create(arena, LR_OP_LOAD, mod->type_i32, load0, load_ptr_ops, 1));
     lr_block_append(entry, lr_inst_create(arena, LR_OP_STORE, mod->type_void, 0, store1_ops, 2));
@@ -295,10 +298,10 @@ int test_ir_finalize_redundant_load_kept_after_store(void) {
     TEST_ASSERT_EQ(lr_func_finalize(func, arena), 0, "finalize succeeds");
     TEST_ASSERT_EQ(count_block_opcode(entry, LR_OP_LOAD), 2,
                    "store invalidates load cache and keeps second load");
-    TEST_ASSERT_EQ(entry->inst_array[5]->op, LR_OP_ADD, "add stays in expected slot");
-    TEST_ASSERT_EQ(entry->inst_array[5]->operands[0].vreg, load0,
+    TEST_ASSERT_EQ(entry->inst_array[4]->op, LR_OP_ADD, "add stays in expected slot");
+    TEST_ASSERT_EQ(entry->inst_array[4]->operands[0].vreg, load0,
                    "add lhs remains first load");
-    TEST_ASSERT_EQ(entry->inst_array[5]->operands[1].vreg, load1,
+    TEST_ASSERT_EQ(entry->inst_array[4]->operands[1].vreg, load1,
                    "add rhs keeps second load");
 
     lr_arena_destroy(arena);
@@ -445,3 +448,1074 @@ int test_ir_phi_copies_flat_arrays_preserve_emission_order(void) {
     lr_arena_destroy(arena);
     return 0;
 }
+
+int test_target_shared_live_ranges_widen_over_loops(void) {
+    const char *src =
+        "define i64 @f(i64 %n) {\n"
+        "entry:\n"
+        "  %pre = add i64 %n, 1\n"
+        "  %step = mul i64 %pre, 2\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %i = phi i64 [ 0, %entry ], [ %i1, %loop ]\n"
+        "  %i1 = add i64 %i, %step\n"
+        "  %c = icmp slt i64 %i1, %n\n"
+        "  br i1 %c, label %loop, label %done\n"
+        "done:\n"
+        "  ret i64 %i1\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    char err[256] = {0};
+    lr_module_t *m = lr_parse_ll_text(src, strlen(src), arena, err, sizeof(err));
+    TEST_ASSERT(m != NULL, err);
+    lr_func_t *func = m->first_func;
+    lr_live_ranges_t lr;
+
+    TEST_ASSERT(lr_target_compute_live_ranges(func, arena, &lr) != 0,
+                "unfinalized function is rejected");
+    TEST_ASSERT_EQ(lr_func_finalize(func, arena), 0, "finalize succeeds");
+    TEST_ASSERT_EQ(func->num_linear_insts, 8, "no instruction folded away");
+    TEST_ASSERT_EQ(lr_target_compute_live_ranges(func, arena, &lr), 0,
+                   "live ranges computed");
+
+    uint32_t n = func->param_vregs[0];
+    uint32_t pre = func->linear_inst_array[0]->dest;
+    uint32_t step = func->linear_inst_array[1]->dest;
+    uint32_t i = func->linear_inst_array[3]->dest;
+    uint32_t i1 = func->linear_inst_array[4]->dest;
+
+    TEST_ASSERT_EQ(lr.start[n], 0, "param live from entry");
+    TEST_ASSERT_EQ(lr.end[n], 7, "param used in loop lives to the back edge");
+    TEST_ASSERT_EQ(lr.start[pre], 1, "pre starts at its definition");
+    TEST_ASSERT_EQ(lr.end[pre], 2, "pre dies before the loop");
+    TEST_ASSERT_EQ(lr.end[step], 7, "loop-invariant lives through the loop");
+    TEST_ASSERT_EQ(lr.start[i], 3, "phi written at the entry edge");
+    TEST_ASSERT_EQ(lr.end[i], 7, "phi written again at the back edge");
+    TEST_ASSERT_EQ(lr.start[i1], 4, "loop value widened to loop head");
+    TEST_ASSERT_EQ(lr.end[i1], 8, "loop value reaches its use after the loop");
+
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+static lr_switch_lowering_t plan_switch_kind(lr_arena_t *arena, lr_type_t *ty,
+                                             const int64_t *vals,
+                                             const uint32_t *dests,
+                                             uint32_t n,
+                                             lr_switch_plan_t *plan) {
+    lr_operand_t ops[2 + 2 * 16];
+    ops[0] = lr_op_vreg(1, ty);
+    ops[1] = lr_op_block(0);
+    for (uint32_t i = 0; i < n; i++) {
+        ops[2 + 2 * i] = lr_op_imm_i64(vals[i], ty);
+        ops[3 + 2 * i] = lr_op_block(dests[i]);
+    }
+    if (lr_target_plan_switch(ops, 2 + 2 * n, arena, plan) != 0)
+        return (lr_switch_lowering_t)-1;
+    return plan->kind;
+}
+
+int test_target_shared_plan_switch(void) {
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *mod = lr_module_create(arena);
+    lr_switch_plan_t plan;
+
+    const int64_t dense[] = {14, 10, 11, 12, 13, 12};
+    const uint32_t dense_dests[] = {1, 2, 3, 4, 5, 6};
+    TEST_ASSERT_EQ(plan_switch_kind(arena, mod->type_i32, dense, dense_dests,
+                                    6, &plan),
+                   LR_SWITCH_LOWER_JUMP_TABLE, "dense cases use a jump table");
+    TEST_ASSERT_EQ(plan.num_cases, 5, "duplicate case dropped");
+    TEST_ASSERT_EQ(plan.min, 10, "minimum case value");
+    TEST_ASSERT_EQ(plan.range, 4, "case value range");
+    TEST_ASSERT_EQ(plan.cases[0].value, 10, "cases sorted by value");
+    TEST_ASSERT_EQ(plan.dests[plan.cases[2].dest], 4,
+                   "first duplicate case wins");
+    TEST_ASSERT_EQ(plan.dests[0], 0, "dest 0 is the default block");
+
+    const int64_t vowels[] = {'a', 'e', 'i', 'o', 'u'};
+    const uint32_t vowel_dests[] = {1, 1, 1, 1, 1};
+    TEST_ASSERT_EQ(plan_switch_kind(arena, mod->type_i8, vowels, vowel_dests,
+                                    5, &plan),
+                   LR_SWITCH_LOWER_BIT_TEST, "one-dest cluster uses bit tests");
+    TEST_ASSERT_EQ(plan.num_dests, 2, "default plus one case dest");
+    TEST_ASSERT_EQ(plan.bit_masks[1],
+                   (1u << 0) | (1u << 4) | (1u << 8) | (1u << 14) | (1u << 20),
+                   "bit mask covers every vowel");
+
+    const int64_t sparse[] = {-7, 3, 900, 70000, 5000000000LL};
+    const uint32_t sparse_dests[] = {1, 2, 1, 2, 3};
+    TEST_ASSERT_EQ(plan_switch_kind(arena, mod->type_i64, sparse, sparse_dests,
+                                    5, &plan),
+                   LR_SWITCH_LOWER_TREE, "sparse cases use a search tree");
+    TEST_ASSERT_EQ(plan.cases[0].value, 3, "unsigned order puts small values first");
+    TEST_ASSERT_EQ(plan.cases[4].value, (uint64_t)-7, "negative values sort last");
+
+    const int64_t narrow[] = {-1, 255, 0, 1};
+    const uint32_t narrow_dests[] = {1, 2, 3, 4};
+    TEST_ASSERT_EQ(plan_switch_kind(arena, mod->type_i8, narrow, narrow_dests,
+                                    4, &plan),
+                   LR_SWITCH_LOWER_TREE, "wide i8 range stays a tree");
+    TEST_ASSERT_EQ(plan.num_cases, 3, "-1 and 255 are the same i8 case");
+    TEST_ASSERT_EQ(plan.cases[2].value, 255, "case values zero-extended");
+
+    /* Many cases over a few hundred repeated dests exercise the dest map. */
+    {
+        enum { NBIG = 4096 };
+        lr_operand_t *big = lr_arena_array(arena, lr_operand_t, 2 + 2 * NBIG);
+        big[0] = lr_op_vreg(1, mod->type_i32);
+        big[1] = lr_op_block(7);
+        for (uint32_t i = 0; i < NBIG; i++) {
+            big[2 + 2 * i] = lr_op_imm_i64((int64_t)i * 3, mod->type_i32);
+            big[3 + 2 * i] = lr_op_block(i % 300 == 0 ? 7 : 1000 + i % 300);
+        }
+        TEST_ASSERT_EQ(lr_target_plan_switch(big, 2 + 2 * NBIG, arena, &plan),
+                       0, "large switch planned");
+        TEST_ASSERT_EQ(plan.num_cases, NBIG, "every large case kept");
+        TEST_ASSERT_EQ(plan.num_dests, 300, "default plus 299 case dests");
+        TEST_ASSERT_EQ(plan.dests[0], 7, "default stays dest 0");
+        TEST_ASSERT_EQ(plan.dests[plan.cases[0].dest], 7,
+                       "case reusing the default block maps to dest 0");
+        TEST_ASSERT_EQ(plan.dests[plan.cases[301].dest], 1001,
+                       "repeated dest resolves to its first index");
+        TEST_ASSERT_EQ(plan.cases[301].dest, plan.cases[1].dest,
+                       "same block shares one dest index");
+    }
+
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_target_shared_classify_int_intrinsic(void) {
+    uint8_t bits = 0;
+
+    TEST_ASSERT_EQ(lr_target_classify_int_intrinsic("llvm.smax.i32", &bits),
+                   LR_INT_INTRIN_SMAX, "smax classified");
+    TEST_ASSERT_EQ(bits, 32, "smax width");
+    TEST_ASSERT_EQ(lr_target_classify_int_intrinsic("\1_llvm.ctlz.i16", &bits),
+                   LR_INT_INTRIN_CTLZ, "mangled ctlz classified");
+    TEST_ASSERT_EQ(bits, 16, "ctlz width");
+    TEST_ASSERT_EQ(lr_target_classify_int_intrinsic("llvm.fshr.i8", &bits),
+                   LR_INT_INTRIN_FSHR, "fshr classified");
+    TEST_ASSERT_EQ(bits, 8, "fshr width");
+    TEST_ASSERT_EQ(lr_target_classify_int_intrinsic("llvm.ctpop.i128", &bits),
+                   LR_INT_INTRIN_NONE, "i128 is not expanded");
+    TEST_ASSERT_EQ(lr_target_classify_int_intrinsic("llvm.abs.v4i32", &bits),
+                   LR_INT_INTRIN_NONE, "vector forms are not expanded");
+    TEST_ASSERT_EQ(lr_target_classify_int_intrinsic("llvm.umax.i64x", &bits),
+                   LR_INT_INTRIN_NONE, "suffix must match exactly");
+    TEST_ASSERT_EQ(lr_target_classify_int_intrinsic("umax.i64", &bits),
+                   LR_INT_INTRIN_NONE, "llvm prefix required");
+    TEST_ASSERT_EQ(lr_target_classify_int_intrinsic(NULL, &bits),
+                   LR_INT_INTRIN_NONE, "null name");
+    return 0;
+}
+
+int test_target_shared_mem_inline_plan(void) {
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *mod = lr_module_create(arena);
+    lr_mem_inline_stats_t stats;
+    lr_operand_t ops[5];
+    uint32_t len = 0;
+    bool small_ok;
+
+    memset(&stats, 0, sizeof(stats));
+    TEST_ASSERT_EQ(lr_target_classify_mem_intrinsic("llvm.memcpy.p0.p0.i64"),
+                   LR_MEM_INTRIN_MEMCPY, "memcpy classified");
+    TEST_ASSERT_EQ(lr_target_classify_mem_intrinsic("llvm.memset.p0i8.i32"),
+                   LR_MEM_INTRIN_MEMSET, "memset classified");
+    TEST_ASSERT_EQ(lr_target_classify_mem_intrinsic("llvm.memmove.p0.p0.i64"),
+                   LR_MEM_INTRIN_NONE, "memmove is not expanded");
+    TEST_ASSERT_EQ(lr_target_classify_mem_intrinsic("memcpy"),
+                   LR_MEM_INTRIN_NONE, "plain libc name is not expanded");
+
+    ops[0] = lr_op_global(0, mod->type_ptr);
+    ops[1] = lr_op_vreg(1, mod->type_ptr);
+    ops[2] = lr_op_vreg(2, mod->type_ptr);
+    ops[3] = lr_op_imm_i64(24, mod->type_i64);
+    ops[4] = lr_op_imm_i64(0, mod->type_i1);
+    small_ok = lr_target_mem_inline_limit() >= 24;
+    TEST_ASSERT_EQ(lr_target_mem_inline_plan(LR_MEM_INTRIN_MEMCPY, ops, 5,
+                                             &stats, &len),
+                   small_ok, "small constant memcpy follows the limit");
+    TEST_ASSERT_EQ(len, small_ok ? 24 : 0, "inline length");
+
+    ops[3] = lr_op_imm_i64((int64_t)lr_target_mem_inline_limit() + 1,
+                           mod->type_i64);
+    TEST_ASSERT(!lr_target_mem_inline_plan(LR_MEM_INTRIN_MEMSET, ops, 5,
+                                           &stats, &len),
+                "length above the limit calls out");
+    ops[3] = lr_op_vreg(3, mod->type_i64);
+    TEST_ASSERT(!lr_target_mem_inline_plan(LR_MEM_INTRIN_MEMCPY, ops, 5,
+                                           &stats, &len),
+                "variable length calls out");
+
+    TEST_ASSERT_EQ(stats.memcpy_inlined, small_ok ? 1 : 0, "memcpy inlined count");
+    TEST_ASSERT_EQ(stats.memcpy_called, small_ok ? 1 : 2, "memcpy called count");
+    TEST_ASSERT_EQ(stats.memset_inlined, 0, "memset inlined count");
+    TEST_ASSERT_EQ(stats.memset_called, 1, "memset called count");
+    TEST_ASSERT_EQ(stats.bytes_inlined, small_ok ? 24 : 0, "inlined byte count");
+
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_target_shared_slot_coloring(void) {
+    const char *src =
+        "declare void @use(ptr)\n"
+        "define i64 @f(i64 %n) {\n"
+        "entry:\n"
+        "  %a = alloca [4 x i64]\n"
+        "  %b = alloca [4 x i64]\n"
+        "  %c = alloca [4 x i64]\n"
+        "  %a1 = getelementptr i64, ptr %a, i64 1\n"
+        "  store i64 %n, ptr %a1\n"
+        "  %x = load i64, ptr %a\n"
+        "  %b1 = getelementptr i64, ptr %b, i64 1\n"
+        "  store i64 %x, ptr %b1\n"
+        "  %y = load i64, ptr %b\n"
+        "  call void @use(ptr %c)\n"
+        "  ret i64 %y\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    char err[256] = {0};
+    lr_module_t *m = lr_parse_ll_text(src, strlen(src), arena, err, sizeof(err));
+    TEST_ASSERT(m != NULL, err);
+    lr_func_t *func = m->first_func;
+    while (func && func->is_decl)
+        func = func->next;
+    TEST_ASSERT(func != NULL, "function found");
+    TEST_ASSERT_EQ(lr_func_finalize(func, arena), 0, "finalize succeeds");
+    TEST_ASSERT_EQ(func->num_linear_insts, 11, "no instruction folded away");
+
+    lr_slot_coloring_t *sc = lr_target_slot_coloring_create(func, m, arena);
+    TEST_ASSERT(sc != NULL, "coloring available");
+    uint32_t a = func->linear_inst_array[0]->dest;
+    uint32_t b = func->linear_inst_array[1]->dest;
+    uint32_t c = func->linear_inst_array[2]->dest;
+    uint32_t x = func->linear_inst_array[5]->dest;
+    uint32_t y = func->linear_inst_array[8]->dest;
+    uint32_t stack = 0;
+
+    TEST_ASSERT_EQ(lr_target_frame_slot(sc, a, true, 32, 8, &stack), -32,
+                   "first alloca gets a fresh slot");
+    TEST_ASSERT_EQ(lr_target_frame_slot(sc, b, true, 32, 8, &stack), -32,
+                   "alloca used after the first dies shares its memory");
+    TEST_ASSERT_EQ(lr_target_frame_slot(sc, c, true, 32, 8, &stack), -64,
+                   "alloca passed to a call is never merged");
+    TEST_ASSERT_EQ(lr_target_frame_slot(sc, x, false, 8, 8, &stack), -72,
+                   "value slot");
+    TEST_ASSERT_EQ(lr_target_frame_slot(sc, y, false, 8, 8, &stack), -72,
+                   "disjoint value reuses the slot");
+    TEST_ASSERT_EQ(lr_target_frame_slot(sc, func->next_vreg + 3u, false, 8, 8,
+                                        &stack), -80,
+                   "backend temporary gets a fresh slot");
+    TEST_ASSERT_EQ(stack, 80, "frame grows only for fresh slots");
+
+    lr_target_slot_coloring_reset_stats();
+    lr_target_slot_coloring_report("test", "f", sc, stack);
+    TEST_ASSERT_EQ(lr_target_slot_coloring_slots_reused(), 2, "reuses counted");
+    TEST_ASSERT_EQ(lr_target_slot_coloring_bytes_saved(), 40, "bytes saved");
+
+    stack = 0;
+    TEST_ASSERT_EQ(lr_target_frame_slot(NULL, x, false, 8, 8, &stack), -8,
+                   "no coloring: plain bump allocation");
+    TEST_ASSERT_EQ(lr_target_frame_slot(NULL, y, false, 8, 8, &stack), -16,
+                   "no coloring: every value gets its own slot");
+
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_target_shared_const_pool(void) {
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_const_pool_t pool;
+    lr_operand_t op;
+    lr_type_t f32_ty, f64_ty;
+    uint64_t bits = 0;
+
+    memset(&f32_ty, 0, sizeof(f32_ty));
+    memset(&f64_ty, 0, sizeof(f64_ty));
+    f32_ty.kind = LR_TYPE_FLOAT;
+    f64_ty.kind = LR_TYPE_DOUBLE;
+    memset(&op, 0, sizeof(op));
+    op.kind = LR_VAL_IMM_F64;
+    op.imm_f64 = 1.5;
+    op.type = &f32_ty;
+    TEST_ASSERT(lr_target_imm_bits(&op, &bits), "float immediate has bits");
+    TEST_ASSERT_EQ(bits, 0x3FC00000u, "float immediate as f32 bits");
+    op.type = &f64_ty;
+    TEST_ASSERT(lr_target_imm_bits(&op, &bits), "double immediate has bits");
+    TEST_ASSERT_EQ(bits, 0x3FF8000000000000ull, "double immediate bits");
+    op.kind = LR_VAL_NULL;
+    TEST_ASSERT(lr_target_imm_bits(&op, &bits) && bits == 0, "null is zero");
+    op.kind = LR_VAL_VREG;
+    TEST_ASSERT(!lr_target_imm_bits(&op, &bits), "vreg is not constant");
+
+    lr_target_const_pool_init(&pool);
+    if (!pool.enabled) {
+        TEST_ASSERT_EQ(lr_target_const_pool_use(&pool, arena, 1, 0), -1,
+                       "disabled pool records nothing");
+        lr_arena_destroy(arena);
+        return 0;
+    }
+    TEST_ASSERT_EQ(lr_target_const_pool_use(&pool, arena, 0x3FF8000000000000ull,
+                                            10), 0, "first use");
+    TEST_ASSERT_EQ(lr_target_const_pool_use(&pool, arena, 0x3FC00000u, 20), 0,
+                   "second constant");
+    TEST_ASSERT_EQ(lr_target_const_pool_use(&pool, arena, 0x3FF8000000000000ull,
+                                            30), 0, "repeated constant");
+    TEST_ASSERT_EQ(pool.num_entries, 2, "entries deduplicated by bits");
+    TEST_ASSERT_EQ(pool.num_refs, 3, "every load recorded");
+    TEST_ASSERT_EQ(pool.refs[2].entry, 0, "repeat shares the first entry");
+    TEST_ASSERT_EQ(pool.refs[2].pos, 30, "load position kept");
+
+    for (uint64_t i = 0; i < 200; i++)
+        TEST_ASSERT_EQ(lr_target_const_pool_use(&pool, arena, i * 977u + 5u,
+                                                40 + i), 0, "bulk use");
+    TEST_ASSERT_EQ(pool.num_entries, 202, "distinct constants get entries");
+    TEST_ASSERT_EQ(lr_target_const_pool_use(&pool, arena, 5u + 977u * 150u,
+                                            999), 0, "lookup after growth");
+    TEST_ASSERT_EQ(pool.num_entries, 202, "still deduplicated after growth");
+    TEST_ASSERT_EQ(pool.refs[pool.num_refs - 1].entry, 152,
+                   "found the existing entry");
+    TEST_ASSERT_EQ(pool.entries[152], 5u + 977u * 150u, "entry bits");
+
+    lr_target_const_pool_reset_stats();
+    lr_target_const_pool_report("test", "f", &pool);
+    TEST_ASSERT_EQ(lr_target_const_pool_loads(), 204, "loads counted");
+    TEST_ASSERT_EQ(lr_target_const_pool_entries(), 202, "entries counted");
+
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+/* Run steps over a register file and check parallel-copy semantics. */
+static int pcopy_check(const uint32_t *dests, const lr_operand_t *srcs,
+                       uint32_t n, const lr_pcopy_step_t *steps, int num_steps) {
+    int64_t regs[16], want[16], scratch = -1;
+    for (uint32_t v = 0; v < 16; v++)
+        regs[v] = want[v] = 100 + v;
+    for (uint32_t i = 0; i < n; i++)
+        want[dests[i]] = srcs[i].kind == LR_VAL_VREG ? regs[srcs[i].vreg]
+                                                      : srcs[i].imm_i64;
+    for (int s = 0; s < num_steps; s++) {
+        uint32_t k = steps[s].index;
+        if (steps[s].kind == LR_PCOPY_SAVE)
+            scratch = regs[dests[k]];
+        else if (steps[s].kind == LR_PCOPY_RESTORE)
+            regs[dests[k]] = scratch;
+        else
+            regs[dests[k]] = srcs[k].kind == LR_VAL_VREG
+                                 ? regs[srcs[k].vreg] : srcs[k].imm_i64;
+    }
+    for (uint32_t v = 0; v < 16; v++) {
+        if (regs[v] != want[v])
+            return 0;
+    }
+    return 1;
+}
+
+int test_target_shared_parallel_copies(void) {
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_pcopy_step_t steps[16];
+    lr_operand_t srcs[8];
+    int num_steps, saves = 0;
+
+    /* 1 <- 2, 2 <- 1 (swap), 3 <- 3 (self), 4 <- 1 (reads a swapped dest),
+       5 <- 7 <- 6 <- 5 (rotation), 8 <- imm. */
+    const uint32_t dests[8] = {1, 2, 3, 4, 5, 7, 6, 8};
+    const uint32_t from[8] = {2, 1, 3, 1, 7, 6, 5, 0};
+    memset(srcs, 0, sizeof(srcs));
+    for (uint32_t i = 0; i < 8; i++) {
+        srcs[i].kind = LR_VAL_VREG;
+        srcs[i].vreg = from[i];
+    }
+    srcs[7].kind = LR_VAL_IMM_I64;
+    srcs[7].imm_i64 = 42;
+
+    num_steps = lr_target_sequence_parallel_copies(dests, srcs, 8, arena,
+                                                   steps);
+    TEST_ASSERT(num_steps > 0, "sequence built");
+    TEST_ASSERT(pcopy_check(dests, srcs, 8, steps, num_steps),
+                "sequential steps match parallel semantics");
+    for (int s = 0; s < num_steps; s++) {
+        TEST_ASSERT(steps[s].index != 2, "self copy dropped");
+        if (steps[s].kind == LR_PCOPY_SAVE)
+            saves++;
+    }
+    TEST_ASSERT_EQ(saves, 2, "one scratch save per cycle");
+    TEST_ASSERT_EQ(num_steps, 9, "seven copies plus two saves");
+
+    /* Chains without cycles need no scratch. */
+    {
+        const uint32_t cd[3] = {1, 2, 3};
+        srcs[0].kind = LR_VAL_VREG; srcs[0].vreg = 2;
+        srcs[1].kind = LR_VAL_VREG; srcs[1].vreg = 3;
+        srcs[2].kind = LR_VAL_VREG; srcs[2].vreg = 4;
+        num_steps = lr_target_sequence_parallel_copies(cd, srcs, 3, arena,
+                                                       steps);
+        TEST_ASSERT_EQ(num_steps, 3, "chain is three moves");
+        TEST_ASSERT(pcopy_check(cd, srcs, 3, steps, num_steps),
+                    "chain ordered");
+        for (int s = 0; s < num_steps; s++)
+            TEST_ASSERT_EQ(steps[s].kind, LR_PCOPY_MOVE, "chain has no saves");
+    }
+
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_target_shared_fast_cc_assign(void) {
+    lr_arena_t *arena = lr_arena_create(0);
+    lr_module_t *mod = lr_module_create(arena);
+    lr_type_t *types[12];
+    lr_cc_loc_t locs[12];
+    uint32_t stack;
+
+    /* Eight integers and four doubles on six GP and eight FP registers:
+       the last two integers spill into the FP file, not the stack. */
+    for (uint32_t i = 0; i < 8; i++)
+        types[i] = mod->type_i64;
+    for (uint32_t i = 8; i < 12; i++)
+        types[i] = mod->type_double;
+    stack = lr_target_fast_cc_assign(types, 12, 6, 8, locs);
+    TEST_ASSERT_EQ(stack, 0, "no stack slots");
+    TEST_ASSERT_EQ(locs[5].kind, LR_CC_LOC_GP, "sixth int in GP");
+    TEST_ASSERT_EQ(locs[5].index, 5, "sixth int register");
+    TEST_ASSERT_EQ(locs[6].kind, LR_CC_LOC_FP, "seventh int borrows FP");
+    TEST_ASSERT_EQ(locs[6].index, 0, "first FP register");
+    TEST_ASSERT_EQ(locs[7].index, 1, "second FP register");
+    TEST_ASSERT_EQ(locs[8].kind, LR_CC_LOC_FP, "double in FP");
+    TEST_ASSERT_EQ(locs[8].index, 2, "doubles follow borrowed registers");
+    TEST_ASSERT_EQ(locs[11].index, 5, "last double");
+
+    /* Twelve floats: eight FP registers, then the GP file, then stack. */
+    for (uint32_t i = 0; i < 12; i++)
+        types[i] = mod->type_float;
+    stack = lr_target_fast_cc_assign(types, 12, 2, 8, locs);
+    TEST_ASSERT_EQ(locs[7].kind, LR_CC_LOC_FP, "eighth float in FP");
+    TEST_ASSERT_EQ(locs[8].kind, LR_CC_LOC_GP, "ninth float borrows GP");
+    TEST_ASSERT_EQ(locs[9].index, 1, "second GP register");
+    TEST_ASSERT_EQ(locs[10].kind, LR_CC_LOC_STACK, "both files full");
+    TEST_ASSERT_EQ(locs[10].index, 0, "first stack slot");
+    TEST_ASSERT_EQ(locs[11].index, 1, "second stack slot");
+    TEST_ASSERT_EQ(stack, 2, "two stack slots");
+
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+static bool cold_block_named(const lr_func_t *func, const bool *cold,
+                             const char *name) {
+    for (const lr_block_t *b = func->first_block; b; b = b->next) {
+        if (b->name && strcmp(b->name, name) == 0)
+            return cold[b->id];
+    }
+    return false;
+}
+
+int test_target_shared_cold_blocks(void) {
+    const char *src =
+        "declare void @_lcompilers_runtime_error(ptr)\n"
+        "define i64 @f(ptr %p, i64 %n) {\n"
+        "entry:\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %i = phi i64 [ 0, %entry ], [ %i1, %body ]\n"
+        "  %bad = icmp slt i64 %i, 0\n"
+        "  br i1 %bad, label %report, label %check\n"
+        "report:\n"
+        "  call void @_lcompilers_runtime_error(ptr %p)\n"
+        "  br label %trap\n"
+        "check:\n"
+        "  %big = icmp sgt i64 %i, 100\n"
+        "  br i1 %big, label %trap, label %body\n"
+        "trap:\n"
+        "  unreachable\n"
+        "body:\n"
+        "  %i1 = add i64 %i, 1\n"
+        "  %more = icmp slt i64 %i1, %n\n"
+        "  br i1 %more, label %loop, label %done\n"
+        "done:\n"
+        "  ret i64 %i1\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    char err[256] = {0};
+    lr_module_t *m = lr_parse_ll_text(src, strlen(src), arena, err, sizeof(err));
+    TEST_ASSERT(m != NULL, err);
+    lr_func_t *func = m->first_func;
+    while (func && func->is_decl)
+        func = func->next;
+    TEST_ASSERT(func != NULL, "function found");
+    TEST_ASSERT_EQ(lr_func_finalize(func, arena), 0, "finalize succeeds");
+
+    bool *cold = lr_arena_array(arena, bool, func->num_blocks);
+    TEST_ASSERT(cold != NULL, "alloc");
+    TEST_ASSERT_EQ(lr_target_cold_blocks(func, cold), 2, "two cold blocks");
+    TEST_ASSERT(cold_block_named(func, cold, "report"),
+                "runtime error call is cold");
+    TEST_ASSERT(cold_block_named(func, cold, "trap"), "unreachable is cold");
+    TEST_ASSERT(!cold_block_named(func, cold, "check"),
+                "block with a hot successor stays hot");
+    TEST_ASSERT(!cold_block_named(func, cold, "loop"), "loop header hot");
+    TEST_ASSERT(!cold_block_named(func, cold, "body"), "loop body hot");
+    TEST_ASSERT(!cold_block_named(func, cold, "entry"), "entry hot");
+
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+static uint32_t count_func_opcode(const lr_func_t *func, lr_opcode_t op) {
+    uint32_t count = 0;
+    for (const lr_block_t *b = func->first_block; b; b = b->next) {
+        for (const lr_inst_t *inst = b->first; inst; inst = inst->next) {
+            if (inst->op == op)
+                count++;
+        }
+    }
+    return count;
+}
+
+int test_ir_promote_allocas(void) {
+    const char *src =
+        "declare void @sink(ptr)\n"
+        "define i64 @f(i64 %n, i1 %c) {\n"
+        "entry:\n"
+        "  %i = alloca i64\n"
+        "  %s = alloca i64\n"
+        "  %d = alloca double\n"
+        "  %esc = alloca i64\n"
+        "  store i64 0, ptr %i\n"
+        "  store i64 0, ptr %s\n"
+        "  store i64 7, ptr %esc\n"
+        "  call void @sink(ptr %esc)\n"
+        "  br i1 %c, label %set, label %loop\n"
+        "set:\n"
+        "  store double 1.5, ptr %d\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %iv = load i64, ptr %i\n"
+        "  %sv = load i64, ptr %s\n"
+        "  %s1 = add i64 %sv, %iv\n"
+        "  store i64 %s1, ptr %s\n"
+        "  %i1 = add i64 %iv, 1\n"
+        "  store i64 %i1, ptr %i\n"
+        "  %more = icmp slt i64 %i1, %n\n"
+        "  br i1 %more, label %loop, label %done\n"
+        "done:\n"
+        "  %r = load i64, ptr %s\n"
+        "  %e = load i64, ptr %esc\n"
+        "  %t = add i64 %r, %e\n"
+        "  ret i64 %t\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    char err[256] = {0};
+    lr_module_t *m = lr_parse_ll_text(src, strlen(src), arena, err, sizeof(err));
+    TEST_ASSERT(m != NULL, err);
+    lr_func_t *func = m->first_func;
+    while (func && func->is_decl)
+        func = func->next;
+    TEST_ASSERT(func != NULL, "function found");
+    func->block_array = lr_arena_array(arena, lr_block_t *, func->num_blocks);
+    TEST_ASSERT(func->block_array != NULL, "alloc");
+    for (lr_block_t *b = func->first_block; b; b = b->next)
+        func->block_array[b->id] = b;
+
+    TEST_ASSERT_EQ(lr_func_promote_allocas(func, arena), 3,
+                   "i, s and the store-only double are promoted");
+    TEST_ASSERT_EQ(count_func_opcode(func, LR_OP_ALLOCA), 1,
+                   "escaping alloca kept");
+    TEST_ASSERT_EQ(count_func_opcode(func, LR_OP_STORE), 1,
+                   "only the escaping store remains");
+    TEST_ASSERT_EQ(count_func_opcode(func, LR_OP_LOAD), 1,
+                   "only the escaping load remains");
+    /* i and s merge at the loop header; the double is never loaded, so
+       pruning gives it no phi at the join. */
+    TEST_ASSERT_EQ(count_func_opcode(func, LR_OP_PHI), 2,
+                   "phis for the loop-carried slots only");
+
+    TEST_ASSERT_EQ(lr_func_promote_allocas(func, arena), 0,
+                   "second run finds nothing left");
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_ir_finalize_promotes_from_opt1(void) {
+    const char *src =
+        "define i64 @f(i64 %n) {\n"
+        "entry:\n"
+        "  %s = alloca i64\n"
+        "  store i64 %n, ptr %s\n"
+        "  %v = load i64, ptr %s\n"
+        "  ret i64 %v\n"
+        "}\n";
+    /* O0 keeps the frame slot: mem2reg is a compile-time cost. */
+    for (int level = 0; level < 2; level++) {
+        lr_arena_t *arena = lr_arena_create(0);
+        char err[256] = {0};
+        lr_module_t *m = lr_parse_ll_text(src, strlen(src), arena, err,
+                                          sizeof(err));
+        TEST_ASSERT(m != NULL, err);
+        m->opt_level = level;
+        TEST_ASSERT_EQ(lr_func_finalize(m->first_func, arena), 0, "finalize");
+        TEST_ASSERT_EQ(count_func_opcode(m->first_func, LR_OP_ALLOCA),
+                       level == 0 ? 1 : 0, "alloca promoted from opt_level 1");
+        lr_arena_destroy(arena);
+    }
+    return 0;
+}
+
+int test_ir_value_number(void) {
+    const char *src =
+        "define i64 @f(ptr %a, i64 %i, i64 %m, i1 %c) {\n"
+        "entry:\n"
+        "  %off = mul i64 %i, %m\n"
+        "  %p = getelementptr i8, ptr %a, i64 %off\n"
+        "  %v = load i8, ptr %p\n"
+        "  %vz = zext i8 %v to i64\n"
+        "  br i1 %c, label %left, label %right\n"
+        "left:\n"
+        "  %off2 = mul i64 %m, %i\n"
+        "  %p2 = getelementptr i8, ptr %a, i64 %off2\n"
+        "  %w = load i8, ptr %p2\n"
+        "  %wz = zext i8 %w to i64\n"
+        "  %x = add i64 %vz, 7\n"
+        "  %s = add i64 %x, %wz\n"
+        "  br label %join\n"
+        "right:\n"
+        "  %d = sub i64 %vz, %i\n"
+        "  %d2 = sub i64 %i, %vz\n"
+        "  %y = add i64 %vz, 7\n"
+        "  %e = xor i64 %d, %d2\n"
+        "  %z = add i64 %y, %e\n"
+        "  br label %join\n"
+        "join:\n"
+        "  %r = phi i64 [ %s, %left ], [ %z, %right ]\n"
+        "  %off3 = mul i64 %i, %m\n"
+        "  %t = add i64 %r, %off3\n"
+        "  ret i64 %t\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    char err[256] = {0};
+    lr_module_t *m = lr_parse_ll_text(src, strlen(src), arena, err, sizeof(err));
+    TEST_ASSERT(m != NULL, err);
+    lr_func_t *func = m->first_func;
+    TEST_ASSERT(func != NULL, "function found");
+    func->block_array = lr_arena_array(arena, lr_block_t *, func->num_blocks);
+    TEST_ASSERT(func->block_array != NULL, "alloc");
+    for (lr_block_t *b = func->first_block; b; b = b->next)
+        func->block_array[b->id] = b;
+
+    /* off2 (commuted), p2 and off3 repeat dominating values; x and y are
+       equal but sit in sibling blocks, and d2 swaps a sub's operands. */
+    TEST_ASSERT_EQ(lr_func_value_number(func, arena), 3,
+                   "three redundant computations removed");
+    TEST_ASSERT_EQ(count_func_opcode(func, LR_OP_MUL), 1, "one mul left");
+    TEST_ASSERT_EQ(count_func_opcode(func, LR_OP_GEP), 1, "one gep left");
+    TEST_ASSERT_EQ(count_func_opcode(func, LR_OP_SUB), 2, "subs kept");
+    TEST_ASSERT_EQ(count_func_opcode(func, LR_OP_ADD), 5,
+                   "sibling adds kept");
+
+    /* Uses now name the leader, with their own operand types. */
+    for (lr_block_t *b = func->first_block; b; b = b->next) {
+        for (lr_inst_t *inst = b->first; inst; inst = inst->next) {
+            if (inst->op == LR_OP_LOAD) {
+                TEST_ASSERT(inst->operands[0].kind == LR_VAL_VREG &&
+                            inst->operands[0].type == m->type_ptr,
+                            "load address keeps ptr type");
+            }
+        }
+    }
+    const lr_inst_t *ld0 = func->first_block->first->next->next;
+    const lr_inst_t *ld1 = func->first_block->next->first;
+    TEST_ASSERT(ld0->op == LR_OP_LOAD && ld1->op == LR_OP_LOAD,
+                "loads in place");
+    TEST_ASSERT_EQ(ld1->operands[0].vreg, ld0->operands[0].vreg,
+                   "both loads read the same gep");
+
+    TEST_ASSERT_EQ(lr_func_value_number(func, arena), 0,
+                   "second run finds nothing left");
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_ir_value_number_vector_types(void) {
+    /* Each <4 x i32> is its own type object: values match structurally. */
+    const char *src =
+        "define <4 x i32> @f(<4 x i32> %a, <4 x i32> %b, i1 %c) {\n"
+        "entry:\n"
+        "  %s = add <4 x i32> %a, %b\n"
+        "  br i1 %c, label %then, label %done\n"
+        "then:\n"
+        "  %t = add <4 x i32> %b, %a\n"
+        "  %u = mul <4 x i32> %t, %s\n"
+        "  ret <4 x i32> %u\n"
+        "done:\n"
+        "  ret <4 x i32> %s\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    char err[256] = {0};
+    lr_module_t *m = lr_parse_ll_text(src, strlen(src), arena, err, sizeof(err));
+    TEST_ASSERT(m != NULL, err);
+    lr_func_t *func = m->first_func;
+    func->block_array = lr_arena_array(arena, lr_block_t *, func->num_blocks);
+    TEST_ASSERT(func->block_array != NULL, "alloc");
+    for (lr_block_t *b = func->first_block; b; b = b->next)
+        func->block_array[b->id] = b;
+
+    lr_block_t *entry = func->first_block, *then = entry->next;
+    TEST_ASSERT(entry->first->type != then->first->type,
+                "parser gives each vector type its own object");
+    TEST_ASSERT_EQ(lr_func_value_number(func, arena), 1,
+                   "commuted vector add removed");
+    TEST_ASSERT(then->first->op == LR_OP_MUL &&
+                then->first->operands[0].vreg == entry->first->dest,
+                "mul reads the dominating add");
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_ir_value_number_multi_def(void) {
+    const char *src =
+        "@g = global i64 0\n"
+        "declare i64 @noisy()\n"
+        "define i64 @f(i64 %x) {\n"
+        "entry:\n"
+        "  %a = ptrtoint ptr @g to i64\n"
+        "  %u = add i64 %a, 1\n"
+        "  %k = mul i64 %x, 3\n"
+        "  call i64 @noisy()\n"
+        "  %b = ptrtoint ptr @g to i64\n"
+        "  %u2 = add i64 %a, 1\n"
+        "  %k2 = mul i64 %x, 3\n"
+        "  %d = sub i64 %b, %u2\n"
+        "  %e = add i64 %d, %k2\n"
+        "  %r = add i64 %e, %u\n"
+        "  ret i64 %r\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    char err[256] = {0};
+    lr_module_t *m = lr_parse_ll_text(src, strlen(src), arena, err, sizeof(err));
+    TEST_ASSERT(m != NULL, err);
+    lr_func_t *func = m->first_func;
+    while (func && func->is_decl)
+        func = func->next;
+    TEST_ASSERT(func != NULL, "definition");
+    func->block_array = lr_arena_array(arena, lr_block_t *, func->num_blocks);
+    TEST_ASSERT(func->block_array != NULL, "alloc");
+    for (lr_block_t *b = func->first_block; b; b = b->next)
+        func->block_array[b->id] = b;
+
+    /* Let the call overwrite a, as a dest-0 call once did: the
+       recomputed ptrtoint and a + 1 after it are not redundant, while
+       x * 3 still is. */
+    lr_inst_t *a = func->first_block->first, *call = a;
+    while (call->op != LR_OP_CALL)
+        call = call->next;
+    TEST_ASSERT(call->dest != a->dest, "unnamed call has its own vreg");
+    call->dest = a->dest;
+    TEST_ASSERT_EQ(lr_func_value_number(func, arena), 1,
+                   "only the multiply removed");
+    TEST_ASSERT_EQ(count_func_opcode(func, LR_OP_PTRTOINT), 2,
+                   "ptrtoint after the call kept");
+    TEST_ASSERT_EQ(count_func_opcode(func, LR_OP_MUL), 1, "one mul left");
+    TEST_ASSERT_EQ(count_func_opcode(func, LR_OP_ADD), 4, "adds kept");
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+static uint32_t block_id_named(const lr_func_t *func, const char *name) {
+    for (const lr_block_t *b = func->first_block; b; b = b->next) {
+        if (b->name && strcmp(b->name, name) == 0)
+            return b->id;
+    }
+    return UINT32_MAX;
+}
+
+int test_ir_cfg_loops(void) {
+    const char *src =
+        "define i64 @f(i64 %n) {\n"
+        "entry:\n"
+        "  br label %outer\n"
+        "outer:\n"
+        "  %i = phi i64 [ 0, %entry ], [ %i1, %olatch ]\n"
+        "  br label %inner\n"
+        "inner:\n"
+        "  %j = phi i64 [ 0, %outer ], [ %j1, %inner ]\n"
+        "  %j1 = add i64 %j, 1\n"
+        "  %jc = icmp slt i64 %j1, %n\n"
+        "  br i1 %jc, label %inner, label %olatch\n"
+        "olatch:\n"
+        "  %i1 = add i64 %i, 1\n"
+        "  %ic = icmp slt i64 %i1, %n\n"
+        "  br i1 %ic, label %outer, label %done\n"
+        "dead:\n"
+        "  br label %inner\n"
+        "done:\n"
+        "  ret i64 %i1\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    char err[256] = {0};
+    lr_module_t *m = lr_parse_ll_text(src, strlen(src), arena, err, sizeof(err));
+    TEST_ASSERT(m != NULL, err);
+    lr_func_t *func = m->first_func;
+    TEST_ASSERT(func != NULL, "function found");
+    TEST_ASSERT(lr_func_cfg(func, arena) == NULL, "no cfg before block_array");
+    func->block_array = lr_arena_array(arena, lr_block_t *, func->num_blocks);
+    TEST_ASSERT(func->block_array != NULL, "alloc");
+    for (lr_block_t *b = func->first_block; b; b = b->next)
+        func->block_array[b->id] = b;
+
+    uint32_t entry = block_id_named(func, "entry");
+    uint32_t outer = block_id_named(func, "outer");
+    uint32_t inner = block_id_named(func, "inner");
+    uint32_t olatch = block_id_named(func, "olatch");
+    uint32_t dead = block_id_named(func, "dead");
+    uint32_t done = block_id_named(func, "done");
+    const lr_cfg_t *priv = lr_func_build_cfg(func, arena);
+    TEST_ASSERT(priv != NULL && func->cfg == NULL, "private cfg not cached");
+    const lr_cfg_t *g = lr_func_cfg(func, arena);
+    TEST_ASSERT(g != NULL && g != priv, "cfg built");
+    TEST_ASSERT(lr_func_cfg(func, arena) == g, "cfg cached");
+    TEST_ASSERT_EQ(priv->num_loops, 2, "private cfg sees both loops");
+
+    TEST_ASSERT_EQ(g->pred_off[inner + 1u] - g->pred_off[inner], 3,
+                   "inner has three predecessors, dead block included");
+    TEST_ASSERT_EQ(g->succ_off[olatch + 1u] - g->succ_off[olatch], 2,
+                   "latch has two successors");
+    TEST_ASSERT_EQ(g->num_rpo, 5, "dead block is unreachable");
+    TEST_ASSERT_EQ(g->rpo[0], entry, "rpo starts at entry");
+    TEST_ASSERT_EQ(g->rpo_num[dead], UINT32_MAX, "dead has no rpo number");
+    TEST_ASSERT_EQ(g->idom[inner], outer, "idom ignores the dead edge");
+    TEST_ASSERT_EQ(g->idom[done], olatch, "idom of exit");
+    TEST_ASSERT(lr_cfg_dominates(g, outer, done), "header dominates exit");
+    TEST_ASSERT(lr_cfg_dominates(g, inner, inner), "dominance is reflexive");
+    TEST_ASSERT(!lr_cfg_dominates(g, inner, outer), "inner not over outer");
+    TEST_ASSERT(!lr_cfg_dominates(g, entry, dead), "dead is dominated by none");
+
+    TEST_ASSERT_EQ(g->num_loops, 2, "two natural loops");
+    TEST_ASSERT_EQ(g->loop_depth[entry], 0, "entry outside loops");
+    TEST_ASSERT_EQ(g->loop_depth[outer], 1, "outer header depth");
+    TEST_ASSERT_EQ(g->loop_depth[inner], 2, "inner loop depth");
+    TEST_ASSERT_EQ(g->loop_depth[olatch], 1, "outer latch depth");
+    TEST_ASSERT_EQ(g->loop_depth[done], 0, "exit depth");
+    TEST_ASSERT_EQ(g->loop_depth[dead], 0, "dead block in no loop");
+    TEST_ASSERT_EQ(g->loop_header[olatch], outer, "latch in outer loop");
+    TEST_ASSERT_EQ(g->loop_header[inner], inner, "innermost header");
+    TEST_ASSERT_EQ(g->loop_parent[inner], outer, "inner nests in outer");
+    TEST_ASSERT_EQ(g->loop_parent[outer], UINT32_MAX, "outer is top level");
+
+    lr_block_t *extra = lr_block_create(func, arena, "extra");
+    TEST_ASSERT(extra != NULL, "block created");
+    TEST_ASSERT(func->cfg == NULL, "new block invalidates the cfg");
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+/* Like count_block_opcode, over the instruction list of an unfinalized
+   block. */
+static uint32_t count_list_opcode(const lr_block_t *b, lr_opcode_t op) {
+    uint32_t count = 0;
+    for (const lr_inst_t *inst = b->first; inst; inst = inst->next) {
+        if (inst->op == op)
+            count++;
+    }
+    return count;
+}
+
+int test_ir_optimize_loops(void) {
+    const char *src =
+        "define i64 @f(ptr %p, i64 %a, i64 %n) {\n"
+        "entry:\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %i = phi i64 [ 0, %entry ], [ %i1, %loop ]\n"
+        "  %s = phi i64 [ 0, %entry ], [ %s1, %loop ]\n"
+        "  %k = mul i64 %a, %a\n"
+        "  %v = load i64, ptr %p\n"
+        "  %x = mul i64 %i, 12\n"
+        "  %y = add i64 %x, %k\n"
+        "  %z = add i64 %y, %v\n"
+        "  %s1 = add i64 %s, %z\n"
+        "  %i1 = add i64 %i, 1\n"
+        "  %c = icmp slt i64 %i1, %n\n"
+        "  br i1 %c, label %loop, label %done\n"
+        "done:\n"
+        "  ret i64 %s1\n"
+        "}\n"
+        "define void @g(ptr %p, ptr %q, i64 %n) {\n"
+        "entry:\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %i = phi i64 [ 0, %entry ], [ %i1, %loop ]\n"
+        "  %v = load i64, ptr %p\n"
+        "  %d = udiv i64 %n, %i\n"
+        "  %w = add i64 %v, %d\n"
+        "  %gp = getelementptr i64, ptr %q, i64 %i\n"
+        "  store i64 %w, ptr %gp\n"
+        "  %i1 = add i64 %i, 1\n"
+        "  %c = icmp slt i64 %i1, %n\n"
+        "  br i1 %c, label %loop, label %done\n"
+        "done:\n"
+        "  ret void\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    char err[256] = {0};
+    lr_module_t *m = lr_parse_ll_text(src, strlen(src), arena, err, sizeof(err));
+    TEST_ASSERT(m != NULL, err);
+    for (lr_func_t *func = m->first_func; func; func = func->next) {
+        func->block_array = lr_arena_array(arena, lr_block_t *,
+                                           func->num_blocks);
+        TEST_ASSERT(func->block_array != NULL, "alloc");
+        for (lr_block_t *b = func->first_block; b; b = b->next)
+            func->block_array[b->id] = b;
+    }
+
+    /* k and v move to entry; i*12 becomes a phi stepped by 12. */
+    lr_func_t *f = m->first_func;
+    lr_block_t *entry = f->block_array[block_id_named(f, "entry")];
+    lr_block_t *loop = f->block_array[block_id_named(f, "loop")];
+    TEST_ASSERT_EQ(lr_func_optimize_loops(f, arena), 3,
+                   "two hoists and one reduced multiply");
+    TEST_ASSERT_EQ(count_list_opcode(entry, LR_OP_MUL), 1, "mul hoisted");
+    TEST_ASSERT_EQ(count_list_opcode(entry, LR_OP_LOAD), 1, "load hoisted");
+    TEST_ASSERT(entry->last->op == LR_OP_BR, "branch stays last");
+    TEST_ASSERT_EQ(count_list_opcode(loop, LR_OP_MUL), 0, "no mul in loop");
+    TEST_ASSERT_EQ(count_list_opcode(loop, LR_OP_PHI), 3, "new phi");
+    const lr_inst_t *iv = loop->first;
+    TEST_ASSERT(iv->op == LR_OP_PHI && iv->operands[0].kind == LR_VAL_IMM_I64 &&
+                iv->operands[0].imm_i64 == 0, "new phi starts at 0 * 12");
+    const lr_inst_t *bump = NULL;
+    for (const lr_inst_t *inst = loop->first; inst; inst = inst->next) {
+        if (inst->dest == iv->operands[2].vreg && inst->op == LR_OP_ADD)
+            bump = inst;
+    }
+    TEST_ASSERT(bump != NULL && bump->operands[1].kind == LR_VAL_IMM_I64 &&
+                bump->operands[1].imm_i64 == 12, "new phi steps by 1 * 12");
+    TEST_ASSERT_EQ(lr_func_optimize_loops(f, arena), 0,
+                   "second run finds nothing left");
+
+    /* The store may alias p, and n / i can trap: both stay put. */
+    lr_func_t *g = f->next;
+    TEST_ASSERT_EQ(lr_func_optimize_loops(g, arena), 0, "nothing moves");
+    loop = g->block_array[block_id_named(g, "loop")];
+    TEST_ASSERT_EQ(count_list_opcode(loop, LR_OP_LOAD), 1, "load kept");
+    TEST_ASSERT_EQ(count_list_opcode(loop, LR_OP_UDIV), 1, "udiv kept");
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_ir_optimize_loops_multi_def(void) {
+    const char *src =
+        "declare i32 @ext(i32)\n"
+        "define i32 @f(i32 %n) {\n"
+        "entry:\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %i = phi i32 [ 0, %entry ], [ %i1, %loop ]\n"
+        "  %m = mul i32 %i, 3\n"
+        "  %i1 = add i32 %i, 1\n"
+        "  %c = icmp slt i32 %i1, %n\n"
+        "  br i1 %c, label %loop, label %done\n"
+        "done:\n"
+        "  call i32 @ext(i32 %m)\n"
+        "  ret i32 %m\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    char err[256] = {0};
+    lr_module_t *m = lr_parse_ll_text(src, strlen(src), arena, err, sizeof(err));
+    TEST_ASSERT(m != NULL, err);
+    lr_func_t *f = m->first_func;
+    while (f && f->is_decl)
+        f = f->next;
+    TEST_ASSERT(f != NULL, "definition");
+    f->block_array = lr_arena_array(arena, lr_block_t *, f->num_blocks);
+    TEST_ASSERT(f->block_array != NULL, "alloc");
+    for (lr_block_t *b = f->first_block; b; b = b->next)
+        f->block_array[b->id] = b;
+
+    /* The unnamed call result gets a vreg nothing else defines. */
+    lr_block_t *loop = f->block_array[block_id_named(f, "loop")];
+    lr_block_t *done = f->block_array[block_id_named(f, "done")];
+    lr_inst_t *call = done->first;
+    TEST_ASSERT(call->op == LR_OP_CALL, "call first in done");
+    for (lr_block_t *b = f->first_block; b; b = b->next) {
+        for (const lr_inst_t *inst = b->first; inst; inst = inst->next)
+            TEST_ASSERT(inst == call || inst->op == LR_OP_BR ||
+                        inst->op == LR_OP_CONDBR || inst->op == LR_OP_RET ||
+                        inst->dest != call->dest, "call dest unshared");
+    }
+
+    /* A vreg written inside and outside the loop is not invariant, and
+       a phi with a second def is no induction variable. */
+    call->dest = loop->first->dest;
+    TEST_ASSERT_EQ(lr_func_optimize_loops(f, arena), 0, "nothing moves");
+    TEST_ASSERT_EQ(count_list_opcode(loop, LR_OP_MUL), 1, "mul kept");
+    TEST_ASSERT_EQ(count_list_opcode(loop, LR_OP_PHI), 1, "no new phi");
+    lr_arena_destroy(arena);
+    return 0;
+}
+
+int test_ir_inline_calls(void) {
+    const char *src =
+        "define internal i32 @clamp(i32 %x, i32 %hi) {\n"
+        "entry:\n"
+        "  %c = icmp sgt i32 %x, %hi\n"
+        "  br i1 %c, label %high, label %low\n"
+        "high:\n"
+        "  ret i32 %hi\n"
+        "low:\n"
+        "  ret i32 %x\n"
+        "}\n"
+        "define internal i32 @sq(i32 %x) {\n"
+        "entry:\n"
+        "  %t = alloca i32\n"
+        "  store i32 %x, ptr %t\n"
+        "  %v = load i32, ptr %t\n"
+        "  %m = mul i32 %v, %v\n"
+        "  %r = call i32 @clamp(i32 %m, i32 200)\n"
+        "  ret i32 %r\n"
+        "}\n"
+        "define internal i32 @fact(i32 %n) {\n"
+        "entry:\n"
+        "  %z = icmp sle i32 %n, 1\n"
+        "  br i1 %z, label %base, label %rec\n"
+        "base:\n"
+        "  ret i32 1\n"
+        "rec:\n"
+        "  %n1 = sub i32 %n, 1\n"
+        "  %f = call i32 @fact(i32 %n1)\n"
+        "  %r = mul i32 %n, %f\n"
+        "  ret i32 %r\n"
+        "}\n"
+        "define i32 @t(i32 %a) {\n"
+        "entry:\n"
+        "  %q = call i32 @sq(i32 %a)\n"
+        "  %f = call i32 @fact(i32 %a)\n"
+        "  %r = add i32 %q, %f\n"
+        "  ret i32 %r\n"
+        "}\n";
+    lr_arena_t *arena = lr_arena_create(0);
+    char err[256] = {0};
+    lr_module_t *m = lr_parse_ll_text(src, strlen(src), arena, err, sizeof(err));
+    TEST_ASSERT(m != NULL, err);
+    m->opt_level = 1;
+
+    /* clamp goes into sq, then sq into t; fact calls itself and stays. */
+    TEST_ASSERT_EQ(lr_module_inline_calls(m), 2, "two call sites inlined");
+    lr_func_t *sq = m->first_func->next;
+    lr_func_t *fact = sq->next;
+    lr_func_t *t = fact->next;
+    TEST_ASSERT(sq->acyclic && sq->inline_size > 0, "sq inlinable");
+    TEST_ASSERT(!fact->acyclic && fact->inline_size == 0, "fact kept");
+    TEST_ASSERT_EQ(count_func_opcode(sq, LR_OP_CALL), 0, "clamp inlined");
+    TEST_ASSERT_EQ(count_func_opcode(t, LR_OP_CALL), 1, "only fact called");
+    TEST_ASSERT_EQ(count_func_opcode(t, LR_OP_RET), 1, "callee rets branch");
+    TEST_ASSERT_EQ(count_list_opcode(t->first_block, LR_OP_ALLOCA), 1,
+                   "alloca moved to the caller's entry");
+    TEST_ASSERT(t->first_block->first->op == LR_OP_ALLOCA,
+                "alloca heads the entry block");
+    lr_arena_destroy(arena);
+    return 0;
+}
@@ -35,6 +35,18 @@ static int code_contains_u32_le(const uint8_t *buf, size_t len, uint32_t word) {
     return 0;
 }
 
+#if defined(__x86_64__) || defined(_M_X64)
+static size_t count_bytes(const uint8_t *buf, size_t len,
+                          const uint8_t *pat, size_t pat_len) {
+    size_t count = 0;
+    for (size_t i = 0; i + pat_len <= len; i++) {
+        if (memcmp(buf + i, pat, pat_len) == 0)
+            count++;
+    }
+    return count;
+}
+#endif
+
 static int noop_compile_begin(void **compile_ctx,
                               const lr_compile_func_meta_t *func_meta,
                               lr_module_t *mod,
@@ -242,7 +254,7 @@ int test_target_copy_patch_fallback_matches_isel_for_non_x86(void) {
     return 0;
 }
 
-int test_target_copy_patch_matches_isel_for_x86_streaming(void) {
+int test_target_copy_patch_stitches_stencils_for_x86_streaming(void) {
 #if !defined(__x86_64__) && !defined(_M_X64)
     return 0;
 #else
@@ -254,6 +266,7 @@ int test_target_copy_patch_matches_isel_for_x86_streaming(void) {
         "  %sel = select i1 %cmp, i64 %sum, i64 %b\n"
         "  ret i64 %sel\n"
         "}\n";
+    static const uint8_t mov_rdi_rbp[] = {0x48, 0x89, 0xEF};
     const lr_target_t *t = lr_target_by_name("x86_64");
     char err[256] = {0};
     lr_module_t *m = lr_parse_ll(src, strlen(src), err, sizeof(err));
@@ -286,9 +299,13 @@ int test_target_copy_patch_matches_isel_for_x86_streaming(void) {
 
     TEST_ASSERT(rc_isel == 0, "isel compile succeeds");
     TEST_ASSERT(rc_cp == 0, "copy-patch compile succeeds");
-    TEST_ASSERT(isel_len == cp_len, "copy_patch length matches isel");
-    TEST_ASSERT(memcmp(isel_buf, cp_buf, cp_len) == 0,
-                "copy_patch bytes match isel (streaming parity)");
+    /* Every stencil is entered with the frame pointer in RDI. */
+    TEST_ASSERT(count_bytes(isel_buf, isel_len, mov_rdi_rbp,
+                            sizeof(mov_rdi_rbp)) == 0,
+                "isel emits no stencil setup");
+    TEST_ASSERT(count_bytes(cp_buf, cp_len, mov_rdi_rbp,
+                            sizeof(mov_rdi_rbp)) >= 3,
+                "copy_patch stitches add/icmp/select stencils");
 
     lr_module_free(m);
     return 0;
@@ -598,6 +615,100 @@ int test_target_aarch64_streaming_hooks_smoke(void) {
     return 0;
 }
 
+static bool code_has_u32(const uint8_t *code, size_t len, uint32_t insn) {
+    for (size_t off = 0; off + 4 <= len; off += 4) {
+        uint32_t word = (uint32_t)code[off] | ((uint32_t)code[off + 1] << 8) |
+                        ((uint32_t)code[off + 2] << 16) |
+                        ((uint32_t)code[off + 3] << 24);
+        if (word == insn)
+            return true;
+    }
+    return false;
+}
+
+int test_target_aarch64_streaming_switch_jump_table(void) {
+    lr_arena_t *module_arena = lr_arena_create(0);
+    lr_arena_t *compile_arena = lr_arena_create(0);
+    lr_module_t *m = NULL;
+    const lr_target_t *t = lr_target_by_name("aarch64");
+    lr_type_t *params[1];
+    lr_operand_desc_t sw_ops[2 + 2 * 6];
+    lr_operand_desc_t ret_ops[1];
+    lr_compile_inst_desc_t desc;
+    lr_compile_func_meta_t meta;
+    void *compile_ctx = NULL;
+    uint8_t code[4096];
+    size_t code_len = 0;
+
+    TEST_ASSERT(module_arena != NULL, "arena create");
+    TEST_ASSERT(compile_arena != NULL, "compile arena create");
+    TEST_ASSERT(t != NULL, "aarch64 target exists");
+
+    m = lr_module_create(module_arena);
+    TEST_ASSERT(m != NULL, "module create");
+    params[0] = m->type_i32;
+
+    memset(&meta, 0, sizeof(meta));
+    meta.ret_type = m->type_i32;
+    meta.param_types = params;
+    meta.num_params = 1;
+    meta.next_vreg = 2;
+    meta.mode = LR_COMPILE_ISEL;
+
+    TEST_ASSERT_EQ(t->compile_begin(&compile_ctx, &meta, m, code, sizeof(code),
+                                    compile_arena),
+                   0, "compile_begin succeeds");
+    TEST_ASSERT_EQ(t->compile_set_block(compile_ctx, 0), 0, "set block 0");
+
+    /* switch i32 %1, default bb5, [0..5 -> bb1..bb4, bb1, bb2] */
+    memset(sw_ops, 0, sizeof(sw_ops));
+    sw_ops[0].kind = LR_OP_KIND_VREG;
+    sw_ops[0].type = m->type_i32;
+    sw_ops[0].vreg = 1;
+    sw_ops[1].kind = LR_OP_KIND_BLOCK;
+    sw_ops[1].block_id = 5;
+    for (uint32_t i = 0; i < 6; i++) {
+        sw_ops[2 + 2 * i].kind = LR_OP_KIND_IMM_I64;
+        sw_ops[2 + 2 * i].type = m->type_i32;
+        sw_ops[2 + 2 * i].imm_i64 = i;
+        sw_ops[3 + 2 * i].kind = LR_OP_KIND_BLOCK;
+        sw_ops[3 + 2 * i].block_id = 1 + (i % 4);
+    }
+    memset(&desc, 0, sizeof(desc));
+    desc.op = LR_OP_SWITCH;
+    desc.type = m->type_void;
+    desc.operands = sw_ops;
+    desc.num_operands = 2 + 2 * 6;
+    TEST_ASSERT_EQ(t->compile_emit(compile_ctx, &desc), 0, "emit switch");
+
+    for (uint32_t b = 1; b <= 5; b++) {
+        TEST_ASSERT_EQ(t->compile_set_block(compile_ctx, b), 0, "set block");
+        memset(ret_ops, 0, sizeof(ret_ops));
+        ret_ops[0].kind = LR_OP_KIND_IMM_I64;
+        ret_ops[0].type = m->type_i32;
+        ret_ops[0].imm_i64 = b;
+        memset(&desc, 0, sizeof(desc));
+        desc.op = LR_OP_RET;
+        desc.type = m->type_i32;
+        desc.operands = ret_ops;
+        desc.num_operands = 1;
+        TEST_ASSERT_EQ(t->compile_emit(compile_ctx, &desc), 0, "emit ret");
+    }
+
+    TEST_ASSERT_EQ(t->compile_end(compile_ctx, &code_len), 0,
+                   "compile_end succeeds");
+    TEST_ASSERT(code_has_u32(code, code_len, 0x10000000u | (4u << 5) | 10u),
+                "adr x10 addresses the inline table");
+    TEST_ASSERT(code_has_u32(code, code_len, 0xB8A97949u),
+                "ldrsw x9, [x10, x9, lsl #2] loads the table entry");
+    TEST_ASSERT(code_has_u32(code, code_len, 0xD61F0120u),
+                "br x9 dispatches through the table");
+
+    lr_arena_destroy(compile_arena);
+    lr_arena_destroy(module_arena);
+    return 0;
+}
+
 int test_target_aarch64_streaming_fp_convert_ops(void) {
     lr_arena_t *module_arena = lr_arena_create(0);
     lr_module_t *m = NULL;
@@ -807,6 +918,7 @@ int test_target_riscv64_streaming_reports_unsupported_ops(void) {
         LR_OP_PTRTOINT,
         LR_OP_SELECT,
         LR_OP_STORE,
+        LR_OP_SWITCH,
         LR_OP_UITOFP,
         LR_OP_UNREACHABLE,
     };
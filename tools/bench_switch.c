@@ -0,0 +1,231 @@
+/*
+ * bench_switch: per-dispatch cost of a multi-way branch, LR_OP_SWITCH vs an
+ * equivalent icmp/br compare chain.
+ *
+ * Generates one LLVM IR loop per form whose body dispatches a hashed loop
+ * counter across N case blocks, JITs it in-process, and reports the best
+ * ns per dispatch over several runs.  Case values are spaced by --stride,
+ * so stride 1 exercises the jump table and a large stride the search tree.
+ *
+ * Usage: ./build/bench_switch [--cases N] [--stride S] [--iters N]
+ *            [--reps N] [--backend isel|copy_patch]
+ * Output: one JSON line per form.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <liric/liric.h>
+
+#include "bench_common.h"
+
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t cap;
+} sbuf_t;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int sbuf_printf(sbuf_t *sb, const char *fmt, ...) {
+    va_list ap;
+    int n;
+    for (;;) {
+        size_t avail = sb->cap - sb->len;
+        va_start(ap, fmt);
+        n = vsnprintf(sb->buf ? sb->buf + sb->len : NULL, avail, fmt, ap);
+        va_end(ap);
+        if (n < 0)
+            return -1;
+        if ((size_t)n < avail) {
+            sb->len += (size_t)n;
+            return 0;
+        }
+        size_t new_cap = sb->cap ? sb->cap * 2 : 4096;
+        while (new_cap - sb->len <= (size_t)n)
+            new_cap *= 2;
+        char *nb = (char *)realloc(sb->buf, new_cap);
+        if (!nb)
+            return -1;
+        sb->buf = nb;
+        sb->cap = new_cap;
+    }
+}
+
+/* define i64 @run(i64 %n): sum over i < n of case_value(hash(i) % range). */
+static char *gen_ir(unsigned cases, unsigned stride, int use_switch) {
+    sbuf_t sb = {0};
+    unsigned range = cases * stride + stride;
+    int rc = 0;
+
+    rc |= sbuf_printf(&sb,
+        "define i64 @run(i64 %%n) {\n"
+        "entry:\n"
+        "  br label %%loop\n"
+        "loop:\n"
+        "  %%i = phi i64 [ 0, %%entry ], [ %%i1, %%merge ]\n"
+        "  %%acc = phi i64 [ 0, %%entry ], [ %%acc1, %%merge ]\n"
+        "  %%h = mul i64 %%i, 2654435761\n"
+        "  %%hs = lshr i64 %%h, 7\n"
+        "  %%k = urem i64 %%hs, %u\n", range);
+    if (use_switch) {
+        rc |= sbuf_printf(&sb, "  switch i64 %%k, label %%def [\n");
+        for (unsigned c = 0; c < cases; c++)
+            rc |= sbuf_printf(&sb, "    i64 %u, label %%c%u\n", c * stride, c);
+        rc |= sbuf_printf(&sb, "  ]\n");
+    } else {
+        rc |= sbuf_printf(&sb, "  br label %%chk0\n");
+        for (unsigned c = 0; c < cases; c++) {
+            rc |= sbuf_printf(&sb,
+                "chk%u:\n"
+                "  %%e%u = icmp eq i64 %%k, %u\n", c, c, c * stride);
+            if (c + 1 < cases)
+                rc |= sbuf_printf(&sb,
+                    "  br i1 %%e%u, label %%c%u, label %%chk%u\n", c, c, c + 1);
+            else
+                rc |= sbuf_printf(&sb,
+                    "  br i1 %%e%u, label %%c%u, label %%def\n", c, c);
+        }
+    }
+    for (unsigned c = 0; c < cases; c++)
+        rc |= sbuf_printf(&sb, "c%u:\n  br label %%merge\n", c);
+    rc |= sbuf_printf(&sb,
+        "def:\n  br label %%merge\n"
+        "merge:\n  %%v = phi i64 [ 0, %%def ]");
+    for (unsigned c = 0; c < cases; c++)
+        rc |= sbuf_printf(&sb, ", [ %u, %%c%u ]", c * 7u + 3u, c);
+    rc |= sbuf_printf(&sb,
+        "\n"
+        "  %%acc1 = add i64 %%acc, %%v\n"
+        "  %%i1 = add i64 %%i, 1\n"
+        "  %%more = icmp ult i64 %%i1, %%n\n"
+        "  br i1 %%more, label %%loop, label %%exit\n"
+        "exit:\n"
+        "  ret i64 %%acc1\n"
+        "}\n");
+    if (rc != 0) {
+        free(sb.buf);
+        return NULL;
+    }
+    return sb.buf;
+}
+
+static void usage(void) {
+    printf("usage: bench_switch [--cases N] [--stride S] [--iters N] [--reps N]\n"
+           "                    [--backend isel|copy_patch]\n");
+    printf("  Compares LR_OP_SWITCH dispatch against an icmp/br chain.\n");
+    printf("  Output: JSON lines to stdout (one per form).\n");
+}
+
+int main(int argc, char **argv) {
+    unsigned cases = 32;
+    unsigned stride = 1;
+    long long iters = 20000000;
+    int reps = 5;
+    lr_backend_t backend = LR_BACKEND_ISEL;
+    const char *backend_name = "isel";
+    uint64_t results[2] = {0, 0};
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cases") == 0 && i + 1 < argc) {
+            cases = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--stride") == 0 && i + 1 < argc) {
+            stride = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--iters") == 0 && i + 1 < argc) {
+            iters = strtoll(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            reps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            backend_name = argv[++i];
+            if (strcmp(backend_name, "isel") == 0) {
+                backend = LR_BACKEND_ISEL;
+            } else if (strcmp(backend_name, "copy_patch") == 0) {
+                backend = LR_BACKEND_COPY_PATCH;
+            } else {
+                fprintf(stderr, "unknown backend: %s\n", backend_name);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            usage();
+            return 0;
+        } else {
+            fprintf(stderr, "unknown arg: %s\n", argv[i]);
+            usage();
+            return 1;
+        }
+    }
+    if (cases == 0 || stride == 0 || iters <= 0 || reps <= 0) {
+        fprintf(stderr, "error: --cases, --stride, --iters and --reps must be positive\n");
+        return 1;
+    }
+
+    for (int form = 0; form < 2; form++) {
+        lr_compiler_config_t cfg;
+        lr_compiler_error_t err;
+        lr_compiler_t *c;
+        char *src = gen_ir(cases, stride, form == 0);
+        uint64_t (*run)(uint64_t);
+        double *ns = (double *)calloc((size_t)reps, sizeof(double));
+        double compile_us;
+        void *addr;
+
+        if (!src || !ns) {
+            fprintf(stderr, "out of memory\n");
+            free(src);
+            free(ns);
+            return 1;
+        }
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.backend = backend;
+        c = lr_compiler_create(&cfg, &err);
+        if (!c) {
+            fprintf(stderr, "compiler create failed: %s\n", err.msg);
+            free(src);
+            free(ns);
+            return 1;
+        }
+        compile_us = now_ns();
+        if (lr_compiler_feed_ll(c, src, strlen(src), &err) != 0 ||
+            !(addr = lr_compiler_lookup(c, "run"))) {
+            fprintf(stderr, "compile failed: %s\n", err.msg);
+            lr_compiler_destroy(c);
+            free(src);
+            free(ns);
+            return 1;
+        }
+        compile_us = (now_ns() - compile_us) / 1e3;
+        memcpy(&run, &addr, sizeof(run));
+
+        for (int r = 0; r < reps; r++) {
+            double t0 = now_ns();
+            results[form] = run((uint64_t)iters);
+            ns[r] = (now_ns() - t0) / (double)iters;
+        }
+
+        printf("{\"form\":\"%s\",\"backend\":\"%s\",\"cases\":%u,\"stride\":%u,"
+               "\"iters\":%lld,\"compile_us\":%.1f,"
+               "\"median_ns_per_dispatch\":%.3f,\"best_ns_per_dispatch\":%.3f}\n",
+               form == 0 ? "switch" : "chain", backend_name, cases, stride,
+               iters, compile_us, bench_median(ns, (size_t)reps),
+               bench_percentile(ns, (size_t)reps, 0.0));
+
+        lr_compiler_destroy(c);
+        free(src);
+        free(ns);
+    }
+
+    if (results[0] != results[1]) {
+        fprintf(stderr, "result mismatch: switch=%llu chain=%llu\n",
+                (unsigned long long)results[0], (unsigned long long)results[1]);
+        return 1;
+    }
+    return 0;
+}
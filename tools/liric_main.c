@@ -211,6 +211,7 @@ int main(int argc, char **argv) {
     const char *runtime_path = NULL;
     const char *load_libs[64];
     int num_load_libs = 0;
+    int opt_level = 0;
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--jit") == 0) jit_mode = true;
@@ -225,6 +226,9 @@ int main(int argc, char **argv) {
             else
                 return 1;
         }
+        else if (argv[i][0] == '-' && argv[i][1] == 'O' &&
+                 argv[i][2] >= '0' && argv[i][2] <= '3' && !argv[i][3])
+            opt_level = argv[i][2] - '0';
         else if (strcmp(argv[i], "-") == 0) input_file = NULL;
         else if (argv[i][0] != '-') input_file = argv[i];
         else {
@@ -285,6 +289,7 @@ int main(int argc, char **argv) {
         cfg.policy = LR_POLICY_DIRECT;
         cfg.backend = backend;
         cfg.target = target_name;
+        cfg.opt_level = opt_level;
 
         compiler = lr_compiler_create(&cfg, &cerr);
         if (!compiler) {
@@ -357,6 +362,7 @@ int main(int argc, char **argv) {
         free(src);
         return 1;
     }
+    m->opt_level = opt_level;
 
     if (runtime_path) {
         size_t rt_len;
@@ -460,10 +466,10 @@ int main(int argc, char **argv) {
         char backend_err[256] = {0};
         emit_rc = emit_object
             ? lr_emit_module_object_path_mode(m, target_name, LR_COMPILE_LLVM,
-                                              out_path, 0, backend_err,
+                                              out_path, opt_level, backend_err,
                                               sizeof(backend_err))
             : lr_emit_module_executable_path_mode(m, target_name, LR_COMPILE_LLVM,
-                                                  out_path, func_name, 0,
+                                                  out_path, func_name, opt_level,
                                                   backend_err,
                                                   sizeof(backend_err));
         if (emit_rc != 0) {
@@ -26,7 +26,7 @@ typedef struct reloc_entry {
 } reloc_entry_t;
 
 typedef struct stencil_entry {
-    char *stem;
+    char *name;
     uint8_t *text;
     size_t text_size;
     reloc_entry_t *relocs;
@@ -34,6 +34,12 @@ typedef struct stencil_entry {
     size_t reloc_cap;
 } stencil_entry_t;
 
+typedef struct stencil_list {
+    stencil_entry_t *entries;
+    size_t count;
+    size_t cap;
+} stencil_list_t;
+
 static void usage(const char *prog) {
     fprintf(stderr,
             "usage: %s --input-dir <dir> --output <header> [--compiler <cc>]\n",
@@ -206,9 +212,13 @@ static int compile_stencil_source(const char *compiler, const char *src, const c
         (char *)"-O3",
         (char *)"-fno-pic",
         (char *)"-fno-pie",
+        (char *)"-mcmodel=kernel",
         (char *)"-fno-stack-protector",
         (char *)"-fno-asynchronous-unwind-tables",
         (char *)"-fno-unwind-tables",
+        (char *)"-fno-jump-tables",
+        (char *)"-fcf-protection=none",
+        (char *)"-ffunction-sections",
         (char *)"-c",
         (char *)src,
         (char *)"-o",
@@ -294,6 +304,7 @@ static int reloc_size_for_type(uint32_t type, uint8_t *out_size) {
     case R_X86_64_32:
     case R_X86_64_32S:
     case R_X86_64_PC32:
+    case R_X86_64_PLT32:
         *out_size = 4;
         return 0;
     case R_X86_64_16:
@@ -307,6 +318,16 @@ static int reloc_size_for_type(uint32_t type, uint8_t *out_size) {
     }
 }
 
+static bool reloc_is_pcrel(uint32_t type) {
+    return type == R_X86_64_PC32 || type == R_X86_64_PLT32;
+}
+
+static bool hole_is_slot_offset(lr_stencil_hole_t hole) {
+    return hole == LR_STENCIL_HOLE_SRC0_OFF ||
+           hole == LR_STENCIL_HOLE_SRC1_OFF ||
+           hole == LR_STENCIL_HOLE_DST_OFF;
+}
+
 static int add_reloc(stencil_entry_t *entry, uint16_t offset, uint8_t size, lr_stencil_hole_t hole) {
     reloc_entry_t *next;
     if (entry->reloc_count == entry->reloc_cap) {
@@ -325,14 +346,222 @@ static int add_reloc(stencil_entry_t *entry, uint16_t offset, uint8_t size, lr_s
     return 0;
 }
 
-static int parse_elf_object(const char *obj_path, stencil_entry_t *entry) {
+static stencil_entry_t *push_entry(stencil_list_t *list, const char *name) {
+    stencil_entry_t *entry;
+    if (list->count == list->cap) {
+        size_t new_cap = list->cap ? list->cap * 2 : 64;
+        stencil_entry_t *next = (stencil_entry_t *)realloc(list->entries,
+                                                           new_cap * sizeof(*next));
+        if (!next) {
+            return NULL;
+        }
+        list->entries = next;
+        list->cap = new_cap;
+    }
+    entry = &list->entries[list->count];
+    memset(entry, 0, sizeof(*entry));
+    entry->name = dup_cstr(name);
+    if (!entry->name) {
+        return NULL;
+    }
+    list->count++;
+    return entry;
+}
+
+/*
+ * Record one relocation against a stencil section.  Absolute holes must carry
+ * a zero addend and branch holes a -4 one (rel32 measured from the end of the
+ * field), so the runtime can patch the raw value.  __hole_continue is handled
+ * here: its sites are collected in cont_offs and resolved by the caller.
+ */
+static int add_stencil_reloc(stencil_entry_t *entry, const char *obj_path,
+                             const char *sym_name, uint32_t type,
+                             uint64_t off, int64_t addend,
+                             uint16_t *cont_offs, size_t *cont_count) {
+    lr_stencil_hole_t hole = LR_STENCIL_HOLE_IMM64;
+    uint8_t patch_size = 0;
+    bool is_cont = strcmp(sym_name, "__hole_continue") == 0;
+    if (!is_cont && map_hole_symbol(sym_name, &hole) != 0) {
+        fprintf(stderr,
+                "stencil_gen: stencil '%s' in '%s' references non-hole symbol '%s'\n",
+                entry->name, obj_path, sym_name[0] ? sym_name : "<section>");
+        return -1;
+    }
+    if (reloc_size_for_type(type, &patch_size) != 0) {
+        fprintf(stderr,
+                "stencil_gen: unsupported relocation type %u for '%s'\n",
+                type, sym_name);
+        return -1;
+    }
+    if (off > UINT16_MAX || off + patch_size > entry->text_size) {
+        fprintf(stderr, "stencil_gen: relocation offset out of range in '%s'\n", obj_path);
+        return -1;
+    }
+    if (is_cont || hole == LR_STENCIL_HOLE_BRANCH_REL) {
+        if (!reloc_is_pcrel(type) || addend != -4) {
+            fprintf(stderr,
+                    "stencil_gen: '%s' in stencil '%s' is not a rel32 jump target\n",
+                    sym_name, entry->name);
+            return -1;
+        }
+    } else if (reloc_is_pcrel(type) || addend != 0) {
+        fprintf(stderr,
+                "stencil_gen: hole '%s' in stencil '%s' has an unsupported addend\n",
+                sym_name, entry->name);
+        return -1;
+    } else if (hole_is_slot_offset(hole) && type != R_X86_64_32S) {
+        fprintf(stderr,
+                "stencil_gen: slot offset '%s' in stencil '%s' is not sign-extended\n",
+                sym_name, entry->name);
+        return -1;
+    }
+    if (is_cont) {
+        if (*cont_count >= entry->text_size) {
+            return -1;
+        }
+        cont_offs[(*cont_count)++] = (uint16_t)off;
+        return 0;
+    }
+    return add_reloc(entry, (uint16_t)off, patch_size, hole);
+}
+
+/*
+ * Stencils end with a tail call to __hole_continue.  A jmp that is the last
+ * instruction is dropped so execution falls into the next stencil; any
+ * other continuation jump is pointed at the new end of the stencil.
+ */
+static int resolve_continuations(stencil_entry_t *entry,
+                                 const uint16_t *cont_offs, size_t cont_count) {
+    size_t new_size = entry->text_size;
+    size_t i;
+    for (i = 0; i < cont_count; i++) {
+        size_t off = cont_offs[i];
+        if (off + 4 == entry->text_size && off >= 1 && entry->text[off - 1] == 0xE9) {
+            new_size = off - 1;
+        }
+    }
+    for (i = 0; i < cont_count; i++) {
+        size_t off = cont_offs[i];
+        int32_t rel;
+        if (off >= new_size) {
+            continue;
+        }
+        rel = (int32_t)((int64_t)new_size - (int64_t)(off + 4));
+        memcpy(entry->text + off, &rel, sizeof(rel));
+    }
+    for (i = 0; i < entry->reloc_count; i++) {
+        if ((size_t)entry->relocs[i].offset + entry->relocs[i].size > new_size) {
+            fprintf(stderr, "stencil_gen: hole after continuation in stencil '%s'\n",
+                    entry->name);
+            return -1;
+        }
+    }
+    entry->text_size = new_size;
+    return 0;
+}
+
+static int parse_stencil_section(const uint8_t *data, size_t size, const char *obj_path,
+                                 const Elf64_Ehdr *eh, const Elf64_Shdr *shdrs,
+                                 uint16_t text_index, const Elf64_Sym *syms,
+                                 size_t sym_count, const char *sym_names,
+                                 stencil_entry_t *entry) {
+    const Elf64_Shdr *text = &shdrs[text_index];
+    uint16_t *cont_offs;
+    size_t cont_count = 0;
+    uint16_t i;
+    int rc = -1;
+    if (text->sh_offset + text->sh_size > size || text->sh_size > UINT16_MAX) {
+        fprintf(stderr, "stencil_gen: invalid stencil bounds for '%s' in '%s'\n",
+                entry->name, obj_path);
+        return -1;
+    }
+    entry->text = (uint8_t *)malloc(text->sh_size);
+    cont_offs = (uint16_t *)malloc(text->sh_size * sizeof(*cont_offs));
+    if (!entry->text || !cont_offs) {
+        free(cont_offs);
+        return -1;
+    }
+    memcpy(entry->text, data + text->sh_offset, text->sh_size);
+    entry->text_size = text->sh_size;
+    for (i = 0; i < eh->e_shnum; i++) {
+        const Elf64_Shdr *sh = &shdrs[i];
+        size_t count;
+        size_t j;
+        if ((sh->sh_type != SHT_RELA && sh->sh_type != SHT_REL) || sh->sh_info != text_index) {
+            continue;
+        }
+        if (sh->sh_offset + sh->sh_size > size) {
+            fprintf(stderr, "stencil_gen: relocation section out of bounds in '%s'\n", obj_path);
+            goto out;
+        }
+        count = sh->sh_size / (sh->sh_type == SHT_RELA ? sizeof(Elf64_Rela) : sizeof(Elf64_Rel));
+        for (j = 0; j < count; j++) {
+            uint64_t off;
+            uint64_t info;
+            int64_t addend = 0;
+            uint32_t sym_i;
+            if (sh->sh_type == SHT_RELA) {
+                const Elf64_Rela *rel = (const Elf64_Rela *)(data + sh->sh_offset) + j;
+                off = rel->r_offset;
+                info = rel->r_info;
+                addend = rel->r_addend;
+            } else {
+                const Elf64_Rel *rel = (const Elf64_Rel *)(data + sh->sh_offset) + j;
+                uint8_t implicit_size = 0;
+                off = rel->r_offset;
+                info = rel->r_info;
+                if (reloc_size_for_type(ELF64_R_TYPE(info), &implicit_size) == 0 &&
+                    off + implicit_size <= entry->text_size) {
+                    int32_t v32 = 0;
+                    if (implicit_size == 8) {
+                        memcpy(&addend, entry->text + off, 8);
+                    } else if (implicit_size == 4) {
+                        memcpy(&v32, entry->text + off, 4);
+                        addend = v32;
+                    }
+                }
+            }
+            sym_i = ELF64_R_SYM(info);
+            if (sym_i >= sym_count) {
+                continue;
+            }
+            if (add_stencil_reloc(entry, obj_path, sym_names + syms[sym_i].st_name,
+                                  ELF64_R_TYPE(info), off, addend,
+                                  cont_offs, &cont_count) != 0) {
+                goto out;
+            }
+        }
+    }
+    if (resolve_continuations(entry, cont_offs, cont_count) != 0) {
+        goto out;
+    }
+    qsort(entry->relocs, entry->reloc_count, sizeof(*entry->relocs), compare_reloc_entries);
+    if (entry->reloc_count == 0) {
+        fprintf(stderr, "stencil_gen: no hole relocations found in stencil '%s'\n",
+                entry->name);
+        goto out;
+    }
+    rc = 0;
+out:
+    free(cont_offs);
+    return rc;
+}
+
+/*
+ * Stencil sources are compiled with -ffunction-sections; every function
+ * stencil_<name> lands in .text.stencil_<name> and becomes one stencil.
+ */
+static int parse_elf_object(const char *obj_path, stencil_list_t *list) {
+    static const char stencil_prefix[] = ".text.stencil_";
     uint8_t *data = NULL;
     size_t size = 0;
     const Elf64_Ehdr *eh;
     const Elf64_Shdr *shdrs;
+    const Elf64_Shdr *symtab;
+    const Elf64_Shdr *strtab;
     const char *shstrtab;
-    uint16_t text_index = 0;
     uint16_t symtab_index = 0;
+    size_t found = 0;
     uint16_t i;
     if (read_file(obj_path, &data, &size) != 0) {
         fprintf(stderr, "stencil_gen: failed reading object '%s'\n", obj_path);
@@ -380,144 +609,60 @@ static int parse_elf_object(const char *obj_path, stencil_entry_t *entry) {
     }
     shstrtab = (const char *)(data + shdrs[eh->e_shstrndx].sh_offset);
     for (i = 0; i < eh->e_shnum; i++) {
-        const char *name = shstrtab + shdrs[i].sh_name;
-        if (strcmp(name, ".text") == 0) {
-            text_index = i;
-        } else if (shdrs[i].sh_type == SHT_SYMTAB) {
+        if (shdrs[i].sh_type == SHT_SYMTAB) {
             symtab_index = i;
         }
     }
-    if (text_index == 0) {
-        fprintf(stderr, "stencil_gen: no .text section in '%s'\n", obj_path);
-        free(data);
-        return -1;
-    }
     if (symtab_index == 0) {
         fprintf(stderr, "stencil_gen: no symbol table in '%s'\n", obj_path);
         free(data);
         return -1;
     }
-    if (shdrs[text_index].sh_offset + shdrs[text_index].sh_size > size ||
-        shdrs[text_index].sh_size == 0) {
-        fprintf(stderr, "stencil_gen: invalid .text bounds in '%s'\n", obj_path);
+    symtab = &shdrs[symtab_index];
+    if (symtab->sh_link >= eh->e_shnum || symtab->sh_entsize != sizeof(Elf64_Sym)) {
+        fprintf(stderr, "stencil_gen: invalid symbol table metadata in '%s'\n", obj_path);
         free(data);
         return -1;
     }
-    entry->text = (uint8_t *)malloc(shdrs[text_index].sh_size);
-    if (!entry->text) {
+    strtab = &shdrs[symtab->sh_link];
+    if (symtab->sh_offset + symtab->sh_size > size ||
+        strtab->sh_offset + strtab->sh_size > size) {
+        fprintf(stderr, "stencil_gen: bad symbol/string table bounds in '%s'\n", obj_path);
         free(data);
         return -1;
     }
-    memcpy(entry->text, data + shdrs[text_index].sh_offset, shdrs[text_index].sh_size);
-    entry->text_size = shdrs[text_index].sh_size;
-    {
-        const Elf64_Shdr *symtab = &shdrs[symtab_index];
-        const Elf64_Shdr *strtab;
-        const Elf64_Sym *syms;
-        const char *sym_names;
-        size_t sym_count;
-        if (symtab->sh_link >= eh->e_shnum || symtab->sh_entsize != sizeof(Elf64_Sym)) {
-            fprintf(stderr, "stencil_gen: invalid symbol table metadata in '%s'\n", obj_path);
+    for (i = 0; i < eh->e_shnum; i++) {
+        const char *name = shstrtab + shdrs[i].sh_name;
+        stencil_entry_t *entry;
+        if (shdrs[i].sh_type != SHT_PROGBITS || !(shdrs[i].sh_flags & SHF_EXECINSTR) ||
+            shdrs[i].sh_size == 0) {
+            continue;
+        }
+        if (strncmp(name, stencil_prefix, sizeof(stencil_prefix) - 1) != 0 ||
+            name[sizeof(stencil_prefix) - 1] == '\0') {
+            fprintf(stderr, "stencil_gen: code outside a stencil_ function in '%s' (%s)\n",
+                    obj_path, name);
             free(data);
             return -1;
         }
-        strtab = &shdrs[symtab->sh_link];
-        if (symtab->sh_offset + symtab->sh_size > size ||
-            strtab->sh_offset + strtab->sh_size > size) {
-            fprintf(stderr, "stencil_gen: bad symbol/string table bounds in '%s'\n", obj_path);
+        entry = push_entry(list, name + sizeof(stencil_prefix) - 1);
+        if (!entry) {
             free(data);
             return -1;
         }
-        syms = (const Elf64_Sym *)(data + symtab->sh_offset);
-        sym_names = (const char *)(data + strtab->sh_offset);
-        sym_count = symtab->sh_size / sizeof(Elf64_Sym);
-        for (i = 0; i < eh->e_shnum; i++) {
-            const Elf64_Shdr *sh = &shdrs[i];
-            if ((sh->sh_type != SHT_RELA && sh->sh_type != SHT_REL) || sh->sh_info != text_index) {
-                continue;
-            }
-            if (sh->sh_offset + sh->sh_size > size) {
-                fprintf(stderr, "stencil_gen: relocation section out of bounds in '%s'\n", obj_path);
-                free(data);
-                return -1;
-            }
-            if (sh->sh_type == SHT_RELA) {
-                size_t count = sh->sh_size / sizeof(Elf64_Rela);
-                size_t j;
-                const Elf64_Rela *rels = (const Elf64_Rela *)(data + sh->sh_offset);
-                for (j = 0; j < count; j++) {
-                    uint32_t sym_i = ELF64_R_SYM(rels[j].r_info);
-                    uint32_t type = ELF64_R_TYPE(rels[j].r_info);
-                    lr_stencil_hole_t hole;
-                    uint8_t patch_size = 0;
-                    uint64_t off = rels[j].r_offset;
-                    const char *sym_name;
-                    if (sym_i >= sym_count) {
-                        continue;
-                    }
-                    sym_name = sym_names + syms[sym_i].st_name;
-                    if (map_hole_symbol(sym_name, &hole) != 0) {
-                        continue;
-                    }
-                    if (reloc_size_for_type(type, &patch_size) != 0) {
-                        fprintf(stderr,
-                                "stencil_gen: unsupported relocation type %u for '%s'\n",
-                                type, sym_name);
-                        free(data);
-                        return -1;
-                    }
-                    if (off > UINT16_MAX || off + patch_size > entry->text_size) {
-                        fprintf(stderr, "stencil_gen: relocation offset out of range in '%s'\n", obj_path);
-                        free(data);
-                        return -1;
-                    }
-                    if (add_reloc(entry, (uint16_t)off, patch_size, hole) != 0) {
-                        free(data);
-                        return -1;
-                    }
-                }
-            } else {
-                size_t count = sh->sh_size / sizeof(Elf64_Rel);
-                size_t j;
-                const Elf64_Rel *rels = (const Elf64_Rel *)(data + sh->sh_offset);
-                for (j = 0; j < count; j++) {
-                    uint32_t sym_i = ELF64_R_SYM(rels[j].r_info);
-                    uint32_t type = ELF64_R_TYPE(rels[j].r_info);
-                    lr_stencil_hole_t hole;
-                    uint8_t patch_size = 0;
-                    uint64_t off = rels[j].r_offset;
-                    const char *sym_name;
-                    if (sym_i >= sym_count) {
-                        continue;
-                    }
-                    sym_name = sym_names + syms[sym_i].st_name;
-                    if (map_hole_symbol(sym_name, &hole) != 0) {
-                        continue;
-                    }
-                    if (reloc_size_for_type(type, &patch_size) != 0) {
-                        fprintf(stderr,
-                                "stencil_gen: unsupported relocation type %u for '%s'\n",
-                                type, sym_name);
-                        free(data);
-                        return -1;
-                    }
-                    if (off > UINT16_MAX || off + patch_size > entry->text_size) {
-                        fprintf(stderr, "stencil_gen: relocation offset out of range in '%s'\n", obj_path);
-                        free(data);
-                        return -1;
-                    }
-                    if (add_reloc(entry, (uint16_t)off, patch_size, hole) != 0) {
-                        free(data);
-                        return -1;
-                    }
-                }
-            }
+        if (parse_stencil_section(data, size, obj_path, eh, shdrs, i,
+                                  (const Elf64_Sym *)(data + symtab->sh_offset),
+                                  symtab->sh_size / sizeof(Elf64_Sym),
+                                  (const char *)(data + strtab->sh_offset),
+                                  entry) != 0) {
+            free(data);
+            return -1;
         }
+        found++;
     }
-    qsort(entry->relocs, entry->reloc_count, sizeof(*entry->relocs), compare_reloc_entries);
     free(data);
-    if (entry->reloc_count == 0) {
-        fprintf(stderr, "stencil_gen: no hole relocations found in '%s'\n", obj_path);
+    if (found == 0) {
+        fprintf(stderr, "stencil_gen: no stencil_ functions in '%s'\n", obj_path);
         return -1;
     }
     return 0;
@@ -577,7 +722,7 @@ static int write_header(const char *output, const stencil_entry_t *entries, size
     fprintf(fp, "#include \"stencil_data.h\"\n\n");
 
     for (i = 0; i < count; i++) {
-        char *id = sanitize_identifier(entries[i].stem);
+        char *id = sanitize_identifier(entries[i].name);
         size_t j;
         if (!id) {
             fclose(fp);
@@ -607,7 +752,7 @@ static int write_header(const char *output, const stencil_entry_t *entries, size
         }
         fprintf(fp, "};\n");
         fprintf(fp, "static const lr_stencil_t lr_stencil_%s = {\n", id);
-        fprintf(fp, "    \"%s\",\n", entries[i].stem);
+        fprintf(fp, "    \"%s\",\n", entries[i].name);
         fprintf(fp, "    lr_stencil_%s_bytes,\n", id);
         fprintf(fp, "    (uint16_t)%zu,\n", entries[i].text_size);
         fprintf(fp, "    lr_stencil_%s_relocs,\n", id);
@@ -617,7 +762,7 @@ static int write_header(const char *output, const stencil_entry_t *entries, size
     }
     fprintf(fp, "static const lr_stencil_t *const lr_generated_stencils[] = {\n");
     for (i = 0; i < count; i++) {
-        char *id = sanitize_identifier(entries[i].stem);
+        char *id = sanitize_identifier(entries[i].name);
         if (!id) {
             fclose(fp);
             return -1;
@@ -639,20 +784,26 @@ static void free_entries(stencil_entry_t *entries, size_t count) {
         return;
     }
     for (i = 0; i < count; i++) {
-        free(entries[i].stem);
+        free(entries[i].name);
         free(entries[i].text);
         free(entries[i].relocs);
     }
     free(entries);
 }
 
+static int compare_stencil_entries(const void *a, const void *b) {
+    const stencil_entry_t *ea = (const stencil_entry_t *)a;
+    const stencil_entry_t *eb = (const stencil_entry_t *)b;
+    return strcmp(ea->name, eb->name);
+}
+
 int main(int argc, char **argv) {
     const char *input_dir = NULL;
     const char *output = NULL;
     const char *compiler = "cc";
     source_file_t *sources = NULL;
     size_t source_count = 0;
-    stencil_entry_t *entries = NULL;
+    stencil_list_t list = {0};
     size_t i;
     int rc = 1;
     char tmp_dir[PATH_MAX];
@@ -691,11 +842,6 @@ int main(int argc, char **argv) {
     if (list_sources(input_dir, &sources, &source_count) != 0) {
         goto cleanup;
     }
-    entries = (stencil_entry_t *)calloc(source_count, sizeof(*entries));
-    if (!entries) {
-        goto cleanup;
-    }
-
     for (i = 0; i < source_count; i++) {
         char *obj_path = path_join(tmp_dir, sources[i].stem);
         char *obj_path_full;
@@ -709,17 +855,12 @@ int main(int argc, char **argv) {
         }
         obj_path = obj_path_full;
         strcat(obj_path, ".o");
-        entries[i].stem = dup_cstr(sources[i].stem);
-        if (!entries[i].stem) {
-            free(obj_path);
-            goto cleanup;
-        }
         if (compile_stencil_source(compiler, sources[i].path, obj_path) != 0) {
             fprintf(stderr, "stencil_gen: compile failed for '%s'\n", sources[i].path);
             free(obj_path);
             goto cleanup;
         }
-        if (parse_elf_object(obj_path, &entries[i]) != 0) {
+        if (parse_elf_object(obj_path, &list) != 0) {
             free(obj_path);
             goto cleanup;
         }
@@ -727,7 +868,17 @@ int main(int argc, char **argv) {
         free(obj_path);
     }
 
-    if (write_header(output, entries, source_count) != 0) {
+    /* Sorted output keeps the header deterministic and lets the runtime
+       binary-search stencils by name. */
+    qsort(list.entries, list.count, sizeof(*list.entries), compare_stencil_entries);
+    for (i = 1; i < list.count; i++) {
+        if (strcmp(list.entries[i - 1].name, list.entries[i].name) == 0) {
+            fprintf(stderr, "stencil_gen: duplicate stencil '%s'\n", list.entries[i].name);
+            goto cleanup;
+        }
+    }
+
+    if (write_header(output, list.entries, list.count) != 0) {
         goto cleanup;
     }
 
@@ -751,7 +902,7 @@ cleanup:
         }
     }
     rmdir(tmp_dir);
-    free_entries(entries, source_count);
+    free_entries(list.entries, list.count);
     free_sources(sources, source_count);
     return rc;
 }